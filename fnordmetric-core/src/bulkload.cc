@@ -0,0 +1,285 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fstream>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <fnordmetric/cli/flagparser.h>
+#include <fnordmetric/environment.h>
+#include <fnordmetric/metricdb/backends/disk/bulkloader.h>
+#include <fnordmetric/util/outputstream.h>
+#include <fnordmetric/util/random.h>
+#include <fnordmetric/util/runtimeexception.h>
+#include <fnordmetric/util/wallclock.h>
+
+/**
+ * Loads historical samples from CSV or JSON lines files into the datadir of
+ * a disk backend, writing finalized sstables directly instead of sending the
+ * samples through a running server. The input does not need to be sorted.
+ *
+ * CSV, time in milliseconds since epoch, any number of labels:
+ *
+ *   http_latency,1414141414000,23.5,host=web01,path=/
+ *
+ * JSON lines:
+ *
+ *   {"metric": "http_latency", "time": 1414141414000, "value": 23.5,
+ *    "labels": {"host": "web01", "path": "/"}}
+ *
+ * Empty lines and CSV lines starting with '#' are skipped; invalid lines are
+ * reported and skipped. The server must not be running on the datadir while
+ * loading; it picks up the new tables on its next start. If the server runs
+ * with --cold_datadir, pass the same --cold_datadir to the loader.
+ *
+ *   $ fnordmetric-bulkload --datadir /var/lib/fnordmetric export.csv
+ *   $ zcat export.json.gz | fnordmetric-bulkload --datadir data --format json -
+ */
+using namespace fnordmetric;
+using fnord::util::WallClock;
+
+static const int kMaxReportedErrors = 10;
+
+static void printUsage() {
+  auto err_stream = fnordmetric::util::OutputStream::getStderr();
+  err_stream->printf("usage: fnordmetric-bulkload [options] <file>...\n");
+  err_stream->printf("\noptions:\n");
+  env()->flags()->printUsage(err_stream.get());
+  err_stream->printf("\nexamples:\n");
+  err_stream->printf("    $ fnordmetric-bulkload --datadir /var/lib/fnordmetric export.csv\n");
+  err_stream->printf("    $ zcat export.json.gz | fnordmetric-bulkload --datadir data --format json -\n");
+}
+
+static int runBulkload() {
+  auto flags = env()->flags();
+
+  if (!flags->isSet("datadir")) {
+    RAISE(kUsageError, "missing flag: --datadir");
+  }
+
+  auto format = flags->getString("format");
+  if (format != "csv" && format != "json") {
+    RAISE(kUsageError, "invalid format: %s", format.c_str());
+  }
+
+  const auto& files = flags->getArgv();
+  if (files.empty()) {
+    RAISE(kUsageError, "no input files");
+  }
+
+  if (flags->getInt("threads") < 1 ||
+      flags->getInt("memory_limit") < 1 ||
+      flags->getInt("table_size") < 1) {
+    RAISE(kUsageError, "--threads, --memory_limit and --table_size must be > 0");
+  }
+
+  std::string cold_datadir;
+  if (flags->isSet("cold_datadir")) {
+    cold_datadir = flags->getString("cold_datadir");
+  }
+
+  auto start = WallClock::unixMicros();
+
+  metricdb::disk_backend::BulkLoader loader(
+      flags->getString("datadir"),
+      flags->getInt("threads"),
+      flags->getInt("memory_limit") << 20,
+      flags->getString("tmpdir"),
+      cold_datadir);
+
+  loader.setTableMaxSize(flags->getInt("table_size") << 20);
+
+  auto err_stream = fnordmetric::util::OutputStream::getStderr();
+  size_t num_errors = 0;
+  std::string metric_key;
+  metricdb::IMetric::BatchSample sample;
+
+  for (const auto& path : files) {
+    std::ifstream file;
+    if (path != "-") {
+      file.open(path);
+      if (!file.is_open()) {
+        RAISE(kIOError, "can't open file: %s", path.c_str());
+      }
+    }
+
+    std::istream& input = path == "-" ? std::cin : file;
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(input, line)) {
+      ++line_number;
+
+      if (line.empty() || (format == "csv" && line[0] == '#')) {
+        continue;
+      }
+
+      try {
+        if (format == "csv") {
+          metricdb::disk_backend::BulkLoader::parseCSVLine(
+              line,
+              &metric_key,
+              &sample);
+        } else {
+          metricdb::disk_backend::BulkLoader::parseJSONLine(
+              line,
+              &metric_key,
+              &sample);
+        }
+      } catch (const fnordmetric::util::RuntimeException& e) {
+        if (++num_errors <= kMaxReportedErrors) {
+          err_stream->printf(
+              "[WARNING] %s:%i: %s\n",
+              path.c_str(),
+              (int) line_number,
+              e.getMessage().c_str());
+        }
+
+        continue;
+      }
+
+      loader.addSample(metric_key, sample.time, sample.value, sample.labels);
+    }
+  }
+
+  auto parsed = WallClock::unixMicros();
+  loader.finish();
+  auto finished = WallClock::unixMicros();
+
+  auto out_stream = fnordmetric::util::OutputStream::getStdout();
+  auto secs = (finished - start) / 1000000.0;
+  out_stream->printf(
+      "loaded %llu samples into %llu tables of %llu metrics in %.2fs " \
+      "(%.0f samples/s)\n",
+      (long long unsigned) loader.numSamples(),
+      (long long unsigned) loader.numTables(),
+      (long long unsigned) loader.numMetrics(),
+      secs,
+      secs > 0 ? loader.numSamples() / secs : 0);
+
+  out_stream->printf(
+      "  read: %.2fs, sort+write: %.2fs, invalid lines: %llu\n",
+      (parsed - start) / 1000000.0,
+      (finished - parsed) / 1000000.0,
+      (long long unsigned) num_errors);
+
+  return 0;
+}
+
+int main(int argc, const char** argv) {
+  fnord::util::Random::init();
+
+  env()->flags()->defineFlag(
+      "datadir",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "Write the tables into this disk backend datadir",
+      "<path>");
+
+  env()->flags()->defineFlag(
+      "cold_datadir",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "The cold datadir of the disk backend, if the server uses one",
+      "<path>");
+
+  env()->flags()->defineFlag(
+      "format",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      "csv",
+      "Input format: 'csv' or 'json' (one object per line). Default: 'csv'",
+      "<name>");
+
+  env()->flags()->defineFlag(
+      "threads",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "4",
+      "Sort and write this many partitions of the metrics in parallel",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "memory_limit",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "256",
+      "Buffer this many megabytes of samples before spilling sorted runs",
+      "<mb>");
+
+  env()->flags()->defineFlag(
+      "table_size",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "64",
+      "Start a new table once a table is larger than this many megabytes",
+      "<mb>");
+
+  env()->flags()->defineFlag(
+      "tmpdir",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      "/tmp",
+      "Write the sorted runs into this directory",
+      "<path>");
+
+  env()->flags()->defineFlag(
+      "verbose",
+      cli::FlagParser::T_SWITCH,
+      false,
+      NULL,
+      NULL,
+      "Be verbose");
+
+  env()->flags()->defineFlag(
+      "help",
+      cli::FlagParser::T_SWITCH,
+      false,
+      "h",
+      NULL,
+      "You are reading it...");
+
+  env()->flags()->parseArgv(argc, argv);
+  env()->setVerbose(env()->flags()->isSet("verbose"));
+
+  if (env()->flags()->isSet("help")) {
+    printUsage();
+    return 0;
+  }
+
+  try {
+    return runBulkload();
+  } catch (const fnordmetric::util::RuntimeException& e) {
+    auto err_stream = fnordmetric::util::OutputStream::getStderr();
+    auto msg = e.getMessage();
+    err_stream->printf("[ERROR] ");
+    err_stream->write(msg.c_str(), msg.size());
+    err_stream->printf("\n");
+
+    if (e.getTypeName() == kUsageError) {
+      err_stream->printf("\n");
+      printUsage();
+    }
+
+    return 1;
+  }
+
+  return 0;
+}
@@ -98,6 +98,43 @@ int64_t FlagParser::getInt(const char* longopt) const {
   RAISE(kFlagError, "flag '%s' is not set", longopt);
 }
 
+double FlagParser::getFloat(const char* longopt) const {
+  for (auto& flag : flags_) {
+    if (flag.longopt == longopt) {
+      if (flag.type != T_FLOAT) {
+        RAISE(kFlagError, "flag '%s' is not a float", longopt);
+      }
+
+      std::string flag_value_str;
+
+      if (flag.values.size() == 0) {
+        if (flag.default_value != nullptr) {
+          flag_value_str = flag.default_value;
+        } else {
+          RAISE(kFlagError, "flag '%s' is not set", longopt);
+        }
+      } else {
+        flag_value_str = flag.values.back();
+      }
+
+      double flag_value;
+      try {
+        flag_value = std::stod(flag_value_str);
+      } catch (std::exception e) {
+        RAISE(
+            kFlagError,
+            "flag '%s' value '%s' is not a valid float",
+            longopt,
+            flag_value_str.c_str());
+      }
+
+      return flag_value;
+    }
+  }
+
+  RAISE(kFlagError, "flag '%s' is not set", longopt);
+}
+
 void FlagParser::parseArgv(int argc, const char** argv) {
   std::vector<std::string> args;
   for (int i = 1; i < argc; ++i) {
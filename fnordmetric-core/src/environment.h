@@ -11,6 +11,7 @@
 #define _FNORDMETRIC_ENVIRONMENT_H
 #include <memory>
 #include <fnordmetric/cli/flagparser.h>
+#include <fnordmetric/stats/statsregistry.h>
 #include <fnordmetric/util/logger.h>
 #include "config.h"
 
@@ -30,6 +31,13 @@ public:
     return logger_.get();
   }
 
+  /**
+   * The registry of the process's own counters, gauges and histograms
+   */
+  inline fnord::stats::StatsRegistry* stats() {
+    return &stats_;
+  }
+
   inline bool verbose() {
     return verbose_;
   }
@@ -40,6 +48,7 @@ protected:
   bool verbose_;
   cli::FlagParser flag_parser_;
   std::unique_ptr<Logger> logger_;
+  fnord::stats::StatsRegistry stats_;
 };
 
 Environment* env();
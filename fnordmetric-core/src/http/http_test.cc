@@ -10,11 +10,21 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
 #include <fnordmetric/util/inputstream.h>
 #include <fnordmetric/http/httpinputstream.h>
 #include <fnordmetric/http/httpoutputstream.h>
+#include <fnordmetric/http/httpparser.h>
 #include <fnordmetric/http/httprequest.h>
 #include <fnordmetric/http/httpresponse.h>
+#include <fnordmetric/http/httpserver.h>
+#include <fnordmetric/thread/admissioncontroller.h>
+#include <fnordmetric/thread/threadpool.h>
 #include <fnordmetric/util/unittest.h>
 #include <fnordmetric/util/runtimeexception.h>
 
@@ -120,3 +130,478 @@ TEST_CASE(HTTPTest, PopulateHTTPResponseFromHTTP1dot0KeepaliveRequest, [] () {
   EXPECT_EQ(response.getVersion(), "HTTP/1.0");
   EXPECT_EQ(response.getHeader("Connection"), "keep-alive");
 });
+
+TEST_CASE(HTTPTest, WriteChunkedHTTPResponse, [] () {
+  auto req = "GET / HTTP/1.1\r\n" \
+             "\r\n";
+
+  StringInputStream is(req);
+  HTTPInputStream http_is(&is);
+  HTTPRequest request;
+  request.readFromInputStream(&http_is);
+
+  HTTPResponse response;
+  response.populateFromRequest(request);
+  response.setStatus(kStatusOK);
+  response.setBodyWriter([] (std::shared_ptr<OutputStream> body) {
+    body->write("fnord");
+    body->write(std::string(10000, 'x'));
+  });
+
+  std::string output;
+  StringOutputStream os(&output);
+  HTTPOutputStream http_os(&os);
+  response.writeToOutputStream(&http_os);
+
+  std::string expected =
+      "HTTP/1.1 200 OK\r\n" \
+      "transfer-encoding: chunked\r\n" \
+      "\r\n" \
+      "2715\r\n" \
+      "fnord" + std::string(10000, 'x') + "\r\n" \
+      "0\r\n" \
+      "\r\n";
+
+  EXPECT_EQ(output, expected);
+});
+
+TEST_CASE(HTTPTest, WriteStreamingHTTP1dot0Response, [] () {
+  auto req = "GET / HTTP/1.0\r\n" \
+             "\r\n";
+
+  StringInputStream is(req);
+  HTTPInputStream http_is(&is);
+  HTTPRequest request;
+  request.readFromInputStream(&http_is);
+
+  HTTPResponse response;
+  response.populateFromRequest(request);
+  response.setStatus(kStatusOK);
+  response.setBodyWriter([] (std::shared_ptr<OutputStream> body) {
+    body->write("fnord");
+  });
+
+  std::string output;
+  StringOutputStream os(&output);
+  HTTPOutputStream http_os(&os);
+  response.writeToOutputStream(&http_os);
+
+  EXPECT_EQ(
+      output,
+      "HTTP/1.0 200 OK\r\n" \
+      "connection: close\r\n" \
+      "content-length: 5\r\n" \
+      "\r\n" \
+      "fnord");
+});
+
+TEST_CASE(HTTPTest, ParseRequestIncrementally, [] () {
+  std::string req =
+      "POST /metrics?fnord=bar HTTP/1.1\r\n" \
+      "Host: localhost\r\n" \
+      "X-Fnord:   blah \r\n" \
+      "content-LENGTH: 5\r\n" \
+      "\r\n" \
+      "hello";
+
+  /* feed the request one byte at a time, like a very slow client would */
+  HTTPParser parser;
+  for (int i = 1; i < req.size(); ++i) {
+    EXPECT(parser.parse(req.data(), i) == false);
+  }
+
+  EXPECT(parser.parse(req.data(), req.size()) == true);
+  EXPECT_EQ(parser.requestSize(), req.size());
+  EXPECT_EQ(HTTPParser::toString(req.data(), parser.method()), "POST");
+  EXPECT_EQ(
+      HTTPParser::toString(req.data(), parser.url()),
+      "/metrics?fnord=bar");
+
+  HTTPRequest request;
+  request.readFromParser(parser, req.data());
+  EXPECT_EQ(request.getMethod(), "POST");
+  EXPECT_EQ(request.getVersion(), "HTTP/1.1");
+  EXPECT_EQ(request.getHeader("Host"), "localhost");
+  EXPECT_EQ(request.getHeader("X-Fnord"), "blah");
+  EXPECT_EQ(request.getBody(), "hello");
+});
+
+TEST_CASE(HTTPTest, ParsePipelinedRequests, [] () {
+  std::string req =
+      "GET /one HTTP/1.1\r\n" \
+      "\r\n" \
+      "POST /two HTTP/1.1\r\n" \
+      "Content-Length: 3\r\n" \
+      "\r\n" \
+      "abc" \
+      "GET /three HTTP/1.1\n" \
+      "\n";
+
+  std::vector<std::string> urls;
+  size_t pos = 0;
+  HTTPParser parser;
+
+  while (pos < req.size()) {
+    EXPECT(parser.parse(req.data() + pos, req.size() - pos) == true);
+
+    HTTPRequest request;
+    request.readFromParser(parser, req.data() + pos);
+    urls.emplace_back(request.getUrl() + request.getBody());
+
+    pos += parser.requestSize();
+    parser.reset();
+  }
+
+  EXPECT_EQ(urls.size(), 3);
+  EXPECT_EQ(urls[0], "/one");
+  EXPECT_EQ(urls[1], "/twoabc");
+  EXPECT_EQ(urls[2], "/three");
+});
+
+TEST_CASE(HTTPTest, RejectOversizedHeaders, [] () {
+  std::string req = "GET / HTTP/1.1\r\nX-Fnord: ";
+  req += std::string(1024, 'x');
+
+  HTTPParser parser(512);
+  bool raised = false;
+
+  try {
+    parser.parse(req.data(), req.size());
+  } catch (fnordmetric::util::RuntimeException e) {
+    raised = true;
+  }
+
+  EXPECT(raised);
+});
+
+TEST_CASE(HTTPTest, RejectInvalidRequests, [] () {
+  std::vector<std::string> reqs;
+  reqs.emplace_back("GET\r\n\r\n");
+  reqs.emplace_back("GET /\r\n\r\n");
+  reqs.emplace_back("GET / HTTP/1.1\r\nfnord\r\n\r\n");
+  reqs.emplace_back("POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n");
+
+  for (const auto& req : reqs) {
+    HTTPParser parser;
+    bool raised = false;
+
+    try {
+      parser.parse(req.data(), req.size());
+    } catch (fnordmetric::util::RuntimeException e) {
+      raised = true;
+    }
+
+    EXPECT(raised);
+  }
+});
+
+class EchoURLHandler : public HTTPHandler {
+public:
+  bool handleHTTPRequest(
+      HTTPRequest* request,
+      HTTPResponse* response) override {
+    response->setStatus(kStatusOK);
+    response->addBody(request->getUrl() + ":" + request->getBody());
+    return true;
+  }
+};
+
+TEST_CASE(HTTPTest, ServePipelinedRequests, [] () {
+  /* the server never shuts down, so everything is intentionally leaked */
+  auto pool = new fnord::thread::ThreadPool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler("crashed")));
+
+  auto server = new HTTPServer(pool);
+  server->addHandler(std::unique_ptr<HTTPHandler>(new EchoURLHandler()));
+  std::thread server_thread([server] () { server->listen(18099); });
+  server_thread.detach();
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(18099);
+  for (int i = 0; connect(fd, (struct sockaddr *) &addr, sizeof(addr)); ++i) {
+    EXPECT(i < 100);
+    usleep(10000);
+  }
+
+  std::string req =
+      "GET /one HTTP/1.1\r\n" \
+      "\r\n" \
+      "POST /two HTTP/1.1\r\n" \
+      "Content-Length: 5\r\n" \
+      "\r\n" \
+      "fnord" \
+      "GET /three HTTP/1.0\r\n" \
+      "\r\n";
+
+  /* send the requests in small pieces to exercise the incremental parsing */
+  for (int i = 0; i < req.size(); i += 7) {
+    auto len = std::min(req.size() - i, (size_t) 7);
+    EXPECT(write(fd, req.data() + i, len) == len);
+    usleep(1000);
+  }
+
+  std::string resp;
+  char buf[4096];
+  for (;;) {
+    auto n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+
+    resp.append(buf, n);
+  }
+
+  close(fd);
+
+  EXPECT_EQ(
+      resp,
+      "HTTP/1.1 200 OK\r\n" \
+      "content-length: 5\r\n" \
+      "\r\n" \
+      "/one:" \
+      "HTTP/1.1 200 OK\r\n" \
+      "content-length: 10\r\n" \
+      "\r\n" \
+      "/two:fnord" \
+      "HTTP/1.0 200 OK\r\n" \
+      "connection: close\r\n" \
+      "content-length: 7\r\n" \
+      "\r\n" \
+      "/three:");
+});
+
+class ThrowingHandler : public HTTPHandler {
+public:
+  bool handleHTTPRequest(
+      HTTPRequest* request,
+      HTTPResponse* response) override {
+    response->setStatus(kStatusOK);
+    response->addBody(std::to_string(std::stoull(request->getBody())));
+    return true;
+  }
+};
+
+TEST_CASE(HTTPTest, RespondToFailedRequests, [] () {
+  /* the server never shuts down, so everything is intentionally leaked */
+  auto pool = new fnord::thread::ThreadPool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler("crashed")));
+
+  auto server = new HTTPServer(pool);
+  server->addHandler(std::unique_ptr<HTTPHandler>(new ThrowingHandler()));
+  std::thread server_thread([server] () { server->listen(18100); });
+  server_thread.detach();
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(18100);
+  for (int i = 0; connect(fd, (struct sockaddr *) &addr, sizeof(addr)); ++i) {
+    EXPECT(i < 100);
+    usleep(10000);
+  }
+
+  /* std::stoull throws std::invalid_argument */
+  std::string req =
+      "POST /fail HTTP/1.1\r\n" \
+      "Content-Length: 5\r\n" \
+      "\r\n" \
+      "fnord";
+
+  EXPECT(write(fd, req.data(), req.size()) == req.size());
+
+  /* the server responds and closes the connection */
+  std::string resp;
+  char buf[4096];
+  for (;;) {
+    auto n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+
+    resp.append(buf, n);
+  }
+
+  close(fd);
+
+  EXPECT_EQ(
+      resp.substr(0, resp.find("\r\n")),
+      "HTTP/1.1 500 InternalServerError");
+  EXPECT(resp.find("Internal Server Error", resp.find("\r\n\r\n")) !=
+      std::string::npos);
+});
+
+TEST_CASE(HTTPTest, RejectOversizedBodies, [] () {
+  /* the server never shuts down, so everything is intentionally leaked */
+  auto pool = new fnord::thread::ThreadPool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler("crashed")));
+
+  auto server = new HTTPServer(pool);
+  server->setMaxBodySize(16);
+  server->addHandler(std::unique_ptr<HTTPHandler>(new EchoURLHandler()));
+  std::thread server_thread([server] () { server->listen(18101); });
+  server_thread.detach();
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(18101);
+  for (int i = 0; connect(fd, (struct sockaddr *) &addr, sizeof(addr)); ++i) {
+    EXPECT(i < 100);
+    usleep(10000);
+  }
+
+  /* the request is rejected before the body was sent */
+  std::string req =
+      "POST /big HTTP/1.1\r\n" \
+      "Content-Length: 1000000\r\n" \
+      "\r\n";
+
+  EXPECT(write(fd, req.data(), req.size()) == req.size());
+
+  std::string resp;
+  char buf[4096];
+  for (;;) {
+    auto n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+
+    resp.append(buf, n);
+  }
+
+  close(fd);
+
+  EXPECT_EQ(
+      resp.substr(0, resp.find("\r\n")),
+      "HTTP/1.1 413 Request Entity Too Large");
+});
+
+TEST_CASE(HTTPTest, RouteRequestsByMethod, [] () {
+  /* the server never shuts down, so everything is intentionally leaked */
+  auto pool = new fnord::thread::ThreadPool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler("crashed")));
+
+  /* rejects every request */
+  auto admission = new fnord::thread::AdmissionController(0, 0);
+
+  auto server = new HTTPServer(pool);
+  server->addRequestScheduler("/scan", HTTPRequest::M_GET, pool, admission);
+  server->addHandler(std::unique_ptr<HTTPHandler>(new EchoURLHandler()));
+  std::thread server_thread([server] () { server->listen(18102); });
+  server_thread.detach();
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(18102);
+  for (int i = 0; connect(fd, (struct sockaddr *) &addr, sizeof(addr)); ++i) {
+    EXPECT(i < 100);
+    usleep(10000);
+  }
+
+  std::string req =
+      "GET /scan HTTP/1.1\r\n" \
+      "\r\n" \
+      "POST /scan HTTP/1.0\r\n" \
+      "\r\n";
+
+  EXPECT(write(fd, req.data(), req.size()) == req.size());
+
+  std::string resp;
+  char buf[4096];
+  for (;;) {
+    auto n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+
+    resp.append(buf, n);
+  }
+
+  close(fd);
+
+  EXPECT_EQ(
+      resp.substr(0, resp.find("\r\n")),
+      "HTTP/1.1 503 Service Unavailable");
+  EXPECT(resp.find("HTTP/1.0 200 OK\r\n") != std::string::npos);
+  EXPECT(resp.find("/scan:") != std::string::npos);
+});
+
+TEST_CASE(HTTPTest, RetryAcceptWhenOutOfFileDescriptors, [] () {
+  /* the server never shuts down, so everything is intentionally leaked */
+  auto pool = new fnord::thread::ThreadPool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler("crashed")));
+
+  auto server = new HTTPServer(pool);
+  server->addHandler(std::unique_ptr<HTTPHandler>(new EchoURLHandler()));
+  std::thread server_thread([server] () { server->listen(18103); });
+  server_thread.detach();
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(18103);
+
+  /* wait until the server is listening */
+  int probe_fd = socket(AF_INET, SOCK_STREAM, 0);
+  for (int i = 0; connect(probe_fd, (struct sockaddr *) &addr, sizeof(addr));
+      ++i) {
+    EXPECT(i < 100);
+    usleep(10000);
+  }
+
+  close(probe_fd);
+  usleep(10000);
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct timeval timeout;
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  /* the connection ends up in the backlog while accept() fails with EMFILE.
+     it is only accepted if the server retries once fds are available again */
+  struct rlimit orig_limit;
+  EXPECT(getrlimit(RLIMIT_NOFILE, &orig_limit) == 0);
+  struct rlimit limit = orig_limit;
+  limit.rlim_cur = 0;
+  EXPECT(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+  EXPECT(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+  usleep(20000);
+  EXPECT(setrlimit(RLIMIT_NOFILE, &orig_limit) == 0);
+
+  std::string req = "GET /retry HTTP/1.0\r\n\r\n";
+  EXPECT(write(fd, req.data(), req.size()) == req.size());
+
+  std::string resp;
+  char buf[4096];
+  for (;;) {
+    auto n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+
+    resp.append(buf, n);
+  }
+
+  close(fd);
+
+  EXPECT_EQ(resp.substr(0, resp.find("\r\n")), "HTTP/1.0 200 OK");
+  EXPECT(resp.find("/retry:") != std::string::npos);
+});
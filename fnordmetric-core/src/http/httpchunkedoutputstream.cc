@@ -0,0 +1,65 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2011-2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <fnordmetric/http/httpchunkedoutputstream.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnord {
+namespace http {
+
+HTTPChunkedOutputStream::HTTPChunkedOutputStream(
+    OutputStream* output_stream) :
+    output_(output_stream) {
+  buf_.reserve(kChunkSize);
+}
+
+size_t HTTPChunkedOutputStream::write(const char* data, size_t size) {
+  buf_.append(data, size);
+
+  if (buf_.size() >= kChunkSize) {
+    flush();
+  }
+
+  return size;
+}
+
+void HTTPChunkedOutputStream::flush() {
+  if (buf_.size() == 0) {
+    return;
+  }
+
+  char header[32];
+  auto header_len = snprintf(header, sizeof(header), "%zx\r\n", buf_.size());
+  buf_.append("\r\n");
+
+  writeFully(header, header_len);
+  writeFully(buf_.data(), buf_.size());
+  buf_.clear();
+}
+
+void HTTPChunkedOutputStream::finish() {
+  flush();
+  writeFully("0\r\n\r\n", 5);
+}
+
+void HTTPChunkedOutputStream::writeFully(const char* data, size_t size) {
+  /* the underlying stream may be a socket that accepts short writes */
+  for (size_t pos = 0; pos < size; ) {
+    auto bytes_written = output_->write(data + pos, size - pos);
+    if (bytes_written == 0) {
+      RAISE(kIOError, "write() failed: connection closed");
+    }
+
+    pos += bytes_written;
+  }
+}
+
+}
+}
@@ -0,0 +1,56 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2011-2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_HTTPCHUNKEDOUTPUTSTREAM_H
+#define _FNORDMETRIC_HTTPCHUNKEDOUTPUTSTREAM_H
+#include <string>
+#include <fnordmetric/util/outputstream.h>
+
+using fnordmetric::util::OutputStream;
+
+namespace fnord {
+namespace http {
+
+/**
+ * Writes a HTTP/1.1 message body using the chunked transfer encoding. Writes
+ * are buffered and sent as one chunk once kChunkSize bytes are buffered, so
+ * many small writes don't result in many small chunks.
+ */
+class HTTPChunkedOutputStream : public OutputStream {
+public:
+  static const size_t kChunkSize = 8192;
+
+  /**
+   * @param output_stream the output stream -- does not transfer ownership
+   */
+  HTTPChunkedOutputStream(OutputStream* output_stream);
+
+  size_t write(const char* data, size_t size) override;
+
+  /**
+   * Send all buffered data as a chunk
+   */
+  void flush();
+
+  /**
+   * Send all buffered data and the terminating zero length chunk. Nothing may
+   * be written to the stream after finish() was called.
+   */
+  void finish();
+
+protected:
+  void writeFully(const char* data, size_t size);
+
+  OutputStream* output_;
+  std::string buf_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,344 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <chrono>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fnordmetric/http/httpconnection.h>
+#include <fnordmetric/http/httpeventloop.h>
+#include <fnordmetric/http/httpoutputstream.h>
+#include <fnordmetric/http/httpserver.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+using fnordmetric::util::RuntimeException;
+
+namespace fnord {
+namespace http {
+
+HTTPConnection::HTTPConnection(
+    HTTPServer* server,
+    HTTPEventLoop* loop,
+    int fd) :
+    server_(server),
+    loop_(loop),
+    fd_(fd),
+    state_(S_IDLE),
+    peer_closed_(false),
+    close_after_flush_(false),
+    read_pos_(0),
+    parser_(kMaxHeaderSize),
+    write_pos_(0),
+    write_error_(false) {}
+
+HTTPConnection::~HTTPConnection() {
+  ::close(fd_);
+}
+
+int HTTPConnection::fd() const {
+  return fd_;
+}
+
+bool HTTPConnection::onReadable() {
+  char buf[16384];
+
+  /* drop requests that were already handled. the parser state is relative to
+     the start of the current request, so it stays valid */
+  if (read_pos_ > 0) {
+    read_buf_.erase(0, read_pos_);
+    read_pos_ = 0;
+  }
+
+  /* the socket is edge triggered, so read until it would block */
+  for (;;) {
+    auto bytes_read = ::read(fd_, buf, sizeof(buf));
+
+    if (bytes_read > 0) {
+      read_buf_.append(buf, bytes_read);
+      continue;
+    }
+
+    if (bytes_read < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+
+    peer_closed_ = true;
+    break;
+  }
+
+  /* nobody will read the response of the request that is being handled */
+  if (peer_closed_ && current_request_.get() != nullptr) {
+    current_request_->cancel();
+  }
+
+  return processRequests();
+}
+
+bool HTTPConnection::onWritable() {
+  {
+    std::lock_guard<std::mutex> lock_holder(write_mutex_);
+    flushWithLock();
+    write_cv_.notify_all();
+  }
+
+  if (state_ == S_IDLE && close_after_flush_) {
+    return closeIfDone();
+  }
+
+  return true;
+}
+
+bool HTTPConnection::processRequests() {
+  if (state_ != S_IDLE) {
+    return state_ != S_CLOSED;
+  }
+
+  if (close_after_flush_) {
+    return closeIfDone();
+  }
+
+  std::shared_ptr<HTTPRequest> request(new HTTPRequest());
+  bool complete;
+
+  try {
+    complete = readRequest(request.get());
+  } catch (RuntimeException e) {
+    return rejectRequest(kStatusBadRequest);
+  }
+
+  if (bodyTooLarge()) {
+    return rejectRequest(kStatusRequestEntityTooLarge);
+  }
+
+  if (!complete) {
+    if (peer_closed_) {
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  auto scheduled = server_->scheduleRequest(*request, [this, request] () {
+    handleRequest(request);
+  });
+
+  if (scheduled) {
+    state_ = S_HANDLING;
+    current_request_ = request;
+    return true;
+  }
+
+  /* the request was rejected by admission control */
+  HTTPResponse response;
+  response.populateFromRequest(*request);
+  response.setStatus(kStatusServiceUnavailable);
+  response.addBody("Service Unavailable");
+
+  if (!writeResponse(&response) || !request->keepalive()) {
+    close_after_flush_ = true;
+  }
+
+  return processRequests();
+}
+
+bool HTTPConnection::bodyTooLarge() const {
+  return
+      parser_.headerComplete() &&
+      parser_.contentLength() > server_->maxBodySize();
+}
+
+bool HTTPConnection::rejectRequest(const HTTPStatus& status) {
+  HTTPResponse response;
+  response.setVersion("HTTP/1.1");
+  response.setStatus(status);
+  response.addHeader("Connection", "close");
+  response.addBody(status.name);
+  writeResponse(&response);
+
+  close_after_flush_ = true;
+  return closeIfDone();
+}
+
+bool HTTPConnection::writeResponse(HTTPResponse* response) {
+  ResponseOutputStream output_stream(this);
+  HTTPOutputStream http_output_stream(&output_stream);
+
+  try {
+    response->writeToOutputStream(&http_output_stream);
+    std::lock_guard<std::mutex> lock_holder(write_mutex_);
+    flushWithLock();
+  } catch (const std::exception& e) {
+    /* the client is gone or the body writer failed, nothing to do */
+    return false;
+  }
+
+  return true;
+}
+
+bool HTTPConnection::readRequest(HTTPRequest* request) {
+  auto data = read_buf_.data() + read_pos_;
+  if (!parser_.parse(data, read_buf_.size() - read_pos_) || bodyTooLarge()) {
+    return false;
+  }
+
+  request->readFromParser(parser_, data);
+
+  /* pipelined requests that follow stay in the buffer */
+  read_pos_ += parser_.requestSize();
+  parser_.reset();
+
+  if (read_pos_ == read_buf_.size()) {
+    read_buf_.clear();
+    read_pos_ = 0;
+  }
+
+  return true;
+}
+
+void HTTPConnection::handleRequest(std::shared_ptr<HTTPRequest> request) {
+  HTTPResponse response;
+  response.populateFromRequest(*request);
+
+  bool keepalive = false;
+  bool failed = false;
+  try {
+    keepalive = server_->handleRequest(request.get(), &response);
+  } catch (...) {
+    failed = true;
+  }
+
+  if (failed) {
+    HTTPResponse error_response;
+    error_response.populateFromRequest(*request);
+    error_response.setStatus(kStatusInternalServerError);
+    error_response.addHeader("Connection", "close");
+    error_response.addBody("Internal Server Error");
+    writeResponse(&error_response);
+  } else if (!writeResponse(&response)) {
+    keepalive = false;
+  }
+
+  /* the connection must always be handed back to the loop, otherwise it is
+     never closed */
+  loop_->runOnLoop([this, keepalive] () {
+    if (!onRequestComplete(keepalive)) {
+      loop_->deleteConnection(this);
+    }
+  });
+}
+
+bool HTTPConnection::onRequestComplete(bool keepalive) {
+  state_ = S_IDLE;
+  current_request_.reset();
+
+  if (!keepalive) {
+    close_after_flush_ = true;
+  }
+
+  return processRequests();
+}
+
+bool HTTPConnection::closeIfDone() {
+  {
+    std::lock_guard<std::mutex> lock_holder(write_mutex_);
+    if (write_pos_ < write_buf_.size() && !write_error_) {
+      return true;
+    }
+  }
+
+  close();
+  return false;
+}
+
+void HTTPConnection::close() {
+  state_ = S_CLOSED;
+}
+
+void HTTPConnection::write(const char* data, size_t size) {
+  std::unique_lock<std::mutex> lk(write_mutex_);
+
+  if (write_error_) {
+    RAISE(kIOError, "write() failed: connection closed");
+  }
+
+  write_buf_.append(data, size);
+  if (write_buf_.size() - write_pos_ < kWriteBufferSize) {
+    return;
+  }
+
+  flushWithLock();
+
+  auto deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(static_cast<int64_t>(kWriteTimeoutMillis));
+
+  while (!write_error_ && write_buf_.size() - write_pos_ > kWriteHighWatermark) {
+    if (write_cv_.wait_until(lk, deadline) == std::cv_status::timeout) {
+      write_error_ = true;
+      write_buf_.clear();
+      write_pos_ = 0;
+    }
+  }
+
+  if (write_error_) {
+    RAISE(kIOError, "write() failed: connection closed");
+  }
+}
+
+void HTTPConnection::flushWithLock() {
+  while (write_pos_ < write_buf_.size()) {
+    auto bytes_written = ::send(
+        fd_,
+        write_buf_.data() + write_pos_,
+        write_buf_.size() - write_pos_,
+        MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (bytes_written >= 0) {
+      write_pos_ += bytes_written;
+      continue;
+    }
+
+    if (errno == EINTR) {
+      continue;
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      write_error_ = true;
+    }
+
+    break;
+  }
+
+  if (write_pos_ == write_buf_.size() || write_error_) {
+    write_buf_.clear();
+    write_pos_ = 0;
+  } else if (write_pos_ > write_buf_.size() / 2) {
+    write_buf_.erase(0, write_pos_);
+    write_pos_ = 0;
+  }
+}
+
+HTTPConnection::ResponseOutputStream::ResponseOutputStream(
+    HTTPConnection* conn) :
+    conn_(conn) {}
+
+size_t HTTPConnection::ResponseOutputStream::write(
+    const char* data,
+    size_t size) {
+  conn_->write(data, size);
+  return size;
+}
+
+}
+}
@@ -0,0 +1,129 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_HTTPCONNECTION_H
+#define _FNORDMETRIC_HTTPCONNECTION_H
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <fnordmetric/http/httpparser.h>
+#include <fnordmetric/http/httprequest.h>
+#include <fnordmetric/http/httpresponse.h>
+#include <fnordmetric/util/outputstream.h>
+
+namespace fnord {
+namespace http {
+class HTTPEventLoop;
+class HTTPServer;
+
+/**
+ * A non-blocking HTTP connection that is driven by a HTTPEventLoop.
+ *
+ * All reads happen on the event loop's thread: incoming bytes are appended to
+ * the read buffer and incrementally parsed in place by a HTTPParser until a
+ * complete request is available, which is then dispatched to the server's
+ * request handlers. Requests are handled one at a time, so pipelined requests
+ * are answered in order. If the client closes the connection while a request
+ * is being handled, the request is cancelled (see HTTPRequest::isCancelled).
+ * Requests with a body larger than the server's maximum body size are
+ * answered with 413 Request Entity Too Large before the body is buffered.
+ *
+ * The response is written from the handler thread with non-blocking writes of
+ * up to kWriteBufferSize bytes; whatever the socket doesn't accept is buffered
+ * and flushed by the event loop once the socket becomes writable again. If
+ * more than kWriteHighWatermark bytes are buffered, the handler thread blocks
+ * until the event loop has drained the buffer, so slow clients can't make a
+ * streaming response accumulate in memory. If the client doesn't read for
+ * kWriteTimeoutMillis, the write fails and the connection is closed, so a
+ * stalled client can't block the handler thread forever.
+ */
+class HTTPConnection {
+public:
+  static const size_t kMaxHeaderSize = 65536;
+  static const size_t kWriteBufferSize = 8192;
+  static const size_t kWriteHighWatermark = 1024 * 1024;
+  static const uint64_t kWriteTimeoutMillis = 30000;
+
+  /**
+   * @param fd a connected, non-blocking socket. The connection takes ownership
+   */
+  HTTPConnection(HTTPServer* server, HTTPEventLoop* loop, int fd);
+  ~HTTPConnection();
+
+  /**
+   * Called by the event loop when the socket became readable or writable.
+   * Returns false once the connection is closed and may be deleted.
+   */
+  bool onReadable();
+  bool onWritable();
+
+  int fd() const;
+
+protected:
+  enum kState {
+    S_IDLE,
+    S_HANDLING,
+    S_CLOSED
+  };
+
+  class ResponseOutputStream : public fnordmetric::util::OutputStream {
+  public:
+    ResponseOutputStream(HTTPConnection* conn);
+    size_t write(const char* data, size_t size) override;
+  protected:
+    HTTPConnection* conn_;
+  };
+
+  bool readRequest(HTTPRequest* request);
+  bool processRequests();
+
+  /**
+   * Returns true if the header of the current request announced a body that
+   * is larger than the server's maximum body size
+   */
+  bool bodyTooLarge() const;
+
+  /**
+   * Answer the current request with an error and close the connection
+   */
+  bool rejectRequest(const HTTPStatus& status);
+  void handleRequest(std::shared_ptr<HTTPRequest> request);
+
+  /**
+   * Write a response and flush as much as the socket accepts. Returns false
+   * on error
+   */
+  bool writeResponse(HTTPResponse* response);
+  bool onRequestComplete(bool keepalive);
+  bool closeIfDone();
+  void close();
+
+  void write(const char* data, size_t size);
+  void flushWithLock();
+
+  HTTPServer* server_;
+  HTTPEventLoop* loop_;
+  int fd_;
+  kState state_;
+  bool peer_closed_;
+  bool close_after_flush_;
+  std::string read_buf_;
+  size_t read_pos_;
+  HTTPParser parser_;
+  std::shared_ptr<HTTPRequest> current_request_;
+  std::mutex write_mutex_;
+  std::condition_variable write_cv_;
+  std::string write_buf_;
+  size_t write_pos_;
+  bool write_error_;
+};
+
+}
+}
+#endif
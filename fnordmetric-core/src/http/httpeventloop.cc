@@ -0,0 +1,259 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#if defined(__linux__)
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <fnordmetric/environment.h>
+#include <fnordmetric/http/httpconnection.h>
+#include <fnordmetric/http/httpeventloop.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnord {
+namespace http {
+
+/* marker pointers for the epoll data of the listen, wakeup and timer fds */
+static char kListenFdMarker;
+static char kWakeupFdMarker;
+static char kAcceptTimerFdMarker;
+
+HTTPEventLoop::HTTPEventLoop(
+    HTTPServer* server,
+    int listen_fd) :
+    server_(server),
+    listen_fd_(listen_fd) {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    RAISE_ERRNO(kIOError, "epoll_create1() failed");
+  }
+
+  wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd_ < 0) {
+    RAISE_ERRNO(kIOError, "eventfd() failed");
+  }
+
+  accept_timer_fd_ = timerfd_create(
+      CLOCK_MONOTONIC,
+      TFD_NONBLOCK | TFD_CLOEXEC);
+  if (accept_timer_fd_ < 0) {
+    RAISE_ERRNO(kIOError, "timerfd_create() failed");
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.ptr = &kWakeupFdMarker;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &ev) < 0) {
+    RAISE_ERRNO(kIOError, "epoll_ctl() failed");
+  }
+
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.ptr = &kAcceptTimerFdMarker;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, accept_timer_fd_, &ev) < 0) {
+    RAISE_ERRNO(kIOError, "epoll_ctl() failed");
+  }
+
+  /* the listen socket is shared by all event loops. with EPOLLEXCLUSIVE only
+     one of them is woken up per incoming connection */
+  ev.events = EPOLLIN | EPOLLET;
+#ifdef EPOLLEXCLUSIVE
+  ev.events |= EPOLLEXCLUSIVE;
+#endif
+  ev.data.ptr = &kListenFdMarker;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev) < 0) {
+    RAISE_ERRNO(kIOError, "epoll_ctl() failed");
+  }
+}
+
+HTTPEventLoop::~HTTPEventLoop() {
+  close(accept_timer_fd_);
+  close(wakeup_fd_);
+  close(epoll_fd_);
+}
+
+void HTTPEventLoop::run() {
+  struct epoll_event events[kMaxEventsPerPoll];
+
+  for (;;) {
+    auto num_events = epoll_wait(epoll_fd_, events, kMaxEventsPerPoll, -1);
+    if (num_events < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      RAISE_ERRNO(kIOError, "epoll_wait() failed");
+    }
+
+    for (int i = 0; i < num_events; ++i) {
+      auto ptr = events[i].data.ptr;
+
+      if (ptr == &kListenFdMarker) {
+        accept();
+        continue;
+      }
+
+      if (ptr == &kWakeupFdMarker) {
+        runPending();
+        continue;
+      }
+
+      if (ptr == &kAcceptTimerFdMarker) {
+        uint64_t expirations;
+        while (::read(accept_timer_fd_, &expirations, sizeof(expirations)) > 0);
+        accept();
+        continue;
+      }
+
+      auto conn = static_cast<HTTPConnection*>(ptr);
+      if (closed_.count(conn) > 0) {
+        continue;
+      }
+
+      auto ev = events[i].events;
+      bool open = true;
+
+      if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        open = conn->onReadable();
+      }
+
+      if (open && (ev & EPOLLOUT)) {
+        open = conn->onWritable();
+      }
+
+      if (!open) {
+        deleteConnection(conn);
+      }
+    }
+
+    /* connections are only deleted once all events of this round have been
+       dispatched, since a later event may still point to them */
+    for (auto conn : closed_) {
+      delete conn;
+    }
+
+    closed_.clear();
+  }
+}
+
+void HTTPEventLoop::runOnLoop(std::function<void()> fn) {
+  {
+    std::lock_guard<std::mutex> lock_holder(pending_mutex_);
+    pending_.emplace_back(fn);
+  }
+
+  uint64_t one = 1;
+  if (::write(wakeup_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    RAISE_ERRNO(kIOError, "write() failed");
+  }
+}
+
+void HTTPEventLoop::deleteConnection(HTTPConnection* conn) {
+  closed_.insert(conn);
+}
+
+void HTTPEventLoop::runPending() {
+  uint64_t val;
+  while (::read(wakeup_fd_, &val, sizeof(val)) > 0);
+
+  std::vector<std::function<void()>> pending;
+  {
+    std::lock_guard<std::mutex> lock_holder(pending_mutex_);
+    pending.swap(pending_);
+  }
+
+  for (const auto& fn : pending) {
+    fn();
+  }
+}
+
+void HTTPEventLoop::accept() {
+  for (;;) {
+    int fd = accept4(listen_fd_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0) {
+      switch (errno) {
+        case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+        case EWOULDBLOCK:
+#endif
+          return;
+        case EINTR:
+        case ECONNABORTED:
+          continue;
+        case EMFILE:
+        case ENFILE:
+        case ENOBUFS:
+        case ENOMEM:
+          fnordmetric::env()->logger()->printf(
+              "ERROR",
+              "HTTP server: accept() failed, retrying in %llums: %s",
+              (unsigned long long) kAcceptRetryMicros / 1000,
+              strerror(errno));
+          retryAcceptLater();
+          return;
+        default:
+          fnordmetric::env()->logger()->printf(
+              "ERROR",
+              "HTTP server: accept() failed: %s",
+              strerror(errno));
+          return;
+      }
+    }
+
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    if (fnordmetric::env()->verbose()) {
+      fnordmetric::env()->logger()->printf(
+          "DEBUG",
+          "New HTTP connection on fd %i",
+          fd);
+    }
+
+    auto conn = new HTTPConnection(server_, this, fd);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      /* a single connection must not bring down the event loop */
+      fnordmetric::env()->logger()->printf(
+          "ERROR",
+          "HTTP server: epoll_ctl() failed for fd %i: %s",
+          fd,
+          strerror(errno));
+
+      delete conn;
+    }
+  }
+}
+
+void HTTPEventLoop::retryAcceptLater() {
+  struct itimerspec timeout;
+  memset(&timeout, 0, sizeof(timeout));
+  timeout.it_value.tv_sec = kAcceptRetryMicros / 1000000;
+  timeout.it_value.tv_nsec = (kAcceptRetryMicros % 1000000) * 1000;
+
+  if (timerfd_settime(accept_timer_fd_, 0, &timeout, NULL) < 0) {
+    fnordmetric::env()->logger()->printf(
+        "ERROR",
+        "HTTP server: timerfd_settime() failed: %s",
+        strerror(errno));
+  }
+}
+
+}
+}
+#endif
@@ -0,0 +1,78 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_HTTPEVENTLOOP_H
+#define _FNORDMETRIC_HTTPEVENTLOOP_H
+#include <functional>
+#include <stdint.h>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace fnord {
+namespace http {
+class HTTPConnection;
+class HTTPServer;
+
+/**
+ * An edge-triggered epoll event loop that accepts connections from a shared,
+ * non-blocking listen socket and drives the resulting HTTPConnections. The
+ * HTTP server runs one event loop per core; a connection stays on the loop
+ * that accepted it.
+ *
+ * If accepting fails because the process ran out of file descriptors or
+ * memory, the event loop retries after kAcceptRetryMicros. Since the listen
+ * socket is edge-triggered, connections that are already in the backlog
+ * would otherwise not be accepted until the next connection arrives.
+ *
+ * The event loop is only available on Linux.
+ */
+class HTTPEventLoop {
+public:
+  static const int kMaxEventsPerPoll = 256;
+  static const uint64_t kAcceptRetryMicros = 100000;
+
+  HTTPEventLoop(HTTPServer* server, int listen_fd);
+  ~HTTPEventLoop();
+
+  /**
+   * Run the event loop on the calling thread. Never returns.
+   */
+  void run();
+
+  /**
+   * Run the provided function on the event loop's thread. This method is
+   * threadsafe.
+   */
+  void runOnLoop(std::function<void()> fn);
+
+  /**
+   * Delete a closed connection once all events of the current poll round have
+   * been dispatched. Must be called from the event loop's thread.
+   */
+  void deleteConnection(HTTPConnection* conn);
+
+protected:
+  void accept();
+  void retryAcceptLater();
+  void runPending();
+
+  HTTPServer* server_;
+  int listen_fd_;
+  int epoll_fd_;
+  int wakeup_fd_;
+  int accept_timer_fd_;
+  std::mutex pending_mutex_;
+  std::vector<std::function<void()>> pending_;
+  std::unordered_set<HTTPConnection*> closed_;
+};
+
+}
+}
+#endif
@@ -12,6 +12,7 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include <fnordmetric/http/httpparser.h>
 #include <fnordmetric/util/inputstream.h>
 
 using fnordmetric::util::InputStream;
@@ -19,16 +20,14 @@ using fnordmetric::util::InputStream;
 namespace fnord {
 namespace http {
 
+/**
+ * Reads a HTTP request header from a blocking InputStream. The header is
+ * buffered until the terminating empty line was read and then parsed in one
+ * pass by a HTTPParser. No bytes after the header are consumed, so the body
+ * can be read from the underlying input stream.
+ */
 class HTTPInputStream {
 public:
-  enum kParserState {
-    HTTP_STATE_METHOD,
-    HTTP_STATE_URI,
-    HTTP_STATE_VERSION,
-    HTTP_STATE_HKEY,
-    HTTP_STATE_HVAL,
-    HTTP_STATE_BODY
-  };
 
   /**
    * @param input_stream the input stream -- does not transfer ownership
@@ -52,12 +51,19 @@ public:
   void readHeaders(
       std::vector<std::pair<std::string, std::string>>* target);
 
+  /**
+   * Returns the value of the Content-Length header or zero. Only valid after
+   * the headers have been read
+   */
+  size_t getContentLength() const;
+
   InputStream* getInputStream() const;
 
 protected:
-  void readNextByte(std::string* target);
+  void readHeader();
   InputStream* input_;
-  kParserState state_;
+  std::string buf_;
+  HTTPParser parser_;
 };
 
 }
@@ -0,0 +1,206 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <strings.h>
+#include <fnordmetric/http/httpparser.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnord {
+namespace http {
+
+static const char kContentLengthHeader[] = "content-length";
+
+HTTPParser::HTTPParser(
+    size_t max_header_size) :
+    max_header_size_(max_header_size) {
+  reset();
+}
+
+void HTTPParser::reset() {
+  state_ = S_REQUEST_LINE;
+  line_start_ = 0;
+  header_size_ = 0;
+  content_length_ = 0;
+  method_ = Slice { 0, 0 };
+  url_ = Slice { 0, 0 };
+  version_ = Slice { 0, 0 };
+  headers_.clear();
+}
+
+bool HTTPParser::parse(const char* data, size_t size) {
+  while (state_ != S_BODY) {
+    auto line_end = static_cast<const char*>(
+        memchr(data + line_start_, '\n', size - line_start_));
+
+    if (line_end == nullptr) {
+      if (size > max_header_size_) {
+        RAISE(kRuntimeError, "HTTP request headers too large");
+      }
+
+      return false;
+    }
+
+    size_t begin = line_start_;
+    size_t end = static_cast<size_t>(line_end - data);
+    line_start_ = end + 1;
+
+    if (line_start_ > max_header_size_) {
+      RAISE(kRuntimeError, "HTTP request headers too large");
+    }
+
+    if (end > begin && data[end - 1] == '\r') {
+      end--;
+    }
+
+    switch (state_) {
+
+      case S_REQUEST_LINE:
+        /* ignore empty lines before the request line (RFC 7230 3.5) */
+        if (end > begin) {
+          parseRequestLine(data, begin, end);
+          state_ = S_HEADERS;
+        }
+        break;
+
+      case S_HEADERS:
+        if (end == begin) {
+          header_size_ = line_start_;
+          state_ = S_BODY;
+        } else {
+          parseHeaderLine(data, begin, end);
+        }
+        break;
+
+      default:
+        break;
+
+    }
+  }
+
+  return size >= requestSize();
+}
+
+void HTTPParser::parseRequestLine(
+    const char* data,
+    size_t begin,
+    size_t end) {
+  auto method_end = static_cast<const char*>(
+      memchr(data + begin, ' ', end - begin));
+
+  if (method_end == nullptr || method_end == data + begin) {
+    RAISE(kRuntimeError, "invalid HTTP request line");
+  }
+
+  method_ = Slice { begin, static_cast<size_t>(method_end - data) - begin };
+
+  size_t url_begin = static_cast<size_t>(method_end - data) + 1;
+  auto url_end = static_cast<const char*>(
+      memchr(data + url_begin, ' ', end - url_begin));
+
+  if (url_end == nullptr || url_end == data + url_begin) {
+    RAISE(kRuntimeError, "invalid HTTP request line");
+  }
+
+  url_ = Slice { url_begin, static_cast<size_t>(url_end - data) - url_begin };
+
+  size_t version_begin = static_cast<size_t>(url_end - data) + 1;
+  if (version_begin == end) {
+    RAISE(kRuntimeError, "invalid HTTP request line");
+  }
+
+  version_ = Slice { version_begin, end - version_begin };
+}
+
+void HTTPParser::parseHeaderLine(
+    const char* data,
+    size_t begin,
+    size_t end) {
+  auto colon = static_cast<const char*>(
+      memchr(data + begin, ':', end - begin));
+
+  if (colon == nullptr || colon == data + begin) {
+    RAISE(kRuntimeError, "invalid HTTP header");
+  }
+
+  size_t key_end = static_cast<size_t>(colon - data);
+  size_t value_begin = key_end + 1;
+  while (value_begin < end &&
+      (data[value_begin] == ' ' || data[value_begin] == '\t')) {
+    value_begin++;
+  }
+
+  size_t value_end = end;
+  while (value_end > value_begin &&
+      (data[value_end - 1] == ' ' || data[value_end - 1] == '\t')) {
+    value_end--;
+  }
+
+  Slice key { begin, key_end - begin };
+  Slice value { value_begin, value_end - value_begin };
+  headers_.emplace_back(key, value);
+
+  if (key.size == sizeof(kContentLengthHeader) - 1 &&
+      strncasecmp(data + begin, kContentLengthHeader, key.size) == 0) {
+    if (value.size == 0) {
+      RAISE(kRuntimeError, "invalid Content-Length header");
+    }
+
+    size_t content_length = 0;
+    for (size_t i = value_begin; i < value_end; ++i) {
+      if (data[i] < '0' || data[i] > '9' || content_length > (1ul << 48)) {
+        RAISE(kRuntimeError, "invalid Content-Length header");
+      }
+
+      content_length = content_length * 10 + (data[i] - '0');
+    }
+
+    content_length_ = content_length;
+  }
+}
+
+bool HTTPParser::headerComplete() const {
+  return state_ == S_BODY;
+}
+
+size_t HTTPParser::headerSize() const {
+  return header_size_;
+}
+
+size_t HTTPParser::contentLength() const {
+  return content_length_;
+}
+
+size_t HTTPParser::requestSize() const {
+  return header_size_ + content_length_;
+}
+
+const HTTPParser::Slice& HTTPParser::method() const {
+  return method_;
+}
+
+const HTTPParser::Slice& HTTPParser::url() const {
+  return url_;
+}
+
+const HTTPParser::Slice& HTTPParser::version() const {
+  return version_;
+}
+
+const std::vector<std::pair<HTTPParser::Slice, HTTPParser::Slice>>&
+    HTTPParser::headers() const {
+  return headers_;
+}
+
+std::string HTTPParser::toString(const char* data, const Slice& slice) {
+  return std::string(data + slice.offset, slice.size);
+}
+
+}
+}
@@ -0,0 +1,119 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_HTTPPARSER_H
+#define _FNORDMETRIC_HTTPPARSER_H
+#include <stdlib.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fnord {
+namespace http {
+
+/**
+ * An incremental HTTP request parser that works directly on a caller-owned
+ * read buffer.
+ *
+ * The parser scans the buffer for line delimiters with memchr and records the
+ * request line and headers as (offset, size) slices into the buffer instead of
+ * copying them. Slices are relative to the start of the request, so the
+ * caller may grow, move or compact the buffer between two calls to parse() as
+ * long as the request still starts at the passed pointer.
+ *
+ * A buffer may hold more than one (pipelined) request: requestSize() returns
+ * the number of bytes the current request occupies, the next request starts
+ * right after it. Call reset() before parsing the next request.
+ */
+class HTTPParser {
+public:
+  static const size_t kDefaultMaxHeaderSize = 65536;
+
+  struct Slice {
+    size_t offset;
+    size_t size;
+  };
+
+  /**
+   * @param max_header_size the maximum size of the request line and all
+   *   headers. Larger requests are rejected
+   */
+  HTTPParser(size_t max_header_size = kDefaultMaxHeaderSize);
+
+  /**
+   * Continue parsing the request at the beginning of data. Returns true once
+   * the request including its body is complete and false if more data is
+   * needed. Only bytes that were not seen by a previous call are scanned.
+   *
+   * Throws a RuntimeException for invalid requests or if the header is larger
+   * than max_header_size.
+   */
+  bool parse(const char* data, size_t size);
+
+  /**
+   * Reset the parser so it can parse the next request
+   */
+  void reset();
+
+  /**
+   * Returns true once the request line and all headers have been parsed
+   */
+  bool headerComplete() const;
+
+  /**
+   * The size of the request line and headers including the terminating empty
+   * line. Only valid once headerComplete() is true
+   */
+  size_t headerSize() const;
+
+  /**
+   * The value of the Content-Length header or zero
+   */
+  size_t contentLength() const;
+
+  /**
+   * The total size of the request (header and body). Only valid once
+   * headerComplete() is true
+   */
+  size_t requestSize() const;
+
+  const Slice& method() const;
+  const Slice& url() const;
+  const Slice& version() const;
+  const std::vector<std::pair<Slice, Slice>>& headers() const;
+
+  /**
+   * Copy a slice of the request at data into a string
+   */
+  static std::string toString(const char* data, const Slice& slice);
+
+protected:
+  enum kParserState {
+    S_REQUEST_LINE,
+    S_HEADERS,
+    S_BODY
+  };
+
+  void parseRequestLine(const char* data, size_t begin, size_t end);
+  void parseHeaderLine(const char* data, size_t begin, size_t end);
+
+  size_t max_header_size_;
+  kParserState state_;
+  size_t line_start_;
+  size_t header_size_;
+  size_t content_length_;
+  Slice method_;
+  Slice url_;
+  Slice version_;
+  std::vector<std::pair<Slice, Slice>> headers_;
+};
+
+}
+}
+#endif
@@ -7,19 +7,30 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <ctype.h>
 #include <fnordmetric/http/httprequest.h>
 #include <fnordmetric/http/httpinputstream.h>
+#include <fnordmetric/http/httpparser.h>
 
 namespace fnord {
 namespace http {
 
-HTTPRequest::HTTPRequest() {}
+HTTPRequest::HTTPRequest() : cancelled_(new std::atomic<bool>(false)) {}
 
 HTTPRequest::HTTPRequest(
     const std::string& method,
     const std::string& url) :
     method_(method),
-    url_(url) {}
+    url_(url),
+    cancelled_(new std::atomic<bool>(false)) {}
+
+bool HTTPRequest::isCancelled() const {
+  return cancelled_->load();
+}
+
+void HTTPRequest::cancel() {
+  *cancelled_ = true;
+}
 
 const std::string& HTTPRequest::getMethod() const {
   return method_;
@@ -58,20 +69,31 @@ void HTTPRequest::readFromInputStream(HTTPInputStream* input) {
   input->readStatusLine(&method_, &url_, &version_);
   input->readHeaders(&headers_);
 
-  const auto& content_length_header = getHeader("Content-Length");
-  int content_length = 0;
-  if (content_length_header.size() > 0) {
-    try {
-      content_length = std::stoi(content_length_header);
-    } catch (std::exception e){
-      /* invalid content length */
-    }
-  }
-
+  auto content_length = input->getContentLength();
   if (content_length > 0) {
     input->getInputStream()->readNextBytes(&body_, content_length);
   }
 }
 
+void HTTPRequest::readFromParser(const HTTPParser& parser, const char* data) {
+  method_.assign(data + parser.method().offset, parser.method().size);
+  url_.assign(data + parser.url().offset, parser.url().size);
+  version_.assign(data + parser.version().offset, parser.version().size);
+
+  headers_.clear();
+  headers_.reserve(parser.headers().size());
+  for (const auto& header : parser.headers()) {
+    headers_.emplace_back(
+        HTTPParser::toString(data, header.first),
+        HTTPParser::toString(data, header.second));
+
+    for (auto& c : headers_.back().first) {
+      c = tolower(c);
+    }
+  }
+
+  body_.assign(data + parser.headerSize(), parser.contentLength());
+}
+
 }
 }
@@ -10,11 +10,14 @@
 #ifndef _FNORDMETRIC_WEB_HTTPREQUEST_H
 #define _FNORDMETRIC_WEB_HTTPREQUEST_H
 #include <fnordmetric/http/httpmessage.h>
+#include <atomic>
+#include <memory>
 #include <string>
 
 namespace fnord {
 namespace http {
 class HTTPInputStream;
+class HTTPParser;
 
 class HTTPRequest : public HTTPMessage {
 public:
@@ -38,14 +41,29 @@ public:
 
   void readFromInputStream(HTTPInputStream* input);
 
+  /**
+   * Populate the request from a complete request that was parsed by the
+   * provided parser from the buffer at data
+   */
+  void readFromParser(const HTTPParser& parser, const char* data);
+
   const std::string& getMethod() const;
   kMethod method() const;
   const std::string& getUrl() const;
   const bool keepalive() const;
 
+  /**
+   * Returns true if the client closed the connection while the request was
+   * being handled, i.e. nobody is waiting for the response anymore. Copies of
+   * a request share the cancellation state. Threadsafe
+   */
+  bool isCancelled() const;
+  void cancel();
+
 protected:
   std::string method_;
   std::string url_;
+  std::shared_ptr<std::atomic<bool>> cancelled_;
 };
 
 }
@@ -7,6 +7,7 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <fnordmetric/http/httpchunkedoutputstream.h>
 #include <fnordmetric/http/httpresponse.h>
 #include <fnordmetric/http/httpoutputstream.h>
 
@@ -26,7 +27,28 @@ void HTTPResponse::setStatus(const HTTPStatus& status) {
   setStatus(status.code, status.name);
 }
 
+void HTTPResponse::setBodyWriter(BodyWriter body_writer) {
+  body_writer_ = body_writer;
+}
+
 void HTTPResponse::writeToOutputStream(HTTPOutputStream* output) {
+  if (body_writer_ && version_ == "HTTP/1.1") {
+    setHeader("Transfer-Encoding", "chunked");
+    output->writeStatusLine(version_, status_code_, status_);
+    output->writeHeaders(headers_);
+
+    std::shared_ptr<HTTPChunkedOutputStream> body(
+        new HTTPChunkedOutputStream(output->getOutputStream()));
+
+    body_writer_(body);
+    body->finish();
+    return;
+  }
+
+  if (body_writer_) {
+    body_writer_(std::shared_ptr<OutputStream>(getBodyOutputStream()));
+  }
+
   setHeader("Content-Length", std::to_string(body_.size()));
   output->writeStatusLine(version_, status_code_, status_);
   output->writeHeaders(headers_);
@@ -12,6 +12,8 @@
 #include <fnordmetric/http/httpmessage.h>
 #include <fnordmetric/http/httprequest.h>
 #include <fnordmetric/http/status.h>
+#include <functional>
+#include <memory>
 #include <string>
 
 namespace fnord {
@@ -20,11 +22,24 @@ class HTTPOutputStream;
 
 class HTTPResponse : public HTTPMessage {
 public:
+  typedef std::function<void (std::shared_ptr<OutputStream> body)> BodyWriter;
+
   HTTPResponse();
 
   void setStatus(int status_code, const std::string& status);
   void setStatus(const HTTPStatus& status);
 
+  /**
+   * Stream the response body instead of buffering it. The body writer is
+   * called from writeToOutputStream after the status line and headers have
+   * been sent and writes the body directly to the connection using the chunked
+   * transfer encoding, so the response size doesn't have to be known upfront.
+   *
+   * HTTP/1.0 clients don't understand the chunked encoding, so for them the
+   * body writer writes into the buffered body instead.
+   */
+  void setBodyWriter(BodyWriter body_writer);
+
   void writeToOutputStream(HTTPOutputStream* output);
   void populateFromRequest(const HTTPRequest& request);
 
@@ -33,6 +48,7 @@ public:
 protected:
   int status_code_;
   std::string status_;
+  BodyWriter body_writer_;
 };
 
 }
@@ -8,17 +8,22 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <fnordmetric/environment.h>
+#include <fnordmetric/http/httpconnection.h>
+#include <fnordmetric/http/httpeventloop.h>
 #include <fnordmetric/http/httpinputstream.h>
 #include <fnordmetric/http/httpoutputstream.h>
 #include <fnordmetric/http/httpserver.h>
 #include <fnordmetric/http/httprequest.h>
 #include <fnordmetric/http/httpresponse.h>
+#include <fnordmetric/stats/allocationscope.h>
 #include <fnordmetric/util/runtimeexception.h>
 #include <fnordmetric/util/wallclock.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <string.h>
+#include <thread>
 #include <unistd.h>
 
 using fnordmetric::util::FileInputStream;
@@ -28,17 +33,73 @@ using fnordmetric::util::RuntimeException;
 namespace fnord {
 namespace http {
 
+static size_t defaultMaxConcurrentRequests() {
+  size_t num_cores = std::thread::hardware_concurrency();
+  if (num_cores == 0) {
+    num_cores = 1;
+  }
+
+  return num_cores * HTTPServer::kMaxConcurrentRequestsPerCore;
+}
+
 HTTPServer::HTTPServer(
-    TaskScheduler* server_scheduler,
-    TaskScheduler* request_scheduler) :
-    server_scheduler_(server_scheduler),
-    request_scheduler_(request_scheduler) {}
+    TaskScheduler* request_scheduler,
+    size_t max_concurrent_requests /* = 0 */) :
+    request_scheduler_(request_scheduler),
+    request_admission_(
+        max_concurrent_requests > 0 ?
+            max_concurrent_requests :
+            defaultMaxConcurrentRequests()),
+    max_body_size_(kDefaultMaxBodySize),
+    requests_(fnordmetric::env()->stats()->counter("http.requests")),
+    requests_rejected_(
+        fnordmetric::env()->stats()->counter("http.requests_rejected")),
+    requests_failed_(
+        fnordmetric::env()->stats()->counter("http.requests_failed")),
+    request_micros_(
+        fnordmetric::env()->stats()->histogram("http.request_micros")) {}
 
+HTTPServer::~HTTPServer() {}
 
 void HTTPServer::addHandler(std::unique_ptr<HTTPHandler> handler) {
   handlers_.emplace_back(std::move(handler));
 }
 
+void HTTPServer::setMaxBodySize(size_t max_body_size) {
+  max_body_size_ = max_body_size;
+}
+
+size_t HTTPServer::maxBodySize() const {
+  return max_body_size_;
+}
+
+void HTTPServer::addRequestScheduler(
+    const std::string& url_prefix,
+    TaskScheduler* scheduler,
+    thread::AdmissionController* admission) {
+  auto route = new RequestRoute();
+  route->url_prefix = url_prefix;
+  route->any_method = true;
+  route->method = HTTPRequest::M_INVALID;
+  route->scheduler = scheduler;
+  route->admission = admission;
+  routes_.emplace_back(route);
+}
+
+void HTTPServer::addRequestScheduler(
+    const std::string& url_prefix,
+    HTTPRequest::kMethod method,
+    TaskScheduler* scheduler,
+    thread::AdmissionController* admission) {
+  auto route = new RequestRoute();
+  route->url_prefix = url_prefix;
+  route->any_method = false;
+  route->method = method;
+  route->scheduler = scheduler;
+  route->admission = admission;
+  routes_.emplace_back(route);
+}
+
 void HTTPServer::listen(int port) {
   ssock_ = socket(AF_INET, SOCK_STREAM, 0);
   if (ssock_ == 0) {
@@ -65,9 +126,111 @@ void HTTPServer::listen(int port) {
     return;
   }
 
+#if defined(__linux__)
+  if (fcntl(ssock_, F_SETFL, fcntl(ssock_, F_GETFL, 0) | O_NONBLOCK) < 0) {
+    RAISE_ERRNO(kIOError, "fcntl() failed");
+  }
+
+  size_t num_loops = std::thread::hardware_concurrency();
+  if (num_loops == 0) {
+    num_loops = 1;
+  }
+
+  for (int i = 0; i < num_loops; ++i) {
+    event_loops_.emplace_back(new HTTPEventLoop(this, ssock_));
+  }
+
+  for (int i = 1; i < num_loops; ++i) {
+    std::thread loop_thread(
+        std::bind(&HTTPEventLoop::run, event_loops_[i].get()));
+    loop_thread.detach();
+  }
+
+  event_loops_[0]->run();
+#else
   accept();
-  //server_scheduler_->run(
-  //    thread::Task::create(std::bind(&HTTPServer::accept, this)));
+#endif
+}
+
+bool HTTPServer::handleRequest(
+    HTTPRequest* request,
+    HTTPResponse* response) const {
+  fnord::stats::AllocationScope allocation_scope(
+      fnord::stats::AllocationStats::SUBSYSTEM_HTTP);
+
+  bool keepalive = request->keepalive();
+  bool handled = false;
+  bool failed = false;
+  auto request_start = fnord::util::WallClock::unixMicros();
+  requests_->incr();
+
+  try {
+    for (const auto& handler : handlers_) {
+      if (handler->handleHTTPRequest(request, response)) {
+        handled = true;
+        break;
+      }
+    }
+  } catch (RuntimeException e) {
+    e.debugPrint(); // FIXPAUL
+    failed = true;
+  } catch (const std::exception& e) {
+    fnordmetric::env()->logger()->printf(
+        "ERROR",
+        "HTTP request failed: %s",
+        e.what());
+    failed = true;
+  } catch (...) {
+    failed = true;
+  }
+
+  if (failed) {
+    requests_failed_->incr();
+    keepalive = false;
+    handled = true;
+    response->setStatus(kStatusInternalServerError);
+    response->setBodyWriter(nullptr);
+    response->addHeader("Connection", "close");
+    response->addBody("Internal Server Error");
+  }
+
+  if (!handled) {
+    response->setStatus(kStatusNotFound);
+    response->addBody("Not Found");
+  }
+
+  request_micros_->insert(
+      fnord::util::WallClock::unixMicros() - request_start);
+
+  return keepalive;
+}
+
+bool HTTPServer::scheduleRequest(
+    const HTTPRequest& request,
+    std::function<void()> task) {
+  const auto& url = request.getUrl();
+
+  bool scheduled = false;
+  bool routed = false;
+
+  for (const auto& route : routes_) {
+    if (url.compare(0, route->url_prefix.size(), route->url_prefix) == 0 &&
+        (route->any_method || request.method() == route->method)) {
+      scheduled = route->admission->run(route->scheduler, task);
+      routed = true;
+      break;
+    }
+  }
+
+  if (!routed) {
+    scheduled = request_admission_.run(request_scheduler_, task);
+  }
+
+  if (!scheduled) {
+    requests_rejected_->incr();
+  }
+
+  return scheduled;
 }
 
 void HTTPServer::accept() {
@@ -105,12 +268,8 @@ void HTTPServer::handleConnection(int fd) const {
     try {
       HTTPInputStream http_input_stream(&input_stream);
       request.readFromInputStream(&http_input_stream);
-
-      if (request.keepalive()) {
-        keepalive = true;
-      }
-
       response.populateFromRequest(request);
+      keepalive = handleRequest(&request, &response);
     } catch (RuntimeException e) {
       keepalive = false;
       response.setStatus(kStatusNotFound);
@@ -119,27 +278,6 @@ void HTTPServer::handleConnection(int fd) const {
       e.debugPrint(); // FIXPAUL
     }
 
-    bool handled = false;
-    try {
-      for (const auto& handler : handlers_) {
-        if (handler->handleHTTPRequest(&request, &response)) {
-          handled = true;
-          break;
-        }
-      }
-    } catch (RuntimeException e) {
-      keepalive = false;
-      response.setStatus(kStatusInternalServerError);
-      response.addHeader("Connection", "close");
-      response.addBody("Internal Server Error");
-      e.debugPrint(); // FIXPAUL
-    }
-
-    if (!handled) {
-      response.setStatus(kStatusNotFound);
-      response.addBody("Not Found");
-    }
-
     HTTPOutputStream http_output_stream(&output_stream);
     response.writeToOutputStream(&http_output_stream);
   } while (keepalive);
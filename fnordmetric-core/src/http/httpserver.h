@@ -9,33 +9,137 @@
  */
 #ifndef _FNORDMETRIC_WEB_HTTPSERVER_H
 #define _FNORDMETRIC_WEB_HTTPSERVER_H
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <fnordmetric/http/httprequest.h>
 #include <fnordmetric/http/httphandler.h>
+#include <fnordmetric/http/httpresponse.h>
+#include <fnordmetric/stats/counter.h>
+#include <fnordmetric/stats/histogram.h>
+#include <fnordmetric/thread/admissioncontroller.h>
 #include <fnordmetric/thread/taskscheduler.h>
 
 namespace fnord {
 namespace http {
+class HTTPConnection;
+class HTTPEventLoop;
 
 using fnord::thread::TaskScheduler;
 
+/**
+ * An event driven HTTP/1.1 server. On Linux, the server runs one edge
+ * triggered epoll event loop per core that does all network I/O without
+ * blocking; only complete requests are handed to the request scheduler. At
+ * most max_concurrent_requests requests are handled at the same time, the
+ * remaining requests are queued until a handler becomes available, so idle
+ * keep-alive connections don't occupy any threads.
+ *
+ * Requests can be routed to separate schedulers by URL prefix (e.g. to run
+ * queries on a dedicated query executor), each with its own concurrency limit
+ * and queue. Requests that exceed the queue are rejected with 503.
+ *
+ * The event loops run on dedicated threads, since they never return and the
+ * request scheduler's threads should only be busy while a request is handled.
+ *
+ * On other platforms each connection is handled by a blocking task on the
+ * request scheduler.
+ */
 class HTTPServer {
 public:
+  static const size_t kMaxConcurrentRequestsPerCore = 4;
+  static const size_t kDefaultMaxBodySize = 64 * 1024 * 1024;
+
+  /**
+   * @param request_scheduler runs the request handlers
+   * @param max_concurrent_requests the maximum number of requests that are
+   * handled at the same time. defaults to kMaxConcurrentRequestsPerCore
+   * requests per core
+   */
   HTTPServer(
-      TaskScheduler* server_scheduler,
-      TaskScheduler* request_scheduler);
+      TaskScheduler* request_scheduler,
+      size_t max_concurrent_requests = 0);
+
+  ~HTTPServer();
 
   void addHandler(std::unique_ptr<HTTPHandler> handler);
+
+  /**
+   * Requests with a larger body are rejected with 413 Request Entity Too
+   * Large. Defaults to kDefaultMaxBodySize
+   */
+  void setMaxBodySize(size_t max_body_size);
+  size_t maxBodySize() const;
+
+  /**
+   * Handle requests whose URL starts with url_prefix on the provided
+   * scheduler instead of the default request scheduler. The admission
+   * controller limits how many of these requests are handled and queued at
+   * the same time, requests it rejects are answered with 503 Service
+   * Unavailable. Does not transfer ownership.
+   */
+  void addRequestScheduler(
+      const std::string& url_prefix,
+      TaskScheduler* scheduler,
+      thread::AdmissionController* admission);
+
+  /**
+   * Like addRequestScheduler above, but only routes requests with the
+   * provided method, e.g. to handle reads and writes of the same URL on
+   * different schedulers
+   */
+  void addRequestScheduler(
+      const std::string& url_prefix,
+      HTTPRequest::kMethod method,
+      TaskScheduler* scheduler,
+      thread::AdmissionController* admission);
+
+  /**
+   * Start listening on the provided port and run the first event loop on the
+   * calling thread. Never returns.
+   */
   void listen(int port);
 
 protected:
+  friend class HTTPConnection;
+
+  /**
+   * Run the request handlers for the request. Returns false if the connection
+   * should be closed after the response has been sent.
+   */
+  bool handleRequest(HTTPRequest* request, HTTPResponse* response) const;
+
+  struct RequestRoute {
+    std::string url_prefix;
+    bool any_method;
+    HTTPRequest::kMethod method;
+    TaskScheduler* scheduler;
+    thread::AdmissionController* admission;
+  };
+
+  /**
+   * Run the provided request task on the request's scheduler once a slot is
+   * available. Returns false if the request was rejected.
+   */
+  bool scheduleRequest(
+      const HTTPRequest& request,
+      std::function<void()> task);
+
   void accept();
   void handleConnection(int fd) const;
+
   std::vector<std::unique_ptr<HTTPHandler>> handlers_;
-  TaskScheduler* server_scheduler_;
   TaskScheduler* request_scheduler_;
+  thread::AdmissionController request_admission_;
+  std::vector<std::unique_ptr<RequestRoute>> routes_;
+  std::vector<std::unique_ptr<HTTPEventLoop>> event_loops_;
   int ssock_;
+  size_t max_body_size_;
+  stats::Counter* requests_;
+  stats::Counter* requests_rejected_;
+  stats::Counter* requests_failed_;
+  stats::Histogram* request_micros_;
 };
 
 }
@@ -0,0 +1,224 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <fnordmetric/http/httphandler.h>
+#include <fnordmetric/http/httpserver.h>
+#include <fnordmetric/thread/threadpool.h>
+#include <fnordmetric/util/benchmark.h>
+#include <fnordmetric/util/runtimeexception.h>
+#include <fnordmetric/util/signalhandler.h>
+
+/**
+ * Request latency of the HTTP server on a single keep-alive connection and
+ * the throughput with many concurrent keep-alive connections. Every
+ * iteration sends one GET request on each connection of the case and waits
+ * until all responses were received
+ */
+BENCHMARK_SUITE(HTTPServerBenchmark);
+
+static const int kPort = 18080;
+static const int kNumConnections = 256;
+
+class PongHandler : public fnord::http::HTTPHandler {
+public:
+  bool handleHTTPRequest(
+      fnord::http::HTTPRequest* request,
+      fnord::http::HTTPResponse* response) override {
+    response->setStatus(fnord::http::kStatusOK);
+    response->addBody("pong");
+    return true;
+  }
+};
+
+struct BenchmarkConnection {
+  int fd;
+  bool pending;
+  std::string buf;
+};
+
+static const char kRequest[] =
+    "GET /ping HTTP/1.1\r\n" \
+    "Host: localhost\r\n" \
+    "\r\n";
+
+/**
+ * Returns the size of the first complete response in the buffer or 0
+ */
+static size_t responseSize(const std::string& buf) {
+  auto header_end = buf.find("\r\n\r\n");
+  if (header_end == std::string::npos) {
+    return 0;
+  }
+
+  size_t content_length = 0;
+  auto cl = buf.find("content-length: ");
+  if (cl != std::string::npos && cl < header_end) {
+    content_length = std::stoul(buf.substr(cl + 16, header_end - cl - 16));
+  }
+
+  auto size = header_end + 4 + content_length;
+  return buf.size() >= size ? size : 0;
+}
+
+static int connectTo(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    RAISE_ERRNO(kIOError, "socket() failed");
+  }
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  for (int attempt = 0; ; ++attempt) {
+    if (::connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+      break;
+    }
+
+    if (attempt > 100) {
+      RAISE_ERRNO(kIOError, "connect() failed");
+    }
+
+    usleep(10000);
+  }
+
+  int opt = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  return fd;
+}
+
+/**
+ * A set of keep-alive connections that are registered with one epoll fd
+ */
+class ConnectionGroup {
+public:
+
+  void connect(int num_connections) {
+    epoll_fd_ = epoll_create1(0);
+    if (epoll_fd_ < 0) {
+      RAISE_ERRNO(kIOError, "epoll_create1() failed");
+    }
+
+    conns_.resize(num_connections);
+    for (auto& conn : conns_) {
+      conn.fd = connectTo(kPort);
+      conn.pending = false;
+
+      struct epoll_event ev;
+      ev.events = EPOLLIN | EPOLLET;
+      ev.data.ptr = &conn;
+      epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, conn.fd, &ev);
+    }
+  }
+
+  /**
+   * Send one request on every connection and wait for all responses
+   */
+  void roundTrip() {
+    for (auto& conn : conns_) {
+      if (write(conn.fd, kRequest, sizeof(kRequest) - 1) < 0) {
+        RAISE_ERRNO(kIOError, "write() failed");
+      }
+
+      conn.pending = true;
+    }
+
+    struct epoll_event events[256];
+    char buf[4096];
+    size_t num_pending = conns_.size();
+
+    while (num_pending > 0) {
+      auto num_events = epoll_wait(epoll_fd_, events, 256, 1000);
+      if (num_events < 0 && errno != EINTR) {
+        RAISE_ERRNO(kIOError, "epoll_wait() failed");
+      }
+
+      for (int i = 0; i < num_events; ++i) {
+        auto conn = static_cast<BenchmarkConnection*>(events[i].data.ptr);
+
+        for (;;) {
+          auto bytes_read = read(conn->fd, buf, sizeof(buf));
+          if (bytes_read == 0) {
+            RAISE(kIOError, "connection closed by the server");
+          }
+
+          if (bytes_read < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+              RAISE_ERRNO(kIOError, "read() failed");
+            }
+
+            break;
+          }
+
+          conn->buf.append(buf, bytes_read);
+        }
+
+        size_t size = responseSize(conn->buf);
+        if (size > 0 && conn->pending) {
+          conn->buf.erase(0, size);
+          conn->pending = false;
+          num_pending--;
+        }
+      }
+    }
+  }
+
+protected:
+  int epoll_fd_;
+  std::vector<BenchmarkConnection> conns_;
+};
+
+static ConnectionGroup single_connection;
+static ConnectionGroup many_connections;
+
+BENCHMARK_INITIALIZER(HTTPServerBenchmark, StartServer, [] () {
+  fnordmetric::util::SignalHandler::ignoreSIGPIPE();
+
+  /* the server never shuts down, so the pool is intentionally leaked */
+  auto request_pool = new fnord::thread::ThreadPool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler("crashed")));
+
+  auto http_server = new fnord::http::HTTPServer(request_pool);
+  http_server->addHandler(
+      std::unique_ptr<fnord::http::HTTPHandler>(new PongHandler()));
+
+  std::thread server_thread([http_server] () {
+    http_server->listen(kPort);
+  });
+  server_thread.detach();
+
+  single_connection.connect(1);
+  many_connections.connect(kNumConnections);
+});
+
+BENCHMARK_CASE(HTTPServerBenchmark, RequestLatency, 1, [] () {
+  single_connection.roundTrip();
+});
+
+BENCHMARK_CASE(
+    HTTPServerBenchmark,
+    ConcurrentRequests,
+    kNumConnections,
+    [] () {
+  many_connections.roundTrip();
+});
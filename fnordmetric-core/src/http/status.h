@@ -21,11 +21,15 @@ struct HTTPStatus {
 
 const HTTPStatus kStatusOK(200, "OK");
 const HTTPStatus kStatusCreated(201, "Created");
-const HTTPStatus kStatusBadRequest(404, "Bad request");
+const HTTPStatus kStatusBadRequest(400, "Bad Request");
 const HTTPStatus kStatusNotFound(404, "Not found");
 const HTTPStatus kStatusMovedPermanently(301, "Moved permanently");
 const HTTPStatus kStatusFound(302, "Found");
+const HTTPStatus kStatusRequestEntityTooLarge(
+    413,
+    "Request Entity Too Large");
 const HTTPStatus kStatusInternalServerError(500, "InternalServerError");
+const HTTPStatus kStatusServiceUnavailable(503, "Service Unavailable");
 
 }
 }
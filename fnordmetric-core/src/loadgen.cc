@@ -0,0 +1,858 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <ctype.h>
+#include <errno.h>
+#include <fstream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <fnordmetric/cli/flagparser.h>
+#include <fnordmetric/environment.h>
+#include <fnordmetric/util/outputstream.h>
+#include <fnordmetric/util/runtimeexception.h>
+#include <fnordmetric/util/signalhandler.h>
+#include <fnordmetric/util/wallclock.h>
+
+/**
+ * Drives a running fnordmetric-server on localhost with synthetic or replayed
+ * samples while concurrently issuing ChartSQL queries, and reports the ingest
+ * loss and the query latency percentiles.
+ *
+ * Samples and queries are scheduled open-loop: the n-th sample is due at
+ * start + n / rate regardless of how long the previous sends took, and query
+ * latencies are measured from the time a query was due, not from the time it
+ * was sent. A slow server therefore shows up as high latency instead of a
+ * silently reduced request rate.
+ *
+ * The replay file contains one statsd datagram per line, optionally prefixed
+ * with its capture time in microseconds since epoch:
+ *
+ *   1414141414000000 http.requests[host=web01]:1
+ *   1414141414000250 http.latency[host=web01]:23.5
+ *
+ * Timestamped lines are replayed at their original spacing divided by
+ * --speed, other lines at --rate times --speed.
+ *
+ *   $ fnordmetric-loadgen --metrics 100 --label_cardinality 1000 --rate 50000
+ *   $ fnordmetric-loadgen --replay_file capture.txt --speed 10
+ */
+using namespace fnordmetric;
+using fnord::util::WallClock;
+
+static const char kDefaultQuery[] =
+    "SELECT host, count(value), mean(value) "
+    "FROM loadgen_metric_0 GROUP BY host;";
+
+struct IngestStats {
+  IngestStats() : samples_sent(0), send_errors(0), max_lag_micros(0) {}
+  std::atomic<uint64_t> samples_sent;
+  std::atomic<uint64_t> send_errors;
+  std::atomic<uint64_t> max_lag_micros;
+};
+
+struct QueryStats {
+  QueryStats() : num_errors(0) {}
+  std::atomic<uint64_t> num_errors;
+  std::vector<std::vector<uint64_t>> latencies;
+};
+
+static void sleepUntil(uint64_t due) {
+  auto now = WallClock::unixMicros();
+  if (due > now) {
+    usleep(due - now);
+  }
+}
+
+static void recordLag(IngestStats* stats, uint64_t due) {
+  auto now = WallClock::unixMicros();
+  if (now <= due) {
+    return;
+  }
+
+  auto lag = now - due;
+  auto max_lag = stats->max_lag_micros.load();
+  while (lag > max_lag &&
+      !stats->max_lag_micros.compare_exchange_weak(max_lag, lag));
+}
+
+static int connectTo(int port, int type) {
+  int fd = socket(AF_INET, type, 0);
+  if (fd < 0) {
+    RAISE_ERRNO(kIOError, "socket() failed");
+  }
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  if (::connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    close(fd);
+    RAISE_ERRNO(kIOError, "connect() to localhost:%i failed", port);
+  }
+
+  if (type == SOCK_STREAM) {
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+  }
+
+  return fd;
+}
+
+/**
+ * Returns true once the buffer contains a complete response, either framed
+ * by a content-length header or by the terminating chunk of a chunked body
+ */
+static bool responseComplete(const std::string& buf) {
+  auto header_end = buf.find("\r\n\r\n");
+  if (header_end == std::string::npos) {
+    return false;
+  }
+
+  auto headers = buf.substr(0, header_end);
+  std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+
+  if (headers.find("transfer-encoding: chunked") != std::string::npos) {
+    return
+        buf.size() >= header_end + 9 &&
+        buf.compare(buf.size() - 5, 5, "0\r\n\r\n") == 0;
+  }
+
+  size_t content_length = 0;
+  auto cl = headers.find("content-length: ");
+  if (cl != std::string::npos) {
+    content_length = std::stoul(headers.substr(cl + 16));
+  }
+
+  return buf.size() >= header_end + 4 + content_length;
+}
+
+/**
+ * Sends a single request on a new connection and waits for the complete
+ * response. Returns the HTTP status code or 0 if the request failed
+ */
+static int httpRequest(
+    int port,
+    const char* method,
+    const std::string& path,
+    const std::string& body,
+    std::string* response = nullptr) {
+  int fd;
+  try {
+    fd = connectTo(port, SOCK_STREAM);
+  } catch (const util::RuntimeException& e) {
+    return 0;
+  }
+
+  std::string request;
+  request.append(method);
+  request.append(" ");
+  request.append(path);
+  request.append(" HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n");
+  request.append("Content-Length: " + std::to_string(body.size()) + "\r\n");
+  request.append("\r\n");
+  request.append(body);
+
+  for (size_t pos = 0; pos < request.size(); ) {
+    auto bytes_written = write(fd, request.data() + pos, request.size() - pos);
+    if (bytes_written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      close(fd);
+      return 0;
+    }
+
+    pos += bytes_written;
+  }
+
+  std::string buf;
+  char chunk[4096];
+  for (;;) {
+    auto bytes_read = read(fd, chunk, sizeof(chunk));
+    if (bytes_read < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (bytes_read <= 0) {
+      break;
+    }
+
+    buf.append(chunk, bytes_read);
+    if (responseComplete(buf)) {
+      break;
+    }
+  }
+
+  close(fd);
+
+  /* HTTP/1.1 200 OK */
+  if (buf.size() < 12 || buf.compare(0, 5, "HTTP/") != 0) {
+    return 0;
+  }
+
+  if (response != nullptr) {
+    auto header_end = buf.find("\r\n\r\n");
+    if (header_end != std::string::npos) {
+      *response = buf.substr(header_end + 4);
+    }
+  }
+
+  return atoi(buf.c_str() + 9);
+}
+
+struct IngestCounters {
+  int64_t samples_received;
+  int64_t samples_dropped;
+  int64_t datagrams_dropped;
+};
+
+static int64_t readCounter(const std::string& stats, const char* name) {
+  auto key = std::string("\"") + name + "\":";
+  auto pos = stats.find(key);
+  if (pos == std::string::npos) {
+    return 0;
+  }
+
+  return std::stoll(stats.substr(pos + key.size()));
+}
+
+/**
+ * Fetches the statsd ingest counters from GET /stats. Every statsd sample the
+ * server parsed is counted in statsd.samples_received, whether it was
+ * inserted directly or added to the aggregator, so the counters also account
+ * for samples that are flushed as one aggregate per series. Returns false if
+ * the stats could not be fetched
+ */
+static bool fetchIngestCounters(int http_port, IngestCounters* counters) {
+  std::string stats;
+  if (httpRequest(http_port, "GET", "/stats", "", &stats) != 200) {
+    return false;
+  }
+
+  counters->samples_received = readCounter(stats, "statsd.samples_received");
+  counters->samples_dropped = readCounter(stats, "statsd.samples_dropped");
+  counters->datagrams_dropped = readCounter(stats, "udp.datagrams_dropped");
+  return true;
+}
+
+/**
+ * Generates samples for --metrics metrics named loadgen_metric_<n>, each with
+ * a "host" label that takes --label_cardinality distinct values
+ */
+class SampleGenerator {
+public:
+  SampleGenerator(
+      int num_metrics,
+      int label_cardinality,
+      unsigned seed) :
+      metric_dist_(0, std::max(num_metrics, 1) - 1),
+      label_dist_(0, std::max(label_cardinality, 1) - 1),
+      value_dist_(0, 1000),
+      rand_(seed) {}
+
+  void next(std::string* metric, std::string* host, double* value) {
+    *metric = "loadgen_metric_" + std::to_string(metric_dist_(rand_));
+    *host = "host" + std::to_string(label_dist_(rand_));
+    *value = value_dist_(rand_);
+  }
+
+protected:
+  std::uniform_int_distribution<int> metric_dist_;
+  std::uniform_int_distribution<int> label_dist_;
+  std::uniform_real_distribution<double> value_dist_;
+  std::mt19937 rand_;
+};
+
+static void runSyntheticIngest(
+    int thread_id,
+    int num_threads,
+    bool use_http,
+    int port,
+    uint64_t start,
+    uint64_t end,
+    double rate,
+    IngestStats* stats) {
+  SampleGenerator generator(
+      env()->flags()->getInt("metrics"),
+      env()->flags()->getInt("label_cardinality"),
+      thread_id);
+
+  int udp_fd = use_http ? -1 : connectTo(port, SOCK_DGRAM);
+  std::string metric;
+  std::string host;
+  double value;
+  char buf[512];
+
+  for (uint64_t n = thread_id; ; n += num_threads) {
+    auto due = start + static_cast<uint64_t>(n * 1000000.0 / rate);
+    if (due >= end) {
+      break;
+    }
+
+    sleepUntil(due);
+    recordLag(stats, due);
+    generator.next(&metric, &host, &value);
+
+    bool success;
+    if (use_http) {
+      auto len = snprintf(
+          buf,
+          sizeof(buf),
+          "metric=%s&value=%f&label[host]=%s",
+          metric.c_str(),
+          value,
+          host.c_str());
+
+      success = httpRequest(
+          port,
+          "POST",
+          "/metrics",
+          std::string(buf, len)) == 201;
+    } else {
+      auto len = snprintf(
+          buf,
+          sizeof(buf),
+          "%s[host=%s]:%f",
+          metric.c_str(),
+          host.c_str(),
+          value);
+
+      success = send(udp_fd, buf, len, 0) == len;
+    }
+
+    if (success) {
+      stats->samples_sent++;
+    } else {
+      stats->send_errors++;
+    }
+  }
+
+  if (udp_fd >= 0) {
+    close(udp_fd);
+  }
+}
+
+struct ReplayDatagram {
+  uint64_t due;
+  std::string data;
+};
+
+/**
+ * Reads the replay file and computes the offset from the replay start at
+ * which every datagram is due
+ */
+static std::vector<ReplayDatagram> loadReplayFile(
+    const std::string& path,
+    double rate,
+    double speed) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    RAISE(kIOError, "could not open replay file: %s", path.c_str());
+  }
+
+  std::vector<ReplayDatagram> datagrams;
+  uint64_t first_timestamp = 0;
+  uint64_t num_untimed = 0;
+  std::string line;
+
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+
+    auto space = line.find(' ');
+    bool timestamped =
+        space != std::string::npos &&
+        space > 0 &&
+        line.find_first_not_of("0123456789") == space;
+
+    ReplayDatagram datagram;
+    if (timestamped) {
+      auto timestamp = std::stoull(line.substr(0, space));
+      if (first_timestamp == 0) {
+        first_timestamp = timestamp;
+      }
+
+      datagram.due = timestamp < first_timestamp ? 0 :
+          static_cast<uint64_t>((timestamp - first_timestamp) / speed);
+      datagram.data = line.substr(space + 1);
+    } else {
+      datagram.due = static_cast<uint64_t>(
+          num_untimed++ * 1000000.0 / (rate * speed));
+      datagram.data = line;
+    }
+
+    datagrams.emplace_back(datagram);
+  }
+
+  return datagrams;
+}
+
+static void runReplay(
+    const std::vector<ReplayDatagram>& datagrams,
+    int port,
+    uint64_t start,
+    IngestStats* stats) {
+  int udp_fd = connectTo(port, SOCK_DGRAM);
+
+  for (const auto& datagram : datagrams) {
+    auto due = start + datagram.due;
+    sleepUntil(due);
+    recordLag(stats, due);
+
+    auto data = datagram.data.data();
+    auto size = datagram.data.size();
+    if (send(udp_fd, data, size, 0) == size) {
+      /* a datagram may contain more than one newline separated sample */
+      stats->samples_sent += 1 + std::count(data, data + size, '\n');
+    } else {
+      stats->send_errors++;
+    }
+  }
+
+  close(udp_fd);
+}
+
+static void runQueries(
+    int thread_id,
+    const std::vector<std::string>& queries,
+    int port,
+    uint64_t start,
+    uint64_t end,
+    double rate,
+    std::atomic<uint64_t>* next_query,
+    QueryStats* stats) {
+  auto& latencies = stats->latencies[thread_id];
+
+  for (;;) {
+    auto n = (*next_query)++;
+    auto due = start + static_cast<uint64_t>(n * 1000000.0 / rate);
+    if (due >= end) {
+      break;
+    }
+
+    sleepUntil(due);
+
+    auto status = httpRequest(
+        port,
+        "POST",
+        "/query",
+        queries[n % queries.size()]);
+
+    if (status == 200) {
+      latencies.emplace_back(WallClock::unixMicros() - due);
+    } else {
+      stats->num_errors++;
+    }
+  }
+}
+
+static std::vector<std::string> loadQueries() {
+  std::vector<std::string> queries;
+
+  if (!env()->flags()->isSet("query_file")) {
+    queries.emplace_back(kDefaultQuery);
+    return queries;
+  }
+
+  auto path = env()->flags()->getString("query_file");
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    RAISE(kIOError, "could not open query file: %s", path.c_str());
+  }
+
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty() && line[0] != '#') {
+      queries.emplace_back(line);
+    }
+  }
+
+  if (queries.size() == 0) {
+    RAISE(kUsageError, "query file contains no queries: %s", path.c_str());
+  }
+
+  return queries;
+}
+
+static int runLoadgen() {
+  auto http_port = env()->flags()->getInt("http_port");
+  auto statsd_port = env()->flags()->getInt("statsd_port");
+  auto transport = env()->flags()->getString("transport");
+  auto rate = env()->flags()->getFloat("rate");
+  auto speed = env()->flags()->getFloat("speed");
+  auto query_rate = env()->flags()->getFloat("query_rate");
+  auto num_ingest_threads = env()->flags()->getInt("ingest_threads");
+  auto num_query_threads = env()->flags()->getInt("query_threads");
+  auto duration = env()->flags()->getInt("duration") * 1000000;
+
+  if (transport != "statsd" && transport != "http") {
+    RAISE(kUsageError, "invalid transport: %s", transport.c_str());
+  }
+
+  if (rate <= 0 || speed <= 0) {
+    RAISE(kUsageError, "--rate and --speed must be greater than zero");
+  }
+
+  if (num_ingest_threads < 1 || num_query_threads < 1) {
+    RAISE(kUsageError, "need at least one ingest and one query thread");
+  }
+
+  std::vector<ReplayDatagram> datagrams;
+  bool replay = env()->flags()->isSet("replay_file");
+  if (replay) {
+    datagrams = loadReplayFile(
+        env()->flags()->getString("replay_file"),
+        rate,
+        speed);
+
+    duration = datagrams.size() > 0 ? datagrams.back().due : 0;
+  }
+
+  auto queries = loadQueries();
+  /* samples sent over HTTP are acknowledged, failures are send errors */
+  bool measure_loss = replay || transport != "http";
+  IngestCounters counters_before;
+  if (measure_loss && !fetchIngestCounters(http_port, &counters_before)) {
+    fprintf(
+        stderr,
+        "warning: GET /stats on localhost:%i failed, can't measure the "
+        "ingest loss\n",
+        (int) http_port);
+
+    measure_loss = false;
+  }
+
+  IngestStats ingest_stats;
+  QueryStats query_stats;
+  query_stats.latencies.resize(num_query_threads);
+  std::atomic<uint64_t> next_query(0);
+  std::vector<std::thread> threads;
+
+  auto start = WallClock::unixMicros();
+  auto end = start + duration;
+
+  if (replay) {
+    threads.emplace_back(
+        runReplay,
+        std::cref(datagrams),
+        statsd_port,
+        start,
+        &ingest_stats);
+  } else {
+    for (int i = 0; i < num_ingest_threads; ++i) {
+      threads.emplace_back(
+          runSyntheticIngest,
+          i,
+          num_ingest_threads,
+          transport == "http",
+          transport == "http" ? http_port : statsd_port,
+          start,
+          end,
+          rate,
+          &ingest_stats);
+    }
+  }
+
+  if (query_rate > 0) {
+    for (int i = 0; i < num_query_threads; ++i) {
+      threads.emplace_back(
+          runQueries,
+          i,
+          std::cref(queries),
+          http_port,
+          start,
+          end,
+          query_rate,
+          &next_query,
+          &query_stats);
+    }
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto elapsed = WallClock::unixMicros() - start;
+  auto samples_sent = ingest_stats.samples_sent.load();
+
+  /* wait until the server has received all samples or stops making progress */
+  bool loss_measured = false;
+  IngestCounters counters;
+  if (measure_loss) {
+    auto drain_deadline =
+        WallClock::unixMicros() + env()->flags()->getInt("drain") * 1000000;
+    int64_t samples_received = -1;
+
+    while (fetchIngestCounters(http_port, &counters)) {
+      loss_measured = true;
+      auto received =
+          counters.samples_received - counters_before.samples_received;
+
+      if (received >= samples_sent ||
+          received == samples_received ||
+          WallClock::unixMicros() > drain_deadline) {
+        break;
+      }
+
+      samples_received = received;
+      usleep(250000);
+    }
+  }
+
+  std::vector<uint64_t> all_latencies;
+  for (const auto& l : query_stats.latencies) {
+    all_latencies.insert(all_latencies.end(), l.begin(), l.end());
+  }
+
+  std::sort(all_latencies.begin(), all_latencies.end());
+
+  auto percentile = [&all_latencies] (double p) -> double {
+    if (all_latencies.size() == 0) {
+      return 0;
+    }
+
+    auto idx = static_cast<size_t>(p / 100.0 * (all_latencies.size() - 1));
+    return all_latencies[idx] / 1000.0;
+  };
+
+  printf("duration:          %.1fs\n", elapsed / 1000000.0);
+  printf("samples sent:      %llu\n", (unsigned long long) samples_sent);
+  printf(
+      "samples/s:         %.1f\n",
+      samples_sent / (elapsed / 1000000.0));
+  printf(
+      "send errors:       %llu\n",
+      (unsigned long long) ingest_stats.send_errors.load());
+  printf(
+      "max sender lag:    %.3fms\n",
+      ingest_stats.max_lag_micros.load() / 1000.0);
+
+  if (loss_measured) {
+    auto received =
+        counters.samples_received - counters_before.samples_received;
+    auto lost = std::max<int64_t>(samples_sent - received, 0);
+
+    printf("samples received:  %lli\n", (long long) received);
+    printf(
+        "samples dropped:   %lli (invalid)\n",
+        (long long) (counters.samples_dropped -
+            counters_before.samples_dropped));
+    printf(
+        "datagrams dropped: %lli (receive queue full)\n",
+        (long long) (counters.datagrams_dropped -
+            counters_before.datagrams_dropped));
+    printf(
+        "ingest loss:       %lli (%.3f%%)\n",
+        (long long) lost,
+        samples_sent > 0 ? lost * 100.0 / samples_sent : 0.0);
+  } else {
+    printf("ingest loss:       n/a\n");
+  }
+
+  printf("queries:           %llu\n", (unsigned long long) all_latencies.size());
+  printf(
+      "query errors:      %llu\n",
+      (unsigned long long) query_stats.num_errors.load());
+  printf("query latency p50: %.3fms\n", percentile(50));
+  printf("query latency p90: %.3fms\n", percentile(90));
+  printf("query latency p99: %.3fms\n", percentile(99));
+  printf("query latency max: %.3fms\n", percentile(100));
+
+  return 0;
+}
+
+static void printUsage() {
+  auto err_stream = fnordmetric::util::OutputStream::getStderr();
+  err_stream->printf("usage: fnordmetric-loadgen [options]\n");
+  err_stream->printf("\noptions:\n");
+  env()->flags()->printUsage(err_stream.get());
+  err_stream->printf("\nexamples:\n");
+  err_stream->printf("    $ fnordmetric-loadgen --metrics 100 --label_cardinality 1000 --rate 50000 --duration 60\n");
+  err_stream->printf("    $ fnordmetric-loadgen --transport http --rate 500 --query_file dashboard.sql --query_rate 10\n");
+  err_stream->printf("    $ fnordmetric-loadgen --replay_file capture.txt --speed 10\n");
+}
+
+int main(int argc, const char** argv) {
+  fnordmetric::util::SignalHandler::ignoreSIGPIPE();
+
+  env()->flags()->defineFlag(
+      "http_port",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "8080",
+      "Send queries (and HTTP samples) to the server on this port",
+      "<port>");
+
+  env()->flags()->defineFlag(
+      "statsd_port",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "8125",
+      "Send statsd samples to the server on this port",
+      "<port>");
+
+  env()->flags()->defineFlag(
+      "transport",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      "statsd",
+      "Send synthetic samples via 'statsd' or 'http'. Default: 'statsd'",
+      "<name>");
+
+  env()->flags()->defineFlag(
+      "metrics",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "10",
+      "Number of distinct synthetic metrics",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "label_cardinality",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "100",
+      "Number of distinct values of the synthetic 'host' label",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "rate",
+      cli::FlagParser::T_FLOAT,
+      false,
+      NULL,
+      "10000",
+      "Samples per second (replay: for lines without a timestamp)",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "ingest_threads",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "1",
+      "Number of threads sending synthetic samples",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "duration",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "10",
+      "Run for this many seconds (ignored when replaying)",
+      "<secs>");
+
+  env()->flags()->defineFlag(
+      "replay_file",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "Replay the statsd datagrams in this file instead of synthetic samples",
+      "<file>");
+
+  env()->flags()->defineFlag(
+      "speed",
+      cli::FlagParser::T_FLOAT,
+      false,
+      NULL,
+      "1",
+      "Replay this many times faster than captured",
+      "<factor>");
+
+  env()->flags()->defineFlag(
+      "query_file",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "Issue the ChartSQL queries in this file, one per line",
+      "<file>");
+
+  env()->flags()->defineFlag(
+      "query_rate",
+      cli::FlagParser::T_FLOAT,
+      false,
+      NULL,
+      "1",
+      "Queries per second (0 = no queries)",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "query_threads",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "4",
+      "Maximum number of queries in flight",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "drain",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "5",
+      "Wait up to this many seconds for the server to receive all samples",
+      "<secs>");
+
+  env()->flags()->defineFlag(
+      "help",
+      cli::FlagParser::T_SWITCH,
+      false,
+      "h",
+      NULL,
+      "You are reading it...");
+
+  env()->flags()->parseArgv(argc, argv);
+
+  if (env()->flags()->isSet("help")) {
+    printUsage();
+    return 0;
+  }
+
+  try {
+    return runLoadgen();
+  } catch (const fnordmetric::util::RuntimeException& e) {
+    auto err_stream = fnordmetric::util::OutputStream::getStderr();
+    auto msg = e.getMessage();
+    err_stream->printf("[ERROR] ");
+    err_stream->write(msg.c_str(), msg.size());
+    err_stream->printf("\n");
+
+    if (e.getTypeName() == kUsageError) {
+      err_stream->printf("\n");
+      printUsage();
+    }
+
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,899 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <fnordmetric/environment.h>
+#include <fnordmetric/io/fileutil.h>
+#include <fnordmetric/metricdb/backends/disk/bulkloader.h>
+#include <fnordmetric/metricdb/backends/disk/labelindex.h>
+#include <fnordmetric/metricdb/backends/disk/segment.h>
+#include <fnordmetric/metricdb/backends/disk/seriestablewriter.h>
+#include <fnordmetric/metricdb/backends/disk/tokenindex.h>
+#include <fnordmetric/util/ieee754.h>
+#include <fnordmetric/util/random.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+using namespace fnord;
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+
+/**
+ * Buffered samples are stored as records of the form
+ *
+ *   u32 size (of the rest of the record), u32 metric_len, metric, u64 time,
+ *   f64 value, u32 num_labels, num_labels * (u32 len, key, u32 len, value)
+ *
+ * in the partition buffers and run files
+ */
+static const size_t kRunBufferSize = 1 << 20; /* 1MB */
+
+static void appendUInt32(std::string* buf, uint32_t value) {
+  buf->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void appendUInt64(std::string* buf, uint64_t value) {
+  buf->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static uint32_t readUInt32(const char* data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static uint64_t readUInt64(const char* data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static size_t recordSize(const char* record) {
+  return sizeof(uint32_t) + readUInt32(record);
+}
+
+static uint64_t recordTime(const char* record) {
+  return readUInt64(record + 2 * sizeof(uint32_t) + readUInt32(record + 4));
+}
+
+/**
+ * Orders records by (metric, time)
+ */
+static int compareRecords(const char* a, const char* b) {
+  auto a_len = readUInt32(a + 4);
+  auto b_len = readUInt32(b + 4);
+  auto cmp = memcmp(a + 8, b + 8, std::min(a_len, b_len));
+  if (cmp != 0) {
+    return cmp;
+  }
+
+  if (a_len != b_len) {
+    return a_len < b_len ? -1 : 1;
+  }
+
+  auto a_time = recordTime(a);
+  auto b_time = recordTime(b);
+  if (a_time != b_time) {
+    return a_time < b_time ? -1 : 1;
+  }
+
+  return 0;
+}
+
+static void writeAll(int fd, const std::string& data) {
+  size_t pos = 0;
+
+  while (pos < data.size()) {
+    auto bytes_written = ::write(fd, data.data() + pos, data.size() - pos);
+
+    if (bytes_written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      RAISE_ERRNO(kIOError, "write() failed");
+    }
+
+    pos += bytes_written;
+  }
+}
+
+/**
+ * Reads the records of a sorted run in order
+ */
+class RunReader {
+public:
+  virtual ~RunReader() {}
+
+  /**
+   * Advance to the next record and return true or return false at the end
+   * of the run
+   */
+  virtual bool next() = 0;
+
+  const char* record() const {
+    return record_;
+  }
+
+protected:
+  const char* record_;
+};
+
+class MemoryRunReader : public RunReader {
+public:
+  MemoryRunReader(
+      const std::string* buffer,
+      const std::vector<size_t>* offsets) :
+      buffer_(buffer),
+      offsets_(offsets),
+      pos_(0) {}
+
+  bool next() override {
+    if (pos_ >= offsets_->size()) {
+      return false;
+    }
+
+    record_ = buffer_->data() + (*offsets_)[pos_++];
+    return true;
+  }
+
+protected:
+  const std::string* buffer_;
+  const std::vector<size_t>* offsets_;
+  size_t pos_;
+};
+
+class FileRunReader : public RunReader {
+public:
+  explicit FileRunReader(io::File* file) :
+      file_(file),
+      buffer_(kRunBufferSize, 0),
+      begin_(0),
+      end_(0),
+      eof_(false) {
+    file_->seekTo(0);
+  }
+
+  bool next() override {
+    if (!fill(sizeof(uint32_t))) {
+      return false;
+    }
+
+    auto size = recordSize(&buffer_[begin_]);
+    if (!fill(size)) {
+      RAISE(kIllegalStateError, "run file is truncated");
+    }
+
+    record_ = &buffer_[begin_];
+    begin_ += size;
+    return true;
+  }
+
+protected:
+
+  /**
+   * Make sure that at least size bytes are buffered after begin_. Returns
+   * false at the end of the file
+   */
+  bool fill(size_t size) {
+    if (end_ - begin_ >= size) {
+      return true;
+    }
+
+    memmove(&buffer_[0], &buffer_[begin_], end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+
+    if (buffer_.size() < size) {
+      buffer_.resize(size);
+    }
+
+    while (end_ < size && !eof_) {
+      auto bytes_read = file_->read(&buffer_[end_], buffer_.size() - end_);
+      if (bytes_read == 0) {
+        eof_ = true;
+      }
+
+      end_ += bytes_read;
+    }
+
+    return end_ >= size;
+  }
+
+  io::File* file_;
+  std::string buffer_;
+  size_t begin_;
+  size_t end_;
+  bool eof_;
+};
+
+/**
+ * Writes the sorted samples of one metric into new tables that are
+ * partitioned by series, like the tables that Metric finalizes
+ */
+class BulkLoader::MetricWriter {
+public:
+  MetricWriter(
+      const std::string& key,
+      ExistingMetric* existing,
+      io::FileRepository* file_repo,
+      size_t table_max_size) :
+      key_(key),
+      file_repo_(file_repo),
+      table_max_size_(table_max_size),
+      table_(&token_index_, &label_index_, &series_index_),
+      generation_(0),
+      num_tables_(0) {
+    if (existing == nullptr || existing->tables.empty()) {
+      return;
+    }
+
+    /* import the indexes of the current generation chain, like
+       Metric does when it reopens the tables */
+    TableRef* head_table = nullptr;
+    for (const auto& table : existing->tables) {
+      if (head_table == nullptr ||
+          table->generation() > head_table->generation()) {
+        head_table = table.get();
+      }
+    }
+
+    parents_ = head_table->parents();
+    parents_.emplace_back(head_table->generation());
+    generation_ = head_table->generation();
+
+    for (const auto gen : parents_) {
+      for (const auto& table : existing->tables) {
+        if (table->generation() == gen) {
+          table->import(&token_index_, &label_index_);
+          table->importSeries(&series_index_);
+        }
+      }
+    }
+
+    existing->tables.clear();
+  }
+
+  void addSample(const char* record) {
+    auto metric_len = readUInt32(record + 4);
+    auto cur = record + 2 * sizeof(uint32_t) + metric_len;
+    auto time = readUInt64(cur);
+    cur += sizeof(uint64_t);
+
+    double value;
+    memcpy(&value, cur, sizeof(value));
+    cur += sizeof(value);
+
+    auto num_labels = readUInt32(cur);
+    cur += sizeof(uint32_t);
+
+    SeriesIndex::LabelList labels;
+    for (int i = 0; i < num_labels; ++i) {
+      auto key_len = readUInt32(cur);
+      std::string label_key(cur + sizeof(uint32_t), key_len);
+      cur += sizeof(uint32_t) + key_len;
+
+      auto value_len = readUInt32(cur);
+      std::string label_value(cur + sizeof(uint32_t), value_len);
+      cur += sizeof(uint32_t) + value_len;
+
+      label_index_.addLabel(label_key);
+      labels.emplace_back(label_key, label_value);
+    }
+
+    table_.addSample(time, fnord::util::IEEE754::toBytes(value), labels);
+
+    if (table_.bodySize() >= table_max_size_) {
+      finalizeTable();
+    }
+  }
+
+  /**
+   * Finalize the last table and return the number of tables written
+   */
+  size_t finish() {
+    if (table_.numSamples() > 0) {
+      finalizeTable();
+    }
+
+    return num_tables_;
+  }
+
+protected:
+
+  void finalizeTable() {
+    auto fileref = file_repo_->createFile();
+    table_.write(fileref.absolute_path, key_, ++generation_, parents_);
+    parents_.emplace_back(generation_);
+    ++num_tables_;
+  }
+
+  std::string key_;
+  io::FileRepository* file_repo_;
+  size_t table_max_size_;
+  TokenIndex token_index_;
+  LabelIndex label_index_;
+  SeriesIndex series_index_;
+  SeriesTableWriter table_;
+  uint64_t generation_;
+  std::vector<uint64_t> parents_;
+  size_t num_tables_;
+};
+
+/**
+ * Buffers the samples of a subset of the metrics and spills them to sorted
+ * run files
+ */
+class BulkLoader::Partition {
+public:
+  Partition(
+      size_t memory_limit,
+      const std::string& tmpdir) :
+      memory_limit_(memory_limit),
+      tmpdir_(tmpdir),
+      num_metrics_(0),
+      num_tables_(0) {}
+
+  void addSample(
+      const std::string& metric_key,
+      uint64_t time,
+      double value,
+      const LabelList& labels) {
+    auto offset = buffer_.size();
+    appendUInt32(&buffer_, 0);
+    appendUInt32(&buffer_, metric_key.size());
+    buffer_.append(metric_key);
+    appendUInt64(&buffer_, time);
+    buffer_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    appendUInt32(&buffer_, labels.size());
+    for (const auto& label : labels) {
+      appendUInt32(&buffer_, label.first.size());
+      buffer_.append(label.first);
+      appendUInt32(&buffer_, label.second.size());
+      buffer_.append(label.second);
+    }
+
+    uint32_t size = buffer_.size() - offset - sizeof(uint32_t);
+    memcpy(&buffer_[offset], &size, sizeof(size));
+    offsets_.emplace_back(offset);
+
+    if (buffer_.size() + offsets_.size() * sizeof(size_t) > memory_limit_) {
+      spill();
+    }
+  }
+
+  /**
+   * Merge all runs and write the tables of every metric in this partition
+   */
+  void write(
+      std::unordered_map<std::string, ExistingMetric>* existing_metrics,
+      io::FileRepository* file_repo,
+      size_t table_max_size) {
+    sortBuffer();
+
+    /* readers are ordered by run age so that ties keep the insert order */
+    std::vector<std::unique_ptr<RunReader>> readers;
+    for (auto& run : runs_) {
+      readers.emplace_back(new FileRunReader(&run));
+    }
+
+    readers.emplace_back(new MemoryRunReader(&buffer_, &offsets_));
+
+    typedef std::pair<RunReader*, size_t> HeapEntry;
+    auto heap_cmp = [] (const HeapEntry& a, const HeapEntry& b) -> bool {
+      auto cmp = compareRecords(a.first->record(), b.first->record());
+      return cmp == 0 ? a.second > b.second : cmp > 0;
+    };
+
+    std::vector<HeapEntry> heap;
+    for (size_t i = 0; i < readers.size(); ++i) {
+      if (readers[i]->next()) {
+        heap.emplace_back(readers[i].get(), i);
+      }
+    }
+
+    std::make_heap(heap.begin(), heap.end(), heap_cmp);
+
+    std::unique_ptr<MetricWriter> metric;
+    std::string metric_key;
+
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), heap_cmp);
+      auto reader = heap.back().first;
+      auto record = reader->record();
+
+      auto key_len = readUInt32(record + 4);
+      if (metric.get() == nullptr ||
+          metric_key.compare(0, std::string::npos, record + 8, key_len) != 0) {
+        if (metric.get() != nullptr) {
+          num_tables_ += metric->finish();
+        }
+
+        metric_key.assign(record + 8, key_len);
+        auto existing = existing_metrics->find(metric_key);
+
+        metric.reset(new MetricWriter(
+            metric_key,
+            existing == existing_metrics->end() ? nullptr : &existing->second,
+            file_repo,
+            table_max_size));
+
+        ++num_metrics_;
+      }
+
+      metric->addSample(record);
+
+      if (reader->next()) {
+        std::push_heap(heap.begin(), heap.end(), heap_cmp);
+      } else {
+        heap.pop_back();
+      }
+    }
+
+    if (metric.get() != nullptr) {
+      num_tables_ += metric->finish();
+    }
+
+    runs_.clear();
+    buffer_.clear();
+    offsets_.clear();
+  }
+
+  size_t numRuns() const {
+    return runs_.size();
+  }
+
+  size_t numMetrics() const {
+    return num_metrics_;
+  }
+
+  size_t numTables() const {
+    return num_tables_;
+  }
+
+protected:
+
+  void sortBuffer() {
+    auto buffer = buffer_.data();
+
+    std::stable_sort(
+        offsets_.begin(),
+        offsets_.end(),
+        [buffer] (size_t a, size_t b) -> bool {
+      return compareRecords(buffer + a, buffer + b) < 0;
+    });
+  }
+
+  void spill() {
+    sortBuffer();
+
+    auto run = io::File::openFile(
+        io::FileUtil::joinPaths(
+            tmpdir_,
+            "fnordmetric-bulkload-" + fnord::util::Random::alphanumericString(16)),
+        io::File::O_READ | io::File::O_WRITE | io::File::O_CREATE |
+        io::File::O_AUTODELETE);
+
+    std::string write_buffer;
+    write_buffer.reserve(kRunBufferSize);
+
+    for (const auto offset : offsets_) {
+      auto record = buffer_.data() + offset;
+      write_buffer.append(record, recordSize(record));
+
+      if (write_buffer.size() >= kRunBufferSize) {
+        writeAll(run.fd(), write_buffer);
+        write_buffer.clear();
+      }
+    }
+
+    writeAll(run.fd(), write_buffer);
+    runs_.emplace_back(std::move(run));
+
+    buffer_.clear();
+    offsets_.clear();
+  }
+
+  size_t memory_limit_;
+  std::string tmpdir_;
+  std::string buffer_;
+  std::vector<size_t> offsets_;
+  std::vector<io::File> runs_;
+  size_t num_metrics_;
+  size_t num_tables_;
+};
+
+BulkLoader::BulkLoader(
+    const std::string& datadir,
+    size_t num_threads /* = 4 */,
+    size_t memory_limit /* = kDefaultMemoryLimit */,
+    const std::string& tmpdir /* = "/tmp" */,
+    const std::string& cold_datadir /* = "" */) :
+    file_repo_(new io::FileRepository(datadir)),
+    tmpdir_(tmpdir),
+    table_max_size_(kDefaultTableMaxSize),
+    num_samples_(0),
+    finished_(false) {
+  if (!io::FileUtil::isDirectory(datadir)) {
+    RAISE(kIllegalArgumentError, "not a directory: %s", datadir.c_str());
+  }
+
+  if (num_threads == 0) {
+    RAISE(kIllegalArgumentError, "num_threads must be greater than zero");
+  }
+
+  if (!cold_datadir.empty()) {
+    if (!io::FileUtil::isDirectory(cold_datadir)) {
+      RAISE(
+          kIllegalArgumentError,
+          "not a directory: %s",
+          cold_datadir.c_str());
+    }
+
+    cold_file_repo_.reset(new io::FileRepository(cold_datadir));
+  }
+
+  /* the tables of shared segments and cold tables are opened like any other
+     table */
+  SegmentRepository::TableMap tables;
+  SegmentRepository(file_repo_.get()).openTables(
+      &tables,
+      cold_file_repo_.get());
+
+  for (auto& iter : tables) {
+    existing_metrics_[iter.first].tables = std::move(iter.second);
+  }
+
+  for (int i = 0; i < num_threads; ++i) {
+    partitions_.emplace_back(
+        new Partition(memory_limit / num_threads, tmpdir));
+  }
+}
+
+BulkLoader::~BulkLoader() {}
+
+void BulkLoader::addSample(
+    const std::string& metric_key,
+    uint64_t time,
+    double value,
+    const LabelList& labels) {
+  if (finished_) {
+    RAISE(kIllegalStateError, "bulk loader is already finished");
+  }
+
+  auto partition = std::hash<std::string>()(metric_key) % partitions_.size();
+  partitions_[partition]->addSample(metric_key, time, value, labels);
+  ++num_samples_;
+}
+
+void BulkLoader::finish() {
+  if (finished_) {
+    RAISE(kIllegalStateError, "bulk loader is already finished");
+  }
+
+  finished_ = true;
+
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(partitions_.size());
+
+  for (size_t i = 0; i < partitions_.size(); ++i) {
+    threads.emplace_back([this, i, &errors] () {
+      try {
+        partitions_[i]->write(
+            &existing_metrics_,
+            file_repo_.get(),
+            table_max_size_);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+void BulkLoader::setTableMaxSize(size_t max_size) {
+  table_max_size_ = max_size;
+}
+
+size_t BulkLoader::numSamples() const {
+  return num_samples_;
+}
+
+size_t BulkLoader::numMetrics() const {
+  size_t num_metrics = 0;
+  for (const auto& partition : partitions_) {
+    num_metrics += partition->numMetrics();
+  }
+
+  return num_metrics;
+}
+
+size_t BulkLoader::numTables() const {
+  size_t num_tables = 0;
+  for (const auto& partition : partitions_) {
+    num_tables += partition->numTables();
+  }
+
+  return num_tables;
+}
+
+size_t BulkLoader::numRuns() const {
+  size_t num_runs = 0;
+  for (const auto& partition : partitions_) {
+    num_runs += partition->numRuns();
+  }
+
+  return num_runs;
+}
+
+static uint64_t parseTimeMillis(const std::string& str) {
+  char* end;
+  auto time_millis = strtoull(str.c_str(), &end, 10);
+  if (str.empty() || *end != 0) {
+    RAISE(kParseError, "invalid timestamp: '%s'", str.c_str());
+  }
+
+  return time_millis * 1000;
+}
+
+static double parseValue(const std::string& str) {
+  char* end;
+  auto value = strtod(str.c_str(), &end);
+  if (str.empty() || *end != 0) {
+    RAISE(kParseError, "invalid value: '%s'", str.c_str());
+  }
+
+  return value;
+}
+
+void BulkLoader::parseCSVLine(
+    const std::string& line,
+    std::string* metric_key,
+    IMetric::BatchSample* sample) {
+  std::vector<std::string> fields;
+  size_t begin = 0;
+
+  for (;;) {
+    auto end = line.find(',', begin);
+    fields.emplace_back(line.substr(begin, end - begin));
+    if (end == std::string::npos) {
+      break;
+    }
+
+    begin = end + 1;
+  }
+
+  if (fields.size() < 3 || fields[0].empty()) {
+    RAISE(kParseError, "invalid sample: '%s'", line.c_str());
+  }
+
+  *metric_key = fields[0];
+  sample->time = parseTimeMillis(fields[1]);
+  sample->value = parseValue(fields[2]);
+  sample->labels.clear();
+
+  for (int i = 3; i < fields.size(); ++i) {
+    auto eq = fields[i].find('=');
+    if (eq == std::string::npos || eq == 0) {
+      RAISE(kParseError, "invalid label: '%s'", fields[i].c_str());
+    }
+
+    sample->labels.emplace_back(
+        fields[i].substr(0, eq),
+        fields[i].substr(eq + 1));
+  }
+
+  IMetric::checkLabels(sample->labels);
+}
+
+/**
+ * A minimal parser for the flat JSON objects of the JSON lines format
+ */
+class JSONLineParser {
+public:
+  explicit JSONLineParser(const std::string& line) :
+      line_(line),
+      pos_(0) {}
+
+  void expect(char c) {
+    skipWhitespace();
+    if (pos_ >= line_.size() || line_[pos_] != c) {
+      RAISE(kParseError, "expected '%c' at offset %i", c, (int) pos_);
+    }
+
+    ++pos_;
+  }
+
+  /**
+   * Consume c and return true if it is the next character
+   */
+  bool consume(char c) {
+    skipWhitespace();
+    if (pos_ < line_.size() && line_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+
+    return false;
+  }
+
+  bool isString() {
+    skipWhitespace();
+    return pos_ < line_.size() && line_[pos_] == '"';
+  }
+
+  std::string readString() {
+    expect('"');
+    std::string str;
+
+    while (pos_ < line_.size() && line_[pos_] != '"') {
+      if (line_[pos_] != '\\') {
+        str += line_[pos_++];
+        continue;
+      }
+
+      if (++pos_ >= line_.size()) {
+        break;
+      }
+
+      switch (line_[pos_++]) {
+        case '"': str += '"'; break;
+        case '\\': str += '\\'; break;
+        case '/': str += '/'; break;
+        case 'b': str += '\b'; break;
+        case 'f': str += '\f'; break;
+        case 'n': str += '\n'; break;
+        case 'r': str += '\r'; break;
+        case 't': str += '\t'; break;
+        case 'u': appendCodepoint(&str); break;
+        default:
+          RAISE(kParseError, "invalid escape at offset %i", (int) pos_);
+      }
+    }
+
+    expect('"');
+    return str;
+  }
+
+  /**
+   * Returns the literal of the next number, true, false or null
+   */
+  std::string readLiteral() {
+    skipWhitespace();
+    auto begin = pos_;
+    while (pos_ < line_.size() &&
+        strchr(",}] \t\r\n", line_[pos_]) == nullptr) {
+      ++pos_;
+    }
+
+    if (pos_ == begin) {
+      RAISE(kParseError, "expected a value at offset %i", (int) pos_);
+    }
+
+    return line_.substr(begin, pos_ - begin);
+  }
+
+  std::string readScalar() {
+    return isString() ? readString() : readLiteral();
+  }
+
+  void expectEnd() {
+    skipWhitespace();
+    if (pos_ != line_.size()) {
+      RAISE(kParseError, "trailing characters at offset %i", (int) pos_);
+    }
+  }
+
+protected:
+
+  void skipWhitespace() {
+    while (pos_ < line_.size() && isspace(line_[pos_])) {
+      ++pos_;
+    }
+  }
+
+  void appendCodepoint(std::string* str) {
+    if (pos_ + 4 > line_.size()) {
+      RAISE(kParseError, "invalid unicode escape");
+    }
+
+    auto codepoint = strtoul(line_.substr(pos_, 4).c_str(), nullptr, 16);
+    pos_ += 4;
+
+    if (codepoint < 0x80) {
+      *str += (char) codepoint;
+    } else if (codepoint < 0x800) {
+      *str += (char) (0xc0 | (codepoint >> 6));
+      *str += (char) (0x80 | (codepoint & 0x3f));
+    } else {
+      *str += (char) (0xe0 | (codepoint >> 12));
+      *str += (char) (0x80 | ((codepoint >> 6) & 0x3f));
+      *str += (char) (0x80 | (codepoint & 0x3f));
+    }
+  }
+
+  const std::string& line_;
+  size_t pos_;
+};
+
+void BulkLoader::parseJSONLine(
+    const std::string& line,
+    std::string* metric_key,
+    IMetric::BatchSample* sample) {
+  JSONLineParser parser(line);
+  bool has_time = false;
+  bool has_value = false;
+
+  metric_key->clear();
+  sample->labels.clear();
+
+  parser.expect('{');
+  if (!parser.consume('}')) {
+    do {
+      auto key = parser.readString();
+      parser.expect(':');
+
+      if (key == "metric") {
+        *metric_key = parser.readString();
+      } else if (key == "time") {
+        sample->time = parseTimeMillis(parser.readLiteral());
+        has_time = true;
+      } else if (key == "value") {
+        sample->value = parseValue(parser.readScalar());
+        has_value = true;
+      } else if (key == "labels") {
+        parser.expect('{');
+        if (!parser.consume('}')) {
+          do {
+            auto label_key = parser.readString();
+            parser.expect(':');
+            sample->labels.emplace_back(label_key, parser.readScalar());
+          } while (parser.consume(','));
+
+          parser.expect('}');
+        }
+      } else {
+        RAISE(kParseError, "unknown field: '%s'", key.c_str());
+      }
+    } while (parser.consume(','));
+
+    parser.expect('}');
+  }
+
+  parser.expectEnd();
+
+  if (metric_key->empty() || !has_time || !has_value) {
+    RAISE(
+        kParseError,
+        "sample needs a metric, time and value: '%s'",
+        line.c_str());
+  }
+
+  IMetric::checkLabels(sample->labels);
+}
+
+}
+}
+}
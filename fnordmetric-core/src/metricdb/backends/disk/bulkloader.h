@@ -0,0 +1,158 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_BULKLOADER_H
+#define _FNORDMETRIC_METRICDB_BULKLOADER_H
+#include <stdlib.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fnordmetric/io/file.h>
+#include <fnordmetric/io/filerepository.h>
+#include <fnordmetric/metricdb/metric.h>
+#include <fnordmetric/metricdb/backends/disk/tableref.h>
+
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+
+/**
+ * Loads historical samples into a disk backend datadir without going through
+ * a running server: the samples are sorted by (metric, time) and written
+ * straight into finalized and indexed sstables that are partitioned by series
+ * like the tables the server finalizes (see TableRef::createSeriesTable).
+ *
+ *   BulkLoader loader("/var/lib/fnordmetric");
+ *   loader.addSample("http_latency", time, value, labels);
+ *   ...
+ *   loader.finish();
+ *
+ * Samples may be added in any order. They are hash partitioned by metric key
+ * into num_threads partitions, each of which buffers up to
+ * memory_limit / num_threads bytes of samples. A full partition is sorted
+ * and written to an (unlinked) run file in tmpdir. finish merges the runs of
+ * every partition on its own thread and writes the tables of each metric
+ * front to back, so the write path is purely sequential. The samples of the
+ * table that is being written are buffered in memory until the table is
+ * full, so finish needs up to num_threads times the table max size on top of
+ * the memory limit.
+ *
+ * New tables continue the generation chain of the metric's existing tables
+ * (with all of them as parents), so the server picks them up on its next
+ * start. If the server moves old tables to a cold datadir, the loader must
+ * be given the same cold datadir, otherwise it doesn't see the cold tables
+ * and writes tables that conflict with them. Samples of equal metric, labels
+ * and time keep the order in which they were added. The server must not be
+ * running while the loader writes to its datadir.
+ *
+ * addSample must only be called from one thread at a time.
+ */
+class BulkLoader {
+public:
+  static const size_t kDefaultMemoryLimit = 256 << 20; /* 256MB */
+  static const size_t kDefaultTableMaxSize = 64 << 20; /* 64MB */
+
+  typedef std::vector<std::pair<std::string, std::string>> LabelList;
+
+  /**
+   * Open the datadir, which must exist. Scans (and repairs) the existing
+   * tables in the datadir and, if not empty, the cold datadir to continue
+   * their generations. New tables are always written to the datadir
+   */
+  BulkLoader(
+      const std::string& datadir,
+      size_t num_threads = 4,
+      size_t memory_limit = kDefaultMemoryLimit,
+      const std::string& tmpdir = "/tmp",
+      const std::string& cold_datadir = "");
+
+  ~BulkLoader();
+
+  BulkLoader(const BulkLoader& copy) = delete;
+  BulkLoader& operator=(const BulkLoader& copy) = delete;
+
+  /**
+   * Add a sample. The time is in microseconds since epoch
+   */
+  void addSample(
+      const std::string& metric_key,
+      uint64_t time,
+      double value,
+      const LabelList& labels);
+
+  /**
+   * Sort and write all added samples. Must be called exactly once, after the
+   * last addSample
+   */
+  void finish();
+
+  /**
+   * Start a new table once a table's body is larger than max_size bytes
+   */
+  void setTableMaxSize(size_t max_size);
+
+  size_t numSamples() const;
+  size_t numMetrics() const;
+  size_t numTables() const;
+  size_t numRuns() const;
+
+  /**
+   * Parse a line of the CSV format (without the trailing newline):
+   *
+   *   metric,time,value[,label=value...]
+   *
+   * where time is in milliseconds since epoch. Throws a parse error if the
+   * line is invalid
+   */
+  static void parseCSVLine(
+      const std::string& line,
+      std::string* metric_key,
+      IMetric::BatchSample* sample);
+
+  /**
+   * Parse a line of the JSON lines format, one object per line:
+   *
+   *   {"metric": "http_latency", "time": 1414141414000, "value": 23.5,
+   *    "labels": {"host": "web01"}}
+   *
+   * where time is in milliseconds since epoch and labels is optional. Throws
+   * a parse error if the line is invalid
+   */
+  static void parseJSONLine(
+      const std::string& line,
+      std::string* metric_key,
+      IMetric::BatchSample* sample);
+
+protected:
+  class Partition;
+  class MetricWriter;
+
+  /**
+   * The tables that already exist for a metric in the datadir
+   */
+  struct ExistingMetric {
+    std::vector<std::unique_ptr<TableRef>> tables;
+  };
+
+  std::unique_ptr<fnord::io::FileRepository> file_repo_;
+  std::unique_ptr<fnord::io::FileRepository> cold_file_repo_;
+  std::unordered_map<std::string, ExistingMetric> existing_metrics_;
+  std::vector<std::unique_ptr<Partition>> partitions_;
+  std::string tmpdir_;
+  size_t table_max_size_;
+  size_t num_samples_;
+  bool finished_;
+};
+
+}
+}
+}
+#endif
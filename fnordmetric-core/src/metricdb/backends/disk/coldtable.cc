@@ -0,0 +1,497 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/environment.h>
+#include <fnordmetric/io/fileutil.h>
+#include <fnordmetric/metricdb/backends/disk/coldtable.h>
+#include <fnordmetric/metricdb/backends/disk/labelindex.h>
+#include <fnordmetric/metricdb/backends/disk/seriesindex.h>
+#include <fnordmetric/metricdb/backends/disk/tableref.h>
+#include <fnordmetric/metricdb/backends/disk/tokenindex.h>
+#include <fnordmetric/sstable/binaryformat.h>
+#include <fnordmetric/sstable/sstablestreamwriter.h>
+#include <fnordmetric/util/binarymessagereader.h>
+#include <fnordmetric/util/binarymessagewriter.h>
+#include <fnordmetric/util/runtimeexception.h>
+#include <algorithm>
+#include <string.h>
+
+#ifdef FNORD_ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace fnord;
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+
+#ifdef FNORD_ENABLE_ZLIB
+const uint32_t ColdTable::kDefaultCodec = ColdTable::kCodecZlib;
+#else
+const uint32_t ColdTable::kDefaultCodec = ColdTable::kCodecNone;
+#endif
+
+/* the footers of finalized tables that are copied into the cold table */
+static const uint32_t kCopiedFooters[] = {
+  TokenIndex::kIndexType,
+  LabelIndex::kIndexType,
+  TableRef::kTimeRangeIndexType,
+  SeriesIndex::kIndexType
+};
+
+static void compressBlock(
+    uint32_t codec,
+    const std::string& block,
+    std::string* compressed) {
+  switch (codec) {
+
+    case ColdTable::kCodecNone:
+      *compressed = block;
+      return;
+
+    case ColdTable::kCodecZlib: {
+#ifdef FNORD_ENABLE_ZLIB
+      uLongf size = compressBound(block.size());
+      compressed->resize(size);
+
+      auto ret = compress2(
+          reinterpret_cast<Bytef*>(&(*compressed)[0]),
+          &size,
+          reinterpret_cast<const Bytef*>(block.data()),
+          block.size(),
+          Z_BEST_COMPRESSION);
+
+      if (ret != Z_OK) {
+        RAISE(kRuntimeError, "zlib compression failed with error %i", ret);
+      }
+
+      compressed->resize(size);
+      return;
+#else
+      RAISE(kRuntimeError, "FnordMetric was compiled without zlib");
+#endif
+    }
+
+    default:
+      RAISE(kIllegalArgumentError, "unknown block codec: %u", codec);
+
+  }
+}
+
+static void decompressBlock(
+    uint32_t codec,
+    const void* data,
+    size_t size,
+    size_t block_size,
+    std::string* block) {
+  switch (codec) {
+
+    case ColdTable::kCodecNone:
+      block->assign(static_cast<const char*>(data), size);
+      break;
+
+    case ColdTable::kCodecZlib: {
+#ifdef FNORD_ENABLE_ZLIB
+      uLongf decompressed_size = block_size;
+      block->resize(block_size);
+
+      auto ret = uncompress(
+          reinterpret_cast<Bytef*>(&(*block)[0]),
+          &decompressed_size,
+          static_cast<const Bytef*>(data),
+          size);
+
+      if (ret != Z_OK) {
+        RAISE(kIOError, "zlib decompression failed with error %i", ret);
+      }
+
+      block->resize(decompressed_size);
+      break;
+#else
+      RAISE(kRuntimeError, "FnordMetric was compiled without zlib");
+#endif
+    }
+
+    default:
+      RAISE(kIllegalStateError, "unknown block codec: %u", codec);
+
+  }
+
+  if (block->size() != block_size) {
+    RAISE(kIOError, "corrupt block");
+  }
+}
+
+static void writeBlock(
+    sstable::SSTableStreamWriter* writer,
+    uint32_t codec,
+    uint64_t offset,
+    const std::string& block,
+    std::string* compressed) {
+  char key[ColdTable::kBlockKeySize];
+  uint64_t block_size = block.size();
+  memcpy(key, &offset, sizeof(offset));
+  memcpy(key + sizeof(offset), &block_size, sizeof(block_size));
+
+  compressBlock(codec, block, compressed);
+  writer->appendRow(key, sizeof(key), compressed->data(), compressed->size());
+}
+
+void ColdTable::writeTable(
+    const std::string& filename,
+    const std::string& source_filename,
+    uint32_t codec /* = kDefaultCodec */) {
+  sstable::SSTableReader reader(
+      io::File::openFile(source_filename, io::File::O_READ));
+
+  uint32_t source_codec;
+  size_t source_body_size;
+  if (reader.bodySize() == 0 ||
+      readFooter(&reader, &source_codec, &source_body_size)) {
+    RAISE(
+        kIllegalArgumentError,
+        "%s is not a finalized table",
+        source_filename.c_str());
+  }
+
+  if (env()->verbose()) {
+    env()->logger()->printf(
+        "DEBUG",
+        "Writing cold table '%s' for sstable '%s'",
+        filename.c_str(),
+        source_filename.c_str());
+  }
+
+  auto header = reader.readHeader();
+
+  try {
+    auto writer = sstable::SSTableStreamWriter::create(
+        filename,
+        header.data(),
+        header.size());
+
+    std::string block;
+    std::string compressed;
+    uint64_t block_offset = 0;
+
+    /* blocks end at row boundaries, so every row is read from one block */
+    auto cur = reader.getCursor();
+    while (cur->valid()) {
+      void* key;
+      size_t key_size;
+      void* data;
+      size_t data_size;
+      cur->getKey(&key, &key_size);
+      cur->getData(&data, &data_size);
+
+      if (block.empty()) {
+        block_offset = cur->position();
+      }
+
+      block.append(
+          static_cast<char*>(key) - sizeof(sstable::BinaryFormat::RowHeader),
+          sizeof(sstable::BinaryFormat::RowHeader) + key_size + data_size);
+
+      if (block.size() >= kBlockSize) {
+        writeBlock(writer.get(), codec, block_offset, block, &compressed);
+        block.clear();
+      }
+
+      if (!cur->next()) {
+        break;
+      }
+    }
+
+    if (!block.empty()) {
+      writeBlock(writer.get(), codec, block_offset, block, &compressed);
+    }
+
+    for (const auto index_type : kCopiedFooters) {
+      auto footer = reader.readFooter(index_type);
+      if (footer.size() > 0) {
+        writer->writeIndex(index_type, footer.data(), footer.size());
+      }
+    }
+
+    fnord::util::BinaryMessageWriter cold_footer;
+    cold_footer.appendUInt32(codec);
+    cold_footer.appendUInt64(reader.bodySize());
+    writer->writeIndex(kIndexType, cold_footer.data(), cold_footer.size());
+    writer->finalize();
+  } catch (util::RuntimeException& e) {
+    io::FileUtil::rm(filename);
+    throw;
+  }
+}
+
+bool ColdTable::readFooter(
+    sstable::SSTableReader* reader,
+    uint32_t* codec,
+    size_t* body_size) {
+  auto footer = reader->readFooter(kIndexType);
+  if (footer.size() == 0) {
+    return false;
+  }
+
+  fnord::util::BinaryMessageReader footer_reader(footer.data(), footer.size());
+  *codec = *footer_reader.readUInt32();
+  *body_size = *footer_reader.readUInt64();
+  return true;
+}
+
+/**
+ * Reads the rows of the original table from the blocks of a cold table. The
+ * block of the current row is decompressed when the row is read first
+ */
+class ColdTableCursor : public sstable::Cursor {
+public:
+  ColdTableCursor(
+      const std::string& filename,
+      std::unique_ptr<sstable::SSTableReader> reader) :
+      filename_(filename),
+      reader_(std::move(reader)),
+      cursor_(reader_->getCursor()),
+      pos_(0),
+      block_index_(0) {
+    if (!ColdTable::readFooter(reader_.get(), &codec_, &body_size_)) {
+      RAISE(kIllegalStateError, "%s is not a cold table", filename_.c_str());
+    }
+
+    while (cursor_->valid()) {
+      void* key;
+      size_t key_size;
+      cursor_->getKey(&key, &key_size);
+      if (key_size != ColdTable::kBlockKeySize) {
+        RAISE(kIllegalStateError, "invalid block key");
+      }
+
+      Block block;
+      memcpy(&block.offset, key, sizeof(block.offset));
+      memcpy(
+          &block.size,
+          static_cast<char*>(key) + sizeof(block.offset),
+          sizeof(block.size));
+
+      block.position = cursor_->position();
+      blocks_.emplace_back(block);
+
+      if (!cursor_->next()) {
+        break;
+      }
+    }
+  }
+
+  void seekTo(size_t body_offset) override {
+    pos_ = body_offset;
+  }
+
+  bool next() override {
+    auto header = rowHeader();
+    if (header == nullptr) {
+      return false;
+    }
+
+    auto next_pos = pos_ + sizeof(sstable::BinaryFormat::RowHeader) +
+        header->key_size +
+        header->data_size;
+
+    if (next_pos >= body_size_) {
+      return false;
+    }
+
+    pos_ = next_pos;
+    return valid();
+  }
+
+  bool valid() override {
+    auto header = rowHeader();
+    return header != nullptr && header->key_size > 0;
+  }
+
+  void getKey(void** data, size_t* size) override {
+    auto header = rowHeader();
+    if (header == nullptr) {
+      RAISE(kIllegalStateError, "invalid cursor");
+    }
+
+    *data = const_cast<char*>(reinterpret_cast<const char*>(header + 1));
+    *size = header->key_size;
+  }
+
+  void getData(void** data, size_t* size) override {
+    auto header = rowHeader();
+    if (header == nullptr) {
+      RAISE(kIllegalStateError, "invalid cursor");
+    }
+
+    *data = const_cast<char*>(
+        reinterpret_cast<const char*>(header + 1) + header->key_size);
+    *size = header->data_size;
+  }
+
+  size_t position() const override {
+    return pos_;
+  }
+
+protected:
+  struct Block {
+    uint64_t offset;
+    uint64_t size;
+    size_t position;
+  };
+
+  /**
+   * Returns nullptr if there is no complete row at the current position
+   */
+  const sstable::BinaryFormat::RowHeader* rowHeader() {
+    if (!loadBlock()) {
+      return nullptr;
+    }
+
+    auto offset = pos_ - blocks_[block_index_].offset;
+    if (offset + sizeof(sstable::BinaryFormat::RowHeader) > block_->size()) {
+      return nullptr;
+    }
+
+    auto header = reinterpret_cast<const sstable::BinaryFormat::RowHeader*>(
+        block_->data() + offset);
+
+    auto row_limit = offset + sizeof(sstable::BinaryFormat::RowHeader) +
+        header->key_size +
+        header->data_size;
+
+    return row_limit <= block_->size() ? header : nullptr;
+  }
+
+  /**
+   * Make the block that contains the current position the current block
+   */
+  bool loadBlock() {
+    if (block_.get() != nullptr &&
+        pos_ >= blocks_[block_index_].offset &&
+        pos_ < blocks_[block_index_].offset + blocks_[block_index_].size) {
+      return true;
+    }
+
+    auto iter = std::upper_bound(
+        blocks_.begin(),
+        blocks_.end(),
+        pos_,
+        [] (uint64_t pos, const Block& block) -> bool {
+          return pos < block.offset;
+        });
+
+    if (iter == blocks_.begin()) {
+      return false;
+    }
+
+    --iter;
+    if (pos_ >= iter->offset + iter->size) {
+      return false;
+    }
+
+    auto cache = BlockCache::get();
+    auto cache_key = filename_ + "@" + std::to_string(iter->offset);
+    auto block = cache->findBlock(cache_key);
+
+    if (block.get() == nullptr) {
+      void* data;
+      size_t size;
+      cursor_->seekTo(iter->position);
+      cursor_->getData(&data, &size);
+
+      std::shared_ptr<std::string> decompressed(new std::string());
+      decompressBlock(codec_, data, size, iter->size, decompressed.get());
+      cache->storeBlock(cache_key, decompressed);
+      block = decompressed;
+    }
+
+    block_ = block;
+    block_index_ = iter - blocks_.begin();
+    return true;
+  }
+
+  std::string filename_;
+  std::unique_ptr<sstable::SSTableReader> reader_;
+  std::unique_ptr<sstable::Cursor> cursor_;
+  uint32_t codec_;
+  size_t body_size_;
+  std::vector<Block> blocks_;
+  size_t pos_;
+  size_t block_index_;
+  std::shared_ptr<const std::string> block_;
+};
+
+std::unique_ptr<sstable::Cursor> ColdTable::openCursor(
+    const std::string& filename,
+    std::unique_ptr<sstable::SSTableReader> reader) {
+  return std::unique_ptr<sstable::Cursor>(
+      new ColdTableCursor(filename, std::move(reader)));
+}
+
+BlockCache* BlockCache::get() {
+  static BlockCache cache;
+  return &cache;
+}
+
+BlockCache::BlockCache(size_t max_size /* = kDefaultMaxSize */) :
+    max_size_(max_size),
+    size_(0),
+    hits_(env()->stats()->counter("disk.block_cache_hits")),
+    misses_(env()->stats()->counter("disk.block_cache_misses")),
+    mutex_("disk.block_cache") {}
+
+std::shared_ptr<const std::string> BlockCache::findBlock(
+    const std::string& key) {
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
+
+  auto iter = blocks_.find(key);
+  if (iter == blocks_.end()) {
+    misses_->incr();
+    return std::shared_ptr<const std::string>(nullptr);
+  }
+
+  hits_->incr();
+  lru_.splice(lru_.begin(), lru_, iter->second);
+  return iter->second->second;
+}
+
+void BlockCache::storeBlock(
+    const std::string& key,
+    std::shared_ptr<const std::string> block) {
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
+
+  auto iter = blocks_.find(key);
+  if (iter != blocks_.end()) {
+    size_ -= iter->second->second->size();
+    lru_.erase(iter->second);
+    blocks_.erase(iter);
+  }
+
+  lru_.emplace_front(key, block);
+  blocks_.emplace(key, lru_.begin());
+  size_ += block->size();
+
+  /* the newest block is kept even if it is larger than the cache */
+  while (size_ > max_size_ && lru_.size() > 1) {
+    const auto& entry = lru_.back();
+    size_ -= entry.second->size();
+    blocks_.erase(entry.first);
+    lru_.pop_back();
+  }
+}
+
+size_t BlockCache::size() const {
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
+  return size_;
+}
+
+}
+}
+}
@@ -0,0 +1,119 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_COLDTABLE_H
+#define _FNORDMETRIC_METRICDB_COLDTABLE_H
+#include <stdlib.h>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <fnordmetric/sstable/cursor.h>
+#include <fnordmetric/sstable/sstablereader.h>
+#include <fnordmetric/stats/counter.h>
+#include <fnordmetric/stats/profiledmutex.h>
+
+using namespace fnord;
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+
+/**
+ * A cold table is a copy of a finalized table whose body is split into
+ * blocks of about kBlockSize bytes that are compressed separately. Every
+ * block is one row with the body offset and the size of the original rows as
+ * the key and the compressed rows as the data. The header and the footers of
+ * the original table are copied, and the cold table footer stores the codec
+ * and the size of the original body.
+ *
+ * The cursor of a cold table returns the rows and body offsets of the
+ * original table and only decompresses the blocks it reads (see BlockCache).
+ */
+class ColdTable {
+public:
+  static const uint32_t kIndexType = 0xa0fa;
+  static const size_t kBlockSize = 1 << 16; /* 64KB */
+  static const size_t kBlockKeySize = 2 * sizeof(uint64_t);
+
+  static const uint32_t kCodecNone = 0;
+  static const uint32_t kCodecZlib = 1;
+
+  /**
+   * zlib if FnordMetric was compiled with zlib, none otherwise
+   */
+  static const uint32_t kDefaultCodec;
+
+  /**
+   * Write a cold copy of the finalized table in source_filename. Removes the
+   * new file if the copy fails
+   */
+  static void writeTable(
+      const std::string& filename,
+      const std::string& source_filename,
+      uint32_t codec = kDefaultCodec);
+
+  /**
+   * Returns true and stores the codec and the size of the original body if
+   * the sstable is a cold table
+   */
+  static bool readFooter(
+      sstable::SSTableReader* reader,
+      uint32_t* codec,
+      size_t* body_size);
+
+  /**
+   * Returns a cursor over the rows of the original table
+   */
+  static std::unique_ptr<sstable::Cursor> openCursor(
+      const std::string& filename,
+      std::unique_ptr<sstable::SSTableReader> reader);
+};
+
+/**
+ * A size bounded LRU cache of the decompressed blocks of all cold tables
+ */
+class BlockCache {
+public:
+  static const size_t kDefaultMaxSize = 1 << 26; /* 64MB */
+
+  /**
+   * Returns the cache that is shared by all cold tables
+   */
+  static BlockCache* get();
+
+  explicit BlockCache(size_t max_size = kDefaultMaxSize);
+
+  /**
+   * Returns nullptr if the block is not in the cache
+   */
+  std::shared_ptr<const std::string> findBlock(const std::string& key);
+
+  void storeBlock(
+      const std::string& key,
+      std::shared_ptr<const std::string> block);
+
+  size_t size() const;
+
+protected:
+  typedef std::pair<std::string, std::shared_ptr<const std::string>> Entry;
+
+  size_t max_size_;
+  size_t size_;
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> blocks_;
+  fnord::stats::Counter* hits_;
+  fnord::stats::Counter* misses_;
+  mutable fnord::stats::ProfiledMutex mutex_;
+};
+
+}
+}
+}
+
+#endif
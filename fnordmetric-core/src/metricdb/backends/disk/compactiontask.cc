@@ -10,8 +10,9 @@
 #include <fnordmetric/environment.h>
 #include <fnordmetric/metricdb/backends/disk/compactiontask.h>
 #include <fnordmetric/metricdb/backends/disk/metricrepository.h>
+#include <fnordmetric/stats/allocationscope.h>
+#include <fnordmetric/thread/task.h>
 #include <fnordmetric/util/wallclock.h>
-#include <unistd.h>
 
 using fnord::util::WallClock;
 
@@ -20,42 +21,71 @@ namespace metricdb {
 namespace disk_backend {
 
 CompactionTask::CompactionTask(
-    MetricRepository* metric_repo) :
+    MetricRepository* metric_repo,
+    fnord::thread::TaskScheduler* scheduler) :
     metric_repo_(metric_repo),
-    run_every_micros_(kRunEveryMicrosDefault) {}
+    scheduler_(scheduler),
+    run_every_micros_(kRunEveryMicrosDefault),
+    run_micros_(env()->stats()->histogram("disk.compaction_run_micros")),
+    num_metrics_(env()->stats()->gauge("disk.metrics")),
+    num_tables_(env()->stats()->gauge("disk.tables")),
+    max_tables_per_metric_(
+        env()->stats()->gauge("disk.max_tables_per_metric")) {}
 
-std::function<void()> CompactionTask::runnable() const {
-  return [this] () -> void { run(); };
+void CompactionTask::start() const {
+  scheduler_->runAfter(
+      fnord::thread::Task::create([this] () -> void { run(); }),
+      run_every_micros_,
+      fnord::thread::TaskScheduler::PRIORITY_LOW);
 }
 
 void CompactionTask::run() const {
-  auto last_run = WallClock::unixMicros();
+  fnord::stats::AllocationScope allocation_scope(
+      fnord::stats::AllocationStats::SUBSYSTEM_STORAGE);
 
-  for (;;) {
-    auto next_run = last_run + run_every_micros_;
-    auto now = WallClock::unixMicros();
-    last_run = now;
+  auto run_start = WallClock::unixMicros();
+  auto metrics = metric_repo_->listMetrics();
+  size_t num_tables = 0;
+  size_t max_tables = 0;
 
-    if (now < next_run) {
-      usleep(next_run - now);
-    }
+  for (const auto& metric : metrics) {
+    try {
+      auto disk_metric = dynamic_cast<Metric*>(metric);
 
-    for (const auto& metric : metric_repo_->listMetrics()) {
-      try {
-        auto disk_metric = dynamic_cast<Metric*>(metric);
+      if (disk_metric != nullptr) {
+        disk_metric->compact();
 
-        if (disk_metric != nullptr) {
-          disk_metric->compact();
+        auto metric_tables = disk_metric->numTables();
+        num_tables += metric_tables;
+        if (metric_tables > max_tables) {
+          max_tables = metric_tables;
         }
-      } catch (util::RuntimeException e) {
-        env()->logger()->printf(
-            "ERROR",
-            "uncaught exception while executing Metric#compact(): %s\n");
-
-        e.debugPrint();
       }
+    } catch (util::RuntimeException e) {
+      env()->logger()->printf(
+          "ERROR",
+          "uncaught exception while executing Metric#compact(): %s\n");
+
+      e.debugPrint();
     }
   }
+
+  /* after the metrics, so the segments see the newest live tables */
+  try {
+    metric_repo_->compactSegments();
+  } catch (util::RuntimeException e) {
+    env()->logger()->printf(
+        "ERROR",
+        "uncaught exception while compacting segments: %s",
+        e.getMessage().c_str());
+  }
+
+  run_micros_->insert(WallClock::unixMicros() - run_start);
+  num_metrics_->set(metrics.size());
+  num_tables_->set(num_tables);
+  max_tables_per_metric_->set(max_tables);
+
+  start();
 }
 
 }
@@ -10,22 +10,46 @@
 #ifndef _FNORDMETRIC_METRICDB_COMPACTIONTASK_H_
 #define _FNORDMETRIC_METRICDB_COMPACTIONTASK_H_
 #include <functional>
+#include <fnordmetric/stats/gauge.h>
+#include <fnordmetric/stats/histogram.h>
+#include <fnordmetric/thread/taskscheduler.h>
 
 namespace fnordmetric {
 namespace metricdb {
 namespace disk_backend {
 class MetricRepository;
 
+/**
+ * Compacts all metrics and then the sealed segments every run_every_micros.
+ * Each run is a low priority task
+ * that schedules the next run on the task scheduler when it is done, so no
+ * thread is blocked between two runs.
+ *
+ * After each run, the number of metrics and tables is published as
+ * "disk.metrics", "disk.tables" and "disk.max_tables_per_metric".
+ */
 class CompactionTask {
 public:
   static const uint64_t kRunEveryMicrosDefault = 30 * 1000000;
 
-  CompactionTask(MetricRepository* metric_repo);
-  std::function<void()> runnable() const;
+  CompactionTask(
+      MetricRepository* metric_repo,
+      fnord::thread::TaskScheduler* scheduler);
+
+  /**
+   * Schedule the first run
+   */
+  void start() const;
+
 protected:
   void run() const;
   MetricRepository* metric_repo_;
+  fnord::thread::TaskScheduler* scheduler_;
   uint64_t run_every_micros_;
+  fnord::stats::Histogram* run_micros_;
+  fnord::stats::Gauge* num_metrics_;
+  fnord::stats::Gauge* num_tables_;
+  fnord::stats::Gauge* max_tables_per_metric_;
 };
 
 
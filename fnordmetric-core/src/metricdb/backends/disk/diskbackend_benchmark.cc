@@ -0,0 +1,144 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fnordmetric/io/file.h>
+#include <fnordmetric/io/filerepository.h>
+#include <fnordmetric/io/fileutil.h>
+#include <fnordmetric/metricdb/backends/disk/metric.h>
+#include <fnordmetric/metricdb/backends/disk/samplewriter.h>
+#include <fnordmetric/metricdb/backends/disk/tokenindex.h>
+#include <fnordmetric/sstable/sstablewriter.h>
+#include <fnordmetric/util/benchmark.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+using namespace fnordmetric::metricdb::disk_backend;
+using namespace fnordmetric::metricdb;
+using namespace fnord::io;
+using namespace fnord::sstable;
+
+/**
+ * Disk backend hot paths: encoding samples with the SampleWriter, appending
+ * rows to a live sstable, scanning a metric with a MetricCursor and looking
+ * up label tokens in the TokenIndex. All fixtures are generated below
+ * kBenchmarkRepoPath
+ */
+BENCHMARK_SUITE(DiskBackendBenchmark);
+
+const char kBenchmarkRepoPath[] = "/tmp/__fnordmetric_benchmark_metricrepo";
+const char kBenchmarkSSTablePath[] =
+    "/tmp/__fnordmetric_benchmark_metricrepo/append.sst";
+
+static const uint64_t kNumRows = 1000;
+static const uint64_t kNumScanSamples = 100000;
+static const uint64_t kNumTokens = 10000;
+
+using LabelListType = std::vector<std::pair<std::string, std::string>>;
+
+static std::vector<LabelListType> sample_labels;
+static std::vector<std::string> encoded_rows;
+static std::vector<std::string> tokens;
+static std::unique_ptr<FileRepository> file_repo;
+static std::unique_ptr<Metric> scan_metric;
+static std::unique_ptr<SSTableWriter> sstable_writer;
+static TokenIndex token_index;
+
+BENCHMARK_INITIALIZER(DiskBackendBenchmark, GenerateFixtures, [] () {
+  FileUtil::mkdir_p(kBenchmarkRepoPath);
+  file_repo.reset(new FileRepository(kBenchmarkRepoPath));
+  file_repo->deleteAllFiles();
+
+  char buf[64];
+  for (int i = 0; i < kNumTokens; ++i) {
+    snprintf(buf, sizeof(buf), "host-%05i.dc%i.example.com", i, i % 4);
+    tokens.emplace_back(buf);
+    token_index.addToken(tokens.back());
+  }
+
+  for (int i = 0; i < kNumRows; ++i) {
+    LabelListType labels;
+    labels.emplace_back("host", tokens[i % kNumTokens]);
+    labels.emplace_back("path", i % 2 ? "/api/v1/items" : "/api/v1/users");
+    sample_labels.emplace_back(labels);
+
+    SampleWriter writer(&token_index);
+    writer.writeValue(i * 1.5);
+    for (const auto& label : labels) {
+      writer.writeLabel(label.first, label.second);
+    }
+
+    encoded_rows.emplace_back((char*) writer.data(), writer.size());
+  }
+
+  scan_metric.reset(new Metric("benchmark.scan", file_repo.get()));
+  for (int i = 0; i < kNumScanSamples; ++i) {
+    scan_metric->insertSample(
+        fmod(i * 23.5, 4200.0),
+        sample_labels[i % sample_labels.size()]);
+  }
+
+  scan_metric->compact();
+
+  File::openFile(
+      kBenchmarkSSTablePath,
+      File::O_READ | File::O_WRITE | File::O_CREATEOROPEN | File::O_TRUNCATE);
+
+  IndexProvider indexes;
+  sstable_writer = SSTableWriter::create(
+      kBenchmarkSSTablePath,
+      std::move(indexes),
+      nullptr,
+      0);
+});
+
+BENCHMARK_CASE(DiskBackendBenchmark, SampleWriter, kNumRows, [] () {
+  for (int i = 0; i < kNumRows; ++i) {
+    SampleWriter writer(&token_index);
+    writer.writeValue(i * 1.5);
+    for (const auto& label : sample_labels[i]) {
+      writer.writeLabel(label.first, label.second);
+    }
+  }
+});
+
+BENCHMARK_CASE(DiskBackendBenchmark, SSTableAppendRow, kNumRows, [] () {
+  static uint64_t time = 0;
+
+  for (const auto& row : encoded_rows) {
+    ++time;
+    sstable_writer->appendRow(&time, sizeof(time), row.data(), row.size());
+  }
+});
+
+BENCHMARK_CASE(DiskBackendBenchmark, MetricCursorScan, kNumScanSamples, [] () {
+  uint64_t num_samples = 0;
+
+  scan_metric->scanSamples(
+      fnord::util::DateTime::epoch(),
+      fnord::util::DateTime::now(),
+      [&num_samples] (Sample* sample) -> bool {
+        num_samples++;
+        return true;
+      });
+
+  if (num_samples != kNumScanSamples) {
+    RAISE(kRuntimeError, "scanned the wrong number of samples");
+  }
+});
+
+BENCHMARK_CASE(DiskBackendBenchmark, TokenIndexLookup, kNumTokens, [] () {
+  for (const auto& token : tokens) {
+    if (token_index.findToken(token) == 0) {
+      RAISE(kRuntimeError, "token not found");
+    }
+  }
+});
@@ -9,13 +9,18 @@
  */
 #include <fnordmetric/environment.h>
 #include <fnordmetric/io/fileutil.h>
+#include <fnordmetric/metricdb/backends/disk/bulkloader.h>
+#include <fnordmetric/metricdb/backends/disk/coldtable.h>
 #include <fnordmetric/metricdb/backends/disk/metric.h>
+#include <fnordmetric/metricdb/backends/disk/segment.h>
+#include <fnordmetric/metricdb/database.h>
 #include <fnordmetric/util/unittest.h>
 #include <fnordmetric/util/wallclock.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
 
 using namespace fnordmetric::metricdb::disk_backend;
 using namespace fnordmetric::metricdb;
@@ -24,6 +29,8 @@ using namespace fnord::io;
 UNIT_TEST(DiskBackendTest);
 
 const char kTestRepoPath[] = "/tmp/__fnordmetric_test_metricrepo2";
+const char kTestDatabasePath[] = "/tmp/__fnordmetric_test_database";
+const char kTestColdRepoPath[] = "/tmp/__fnordmetric_test_coldrepo";
 
 using LabelListType = std::vector<std::pair<std::string, std::string>>;
 
@@ -62,11 +69,13 @@ TEST_CASE(DiskBackendTest, TestCreateNewMetric, [] () {
     metric.insertSample(seq1(i), smpl_labels);
   }
 
+  /* series tables don't store the labels of every sample */
   size_t total_bytes = metric.totalBytes();
   metric.compact();
-  EXPECT_EQ(metric.totalBytes(), total_bytes);
+  EXPECT(metric.totalBytes() < total_bytes);
 
   n = 0;
+  IMetric::ScanStats stats;
   metric.scanSamples(
       util::DateTime::epoch(),
       util::DateTime::now(),
@@ -74,11 +83,831 @@ TEST_CASE(DiskBackendTest, TestCreateNewMetric, [] () {
         EXPECT_EQ(sample->value(), seq1(n));
         n++;
         return true;
-      });
+      },
+      &stats);
 
   EXPECT_EQ(n, num_saples);
+  EXPECT_EQ(stats.tables_opened, metric.numTables());
+  EXPECT_EQ(stats.tables_skipped, 0);
+  EXPECT(stats.bytes_read > num_saples * sizeof(uint64_t));
+});
+
+
+
+
+
+TEST_CASE(DiskBackendTest, TestInsertSamplesBatch, [] () {
+  io::FileUtil::mkdir_p(kTestRepoPath);
+  FileRepository file_repo(kTestRepoPath);
+  file_repo.deleteAllFiles();
+
+  Metric metric("mybatchmetric", &file_repo);
+  metric.setLiveTableMaxSize(1 << 16);
+
+  std::vector<IMetric::BatchSample> batch;
+  for (int i = 0; i < 10000; ++i) {
+    IMetric::BatchSample sample;
+    sample.time = 0;
+    sample.value = i;
+    sample.labels.emplace_back("host", "host" + std::to_string(i % 10));
+    batch.emplace_back(sample);
+  }
+
+  metric.insertSamples(batch);
+
+  /* the batch rolls over to new live tables like single inserts */
+  EXPECT(metric.numTables() > 1);
+
+  int n = 0;
+  metric.scanSamples(
+      util::DateTime::epoch(),
+      util::DateTime::now(),
+      [&n] (Sample* sample) -> bool {
+        EXPECT_EQ(sample->value(), n);
+        EXPECT_EQ(sample->labels()[0].second, "host" + std::to_string(n % 10));
+        n++;
+        return true;
+      });
+
+  EXPECT_EQ(n, 10000);
+
+  /* a sample with duplicate labels rejects the whole batch */
+  batch[5].labels.emplace_back("host", "other");
+  EXPECT_EXCEPTION("duplicate label: host", [&] () {
+    metric.insertSamples(batch);
+  });
+});
+
+TEST_CASE(DiskBackendTest, TestOutOfOrderSamples, [] () {
+  io::FileUtil::mkdir_p(kTestRepoPath);
+  FileRepository file_repo(kTestRepoPath);
+  file_repo.deleteAllFiles();
+
+  Metric metric("myunorderedmetric", &file_repo);
+  metric.setReorderWindowMicros(3600 * 1000000llu);
+
+  const uint64_t base = 1000000;
+  std::vector<IMetric::BatchSample> batch(1000);
+
+  /* the even and then the odd sample times */
+  for (int odd = 0; odd < 2; ++odd) {
+    for (int i = 0; i < batch.size(); ++i) {
+      batch[i].time = base + i * 2 + odd;
+      batch[i].value = i * 2 + odd;
+    }
+
+    metric.insertSamples(batch);
+  }
+
+  /* all odd samples but the newest are older than the live table */
+  EXPECT_EQ(metric.numReorderedSamples(), 999);
+  EXPECT_EQ(metric.numTables(), 1);
+
+  auto expectOrdered = [&metric] (uint64_t begin, int num_samples) {
+    int n = 0;
+    metric.scanSamples(
+        util::DateTime(begin),
+        util::DateTime::now(),
+        [&n, begin] (Sample* sample) -> bool {
+          EXPECT_EQ(static_cast<uint64_t>(sample->time()), begin + n);
+          EXPECT_EQ(sample->value(), begin + n - base);
+          n++;
+          return true;
+        });
+
+    EXPECT_EQ(n, num_samples);
+  };
+
+  expectOrdered(base, 2000);
+  expectOrdered(base + 1500, 500);
+
+  /* the reorder buffer is written as a new table once the window passed */
+  metric.setReorderWindowMicros(0);
+  metric.compact();
+  EXPECT_EQ(metric.numReorderedSamples(), 0);
+  EXPECT_EQ(metric.numTables(), 2);
+
+  expectOrdered(base, 2000);
+  expectOrdered(base + 1999, 1);
+
+  IMetric::ScanStats stats;
+  metric.scanSamples(
+      util::DateTime(base + 5000),
+      util::DateTime::now(),
+      [] (Sample* sample) -> bool { return true; },
+      &stats);
+
+  EXPECT_EQ(stats.tables_opened, 0);
+  EXPECT_EQ(stats.tables_skipped, 2);
+
+  uint64_t seq;
+  EXPECT_EQ(metric.lateSamplesMinTime(0, &seq), base);
+  EXPECT_EQ(seq, 2);
+  EXPECT_EQ(metric.lateSamplesMinTime(1, &seq), base + 1);
+  EXPECT_EQ(metric.lateSamplesMinTime(2, &seq), UINT64_MAX);
 });
 
+TEST_CASE(DiskBackendTest, TestReorderRuns, [] () {
+  io::FileUtil::mkdir_p(kTestRepoPath);
+  FileRepository file_repo(kTestRepoPath);
+  file_repo.deleteAllFiles();
 
+  Metric metric("myreorderrunsmetric", &file_repo);
+  metric.setReorderWindowMicros(100000);
 
+  const uint64_t base = 1000000;
+  std::vector<IMetric::BatchSample> batch(1);
+  batch[0].time = base + 100;
+  batch[0].value = 100;
+  metric.insertSamples(batch);
 
+  /* one straggler per insert, newest first */
+  for (int i = 99; i >= 0; --i) {
+    batch[0].time = base + i;
+    batch[0].value = i;
+    metric.insertSamples(batch);
+  }
+
+  EXPECT_EQ(metric.numReorderedSamples(), 100);
+
+  auto expectOrdered = [&metric] (int num_samples) {
+    int n = 0;
+    metric.scanSamples(
+        util::DateTime(base),
+        util::DateTime::now(),
+        [&n] (Sample* sample) -> bool {
+          EXPECT_EQ(static_cast<uint64_t>(sample->time()), base + n);
+          EXPECT_EQ(sample->value(), n);
+          n++;
+          return true;
+        });
+
+    EXPECT_EQ(n, num_samples);
+  };
+
+  expectOrdered(101);
+
+  /* a small buffer doesn't get a table of its own once the window passed */
+  usleep(200000);
+  metric.compact();
+  EXPECT_EQ(metric.numReorderedSamples(), 100);
+  EXPECT_EQ(metric.numTables(), 1);
+
+  /* but is written into the next live table */
+  metric.setLiveTableMaxSize(1);
+  batch[0].time = base + 101;
+  batch[0].value = 101;
+  metric.insertSamples(batch);
+  EXPECT_EQ(metric.numReorderedSamples(), 0);
+  EXPECT_EQ(metric.numTables(), 2);
+
+  expectOrdered(102);
+});
+
+TEST_CASE(DiskBackendTest, TestLateSampleLog, [] () {
+  io::FileUtil::mkdir_p(kTestRepoPath);
+  FileRepository file_repo(kTestRepoPath);
+  file_repo.deleteAllFiles();
+
+  Metric metric("mylatemetric", &file_repo);
+  std::vector<IMetric::BatchSample> batch(1);
+  batch[0].value = 1;
+
+  /* batches beyond the log size are merged into the oldest entry */
+  const uint64_t base = 1000000;
+  uint64_t num_batches = IMetric::kMaxLateSampleLog + 10;
+  for (uint64_t i = 0; i < num_batches; ++i) {
+    batch[0].time = base + i;
+    metric.insertSamples(batch);
+  }
+
+  uint64_t seq;
+  EXPECT_EQ(metric.lateSamplesMinTime(0, &seq), base);
+  EXPECT_EQ(seq, num_batches);
+  EXPECT_EQ(metric.lateSamplesMinTime(20, &seq), base + 20);
+  EXPECT_EQ(
+      metric.lateSamplesMinTime(num_batches - 1, &seq),
+      base + num_batches - 1);
+
+  /* client timestamps that are a bit older than now are not late */
+  batch[0].time = fnord::util::WallClock::unixMicros() - 1000000;
+  metric.insertSamples(batch);
+  EXPECT_EQ(metric.lateSamplesMinTime(num_batches, &seq), UINT64_MAX);
+  EXPECT_EQ(seq, num_batches);
+});
+
+TEST_CASE(DiskBackendTest, TestReopenOutOfOrderSamples, [] () {
+  io::FileUtil::mkdir_p(kTestDatabasePath);
+  FileRepository(kTestDatabasePath).deleteAllFiles();
+
+  {
+    Database db(kTestDatabasePath);
+
+    /* newest first; the database writes the reorder buffer when closed */
+    std::vector<IMetric::BatchSample> batch(100);
+    for (int i = 0; i < batch.size(); ++i) {
+      batch[i].time = (100 - i) * 1000000llu;
+      batch[i].value = 100 - i;
+    }
+
+    db.insertSamples("reopen_test", batch);
+  }
+
+  Database db(kTestDatabasePath);
+  std::vector<double> values;
+  db.executeQuery(
+      "SELECT value FROM reopen_test;",
+      [&values] (const Database::ResultBatch& result) {
+        for (const auto& row : result.rows) {
+          values.emplace_back(row[0].getValue<fnordmetric::FloatType>());
+        }
+      });
+
+  EXPECT_EQ(values.size(), 100);
+  for (int i = 0; i < values.size(); ++i) {
+    EXPECT(values[i] == i + 1);
+  }
+});
+
+TEST_CASE(DiskBackendTest, TestEmbeddedDatabase, [] () {
+  io::FileUtil::mkdir_p(kTestDatabasePath);
+  FileRepository(kTestDatabasePath).deleteAllFiles();
+
+  {
+    Database db(kTestDatabasePath);
+
+    std::vector<IMetric::BatchSample> batch(2500);
+    for (int i = 0; i < batch.size(); ++i) {
+      batch[i].time = 0;
+      batch[i].value = i;
+      batch[i].labels.emplace_back("host", i % 2 ? "web01" : "web02");
+    }
+
+    db.insertSamples("embedded_test", batch);
+    EXPECT_EQ(db.listMetrics().size(), 1);
+  }
+
+  Database db(kTestDatabasePath);
+  EXPECT(db.findMetric("embedded_test") != nullptr);
+
+  std::vector<size_t> batch_sizes;
+  double sum = 0;
+  db.executeQuery(
+      "SELECT host, value FROM embedded_test;",
+      [&] (const Database::ResultBatch& result) {
+        EXPECT_EQ(result.columns.size(), 2);
+        EXPECT_EQ(result.last, batch_sizes.size() == 2);
+        batch_sizes.emplace_back(result.rows.size());
+
+        for (const auto& row : result.rows) {
+          sum += row[1].getValue<fnordmetric::FloatType>();
+        }
+      });
+
+  EXPECT_EQ(batch_sizes.size(), 3);
+  EXPECT_EQ(batch_sizes[0], Database::kResultBatchSize);
+  EXPECT_EQ(batch_sizes[2], 2500 - 2 * Database::kResultBatchSize);
+  EXPECT(sum == 2499 * 2500 / 2);
+});
+
+TEST_CASE(DiskBackendTest, TestBulkLoader, [] () {
+  io::FileUtil::mkdir_p(kTestDatabasePath);
+  FileRepository(kTestDatabasePath).deleteAllFiles();
+
+  {
+    Database db(kTestDatabasePath);
+
+    std::vector<IMetric::BatchSample> batch(10);
+    for (int i = 0; i < batch.size(); ++i) {
+      batch[i].time = (i + 1) * 1000000llu;
+      batch[i].value = i + 1;
+      batch[i].labels.emplace_back("host", "web01");
+    }
+
+    db.insertSamples("bulk_test", batch);
+  }
+
+  {
+    /* small limits to spill sorted runs and to write several tables */
+    BulkLoader loader(kTestDatabasePath, 2, 16384);
+    loader.setTableMaxSize(4096);
+
+    for (int i = 0; i < 1000; ++i) {
+      auto n = 11 + (i * 7919) % 1000;
+      LabelListType labels;
+      labels.emplace_back("host", "web02");
+      loader.addSample("bulk_test", n * 1000000llu, n, labels);
+      loader.addSample("bulk_test2", n * 1000000llu, n, LabelListType());
+    }
+
+    EXPECT(loader.numRuns() > 0);
+    loader.finish();
+    EXPECT_EQ(loader.numSamples(), 2000);
+    EXPECT_EQ(loader.numMetrics(), 2);
+    EXPECT(loader.numTables() > 2);
+  }
+
+  Database db(kTestDatabasePath);
+  std::vector<double> values;
+  std::vector<std::string> hosts;
+  db.executeQuery(
+      "SELECT value, host FROM bulk_test;",
+      [&values, &hosts] (const Database::ResultBatch& result) {
+        for (const auto& row : result.rows) {
+          values.emplace_back(row[0].getValue<fnordmetric::FloatType>());
+          hosts.emplace_back(row[1].toString());
+        }
+      });
+
+  EXPECT_EQ(values.size(), 1010);
+  for (int i = 0; i < values.size(); ++i) {
+    EXPECT(values[i] == i + 1);
+    EXPECT_EQ(hosts[i], i < 10 ? "web01" : "web02");
+  }
+
+  size_t num_rows = 0;
+  db.executeQuery(
+      "SELECT value FROM bulk_test2;",
+      [&num_rows] (const Database::ResultBatch& result) {
+        num_rows += result.rows.size();
+      });
+
+  EXPECT_EQ(num_rows, 1000);
+
+  /* new samples continue the generation chain of the loaded tables */
+  std::vector<IMetric::BatchSample> batch(1);
+  batch[0].time = 2000 * 1000000llu;
+  batch[0].value = 2000;
+  db.insertSamples("bulk_test", batch);
+
+  num_rows = 0;
+  db.executeQuery(
+      "SELECT value FROM bulk_test;",
+      [&num_rows] (const Database::ResultBatch& result) {
+        num_rows += result.rows.size();
+      });
+
+  EXPECT_EQ(num_rows, 1011);
+});
+
+/* returns the number of samples if all of them have the label host=<host> */
+static int countSegmentSamples(Metric* metric, const std::string& host) {
+  int n = 0;
+  metric->scanSamples(
+      util::DateTime::epoch(),
+      util::DateTime::now(),
+      [&n, &host] (Sample* sample) -> bool {
+        EXPECT_EQ(sample->value(), n);
+        EXPECT_EQ(sample->labels()[0].second, host);
+        n++;
+        return true;
+      });
+
+  return n;
+}
+
+TEST_CASE(DiskBackendTest, TestSegments, [] () {
+  io::FileUtil::mkdir_p(kTestRepoPath);
+  FileRepository file_repo(kTestRepoPath);
+  file_repo.deleteAllFiles();
+
+  {
+    SegmentRepository segment_repo(&file_repo, 4096, 1024);
+
+    Metric hot_metric("segment_hot_metric", &file_repo);
+    hot_metric.setSegmentRepository(&segment_repo);
+
+    std::vector<std::unique_ptr<Metric>> metrics;
+    for (int i = 0; i < 20; ++i) {
+      metrics.emplace_back(
+          new Metric("segment_metric" + std::to_string(i), &file_repo));
+      metrics.back()->setSegmentRepository(&segment_repo);
+    }
+
+    for (int j = 0; j < 100; ++j) {
+      std::vector<IMetric::BatchSample> batch(1);
+      batch[0].time = (j + 1) * 1000000llu;
+      batch[0].value = j;
+      batch[0].labels.emplace_back("host", "hot");
+      hot_metric.insertSamples(batch);
+    }
+
+    for (int j = 0; j < 5; ++j) {
+      for (int i = 0; i < metrics.size(); ++i) {
+        std::vector<IMetric::BatchSample> batch(1);
+        batch[0].time = (j + 1) * 1000000llu;
+        batch[0].value = j;
+        batch[0].labels.emplace_back("host", "web" + std::to_string(i));
+        metrics[i]->insertSamples(batch);
+      }
+    }
+
+    /* the hot metric continues in its own tables */
+    EXPECT(hot_metric.numTables() > 1);
+
+    size_t num_files = 0;
+    file_repo.listFiles([&num_files] (const std::string& filename) -> bool {
+      ++num_files;
+      return true;
+    });
+
+    EXPECT(num_files < 5);
+    auto num_segments = segment_repo.numLiveSegments();
+    EXPECT(num_segments > 1);
+
+    for (int i = 0; i < metrics.size(); ++i) {
+      EXPECT_EQ(
+          countSegmentSamples(metrics[i].get(), "web" + std::to_string(i)),
+          5);
+    }
+
+    EXPECT_EQ(countSegmentSamples(&hot_metric, "hot"), 100);
+
+    /* only the sealed segments are compacted */
+    segment_repo.compact(0);
+    EXPECT(segment_repo.numLiveSegments() < num_segments);
+
+    for (int i = 0; i < metrics.size(); ++i) {
+      metrics[i]->compact();
+      EXPECT_EQ(
+          countSegmentSamples(metrics[i].get(), "web" + std::to_string(i)),
+          5);
+    }
+
+    EXPECT_EQ(countSegmentSamples(&hot_metric, "hot"), 100);
+  }
+
+  SegmentRepository segment_repo(&file_repo, 4096, 1024);
+  SegmentRepository::TableMap tables;
+  segment_repo.openTables(&tables);
+  EXPECT_EQ(tables.size(), 21);
+  EXPECT(tables["segment_metric0"][0]->isShared());
+
+  /* the compaction moved the first table of the hot metric into a file */
+  for (const auto& table : tables["segment_hot_metric"]) {
+    EXPECT(!table->isShared() || table->generation() > 1);
+  }
+
+  Metric hot_metric(
+      "segment_hot_metric",
+      &file_repo,
+      std::move(tables["segment_hot_metric"]));
+
+  Metric metric(
+      "segment_metric0",
+      &file_repo,
+      std::move(tables["segment_metric0"]));
+  EXPECT_EQ(countSegmentSamples(&hot_metric, "hot"), 100);
+  EXPECT_EQ(countSegmentSamples(&metric, "web0"), 5);
+
+  /* the moved table is partitioned by series */
+  EXPECT_EQ(hot_metric.numSeries(), 1);
+
+  /* reopened live segments are compacted on the next run */
+  segment_repo.compact(0);
+  EXPECT_EQ(segment_repo.numLiveSegments(), 0);
+  EXPECT_EQ(countSegmentSamples(&hot_metric, "hot"), 100);
+  EXPECT_EQ(countSegmentSamples(&metric, "web0"), 5);
+});
+
+/* returns the number of samples with the label host=<host> */
+static int countSeriesSamples(
+    Metric* metric,
+    const std::string& host,
+    IMetric::ScanStats* stats) {
+  LabelListType label_filter;
+  label_filter.emplace_back("host", host);
+
+  int n = 0;
+  uint64_t last_time = 0;
+  metric->scanSeries(
+      util::DateTime::epoch(),
+      util::DateTime::now(),
+      label_filter,
+      [&n, &label_filter, &last_time] (Sample* sample) -> bool {
+        EXPECT(static_cast<uint64_t>(sample->time()) > last_time);
+        EXPECT_EQ(sample->labels().size(), 2);
+        EXPECT(IMetric::matchLabels(sample->labels(), label_filter));
+        last_time = static_cast<uint64_t>(sample->time());
+        n++;
+        return true;
+      },
+      stats);
+
+  return n;
+}
+
+TEST_CASE(DiskBackendTest, TestSeriesTables, [] () {
+  io::FileUtil::mkdir_p(kTestRepoPath);
+  FileRepository file_repo(kTestRepoPath);
+  file_repo.deleteAllFiles();
+
+  {
+    Metric metric("series_metric", &file_repo);
+    metric.setLiveTableIdleTimeMicros(0);
+
+    std::vector<IMetric::BatchSample> batch(1000);
+    for (int i = 0; i < batch.size(); ++i) {
+      batch[i].time = (i + 1) * 1000000llu;
+      batch[i].value = i;
+      batch[i].labels.emplace_back("host", "web" + std::to_string(i % 10));
+      batch[i].labels.emplace_back("dc", "dc" + std::to_string(i % 2));
+    }
+
+    metric.insertSamples(batch);
+    EXPECT_EQ(countSeriesSamples(&metric, "web3", nullptr), 100);
+
+    metric.compact();
+    EXPECT_EQ(metric.numTables(), 1);
+    EXPECT_EQ(metric.numSeries(), 10);
+
+    /* all samples in time order with their labels */
+    IMetric::ScanStats full_stats;
+    int n = 0;
+    metric.scanSamples(
+        util::DateTime::epoch(),
+        util::DateTime::now(),
+        [&n] (Sample* sample) -> bool {
+          EXPECT_EQ(sample->value(), n);
+          EXPECT_EQ(sample->labels()[0].second, "dc" + std::to_string(n % 2));
+          EXPECT_EQ(
+              sample->labels()[1].second,
+              "web" + std::to_string(n % 10));
+          n++;
+          return true;
+        },
+        &full_stats);
+
+    EXPECT_EQ(n, 1000);
+
+    /* a label filter only reads the matching series */
+    IMetric::ScanStats stats;
+    EXPECT_EQ(countSeriesSamples(&metric, "web3", &stats), 100);
+    EXPECT(stats.bytes_read * 5 < full_stats.bytes_read);
+    EXPECT_EQ(countSeriesSamples(&metric, "web10", nullptr), 0);
+
+    LabelListType label_filter;
+    label_filter.emplace_back("dc", "dc0");
+    label_filter.emplace_back("host", "web3");
+    n = 0;
+    metric.scanSeries(
+        util::DateTime::epoch(),
+        util::DateTime::now(),
+        label_filter,
+        [&n] (Sample* sample) -> bool {
+          n++;
+          return true;
+        });
+
+    EXPECT_EQ(n, 0);
+
+    /* samples in live tables are filtered by their labels */
+    std::vector<IMetric::BatchSample> live_batch(10);
+    for (int i = 0; i < live_batch.size(); ++i) {
+      live_batch[i].time = (i + 1001) * 1000000llu;
+      live_batch[i].value = i + 1000;
+      live_batch[i].labels.emplace_back("host", "web" + std::to_string(i));
+      live_batch[i].labels.emplace_back("dc", "dc" + std::to_string(i % 2));
+    }
+
+    metric.insertSamples(live_batch);
+    EXPECT_EQ(countSeriesSamples(&metric, "web3", nullptr), 101);
+  }
+
+  /* the live tables were replaced by the series table */
+  SegmentRepository::TableMap tables;
+  SegmentRepository(&file_repo).openTables(&tables);
+  EXPECT_EQ(tables["series_metric"].size(), 2);
+
+  Metric metric(
+      "series_metric",
+      &file_repo,
+      std::move(tables["series_metric"]));
+
+  EXPECT_EQ(metric.numSeries(), 10);
+  EXPECT_EQ(countSeriesSamples(&metric, "web3", nullptr), 101);
+  EXPECT_EQ(countSeriesSamples(&metric, "web9", nullptr), 101);
+});
+
+static size_t repoSize(FileRepository* file_repo, int* num_files) {
+  size_t size = 0;
+  *num_files = 0;
+
+  file_repo->listFiles([&size, num_files] (const std::string& filename) {
+    size += File::openFile(filename, File::O_READ).size();
+    ++*num_files;
+    return true;
+  });
+
+  return size;
+}
+
+TEST_CASE(DiskBackendTest, TestColdTables, [] () {
+  io::FileUtil::mkdir_p(kTestRepoPath);
+  io::FileUtil::mkdir_p(kTestColdRepoPath);
+  FileRepository file_repo(kTestRepoPath);
+  FileRepository cold_repo(kTestColdRepoPath);
+  file_repo.deleteAllFiles();
+  cold_repo.deleteAllFiles();
+
+  int num_files;
+  int num_cold_files;
+
+  {
+    Metric metric("cold_metric", &file_repo);
+    metric.setLiveTableIdleTimeMicros(0);
+
+    std::vector<IMetric::BatchSample> batch(10000);
+    for (int i = 0; i < batch.size(); ++i) {
+      batch[i].time = (i + 1) * 1000000llu;
+      batch[i].value = i;
+      batch[i].labels.emplace_back("host", "web" + std::to_string(i % 10));
+      batch[i].labels.emplace_back("dc", "dc" + std::to_string(i % 2));
+    }
+
+    metric.insertSamples(batch);
+    metric.compact();
+    EXPECT_EQ(metric.numTables(), 1);
+
+    auto hot_size = repoSize(&file_repo, &num_files);
+    auto total_bytes = metric.totalBytes();
+    EXPECT_EQ(num_files, 1);
+
+    /* the samples are from 1970, so the next compaction moves the table */
+    metric.setColdStorage(&cold_repo, 3600 * 1000000llu);
+    metric.compact();
+    EXPECT_EQ(metric.numTables(), 1);
+    EXPECT_EQ(metric.totalBytes(), total_bytes);
+    EXPECT_EQ(repoSize(&file_repo, &num_files), 0);
+    EXPECT_EQ(num_files, 0);
+    auto cold_size = repoSize(&cold_repo, &num_cold_files);
+    EXPECT_EQ(num_cold_files, 1);
+    if (ColdTable::kDefaultCodec != ColdTable::kCodecNone) {
+      EXPECT(cold_size < hot_size);
+    }
+
+    int n = 0;
+    metric.scanSamples(
+        util::DateTime::epoch(),
+        util::DateTime::now(),
+        [&n] (Sample* sample) -> bool {
+          EXPECT_EQ(sample->value(), n);
+          EXPECT_EQ(sample->labels()[0].second, "dc" + std::to_string(n % 2));
+          EXPECT_EQ(
+              sample->labels()[1].second,
+              "web" + std::to_string(n % 10));
+          n++;
+          return true;
+        });
+
+    EXPECT_EQ(n, 10000);
+    EXPECT_EQ(countSeriesSamples(&metric, "web3", nullptr), 1000);
+
+    /* new samples stay in the datadir */
+    std::vector<IMetric::BatchSample> new_batch(10);
+    for (int i = 0; i < new_batch.size(); ++i) {
+      new_batch[i].value = i;
+      new_batch[i].labels.emplace_back("host", "web" + std::to_string(i));
+      new_batch[i].labels.emplace_back("dc", "dc" + std::to_string(i % 2));
+    }
+
+    metric.insertSamples(new_batch);
+    metric.compact();
+    EXPECT_EQ(metric.numTables(), 2);
+    repoSize(&file_repo, &num_files);
+    repoSize(&cold_repo, &num_cold_files);
+    EXPECT_EQ(num_files, 1);
+    EXPECT_EQ(num_cold_files, 1);
+  }
+
+  /* a move that was interrupted before the original file was removed */
+  file_repo.listFiles([&cold_repo] (const std::string& filename) -> bool {
+    ColdTable::writeTable(cold_repo.createFile().absolute_path, filename);
+    return true;
+  });
+
+  SegmentRepository::TableMap tables;
+  SegmentRepository(&file_repo).openTables(&tables, &cold_repo);
+  EXPECT_EQ(tables["cold_metric"].size(), 2);
+  EXPECT_EQ(repoSize(&file_repo, &num_files), 0);
+
+  Metric metric(
+      "cold_metric",
+      &file_repo,
+      std::move(tables["cold_metric"]));
+
+  EXPECT_EQ(metric.numSeries(), 10);
+  EXPECT_EQ(countSeriesSamples(&metric, "web3", nullptr), 1001);
+  EXPECT_EQ(countSeriesSamples(&metric, "web9", nullptr), 1001);
+});
+
+TEST_CASE(DiskBackendTest, TestBulkLoaderColdTables, [] () {
+  io::FileUtil::mkdir_p(kTestRepoPath);
+  io::FileUtil::mkdir_p(kTestColdRepoPath);
+  FileRepository file_repo(kTestRepoPath);
+  FileRepository cold_repo(kTestColdRepoPath);
+  file_repo.deleteAllFiles();
+  cold_repo.deleteAllFiles();
+
+  {
+    Metric metric("cold_bulk_metric", &file_repo);
+    metric.setLiveTableIdleTimeMicros(0);
+
+    std::vector<IMetric::BatchSample> batch(100);
+    for (int i = 0; i < batch.size(); ++i) {
+      batch[i].time = (i + 1) * 1000000llu;
+      batch[i].value = i;
+      batch[i].labels.emplace_back("host", "web" + std::to_string(i % 10));
+    }
+
+    metric.insertSamples(batch);
+    metric.compact();
+    metric.setColdStorage(&cold_repo, 3600 * 1000000llu);
+    metric.compact();
+  }
+
+  int num_files;
+  repoSize(&file_repo, &num_files);
+  EXPECT_EQ(num_files, 0);
+
+  /* the loaded tables continue the generation chain of the cold tables and
+     don't reuse their token ids */
+  {
+    BulkLoader loader(kTestRepoPath, 1, 1 << 20, "/tmp", kTestColdRepoPath);
+    for (int i = 0; i < 100; ++i) {
+      LabelListType labels;
+      labels.emplace_back("host", "db" + std::to_string(i % 10));
+      loader.addSample(
+          "cold_bulk_metric",
+          (i + 101) * 1000000llu,
+          i + 100,
+          labels);
+    }
+
+    loader.finish();
+  }
+
+  SegmentRepository::TableMap tables;
+  SegmentRepository(&file_repo).openTables(&tables, &cold_repo);
+  EXPECT_EQ(tables["cold_bulk_metric"].size(), 2);
+
+  Metric metric(
+      "cold_bulk_metric",
+      &file_repo,
+      std::move(tables["cold_bulk_metric"]));
+
+  /* the loaded tables are partitioned by series as well */
+  EXPECT_EQ(metric.numSeries(), 20);
+
+  LabelListType label_filter;
+  label_filter.emplace_back("host", "db3");
+  IMetric::ScanStats stats;
+  int num_matching = 0;
+  metric.scanSeries(
+      util::DateTime::epoch(),
+      util::DateTime::now(),
+      label_filter,
+      [&num_matching] (Sample* sample) -> bool {
+        EXPECT_EQ(sample->labels()[0].second, "db3");
+        num_matching++;
+        return true;
+      },
+      &stats);
+
+  EXPECT_EQ(num_matching, 10);
+
+  int n = 0;
+  metric.scanSamples(
+      util::DateTime::epoch(),
+      util::DateTime::now(),
+      [&n] (Sample* sample) -> bool {
+        EXPECT_EQ(sample->value(), n);
+        EXPECT_EQ(
+            sample->labels()[0].second,
+            (n < 100 ? "web" : "db") + std::to_string(n % 10));
+        n++;
+        return true;
+      });
+
+  EXPECT_EQ(n, 200);
+});
+
+TEST_CASE(DiskBackendTest, TestBlockCache, [] () {
+  BlockCache cache(100);
+
+  for (int i = 0; i < 3; ++i) {
+    std::shared_ptr<const std::string> block(new std::string(40, 'x'));
+    cache.storeBlock("block" + std::to_string(i), block);
+  }
+
+  EXPECT_EQ(cache.size(), 80);
+  EXPECT(cache.findBlock("block0").get() == nullptr);
+  EXPECT(cache.findBlock("block1").get() != nullptr);
+
+  /* block1 was used last, so block2 is evicted */
+  std::shared_ptr<const std::string> block(new std::string(40, 'y'));
+  cache.storeBlock("block3", block);
+  EXPECT(cache.findBlock("block2").get() == nullptr);
+  EXPECT(cache.findBlock("block1").get() != nullptr);
+  EXPECT_EQ(*cache.findBlock("block3"), *block);
+});
@@ -13,20 +13,20 @@ namespace fnordmetric {
 namespace metricdb  {
 namespace disk_backend {
 
-LabelIndex::LabelIndex() {}
+LabelIndex::LabelIndex() : mutex_("disk.label_index") {}
 
 void LabelIndex::addLabel(const std::string& label) {
-  std::lock_guard<std::mutex> lock_holder(mutex_);
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
   labels_.emplace(label);
 }
 
 bool LabelIndex::hasLabel(const std::string& label) const {
-  std::lock_guard<std::mutex> lock_holder(mutex_);
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
   return labels_.find(label) != labels_.end();
 }
 
 std::set<std::string> LabelIndex::labels() const {
-  std::lock_guard<std::mutex> lock_holder(mutex_);
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
   return labels_;
 }
 
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <string>
 #include <set>
+#include <fnordmetric/stats/profiledmutex.h>
 
 namespace fnordmetric {
 namespace metricdb  {
@@ -31,7 +32,7 @@ public:
 
 protected:
   std::set<std::string> labels_;
-  mutable std::mutex mutex_;
+  mutable fnord::stats::ProfiledMutex mutex_;
 };
 
 
@@ -12,9 +12,12 @@
 #include <fnordmetric/metricdb/backends/disk/metric.h>
 #include <fnordmetric/metricdb/backends/disk/tableref.h>
 #include <fnordmetric/metricdb/backends/disk/samplewriter.h>
+#include <fnordmetric/io/fileutil.h>
 #include <fnordmetric/util/runtimeexception.h>
 #include <fnordmetric/util/freeondestroy.h>
 #include <fnordmetric/util/wallclock.h>
+#include <algorithm>
+#include <iterator>
 #include <string.h>
 
 using namespace fnord;
@@ -24,16 +27,53 @@ namespace fnordmetric {
 namespace metricdb {
 namespace disk_backend {
 
+/* shared by all disk metrics */
+struct DiskMetricStats {
+  DiskMetricStats() :
+      samples_inserted(env()->stats()->counter("disk.samples_inserted")),
+      tables_created(env()->stats()->counter("disk.tables_created")),
+      tables_finalized(env()->stats()->counter("disk.tables_finalized")),
+      series_tables(env()->stats()->counter("disk.series_tables")),
+      cold_tables(env()->stats()->counter("disk.cold_tables")),
+      samples_reordered(env()->stats()->counter("disk.samples_reordered")),
+      reordered_runs(env()->stats()->counter("disk.reordered_runs")),
+      compactions(env()->stats()->counter("disk.compactions")),
+      compaction_micros(env()->stats()->histogram("disk.compaction_micros")) {}
+
+  stats::Counter* samples_inserted;
+  stats::Counter* tables_created;
+  stats::Counter* tables_finalized;
+  stats::Counter* series_tables;
+  stats::Counter* cold_tables;
+  stats::Counter* samples_reordered;
+  stats::Counter* reordered_runs;
+  stats::Counter* compactions;
+  stats::Histogram* compaction_micros;
+};
+
+static DiskMetricStats* diskMetricStats() {
+  static DiskMetricStats stats;
+  return &stats;
+}
+
 Metric::Metric(
     const std::string& key,
     io::FileRepository* file_repo) :
     IMetric(key),
     file_repo_(file_repo),
+    segment_repo_(nullptr),
+    cold_file_repo_(nullptr),
+    cold_age_micros_(kColdAgeMicros),
     head_(nullptr),
+    head_mutex_("disk.head"),
+    append_mutex_("disk.append"),
     max_generation_(0),
     live_table_max_size_(kLiveTableMaxSize),
     live_table_idle_time_micros_(kLiveTableIdleTimeMicros),
-    last_insert_(fnord::util::WallClock::unixMicros()) {} // FIXPAUL
+    last_insert_(fnord::util::WallClock::unixMicros()), // FIXPAUL
+    reorder_buffer_size_(0),
+    reorder_buffer_since_(0),
+    reorder_window_micros_(kReorderWindowMicros) {}
 
 Metric::Metric(
     const std::string& key,
@@ -41,9 +81,17 @@ Metric::Metric(
     std::vector<std::unique_ptr<TableRef>>&& tables) :
     IMetric(key),
     file_repo_(file_repo),
+    segment_repo_(nullptr),
+    cold_file_repo_(nullptr),
+    cold_age_micros_(kColdAgeMicros),
+    head_mutex_("disk.head"),
+    append_mutex_("disk.append"),
     live_table_max_size_(kLiveTableMaxSize),
     live_table_idle_time_micros_(kLiveTableIdleTimeMicros),
-    last_insert_(fnord::util::WallClock::unixMicros()) { // FIXPAUL
+    last_insert_(fnord::util::WallClock::unixMicros()), // FIXPAUL
+    reorder_buffer_size_(0),
+    reorder_buffer_since_(0),
+    reorder_window_micros_(kReorderWindowMicros) {
   TableRef* head_table = nullptr;
   std::vector<uint64_t> generations;
 
@@ -75,6 +123,7 @@ Metric::Metric(
 
       if (table->generation() == gen) {
         table->import(&token_index_, &label_index_);
+        table->importSeries(&series_index_);
         snapshot->appendTable(std::move(table));
         table.reset(nullptr);
       }
@@ -91,27 +140,55 @@ Metric::Metric(
   }
 }
 
+Metric::~Metric() {
+  try {
+    std::lock_guard<stats::ProfiledMutex> lock_holder(append_mutex_);
+    flushReorderBuffer(WallClock::unixMicros(), true);
+  } catch (util::RuntimeException& e) {
+    env()->logger()->printf(
+        "ERROR",
+        "error while writing the reorder buffer of metric '%s': %s",
+        key_.c_str(),
+        e.getMessage().c_str());
+  }
+}
+
 std::shared_ptr<MetricSnapshot> Metric::getSnapshot() const {
-  std::lock_guard<std::mutex> lock_holder(head_mutex_);
+  std::lock_guard<stats::ProfiledMutex> lock_holder(head_mutex_);
   return head_;
 }
 
 // Must hold append_mutex_ to call this!
 std::shared_ptr<MetricSnapshot> Metric::getOrCreateSnapshot() {
-  {
-    std::lock_guard<std::mutex> lock_holder(head_mutex_);
+  std::lock_guard<stats::ProfiledMutex> lock_holder(head_mutex_);
+
+  /* metrics that filled up their last table don't go into a segment */
+  bool shared = segment_repo_ != nullptr;
 
-    if (head_.get() != nullptr &&
-        head_->isWritable() &&
-        head_->tables().back()->isWritable() &&
-        head_->tables().back()->bodySize() < live_table_max_size_) {
-      return head_;
+  if (head_.get() != nullptr && !head_->tables().empty()) {
+    const auto& table = head_->tables().back();
+    auto max_size = table->isShared() && segment_repo_ != nullptr ?
+        segment_repo_->hotMetricSize() :
+        live_table_max_size_;
+
+    if (table->bodySize() < max_size) {
+      if (head_->isWritable() && table->isWritable()) {
+        return head_;
+      }
+    } else {
+      shared = false;
     }
   }
 
-  std::lock_guard<std::mutex> lock_holder(head_mutex_);
-  auto new_snapshot = createSnapshot(true);
-  head_ = new_snapshot;
+  head_ = createSnapshot(true, shared);
+
+  /* the new table starts with the reorder buffer, so small buffers don't
+     need a table of their own. later samples that are older than the
+     buffered ones go into the next reorder run, so the table stays sorted */
+  if (!reorder_runs_.empty()) {
+    writeReorderBuffer(head_->tables().back().get());
+  }
+
   return head_;
 }
 
@@ -125,17 +202,177 @@ void Metric::insertSampleImpl(
     label_index_.addLabel(label.first);
   }
 
-  std::lock_guard<std::mutex> lock_holder(append_mutex_);
-  auto snapshot = getOrCreateSnapshot();
-  auto& table = snapshot->tables().back();
+  std::lock_guard<stats::ProfiledMutex> lock_holder(append_mutex_);
+  uint64_t now = fnord::util::WallClock::unixMicros();
+  MemoryTableRef::RowList reordered;
+  appendSample(&writer, now, &reordered);
+  addReorderRun(&reordered, now);
+  flushReorderBuffer(now, false);
+  last_insert_ = now;
+  diskMetricStats()->samples_inserted->incr();
+}
 
+void Metric::insertSamplesImpl(const std::vector<BatchSample>& samples) {
+  std::vector<std::unique_ptr<SampleWriter>> writers;
+  writers.reserve(samples.size());
+
+  /* encode outside of the append lock */
+  for (const auto& sample : samples) {
+    writers.emplace_back(new SampleWriter(&token_index_));
+    writers.back()->writeValue(sample.value);
+    for (const auto& label : sample.labels) {
+      writers.back()->writeLabel(label.first, label.second);
+      label_index_.addLabel(label.first);
+    }
+  }
+
+  std::lock_guard<stats::ProfiledMutex> lock_holder(append_mutex_);
   uint64_t now = fnord::util::WallClock::unixMicros();
-  table->addSample(&writer, now);
+  MemoryTableRef::RowList reordered;
+
+  for (size_t i = 0; i < samples.size(); ++i) {
+    auto time = samples[i].time == 0 ? now : samples[i].time;
+    appendSample(writers[i].get(), time, &reordered);
+  }
+
+  addReorderRun(&reordered, now);
+  flushReorderBuffer(now, false);
   last_insert_ = now;
+  diskMetricStats()->samples_inserted->incr(samples.size());
+}
+
+void Metric::appendSample(
+    SampleWriter const* sample,
+    uint64_t time,
+    MemoryTableRef::RowList* reordered) {
+  auto snapshot = getOrCreateSnapshot();
+  auto& table = snapshot->tables().back();
+
+  uint64_t min_time;
+  uint64_t max_time;
+  if (!table->timeRange(&min_time, &max_time) || time >= max_time) {
+    table->addSample(sample->data(), sample->size(), time);
+    return;
+  }
+
+  reordered->emplace_back(
+      time,
+      std::string(static_cast<char*>(sample->data()), sample->size()));
+}
+
+static bool compareRowTime(
+    const std::pair<uint64_t, std::string>& a,
+    const std::pair<uint64_t, std::string>& b) {
+  return a.first < b.first;
+}
+
+void Metric::addReorderRun(MemoryTableRef::RowList* rows, uint64_t now) {
+  if (rows->empty()) {
+    return;
+  }
+
+  if (reorder_runs_.empty()) {
+    reorder_buffer_since_ = now;
+  }
+
+  reorder_buffer_size_ += rows->size();
+  diskMetricStats()->samples_reordered->incr(rows->size());
+
+  std::stable_sort(rows->begin(), rows->end(), compareRowTime);
+  reorder_runs_.emplace_back(new MemoryTableRef(key_, std::move(*rows)));
+
+  /* merge runs of similar size, so there are only O(log n) runs and every
+     sample is copied O(log n) times. scans may still use the old runs */
+  while (reorder_runs_.size() > 1) {
+    const auto& newer = reorder_runs_.back()->rows();
+    const auto& older = reorder_runs_[reorder_runs_.size() - 2]->rows();
+    if (older.size() > newer.size() * 2) {
+      break;
+    }
+
+    MemoryTableRef::RowList merged;
+    merged.reserve(older.size() + newer.size());
+    std::merge(
+        older.begin(),
+        older.end(),
+        newer.begin(),
+        newer.end(),
+        std::back_inserter(merged),
+        compareRowTime);
+
+    reorder_runs_.pop_back();
+    reorder_runs_.back().reset(new MemoryTableRef(key_, std::move(merged)));
+  }
+
+  if (reorder_buffer_size_ >= kReorderBufferMaxSamples) {
+    flushReorderBuffer(now, true);
+  }
+}
+
+void Metric::flushReorderBuffer(uint64_t now, bool force) {
+  if (reorder_runs_.empty()) {
+    return;
+  }
+
+  if (!force && now < reorder_buffer_since_ + reorder_window_micros_) {
+    return;
+  }
+
+  /* a small buffer would get a table of its own, so without a shared segment
+     it waits for the next live table (see getOrCreateSnapshot) */
+  if (!force &&
+      segment_repo_ == nullptr &&
+      reorder_buffer_size_ < kReorderRunMinSamples &&
+      now < reorder_buffer_since_ +
+          reorder_window_micros_ * kReorderSmallRunWindows) {
+    return;
+  }
+
+  /* all buffered samples are older than the newest sample of the current
+     live table, so they are written as a sorted run into a new live table */
+  std::shared_ptr<MetricSnapshot> snapshot;
+  {
+    std::lock_guard<stats::ProfiledMutex> lock_holder(head_mutex_);
+    snapshot = createSnapshot(true, segment_repo_ != nullptr);
+    head_ = snapshot;
+  }
+
+  writeReorderBuffer(snapshot->tables().back().get());
+}
+
+void Metric::writeReorderBuffer(TableRef* table) {
+  std::vector<const std::pair<uint64_t, std::string>*> rows;
+  rows.reserve(reorder_buffer_size_);
+  for (const auto& run : reorder_runs_) {
+    for (const auto& row : run->rows()) {
+      rows.emplace_back(&row);
+    }
+  }
+
+  /* the runs are ordered by insert time, so samples with the same time keep
+     their insert order */
+  std::stable_sort(
+      rows.begin(),
+      rows.end(),
+      [] (
+          const std::pair<uint64_t, std::string>* a,
+          const std::pair<uint64_t, std::string>* b) {
+        return a->first < b->first;
+      });
+
+  for (const auto row : rows) {
+    table->addSample(row->second.data(), row->second.size(), row->first);
+  }
+
+  reorder_runs_.clear();
+  reorder_buffer_size_ = 0;
+  diskMetricStats()->reordered_runs->incr();
 }
 
 // FIXPAUL misnomer...it creates a new snapshot + appends a new, clean table
-std::shared_ptr<MetricSnapshot> Metric::createSnapshot(bool writable) {
+std::shared_ptr<MetricSnapshot> Metric::createSnapshot(
+    bool writable,
+    bool shared /* = false */) {
   std::shared_ptr<MetricSnapshot> snapshot;
   std::vector<uint64_t> parents;
 
@@ -150,7 +387,19 @@ std::shared_ptr<MetricSnapshot> Metric::createSnapshot(bool writable) {
 
   snapshot->setWritable(writable);
 
-  if (writable) {
+  if (writable && shared) {
+    diskMetricStats()->tables_created->incr();
+
+    snapshot->appendTable(segment_repo_->currentSegment()->addTable(
+        key_,
+        ++max_generation_,
+        parents,
+        &token_index_,
+        &label_index_,
+        &series_index_));
+  } else if (writable) {
+    diskMetricStats()->tables_created->incr();
+
     // open new file
     auto fileref = file_repo_->createFile();
     auto file = io::File::openFile(
@@ -168,16 +417,122 @@ std::shared_ptr<MetricSnapshot> Metric::createSnapshot(bool writable) {
   return snapshot;
 }
 
+std::shared_ptr<MetricSnapshot> Metric::getScanSnapshot() {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(append_mutex_);
+  auto snapshot = getSnapshot();
+
+  if (snapshot.get() == nullptr || reorder_runs_.empty()) {
+    return snapshot;
+  }
+
+  /* the runs are immutable, so the scan shares them */
+  snapshot = snapshot->clone();
+  for (const auto& run : reorder_runs_) {
+    snapshot->appendTable(run);
+  }
+
+  return snapshot;
+}
+
 void Metric::scanSamples(
     const fnord::util::DateTime& time_begin,
     const fnord::util::DateTime& time_end,
-    std::function<bool (Sample* sample)> callback) {
-  auto snapshot = getSnapshot();
+    std::function<bool (Sample* sample)> callback,
+    ScanStats* stats /* = nullptr */) {
+  auto snapshot = getScanSnapshot();
+  if (snapshot.get() == nullptr) {
+    return;
+  }
+
+  scanSnapshot(
+      snapshot,
+      time_begin,
+      time_end,
+      std::vector<std::pair<std::string, std::string>>(),
+      callback,
+      stats);
+}
+
+void Metric::scanSeries(
+    const fnord::util::DateTime& time_begin,
+    const fnord::util::DateTime& time_end,
+    const std::vector<std::pair<std::string, std::string>>& label_filter,
+    std::function<bool (Sample* sample)> callback,
+    ScanStats* stats /* = nullptr */) {
+  auto snapshot = getScanSnapshot();
   if (snapshot.get() == nullptr) {
     return;
   }
 
-  MetricCursor cursor(snapshot, &token_index_);
+  scanSnapshot(snapshot, time_begin, time_end, label_filter, callback, stats);
+}
+
+void Metric::partitionScan(
+    const fnord::util::DateTime& time_begin,
+    const fnord::util::DateTime& time_end,
+    std::vector<std::function<void (
+        std::function<bool (Sample* sample)>,
+        ScanStats* stats)>>* partitions) {
+  auto snapshot = getScanSnapshot();
+  if (snapshot.get() == nullptr) {
+    return;
+  }
+
+  for (const auto& table : snapshot->tables()) {
+    std::shared_ptr<MetricSnapshot> table_snapshot(new MetricSnapshot());
+    table_snapshot->appendTable(table);
+
+    partitions->emplace_back([this, table_snapshot, time_begin, time_end] (
+        std::function<bool (Sample* sample)> callback,
+        ScanStats* stats) {
+      scanSnapshot(
+          table_snapshot,
+          time_begin,
+          time_end,
+          std::vector<std::pair<std::string, std::string>>(),
+          callback,
+          stats);
+    });
+  }
+}
+
+void Metric::scanSnapshot(
+    std::shared_ptr<MetricSnapshot> snapshot,
+    const fnord::util::DateTime& time_begin,
+    const fnord::util::DateTime& time_end,
+    const std::vector<std::pair<std::string, std::string>>& label_filter,
+    std::function<bool (Sample* sample)> callback,
+    ScanStats* stats) {
+  /* skip all tables that contain no samples in the scanned time range */
+  std::shared_ptr<MetricSnapshot> bounded_snapshot(new MetricSnapshot());
+  size_t tables_skipped = 0;
+  for (const auto& table : snapshot->tables()) {
+    uint64_t min_time;
+    uint64_t max_time;
+    if (!table->timeRange(&min_time, &max_time) ||
+        max_time < static_cast<uint64_t>(time_begin) ||
+        min_time >= static_cast<uint64_t>(time_end)) {
+      ++tables_skipped;
+      continue;
+    }
+
+    bounded_snapshot->appendTable(table);
+  }
+
+  snapshot = bounded_snapshot;
+
+  /* tables that are partitioned by series only read the matching series,
+     the samples of all other tables are filtered by their labels */
+  std::set<uint32_t> series_ids;
+  if (!label_filter.empty()) {
+    series_ids = series_index_.findSeries(label_filter);
+  }
+
+  MetricCursor cursor(
+      snapshot,
+      &token_index_,
+      label_filter.empty() ? nullptr : &series_ids);
+
   while (cursor.valid()) {
     auto sample = cursor.sample<double>();
     auto time = cursor.time();
@@ -186,19 +541,28 @@ void Metric::scanSamples(
       break;
     }
 
-    if (time >= static_cast<uint64_t>(time_begin)) {
+    if (time >= static_cast<uint64_t>(time_begin) &&
+        matchLabels(sample->labels(), label_filter)) {
       Sample cb_sample(
           time,
           sample->value(),
           sample->labels());
 
-      callback(&cb_sample);
+      if (!callback(&cb_sample)) {
+        break;
+      }
     }
 
     if (!cursor.next()) {
       break;
     }
   }
+
+  if (stats != nullptr) {
+    stats->bytes_read += cursor.bytesRead();
+    stats->tables_opened += cursor.tablesOpened();
+    stats->tables_skipped += tables_skipped;
+  }
 }
 
 void Metric::compact(CompactionPolicy* compaction /* = nullptr */) {
@@ -207,6 +571,7 @@ void Metric::compact(CompactionPolicy* compaction /* = nullptr */) {
   }
 
   std::lock_guard<std::mutex>(compaction_mutex_, std::adopt_lock);
+  auto compaction_start = WallClock::unixMicros();
 
   if (env()->verbose()) {
     env()->logger()->printf(
@@ -218,8 +583,12 @@ void Metric::compact(CompactionPolicy* compaction /* = nullptr */) {
   // create a new snapshot and make all tables immutable
   std::shared_ptr<MetricSnapshot> snapshot;
   {
-    std::lock_guard<std::mutex> append_lock_holder(append_mutex_);
-    std::lock_guard<std::mutex> head_lock_holder(head_mutex_);
+    std::lock_guard<stats::ProfiledMutex> append_lock_holder(append_mutex_);
+
+    /* idle metrics write their reorder buffer here */
+    flushReorderBuffer(compaction_start, false);
+
+    std::lock_guard<stats::ProfiledMutex> head_lock_holder(head_mutex_);
     snapshot = createSnapshot(false);
   }
 
@@ -231,10 +600,12 @@ void Metric::compact(CompactionPolicy* compaction /* = nullptr */) {
   }
 
   std::vector<std::shared_ptr<TableRef>> new_tables;
+  std::vector<std::string> replaced_files;
 
-  // finalize unfinished sstables
+  // rewrite unfinished sstables into finalized series tables, shared tables
+  // are finalized by the segment compaction
   for (auto& table : old_tables) {
-    if (table->isWritable()) {
+    if (table->isWritable() && !table->isShared()) {
       if (table->bodySize() == 0) {
         if (env()->verbose()) {
           env()->logger()->printf(
@@ -254,14 +625,59 @@ void Metric::compact(CompactionPolicy* compaction /* = nullptr */) {
               table->metricKey().c_str());
         }
 
-        table->finalize(&token_index_, &label_index_);
-        new_tables.emplace_back(new ReadonlyTableRef(*table));
+        auto fileref = file_repo_->createFile();
+        new_tables.emplace_back(TableRef::createSeriesTable(
+            fileref.absolute_path,
+            table.get(),
+            &token_index_,
+            &label_index_,
+            &series_index_));
+
+        replaced_files.emplace_back(table->filename());
+        diskMetricStats()->tables_finalized->incr();
+        diskMetricStats()->series_tables->incr();
       }
     } else {
       new_tables.emplace_back(table);
     }
   }
 
+  // move old finalized tables to the cold datadir
+  if (cold_file_repo_ != nullptr && compaction_start > cold_age_micros_) {
+    auto cold_before = compaction_start - cold_age_micros_;
+
+    for (auto& table : new_tables) {
+      auto readonly_table = dynamic_cast<ReadonlyTableRef*>(table.get());
+      if (readonly_table == nullptr || readonly_table->isCompressed()) {
+        continue;
+      }
+
+      uint64_t min_time;
+      uint64_t max_time;
+      if (!table->timeRange(&min_time, &max_time) || max_time >= cold_before) {
+        continue;
+      }
+
+      if (env()->verbose()) {
+        env()->logger()->printf(
+            "DEBUG",
+            "Moving sstable '%s' (%s) to the cold datadir",
+            table->filename().c_str(),
+            table->metricKey().c_str());
+      }
+
+      auto fileref = cold_file_repo_->createFile();
+      std::shared_ptr<TableRef> cold_table(TableRef::createColdTable(
+          fileref.absolute_path,
+          table.get()));
+
+      /* older snapshots may still read the original file */
+      readonly_table->setObsolete();
+      table = cold_table;
+      diskMetricStats()->cold_tables->incr();
+    }
+  }
+
   // run the compaction
   if (compaction != nullptr) {
     compaction->compact(&new_tables);
@@ -269,8 +685,8 @@ void Metric::compact(CompactionPolicy* compaction /* = nullptr */) {
 
   // create a new snapshot and commit modifications
   {
-    std::lock_guard<std::mutex> append_lock_holder(append_mutex_);
-    std::lock_guard<std::mutex> head_lock_holder(head_mutex_);
+    std::lock_guard<stats::ProfiledMutex> append_lock_holder(append_mutex_);
+    std::lock_guard<stats::ProfiledMutex> head_lock_holder(head_mutex_);
     auto new_snapshot = new MetricSnapshot();
     new_snapshot->setWritable(head_->isWritable());
 
@@ -284,6 +700,16 @@ void Metric::compact(CompactionPolicy* compaction /* = nullptr */) {
 
     head_.reset(new_snapshot);
   }
+
+  /* until the live tables are removed, reopening the metric prefers the
+     series tables of the same generation */
+  for (const auto& filename : replaced_files) {
+    io::FileUtil::rm(filename);
+  }
+
+  diskMetricStats()->compactions->incr();
+  diskMetricStats()->compaction_micros->insert(
+      WallClock::unixMicros() - compaction_start);
 }
 
 void Metric::setLiveTableMaxSize(size_t max_size) {
@@ -294,11 +720,40 @@ void Metric::setLiveTableIdleTimeMicros(uint64_t idle_time_micros) {
   live_table_idle_time_micros_ = idle_time_micros;
 }
 
+void Metric::setReorderWindowMicros(uint64_t window_micros) {
+  std::lock_guard<stats::ProfiledMutex> append_lock_holder(append_mutex_);
+  reorder_window_micros_ = window_micros;
+}
+
+void Metric::setSegmentRepository(SegmentRepository* segment_repo) {
+  segment_repo_ = segment_repo;
+}
+
+void Metric::setColdStorage(
+    io::FileRepository const* cold_file_repo,
+    uint64_t cold_age_micros /* = kColdAgeMicros */) {
+  cold_file_repo_ = cold_file_repo;
+  cold_age_micros_ = cold_age_micros;
+}
+
 size_t Metric::numTables() const {
   auto snapshot = getSnapshot();
+  if (snapshot.get() == nullptr) {
+    return 0;
+  }
+
   return snapshot->tables().size();
 }
 
+size_t Metric::numSeries() const {
+  return series_index_.numSeries();
+}
+
+size_t Metric::numReorderedSamples() const {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(append_mutex_);
+  return reorder_buffer_size_;
+}
+
 size_t Metric::totalBytes() const {
   auto snapshot = getSnapshot();
 
@@ -15,9 +15,12 @@
 #include <fnordmetric/metricdb/backends/disk/metriccursor.h>
 #include <fnordmetric/metricdb/backends/disk/metricsnapshot.h>
 #include <fnordmetric/metricdb/backends/disk/samplereader.h>
+#include <fnordmetric/metricdb/backends/disk/segment.h>
+#include <fnordmetric/metricdb/backends/disk/seriesindex.h>
 #include <fnordmetric/metricdb/backends/disk/tokenindex.h>
 #include <fnordmetric/metricdb/metric.h>
 #include <fnordmetric/metricdb/sample.h>
+#include <fnordmetric/stats/profiledmutex.h>
 #include <fnordmetric/util/datetime.h>
 #include <string>
 #include <vector>
@@ -27,11 +30,53 @@ namespace fnordmetric {
 namespace metricdb {
 namespace disk_backend {
 
+/**
+ * Samples are appended to the live table, which must be sorted by time.
+ * Samples that are older than the newest sample in the live table ("out of
+ * order" samples, e.g. from batching agents, replays or backfills) are kept
+ * in an in-memory reorder buffer instead. The out of order samples of every
+ * insert are added to the buffer as an immutable sorted run, and runs of
+ * similar size are merged, so a scan only shares the few current runs
+ * instead of copying the buffer. Once the oldest buffered sample was inserted
+ * more than the reorder window ago, or the buffer holds
+ * kReorderBufferMaxSamples samples, the buffer is written to a new live table
+ * as one sorted run. So tables may overlap in time; scans merge them and the
+ * reorder buffer (see MetricCursor).
+ *
+ * A buffer of less than kReorderRunMinSamples samples would take a table
+ * file of its own. Unless it can go into the shared segment, it is kept for
+ * up to kReorderSmallRunWindows reorder windows and written into the next
+ * live table once the current one is full.
+ *
+ * Buffered samples are lost if the process crashes before they are written.
+ *
+ * If a segment repository is set, new live tables are added to the current
+ * segment, which is shared with other metrics, until the metric wrote
+ * hotMetricSize bytes into its shared table; it then continues in its own
+ * tables. Shared tables are finalized by the segment compaction.
+ *
+ * The compaction rewrites the sealed live tables of the metric into tables
+ * that are partitioned by series (every distinct label set is a series, see
+ * SeriesIndex), so scans with a label filter only read the matching series.
+ *
+ * If a cold datadir is set, the compaction also moves finalized tables whose
+ * newest sample is older than the cold age into it. The tables are rewritten
+ * with their body compressed in blocks (see ColdTable) and replace the
+ * original tables in the snapshot; the original files are removed once no
+ * snapshot uses them anymore.
+ */
 class Metric : public fnordmetric::metricdb::IMetric {
 public:
   static constexpr const size_t kLiveTableMaxSize = 2 << 19; /* 1MB */
   static constexpr const uint64_t kLiveTableIdleTimeMicros = 
       5 * 60 * 1000000; /* 5 minutes */
+  static constexpr const uint64_t kReorderWindowMicros =
+      60 * 1000000; /* 1 minute */
+  static constexpr const size_t kReorderBufferMaxSamples = 1 << 16;
+  static constexpr const size_t kReorderRunMinSamples = 1 << 12;
+  static constexpr const uint64_t kReorderSmallRunWindows = 10;
+  static constexpr const uint64_t kColdAgeMicros =
+      7 * 24 * 3600 * 1000000llu; /* 7 days */
 
   Metric(const std::string& key, io::FileRepository* file_repo);
 
@@ -40,17 +85,68 @@ public:
       io::FileRepository* file_repo,
       std::vector<std::unique_ptr<TableRef>>&& tables);
 
+  /**
+   * Writes the reorder buffer
+   */
+  ~Metric();
+
   void scanSamples(
       const fnord::util::DateTime& time_begin,
       const fnord::util::DateTime& time_end,
-      std::function<bool (Sample* sample)> callback) override;
+      std::function<bool (Sample* sample)> callback,
+      ScanStats* stats = nullptr) override;
+
+  void scanSeries(
+      const fnord::util::DateTime& time_begin,
+      const fnord::util::DateTime& time_end,
+      const std::vector<std::pair<std::string, std::string>>& label_filter,
+      std::function<bool (Sample* sample)> callback,
+      ScanStats* stats = nullptr) override;
+
+  /**
+   * Returns one partition per table in the current snapshot and one for the
+   * reorder buffer
+   */
+  void partitionScan(
+      const fnord::util::DateTime& time_begin,
+      const fnord::util::DateTime& time_end,
+      std::vector<std::function<void (
+          std::function<bool (Sample* sample)>,
+          ScanStats* stats)>>* partitions) override;
 
   void compact(CompactionPolicy* compaction = nullptr);
 
   void setLiveTableMaxSize(size_t max_size);
   void setLiveTableIdleTimeMicros(uint64_t idle_time_micros);
+  void setReorderWindowMicros(uint64_t window_micros);
+
+  /**
+   * Add new live tables to the segments of this repository. The repository
+   * must outlive the metric
+   */
+  void setSegmentRepository(SegmentRepository* segment_repo);
+
+  /**
+   * Move finalized tables whose newest sample is older than cold_age_micros
+   * into the files of this repository. The repository must outlive the
+   * metric
+   */
+  void setColdStorage(
+      io::FileRepository const* cold_file_repo,
+      uint64_t cold_age_micros = kColdAgeMicros);
+
   size_t numTables() const;
 
+  /**
+   * Returns the number of series in the tables that are partitioned by series
+   */
+  size_t numSeries() const;
+
+  /**
+   * Returns the number of out of order samples in the reorder buffer
+   */
+  size_t numReorderedSamples() const;
+
   size_t totalBytes() const override;
   DateTime lastInsertTime() const override;
   std::set<std::string> labels() const override;
@@ -61,22 +157,78 @@ protected:
       double value,
       const std::vector<std::pair<std::string, std::string>>& labels) override;
 
+  void insertSamplesImpl(const std::vector<BatchSample>& samples) override;
+
   std::shared_ptr<MetricSnapshot> getSnapshot() const;
   std::shared_ptr<MetricSnapshot> getOrCreateSnapshot();
-  std::shared_ptr<MetricSnapshot> createSnapshot(bool writable);
+  std::shared_ptr<MetricSnapshot> createSnapshot(
+      bool writable,
+      bool shared = false);
+
+  /**
+   * Returns the current snapshot with the runs of the reorder buffer
+   * appended as in-memory tables
+   */
+  std::shared_ptr<MetricSnapshot> getScanSnapshot();
+
+  /**
+   * Append the sample to the live table or add it to the reordered rows if
+   * it is older than the live table's newest sample. Must hold append_mutex_
+   */
+  void appendSample(
+      SampleWriter const* sample,
+      uint64_t time,
+      MemoryTableRef::RowList* reordered);
+
+  /**
+   * Add the reordered rows of one insert to the reorder buffer as a new run.
+   * Must hold append_mutex_
+   */
+  void addReorderRun(MemoryTableRef::RowList* rows, uint64_t now);
+
+  /**
+   * Write the reorder buffer to a new live table if the reorder window has
+   * passed (see kReorderRunMinSamples), the buffer is full or force is true.
+   * Must hold append_mutex_
+   */
+  void flushReorderBuffer(uint64_t now, bool force);
+
+  /**
+   * Write all runs of the reorder buffer into the table as one sorted run and
+   * clear the buffer. Must hold append_mutex_
+   */
+  void writeReorderBuffer(TableRef* table);
+
+  void scanSnapshot(
+      std::shared_ptr<MetricSnapshot> snapshot,
+      const fnord::util::DateTime& time_begin,
+      const fnord::util::DateTime& time_end,
+      const std::vector<std::pair<std::string, std::string>>& label_filter,
+      std::function<bool (Sample* sample)> callback,
+      ScanStats* stats);
 
   io::FileRepository const* file_repo_;
+  SegmentRepository* segment_repo_;
+  io::FileRepository const* cold_file_repo_;
+  uint64_t cold_age_micros_;
   std::shared_ptr<MetricSnapshot> head_;
-  mutable std::mutex head_mutex_;
-  std::mutex append_mutex_;
+  mutable fnord::stats::ProfiledMutex head_mutex_;
+  mutable fnord::stats::ProfiledMutex append_mutex_;
   std::mutex compaction_mutex_;
   uint64_t max_generation_;
   TokenIndex token_index_;
   LabelIndex label_index_;
+  SeriesIndex series_index_;
 
   size_t live_table_max_size_; // FIXPAUL make atomic
   uint64_t live_table_idle_time_micros_; // FIXPAUL make atomic
   uint64_t last_insert_; // FIXPAUL make atomic
+
+  /* immutable sorted runs, oldest first, guarded by append_mutex_ */
+  std::vector<std::shared_ptr<MemoryTableRef>> reorder_runs_;
+  size_t reorder_buffer_size_;
+  uint64_t reorder_buffer_since_;
+  uint64_t reorder_window_micros_;
 };
 
 }
@@ -10,6 +10,7 @@
 #include <fnordmetric/metricdb/backends/disk/metriccursor.h>
 #include <fnordmetric/util/stringutil.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -21,68 +22,125 @@ namespace disk_backend {
 
 MetricCursor::MetricCursor(
     std::shared_ptr<MetricSnapshot> snapshot,
-    TokenIndex* token_index) :
+    TokenIndex* token_index,
+    const std::set<uint32_t>* series_ids /* = nullptr */) :
     snapshot_(snapshot),
     token_index_(token_index),
-    table_index_(0) {}
+    series_ids_(series_ids),
+    next_pending_(0),
+    bytes_read_(0),
+    tables_opened_(0) {
+  const auto& tables = snapshot_->tables();
+
+  for (size_t i = 0; i < tables.size(); ++i) {
+    uint64_t min_time;
+    uint64_t max_time;
+    if (tables[i]->timeRange(&min_time, &max_time)) {
+      pending_tables_.emplace_back(min_time, i);
+    }
+  }
+
+  /* sorted by the time of the oldest sample and then by snapshot order */
+  std::sort(pending_tables_.begin(), pending_tables_.end());
+  openTables();
+}
 
 bool MetricCursor::next() {
-  if (tableCursor()->next()) {
-    return true;
+  if (heap_.empty()) {
+    return false;
   }
 
+  std::pop_heap(heap_.begin(), heap_.end(), TableCursorCompare());
+  auto cursor = std::move(heap_.back());
+  heap_.pop_back();
 
-  while (table_index_ < (snapshot_->tables().size() - 1)) {
-    table_cur_ = snapshot_->tables()[++table_index_]->cursor();
-
-    if (table_cur_->valid()) {
-      return true;
-    }
+  if (cursor->cursor->next()) {
+    pushCursor(std::move(cursor));
   }
 
-  return false;
+  openTables();
+  return !heap_.empty();
 }
 
 bool MetricCursor::valid() {
-  if (tableCursor()->valid()) {
-    return true;
+  return !heap_.empty();
+}
+
+uint64_t MetricCursor::time() {
+  if (heap_.empty()) {
+    RAISE(kIllegalStateError, "cursor is not valid");
   }
 
-  while (table_index_ < (snapshot_->tables().size() - 1)) {
-    table_cur_ = snapshot_->tables()[++table_index_]->cursor();
+  return heap_.front()->time;
+}
+
+uint64_t MetricCursor::bytesRead() const {
+  return bytes_read_;
+}
+
+size_t MetricCursor::tablesOpened() const {
+  return tables_opened_;
+}
+
+void MetricCursor::openTables() {
+  while (next_pending_ < pending_tables_.size()) {
+    const auto& pending = pending_tables_[next_pending_];
 
-    if (table_cur_->valid()) {
-      return true;
+    if (!heap_.empty() && pending.first > heap_.front()->time) {
+      break;
     }
-  }
 
-  return false;
+    std::unique_ptr<TableCursor> cursor(new TableCursor());
+    cursor->table_index = pending.second;
+    const auto& table = snapshot_->tables()[pending.second];
+    cursor->cursor = series_ids_ == nullptr ?
+        table->cursor() :
+        table->seriesCursor(*series_ids_);
+    ++tables_opened_;
+    ++next_pending_;
+
+    pushCursor(std::move(cursor));
+  }
 }
 
-uint64_t MetricCursor::time() {
-  uint64_t time = 0;
+void MetricCursor::pushCursor(std::unique_ptr<TableCursor> cursor) {
+  if (!cursor->cursor->valid()) {
+    return;
+  }
 
   void* key;
   size_t key_len;
-  tableCursor()->getKey(&key, &key_len);
+  cursor->cursor->getKey(&key, &key_len);
 
-  if (key_len == sizeof(time)) {
-    memcpy(&time, key, sizeof(time));
-  } else {
+  if (key_len != sizeof(cursor->time)) {
     RAISE(kIllegalStateError, "invalid key");
   }
-  return time;
+
+  memcpy(&cursor->time, key, sizeof(cursor->time));
+  heap_.emplace_back(std::move(cursor));
+  std::push_heap(heap_.begin(), heap_.end(), TableCursorCompare());
 }
 
 fnord::sstable::Cursor* MetricCursor::tableCursor() {
-  if (table_cur_.get() == nullptr) {
-    table_cur_ = snapshot_->tables()[table_index_]->cursor();
+  if (heap_.empty()) {
+    RAISE(kIllegalStateError, "cursor is not valid");
+  }
+
+  return heap_.front()->cursor.get();
+}
+
+bool MetricCursor::TableCursorCompare::operator()(
+    const std::unique_ptr<TableCursor>& a,
+    const std::unique_ptr<TableCursor>& b) const {
+  /* std::push_heap builds a max heap, so the oldest sample must compare as
+     the greatest element */
+  if (a->time != b->time) {
+    return a->time > b->time;
   }
 
-  return table_cur_.get();
+  return a->table_index > b->table_index;
 }
 
 }
 }
 }
-
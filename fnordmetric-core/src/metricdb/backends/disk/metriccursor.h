@@ -13,6 +13,7 @@
 #include <fnordmetric/metricdb/backends/disk/samplereader.h>
 #include <fnordmetric/util/binarymessagereader.h>
 #include <stdlib.h>
+#include <set>
 #include <string>
 #include <vector>
 #include <memory>
@@ -21,11 +22,25 @@ namespace fnordmetric {
 namespace metricdb {
 namespace disk_backend {
 
+/**
+ * Iterates the samples of all tables in a snapshot in ascending time order.
+ *
+ * The samples within each table are sorted, but the time ranges of tables
+ * may overlap (e.g. if samples were inserted out of order), so the cursor
+ * does a k-way merge of the table cursors. Tables are opened lazily: a table
+ * is only opened once the merge reaches the time of its oldest sample, so
+ * scanning a snapshot of tables that don't overlap keeps one table open at a
+ * time. Samples with equal times are returned in snapshot order.
+ *
+ * If series ids are provided, tables that are partitioned by series only
+ * return the samples of these series (see TableRef::seriesCursor).
+ */
 class MetricCursor {
 public:
   MetricCursor(
       std::shared_ptr<MetricSnapshot> snapshot,
-      TokenIndex* token_index);
+      TokenIndex* token_index,
+      const std::set<uint32_t>* series_ids = nullptr);
 
   MetricCursor(const MetricCursor& copy) = delete;
   MetricCursor& operator=(const MetricCursor& copy) = delete;
@@ -38,13 +53,51 @@ public:
   template <typename T>
   SampleReader<T>* sample();
 
+  /**
+   * The number of key and sample bytes that were read by this cursor
+   */
+  uint64_t bytesRead() const;
+
+  /**
+   * The number of tables that this cursor has opened so far
+   */
+  size_t tablesOpened() const;
+
 protected:
-  std::shared_ptr<MetricSnapshot> snapshot_;
-  int table_index_;
+  struct TableCursor {
+    size_t table_index;
+    uint64_t time;
+    std::unique_ptr<fnord::sstable::Cursor> cursor;
+  };
+
+  struct TableCursorCompare {
+    bool operator()(
+        const std::unique_ptr<TableCursor>& a,
+        const std::unique_ptr<TableCursor>& b) const;
+  };
+
+  /**
+   * Open all tables whose oldest sample is not newer than the current sample
+   */
+  void openTables();
+
+  /**
+   * Read the time of the table cursor's current sample and push it onto the
+   * merge heap or discard it if the cursor is exhausted
+   */
+  void pushCursor(std::unique_ptr<TableCursor> cursor);
+
   fnord::sstable::Cursor* tableCursor();
-  std::unique_ptr<fnord::sstable::Cursor> table_cur_;
-  std::unique_ptr<fnord::util::BinaryMessageReader> sample_;
+
+  std::shared_ptr<MetricSnapshot> snapshot_;
   TokenIndex* token_index_;
+  const std::set<uint32_t>* series_ids_;
+  std::vector<std::pair<uint64_t, size_t>> pending_tables_;
+  size_t next_pending_;
+  std::vector<std::unique_ptr<TableCursor>> heap_;
+  std::unique_ptr<fnord::util::BinaryMessageReader> sample_;
+  uint64_t bytes_read_;
+  size_t tables_opened_;
 };
 
 // impl
@@ -53,6 +106,7 @@ SampleReader<T>* MetricCursor::sample() {
   void* data;
   size_t data_size;
   tableCursor()->getData(&data, &data_size);
+  bytes_read_ += sizeof(uint64_t) + data_size;
 
   auto reader = new SampleReader<T>(data, data_size, token_index_);
   sample_.reset(reader);
@@ -9,7 +9,6 @@
  */
 #include <fnordmetric/environment.h>
 #include <fnordmetric/metricdb/backends/disk/metricrepository.h>
-#include <fnordmetric/sstable/sstablerepair.h>
 #include <fnordmetric/thread/task.h>
 
 namespace fnordmetric {
@@ -18,28 +17,27 @@ namespace disk_backend {
 
 MetricRepository::MetricRepository(
     const std::string data_dir,
-    fnord::thread::TaskScheduler* scheduler) :
+    fnord::thread::TaskScheduler* scheduler,
+    uint64_t reorder_window_micros /* = Metric::kReorderWindowMicros */,
+    size_t segment_size /* = 0 */,
+    const std::string& cold_data_dir /* = "" */,
+    uint64_t cold_age_micros /* = Metric::kColdAgeMicros */) :
     file_repo_(new fnord::io::FileRepository(data_dir)),
-    compaction_task_(this) {
-  std::unordered_map<
-      std::string,
-      std::vector<std::unique_ptr<TableRef>>> tables;
-
-  file_repo_->listFiles([this, &tables] (const std::string& filename) -> bool {
-    fnord::sstable::SSTableRepair repair(filename);
-
-    if (repair.checkAndRepair(true)) {
-      auto table_ref = TableRef::openTable(filename);
-      tables[table_ref->metricKey()].emplace_back(std::move(table_ref));
-    } else {
-      env()->logger()->printf(
-          "ERROR",
-          "can't repair sstable %s. skipping...",
-          filename.c_str());
-    }
-
-    return true;
-  });
+    cold_file_repo_(
+        cold_data_dir.empty() ?
+            nullptr :
+            new fnord::io::FileRepository(cold_data_dir)),
+    segment_repo_(new SegmentRepository(
+        file_repo_.get(),
+        segment_size > 0 ?
+            segment_size :
+            SegmentRepository::kDefaultSegmentMaxSize)),
+    reorder_window_micros_(reorder_window_micros),
+    cold_age_micros_(cold_age_micros),
+    segments_enabled_(segment_size > 0),
+    compaction_task_(this, scheduler) {
+  SegmentRepository::TableMap tables;
+  segment_repo_->openTables(&tables, cold_file_repo_.get());
 
   for (auto& iter : tables) {
     auto metric = new Metric(
@@ -47,14 +45,44 @@ MetricRepository::MetricRepository(
         file_repo_.get(),
         std::move(iter.second));
 
+    metric->setReorderWindowMicros(reorder_window_micros_);
+    if (segments_enabled_) {
+      metric->setSegmentRepository(segment_repo_.get());
+    }
+
+    if (cold_file_repo_.get() != nullptr) {
+      metric->setColdStorage(cold_file_repo_.get(), cold_age_micros_);
+    }
+
     metrics_.emplace(iter.first, std::unique_ptr<Metric>(metric));
   }
 
-  scheduler->run(fnord::thread::Task::create(compaction_task_.runnable()));
+  compaction_task_.start();
+}
+
+MetricRepository::~MetricRepository() {
+  /* the metrics must be closed before the file and segment repositories are
+     freed */
+  std::lock_guard<stats::ProfiledMutex> lock_holder(metrics_mutex_);
+  metrics_.clear();
 }
 
 Metric* MetricRepository::createMetric(const std::string& key) {
-  return new Metric(key, file_repo_.get());
+  auto metric = new Metric(key, file_repo_.get());
+  metric->setReorderWindowMicros(reorder_window_micros_);
+  if (segments_enabled_) {
+    metric->setSegmentRepository(segment_repo_.get());
+  }
+
+  if (cold_file_repo_.get() != nullptr) {
+    metric->setColdStorage(cold_file_repo_.get(), cold_age_micros_);
+  }
+
+  return metric;
+}
+
+void MetricRepository::compactSegments() {
+  segment_repo_->compact();
 }
 
 }
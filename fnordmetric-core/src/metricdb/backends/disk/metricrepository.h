@@ -11,6 +11,7 @@
 #define _FNORDMETRIC_METRICDB_DISK_BACKEND_METRICREPOSITORY_H_
 #include <fnordmetric/metricdb/backends/disk/compactiontask.h>
 #include <fnordmetric/metricdb/backends/disk/metric.h>
+#include <fnordmetric/metricdb/backends/disk/segment.h>
 #include <fnordmetric/metricdb/metricrepository.h>
 #include <fnordmetric/io/filerepository.h>
 #include <fnordmetric/thread/taskscheduler.h>
@@ -21,13 +22,42 @@ namespace disk_backend {
 
 class MetricRepository : public fnordmetric::metricdb::IMetricRepository {
 public:
+  /**
+   * @param reorder_window_micros The reorder window of all metrics (see
+   *   Metric::setReorderWindowMicros)
+   * @param segment_size If non-zero, the live tables of all metrics are
+   *   stored in shared segments of this size (see Segment)
+   * @param cold_data_dir If non-empty, finalized tables whose newest sample
+   *   is older than cold_age_micros are moved into this directory (see
+   *   Metric::setColdStorage)
+   */
   MetricRepository(
       const std::string data_dir,
-      fnord::thread::TaskScheduler* scheduler);
+      fnord::thread::TaskScheduler* scheduler,
+      uint64_t reorder_window_micros = Metric::kReorderWindowMicros,
+      size_t segment_size = 0,
+      const std::string& cold_data_dir = "",
+      uint64_t cold_age_micros = Metric::kColdAgeMicros);
+
+  /**
+   * Closes all metrics, which write their reorder buffers
+   */
+  ~MetricRepository();
+
+  /**
+   * Compact the sealed segments. Segments that were written by an earlier
+   * run are compacted even if segments are disabled
+   */
+  void compactSegments();
 
 protected:
   Metric* createMetric(const std::string& key) override;
   std::shared_ptr<fnord::io::FileRepository> file_repo_;
+  std::shared_ptr<fnord::io::FileRepository> cold_file_repo_;
+  std::unique_ptr<SegmentRepository> segment_repo_;
+  uint64_t reorder_window_micros_;
+  uint64_t cold_age_micros_;
+  bool segments_enabled_;
   CompactionTask compaction_task_;
 };
 
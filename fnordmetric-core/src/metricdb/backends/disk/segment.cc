@@ -0,0 +1,1198 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/environment.h>
+#include <fnordmetric/io/fileutil.h>
+#include <fnordmetric/metricdb/backends/disk/labelindex.h>
+#include <fnordmetric/metricdb/backends/disk/labelindexreader.h>
+#include <fnordmetric/metricdb/backends/disk/labelindexwriter.h>
+#include <fnordmetric/metricdb/backends/disk/samplereader.h>
+#include <fnordmetric/metricdb/backends/disk/segment.h>
+#include <fnordmetric/metricdb/backends/disk/seriestablewriter.h>
+#include <fnordmetric/metricdb/backends/disk/tableheaderreader.h>
+#include <fnordmetric/metricdb/backends/disk/tableheaderwriter.h>
+#include <fnordmetric/metricdb/backends/disk/tokenindex.h>
+#include <fnordmetric/metricdb/backends/disk/tokenindexreader.h>
+#include <fnordmetric/metricdb/backends/disk/tokenindexwriter.h>
+#include <fnordmetric/sstable/binaryformat.h>
+#include <fnordmetric/sstable/sstablerepair.h>
+#include <fnordmetric/sstable/sstablestreamwriter.h>
+#include <fnordmetric/util/binarymessagereader.h>
+#include <fnordmetric/util/binarymessagewriter.h>
+#include <fnordmetric/util/wallclock.h>
+#include <map>
+#include <string.h>
+
+using namespace fnord;
+using fnord::util::WallClock;
+
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+
+/* shared by all segments */
+struct SegmentStats {
+  SegmentStats() :
+      segments_created(env()->stats()->counter("disk.segments_created")),
+      segments_compacted(env()->stats()->counter("disk.segments_compacted")),
+      hot_metrics_separated(
+          env()->stats()->counter("disk.hot_metrics_separated")),
+      compaction_micros(
+          env()->stats()->histogram("disk.segment_compaction_micros")) {}
+
+  stats::Counter* segments_created;
+  stats::Counter* segments_compacted;
+  stats::Counter* hot_metrics_separated;
+  stats::Histogram* compaction_micros;
+};
+
+static SegmentStats* segmentStats() {
+  static SegmentStats stats;
+  return &stats;
+}
+
+/* metric id + sample time */
+static const size_t kSampleKeySize = sizeof(uint32_t) + sizeof(uint64_t);
+
+/**
+ * A cursor over the row ranges of one metric id. Returns the sample time
+ * as the key, like the cursor of a regular table
+ */
+class SegmentCursor : public sstable::Cursor {
+public:
+  SegmentCursor(
+      std::unique_ptr<sstable::Cursor> cursor,
+      std::shared_ptr<sstable::SSTableWriter> writer,
+      std::shared_ptr<sstable::SSTableReader> reader,
+      const std::vector<std::pair<uint64_t, uint64_t>>& ranges) :
+      cursor_(std::move(cursor)),
+      writer_(writer),
+      reader_(reader),
+      ranges_(ranges),
+      range_(0) {
+    if (!ranges_.empty()) {
+      pos_ = ranges_[0].first;
+      cursor_->seekTo(pos_);
+    }
+  }
+
+  void seekTo(size_t body_offset) override {
+    RAISE(kNotImplementedError, "seekTo is not supported on segment tables");
+  }
+
+  bool next() override {
+    if (!valid()) {
+      return false;
+    }
+
+    void* key;
+    size_t key_size;
+    void* data;
+    size_t data_size;
+    cursor_->getKey(&key, &key_size);
+    cursor_->getData(&data, &data_size);
+
+    auto next_pos = pos_ + sizeof(sstable::BinaryFormat::RowHeader) +
+        key_size + data_size;
+
+    if (next_pos >= ranges_[range_].second) {
+      if (range_ + 1 >= ranges_.size()) {
+        return false;
+      }
+
+      next_pos = ranges_[++range_].first;
+    }
+
+    pos_ = next_pos;
+    cursor_->seekTo(pos_);
+    return true;
+  }
+
+  bool valid() override {
+    return range_ < ranges_.size();
+  }
+
+  void getKey(void** data, size_t* size) override {
+    void* key;
+    size_t key_size;
+    cursor_->getKey(&key, &key_size);
+    if (key_size != kSampleKeySize) {
+      RAISE(kIllegalStateError, "invalid segment key");
+    }
+
+    *data = static_cast<char*>(key) + sizeof(uint32_t);
+    *size = sizeof(uint64_t);
+  }
+
+  void getData(void** data, size_t* size) override {
+    cursor_->getData(data, size);
+  }
+
+  size_t position() const override {
+    return pos_;
+  }
+
+protected:
+  std::unique_ptr<sstable::Cursor> cursor_;
+  std::shared_ptr<sstable::SSTableWriter> writer_;
+  std::shared_ptr<sstable::SSTableReader> reader_;
+  std::vector<std::pair<uint64_t, uint64_t>> ranges_;
+  size_t range_;
+  size_t pos_;
+};
+
+Segment::MetricEntry::MetricEntry() :
+    generation(0),
+    min_time(UINT64_MAX),
+    max_time(0),
+    body_size(0),
+    dropped(false),
+    token_index(nullptr),
+    label_index(nullptr),
+    series_index(nullptr) {}
+
+void Segment::MetricEntry::addRow(
+    uint64_t offset,
+    size_t row_size,
+    uint64_t time) {
+  if (!ranges.empty() && ranges.back().second == offset) {
+    ranges.back().second += row_size;
+  } else {
+    ranges.emplace_back(offset, offset + row_size);
+  }
+
+  if (time < min_time) {
+    min_time = time;
+  }
+
+  if (time > max_time) {
+    max_time = time;
+  }
+
+  body_size += row_size;
+}
+
+std::shared_ptr<Segment> Segment::create(
+    const std::string& filename,
+    size_t max_size) {
+  if (env()->verbose()) {
+    env()->logger()->printf(
+        "DEBUG",
+        "Creating new segment: '%s'",
+        filename.c_str());
+  }
+
+  io::File::openFile(
+      filename,
+      io::File::O_READ | io::File::O_WRITE | io::File::O_CREATE);
+
+  fnord::util::BinaryMessageWriter header;
+  header.appendUInt32(kHeaderMarker);
+  header.appendUInt32(0);
+
+  sstable::IndexProvider indexes;
+  std::shared_ptr<Segment> segment(new Segment(filename, max_size));
+  segment->writer_ = sstable::SSTableWriter::create(
+      filename,
+      std::move(indexes),
+      header.data(),
+      header.size());
+
+  segmentStats()->segments_created->incr();
+  return segment;
+}
+
+std::shared_ptr<Segment> Segment::open(const std::string& filename) {
+  uint32_t flags;
+  size_t body_size;
+
+  {
+    sstable::SSTableReader reader(
+        io::File::openFile(filename, io::File::O_READ));
+
+    auto header = reader.readHeader();
+    if (!isSegmentHeader(header.data(), header.size())) {
+      RAISE(kIllegalArgumentError, "not a segment: %s", filename.c_str());
+    }
+
+    fnord::util::BinaryMessageReader header_reader(
+        header.data(),
+        header.size());
+
+    header_reader.readUInt32();
+    flags = *header_reader.readUInt32();
+    body_size = reader.bodySize();
+  }
+
+  if (env()->verbose()) {
+    env()->logger()->printf(
+        "DEBUG",
+        "Opening segment: '%s'",
+        filename.c_str());
+  }
+
+  std::shared_ptr<Segment> segment(new Segment(filename, 0));
+
+  if (body_size == 0) {
+    if ((flags & kFlagCompacted) != 0) {
+      return std::shared_ptr<Segment>(nullptr);
+    }
+
+    sstable::IndexProvider indexes;
+    segment->writer_ = sstable::SSTableWriter::reopen(
+        filename,
+        std::move(indexes));
+
+    segment->recover();
+  } else {
+    segment->reader_.reset(new sstable::SSTableReader(
+        io::File::openFile(filename, io::File::O_READ)));
+
+    segment->compacted_ = true;
+    segment->readIndex();
+  }
+
+  /* reopened live segments are compacted on the next run */
+  segment->sealed_ = true;
+  segment->last_append_ = 0;
+  return segment;
+}
+
+bool Segment::isSegmentHeader(void const* data, size_t size) {
+  if (size < 2 * sizeof(uint32_t)) {
+    return false;
+  }
+
+  uint32_t marker;
+  memcpy(&marker, data, sizeof(marker));
+  return marker == kHeaderMarker;
+}
+
+Segment::Segment(
+    const std::string& filename,
+    size_t max_size) :
+    filename_(filename),
+    max_size_(max_size),
+    sealed_(false),
+    last_append_(WallClock::unixMicros()),
+    compacted_(false),
+    mutex_("disk.segment") {}
+
+std::unique_ptr<TableRef> Segment::addTable(
+    const std::string& metric_key,
+    uint64_t generation,
+    const std::vector<uint64_t>& parents,
+    TokenIndex* token_index,
+    LabelIndex* label_index,
+    SeriesIndex* series_index) {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+
+  if (writer_.get() == nullptr) {
+    RAISE(kIllegalStateError, "segment %s is compacted", filename_.c_str());
+  }
+
+  uint32_t metric_id = entries_.size();
+  TableHeaderWriter header(metric_key, generation, parents);
+  writer_->appendRow(
+      &metric_id,
+      sizeof(metric_id),
+      header.data(),
+      header.size());
+
+  entries_.emplace_back();
+  auto& entry = entries_.back();
+  entry.key = metric_key;
+  entry.generation = generation;
+  entry.parents = parents;
+  entry.token_index = token_index;
+  entry.label_index = label_index;
+  entry.series_index = series_index;
+
+  if (writer_->bodySize() >= max_size_) {
+    sealed_ = true;
+  }
+
+  last_append_ = WallClock::unixMicros();
+
+  return std::unique_ptr<TableRef>(new SegmentTableRef(
+      shared_from_this(),
+      metric_id,
+      metric_key,
+      generation,
+      parents));
+}
+
+std::vector<std::unique_ptr<TableRef>> Segment::tables() {
+  std::vector<std::unique_ptr<TableRef>> tables;
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+
+  for (uint32_t metric_id = 0; metric_id < entries_.size(); ++metric_id) {
+    const auto& entry = entries_[metric_id];
+    if (entry.dropped || entry.own_table.get() != nullptr) {
+      continue;
+    }
+
+    tables.emplace_back(new SegmentTableRef(
+        shared_from_this(),
+        metric_id,
+        entry.key,
+        entry.generation,
+        entry.parents));
+  }
+
+  return tables;
+}
+
+void Segment::dropTable(uint32_t metric_id) {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+
+  if (metric_id >= entries_.size()) {
+    RAISE(kIndexError, "invalid metric id: %i", (int) metric_id);
+  }
+
+  entries_[metric_id].dropped = true;
+}
+
+bool Segment::compact(
+    io::FileRepository const* file_repo,
+    size_t hot_metric_size) {
+  auto compaction_start = WallClock::unixMicros();
+  std::vector<MetricEntry> entries;
+  std::shared_ptr<sstable::SSTableWriter> writer;
+  size_t body_size;
+
+  {
+    std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+    if (compacted_ || !sealed_) {
+      return false;
+    }
+
+    entries = entries_;
+    writer = writer_;
+    body_size = writer_->bodySize();
+  }
+
+  if (env()->verbose()) {
+    env()->logger()->printf(
+        "DEBUG",
+        "Compacting segment '%s' with %i metric(s)",
+        filename_.c_str(),
+        (int) entries.size());
+  }
+
+  std::vector<std::string> new_files;
+  std::vector<bool> written(entries.size(), false);
+  std::unique_ptr<sstable::SSTableStreamWriter> segment_writer;
+  std::string segment_filename;
+  size_t num_hot_metrics = 0;
+
+  fnord::util::BinaryMessageWriter index;
+  uint32_t num_indexed = 0;
+  index.appendUInt32(0);
+
+  try {
+    for (uint32_t metric_id = 0; metric_id < entries.size(); ++metric_id) {
+      auto& entry = entries[metric_id];
+      if (entry.dropped || entry.ranges.empty()) {
+        continue;
+      }
+
+      SegmentCursor cursor(
+          writer->getCursor(),
+          writer,
+          nullptr,
+          entry.ranges);
+
+      /* separating a metric requires its indexes for the table footers and
+         the series catalog */
+      if (entry.body_size >= hot_metric_size &&
+          entry.token_index != nullptr &&
+          entry.series_index != nullptr) {
+        auto fileref = file_repo->createFile();
+        new_files.emplace_back(fileref.absolute_path);
+
+        SeriesTableWriter table(
+            entry.token_index,
+            entry.label_index,
+            entry.series_index);
+
+        table.addSamples(&cursor);
+
+        auto table_body_size = table.write(
+            fileref.absolute_path,
+            entry.key,
+            entry.generation,
+            entry.parents);
+
+        entry.own_table.reset(new SeriesTableRef(
+            fileref.absolute_path,
+            entry.key,
+            table_body_size,
+            entry.generation,
+            entry.parents));
+
+        ++num_hot_metrics;
+        written[metric_id] = true;
+        continue;
+      }
+
+      if (segment_writer.get() == nullptr) {
+        auto fileref = file_repo->createFile();
+        segment_filename = fileref.absolute_path;
+        new_files.emplace_back(segment_filename);
+
+        fnord::util::BinaryMessageWriter header;
+        header.appendUInt32(kHeaderMarker);
+        header.appendUInt32(kFlagCompacted);
+        segment_writer = sstable::SSTableStreamWriter::create(
+            segment_filename,
+            header.data(),
+            header.size());
+      }
+
+      auto begin = segment_writer->bodySize();
+      char row_key[kSampleKeySize];
+      memcpy(row_key, &metric_id, sizeof(metric_id));
+
+      while (cursor.valid()) {
+        void* key;
+        size_t key_size;
+        void* data;
+        size_t data_size;
+        cursor.getKey(&key, &key_size);
+        cursor.getData(&data, &data_size);
+        memcpy(row_key + sizeof(metric_id), key, sizeof(uint64_t));
+        segment_writer->appendRow(row_key, sizeof(row_key), data, data_size);
+
+        if (!cursor.next()) {
+          break;
+        }
+      }
+
+      auto end = segment_writer->bodySize();
+      entry.ranges.clear();
+      entry.ranges.emplace_back(begin, end);
+      entry.body_size = end - begin;
+
+      /* tables that no metric imported keep their inline token definitions
+         and are imported by scanning them */
+      if (entry.token_index != nullptr) {
+        TokenIndexWriter token_index_writer(entry.token_index);
+        entry.token_index_data = std::string(
+            static_cast<char*>(token_index_writer.data()),
+            token_index_writer.size());
+
+        LabelIndexWriter label_index_writer(entry.label_index);
+        entry.label_index_data = std::string(
+            static_cast<char*>(label_index_writer.data()),
+            label_index_writer.size());
+      }
+
+      TableHeaderWriter table_header(
+          entry.key,
+          entry.generation,
+          entry.parents);
+
+      index.appendUInt32(metric_id);
+      index.appendUInt32(table_header.size());
+      index.append(table_header.data(), table_header.size());
+      index.appendUInt64(entry.min_time);
+      index.appendUInt64(entry.max_time);
+      index.appendUInt64(begin);
+      index.appendUInt64(end);
+      index.appendUInt32(entry.token_index_data.size());
+      index.appendString(entry.token_index_data);
+      index.appendUInt32(entry.label_index_data.size());
+      index.appendString(entry.label_index_data);
+
+      ++num_indexed;
+      written[metric_id] = true;
+    }
+
+    if (segment_writer.get() != nullptr) {
+      index.updateUInt32(0, num_indexed);
+      segment_writer->writeIndex(kIndexType, index.data(), index.size());
+      segment_writer->finalize();
+    }
+  } catch (util::RuntimeException& e) {
+    for (const auto& filename : new_files) {
+      io::FileUtil::rm(filename);
+    }
+
+    throw;
+  }
+
+  std::string old_filename;
+  {
+    std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+
+    /* a metric appended a sample after the segment was sealed */
+    if (writer_->bodySize() != body_size) {
+      for (const auto& filename : new_files) {
+        io::FileUtil::rm(filename);
+      }
+
+      return false;
+    }
+
+    for (uint32_t metric_id = 0; metric_id < entries.size(); ++metric_id) {
+      auto& entry = entries_[metric_id];
+
+      if (!written[metric_id]) {
+        entry.dropped = true;
+        entry.ranges.clear();
+        continue;
+      }
+
+      if (entries[metric_id].own_table.get() != nullptr) {
+        entry.own_table = entries[metric_id].own_table;
+        entry.ranges.clear();
+        continue;
+      }
+
+      entry.ranges = entries[metric_id].ranges;
+      entry.body_size = entries[metric_id].body_size;
+      entry.token_index_data = entries[metric_id].token_index_data;
+      entry.label_index_data = entries[metric_id].label_index_data;
+    }
+
+    if (segment_writer.get() != nullptr) {
+      reader_.reset(new sstable::SSTableReader(
+          io::File::openFile(segment_filename, io::File::O_READ)));
+    }
+
+    old_filename = filename_;
+    filename_ = segment_filename;
+    writer_.reset();
+    compacted_ = true;
+  }
+
+  /* open cursors keep the old file mapped */
+  io::FileUtil::rm(old_filename);
+
+  segmentStats()->segments_compacted->incr();
+  segmentStats()->hot_metrics_separated->incr(num_hot_metrics);
+  segmentStats()->compaction_micros->insert(
+      WallClock::unixMicros() - compaction_start);
+
+  return true;
+}
+
+const std::string& Segment::filename() const {
+  return filename_;
+}
+
+size_t Segment::bodySize() const {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+
+  if (writer_.get() != nullptr) {
+    return writer_->bodySize();
+  }
+
+  if (reader_.get() != nullptr) {
+    return reader_->bodySize();
+  }
+
+  return 0;
+}
+
+bool Segment::isWritable() const {
+  return !sealed_;
+}
+
+bool Segment::isSealed() const {
+  return sealed_;
+}
+
+bool Segment::isCompacted() const {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+  return compacted_;
+}
+
+bool Segment::isEmpty() const {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+
+  for (const auto& entry : entries_) {
+    if (!entry.dropped && entry.own_table.get() == nullptr) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint64_t Segment::lastAppendTime() const {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+  return last_append_;
+}
+
+void Segment::addSample(
+    uint32_t metric_id,
+    void const* data,
+    size_t size,
+    uint64_t time) {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+
+  if (writer_.get() == nullptr) {
+    RAISE(kIllegalStateError, "segment %s is compacted", filename_.c_str());
+  }
+
+  auto& entry = entries_[metric_id];
+  if (!entry.ranges.empty() && time < entry.max_time) {
+    RAISE(
+        kIllegalArgumentError,
+        "sample time %llu is older than the last sample in table %s",
+        (long long unsigned) time,
+        filename_.c_str());
+  }
+
+  char key[kSampleKeySize];
+  memcpy(key, &metric_id, sizeof(metric_id));
+  memcpy(key + sizeof(metric_id), &time, sizeof(time));
+
+  auto offset = writer_->bodySize();
+  writer_->appendRow(key, sizeof(key), data, size);
+  entry.addRow(offset, writer_->bodySize() - offset, time);
+
+  if (writer_->bodySize() >= max_size_) {
+    sealed_ = true;
+  }
+
+  last_append_ = WallClock::unixMicros();
+}
+
+std::unique_ptr<sstable::Cursor> Segment::cursor(uint32_t metric_id) {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+  const auto& entry = entries_[metric_id];
+
+  if (entry.own_table.get() != nullptr) {
+    return entry.own_table->cursor();
+  }
+
+  if (writer_.get() != nullptr) {
+    return std::unique_ptr<sstable::Cursor>(new SegmentCursor(
+        writer_->getCursor(),
+        writer_,
+        nullptr,
+        entry.ranges));
+  }
+
+  if (reader_.get() != nullptr) {
+    return std::unique_ptr<sstable::Cursor>(new SegmentCursor(
+        reader_->getCursor(),
+        nullptr,
+        reader_,
+        entry.ranges));
+  }
+
+  /* all metrics were dropped or moved into their own tables */
+  return std::unique_ptr<sstable::Cursor>(new SegmentCursor(
+      nullptr,
+      nullptr,
+      nullptr,
+      std::vector<std::pair<uint64_t, uint64_t>>()));
+}
+
+std::unique_ptr<sstable::Cursor> Segment::seriesCursor(
+    uint32_t metric_id,
+    const std::set<uint32_t>& series_ids) {
+  std::shared_ptr<TableRef> own_table;
+
+  {
+    std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+    own_table = entries_[metric_id].own_table;
+  }
+
+  if (own_table.get() == nullptr) {
+    return cursor(metric_id);
+  }
+
+  return own_table->seriesCursor(series_ids);
+}
+
+bool Segment::timeRange(
+    uint32_t metric_id,
+    uint64_t* min_time,
+    uint64_t* max_time) {
+  std::shared_ptr<TableRef> own_table;
+
+  {
+    std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+    const auto& entry = entries_[metric_id];
+
+    if (entry.own_table.get() == nullptr) {
+      if (entry.dropped || entry.ranges.empty()) {
+        return false;
+      }
+
+      *min_time = entry.min_time;
+      *max_time = entry.max_time;
+      return true;
+    }
+
+    own_table = entry.own_table;
+  }
+
+  return own_table->timeRange(min_time, max_time);
+}
+
+size_t Segment::bodySize(uint32_t metric_id) {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+  const auto& entry = entries_[metric_id];
+
+  if (entry.own_table.get() != nullptr) {
+    return entry.own_table->bodySize();
+  }
+
+  return entry.dropped ? 0 : entry.body_size;
+}
+
+void Segment::import(
+    uint32_t metric_id,
+    TokenIndex* token_index,
+    LabelIndex* label_index) {
+  std::string token_index_data;
+  std::string label_index_data;
+
+  {
+    std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+    auto& entry = entries_[metric_id];
+    entry.token_index = token_index;
+    entry.label_index = label_index;
+    token_index_data = entry.token_index_data;
+    label_index_data = entry.label_index_data;
+  }
+
+  if (!token_index_data.empty()) {
+    TokenIndexReader token_index_reader(
+        &token_index_data[0],
+        token_index_data.size());
+
+    token_index_reader.readIndex(token_index);
+
+    if (!label_index_data.empty()) {
+      LabelIndexReader label_index_reader(
+          &label_index_data[0],
+          label_index_data.size());
+
+      label_index_reader.readIndex(label_index);
+    }
+
+    return;
+  }
+
+  auto cur = cursor(metric_id);
+  while (cur->valid()) {
+    void* data;
+    size_t data_size;
+    cur->getData(&data, &data_size);
+
+    SampleReader<double> sample(data, data_size, token_index);
+
+    for (const auto& def : sample.tokenDefinitions()) {
+      token_index->addToken(def.second, def.first);
+    }
+
+    for (const auto& label : sample.labels()) {
+      label_index->addLabel(label.first);
+    }
+
+    if (!cur->next()) {
+      break;
+    }
+  }
+}
+
+void Segment::importSeries(uint32_t metric_id, SeriesIndex* series_index) {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+  entries_[metric_id].series_index = series_index;
+}
+
+void Segment::recover() {
+  if (writer_->bodySize() == 0) {
+    return;
+  }
+
+  auto cur = writer_->getCursor();
+  cur->seekTo(0);
+
+  for (;;) {
+    void* key;
+    size_t key_size;
+    void* data;
+    size_t data_size;
+    cur->getKey(&key, &key_size);
+    cur->getData(&data, &data_size);
+
+    uint32_t metric_id;
+    memcpy(&metric_id, key, sizeof(metric_id));
+
+    if (key_size == sizeof(metric_id)) {
+      TableHeaderReader header(data, data_size);
+
+      if (metric_id >= entries_.size()) {
+        entries_.resize(metric_id + 1);
+      }
+
+      auto& entry = entries_[metric_id];
+      entry.key = header.metricKey();
+      entry.generation = header.generation();
+      entry.parents = header.parents();
+    } else if (key_size == kSampleKeySize) {
+      if (metric_id >= entries_.size()) {
+        RAISE(
+            kIllegalStateError,
+            "segment %s references undefined metric id %i",
+            filename_.c_str(),
+            (int) metric_id);
+      }
+
+      uint64_t time;
+      memcpy(&time, static_cast<char*>(key) + sizeof(metric_id), sizeof(time));
+
+      auto row_size = sizeof(sstable::BinaryFormat::RowHeader) + key_size +
+          data_size;
+
+      entries_[metric_id].addRow(cur->position(), row_size, time);
+    } else {
+      RAISE(kIllegalStateError, "invalid segment key");
+    }
+
+    if (!cur->next()) {
+      break;
+    }
+  }
+}
+
+void Segment::readIndex() {
+  auto footer = reader_->readFooter(kIndexType);
+  if (footer.size() == 0) {
+    RAISE(kIllegalStateError, "segment %s has no index", filename_.c_str());
+  }
+
+  fnord::util::BinaryMessageReader reader(footer.data(), footer.size());
+  auto num_entries = *reader.readUInt32();
+
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    auto metric_id = *reader.readUInt32();
+    auto header_size = *reader.readUInt32();
+    auto header_data = reader.readString(header_size);
+    TableHeaderReader header(const_cast<char*>(header_data), header_size);
+
+    /* ids of dropped metrics are not stored */
+    if (metric_id >= entries_.size()) {
+      auto dropped = entries_.size();
+      entries_.resize(metric_id + 1);
+
+      for (; dropped < metric_id; ++dropped) {
+        entries_[dropped].dropped = true;
+      }
+    }
+
+    auto& entry = entries_[metric_id];
+    entry.key = header.metricKey();
+    entry.generation = header.generation();
+    entry.parents = header.parents();
+    entry.min_time = *reader.readUInt64();
+    entry.max_time = *reader.readUInt64();
+
+    auto begin = *reader.readUInt64();
+    auto end = *reader.readUInt64();
+    entry.ranges.emplace_back(begin, end);
+    entry.body_size = end - begin;
+
+    auto token_index_size = *reader.readUInt32();
+    entry.token_index_data = std::string(
+        reader.readString(token_index_size),
+        token_index_size);
+
+    auto label_index_size = *reader.readUInt32();
+    entry.label_index_data = std::string(
+        reader.readString(label_index_size),
+        label_index_size);
+  }
+}
+
+SegmentTableRef::SegmentTableRef(
+    std::shared_ptr<Segment> segment,
+    uint32_t metric_id,
+    const std::string& metric_key,
+    uint64_t generation,
+    const std::vector<uint64_t>& parents) :
+    TableRef(segment->filename(), metric_key, generation, parents),
+    segment_(segment),
+    metric_id_(metric_id) {}
+
+void SegmentTableRef::addSample(
+    void const* data,
+    size_t size,
+    uint64_t time) {
+  segment_->addSample(metric_id_, data, size, time);
+}
+
+std::unique_ptr<sstable::Cursor> SegmentTableRef::cursor() {
+  return segment_->cursor(metric_id_);
+}
+
+std::unique_ptr<sstable::Cursor> SegmentTableRef::seriesCursor(
+    const std::set<uint32_t>& series_ids) {
+  return segment_->seriesCursor(metric_id_, series_ids);
+}
+
+bool SegmentTableRef::timeRange(uint64_t* min_time, uint64_t* max_time) const {
+  return segment_->timeRange(metric_id_, min_time, max_time);
+}
+
+void SegmentTableRef::import(
+    TokenIndex* token_index,
+    LabelIndex* label_index) {
+  segment_->import(metric_id_, token_index, label_index);
+}
+
+void SegmentTableRef::importSeries(SeriesIndex* series_index) {
+  segment_->importSeries(metric_id_, series_index);
+}
+
+void SegmentTableRef::finalize(
+    TokenIndex* token_index,
+    LabelIndex* label_index) {
+  RAISE(
+      kIllegalStateError,
+      "shared tables are finalized by compacting their segment");
+}
+
+bool SegmentTableRef::isWritable() const {
+  return segment_->isWritable();
+}
+
+bool SegmentTableRef::isShared() const {
+  return true;
+}
+
+size_t SegmentTableRef::bodySize() const {
+  return segment_->bodySize(metric_id_);
+}
+
+Segment* SegmentTableRef::segment() const {
+  return segment_.get();
+}
+
+uint32_t SegmentTableRef::metricID() const {
+  return metric_id_;
+}
+
+SegmentRepository::SegmentRepository(
+    io::FileRepository const* file_repo,
+    size_t segment_max_size /* = kDefaultSegmentMaxSize */,
+    size_t hot_metric_size /* = kDefaultHotMetricSize */) :
+    file_repo_(file_repo),
+    segment_max_size_(segment_max_size),
+    hot_metric_size_(hot_metric_size),
+    mutex_("disk.segments") {}
+
+/* cold tables win over finalized tables, which win over live segments,
+   which win over live tables */
+static int tableRank(TableRef* table) {
+  if (table->isShared()) {
+    auto segment = static_cast<SegmentTableRef*>(table)->segment();
+    return segment->isCompacted() ? 1 : 2;
+  }
+
+  if (table->isCompressed()) {
+    return 0;
+  }
+
+  return table->isWritable() ? 3 : 1;
+}
+
+void SegmentRepository::openTables(
+    TableMap* tables,
+    io::FileRepository const* cold_file_repo /* = nullptr */) {
+  std::vector<std::unique_ptr<TableRef>> all_tables;
+  std::vector<std::shared_ptr<Segment>> segments;
+
+  auto open_file = [&all_tables, &segments] (
+      const std::string& filename) -> bool {
+    fnord::sstable::SSTableRepair repair(filename);
+
+    if (!repair.checkAndRepair(true)) {
+      env()->logger()->printf(
+          "ERROR",
+          "can't repair sstable %s. skipping...",
+          filename.c_str());
+
+      return true;
+    }
+
+    bool is_segment;
+    {
+      sstable::SSTableReader reader(
+          io::File::openFile(filename, io::File::O_READ));
+
+      auto header = reader.readHeader();
+      is_segment = Segment::isSegmentHeader(header.data(), header.size());
+    }
+
+    if (!is_segment) {
+      auto table = TableRef::openTable(filename);
+      if (table.get() == nullptr) {
+        env()->logger()->printf(
+            "INFO",
+            "removing unfinished table %s",
+            filename.c_str());
+
+        io::FileUtil::rm(filename);
+        return true;
+      }
+
+      all_tables.emplace_back(std::move(table));
+      return true;
+    }
+
+    auto segment = Segment::open(filename);
+    if (segment.get() == nullptr) {
+      env()->logger()->printf(
+          "INFO",
+          "removing unfinished segment compaction %s",
+          filename.c_str());
+
+      io::FileUtil::rm(filename);
+      return true;
+    }
+
+    for (auto& table : segment->tables()) {
+      all_tables.emplace_back(std::move(table));
+    }
+
+    segments.emplace_back(segment);
+    return true;
+  };
+
+  file_repo_->listFiles(open_file);
+  if (cold_file_repo != nullptr) {
+    cold_file_repo->listFiles(open_file);
+  }
+
+  /* an interrupted segment compaction or move to the cold datadir leaves
+     tables of the same metric and generation in the old and the new files */
+  std::map<std::pair<std::string, uint64_t>, size_t> best;
+  for (size_t i = 0; i < all_tables.size(); ++i) {
+    auto& table = all_tables[i];
+    auto table_key = std::make_pair(table->metricKey(), table->generation());
+    auto iter = best.find(table_key);
+
+    if (iter == best.end()) {
+      best.emplace(table_key, i);
+      continue;
+    }
+
+    auto superseded = i;
+    if (tableRank(table.get()) < tableRank(all_tables[iter->second].get())) {
+      superseded = iter->second;
+      iter->second = i;
+    }
+
+    auto& superseded_table = all_tables[superseded];
+    env()->logger()->printf(
+        "INFO",
+        "removing superseded table of metric '%s', generation %llu in %s",
+        superseded_table->metricKey().c_str(),
+        (long long unsigned) superseded_table->generation(),
+        superseded_table->filename().c_str());
+
+    if (superseded_table->isShared()) {
+      auto segment_table = static_cast<SegmentTableRef*>(
+          superseded_table.get());
+
+      segment_table->segment()->dropTable(segment_table->metricID());
+    } else {
+      io::FileUtil::rm(superseded_table->filename());
+    }
+
+    superseded_table.reset(nullptr);
+  }
+
+  for (auto& table : all_tables) {
+    if (table.get() != nullptr) {
+      auto& metric_tables = (*tables)[table->metricKey()];
+      metric_tables.emplace_back(std::move(table));
+    }
+  }
+
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+  for (const auto& segment : segments) {
+    if (segment->isEmpty()) {
+      env()->logger()->printf(
+          "INFO",
+          "removing empty segment %s",
+          segment->filename().c_str());
+
+      io::FileUtil::rm(segment->filename());
+      continue;
+    }
+
+    if (!segment->isCompacted()) {
+      segments_.emplace_back(segment);
+    }
+  }
+}
+
+std::shared_ptr<Segment> SegmentRepository::currentSegment() {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+
+  if (current_.get() == nullptr || !current_->isWritable()) {
+    auto fileref = file_repo_->createFile();
+    current_ = Segment::create(fileref.absolute_path, segment_max_size_);
+    segments_.emplace_back(current_);
+  }
+
+  return current_;
+}
+
+void SegmentRepository::compact(
+    uint64_t delay_micros /* = kCompactionDelayMicros */) {
+  std::vector<std::shared_ptr<Segment>> segments;
+  {
+    std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+    segments = segments_;
+  }
+
+  auto now = WallClock::unixMicros();
+  for (const auto& segment : segments) {
+    if (!segment->isSealed() ||
+        segment->lastAppendTime() + delay_micros > now) {
+      continue;
+    }
+
+    if (!segment->compact(file_repo_, hot_metric_size_)) {
+      continue;
+    }
+
+    std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+    for (auto iter = segments_.begin(); iter != segments_.end(); ++iter) {
+      if (*iter == segment) {
+        segments_.erase(iter);
+        break;
+      }
+    }
+  }
+}
+
+size_t SegmentRepository::hotMetricSize() const {
+  return hot_metric_size_;
+}
+
+size_t SegmentRepository::numLiveSegments() const {
+  std::lock_guard<stats::ProfiledMutex> lock_holder(mutex_);
+  return segments_.size();
+}
+
+}
+}
+}
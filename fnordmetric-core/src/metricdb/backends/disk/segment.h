@@ -0,0 +1,318 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_SEGMENT_H_
+#define _FNORDMETRIC_METRICDB_SEGMENT_H_
+#include <fnordmetric/io/filerepository.h>
+#include <fnordmetric/metricdb/backends/disk/tableref.h>
+#include <fnordmetric/sstable/sstablereader.h>
+#include <fnordmetric/sstable/sstablewriter.h>
+#include <fnordmetric/stats/profiledmutex.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace fnord;
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+class LabelIndex;
+class TokenIndex;
+
+/**
+ * A segment is one sstable that holds the live tables of many metrics, so
+ * that low-rate metrics don't need a file and a mapping each. Every metric
+ * that writes into the segment is assigned a metric id and a generation like
+ * any other table (see SegmentTableRef). Rows are keyed by the metric id and
+ * the sample time; a metric id is defined by a row with only the id as its
+ * key and a table header as its data, so live segments can be recovered
+ * after a crash by scanning them.
+ *
+ * While a segment is live, the rows of its metrics are interleaved and the
+ * segment keeps the row ranges of every metric in memory. Once the segment
+ * is larger than its max size it is sealed and later compacted: the rows are
+ * rewritten sorted by (metric id, time) into a new, finalized segment with
+ * one row range per metric and an index footer that stores the ranges, the
+ * table headers and the token and label indexes of all metrics. Metrics with
+ * at least hot_metric_size bytes in the segment are written into their own
+ * tables that are partitioned by series instead (see
+ * TableRef::createSeriesTable). The row ranges of the other metrics stay
+ * ordered by time and have no series catalog, so a scan with a label filter
+ * reads all rows of such a metric in the segment; these metrics are small by
+ * definition.
+ */
+class Segment : public std::enable_shared_from_this<Segment> {
+public:
+  static const uint32_t kIndexType = 0xa0f6;
+  static const uint32_t kHeaderMarker = 0xffffffff;
+  static const uint32_t kFlagCompacted = 1;
+
+  /**
+   * Create a new live segment
+   */
+  static std::shared_ptr<Segment> create(
+      const std::string& filename,
+      size_t max_size);
+
+  /**
+   * Open an existing segment. Live segments are opened sealed. Returns
+   * nullptr if the file is the output of a compaction that didn't finish
+   */
+  static std::shared_ptr<Segment> open(const std::string& filename);
+
+  /**
+   * Returns true if the sstable header belongs to a segment
+   */
+  static bool isSegmentHeader(void const* data, size_t size);
+
+  Segment(const Segment& other) = delete;
+  Segment& operator=(const Segment& other) = delete;
+
+  /**
+   * Add a table for the metric to the live segment. The indexes are used to
+   * encode the samples of the table and to write its own table if the metric
+   * is hot, so they must stay valid until the segment is compacted
+   */
+  std::unique_ptr<TableRef> addTable(
+      const std::string& metric_key,
+      uint64_t generation,
+      const std::vector<uint64_t>& parents,
+      TokenIndex* token_index,
+      LabelIndex* label_index,
+      SeriesIndex* series_index);
+
+  /**
+   * Returns one table per metric id that was not dropped
+   */
+  std::vector<std::unique_ptr<TableRef>> tables();
+
+  /**
+   * Remove the metric id, e.g. because its table was superseded by the
+   * output of a compaction. The rows are removed by the next compaction
+   */
+  void dropTable(uint32_t metric_id);
+
+  /**
+   * Rewrite a sealed live segment as described above. Returns false if the
+   * segment is not sealed or a sample was appended while compacting
+   */
+  bool compact(io::FileRepository const* file_repo, size_t hot_metric_size);
+
+  const std::string& filename() const;
+  size_t bodySize() const;
+
+  /**
+   * Returns true if samples can be appended
+   */
+  bool isWritable() const;
+  bool isSealed() const;
+  bool isCompacted() const;
+
+  /**
+   * Returns true if all metric ids were dropped
+   */
+  bool isEmpty() const;
+
+  /**
+   * The time of the last append in microseconds since epoch
+   */
+  uint64_t lastAppendTime() const;
+
+protected:
+  friend class SegmentTableRef;
+
+  struct MetricEntry {
+    MetricEntry();
+    void addRow(uint64_t offset, size_t row_size, uint64_t time);
+
+    std::string key;
+    uint64_t generation;
+    std::vector<uint64_t> parents;
+
+    /* body offsets of the rows [begin, end) */
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    uint64_t min_time;
+    uint64_t max_time;
+    size_t body_size;
+    bool dropped;
+
+    /* the indexes of the metric, set by import, importSeries or addTable */
+    TokenIndex* token_index;
+    LabelIndex* label_index;
+    SeriesIndex* series_index;
+
+    /* the index footers of a compacted segment */
+    std::string token_index_data;
+    std::string label_index_data;
+
+    /* set if compaction moved the rows into their own table */
+    std::shared_ptr<TableRef> own_table;
+  };
+
+  Segment(const std::string& filename, size_t max_size);
+
+  void addSample(
+      uint32_t metric_id,
+      void const* data,
+      size_t size,
+      uint64_t time);
+
+  std::unique_ptr<sstable::Cursor> cursor(uint32_t metric_id);
+  std::unique_ptr<sstable::Cursor> seriesCursor(
+      uint32_t metric_id,
+      const std::set<uint32_t>& series_ids);
+  bool timeRange(uint32_t metric_id, uint64_t* min_time, uint64_t* max_time);
+  size_t bodySize(uint32_t metric_id);
+
+  void import(
+      uint32_t metric_id,
+      TokenIndex* token_index,
+      LabelIndex* label_index);
+
+  void importSeries(uint32_t metric_id, SeriesIndex* series_index);
+
+  void recover();
+  void readIndex();
+
+  std::string filename_;
+  size_t max_size_;
+  std::shared_ptr<sstable::SSTableWriter> writer_;
+  std::shared_ptr<sstable::SSTableReader> reader_;
+  std::vector<MetricEntry> entries_;
+  std::atomic<bool> sealed_;
+  uint64_t last_append_;
+  bool compacted_;
+  mutable fnord::stats::ProfiledMutex mutex_;
+};
+
+/**
+ * The rows of one metric id in a segment. Shared tables are never finalized
+ * by their metric; they are finalized when the segment is compacted
+ */
+class SegmentTableRef : public TableRef {
+public:
+  SegmentTableRef(
+      std::shared_ptr<Segment> segment,
+      uint32_t metric_id,
+      const std::string& metric_key,
+      uint64_t generation,
+      const std::vector<uint64_t>& parents);
+
+  void addSample(void const* data, size_t size, uint64_t time) override;
+  std::unique_ptr<sstable::Cursor> cursor() override;
+
+  /**
+   * Only partitioned once compaction moved the metric into its own table
+   */
+  std::unique_ptr<sstable::Cursor> seriesCursor(
+      const std::set<uint32_t>& series_ids) override;
+
+  bool timeRange(uint64_t* min_time, uint64_t* max_time) const override;
+
+  /**
+   * Also remembers the indexes, which the segment needs for compaction
+   */
+  void import(
+      TokenIndex* token_index,
+      LabelIndex* label_index) override;
+
+  /**
+   * Shared tables have no series catalog, but the segment remembers the
+   * index to partition the metric if compaction moves it into its own table
+   */
+  void importSeries(SeriesIndex* series_index) override;
+
+  void finalize(
+      TokenIndex* token_index,
+      LabelIndex* label_index) override;
+
+  bool isWritable() const override;
+  bool isShared() const override;
+  size_t bodySize() const override;
+
+  Segment* segment() const;
+  uint32_t metricID() const;
+
+protected:
+  std::shared_ptr<Segment> segment_;
+  uint32_t metric_id_;
+};
+
+/**
+ * Hands out the current live segment of a datadir, rolls over to a new
+ * segment once it is sealed and compacts the sealed segments.
+ */
+class SegmentRepository {
+public:
+  typedef std::unordered_map<
+      std::string,
+      std::vector<std::unique_ptr<TableRef>>> TableMap;
+
+  static const size_t kDefaultSegmentMaxSize = 64 << 20; /* 64MB */
+  static const size_t kDefaultHotMetricSize = 1 << 16; /* 64KB */
+
+  /**
+   * Sealed segments are compacted once no sample was appended to them for
+   * this long
+   */
+  static const uint64_t kCompactionDelayMicros = 1000000;
+
+  /**
+   * @param hot_metric_size A metric that writes this many bytes into a
+   *   segment continues in its own tables
+   */
+  SegmentRepository(
+      io::FileRepository const* file_repo,
+      size_t segment_max_size = kDefaultSegmentMaxSize,
+      size_t hot_metric_size = kDefaultHotMetricSize);
+
+  /**
+   * Open (and repair) all tables and segments in the datadir and the cold
+   * tables in the cold datadir, if any, and add the tables to the map by
+   * metric key. Tables of a metric and generation that exist more than once
+   * because a segment compaction or a move to the cold datadir was
+   * interrupted are opened once and the superseded files are removed
+   */
+  void openTables(
+      TableMap* tables,
+      io::FileRepository const* cold_file_repo = nullptr);
+
+  /**
+   * Returns the live segment that new shared tables are added to
+   */
+  std::shared_ptr<Segment> currentSegment();
+
+  /**
+   * Compact all sealed segments that no sample was appended to for
+   * delay_micros
+   */
+  void compact(uint64_t delay_micros = kCompactionDelayMicros);
+
+  size_t hotMetricSize() const;
+
+  /**
+   * Returns the number of segments that are not compacted yet
+   */
+  size_t numLiveSegments() const;
+
+protected:
+  io::FileRepository const* file_repo_;
+  size_t segment_max_size_;
+  size_t hot_metric_size_;
+  std::shared_ptr<Segment> current_;
+  std::vector<std::shared_ptr<Segment>> segments_;
+  mutable fnord::stats::ProfiledMutex mutex_;
+};
+
+}
+}
+}
+#endif
@@ -0,0 +1,123 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <fnordmetric/metricdb/backends/disk/seriesindex.h>
+
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+
+SeriesIndex::SeriesIndex() :
+    max_series_id_(0),
+    mutex_("disk.series_index") {}
+
+uint32_t SeriesIndex::findOrAddSeries(const LabelList& labels) {
+  auto sorted_labels = sortLabels(labels);
+  auto key = seriesKey(sorted_labels);
+
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
+
+  auto iter = series_ids_.find(key);
+  if (iter != series_ids_.end()) {
+    return iter->second;
+  }
+
+  auto series_id = ++max_series_id_;
+  series_ids_.emplace(key, series_id);
+
+  for (const auto& label : sorted_labels) {
+    postings_[label].insert(series_id);
+  }
+
+  return series_id;
+}
+
+void SeriesIndex::addSeries(uint32_t series_id, const LabelList& labels) {
+  auto sorted_labels = sortLabels(labels);
+  auto key = seriesKey(sorted_labels);
+
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
+
+  /* the first id of a label set wins, but all ids are found by their labels */
+  series_ids_.emplace(key, series_id);
+  for (const auto& label : sorted_labels) {
+    postings_[label].insert(series_id);
+  }
+
+  if (series_id > max_series_id_) {
+    max_series_id_ = series_id;
+  }
+}
+
+std::set<uint32_t> SeriesIndex::findSeries(
+    const LabelList& label_filter) const {
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
+  std::set<uint32_t> series_ids;
+
+  if (label_filter.empty()) {
+    for (const auto& series : series_ids_) {
+      series_ids.insert(series.second);
+    }
+
+    return series_ids;
+  }
+
+  for (size_t i = 0; i < label_filter.size(); ++i) {
+    auto iter = postings_.find(label_filter[i]);
+    if (iter == postings_.end()) {
+      return std::set<uint32_t>();
+    }
+
+    if (i == 0) {
+      series_ids = iter->second;
+      continue;
+    }
+
+    std::set<uint32_t> intersection;
+    std::set_intersection(
+        series_ids.begin(),
+        series_ids.end(),
+        iter->second.begin(),
+        iter->second.end(),
+        std::inserter(intersection, intersection.begin()));
+
+    series_ids.swap(intersection);
+  }
+
+  return series_ids;
+}
+
+size_t SeriesIndex::numSeries() const {
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
+  return series_ids_.size();
+}
+
+SeriesIndex::LabelList SeriesIndex::sortLabels(const LabelList& labels) {
+  auto sorted_labels = labels;
+  std::sort(sorted_labels.begin(), sorted_labels.end());
+  return sorted_labels;
+}
+
+std::string SeriesIndex::seriesKey(const LabelList& sorted_labels) {
+  std::string key;
+
+  for (const auto& label : sorted_labels) {
+    key.append(label.first);
+    key.push_back(0);
+    key.append(label.second);
+    key.push_back(0);
+  }
+
+  return key;
+}
+
+}
+}
+}
@@ -0,0 +1,80 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_SERIESINDEX_H
+#define _FNORDMETRIC_METRICDB_SERIESINDEX_H
+#include <stdlib.h>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fnordmetric/stats/profiledmutex.h>
+
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+
+/**
+ * The series dictionary of a metric: every distinct label set of the metric
+ * is a series and gets an id. The index also keeps the postings of every
+ * label, i.e. the ids of all series that have a label key and value, so the
+ * series that match a label filter can be found without scanning.
+ *
+ * Label sets are compared regardless of the order of their labels.
+ */
+class SeriesIndex {
+public:
+  /**
+   * Footer that stores the series catalog of a table that is partitioned by
+   * series (see TableRef::createSeriesTable)
+   */
+  static const uint32_t kIndexType = 0xa0f8;
+
+  typedef std::vector<std::pair<std::string, std::string>> LabelList;
+
+  SeriesIndex();
+
+  /**
+   * Returns the id of the series with the labels. Assigns a new id if the
+   * metric has no such series yet
+   */
+  uint32_t findOrAddSeries(const LabelList& labels);
+
+  /**
+   * Add a series with a known id, e.g. from the catalog of a table
+   */
+  void addSeries(uint32_t series_id, const LabelList& labels);
+
+  /**
+   * Returns the ids of all series that have all labels of the filter
+   */
+  std::set<uint32_t> findSeries(const LabelList& label_filter) const;
+
+  size_t numSeries() const;
+
+  /**
+   * Returns the labels sorted by key
+   */
+  static LabelList sortLabels(const LabelList& labels);
+
+protected:
+  static std::string seriesKey(const LabelList& sorted_labels);
+
+  std::unordered_map<std::string, uint32_t> series_ids_;
+  std::map<std::pair<std::string, std::string>, std::set<uint32_t>> postings_;
+  uint32_t max_series_id_;
+  mutable fnord::stats::ProfiledMutex mutex_;
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,210 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <algorithm>
+#include <fnordmetric/environment.h>
+#include <fnordmetric/io/fileutil.h>
+#include <fnordmetric/metricdb/backends/disk/labelindex.h>
+#include <fnordmetric/metricdb/backends/disk/labelindexwriter.h>
+#include <fnordmetric/metricdb/backends/disk/samplereader.h>
+#include <fnordmetric/metricdb/backends/disk/seriestablewriter.h>
+#include <fnordmetric/metricdb/backends/disk/tableheaderwriter.h>
+#include <fnordmetric/metricdb/backends/disk/tableref.h>
+#include <fnordmetric/metricdb/backends/disk/tokenindex.h>
+#include <fnordmetric/metricdb/backends/disk/tokenindexwriter.h>
+#include <fnordmetric/sstable/binaryformat.h>
+#include <fnordmetric/sstable/sstablestreamwriter.h>
+#include <fnordmetric/util/binarymessagewriter.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+using namespace fnord;
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+
+SeriesTableWriter::SeriesTableWriter(
+    TokenIndex* token_index,
+    LabelIndex* label_index,
+    SeriesIndex* series_index) :
+    token_index_(token_index),
+    label_index_(label_index),
+    series_index_(series_index),
+    min_time_(UINT64_MAX),
+    max_time_(0) {}
+
+void SeriesTableWriter::addSample(
+    uint64_t time,
+    uint64_t value,
+    const SeriesIndex::LabelList& labels) {
+  SeriesRow row;
+  row.series_id = series_index_->findOrAddSeries(labels);
+  row.time = time;
+  row.value = value;
+
+  if (series_.find(row.series_id) == series_.end()) {
+    series_.emplace(row.series_id, SeriesIndex::sortLabels(labels));
+  }
+
+  min_time_ = std::min(min_time_, time);
+  max_time_ = std::max(max_time_, time);
+  rows_.emplace_back(row);
+}
+
+void SeriesTableWriter::addSamples(sstable::Cursor* cursor) {
+  while (cursor->valid()) {
+    void* key;
+    size_t key_len;
+    void* data;
+    size_t data_size;
+    cursor->getKey(&key, &key_len);
+    cursor->getData(&data, &data_size);
+
+    uint64_t time;
+    uint64_t value;
+    if (key_len != sizeof(time) || data_size < sizeof(value)) {
+      RAISE(kIllegalStateError, "invalid sample");
+    }
+
+    memcpy(&time, key, sizeof(time));
+    memcpy(&value, data, sizeof(value));
+
+    SampleReader<double> sample(data, data_size, token_index_);
+    addSample(time, value, sample.labels());
+
+    if (!cursor->next()) {
+      break;
+    }
+  }
+}
+
+size_t SeriesTableWriter::numSamples() const {
+  return rows_.size();
+}
+
+size_t SeriesTableWriter::numSeries() const {
+  return series_.size();
+}
+
+size_t SeriesTableWriter::bodySize() const {
+  return rows_.size() * (
+      sizeof(sstable::BinaryFormat::RowHeader) +
+      SeriesTableRef::kSeriesKeySize +
+      sizeof(uint64_t));
+}
+
+size_t SeriesTableWriter::write(
+    const std::string& filename,
+    const std::string& metric_key,
+    uint64_t generation,
+    const std::vector<uint64_t>& parents) {
+  std::stable_sort(
+      rows_.begin(),
+      rows_.end(),
+      [] (const SeriesRow& a, const SeriesRow& b) -> bool {
+        if (a.series_id != b.series_id) {
+          return a.series_id < b.series_id;
+        }
+
+        return a.time < b.time;
+      });
+
+  if (env()->verbose()) {
+    env()->logger()->printf(
+        "DEBUG",
+        "Writing series table for metric: '%s', generation: %llu with %i "
+            "series",
+        metric_key.c_str(),
+        (long long unsigned) generation,
+        (int) series_.size());
+  }
+
+  TableHeaderWriter header(metric_key, generation, parents);
+  size_t body_size;
+
+  try {
+    auto writer = sstable::SSTableStreamWriter::create(
+        filename,
+        header.data(),
+        header.size());
+
+    fnord::util::BinaryMessageWriter catalog;
+    catalog.appendUInt32(series_.size());
+
+    char row_key[SeriesTableRef::kSeriesKeySize];
+    for (size_t i = 0; i < rows_.size(); ) {
+      auto series_id = rows_[i].series_id;
+      auto begin = writer->bodySize();
+      memcpy(row_key, &series_id, sizeof(series_id));
+
+      for (; i < rows_.size() && rows_[i].series_id == series_id; ++i) {
+        memcpy(row_key + sizeof(series_id), &rows_[i].time, sizeof(uint64_t));
+        writer->appendRow(
+            row_key,
+            sizeof(row_key),
+            &rows_[i].value,
+            sizeof(rows_[i].value));
+      }
+
+      const auto& labels = series_[series_id];
+      catalog.appendUInt32(series_id);
+      catalog.appendUInt64(begin);
+      catalog.appendUInt64(writer->bodySize());
+      catalog.appendUInt32(labels.size());
+      for (const auto& label : labels) {
+        catalog.appendUInt32(label.first.size());
+        catalog.appendString(label.first);
+        catalog.appendUInt32(label.second.size());
+        catalog.appendString(label.second);
+      }
+    }
+
+    /* the rows don't carry token definitions anymore, but the footer still
+       restores the metric's token index for its other tables */
+    TokenIndexWriter token_index_writer(token_index_);
+    writer->writeIndex(
+        TokenIndex::kIndexType,
+        token_index_writer.data(),
+        token_index_writer.size());
+
+    LabelIndexWriter label_index_writer(label_index_);
+    writer->writeIndex(
+        LabelIndex::kIndexType,
+        label_index_writer.data(),
+        label_index_writer.size());
+
+    if (!rows_.empty()) {
+      fnord::util::BinaryMessageWriter time_range_writer;
+      time_range_writer.appendUInt64(min_time_);
+      time_range_writer.appendUInt64(max_time_);
+      writer->writeIndex(
+          TableRef::kTimeRangeIndexType,
+          time_range_writer.data(),
+          time_range_writer.size());
+    }
+
+    writer->writeIndex(SeriesIndex::kIndexType, catalog.data(), catalog.size());
+    writer->finalize();
+    body_size = writer->bodySize();
+  } catch (util::RuntimeException& e) {
+    io::FileUtil::rm(filename);
+    throw;
+  }
+
+  rows_.clear();
+  series_.clear();
+  min_time_ = UINT64_MAX;
+  max_time_ = 0;
+
+  return body_size;
+}
+
+}
+}
+}
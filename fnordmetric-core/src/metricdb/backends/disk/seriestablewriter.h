@@ -0,0 +1,99 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_SERIESTABLEWRITER_H
+#define _FNORDMETRIC_METRICDB_SERIESTABLEWRITER_H
+#include <stdlib.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <fnordmetric/metricdb/backends/disk/seriesindex.h>
+#include <fnordmetric/sstable/cursor.h>
+
+namespace fnordmetric {
+namespace metricdb {
+namespace disk_backend {
+class LabelIndex;
+class TokenIndex;
+
+/**
+ * Writes the samples of one metric into a finalized table that is partitioned
+ * by series (see TableRef::createSeriesTable). The samples are buffered in
+ * memory and sorted by (series, time) when the table is written; samples of
+ * equal series and time keep the order in which they were added.
+ *
+ * The series ids are assigned by the series index of the metric, so the
+ * catalogs of all tables of a metric agree.
+ */
+class SeriesTableWriter {
+public:
+
+  SeriesTableWriter(
+      TokenIndex* token_index,
+      LabelIndex* label_index,
+      SeriesIndex* series_index);
+
+  SeriesTableWriter(const SeriesTableWriter& other) = delete;
+  SeriesTableWriter& operator=(const SeriesTableWriter& other) = delete;
+
+  /**
+   * Add a sample. The value is the encoded value of the sample (see
+   * SampleWriter::writeValue)
+   */
+  void addSample(
+      uint64_t time,
+      uint64_t value,
+      const SeriesIndex::LabelList& labels);
+
+  /**
+   * Add all samples of a cursor whose rows are keyed by the sample time, e.g.
+   * the cursor of a live table
+   */
+  void addSamples(fnord::sstable::Cursor* cursor);
+
+  size_t numSamples() const;
+  size_t numSeries() const;
+
+  /**
+   * The body size of the table if it was written now
+   */
+  size_t bodySize() const;
+
+  /**
+   * Write the buffered samples into a new table with the header and clear
+   * them. Returns the body size of the table. The file is removed if writing
+   * fails
+   */
+  size_t write(
+      const std::string& filename,
+      const std::string& metric_key,
+      uint64_t generation,
+      const std::vector<uint64_t>& parents);
+
+protected:
+  struct SeriesRow {
+    uint32_t series_id;
+    uint64_t time;
+    uint64_t value;
+  };
+
+  TokenIndex* token_index_;
+  LabelIndex* label_index_;
+  SeriesIndex* series_index_;
+  std::vector<SeriesRow> rows_;
+  std::map<uint32_t, SeriesIndex::LabelList> series_;
+  uint64_t min_time_;
+  uint64_t max_time_;
+};
+
+}
+}
+}
+#endif
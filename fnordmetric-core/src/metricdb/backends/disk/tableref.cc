@@ -8,17 +8,25 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <fnordmetric/environment.h>
+#include <fnordmetric/io/fileutil.h>
+#include <fnordmetric/metricdb/backends/disk/coldtable.h>
 #include <fnordmetric/metricdb/backends/disk/labelindex.h>
 #include <fnordmetric/metricdb/backends/disk/labelindexreader.h>
 #include <fnordmetric/metricdb/backends/disk/labelindexwriter.h>
 #include <fnordmetric/metricdb/backends/disk/samplereader.h>
+#include <fnordmetric/metricdb/backends/disk/seriestablewriter.h>
 #include <fnordmetric/metricdb/backends/disk/tableref.h>
 #include <fnordmetric/metricdb/backends/disk/tableheaderreader.h>
 #include <fnordmetric/metricdb/backends/disk/tableheaderwriter.h>
 #include <fnordmetric/metricdb/backends/disk/tokenindex.h>
 #include <fnordmetric/metricdb/backends/disk/tokenindexwriter.h>
 #include <fnordmetric/metricdb/backends/disk/tokenindexreader.h>
+#include <fnordmetric/sstable/binaryformat.h>
 #include <fnordmetric/sstable/sstablereader.h>
+#include <fnordmetric/util/binarymessagereader.h>
+#include <fnordmetric/util/binarymessagewriter.h>
+#include <algorithm>
+#include <string.h>
 
 using namespace fnord;
 namespace fnordmetric {
@@ -55,19 +63,49 @@ std::unique_ptr<TableRef> TableRef::openTableUnsafe(
   }
 
   if (reader.bodySize() == 0) {
-    return TableRef::reopenTable(
+    auto table = TableRef::reopenTable(
         filename,
         header.metricKey(),
         std::move(file),
         header.generation(),
         header.parents());
+
+    /* rows of live tables are keyed by the sample time only, series tables
+       and cold tables that are being written have other keys */
+    auto cur = table->cursor();
+    if (cur->valid()) {
+      void* key;
+      size_t key_len;
+      cur->getKey(&key, &key_len);
+      if (key_len != sizeof(uint64_t)) {
+        return std::unique_ptr<TableRef>(nullptr);
+      }
+    }
+
+    return table;
+  }
+
+  /* the cursors of cold tables return the rows of the original body */
+  uint32_t codec;
+  size_t body_size = reader.bodySize();
+  auto compressed = ColdTable::readFooter(&reader, &codec, &body_size);
+
+  if (reader.readFooter(SeriesIndex::kIndexType).size() > 0) {
+    return std::unique_ptr<TableRef>(new SeriesTableRef(
+        filename,
+        header.metricKey(),
+        body_size,
+        header.generation(),
+        header.parents(),
+        compressed));
   } else {
     return TableRef::openTable(
         filename,
         header.metricKey(),
-        reader.bodySize(),
+        body_size,
         header.generation(),
-        header.parents());
+        header.parents(),
+        compressed);
   }
 }
 
@@ -133,17 +171,63 @@ std::unique_ptr<TableRef> TableRef::openTable(
     const std::string& metric_key,
     size_t body_size,
     uint64_t generation,
-    const std::vector<uint64_t>& parents) {
+    const std::vector<uint64_t>& parents,
+    bool compressed /* = false */) {
   auto table_ref = new ReadonlyTableRef(
       filename,
       metric_key,
       body_size,
       generation,
-      parents);
+      parents,
+      compressed);
 
   return std::unique_ptr<TableRef>(table_ref);
 }
 
+std::unique_ptr<TableRef> TableRef::createSeriesTable(
+    const std::string& filename,
+    TableRef* table,
+    TokenIndex* token_index,
+    LabelIndex* label_index,
+    SeriesIndex* series_index) {
+  SeriesTableWriter writer(token_index, label_index, series_index);
+  writer.addSamples(table->cursor().get());
+
+  auto body_size = writer.write(
+      filename,
+      table->metricKey(),
+      table->generation(),
+      table->parents());
+
+  return std::unique_ptr<TableRef>(new SeriesTableRef(
+      filename,
+      table->metricKey(),
+      body_size,
+      table->generation(),
+      table->parents()));
+}
+
+std::unique_ptr<TableRef> TableRef::createColdTable(
+    const std::string& filename,
+    TableRef* table) {
+  if (env()->verbose()) {
+    env()->logger()->printf(
+        "DEBUG",
+        "Writing cold table for metric: '%s', generation: %llu",
+        table->metricKey().c_str(),
+        (long long unsigned) table->generation());
+  }
+
+  ColdTable::writeTable(filename, table->filename());
+
+  auto cold_table = TableRef::openTable(filename);
+  if (cold_table.get() == nullptr || !cold_table->isCompressed()) {
+    RAISE(kIllegalStateError, "invalid cold table %s", filename.c_str());
+  }
+
+  return cold_table;
+}
+
 TableRef::TableRef(
     const std::string& filename,
     const std::string& metric_key,
@@ -170,6 +254,21 @@ const std::vector<uint64_t> TableRef::parents() const {
   return parents_;
 }
 
+std::unique_ptr<sstable::Cursor> TableRef::seriesCursor(
+    const std::set<uint32_t>& series_ids) {
+  return cursor();
+}
+
+void TableRef::importSeries(SeriesIndex* series_index) {}
+
+bool TableRef::isShared() const {
+  return false;
+}
+
+bool TableRef::isCompressed() const {
+  return false;
+}
+
 LiveTableRef::LiveTableRef(
     const std::string& filename,
     const std::string& metric_key,
@@ -178,20 +277,46 @@ LiveTableRef::LiveTableRef(
     const std::vector<uint64_t>& parents) :
     TableRef(filename, metric_key, generation, parents),
     table_(std::move(table)),
-    is_writable_(true) {
+    is_writable_(true),
+    min_time_(UINT64_MAX),
+    max_time_(0) {
 }
 
 LiveTableRef::~LiveTableRef() {
 }
 
-void LiveTableRef::addSample(SampleWriter const* sample, uint64_t time) {
-  table_->appendRow(&time, sizeof(time), sample->data(), sample->size()); // FIXPAUL
+void LiveTableRef::addSample(void const* data, size_t size, uint64_t time) {
+  if (time < max_time_.load()) {
+    RAISE(
+        kIllegalArgumentError,
+        "sample time %llu is older than the last sample in table %s",
+        (long long unsigned) time,
+        filename_.c_str());
+  }
+
+  table_->appendRow(&time, sizeof(time), data, size);
+
+  /* timeRange reads min_time_ first, so max_time_ is valid once it's set */
+  max_time_.store(time);
+  if (min_time_.load() == UINT64_MAX) {
+    min_time_.store(time);
+  }
 }
 
 std::unique_ptr<sstable::Cursor> LiveTableRef::cursor() {
   return table_->getCursor();
 }
 
+bool LiveTableRef::timeRange(uint64_t* min_time, uint64_t* max_time) const {
+  *min_time = min_time_.load();
+  if (*min_time == UINT64_MAX) {
+    return false;
+  }
+
+  *max_time = max_time_.load();
+  return true;
+}
+
 bool LiveTableRef::isWritable() const {
   return is_writable_;
 }
@@ -218,6 +343,23 @@ void LiveTableRef::import(TokenIndex* token_index, LabelIndex* label_index) {
       label_index->addLabel(label.first);
     }
 
+    void* key;
+    size_t key_len;
+    uint64_t time;
+    cur->getKey(&key, &key_len);
+    if (key_len != sizeof(time)) {
+      RAISE(kIllegalStateError, "invalid key");
+    }
+
+    memcpy(&time, key, sizeof(time));
+    if (time < min_time_.load()) {
+      min_time_.store(time);
+    }
+
+    if (time > max_time_.load()) {
+      max_time_.store(time);
+    }
+
     if (!cur->next()) {
       break;
     }
@@ -241,6 +383,19 @@ void LiveTableRef::finalize(
       label_index_writer.data(),
       label_index_writer.size());
 
+  uint64_t min_time;
+  uint64_t max_time;
+  if (timeRange(&min_time, &max_time)) {
+    fnord::util::BinaryMessageWriter time_range_writer;
+    time_range_writer.appendUInt64(min_time);
+    time_range_writer.appendUInt64(max_time);
+
+    table_->writeIndex(
+        kTimeRangeIndexType,
+        time_range_writer.data(),
+        time_range_writer.size());
+  }
+
   table_->finalize();
 }
 
@@ -249,9 +404,15 @@ ReadonlyTableRef::ReadonlyTableRef(
     const std::string& metric_key,
     size_t body_size,
     uint64_t generation,
-    const std::vector<uint64_t>& parents) :
+    const std::vector<uint64_t>& parents,
+    bool compressed /* = false */) :
     TableRef(filename, metric_key, generation, parents),
-    body_size_(body_size) {}
+    body_size_(body_size),
+    compressed_(compressed),
+    obsolete_(false),
+    time_range_loaded_(false),
+    min_time_(UINT64_MAX),
+    max_time_(0) {}
 
 ReadonlyTableRef::ReadonlyTableRef(
     const TableRef& live_table) :
@@ -260,15 +421,95 @@ ReadonlyTableRef::ReadonlyTableRef(
         live_table.filename(),
         live_table.metricKey(),
         live_table.generation(),
-        live_table.parents()) {}
+        live_table.parents()),
+    compressed_(false),
+    obsolete_(false),
+    time_range_loaded_(true),
+    min_time_(UINT64_MAX),
+    max_time_(0) {
+  live_table.timeRange(&min_time_, &max_time_);
+}
+
+ReadonlyTableRef::~ReadonlyTableRef() {
+  if (!obsolete_.load()) {
+    return;
+  }
+
+  if (env()->verbose()) {
+    env()->logger()->printf(
+        "DEBUG",
+        "Removing obsolete sstable: '%s'",
+        filename_.c_str());
+  }
 
-void ReadonlyTableRef::addSample(SampleWriter const* sample, uint64_t time) {
+  try {
+    io::FileUtil::rm(filename_);
+  } catch (util::RuntimeException& e) {
+    env()->logger()->printf(
+        "ERROR",
+        "error while removing obsolete sstable %s: %s",
+        filename_.c_str(),
+        e.getMessage().c_str());
+  }
+}
+
+void ReadonlyTableRef::addSample(void const* data, size_t size, uint64_t time) {
   RAISE(kIllegalStateError, "table is immutable");
 }
 
 std::unique_ptr<sstable::Cursor> ReadonlyTableRef::cursor() {
-  auto table = openTable();
-  return table->getCursor();
+  return openCursor();
+}
+
+bool ReadonlyTableRef::timeRange(
+    uint64_t* min_time,
+    uint64_t* max_time) const {
+  std::lock_guard<std::mutex> lock_holder(time_range_mutex_);
+
+  if (!time_range_loaded_) {
+    auto reader = openTable();
+    auto footer = reader->readFooter(kTimeRangeIndexType);
+
+    if (footer.size() == 2 * sizeof(uint64_t)) {
+      fnord::util::BinaryMessageReader footer_reader(
+          footer.data(),
+          footer.size());
+
+      min_time_ = *footer_reader.readUInt64();
+      max_time_ = *footer_reader.readUInt64();
+    } else {
+      auto cur = openCursor();
+
+      while (cur->valid()) {
+        void* key;
+        size_t key_len;
+        uint64_t time;
+        cur->getKey(&key, &key_len);
+        if (key_len != sizeof(time)) {
+          RAISE(kIllegalStateError, "invalid key");
+        }
+
+        memcpy(&time, key, sizeof(time));
+        if (time < min_time_) {
+          min_time_ = time;
+        }
+
+        if (time > max_time_) {
+          max_time_ = time;
+        }
+
+        if (!cur->next()) {
+          break;
+        }
+      }
+    }
+
+    time_range_loaded_ = true;
+  }
+
+  *min_time = min_time_;
+  *max_time = max_time_;
+  return min_time_ != UINT64_MAX;
 }
 
 void ReadonlyTableRef::import(
@@ -324,7 +565,16 @@ size_t ReadonlyTableRef::bodySize() const {
   return body_size_;
 }
 
-std::unique_ptr<fnord::sstable::SSTableReader> ReadonlyTableRef::openTable() {
+bool ReadonlyTableRef::isCompressed() const {
+  return compressed_;
+}
+
+void ReadonlyTableRef::setObsolete() {
+  obsolete_.store(true);
+}
+
+std::unique_ptr<fnord::sstable::SSTableReader> ReadonlyTableRef::openTable()
+    const {
   if (env()->verbose()) {
     env()->logger()->printf(
         "DEBUG",
@@ -337,6 +587,344 @@ std::unique_ptr<fnord::sstable::SSTableReader> ReadonlyTableRef::openTable() {
       new sstable::SSTableReader(std::move(file)));
 }
 
+std::unique_ptr<sstable::Cursor> ReadonlyTableRef::openCursor() const {
+  auto table = openTable();
+  if (compressed_) {
+    return ColdTable::openCursor(filename_, std::move(table));
+  }
+
+  return table->getCursor();
+}
+
+/**
+ * Merges the row ranges of the selected series of a SeriesTableRef by time.
+ * The key is the sample time and the data is the value followed by the
+ * labels of the series
+ */
+class SeriesCursor : public sstable::Cursor {
+public:
+  SeriesCursor(
+      std::unique_ptr<sstable::Cursor> cursor,
+      std::shared_ptr<const std::vector<SeriesTableRef::Series>> catalog,
+      const std::vector<size_t>& series) :
+      cursor_(std::move(cursor)),
+      catalog_(catalog) {
+    for (const auto index : series) {
+      const auto& entry = (*catalog_)[index];
+      if (entry.begin < entry.end) {
+        pushRow(index, entry.begin);
+      }
+    }
+  }
+
+  void seekTo(size_t body_offset) override {
+    RAISE(kNotImplementedError, "seekTo is not supported on series tables");
+  }
+
+  bool next() override {
+    if (heap_.empty()) {
+      return false;
+    }
+
+    auto row = heap_.front();
+    cursor_->seekTo(row.pos);
+
+    void* key;
+    size_t key_size;
+    void* data;
+    size_t data_size;
+    cursor_->getKey(&key, &key_size);
+    cursor_->getData(&data, &data_size);
+
+    auto next_pos = row.pos + sizeof(sstable::BinaryFormat::RowHeader) +
+        key_size + data_size;
+    auto has_next = next_pos < (*catalog_)[row.series].end;
+
+    /* like the sstable cursors, stay on the last row */
+    if (!has_next && heap_.size() == 1) {
+      return false;
+    }
+
+    std::pop_heap(heap_.begin(), heap_.end(), RowCompare());
+    heap_.pop_back();
+
+    if (has_next) {
+      pushRow(row.series, next_pos);
+    }
+
+    return true;
+  }
+
+  bool valid() override {
+    return !heap_.empty();
+  }
+
+  void getKey(void** data, size_t* size) override {
+    if (heap_.empty()) {
+      RAISE(kIllegalStateError, "cursor is not valid");
+    }
+
+    *data = &heap_.front().time;
+    *size = sizeof(uint64_t);
+  }
+
+  void getData(void** data, size_t* size) override {
+    if (heap_.empty()) {
+      RAISE(kIllegalStateError, "cursor is not valid");
+    }
+
+    const auto& row = heap_.front();
+    void* value;
+    size_t value_size;
+    cursor_->seekTo(row.pos);
+    cursor_->getData(&value, &value_size);
+
+    buffer_.assign(static_cast<char*>(value), value_size);
+    buffer_.append((*catalog_)[row.series].label_tokens);
+    *data = &buffer_[0];
+    *size = buffer_.size();
+  }
+
+  size_t position() const override {
+    return heap_.empty() ? 0 : heap_.front().pos;
+  }
+
+protected:
+  struct Row {
+    uint64_t time;
+    size_t series;
+    uint64_t pos;
+  };
+
+  struct RowCompare {
+    bool operator()(const Row& a, const Row& b) const {
+      /* std::push_heap builds a max heap */
+      if (a.time != b.time) {
+        return a.time > b.time;
+      }
+
+      return a.series > b.series;
+    }
+  };
+
+  void pushRow(size_t series, uint64_t pos) {
+    void* key;
+    size_t key_size;
+    cursor_->seekTo(pos);
+    cursor_->getKey(&key, &key_size);
+    if (key_size != SeriesTableRef::kSeriesKeySize) {
+      RAISE(kIllegalStateError, "invalid series key");
+    }
+
+    Row row;
+    row.series = series;
+    row.pos = pos;
+    memcpy(
+        &row.time,
+        static_cast<char*>(key) + sizeof(uint32_t),
+        sizeof(row.time));
+
+    heap_.emplace_back(row);
+    std::push_heap(heap_.begin(), heap_.end(), RowCompare());
+  }
+
+  std::unique_ptr<sstable::Cursor> cursor_;
+  std::shared_ptr<const std::vector<SeriesTableRef::Series>> catalog_;
+  std::vector<Row> heap_;
+  std::string buffer_;
+};
+
+SeriesTableRef::SeriesTableRef(
+    const std::string& filename,
+    const std::string& metric_key,
+    size_t size,
+    uint64_t generation,
+    const std::vector<uint64_t>& parents,
+    bool compressed /* = false */) :
+    ReadonlyTableRef(
+        filename,
+        metric_key,
+        size,
+        generation,
+        parents,
+        compressed) {}
+
+std::unique_ptr<sstable::Cursor> SeriesTableRef::cursor() {
+  auto catalog = this->catalog();
+  std::vector<size_t> series;
+  for (size_t i = 0; i < catalog->size(); ++i) {
+    series.emplace_back(i);
+  }
+
+  return std::unique_ptr<sstable::Cursor>(
+      new SeriesCursor(openCursor(), catalog, series));
+}
+
+std::unique_ptr<sstable::Cursor> SeriesTableRef::seriesCursor(
+    const std::set<uint32_t>& series_ids) {
+  auto catalog = this->catalog();
+  std::vector<size_t> series;
+  for (size_t i = 0; i < catalog->size(); ++i) {
+    if (series_ids.count((*catalog)[i].series_id) > 0) {
+      series.emplace_back(i);
+    }
+  }
+
+  return std::unique_ptr<sstable::Cursor>(
+      new SeriesCursor(openCursor(), catalog, series));
+}
+
+void SeriesTableRef::importSeries(SeriesIndex* series_index) {
+  for (const auto& series : *catalog()) {
+    series_index->addSeries(series.series_id, series.labels);
+  }
+}
+
+std::shared_ptr<const std::vector<SeriesTableRef::Series>>
+    SeriesTableRef::catalog() const {
+  std::lock_guard<std::mutex> lock_holder(catalog_mutex_);
+
+  if (catalog_.get() != nullptr) {
+    return catalog_;
+  }
+
+  auto footer = openTable()->readFooter(SeriesIndex::kIndexType);
+  fnord::util::BinaryMessageReader reader(footer.data(), footer.size());
+  std::shared_ptr<std::vector<Series>> catalog(new std::vector<Series>());
+
+  auto num_series = *reader.readUInt32();
+  for (uint32_t i = 0; i < num_series; ++i) {
+    Series series;
+    series.series_id = *reader.readUInt32();
+    series.begin = *reader.readUInt64();
+    series.end = *reader.readUInt64();
+
+    fnord::util::BinaryMessageWriter label_tokens;
+    auto num_labels = *reader.readUInt32();
+    for (uint32_t j = 0; j < num_labels; ++j) {
+      auto key_len = *reader.readUInt32();
+      std::string key(static_cast<const char*>(reader.read(key_len)), key_len);
+      auto value_len = *reader.readUInt32();
+      std::string value(
+          static_cast<const char*>(reader.read(value_len)),
+          value_len);
+
+      label_tokens.appendUInt32(key.size());
+      label_tokens.appendString(key);
+      label_tokens.appendUInt32(value.size());
+      label_tokens.appendString(value);
+      series.labels.emplace_back(key, value);
+    }
+
+    series.label_tokens = std::string(
+        static_cast<char*>(label_tokens.data()),
+        label_tokens.size());
+
+    catalog->emplace_back(series);
+  }
+
+  catalog_ = catalog;
+  return catalog_;
+}
+
+/**
+ * A cursor over the rows of a MemoryTableRef
+ */
+class MemoryTableCursor : public sstable::Cursor {
+public:
+  MemoryTableCursor(
+      const MemoryTableRef::RowList* rows) :
+      rows_(rows),
+      pos_(0) {}
+
+  void seekTo(size_t body_offset) override {
+    RAISE(kNotImplementedError, "seekTo is not supported on in-memory tables");
+  }
+
+  bool next() override {
+    if (pos_ + 1 >= rows_->size()) {
+      return false;
+    }
+
+    ++pos_;
+    return true;
+  }
+
+  bool valid() override {
+    return pos_ < rows_->size();
+  }
+
+  void getKey(void** data, size_t* size) override {
+    *data = const_cast<uint64_t*>(&(*rows_)[pos_].first);
+    *size = sizeof(uint64_t);
+  }
+
+  void getData(void** data, size_t* size) override {
+    const auto& row_data = (*rows_)[pos_].second;
+    *data = const_cast<char*>(row_data.data());
+    *size = row_data.size();
+  }
+
+  size_t position() const override {
+    return pos_;
+  }
+
+protected:
+  const MemoryTableRef::RowList* rows_;
+  size_t pos_;
+};
+
+MemoryTableRef::MemoryTableRef(
+    const std::string& metric_key,
+    RowList&& rows) :
+    TableRef("", metric_key, 0, std::vector<uint64_t>()),
+    rows_(std::move(rows)),
+    body_size_(0) {
+  for (const auto& row : rows_) {
+    body_size_ += sizeof(uint64_t) + row.second.size();
+  }
+}
+
+void MemoryTableRef::addSample(void const* data, size_t size, uint64_t time) {
+  RAISE(kIllegalStateError, "table is immutable");
+}
+
+std::unique_ptr<sstable::Cursor> MemoryTableRef::cursor() {
+  return std::unique_ptr<sstable::Cursor>(new MemoryTableCursor(&rows_));
+}
+
+bool MemoryTableRef::timeRange(uint64_t* min_time, uint64_t* max_time) const {
+  if (rows_.empty()) {
+    return false;
+  }
+
+  *min_time = rows_.front().first;
+  *max_time = rows_.back().first;
+  return true;
+}
+
+void MemoryTableRef::import(
+    TokenIndex* token_index,
+    LabelIndex* label_index) {}
+
+void MemoryTableRef::finalize(
+    TokenIndex* token_index,
+    LabelIndex* label_index) {
+  RAISE(kIllegalStateError, "table is immutable");
+}
+
+bool MemoryTableRef::isWritable() const {
+  return false;
+}
+
+size_t MemoryTableRef::bodySize() const {
+  return body_size_;
+}
+
+const MemoryTableRef::RowList& MemoryTableRef::rows() const {
+  return rows_;
+}
+
 }
 }
 }
@@ -10,10 +10,15 @@
 #ifndef _FNORDMETRIC_METRICDB_TABLEREF_H_
 #define _FNORDMETRIC_METRICDB_TABLEREF_H_
 #include <fnordmetric/metricdb/backends/disk/samplewriter.h>
+#include <fnordmetric/metricdb/backends/disk/seriesindex.h>
 #include <fnordmetric/metricdb/sample.h>
 #include <fnordmetric/sstable/sstablereader.h>
 #include <fnordmetric/sstable/sstablewriter.h>
+#include <atomic>
+#include <mutex>
+#include <set>
 #include <string>
+#include <vector>
 
 using namespace fnord;
 namespace fnordmetric {
@@ -24,10 +29,20 @@ class TableHeaderReader;
 
 class TableRef {
 public:
+  /**
+   * Footer that stores the time range of a finalized table. Tables that were
+   * finalized before it was introduced don't have it
+   */
+  static const uint32_t kTimeRangeIndexType = 0xa0f4;
+
   TableRef(const TableRef& other) = delete;
   TableRef& operator=(const TableRef& other) = delete;
   virtual ~TableRef() {}
 
+  /**
+   * Returns nullptr if the file is a series table or a cold table that was
+   * not completely written (see createSeriesTable and ColdTable)
+   */
   static std::unique_ptr<TableRef> openTable(const std::string filename);
   static std::unique_ptr<TableRef> openTableUnsafe(const std::string filename);
 
@@ -50,17 +65,77 @@ public:
       const std::string& metric_key,
       size_t body_size,
       uint64_t generation,
-      const std::vector<uint64_t>& parents);
+      const std::vector<uint64_t>& parents,
+      bool compressed = false);
+
+  /**
+   * Write the samples of a sealed table into a new finalized table that is
+   * partitioned by series: the rows of every series (see SeriesIndex) are
+   * stored in one contiguous range sorted by time and only carry the series
+   * id, the time and the value. The labels and the row range of every series
+   * are stored in the series catalog footer. The new table has the metric
+   * key, generation and parents of the sealed table
+   */
+  static std::unique_ptr<TableRef> createSeriesTable(
+      const std::string& filename,
+      TableRef* table,
+      TokenIndex* token_index,
+      LabelIndex* label_index,
+      SeriesIndex* series_index);
+
+  /**
+   * Write a copy of a finalized table whose body is compressed in blocks (see
+   * ColdTable) and open it. The new table has the metric key, generation and
+   * parents of the finalized table
+   */
+  static std::unique_ptr<TableRef> createColdTable(
+      const std::string& filename,
+      TableRef* table);
 
-  virtual void addSample(SampleWriter const* sample, uint64_t time) = 0;
+  /**
+   * Append an encoded sample. The samples of a table must be appended in
+   * ascending time order; this raises an exception otherwise
+   */
+  virtual void addSample(void const* data, size_t size, uint64_t time) = 0;
   virtual std::unique_ptr<sstable::Cursor> cursor() = 0;
 
+  /**
+   * Returns a cursor over the samples of the provided series in ascending
+   * time order. Tables that are not partitioned by series return a cursor
+   * over all samples
+   */
+  virtual std::unique_ptr<sstable::Cursor> seriesCursor(
+      const std::set<uint32_t>& series_ids);
+
+  /**
+   * Store the time of the oldest and the newest sample in the table in
+   * min_time and max_time. Returns false if the table is empty
+   */
+  virtual bool timeRange(uint64_t* min_time, uint64_t* max_time) const = 0;
+
   virtual void import(TokenIndex* token_index, LabelIndex* label_index) = 0;
   virtual void finalize(TokenIndex* token_index, LabelIndex* label_index) = 0;
 
+  /**
+   * Add the series of a table that is partitioned by series to the index
+   */
+  virtual void importSeries(SeriesIndex* series_index);
+
   virtual bool isWritable() const = 0;
   virtual size_t bodySize() const = 0;
 
+  /**
+   * Returns true if the table is stored in a segment together with the
+   * tables of other metrics (see Segment)
+   */
+  virtual bool isShared() const;
+
+  /**
+   * Returns true if the body of the table is compressed in blocks (see
+   * ColdTable). bodySize returns the size of the uncompressed body
+   */
+  virtual bool isCompressed() const;
+
   const std::string& filename() const;
   const std::string& metricKey() const;
   uint64_t generation() const;
@@ -88,8 +163,9 @@ public:
       uint64_t generation,
       const std::vector<uint64_t>& parents);
   ~LiveTableRef();
-  void addSample(SampleWriter const* sample, uint64_t time) override;
+  void addSample(void const* data, size_t size, uint64_t time) override;
   std::unique_ptr<sstable::Cursor> cursor() override;
+  bool timeRange(uint64_t* min_time, uint64_t* max_time) const override;
 
   void import(
       TokenIndex* token_index,
@@ -105,6 +181,8 @@ public:
 protected:
   bool is_writable_;
   std::unique_ptr<sstable::SSTableWriter> table_;
+  std::atomic<uint64_t> min_time_;
+  std::atomic<uint64_t> max_time_;
 };
 
 class ReadonlyTableRef : public TableRef {
@@ -114,13 +192,114 @@ public:
       const std::string& metric_key,
       size_t size,
       uint64_t generation,
-      const std::vector<uint64_t>& parents);
+      const std::vector<uint64_t>& parents,
+      bool compressed = false);
 
   explicit ReadonlyTableRef(
       const TableRef& live_table);
 
-  void addSample(SampleWriter const* sample, uint64_t time) override;
+  /**
+   * Removes the file if the table is obsolete
+   */
+  ~ReadonlyTableRef();
+
+  void addSample(void const* data, size_t size, uint64_t time) override;
+  std::unique_ptr<sstable::Cursor> cursor() override;
+
+  /**
+   * Reads the time range footer on the first call. The range of tables
+   * without the footer is computed by reading all sample times once
+   */
+  bool timeRange(uint64_t* min_time, uint64_t* max_time) const override;
+
+  void import(
+      TokenIndex* token_index,
+      LabelIndex* label_index) override;
+
+  void finalize(
+      TokenIndex* token_index,
+      LabelIndex* label_index) override;
+
+  bool isWritable() const override;
+  size_t bodySize() const override;
+  bool isCompressed() const override;
+
+  /**
+   * Remove the file once the table is freed, i.e. when no snapshot that
+   * contains the table is used anymore. Used when a table was replaced by a
+   * copy in another file
+   */
+  void setObsolete();
+
+protected:
+  std::unique_ptr<fnord::sstable::SSTableReader> openTable() const;
+
+  /**
+   * Returns a cursor over the (uncompressed) rows of the table
+   */
+  std::unique_ptr<sstable::Cursor> openCursor() const;
+
+  size_t body_size_;
+  bool compressed_;
+  std::atomic<bool> obsolete_;
+  mutable std::mutex time_range_mutex_;
+  mutable bool time_range_loaded_;
+  mutable uint64_t min_time_;
+  mutable uint64_t max_time_;
+};
+
+/**
+ * A finalized table that is partitioned by series (see createSeriesTable).
+ * The series catalog is read on first use. The cursors append the labels of
+ * the series to the value of every row as anonymous tokens, so the rows are
+ * read like any other encoded sample
+ */
+class SeriesTableRef : public ReadonlyTableRef {
+public:
+  static const size_t kSeriesKeySize = sizeof(uint32_t) + sizeof(uint64_t);
+
+  struct Series {
+    uint32_t series_id;
+    SeriesIndex::LabelList labels;
+    std::string label_tokens;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  explicit SeriesTableRef(
+      const std::string& filename,
+      const std::string& metric_key,
+      size_t size,
+      uint64_t generation,
+      const std::vector<uint64_t>& parents,
+      bool compressed = false);
+
+  std::unique_ptr<sstable::Cursor> cursor() override;
+  std::unique_ptr<sstable::Cursor> seriesCursor(
+      const std::set<uint32_t>& series_ids) override;
+
+  void importSeries(SeriesIndex* series_index) override;
+
+protected:
+  std::shared_ptr<const std::vector<Series>> catalog() const;
+
+  mutable std::mutex catalog_mutex_;
+  mutable std::shared_ptr<const std::vector<Series>> catalog_;
+};
+
+/**
+ * An immutable in-memory table of encoded samples, sorted by time. Used to
+ * include samples that are not yet written to an sstable in a scan
+ */
+class MemoryTableRef : public TableRef {
+public:
+  typedef std::vector<std::pair<uint64_t, std::string>> RowList;
+
+  MemoryTableRef(const std::string& metric_key, RowList&& rows);
+
+  void addSample(void const* data, size_t size, uint64_t time) override;
   std::unique_ptr<sstable::Cursor> cursor() override;
+  bool timeRange(uint64_t* min_time, uint64_t* max_time) const override;
 
   void import(
       TokenIndex* token_index,
@@ -133,8 +312,10 @@ public:
   bool isWritable() const override;
   size_t bodySize() const override;
 
+  const RowList& rows() const;
+
 protected:
-  std::unique_ptr<fnord::sstable::SSTableReader> openTable();
+  RowList rows_;
   size_t body_size_;
 };
 
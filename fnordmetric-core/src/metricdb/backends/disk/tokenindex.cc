@@ -14,10 +14,12 @@ namespace fnordmetric {
 namespace metricdb {
 namespace disk_backend {
 
-TokenIndex::TokenIndex() : max_token_id_(kMinTokenID) {}
+TokenIndex::TokenIndex() :
+    max_token_id_(kMinTokenID),
+    mutex_("disk.token_index") {}
 
 uint32_t TokenIndex::findToken(const std::string& key) const {
-  std::lock_guard<std::mutex> lock_holder(mutex_);
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
 
   auto iter = token_ids_.find(key);
   if (iter == token_ids_.end()) {
@@ -28,7 +30,7 @@ uint32_t TokenIndex::findToken(const std::string& key) const {
 }
 
 uint32_t TokenIndex::addToken(const std::string& key) {
-  std::lock_guard<std::mutex> lock_holder(mutex_);
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
 
   auto iter = token_ids_.find(key);
   if (iter != token_ids_.end()) {
@@ -42,7 +44,7 @@ uint32_t TokenIndex::addToken(const std::string& key) {
 }
 
 void TokenIndex::addToken(const std::string& key, uint32_t id) {
-  std::lock_guard<std::mutex> lock_holder(mutex_);
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
 
   auto iter = token_ids_.find(key);
   if (iter == token_ids_.end()) {
@@ -60,7 +62,7 @@ void TokenIndex::addToken(const std::string& key, uint32_t id) {
 }
 
 std::string TokenIndex::resolveToken(uint32_t token_id) const {
-  std::lock_guard<std::mutex> lock_holder(mutex_);
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
 
   // FIXPAUL!
   for (const auto& pair : token_ids_) {
@@ -76,7 +78,7 @@ std::unordered_map<std::string, uint32_t> TokenIndex::tokenIDs() const {
   std::unordered_map<std::string, uint32_t> copy;
 
   {
-    std::lock_guard<std::mutex> lock_holder(mutex_);
+    std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(mutex_);
     copy = token_ids_;
   }
 
@@ -15,6 +15,7 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include <fnordmetric/stats/profiledmutex.h>
 
 namespace fnordmetric {
 namespace metricdb {
@@ -37,7 +38,7 @@ protected:
   std::unordered_map<std::string, uint32_t> token_ids_;
 
   uint32_t max_token_id_;
-  mutable std::mutex mutex_;
+  mutable fnord::stats::ProfiledMutex mutex_;
 };
 
 
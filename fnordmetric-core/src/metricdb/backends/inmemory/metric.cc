@@ -7,8 +7,10 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <fnordmetric/environment.h>
 #include <fnordmetric/metricdb/backends/inmemory/metric.h>
 #include <fnordmetric/util/wallclock.h>
+#include <algorithm>
 
 namespace fnordmetric {
 namespace metricdb {
@@ -20,37 +22,66 @@ using fnord::util::WallClock;
 Metric::Metric(
     const std::string& key) :
     IMetric(key),
+    labels_mutex_("inmemory.labels"),
+    values_mutex_("inmemory.values"),
     total_bytes_(0),
     last_insert_time_(0) {}
 
 void Metric::insertSampleImpl(
     double value,
     const std::vector<std::pair<std::string, std::string>>& labels) {
+  BatchSample sample;
+  sample.time = 0;
+  sample.value = value;
+  sample.labels = labels;
+  insertSamplesImpl(std::vector<BatchSample>{sample});
+}
+
+void Metric::insertSamplesImpl(const std::vector<BatchSample>& samples) {
+  static auto samples_inserted =
+      env()->stats()->counter("inmemory.samples_inserted");
+  samples_inserted->incr(samples.size());
 
   {
-    std::lock_guard<std::mutex> lock_holder(labels_mutex_);
-    for (const auto& pair : labels) {
-      labels_.emplace(pair.first);
+    std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(labels_mutex_);
+    for (const auto& sample : samples) {
+      for (const auto& pair : sample.labels) {
+        labels_.emplace(pair.first);
+      }
     }
   }
 
   {
-    std::lock_guard<std::mutex> lock_holder(values_mutex_);
-    last_insert_time_ = WallClock::unixMicros();
-    MemSample sample = {
-      .time = DateTime(last_insert_time_),
-      .value = value,
-      .labels = labels};
-
-    values_.emplace_back(sample);
+    std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(values_mutex_);
+    uint64_t now = WallClock::unixMicros();
+    last_insert_time_ = now;
+
+    for (const auto& sample : samples) {
+      MemSample mem_sample = {
+        .time = DateTime(sample.time == 0 ? now : sample.time),
+        .value = sample.value,
+        .labels = sample.labels};
+
+      /* keep the samples sorted by time */
+      auto pos = std::upper_bound(
+          values_.begin(),
+          values_.end(),
+          mem_sample,
+          [] (const MemSample& a, const MemSample& b) {
+            return a.time < b.time;
+          });
+
+      values_.insert(pos, mem_sample);
+    }
   }
 }
 
 void Metric::scanSamples(
     const DateTime& time_begin,
     const DateTime& time_end,
-    std::function<bool (Sample* sample)> callback) {
-  std::lock_guard<std::mutex> lock_holder(values_mutex_);
+    std::function<bool (Sample* sample)> callback,
+    ScanStats* stats /* = nullptr */) {
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(values_mutex_);
 
   for (const auto sample : values_) {
     if (sample.time < time_begin) {
@@ -77,12 +108,12 @@ DateTime Metric::lastInsertTime() const {
 }
 
 std::set<std::string> Metric::labels() const {
-  std::lock_guard<std::mutex> lock_holder(labels_mutex_);
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(labels_mutex_);
   return labels_;
 }
 
 bool Metric::hasLabel(const std::string& label) const {
-  std::lock_guard<std::mutex> lock_holder(labels_mutex_);
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(labels_mutex_);
   return labels_.find(label) != labels_.end();
 }
 
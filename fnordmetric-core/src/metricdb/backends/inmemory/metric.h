@@ -12,6 +12,7 @@
 #include <atomic>
 #include <mutex>
 #include <fnordmetric/metricdb/metric.h>
+#include <fnordmetric/stats/profiledmutex.h>
 
 namespace fnordmetric {
 namespace metricdb {
@@ -29,7 +30,8 @@ public:
   void scanSamples(
       const DateTime& time_begin,
       const DateTime& time_end,
-      std::function<bool (Sample* sample)> callback) override;
+      std::function<bool (Sample* sample)> callback,
+      ScanStats* stats = nullptr) override;
 
   size_t totalBytes() const override;
   DateTime lastInsertTime() const override;
@@ -42,6 +44,8 @@ protected:
       double value,
       const std::vector<std::pair<std::string, std::string>>& labels) override;
 
+  void insertSamplesImpl(const std::vector<BatchSample>& samples) override;
+
   struct MemSample {
     DateTime time;
     double value;
@@ -50,9 +54,9 @@ protected:
 
   const std::string key_;
 
-  mutable std::mutex labels_mutex_;
+  mutable fnord::stats::ProfiledMutex labels_mutex_;
   std::set<std::string> labels_;
-  mutable std::mutex values_mutex_;
+  mutable fnord::stats::ProfiledMutex values_mutex_;
   std::vector<MemSample> values_;
   std::atomic_size_t total_bytes_;
   std::atomic_uint_fast64_t last_insert_time_;
@@ -0,0 +1,132 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/environment.h>
+#include <fnordmetric/io/fileutil.h>
+#include <fnordmetric/metricdb/database.h>
+#include <fnordmetric/metricdb/backends/disk/metricrepository.h>
+#include <fnordmetric/metricdb/metrictablerepository.h>
+#include <fnordmetric/sql/runtime/rowsink.h>
+#include <fnordmetric/util/exceptionhandler.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Collects the rows of one result list into batches of kResultBatchSize
+ */
+class ResultBatchSink : public query::RowSink {
+public:
+
+  ResultBatchSink(
+      size_t result_index,
+      const std::vector<std::string>& columns,
+      Database::ResultCallback callback) :
+      batch_{result_index, columns, {}, false},
+      callback_(callback) {}
+
+  bool nextRow(query::SValue* row, int row_len) override {
+    batch_.rows.emplace_back(row, row + row_len);
+
+    if (batch_.rows.size() >= Database::kResultBatchSize) {
+      callback_(batch_);
+      batch_.rows.clear();
+    }
+
+    return true;
+  }
+
+  void flush() {
+    batch_.last = true;
+    callback_(batch_);
+  }
+
+protected:
+  Database::ResultBatch batch_;
+  Database::ResultCallback callback_;
+};
+
+Database::Database(
+    const std::string& datadir,
+    size_t num_threads /* = 2 */) {
+  if (!fnord::io::FileUtil::exists(datadir)) {
+    fnord::io::FileUtil::mkdir_p(datadir);
+  }
+
+  if (!fnord::io::FileUtil::isDirectory(datadir)) {
+    RAISE(kIOError, "File %s is not a directory", datadir.c_str());
+  }
+
+  thread_pool_.reset(
+      new fnord::thread::ThreadPool(
+          std::unique_ptr<fnord::util::ExceptionHandler>(
+              new fnord::util::CatchAndPrintExceptionHandler(
+                  fnordmetric::env()->logger())),
+          num_threads,
+          "database"));
+
+  metric_repo_.reset(
+      new disk_backend::MetricRepository(datadir, thread_pool_.get()));
+
+  query_service_.setScheduler(thread_pool_.get());
+}
+
+Database::~Database() {
+  /* stop the compactions before the metrics are freed */
+  thread_pool_.reset(nullptr);
+}
+
+IMetric* Database::getMetric(const std::string& key) {
+  return metric_repo_->findOrCreateMetric(key);
+}
+
+IMetric* Database::findMetric(const std::string& key) const {
+  return metric_repo_->findMetric(key);
+}
+
+std::vector<IMetric*> Database::listMetrics() const {
+  return metric_repo_->listMetrics();
+}
+
+void Database::insertSamples(
+    const std::string& key,
+    const std::vector<IMetric::BatchSample>& samples) {
+  metric_repo_->findOrCreateMetric(key)->insertSamples(samples);
+}
+
+void Database::executeQuery(
+    const std::string& query_string,
+    ResultCallback callback,
+    query::QueryContext* context /* = nullptr */) {
+  std::unique_ptr<ResultBatchSink> sink;
+
+  query_service_.executeQuery(
+      query_string,
+      std::unique_ptr<query::TableRepository>(
+          new MetricTableRepository(metric_repo_.get())),
+      [&sink, &callback] (
+          size_t index,
+          const std::vector<std::string>& columns) -> query::RowSink* {
+        sink.reset(new ResultBatchSink(index, columns, callback));
+        return sink.get();
+      },
+      [&sink] (size_t index) {
+        sink->flush();
+        sink.reset(nullptr);
+      },
+      context);
+}
+
+IMetricRepository* Database::metricRepository() const {
+  return metric_repo_.get();
+}
+
+}
+}
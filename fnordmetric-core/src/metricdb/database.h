@@ -0,0 +1,127 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_DATABASE_H
+#define _FNORDMETRIC_METRICDB_DATABASE_H
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fnordmetric/metricdb/metric.h>
+#include <fnordmetric/metricdb/metricrepository.h>
+#include <fnordmetric/query/queryservice.h>
+#include <fnordmetric/sql/runtime/querycontext.h>
+#include <fnordmetric/sql/svalue.h>
+#include <fnordmetric/thread/threadpool.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * The embedding API: opens a disk backend datadir inside the calling process
+ * so that collectors and batch jobs can link libfnord and write samples and
+ * run ChartSQL queries without a socket round-trip or a text encoding.
+ *
+ *   Database db("/var/lib/fnordmetric");
+ *
+ *   std::vector<IMetric::BatchSample> batch;
+ *   ...
+ *   db.insertSamples("http_latency", batch);
+ *
+ *   db.executeQuery(
+ *       "SELECT time, value FROM http_latency;",
+ *       [] (const Database::ResultBatch& result) {
+ *         for (const auto& row : result.rows) {
+ *           auto value = row[1].getValue<FloatType>();
+ *           ...
+ *         }
+ *       });
+ *
+ * The datadir may be shared with a fnordmetric-server only if the server is
+ * not running: both would append to and compact the same files.
+ *
+ * All methods are threadsafe. Compactions run in the background on a thread
+ * pool owned by the database, which also executes partitioned table scans.
+ */
+class Database {
+public:
+  static const size_t kResultBatchSize = 1024;
+
+  /**
+   * A batch of at most kResultBatchSize typed rows of one result list. The
+   * columns reference is valid for the duration of the callback.
+   */
+  struct ResultBatch {
+    size_t result_index;
+    const std::vector<std::string>& columns;
+    std::vector<std::vector<query::SValue>> rows;
+    bool last;
+  };
+
+  typedef std::function<void (const ResultBatch& batch)> ResultCallback;
+
+  /**
+   * Open the disk backend at datadir, which is created if it does not exist.
+   * Raises an exception if datadir is not a directory
+   */
+  explicit Database(const std::string& datadir, size_t num_threads = 2);
+  ~Database();
+
+  Database(const Database& copy) = delete;
+  Database& operator=(const Database& copy) = delete;
+
+  /**
+   * Returns the metric with this key, creating it if it does not exist. The
+   * returned pointer is owned by the database and valid for its lifetime
+   */
+  IMetric* getMetric(const std::string& key);
+
+  /**
+   * Returns the metric with this key or nullptr
+   */
+  IMetric* findMetric(const std::string& key) const;
+
+  std::vector<IMetric*> listMetrics() const;
+
+  /**
+   * Insert a batch of samples into the metric with this key
+   */
+  void insertSamples(
+      const std::string& key,
+      const std::vector<IMetric::BatchSample>& samples);
+
+  /**
+   * Execute a ChartSQL query and pass the rows of every result list to the
+   * callback in batches while they are produced. The last batch of each
+   * result list has last set to true and may be empty. This may raise an
+   * exception.
+   *
+   * @param context The context that bounds the query's execution time and
+   *   memory usage or nullptr for no limits
+   */
+  void executeQuery(
+      const std::string& query_string,
+      ResultCallback callback,
+      query::QueryContext* context = nullptr);
+
+  /**
+   * Returns the metric repository, e.g. to serve it with the HTTP API.
+   * Does not transfer ownership
+   */
+  IMetricRepository* metricRepository() const;
+
+protected:
+  std::unique_ptr<fnord::thread::ThreadPool> thread_pool_;
+  std::unique_ptr<IMetricRepository> metric_repo_;
+  query::QueryService query_service_;
+};
+
+}
+}
+#endif
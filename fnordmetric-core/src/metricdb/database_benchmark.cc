@@ -0,0 +1,297 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fnordmetric/environment.h>
+#include <fnordmetric/http/httpserver.h>
+#include <fnordmetric/io/filerepository.h>
+#include <fnordmetric/io/fileutil.h>
+#include <fnordmetric/metricdb/database.h>
+#include <fnordmetric/metricdb/httpapi.h>
+#include <fnordmetric/metricdb/messagepackdecoder.h>
+#include <fnordmetric/metricdb/statsd.h>
+#include <fnordmetric/msgpack/messagepackwriter.h>
+#include <fnordmetric/thread/threadpool.h>
+#include <fnordmetric/util/benchmark.h>
+#include <fnordmetric/util/exceptionhandler.h>
+#include <fnordmetric/util/runtimeexception.h>
+#include <fnordmetric/util/signalhandler.h>
+#include <fnordmetric/util/wallclock.h>
+
+using namespace fnordmetric;
+using namespace fnordmetric::metricdb;
+
+/**
+ * Ingest throughput of the embedded API compared to the network interfaces.
+ * Every case inserts the same kNumSamples labeled samples into a disk
+ * backend; the statsd and HTTP cases go through an in-process server on the
+ * loopback interface, including the socket round-trip and text or msgpack
+ * encoding and decoding:
+ *
+ *   EmbeddedInsertSamples  Database::insertSamples with one batch
+ *   StatsdUDP              statsd datagrams of up to 1400 bytes
+ *   HTTPPostForm           one POST /metrics request per sample
+ *   HTTPPostMessagePack    one POST /metrics request with a msgpack batch
+ *
+ * The statsd case waits until all samples were inserted.
+ */
+BENCHMARK_SUITE(EmbeddedIngestBenchmark);
+
+const char kBenchmarkDatabasePath[] = "/tmp/__fnordmetric_benchmark_database";
+static const int kStatsdPort = 18925;
+static const int kHTTPPort = 18980;
+static const uint64_t kNumSamples = 1000;
+
+static std::unique_ptr<Database> database;
+static std::unique_ptr<fnord::thread::ThreadPool> server_pool;
+static std::vector<IMetric::BatchSample> samples;
+static std::vector<std::string> datagrams;
+static std::vector<std::string> form_requests;
+static std::string msgpack_request;
+static int udp_fd;
+static int http_fd;
+
+static int connectTo(int type, int port) {
+  int fd = socket(AF_INET, type, 0);
+  if (fd < 0) {
+    RAISE_ERRNO(kIOError, "socket() failed");
+  }
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  for (int attempt = 0; ; ++attempt) {
+    if (::connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+      break;
+    }
+
+    if (attempt > 100) {
+      RAISE_ERRNO(kIOError, "connect() failed");
+    }
+
+    usleep(10000);
+  }
+
+  int opt = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+  return fd;
+}
+
+static std::string postRequest(
+    const std::string& content_type,
+    const std::string& body) {
+  char header[256];
+  snprintf(
+      header,
+      sizeof(header),
+      "POST /metrics HTTP/1.1\r\n" \
+      "Host: localhost\r\n" \
+      "Content-Type: %s\r\n" \
+      "Content-Length: %zu\r\n" \
+      "\r\n",
+      content_type.c_str(),
+      body.size());
+
+  return header + body;
+}
+
+/**
+ * Send the request and block until the complete response was received
+ */
+static void sendHTTPRequest(const std::string& request) {
+  if (write(http_fd, request.data(), request.size()) != request.size()) {
+    RAISE_ERRNO(kIOError, "write() failed");
+  }
+
+  std::string response;
+  char buf[4096];
+
+  for (;;) {
+    auto bytes_read = read(http_fd, buf, sizeof(buf));
+    if (bytes_read <= 0) {
+      RAISE_ERRNO(kIOError, "read() failed");
+    }
+
+    response.append(buf, bytes_read);
+
+    auto header_end = response.find("\r\n\r\n");
+    if (header_end == std::string::npos) {
+      continue;
+    }
+
+    size_t content_length = 0;
+    auto cl = response.find("content-length: ");
+    if (cl != std::string::npos && cl < header_end) {
+      content_length = std::stoul(
+          response.substr(cl + 16, header_end - cl - 16));
+    }
+
+    if (response.size() >= header_end + 4 + content_length) {
+      break;
+    }
+  }
+
+  if (response.compare(9, 3, "201") != 0) {
+    RAISE(kRuntimeError, "unexpected response: %s", response.c_str());
+  }
+}
+
+BENCHMARK_INITIALIZER(EmbeddedIngestBenchmark, StartServers, [] () {
+  fnordmetric::util::SignalHandler::ignoreSIGPIPE();
+
+  fnord::io::FileUtil::mkdir_p(kBenchmarkDatabasePath);
+  fnord::io::FileRepository(kBenchmarkDatabasePath).deleteAllFiles();
+  database.reset(new Database(kBenchmarkDatabasePath));
+
+  server_pool.reset(
+      new fnord::thread::ThreadPool(
+          std::unique_ptr<fnord::util::ExceptionHandler>(
+              new fnord::util::CatchAndAbortExceptionHandler("crashed")),
+          4,
+          "ingest"));
+
+  auto statsd_server = new StatsdServer(
+      database->metricRepository(),
+      server_pool.get(),
+      server_pool.get(),
+      nullptr);
+  statsd_server->listen(kStatsdPort);
+
+  auto http_server = new fnord::http::HTTPServer(server_pool.get());
+  http_server->addHandler(
+      std::unique_ptr<fnord::http::HTTPHandler>(
+          new HTTPAPI(database->metricRepository())));
+
+  /* the http server runs its first event loop on the listening thread */
+  std::thread([http_server] () {
+    http_server->listen(kHTTPPort);
+  }).detach();
+
+  udp_fd = connectTo(SOCK_DGRAM, kStatsdPort);
+  http_fd = connectTo(SOCK_STREAM, kHTTPPort);
+
+  char buf[256];
+  std::string datagram;
+  std::string msgpack_body;
+  fnord::msgpack::MessagePackWriter msgpack(&msgpack_body);
+  msgpack.writeArrayHeader(2);
+  msgpack.writeUInt(MessagePackDecoder::kMessageTypeString);
+  msgpack.writeString("bench_msgpack");
+
+  for (int i = 0; i < kNumSamples; ++i) {
+    char host[16];
+    char path[16];
+    snprintf(host, sizeof(host), "web%03i", i % 100);
+    snprintf(path, sizeof(path), "/api/v%i", i % 3);
+
+    IMetric::BatchSample sample;
+    sample.time = 0;
+    sample.value = i * 1.5;
+    sample.labels.emplace_back("host", host);
+    sample.labels.emplace_back("path", path);
+    samples.emplace_back(sample);
+
+    snprintf(
+        buf,
+        sizeof(buf),
+        "bench_statsd[host=%s][path=%s]:%f",
+        host,
+        path,
+        sample.value);
+
+    if (datagram.size() + strlen(buf) + 1 > 1400) {
+      datagrams.emplace_back(datagram);
+      datagram.clear();
+    }
+
+    if (!datagram.empty()) {
+      datagram += "\n";
+    }
+
+    datagram += buf;
+
+    snprintf(
+        buf,
+        sizeof(buf),
+        "metric=bench_http&value=%f&label[host]=%s&label[path]=%s",
+        sample.value,
+        host,
+        path);
+
+    form_requests.emplace_back(
+        postRequest("application/x-www-form-urlencoded", buf));
+
+    msgpack.writeArrayHeader(5);
+    msgpack.writeUInt(MessagePackDecoder::kMessageTypeSample);
+    msgpack.writeUInt(0);
+    msgpack.writeUInt(0);
+    msgpack.writeFloat(sample.value);
+    msgpack.writeMapHeader(2);
+    msgpack.writeString("host");
+    msgpack.writeString(host);
+    msgpack.writeString("path");
+    msgpack.writeString(path);
+  }
+
+  datagrams.emplace_back(datagram);
+  msgpack_request = postRequest("application/msgpack", msgpack_body);
+});
+
+BENCHMARK_CASE(
+    EmbeddedIngestBenchmark,
+    EmbeddedInsertSamples,
+    kNumSamples,
+    [] () {
+  database->insertSamples("bench_embedded", samples);
+});
+
+BENCHMARK_CASE(EmbeddedIngestBenchmark, StatsdUDP, kNumSamples, [] () {
+  auto samples_received = env()->stats()->counter("statsd.samples_received");
+  auto target = samples_received->get() + kNumSamples;
+
+  for (const auto& datagram : datagrams) {
+    if (write(udp_fd, datagram.data(), datagram.size()) < 0) {
+      RAISE_ERRNO(kIOError, "write() failed");
+    }
+  }
+
+  auto deadline = fnord::util::WallClock::unixMicros() + 10 * 1000000;
+  while (samples_received->get() < target) {
+    if (fnord::util::WallClock::unixMicros() > deadline) {
+      RAISE(kRuntimeError, "statsd samples were dropped");
+    }
+
+    usleep(10);
+  }
+});
+
+BENCHMARK_CASE(EmbeddedIngestBenchmark, HTTPPostForm, kNumSamples, [] () {
+  for (const auto& request : form_requests) {
+    sendHTTPRequest(request);
+  }
+});
+
+BENCHMARK_CASE(
+    EmbeddedIngestBenchmark,
+    HTTPPostMessagePack,
+    kNumSamples,
+    [] () {
+  sendHTTPRequest(msgpack_request);
+});
@@ -0,0 +1,160 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string>
+#include <vector>
+#include <fnordmetric/metricdb/debughandler.h>
+#include <fnordmetric/stats/allocationscope.h>
+#include <fnordmetric/stats/profiledmutex.h>
+#include <fnordmetric/stats/threadcputime.h>
+#include <fnordmetric/util/jsonoutputstream.h>
+#include <fnordmetric/util/stringutil.h>
+#include <fnordmetric/util/uri.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+static const char kDebugUrl[] = "/debug";
+
+struct LockSnapshot {
+  std::string name;
+  uint64_t acquisitions;
+  uint64_t contentions;
+  stats::Histogram::Snapshot wait_nanos;
+  stats::Histogram::Snapshot hold_nanos;
+};
+
+static void renderHistogram(
+    const stats::Histogram::Snapshot& snapshot,
+    util::JSONOutputStream* json) {
+  json->beginObject();
+  json->addObjectEntry("count");
+  json->addLiteral<uint64_t>(snapshot.count);
+  json->addComma();
+  json->addObjectEntry("mean");
+  json->addFloat(snapshot.mean());
+  json->addComma();
+  json->addObjectEntry("p50");
+  json->addFloat(snapshot.percentile(50));
+  json->addComma();
+  json->addObjectEntry("p99");
+  json->addFloat(snapshot.percentile(99));
+  json->addComma();
+  json->addObjectEntry("max");
+  json->addFloat(snapshot.max());
+  json->endObject();
+}
+
+bool DebugHandler::handleHTTPRequest(
+    http::HTTPRequest* request,
+    http::HTTPResponse* response) {
+  util::URI uri(request->getUrl());
+  auto path = uri.path();
+  fnord::util::StringUtil::stripTrailingSlashes(&path);
+
+  if (path != kDebugUrl ||
+      request->method() != http::HTTPRequest::M_GET) {
+    return false;
+  }
+
+  /* copy the lock stats so we don't write json while holding the lock */
+  std::vector<LockSnapshot> locks;
+  stats::LockStats::exportAll(
+      [&locks] (const std::string& name, const stats::LockStats& lock) {
+        LockSnapshot snapshot;
+        snapshot.name = name;
+        snapshot.acquisitions = lock.acquisitions.get();
+        snapshot.contentions = lock.contentions.get();
+        snapshot.wait_nanos = lock.wait_nanos.snapshot();
+        snapshot.hold_nanos = lock.hold_nanos.snapshot();
+        locks.emplace_back(snapshot);
+      });
+
+  response->setStatus(http::kStatusOK);
+  response->addHeader("Content-Type", "application/json; charset=utf-8");
+  util::JSONOutputStream json(response->getBodyOutputStream());
+
+  json.beginObject();
+  json.addObjectEntry("profiling_enabled");
+  json.addBool(stats::ProfiledMutex::kEnabled);
+  json.addComma();
+  json.addObjectEntry("locks");
+  json.beginObject();
+
+  for (int i = 0; i < locks.size(); ++i) {
+    if (i > 0) { json.addComma(); }
+    json.addObjectEntry(locks[i].name);
+    json.beginObject();
+    json.addObjectEntry("acquisitions");
+    json.addLiteral<uint64_t>(locks[i].acquisitions);
+    json.addComma();
+    json.addObjectEntry("contentions");
+    json.addLiteral<uint64_t>(locks[i].contentions);
+    json.addComma();
+    json.addObjectEntry("wait_nanos");
+    renderHistogram(locks[i].wait_nanos, &json);
+    json.addComma();
+    json.addObjectEntry("hold_nanos");
+    renderHistogram(locks[i].hold_nanos, &json);
+    json.endObject();
+  }
+
+  json.endObject();
+  json.addComma();
+  json.addObjectEntry("allocations");
+  json.beginObject();
+
+  for (int i = 0; i < stats::AllocationStats::kNumSubsystems; ++i) {
+    auto subsystem = static_cast<stats::AllocationStats::kSubsystem>(i);
+    const auto& allocs = stats::AllocationStats::get(subsystem);
+
+    if (i > 0) { json.addComma(); }
+    json.addObjectEntry(stats::AllocationStats::subsystemName(subsystem));
+    json.beginObject();
+    json.addObjectEntry("allocations");
+    json.addLiteral<uint64_t>(allocs.allocations.get());
+    json.addComma();
+    json.addObjectEntry("frees");
+    json.addLiteral<uint64_t>(allocs.frees.get());
+    json.addComma();
+    json.addObjectEntry("bytes_allocated");
+    json.addLiteral<uint64_t>(allocs.bytes_allocated.get());
+    json.endObject();
+  }
+
+  json.endObject();
+  json.addComma();
+  json.addObjectEntry("threads");
+  json.beginArray();
+
+  auto threads = stats::getThreadCPUTimes();
+  for (int i = 0; i < threads.size(); ++i) {
+    if (i > 0) { json.addComma(); }
+    json.beginObject();
+    json.addObjectEntry("tid");
+    json.addLiteral<uint64_t>(threads[i].tid);
+    json.addComma();
+    json.addObjectEntry("name");
+    json.addString(threads[i].name);
+    json.addComma();
+    json.addObjectEntry("user_ms");
+    json.addFloat(threads[i].user_millis);
+    json.addComma();
+    json.addObjectEntry("system_ms");
+    json.addFloat(threads[i].system_millis);
+    json.endObject();
+  }
+
+  json.endArray();
+  json.endObject();
+  return true;
+}
+
+}
+}
@@ -0,0 +1,35 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_DEBUGHANDLER_H
+#define _FNORDMETRIC_METRICDB_DEBUGHANDLER_H
+#include <fnordmetric/http/httphandler.h>
+#include <fnordmetric/http/httprequest.h>
+#include <fnordmetric/http/httpresponse.h>
+
+using namespace fnord;
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Renders the lock contention and allocation statistics (see ProfiledMutex
+ * and AllocationScope) and the CPU time of every thread as JSON on
+ * GET /debug. Locks and allocations are only recorded if the server was built
+ * with -DENABLE_PROFILING=ON; "profiling_enabled" tells which build this is.
+ */
+class DebugHandler : public http::HTTPHandler {
+public:
+  bool handleHTTPRequest(
+      http::HTTPRequest* request,
+      http::HTTPResponse* response) override;
+};
+
+}
+}
+#endif
@@ -0,0 +1,108 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/metricdb/executorstatshandler.h>
+#include <fnordmetric/util/jsonoutputstream.h>
+#include <fnordmetric/util/stringutil.h>
+#include <fnordmetric/util/uri.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+static const char kExecutorsUrl[] = "/executors";
+
+void ExecutorStatsHandler::addExecutor(thread::ThreadPool* executor) {
+  executors_.emplace_back(executor);
+}
+
+void ExecutorStatsHandler::addAdmissionController(
+    const std::string& name,
+    thread::AdmissionController* admission) {
+  admission_controllers_.emplace_back(name, admission);
+}
+
+bool ExecutorStatsHandler::handleHTTPRequest(
+    http::HTTPRequest* request,
+    http::HTTPResponse* response) {
+  util::URI uri(request->getUrl());
+  auto path = uri.path();
+  fnord::util::StringUtil::stripTrailingSlashes(&path);
+
+  if (path != kExecutorsUrl ||
+      request->method() != http::HTTPRequest::M_GET) {
+    return false;
+  }
+
+  response->setStatus(http::kStatusOK);
+  response->addHeader("Content-Type", "application/json; charset=utf-8");
+  util::JSONOutputStream json(response->getBodyOutputStream());
+
+  json.beginObject();
+  json.addObjectEntry("executors");
+  json.beginArray();
+
+  for (int i = 0; i < executors_.size(); ++i) {
+    auto stats = executors_[i]->getStats();
+
+    if (i > 0) { json.addComma(); }
+    json.beginObject();
+    json.addObjectEntry("name");
+    json.addString(stats.name);
+    json.addComma();
+    json.addObjectEntry("threads");
+    json.addLiteral<size_t>(stats.num_threads);
+    json.addComma();
+    json.addObjectEntry("queue_depth");
+    json.addLiteral<size_t>(stats.queue_depth);
+    json.addComma();
+    json.addObjectEntry("tasks");
+    json.addLiteral<uint64_t>(stats.num_tasks);
+    json.addComma();
+    json.addObjectEntry("wait_micros_p50");
+    json.addFloat(stats.wait_micros.percentile(50));
+    json.addComma();
+    json.addObjectEntry("wait_micros_p99");
+    json.addFloat(stats.wait_micros.percentile(99));
+    json.addComma();
+    json.addObjectEntry("wait_micros_max");
+    json.addFloat(stats.wait_micros.max());
+    json.endObject();
+  }
+
+  json.endArray();
+  json.addComma();
+  json.addObjectEntry("admission");
+  json.beginArray();
+
+  for (int i = 0; i < admission_controllers_.size(); ++i) {
+    const auto& admission = admission_controllers_[i];
+
+    if (i > 0) { json.addComma(); }
+    json.beginObject();
+    json.addObjectEntry("name");
+    json.addString(admission.first);
+    json.addComma();
+    json.addObjectEntry("running");
+    json.addLiteral<size_t>(admission.second->numRunning());
+    json.addComma();
+    json.addObjectEntry("queued");
+    json.addLiteral<size_t>(admission.second->numQueued());
+    json.addComma();
+    json.addObjectEntry("rejected");
+    json.addLiteral<uint64_t>(admission.second->numRejected());
+    json.endObject();
+  }
+
+  json.endArray();
+  json.endObject();
+  return true;
+}
+
+}
+}
@@ -0,0 +1,56 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_EXECUTORSTATSHANDLER_H
+#define _FNORDMETRIC_METRICDB_EXECUTORSTATSHANDLER_H
+#include <string>
+#include <utility>
+#include <vector>
+#include <fnordmetric/http/httphandler.h>
+#include <fnordmetric/http/httprequest.h>
+#include <fnordmetric/http/httpresponse.h>
+#include <fnordmetric/thread/admissioncontroller.h>
+#include <fnordmetric/thread/threadpool.h>
+
+using namespace fnord;
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Renders the queue depth and queue latency of the server's executors and
+ * the state of its admission controllers as JSON on GET /executors
+ */
+class ExecutorStatsHandler : public http::HTTPHandler {
+public:
+
+  /**
+   * Does not transfer ownership
+   */
+  void addExecutor(thread::ThreadPool* executor);
+
+  /**
+   * Does not transfer ownership
+   */
+  void addAdmissionController(
+      const std::string& name,
+      thread::AdmissionController* admission);
+
+  bool handleHTTPRequest(
+      http::HTTPRequest* request,
+      http::HTTPResponse* response) override;
+
+protected:
+  std::vector<thread::ThreadPool*> executors_;
+  std::vector<std::pair<std::string, thread::AdmissionController*>>
+      admission_controllers_;
+};
+
+}
+}
+#endif
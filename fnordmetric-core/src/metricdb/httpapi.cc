@@ -7,8 +7,10 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <limits>
 #include <fnordmetric/environment.h>
 #include <fnordmetric/metricdb/httpapi.h>
+#include <fnordmetric/metricdb/messagepackdecoder.h>
 #include <fnordmetric/query/queryservice.h>
 #include <fnordmetric/metricdb/metricrepository.h>
 #include <fnordmetric/metricdb/metrictablerepository.h>
@@ -24,8 +26,64 @@ static const char kMetricsUrl[] = "/metrics";
 static const char kMetricsUrlPrefix[] = "/metrics/";
 static const char kQueryUrl[] = "/query";
 static const char kLabelParamPrefix[] = "label[";
+static const char kMessagePackContentType[] = "application/msgpack";
+static const char kMessagePackContentTypeLegacy[] = "application/x-msgpack";
+
+/* returns false if the parameter is set but not an integer */
+static bool getIntegerParam(
+    const util::URI::ParamList& params,
+    const std::string& key,
+    int64_t* value) {
+  std::string str;
+  if (!util::URI::getParam(params, key, &str)) {
+    return true;
+  }
+
+  try {
+    size_t pos;
+    auto parsed = std::stoll(str, &pos);
+    if (pos != str.size()) {
+      return false;
+    }
 
-HTTPAPI::HTTPAPI(IMetricRepository* metric_repo) : metric_repo_(metric_repo) {}
+    *value = parsed;
+  } catch (const std::exception& e) {
+    return false;
+  }
+
+  return true;
+}
+
+HTTPAPI::HTTPAPI(
+    IMetricRepository* metric_repo) :
+    HTTPAPI(metric_repo, nullptr) {}
+
+HTTPAPI::HTTPAPI(
+    IMetricRepository* metric_repo,
+    thread::TaskScheduler* query_scheduler) :
+    metric_repo_(metric_repo),
+    query_timeout_(0),
+    query_memory_limit_(0),
+    window_cache_(
+        query::WindowCache::kDefaultMaxEntries,
+        IMetric::kLateSampleSlackMicros) {
+  query_service_.setScheduler(query_scheduler);
+  query_service_.setWindowCache(&window_cache_);
+
+  if (!env()->flags()->isSet("disable_external_sources")) {
+    query_service_.registerBackend(
+        std::unique_ptr<fnordmetric::query::Backend>(
+            new fnordmetric::query::mysql_backend::MySQLBackend));
+
+    query_service_.registerBackend(
+        std::unique_ptr<fnordmetric::query::Backend>(
+            new fnordmetric::query::postgres_backend::PostgresBackend));
+
+    query_service_.registerBackend(
+        std::unique_ptr<fnordmetric::query::Backend>(
+            new fnordmetric::query::csv_backend::CSVBackend));
+  }
+}
 
 bool HTTPAPI::handleHTTPRequest(
     http::HTTPRequest* request,
@@ -107,6 +165,24 @@ void HTTPAPI::insertSample(
   const auto& postbody = request->getBody();
   util::URI::ParamList params;
 
+  const auto& content_type = request->getHeader("Content-Type");
+  if (content_type == kMessagePackContentType ||
+      content_type == kMessagePackContentTypeLegacy) {
+    MessagePackDecoder decoder(metric_repo_);
+
+    /* a body with an invalid message is rejected as a whole */
+    try {
+      decoder.decodeAll(postbody.data(), postbody.size());
+    } catch (util::RuntimeException& e) {
+      response->addBody("error: " + e.getMessage());
+      response->setStatus(http::kStatusBadRequest);
+      return;
+    }
+
+    response->setStatus(http::kStatusCreated);
+    return;
+  }
+
   if (postbody.size() > 0) {
     util::URI::parseQueryString(postbody, &params);
   } else {
@@ -176,52 +252,88 @@ void HTTPAPI::renderMetricSampleScan(
 
   response->setStatus(http::kStatusOK);
   response->addHeader("Content-Type", "application/json; charset=utf-8");
-  util::JSONOutputStream json(response->getBodyOutputStream());
 
-  json.beginObject();
+  /* the samples are written to the connection while the metric is scanned */
+  response->setBodyWriter([this, metric] (
+      std::shared_ptr<util::OutputStream> body) {
+    util::JSONOutputStream json(body);
 
-  json.addObjectEntry("metric");
-  renderMetricJSON(metric, &json);
-  json.addComma();
+    json.beginObject();
 
-  json.addObjectEntry("samples");
-  json.beginArray();
+    json.addObjectEntry("metric");
+    renderMetricJSON(metric, &json);
+    json.addComma();
 
-  int i = 0;
-  metric->scanSamples(
-      fnord::util::DateTime::epoch(),
-      fnord::util::DateTime::now(),
-      [&json, &i] (Sample* sample) -> bool {
-        if (i++ > 0) { json.addComma(); }
-        json.beginObject();
-
-        json.addObjectEntry("time");
-        json.addLiteral<uint64_t>(static_cast<uint64_t>(sample->time()));
-        json.addComma();
-
-        json.addObjectEntry("value");
-        json.addLiteral<double>(sample->value());
-        json.addComma();
-
-        json.addObjectEntry("labels");
-        json.beginObject();
-        auto labels = sample->labels();
-        for (int n = 0; n < labels.size(); n++) {
-          if (n > 0) {
-            json.addComma();
+    json.addObjectEntry("samples");
+    json.beginArray();
+
+    int i = 0;
+    metric->scanSamples(
+        fnord::util::DateTime::epoch(),
+        fnord::util::DateTime::now(),
+        [&json, &i] (Sample* sample) -> bool {
+          if (i++ > 0) { json.addComma(); }
+          json.beginObject();
+
+          json.addObjectEntry("time");
+          json.addLiteral<uint64_t>(static_cast<uint64_t>(sample->time()));
+          json.addComma();
+
+          json.addObjectEntry("value");
+          json.addLiteral<double>(sample->value());
+          json.addComma();
+
+          json.addObjectEntry("labels");
+          json.beginObject();
+          auto labels = sample->labels();
+          for (int n = 0; n < labels.size(); n++) {
+            if (n > 0) {
+              json.addComma();
+            }
+
+            json.addObjectEntry(labels[n].first);
+            json.addString(labels[n].second);
           }
+          json.endObject();
 
-          json.addObjectEntry(labels[n].first);
-          json.addString(labels[n].second);
-        }
-        json.endObject();
+          json.endObject();
+          return true;
+        });
 
-        json.endObject();
-        return true;
-      });
+    json.endArray();
+    json.endObject();
+  });
+}
 
-  json.endArray();
-  json.endObject();
+void HTTPAPI::setQueryLimits(uint64_t timeout_micros, size_t memory_limit) {
+  query_timeout_ = timeout_micros;
+  query_memory_limit_ = memory_limit;
+}
+
+std::shared_ptr<query::QueryContext> HTTPAPI::makeQueryContext(
+    http::HTTPRequest* request,
+    int64_t timeout_millis) const {
+  auto timeout = query_timeout_;
+
+  /* a client may shorten the timeout, but never disable or extend it */
+  if (timeout_millis > 0) {
+    auto timeout_micros = static_cast<uint64_t>(timeout_millis) * 1000;
+    if (timeout == 0 || timeout_micros < timeout) {
+      timeout = timeout_micros;
+    }
+  }
+
+  std::shared_ptr<query::QueryContext> context(new query::QueryContext());
+  context->setTimeout(timeout);
+  context->setMemoryLimit(query_memory_limit_);
+
+  /* the request outlives the query: it is executed from the handler or the
+     response's body writer */
+  context->setCancellationCheck([request] () -> bool {
+    return request->isCancelled();
+  });
+
+  return context;
 }
 
 void HTTPAPI::executeQuery(
@@ -238,28 +350,6 @@ void HTTPAPI::executeQuery(
     input_stream = request->getBodyInputStream();
   }
 
-  std::shared_ptr<util::OutputStream> output_stream =
-      response->getBodyOutputStream();
-
-  query::QueryService query_service;
-  std::unique_ptr<query::TableRepository> table_repo(
-      new MetricTableRepository(metric_repo_));
-
-
-  if (!env()->flags()->isSet("disable_external_sources")) {
-    query_service.registerBackend(
-        std::unique_ptr<fnordmetric::query::Backend>(
-            new fnordmetric::query::mysql_backend::MySQLBackend));
-
-    query_service.registerBackend(
-        std::unique_ptr<fnordmetric::query::Backend>(
-            new fnordmetric::query::postgres_backend::PostgresBackend));
-
-    query_service.registerBackend(
-        std::unique_ptr<fnordmetric::query::Backend>(
-            new fnordmetric::query::csv_backend::CSVBackend));
-  }
-
   query::QueryService::kFormat resp_format = query::QueryService::FORMAT_JSON;
   std::string format_param;
   if (util::URI::getParam(params, "format", &format_param)) {
@@ -268,6 +358,20 @@ void HTTPAPI::executeQuery(
     }
   }
 
+  int64_t width = -1;
+  int64_t height = -1;
+  int64_t timeout_millis = 0;
+  if (!getIntegerParam(params, "width", &width) ||
+      !getIntegerParam(params, "height", &height) ||
+      !getIntegerParam(params, "timeout", &timeout_millis) ||
+      width < -1 || width > std::numeric_limits<int>::max() ||
+      height < -1 || height > std::numeric_limits<int>::max()) {
+    response->addBody(
+        "error: invalid ?width=..., ?height=... or ?timeout=... parameter");
+    response->setStatus(http::kStatusBadRequest);
+    return;
+  }
+
   response->setStatus(http::kStatusOK);
 
   switch (resp_format) {
@@ -281,41 +385,66 @@ void HTTPAPI::executeQuery(
       break;
   }
 
-  int width = -1;
-  std::string width_param;
-  if (util::URI::getParam(params, "width", &width_param)) {
-    width = std::stoi(width_param);
-  }
+  auto context = makeQueryContext(request, timeout_millis);
+
+  /* JSON results are written to the connection while the query is executing,
+     all other formats need the full result and are buffered */
+  if (resp_format == query::QueryService::FORMAT_JSON) {
+    response->setBodyWriter([this, input_stream, width, height, context] (
+        std::shared_ptr<util::OutputStream> body) {
+      std::unique_ptr<query::TableRepository> table_repo(
+          new MetricTableRepository(metric_repo_));
+
+      try {
+        query_service_.executeQuery(
+            input_stream,
+            query::QueryService::FORMAT_JSON,
+            body,
+            std::move(table_repo),
+            width,
+            height,
+            context.get());
+      } catch (util::RuntimeException e) {
+        /* only raised before the body was written, later errors are in the
+           status field of the streamed response */
+        renderQueryError(e, body);
+      }
+    });
 
-  int height = -1;
-  std::string height_param;
-  if (util::URI::getParam(params, "height", &height_param)) {
-    height = std::stoi(height_param);
+    return;
   }
 
+  std::unique_ptr<query::TableRepository> table_repo(
+      new MetricTableRepository(metric_repo_));
+
   try {
-    query_service.executeQuery(
+    query_service_.executeQuery(
         input_stream,
         resp_format,
-        output_stream,
+        response->getBodyOutputStream(),
         std::move(table_repo),
         width,
-        height);
-
+        height,
+        context.get());
   } catch (util::RuntimeException e) {
     response->clearBody();
-
-    util::JSONOutputStream json(std::move(output_stream));
-    json.beginObject();
-    json.addObjectEntry("status");
-    json.addString("error");
-    json.addComma();
-    json.addObjectEntry("error");
-    json.addString(e.getMessage());
-    json.endObject();
+    renderQueryError(e, response->getBodyOutputStream());
   }
 }
 
+void HTTPAPI::renderQueryError(
+    const util::RuntimeException& error,
+    std::shared_ptr<util::OutputStream> output_stream) const {
+  util::JSONOutputStream json(std::move(output_stream));
+  json.beginObject();
+  json.addObjectEntry("status");
+  json.addString("error");
+  json.addComma();
+  json.addObjectEntry("error");
+  json.addString(error.getMessage());
+  json.endObject();
+}
+
 void HTTPAPI::renderMetricJSON(
     IMetric* metric,
     util::JSONOutputStream* json) const {
@@ -13,6 +13,9 @@
 #include <fnordmetric/http/httphandler.h>
 #include <fnordmetric/http/httprequest.h>
 #include <fnordmetric/http/httpresponse.h>
+#include <fnordmetric/query/queryservice.h>
+#include <fnordmetric/sql/runtime/windowcache.h>
+#include <fnordmetric/thread/taskscheduler.h>
 #include <fnordmetric/util/jsonoutputstream.h>
 #include <fnordmetric/util/uri.h>
 
@@ -27,6 +30,22 @@ public:
 
   HTTPAPI(IMetricRepository* metric_repo);
 
+  /**
+   * @param query_scheduler scheduler for parallel query execution (may be
+   * nullptr to execute all queries on the request thread)
+   */
+  HTTPAPI(
+      IMetricRepository* metric_repo,
+      thread::TaskScheduler* query_scheduler);
+
+  /**
+   * Abort queries that run for longer than timeout_micros or that buffer more
+   * than memory_limit bytes of rows. Zero means no limit. Queries are also
+   * aborted once the client disconnected. A client may lower (but not raise)
+   * the timeout with the "timeout" parameter (in milliseconds)
+   */
+  void setQueryLimits(uint64_t timeout_micros, size_t memory_limit);
+
   bool handleHTTPRequest(
       http::HTTPRequest* request,
       http::HTTPResponse* response) override;
@@ -53,11 +72,27 @@ protected:
       http::HTTPResponse* response,
       util::URI* uri);
 
+  void renderQueryError(
+      const util::RuntimeException& error,
+      std::shared_ptr<util::OutputStream> output_stream) const;
+
   void renderMetricJSON(
       IMetric* metric,
       util::JSONOutputStream* json) const;
 
+  /**
+   * The timeout of the query is the server's query timeout or timeout_millis
+   * if that is shorter. timeout_millis is ignored if it is not positive
+   */
+  std::shared_ptr<query::QueryContext> makeQueryContext(
+      http::HTTPRequest* request,
+      int64_t timeout_millis) const;
+
   IMetricRepository* metric_repo_;
+  uint64_t query_timeout_;
+  size_t query_memory_limit_;
+  query::WindowCache window_cache_;
+  query::QueryService query_service_;
 };
 
 }
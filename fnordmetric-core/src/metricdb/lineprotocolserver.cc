@@ -0,0 +1,135 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <fnordmetric/environment.h>
+#include <fnordmetric/metricdb/lineprotocolserver.h>
+#include <fnordmetric/metricdb/statsd.h>
+#include <fnordmetric/stats/allocationscope.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+LineProtocolServer::LineProtocolServer(
+    IMetricRepository* metric_repo,
+    fnord::thread::TaskScheduler* scheduler) :
+    TCPIngestServer(metric_repo, scheduler) {}
+
+bool LineProtocolServer::processInput(Connection* conn, bool eof) {
+  auto& buf = conn->buf;
+  BatchType batch;
+  size_t begin = 0;
+  uint64_t num_samples = 0;
+
+  while (begin < buf.size()) {
+    auto end = buf.find('\n', begin);
+    if (end == std::string::npos) {
+      if (!eof) {
+        break;
+      }
+
+      end = buf.size();
+      buf.push_back('\n');
+    }
+
+    auto line_end = end;
+    if (line_end > begin && buf[line_end - 1] == '\r') {
+      --line_end;
+    }
+
+    if (line_end > begin) {
+      buf[line_end] = 0;
+
+      try {
+        parseLine(&buf[begin], &buf[line_end], &batch);
+        num_samples++;
+      } catch (std::exception& e) {
+        samples_dropped_->incr();
+      }
+    }
+
+    begin = end + 1;
+  }
+
+  buf.erase(0, begin);
+
+  /* the samples of the other metrics are still inserted if one fails */
+  bool failed = false;
+  for (const auto& metric_batch : batch) {
+    try {
+      auto metric = metric_repo_->findOrCreateMetric(metric_batch.first);
+      metric->insertSamples(metric_batch.second);
+    } catch (util::RuntimeException& e) {
+      env()->logger()->printf(
+          "WARNING",
+          "Line protocol server: insert failed on fd %i: %s",
+          conn->fd,
+          e.getMessage().c_str());
+
+      samples_dropped_->incr(metric_batch.second.size());
+      num_samples -= metric_batch.second.size();
+      failed = true;
+    }
+  }
+
+  samples_received_->incr(num_samples);
+  return !failed;
+}
+
+void LineProtocolServer::parseLine(
+    const char* begin,
+    const char* end,
+    BatchType* batch) {
+  std::string key;
+  std::string value;
+  IMetric::BatchSample sample;
+
+  auto rest = StatsdServer::parseStatsdSample(
+      begin,
+      end,
+      &key,
+      &value,
+      &sample.labels);
+
+  if (rest != end || key.empty() || value.empty()) {
+    RAISE(kParseError, "invalid sample: '%s'", std::string(begin, end).c_str());
+  }
+
+  IMetric::checkLabels(sample.labels);
+
+  const char* value_str = value.c_str();
+  char* value_end;
+  sample.value = strtod(value_str, &value_end);
+  if (value_end == value_str) {
+    RAISE(kParseError, "invalid value: '%s'", value.c_str());
+  }
+
+  sample.time = 0;
+  if (*value_end == ' ') {
+    const char* time_str = value_end + 1;
+    char* time_end;
+    auto time_millis = strtoull(time_str, &time_end, 10);
+    if (time_end == time_str) {
+      RAISE(kParseError, "invalid timestamp: '%s'", value.c_str());
+    }
+
+    sample.time = time_millis * 1000;
+    value_end = time_end;
+  }
+
+  if (*value_end != 0) {
+    RAISE(kParseError, "invalid value: '%s'", value.c_str());
+  }
+
+  (*batch)[key].emplace_back(std::move(sample));
+}
+
+}
+}
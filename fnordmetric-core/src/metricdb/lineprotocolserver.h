@@ -0,0 +1,67 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_LINEPROTOCOLSERVER_H
+#define _FNORDMETRIC_METRICDB_LINEPROTOCOLSERVER_H
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fnordmetric/metricdb/metric.h>
+#include <fnordmetric/metricdb/tcpingestserver.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Accepts samples over long-lived TCP connections, one sample per line in the
+ * statsd format, optionally followed by a space and the sample time in
+ * milliseconds since epoch:
+ *
+ *   http.latency[host=web01][path=/]:23.5
+ *   http.latency[host=web01][path=/]:17.2 1414141414000
+ *
+ * All complete lines of every read are parsed and the samples are inserted
+ * with one batch insert per metric. Invalid lines are skipped and counted in
+ * tcp.samples_dropped. If the insert into a metric fails, its samples are
+ * counted in tcp.samples_dropped as well and the connection is closed once
+ * the samples of the other metrics were inserted. Connections that send a
+ * line longer than kMaxMessageSize are closed.
+ */
+class LineProtocolServer : public TCPIngestServer {
+public:
+
+  typedef std::unordered_map<std::string, std::vector<IMetric::BatchSample>>
+      BatchType;
+
+  /**
+   * Does not transfer ownership
+   */
+  LineProtocolServer(
+      IMetricRepository* metric_repo,
+      fnord::thread::TaskScheduler* scheduler);
+
+  /**
+   * Parse a single line (without the trailing newline) and append the sample
+   * to the batch. The line must be followed by a NUL byte. Throws a parse
+   * error if the line is invalid, in which case the batch is unchanged
+   */
+  static void parseLine(const char* begin, const char* end, BatchType* batch);
+
+protected:
+
+  /**
+   * Parse and insert all complete lines from the connection's buffer (and
+   * the remaining partial line if eof is true)
+   */
+  bool processInput(Connection* conn, bool eof) override;
+};
+
+}
+}
+#endif
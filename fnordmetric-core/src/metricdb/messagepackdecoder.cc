@@ -0,0 +1,189 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/metricdb/messagepackdecoder.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+using fnord::msgpack::MessagePackReader;
+
+namespace fnordmetric {
+namespace metricdb {
+
+MessagePackDecoder::MessagePackDecoder(
+    IMetricRepository* metric_repo) :
+    metric_repo_(metric_repo),
+    num_samples_(0) {}
+
+size_t MessagePackDecoder::decode(const char* data, size_t size, bool eof) {
+  MessagePackReader reader(data, size);
+  BatchType batch;
+  size_t consumed = 0;
+  num_samples_ = 0;
+
+  try {
+    while (!reader.eof()) {
+      try {
+        decodeMessage(&reader, &batch);
+      } catch (util::RuntimeException& e) {
+        if (eof || e.getTypeName() != kBufferOverflowError) {
+          throw;
+        }
+
+        /* incomplete message, retry once more data arrived */
+        break;
+      }
+
+      consumed = reader.position();
+    }
+  } catch (...) {
+    insertBatch(&batch);
+    throw;
+  }
+
+  insertBatch(&batch);
+  return consumed;
+}
+
+void MessagePackDecoder::decodeAll(const char* data, size_t size) {
+  MessagePackReader reader(data, size);
+  BatchType batch;
+  num_samples_ = 0;
+
+  while (!reader.eof()) {
+    decodeMessage(&reader, &batch);
+  }
+
+  insertBatch(&batch);
+}
+
+void MessagePackDecoder::decodeMessage(
+    MessagePackReader* reader,
+    BatchType* batch) {
+  auto len = reader->readArrayHeader();
+  if (len == 0) {
+    RAISE(kParseError, "empty message");
+  }
+
+  switch (reader->readUInt()) {
+
+    case kMessageTypeString: {
+      if (len != 2) {
+        RAISE(kParseError, "string message must have 2 elements");
+      }
+
+      const char* str;
+      size_t str_len;
+      reader->readString(&str, &str_len);
+
+      if (strings_.size() >= kMaxStrings) {
+        RAISE(kRangeError, "too many strings, max is %i", (int) kMaxStrings);
+      }
+
+      strings_.emplace_back(str, str_len);
+      metrics_.emplace_back(nullptr);
+      return;
+    }
+
+    case kMessageTypeSample: {
+      if (len != 4 && len != 5) {
+        RAISE(kParseError, "sample message must have 4 or 5 elements");
+      }
+
+      IMetric::BatchSample sample;
+      auto metric = readMetric(reader);
+      sample.time = reader->readUInt() * 1000;
+      sample.value = reader->readFloat();
+
+      if (len == 5) {
+        for (auto n = reader->readMapHeader(); n > 0; --n) {
+          std::string key;
+          std::string value;
+          readString(reader, &key);
+          readString(reader, &value);
+          sample.labels.emplace_back(std::move(key), std::move(value));
+        }
+
+        IMetric::checkLabels(sample.labels);
+      }
+
+      (*batch)[metric].emplace_back(std::move(sample));
+      return;
+    }
+
+    default:
+      RAISE(kParseError, "invalid message type");
+
+  }
+}
+
+void MessagePackDecoder::readString(
+    MessagePackReader* reader,
+    std::string* target) {
+  if (reader->nextType() == MessagePackReader::T_STRING) {
+    const char* str;
+    size_t str_len;
+    reader->readString(&str, &str_len);
+    target->assign(str, str_len);
+    return;
+  }
+
+  auto id = reader->readUInt();
+  if (id >= strings_.size()) {
+    RAISE(kIndexError, "undefined string id: %i", (int) id);
+  }
+
+  *target = strings_[id];
+}
+
+IMetric* MessagePackDecoder::readMetric(MessagePackReader* reader) {
+  std::string key;
+
+  if (reader->nextType() == MessagePackReader::T_STRING) {
+    readString(reader, &key);
+  } else {
+    auto id = reader->readUInt();
+    if (id >= strings_.size()) {
+      RAISE(kIndexError, "undefined string id: %i", (int) id);
+    }
+
+    if (metrics_[id] != nullptr) {
+      return metrics_[id];
+    }
+
+    key = strings_[id];
+    if (key.empty()) {
+      RAISE(kParseError, "empty metric key");
+    }
+
+    metrics_[id] = metric_repo_->findOrCreateMetric(key);
+    return metrics_[id];
+  }
+
+  if (key.empty()) {
+    RAISE(kParseError, "empty metric key");
+  }
+
+  return metric_repo_->findOrCreateMetric(key);
+}
+
+void MessagePackDecoder::insertBatch(BatchType* batch) {
+  for (const auto& metric_batch : *batch) {
+    metric_batch.first->insertSamples(metric_batch.second);
+    num_samples_ += metric_batch.second.size();
+  }
+
+  batch->clear();
+}
+
+size_t MessagePackDecoder::numSamples() const {
+  return num_samples_;
+}
+
+}
+}
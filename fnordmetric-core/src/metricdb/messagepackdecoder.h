@@ -0,0 +1,96 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_MESSAGEPACKDECODER_H
+#define _FNORDMETRIC_METRICDB_MESSAGEPACKDECODER_H
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fnordmetric/metricdb/metric.h>
+#include <fnordmetric/metricdb/metricrepository.h>
+#include <fnordmetric/msgpack/messagepackreader.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Decodes the binary ingest protocol: a stream of MessagePack arrays, each
+ * of which is one of
+ *
+ *   [0, <string>]
+ *     Define a string. Strings are numbered in the order they are defined,
+ *     starting at zero, and can then be referenced by their number wherever
+ *     a metric key, label key or label value is expected.
+ *
+ *   [1, <metric>, <time>, <value>, {<label>: <value>, ...}]
+ *     A sample. The time is in milliseconds since epoch or 0 for "now", the
+ *     value is a float or an integer. The label map may be omitted.
+ *
+ * A client that sends many samples for the same series only has to send the
+ * metric key and labels once and every following sample is a handful of
+ * bytes. The string table lives as long as the decoder, i.e. for the
+ * lifetime of a TCP connection or a single HTTP request body.
+ */
+class MessagePackDecoder {
+public:
+  static const uint64_t kMessageTypeString = 0;
+  static const uint64_t kMessageTypeSample = 1;
+  static const size_t kMaxStrings = 1 << 16;
+
+  /**
+   * Does not transfer ownership
+   */
+  MessagePackDecoder(IMetricRepository* metric_repo);
+
+  /**
+   * Decode and insert all complete messages from the buffer and return the
+   * number of bytes consumed. A trailing incomplete message is left in the
+   * buffer unless eof is true, in which case it is a parse error.
+   *
+   * Throws on invalid input. Samples decoded before the invalid message are
+   * still inserted.
+   */
+  size_t decode(const char* data, size_t size, bool eof);
+
+  /**
+   * Decode a complete body and insert its samples only if every message in
+   * it is valid. Throws on invalid input without inserting any sample
+   */
+  void decodeAll(const char* data, size_t size);
+
+  /**
+   * Returns the number of samples inserted by the last call to decode or
+   * decodeAll
+   */
+  size_t numSamples() const;
+
+protected:
+  typedef std::unordered_map<IMetric*, std::vector<IMetric::BatchSample>>
+      BatchType;
+
+  void decodeMessage(
+      fnord::msgpack::MessagePackReader* reader,
+      BatchType* batch);
+
+  void readString(
+      fnord::msgpack::MessagePackReader* reader,
+      std::string* target);
+
+  IMetric* readMetric(fnord::msgpack::MessagePackReader* reader);
+  void insertBatch(BatchType* batch);
+
+  IMetricRepository* metric_repo_;
+  std::vector<std::string> strings_;
+  std::vector<IMetric*> metrics_;
+  size_t num_samples_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,54 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/environment.h>
+#include <fnordmetric/metricdb/messagepackserver.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+MessagePackServer::MessagePackServer(
+    IMetricRepository* metric_repo,
+    fnord::thread::TaskScheduler* scheduler) :
+    TCPIngestServer(metric_repo, scheduler) {}
+
+MessagePackServer::MessagePackConnection::MessagePackConnection(
+    IMetricRepository* metric_repo) :
+    decoder(metric_repo) {}
+
+TCPIngestServer::Connection* MessagePackServer::createConnection() {
+  return new MessagePackConnection(metric_repo_);
+}
+
+bool MessagePackServer::processInput(Connection* conn, bool eof) {
+  auto& decoder = static_cast<MessagePackConnection*>(conn)->decoder;
+  auto& buf = conn->buf;
+  bool valid = true;
+
+  try {
+    auto consumed = decoder.decode(buf.data(), buf.size(), eof);
+    buf.erase(0, consumed);
+  } catch (util::RuntimeException& e) {
+    env()->logger()->printf(
+        "WARNING",
+        "MessagePack server: invalid message on fd %i: %s",
+        conn->fd,
+        e.getMessage().c_str());
+
+    samples_dropped_->incr();
+    valid = false;
+  }
+
+  samples_received_->incr(decoder.numSamples());
+  return valid;
+}
+
+}
+}
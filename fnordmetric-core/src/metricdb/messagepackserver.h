@@ -0,0 +1,47 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_MESSAGEPACKSERVER_H
+#define _FNORDMETRIC_METRICDB_MESSAGEPACKSERVER_H
+#include <fnordmetric/metricdb/messagepackdecoder.h>
+#include <fnordmetric/metricdb/tcpingestserver.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Accepts samples in the MessagePack binary protocol (see MessagePackDecoder)
+ * over long-lived TCP connections. Every connection has its own string
+ * table. Connections that send an invalid message are closed.
+ */
+class MessagePackServer : public TCPIngestServer {
+public:
+
+  /**
+   * Does not transfer ownership
+   */
+  MessagePackServer(
+      IMetricRepository* metric_repo,
+      fnord::thread::TaskScheduler* scheduler);
+
+protected:
+
+  class MessagePackConnection : public Connection {
+  public:
+    MessagePackConnection(IMetricRepository* metric_repo);
+    MessagePackDecoder decoder;
+  };
+
+  Connection* createConnection() override;
+  bool processInput(Connection* conn, bool eof) override;
+};
+
+}
+}
+#endif
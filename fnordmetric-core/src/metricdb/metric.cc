@@ -9,16 +9,78 @@
  */
 #include <fnordmetric/metricdb/metric.h>
 #include <fnordmetric/util/runtimeexception.h>
+#include <fnordmetric/util/wallclock.h>
+#include <algorithm>
 
 namespace fnordmetric {
 namespace metricdb {
 
-IMetric::IMetric(const std::string& key) : key_(key) {}
+IMetric::IMetric(
+    const std::string& key) :
+    key_(key),
+    late_samples_seq_(0),
+    late_samples_mutex_("metric.late_samples") {}
 IMetric::~IMetric() {}
 
 void IMetric::insertSample(
     double value,
     const std::vector<std::pair<std::string, std::string>>& labels) {
+  checkLabels(labels);
+  insertSampleImpl(value, labels);
+}
+
+void IMetric::insertSamples(const std::vector<BatchSample>& samples) {
+  auto now = fnord::util::WallClock::unixMicros();
+  auto late_threshold =
+      now > kLateSampleSlackMicros ? now - kLateSampleSlackMicros : 0;
+  uint64_t late_min_time = UINT64_MAX;
+
+  /* samples from clients that send their own timestamps are usually a bit
+     older than now, but can't be in a window that was already cached */
+  for (const auto& sample : samples) {
+    checkLabels(sample.labels);
+
+    if (sample.time > 0 &&
+        sample.time < late_threshold &&
+        sample.time < late_min_time) {
+      late_min_time = sample.time;
+    }
+  }
+
+  insertSamplesImpl(samples);
+
+  if (late_min_time != UINT64_MAX) {
+    std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(
+        late_samples_mutex_);
+
+    late_samples_.emplace_back(++late_samples_seq_, late_min_time);
+
+    /* merge the oldest batch into the next one instead of forgetting it */
+    if (late_samples_.size() > kMaxLateSampleLog) {
+      auto oldest_min_time = late_samples_.front().second;
+      late_samples_.pop_front();
+      auto& next = late_samples_.front();
+      next.second = std::min(next.second, oldest_min_time);
+    }
+  }
+}
+
+void IMetric::insertSamplesImpl(const std::vector<BatchSample>& samples) {
+  for (const auto& sample : samples) {
+    if (sample.time != 0) {
+      RAISE(
+          kNotImplementedError,
+          "metric backend doesn't support sample times");
+    }
+  }
+
+  for (const auto& sample : samples) {
+    insertSampleImpl(sample.value, sample.labels);
+  }
+}
+
+void IMetric::checkLabels(
+    const std::vector<std::pair<std::string, std::string>>& labels) {
   // FIXPAUL slow slow slow!
   for (int i1 = 0; i1 < labels.size(); ++i1) {
     for (int i2 = 0; i2 < labels.size(); ++i2) {
@@ -30,8 +92,68 @@ void IMetric::insertSample(
       }
     }
   }
+}
 
-  insertSampleImpl(value, labels);
+void IMetric::scanSeries(
+    const fnord::util::DateTime& time_begin,
+    const fnord::util::DateTime& time_end,
+    const std::vector<std::pair<std::string, std::string>>& label_filter,
+    std::function<bool (Sample* sample)> callback,
+    ScanStats* stats /* = nullptr */) {
+  scanSamples(
+      time_begin,
+      time_end,
+      [&label_filter, &callback] (Sample* sample) -> bool {
+        if (!matchLabels(sample->labels(), label_filter)) {
+          return true;
+        }
+
+        return callback(sample);
+      },
+      stats);
+}
+
+bool IMetric::matchLabels(
+    const std::vector<std::pair<std::string, std::string>>& labels,
+    const std::vector<std::pair<std::string, std::string>>& label_filter) {
+  for (const auto& filter : label_filter) {
+    if (std::find(labels.begin(), labels.end(), filter) == labels.end()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void IMetric::partitionScan(
+    const fnord::util::DateTime& time_begin,
+    const fnord::util::DateTime& time_end,
+    std::vector<std::function<void (
+        std::function<bool (Sample* sample)>,
+        ScanStats* stats)>>* partitions) {
+  partitions->emplace_back([this, time_begin, time_end] (
+      std::function<bool (Sample* sample)> callback,
+      ScanStats* stats) {
+    scanSamples(time_begin, time_end, callback, stats);
+  });
+}
+
+uint64_t IMetric::lateSamplesMinTime(uint64_t since_seq, uint64_t* cur_seq) {
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(late_samples_mutex_);
+  *cur_seq = late_samples_seq_;
+
+  if (since_seq >= late_samples_seq_) {
+    return UINT64_MAX;
+  }
+
+  uint64_t min_time = UINT64_MAX;
+  for (const auto& batch : late_samples_) {
+    if (batch.first > since_seq && batch.second < min_time) {
+      min_time = batch.second;
+    }
+  }
+
+  return min_time;
 }
 
 const std::string& IMetric::key() const {
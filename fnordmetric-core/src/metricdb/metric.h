@@ -10,7 +10,11 @@
 #ifndef _FNORDMETRIC_METRICDB_METRIC_H_
 #define _FNORDMETRIC_METRICDB_METRIC_H_
 #include <fnordmetric/metricdb/sample.h>
+#include <fnordmetric/sql/runtime/windowcache.h>
+#include <fnordmetric/stats/profiledmutex.h>
 #include <fnordmetric/util/datetime.h>
+#include <stdint.h>
+#include <deque>
 #include <functional>
 #include <string>
 #include <vector>
@@ -24,6 +28,43 @@ namespace metricdb {
  */
 class IMetric {
 public:
+
+  /**
+   * Storage level statistics of a scan (see EXPLAIN ANALYZE). Backends that
+   * don't read from tables leave them at zero
+   */
+  struct ScanStats {
+    ScanStats() : bytes_read(0), tables_opened(0), tables_skipped(0) {}
+    uint64_t bytes_read;
+    uint64_t tables_opened;
+    uint64_t tables_skipped;
+  };
+
+  /**
+   * A sample of a batch insert. The time is in microseconds since epoch, 0
+   * means the insert time. Samples may be inserted in any time order
+   */
+  struct BatchSample {
+    uint64_t time;
+    double value;
+    std::vector<std::pair<std::string, std::string>> labels;
+  };
+
+  /**
+   * The number of late sample batches that are remembered for
+   * lateSamplesMinTime
+   */
+  static const size_t kMaxLateSampleLog = 1024;
+
+  /**
+   * Samples that are at most this much older than their insert time are not
+   * late. Cached query results only include windows that closed more than
+   * the grace period of the window cache ago, so this is the default grace
+   * period; a window cache for metrics must not use a shorter one
+   */
+  static const uint64_t kLateSampleSlackMicros =
+      query::WindowCache::kDefaultGracePeriodMicros;
+
   IMetric(const std::string& key);
   virtual ~IMetric();
 
@@ -31,10 +72,75 @@ public:
       double value,
       const std::vector<std::pair<std::string, std::string>>& labels);
 
+  /**
+   * Insert many samples at once. This is faster than calling insertSample for
+   * every sample since backends acquire their locks only once per batch.
+   * Throws if any sample is invalid, in which case no sample is inserted
+   */
+  void insertSamples(const std::vector<BatchSample>& samples);
+
+  /**
+   * Throws an IllegalArgumentError if the labels contain a duplicate key
+   */
+  static void checkLabels(
+      const std::vector<std::pair<std::string, std::string>>& labels);
+
   virtual void scanSamples(
       const fnord::util::DateTime& time_begin,
       const fnord::util::DateTime& time_end,
-      std::function<bool (Sample* sample)> callback) = 0;
+      std::function<bool (Sample* sample)> callback,
+      ScanStats* stats = nullptr) = 0;
+
+  /**
+   * Like scanSamples, but only returns the samples that have all labels of
+   * the label filter. Backends that store the samples of every label set
+   * ("series") together only read the matching series.
+   *
+   * The default implementation filters the samples of scanSamples
+   */
+  virtual void scanSeries(
+      const fnord::util::DateTime& time_begin,
+      const fnord::util::DateTime& time_end,
+      const std::vector<std::pair<std::string, std::string>>& label_filter,
+      std::function<bool (Sample* sample)> callback,
+      ScanStats* stats = nullptr);
+
+  /**
+   * Returns true if the labels contain all labels of the label filter
+   */
+  static bool matchLabels(
+      const std::vector<std::pair<std::string, std::string>>& labels,
+      const std::vector<std::pair<std::string, std::string>>& label_filter);
+
+  /**
+   * Split a scan of the provided time range into independent partitions that
+   * may be executed concurrently. Each partition calls the provided callback
+   * for every sample in the partition in ascending time order and adds its
+   * scan statistics to the provided ScanStats (which may be null). There is
+   * no ordering guarantee across partitions.
+   *
+   * The default implementation returns a single partition that calls
+   * scanSamples
+   */
+  virtual void partitionScan(
+      const fnord::util::DateTime& time_begin,
+      const fnord::util::DateTime& time_end,
+      std::vector<std::function<void (
+          std::function<bool (Sample* sample)>,
+          ScanStats* stats)>>* partitions);
+
+  /**
+   * Returns the smallest time of all samples that were inserted with a time
+   * more than kLateSampleSlackMicros older than their insert time ("late
+   * samples") after the provided late sample sequence number or UINT64_MAX
+   * if there were none. The current sequence number is stored in cur_seq.
+   *
+   * Every batch with late samples increments the sequence number. Only the
+   * last kMaxLateSampleLog batches are remembered separately, older batches
+   * are merged into the oldest one. For an older since_seq the result may
+   * therefore be earlier than necessary, but never later.
+   */
+  virtual uint64_t lateSamplesMinTime(uint64_t since_seq, uint64_t* cur_seq);
 
   const std::string& key() const;
   virtual size_t totalBytes() const = 0;
@@ -48,7 +154,18 @@ protected:
       double value,
       const std::vector<std::pair<std::string, std::string>>& labels) = 0;
 
+  /**
+   * The default implementation calls insertSampleImpl for every sample and
+   * rejects batches with sample times
+   */
+  virtual void insertSamplesImpl(const std::vector<BatchSample>& samples);
+
   const std::string key_;
+
+  /* late sample sequence number -> min time of the batch's late samples */
+  std::deque<std::pair<uint64_t, uint64_t>> late_samples_;
+  uint64_t late_samples_seq_;
+  mutable fnord::stats::ProfiledMutex late_samples_mutex_;
 };
 
 }
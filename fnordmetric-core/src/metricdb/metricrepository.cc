@@ -14,10 +14,13 @@ using namespace fnord;
 namespace fnordmetric {
 namespace metricdb {
 
+IMetricRepository::IMetricRepository() :
+    metrics_mutex_("metricdb.metrics") {}
+
 IMetric* IMetricRepository::findMetric(const std::string& key) const {
   IMetric* metric = nullptr;
 
-  std::lock_guard<std::mutex> lock_holder(metrics_mutex_);
+  std::lock_guard<stats::ProfiledMutex> lock_holder(metrics_mutex_);
 
   auto iter = metrics_.find(key);
   if (iter != metrics_.end()) {
@@ -29,7 +32,7 @@ IMetric* IMetricRepository::findMetric(const std::string& key) const {
 
 IMetric* IMetricRepository::findOrCreateMetric(const std::string& key) {
   IMetric* metric;
-  std::lock_guard<std::mutex> lock_holder(metrics_mutex_);
+  std::lock_guard<stats::ProfiledMutex> lock_holder(metrics_mutex_);
 
   auto iter = metrics_.find(key);
   if (iter == metrics_.end()) {
@@ -55,7 +58,7 @@ std::vector<IMetric*> IMetricRepository::listMetrics()
   std::vector<IMetric*> metrics;
 
   {
-    std::lock_guard<std::mutex> lock_holder(metrics_mutex_);
+    std::lock_guard<stats::ProfiledMutex> lock_holder(metrics_mutex_);
     for (const auto& iter : metrics_) {
       metrics.emplace_back(iter.second.get());
     }
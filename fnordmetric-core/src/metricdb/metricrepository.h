@@ -15,6 +15,7 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include <fnordmetric/stats/profiledmutex.h>
 
 using namespace fnord;
 namespace fnordmetric {
@@ -22,6 +23,7 @@ namespace metricdb {
 
 class IMetricRepository {
 public:
+  IMetricRepository();
   virtual ~IMetricRepository() {}
   IMetric* findMetric(const std::string& key) const;
   IMetric* findOrCreateMetric(const std::string& key);
@@ -29,7 +31,7 @@ public:
 protected:
   virtual IMetric* createMetric(const std::string& key) = 0;
   std::unordered_map<std::string, std::unique_ptr<IMetric>> metrics_;
-  mutable std::mutex metrics_mutex_;
+  mutable stats::ProfiledMutex metrics_mutex_;
 };
 
 }
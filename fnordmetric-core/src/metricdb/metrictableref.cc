@@ -60,39 +60,116 @@ std::vector<std::string> MetricTableRef::columns() {
   return columns;
 }
 
+int MetricTableRef::getTimeColumnIndex() {
+  return 0;
+}
+
+uint64_t MetricTableRef::getLateRowsMinTime(
+    uint64_t since_seq,
+    uint64_t* cur_seq) {
+  return metric_->lateSamplesMinTime(since_seq, cur_seq);
+}
+
 void MetricTableRef::executeScan(query::TableScan* scan) {
+  auto begin = fnord::util::DateTime(scan->timeRangeBegin());
+  auto limit = fnord::util::DateTime::now();
+
+  IMetric::ScanStats stats;
+  auto label_filter = labelFilter(scan);
+  auto callback = [this, scan] (Sample* sample) -> bool {
+    return emitSample(scan, sample);
+  };
+
+  if (label_filter.empty()) {
+    metric_->scanSamples(begin, limit, callback, &stats);
+  } else {
+    metric_->scanSeries(begin, limit, label_filter, callback, &stats);
+  }
+
+  scan->addScanStats(
+      stats.bytes_read,
+      stats.tables_opened,
+      stats.tables_skipped);
+}
+
+void MetricTableRef::partitionScan(
+    std::vector<std::function<void (query::TableScan* scan)>>* partitions) {
   auto begin = fnord::util::DateTime::epoch();
   auto limit = fnord::util::DateTime::now();
 
-  metric_->scanSamples(
-      begin,
-      limit,
-      [this, scan] (Sample* sample) -> bool {
-        std::vector<query::SValue> row;
-        row.emplace_back(sample->time());
-        row.emplace_back(sample->value());
-
-        // FIXPAUL slow!
-        for (const auto& field : fields_) {
-          bool found = false;
-
-          for (const auto& label : sample->labels()) {
-            if (label.first == field) {
-              found = true;
-              row.emplace_back(label.second);
-              break;
-            }
-          }
-
-          if (!found) {
-            row.emplace_back();
-          }
-        }
-
-        return scan->nextRow(row.data(), row.size());
-      });
+  std::vector<std::function<void (
+      std::function<bool (Sample* sample)>,
+      IMetric::ScanStats* stats)>> metric_partitions;
+  metric_->partitionScan(begin, limit, &metric_partitions);
+
+  /* the partitions are built before the scan is known, so a scan with a
+     label filter reads only the matching series in the first partition */
+  for (size_t i = 0; i < metric_partitions.size(); ++i) {
+    auto metric_partition = metric_partitions[i];
+    auto first = i == 0;
+
+    partitions->emplace_back([this, metric_partition, first, begin, limit] (
+        query::TableScan* scan) {
+      IMetric::ScanStats stats;
+      auto label_filter = labelFilter(scan);
+      auto callback = [this, scan] (Sample* sample) -> bool {
+        return emitSample(scan, sample);
+      };
+
+      if (label_filter.empty()) {
+        metric_partition(callback, &stats);
+      } else if (first) {
+        metric_->scanSeries(begin, limit, label_filter, callback, &stats);
+      }
+
+      scan->addScanStats(
+          stats.bytes_read,
+          stats.tables_opened,
+          stats.tables_skipped);
+    });
+  }
+}
+
+std::vector<std::pair<std::string, std::string>> MetricTableRef::labelFilter(
+    query::TableScan* scan) const {
+  std::vector<std::pair<std::string, std::string>> label_filter;
+
+  for (const auto& constraint : scan->equalityConstraints()) {
+    auto index = constraint.first - 2;
+    if (index >= 0 && index < fields_.size()) {
+      label_filter.emplace_back(fields_[index], constraint.second);
+    }
+  }
+
+  return label_filter;
 }
 
+bool MetricTableRef::emitSample(
+    query::TableScan* scan,
+    Sample* sample) const {
+  std::vector<query::SValue> row;
+  row.emplace_back(sample->time());
+  row.emplace_back(sample->value());
+
+  // FIXPAUL slow!
+  for (const auto& field : fields_) {
+    bool found = false;
+
+    for (const auto& label : sample->labels()) {
+      if (label.first == field) {
+        found = true;
+        row.emplace_back(label.second);
+        break;
+      }
+    }
+
+    if (!found) {
+      row.emplace_back();
+    }
+  }
+
+  return scan->nextRow(row.data(), row.size());
+}
 
 }
 }
@@ -29,9 +29,23 @@ public:
   int getColumnIndex(const std::string& name) override;
   std::string getColumnName(int index) override;
   void executeScan(query::TableScan* scan) override;
+  void partitionScan(
+      std::vector<std::function<void (query::TableScan* scan)>>* partitions)
+      override;
   std::vector<std::string> columns() override;
+  int getTimeColumnIndex() override;
+  uint64_t getLateRowsMinTime(uint64_t since_seq, uint64_t* cur_seq) override;
 
 protected:
+  bool emitSample(query::TableScan* scan, Sample* sample) const;
+
+  /**
+   * Returns the label conditions of the scan (see
+   * TableScan::equalityConstraints)
+   */
+  std::vector<std::pair<std::string, std::string>> labelFilter(
+      query::TableScan* scan) const;
+
   IMetric* metric_;
   std::vector<std::string> fields_;
 };
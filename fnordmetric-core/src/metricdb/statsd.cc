@@ -10,6 +10,7 @@
 #include <fnordmetric/environment.h>
 #include <fnordmetric/util/inspect.h>
 #include <fnordmetric/metricdb/statsd.h>
+#include <fnordmetric/stats/allocationscope.h>
 #include <fnordmetric/util/runtimeexception.h>
 
 namespace fnordmetric {
@@ -18,9 +19,23 @@ namespace metricdb {
 StatsdServer::StatsdServer(
     IMetricRepository* metric_repo,
     fnord::thread::TaskScheduler* server_scheduler,
-    fnord::thread::TaskScheduler* work_scheduler) :
+    fnord::thread::TaskScheduler* work_scheduler,
+    StatsdAggregator* aggregator,
+    size_t queue_size /* = UDPServer::kDefaultQueueSize */,
+    size_t num_queues /* = 1 */,
+    fnord::net::UDPServer::kOverflowPolicy overflow_policy
+        /* = UDPServer::DROP_NEWEST */) :
     metric_repo_(metric_repo),
-    udp_server_(server_scheduler, work_scheduler) {
+    aggregator_(aggregator),
+    udp_server_(
+        server_scheduler,
+        work_scheduler,
+        queue_size,
+        num_queues,
+        overflow_policy),
+    datagrams_received_(env()->stats()->counter("statsd.datagrams_received")),
+    samples_received_(env()->stats()->counter("statsd.samples_received")),
+    samples_dropped_(env()->stats()->counter("statsd.samples_dropped")) {
 
   udp_server_.onMessage([this] (const fnord::util::Buffer& msg) {
     this->messageReceived(msg);
@@ -39,21 +54,41 @@ enum StatsdParseState {
 };
 
 void StatsdServer::messageReceived(const fnord::util::Buffer& msg) {
+  fnord::stats::AllocationScope allocation_scope(
+      fnord::stats::AllocationStats::SUBSYSTEM_INGEST);
+
   std::string key;
   std::string value;
+  std::string sample_value;
   std::vector<std::pair<std::string, std::string>> labels;
+  StatsdAggregator::kSampleType type;
+  double sample_rate;
 
   auto msg_str = msg.toString();
   char const* begin = msg_str.c_str();
   char const* end = begin + msg_str.size();
+  datagrams_received_->incr();
 
   while (begin < end) {
-    begin = parseStatsdSample(begin, end, &key, &value, &labels);
-
+    /* the rest of a datagram is dropped after the first invalid sample */
     double float_value;
     try {
+      begin = parseStatsdSample(begin, end, &key, &value, &labels);
+
+      if (parseStatsdValue(value, &sample_value, &type, &sample_rate)) {
+        if (aggregator_ != nullptr) {
+          aggregator_->addSample(key, labels, type, sample_value, sample_rate);
+          samples_received_->incr();
+          labels.clear();
+          continue;
+        }
+
+        value = sample_value;
+      }
+
       float_value = std::stod(value);
     } catch (std::exception& e) {
+      samples_dropped_->incr();
       return;
     }
 
@@ -68,10 +103,53 @@ void StatsdServer::messageReceived(const fnord::util::Buffer& msg) {
 
     auto metric = metric_repo_->findOrCreateMetric(key);
     metric->insertSample(float_value, labels);
+    samples_received_->incr();
     labels.clear();
   }
 }
 
+bool StatsdServer::parseStatsdValue(
+    const std::string& str,
+    std::string* value,
+    StatsdAggregator::kSampleType* type,
+    double* sample_rate) {
+  auto type_begin = str.find('|');
+  if (type_begin == std::string::npos) {
+    *value = str;
+    return false;
+  }
+
+  auto type_end = str.find('|', type_begin + 1);
+  auto type_str = str.substr(
+      type_begin + 1,
+      type_end == std::string::npos ? type_end : type_end - type_begin - 1);
+
+  if (type_str == "c") {
+    *type = StatsdAggregator::T_COUNTER;
+  } else if (type_str == "g") {
+    *type = StatsdAggregator::T_GAUGE;
+  } else if (type_str == "ms" || type_str == "h") {
+    *type = StatsdAggregator::T_TIMER;
+  } else if (type_str == "s") {
+    *type = StatsdAggregator::T_SET;
+  } else {
+    RAISE(kParseError, "invalid statsd type: '%s'", type_str.c_str());
+  }
+
+  *value = str.substr(0, type_begin);
+  *sample_rate = 1.0;
+
+  if (type_end != std::string::npos) {
+    if (str.size() < type_end + 3 || str[type_end + 1] != '@') {
+      RAISE(kParseError, "invalid statsd sample rate: '%s'", str.c_str());
+    }
+
+    *sample_rate = std::stod(str.substr(type_end + 2));
+  }
+
+  return true;
+}
+
 char const* StatsdServer::parseStatsdSample(
     char const* begin,
     char const* end,
@@ -8,7 +8,9 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <fnordmetric/metricdb/metricrepository.h>
+#include <fnordmetric/metricdb/statsdaggregator.h>
 #include <fnordmetric/net/udpserver.h>
+#include <fnordmetric/stats/counter.h>
 #include <fnordmetric/thread/taskscheduler.h>
 
 namespace fnordmetric {
@@ -17,10 +19,21 @@ namespace metricdb {
 class StatsdServer {
 public:
 
+  /**
+   * Typed samples (e.g. "key:1|c") are added to the aggregator. If the
+   * aggregator is null, they are inserted directly like untyped samples.
+   * Datagrams are processed by up to num_queues tasks on the work scheduler
+   * in parallel, see fnord::net::UDPServer. Does not transfer ownership
+   */
   StatsdServer(
       IMetricRepository* metric_repo,
       fnord::thread::TaskScheduler* server_scheduler,
-      fnord::thread::TaskScheduler* work_scheduler);
+      fnord::thread::TaskScheduler* work_scheduler,
+      StatsdAggregator* aggregator,
+      size_t queue_size = fnord::net::UDPServer::kDefaultQueueSize,
+      size_t num_queues = 1,
+      fnord::net::UDPServer::kOverflowPolicy overflow_policy =
+          fnord::net::UDPServer::DROP_NEWEST);
 
   void listen(int port);
 
@@ -31,12 +44,26 @@ public:
       std::string* value,
       std::vector<std::pair<std::string, std::string>>* labels);
 
+  /**
+   * Splits a statsd value like "12.5|ms|@0.1" into the value, the type and
+   * the sample rate (1 if not set). Returns false if the value has no type
+   */
+  static bool parseStatsdValue(
+      const std::string& str,
+      std::string* value,
+      StatsdAggregator::kSampleType* type,
+      double* sample_rate);
+
 protected:
 
   void messageReceived(const fnord::util::Buffer& msg);
 
   IMetricRepository* metric_repo_;
+  StatsdAggregator* aggregator_;
   fnord::net::UDPServer udp_server_;
+  fnord::stats::Counter* datagrams_received_;
+  fnord::stats::Counter* samples_received_;
+  fnord::stats::Counter* samples_dropped_;
 };
 
 
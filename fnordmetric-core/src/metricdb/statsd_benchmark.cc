@@ -0,0 +1,126 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fnordmetric/metricdb/backends/inmemory/metricrepository.h>
+#include <fnordmetric/metricdb/statsd.h>
+#include <fnordmetric/metricdb/statsdaggregator.h>
+#include <fnordmetric/util/benchmark.h>
+
+using namespace fnordmetric::metricdb;
+
+/**
+ * Statsd line parsing: a sample without labels, a sample with three labels
+ * and a full datagram of 50 samples separated by newlines. Also adding typed
+ * samples to the StatsdAggregator
+ */
+BENCHMARK_SUITE(StatsdBenchmark);
+
+static const uint64_t kNumSamples = 1000;
+static std::vector<std::string> simple_samples;
+static std::vector<std::string> labeled_samples;
+static std::string datagram;
+
+BENCHMARK_INITIALIZER(StatsdBenchmark, GenerateSamples, [] () {
+  char buf[256];
+
+  for (int i = 0; i < kNumSamples; ++i) {
+    snprintf(buf, sizeof(buf), "web.requests.%i:%i.%i", i % 50, i, i % 7);
+    simple_samples.emplace_back(buf);
+
+    snprintf(
+        buf,
+        sizeof(buf),
+        "web.latency[host=web%03i][dc=dc%i][path=/api/v%i/items]:%i.%i",
+        i % 100,
+        i % 4,
+        i % 3,
+        i * 17,
+        i % 10);
+    labeled_samples.emplace_back(buf);
+  }
+
+  for (int i = 0; i < 50; ++i) {
+    if (i > 0) {
+      datagram += "\n";
+    }
+
+    datagram += labeled_samples[i];
+  }
+});
+
+static void parseSamples(const std::vector<std::string>& samples) {
+  std::string key;
+  std::string value;
+  std::vector<std::pair<std::string, std::string>> labels;
+
+  for (const auto& sample : samples) {
+    labels.clear();
+    StatsdServer::parseStatsdSample(
+        sample.data(),
+        sample.data() + sample.size(),
+        &key,
+        &value,
+        &labels);
+  }
+}
+
+BENCHMARK_CASE(StatsdBenchmark, ParseSimpleSample, kNumSamples, [] () {
+  parseSamples(simple_samples);
+});
+
+BENCHMARK_CASE(StatsdBenchmark, ParseLabeledSample, kNumSamples, [] () {
+  parseSamples(labeled_samples);
+});
+
+BENCHMARK_CASE(StatsdBenchmark, ParseDatagram, 50, [] () {
+  std::string key;
+  std::string value;
+  std::vector<std::pair<std::string, std::string>> labels;
+
+  auto begin = datagram.data();
+  auto end = begin + datagram.size();
+  while (begin < end) {
+    labels.clear();
+    begin = StatsdServer::parseStatsdSample(begin, end, &key, &value, &labels);
+  }
+});
+
+static inmemory_backend::MetricRepository aggregator_repo;
+static StatsdAggregator aggregator(&aggregator_repo, nullptr, 0);
+
+BENCHMARK_CASE(StatsdBenchmark, AggregateCounter, kNumSamples, [] () {
+  std::vector<std::pair<std::string, std::string>> labels;
+  labels.emplace_back("host", "web001");
+
+  for (int i = 0; i < kNumSamples; ++i) {
+    aggregator.addSample(
+        "web.requests",
+        labels,
+        StatsdAggregator::T_COUNTER,
+        "1",
+        1);
+  }
+});
+
+BENCHMARK_CASE(StatsdBenchmark, AggregateTimer, kNumSamples, [] () {
+  std::vector<std::pair<std::string, std::string>> labels;
+  labels.emplace_back("host", "web001");
+
+  for (int i = 0; i < kNumSamples; ++i) {
+    aggregator.addSample(
+        "web.latency",
+        labels,
+        StatsdAggregator::T_TIMER,
+        "23.5",
+        1);
+  }
+});
@@ -7,7 +7,24 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <math.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <map>
+#include <fnordmetric/environment.h>
+#include <fnordmetric/metricdb/backends/inmemory/metricrepository.h>
+#include <fnordmetric/metricdb/lineprotocolserver.h>
+#include <fnordmetric/metricdb/messagepackdecoder.h>
 #include <fnordmetric/metricdb/statsd.h>
+#include <fnordmetric/metricdb/statsdaggregator.h>
+#include <fnordmetric/msgpack/messagepackwriter.h>
+#include <fnordmetric/net/udpserver.h>
+#include <fnordmetric/thread/threadpool.h>
 #include <fnordmetric/util/unittest.h>
 
 using namespace fnordmetric::metricdb;
@@ -16,6 +33,10 @@ UNIT_TEST(StatsdTest);
 
 using LabelList = std::vector<std::pair<std::string, std::string>>;
 
+static const int kTestUDPPort = 18929;
+static const int kTestTCPPort = 18930;
+static const int kTestUDPErrorPort = 18931;
+
 TEST_CASE(StatsdTest, TestSimpleParseFromStatsdFormat, [] () {
   std::string key;
   std::string value;
@@ -172,3 +193,518 @@ TEST_CASE(StatsdTest, TestParseFromStatsdFormatWithMultipleSmplLabels, [] () {
   EXPECT_EQ(labels.size(), 1);
   EXPECT_EQ(value, "4.6");
 });
+
+TEST_CASE(StatsdTest, TestParseStatsdValueWithType, [] () {
+  std::string value;
+  StatsdAggregator::kSampleType type;
+  double sample_rate;
+
+  EXPECT(!StatsdServer::parseStatsdValue("34.23", &value, &type, &sample_rate));
+  EXPECT_EQ(value, "34.23");
+
+  EXPECT(StatsdServer::parseStatsdValue("1|c", &value, &type, &sample_rate));
+  EXPECT_EQ(value, "1");
+  EXPECT(type == StatsdAggregator::T_COUNTER);
+  EXPECT(sample_rate == 1.0);
+
+  EXPECT(StatsdServer::parseStatsdValue(
+      "12.5|ms|@0.25",
+      &value,
+      &type,
+      &sample_rate));
+  EXPECT_EQ(value, "12.5");
+  EXPECT(type == StatsdAggregator::T_TIMER);
+  EXPECT(sample_rate == 0.25);
+
+  EXPECT(StatsdServer::parseStatsdValue("-3|g", &value, &type, &sample_rate));
+  EXPECT_EQ(value, "-3");
+  EXPECT(type == StatsdAggregator::T_GAUGE);
+
+  EXPECT(StatsdServer::parseStatsdValue("u42|s", &value, &type, &sample_rate));
+  EXPECT_EQ(value, "u42");
+  EXPECT(type == StatsdAggregator::T_SET);
+
+  EXPECT_EXCEPTION("invalid statsd type: 'x'", [] () {
+    std::string value;
+    StatsdAggregator::kSampleType type;
+    double sample_rate;
+    StatsdServer::parseStatsdValue("1|x", &value, &type, &sample_rate);
+  });
+});
+
+static std::map<std::string, double> scanStats(IMetric* metric) {
+  std::map<std::string, double> values;
+
+  metric->scanSamples(
+      fnord::util::DateTime::epoch(),
+      fnord::util::DateTime(UINT64_MAX),
+      [&values] (Sample* sample) -> bool {
+        std::string stat;
+        for (const auto& label : sample->labels()) {
+          if (label.first == "stat") {
+            stat = label.second;
+          }
+        }
+
+        values[stat] = sample->value();
+        return true;
+      });
+
+  return values;
+}
+
+TEST_CASE(StatsdTest, TestAggregateCountersGaugesAndSets, [] () {
+  inmemory_backend::MetricRepository metric_repo;
+  StatsdAggregator aggregator(&metric_repo, nullptr, 0);
+  LabelList labels;
+  labels.emplace_back("host", "web01");
+
+  aggregator.addSample("reqs", labels, StatsdAggregator::T_COUNTER, "2", 1);
+  aggregator.addSample("reqs", labels, StatsdAggregator::T_COUNTER, "1", 0.1);
+  aggregator.addSample("temp", labels, StatsdAggregator::T_GAUGE, "20", 1);
+  aggregator.addSample("temp", labels, StatsdAggregator::T_GAUGE, "+3", 1);
+  for (int i = 0; i < 100; ++i) {
+    aggregator.addSample(
+        "users",
+        labels,
+        StatsdAggregator::T_SET,
+        "user" + std::to_string(i % 10),
+        1);
+  }
+
+  EXPECT(metric_repo.findMetric("reqs") == nullptr);
+  aggregator.flush();
+
+  EXPECT(scanStats(metric_repo.findMetric("reqs"))[""] == 12);
+  EXPECT(scanStats(metric_repo.findMetric("temp"))[""] == 23);
+  EXPECT(scanStats(metric_repo.findMetric("users"))[""] == 10);
+
+  /* gauge deltas apply to the last value of the previous interval */
+  aggregator.addSample("temp", labels, StatsdAggregator::T_GAUGE, "-5", 1);
+  aggregator.flush();
+  aggregator.flush();
+
+  std::vector<double> temps;
+  metric_repo.findMetric("temp")->scanSamples(
+      fnord::util::DateTime::epoch(),
+      fnord::util::DateTime(UINT64_MAX),
+      [&temps] (Sample* sample) -> bool {
+        temps.emplace_back(sample->value());
+        return true;
+      });
+
+  EXPECT_EQ(temps.size(), 2);
+  EXPECT(temps[1] == 18);
+});
+
+TEST_CASE(StatsdTest, TestAggregateTimers, [] () {
+  inmemory_backend::MetricRepository metric_repo;
+  StatsdAggregator aggregator(&metric_repo, nullptr, 0);
+
+  for (int i = 1; i <= 100; ++i) {
+    aggregator.addSample(
+        "latency",
+        LabelList{},
+        StatsdAggregator::T_TIMER,
+        std::to_string(i),
+        0.5);
+  }
+
+  aggregator.flush();
+
+  auto stats = scanStats(metric_repo.findMetric("latency"));
+  EXPECT_EQ(stats.size(), 7);
+  EXPECT(stats["count"] == 200);
+  EXPECT(stats["mean"] == 50.5);
+  EXPECT(stats["min"] == 1);
+  EXPECT(stats["max"] == 100);
+  EXPECT(fabs(stats["p90"] - 90) < 90 * 0.02);
+  EXPECT(fabs(stats["p99"] - 99) < 99 * 0.02);
+});
+
+class BrokenMetricRepository : public inmemory_backend::MetricRepository {
+protected:
+  inmemory_backend::Metric* createMetric(const std::string& key) override {
+    if (key == "broken") {
+      RAISE(kIOError, "can't create metric");
+    }
+
+    return inmemory_backend::MetricRepository::createMetric(key);
+  }
+};
+
+TEST_CASE(StatsdTest, TestAggregatorFlushesRemainingSeriesOnError, [] () {
+  BrokenMetricRepository metric_repo;
+  StatsdAggregator aggregator(&metric_repo, nullptr, 0);
+  auto flush_errors =
+      fnordmetric::env()->stats()->counter("statsd.flush_errors");
+  auto num_errors = flush_errors->get();
+
+  for (const auto& key : { "a", "broken", "b", "c" }) {
+    aggregator.addSample(key, LabelList{}, StatsdAggregator::T_COUNTER, "1", 1);
+  }
+
+  aggregator.flush();
+
+  EXPECT_EQ(flush_errors->get(), num_errors + 1);
+  EXPECT(metric_repo.findMetric("broken") == nullptr);
+  for (const auto& key : { "a", "b", "c" }) {
+    EXPECT(scanStats(metric_repo.findMetric(key))[""] == 1);
+  }
+});
+
+TEST_CASE(StatsdTest, TestAggregatorExpiresIdleGauges, [] () {
+  inmemory_backend::MetricRepository metric_repo;
+  StatsdAggregator aggregator(&metric_repo, nullptr, 0);
+
+  aggregator.addSample("temp", LabelList{}, StatsdAggregator::T_GAUGE, "20", 1);
+  for (uint32_t i = 0; i <= StatsdAggregator::kGaugeExpiryIntervals; ++i) {
+    aggregator.flush();
+  }
+
+  /* the delta applies to a new gauge since the old one expired */
+  aggregator.addSample("temp", LabelList{}, StatsdAggregator::T_GAUGE, "+3", 1);
+  aggregator.flush();
+
+  std::vector<double> temps;
+  metric_repo.findMetric("temp")->scanSamples(
+      fnord::util::DateTime::epoch(),
+      fnord::util::DateTime(UINT64_MAX),
+      [&temps] (Sample* sample) -> bool {
+        temps.emplace_back(sample->value());
+        return true;
+      });
+
+  EXPECT_EQ(temps.size(), 2);
+  EXPECT(temps[1] == 3);
+});
+
+TEST_CASE(StatsdTest, TestParseLineProtocol, [] () {
+  LineProtocolServer::BatchType batch;
+
+  std::string line1 = "http.latency[host=web01][path=/]:23.5";
+  LineProtocolServer::parseLine(
+      line1.c_str(),
+      line1.c_str() + line1.size(),
+      &batch);
+
+  std::string line2 = "http.latency[host=web02]:17.25 1414141414123";
+  LineProtocolServer::parseLine(
+      line2.c_str(),
+      line2.c_str() + line2.size(),
+      &batch);
+
+  EXPECT_EQ(batch.size(), 1);
+  const auto& samples = batch["http.latency"];
+  EXPECT_EQ(samples.size(), 2);
+  EXPECT(samples[0].value == 23.5);
+  EXPECT_EQ(samples[0].time, 0);
+  EXPECT_EQ(samples[0].labels.size(), 2);
+  EXPECT_EQ(samples[0].labels[1].second, "/");
+  EXPECT(samples[1].value == 17.25);
+  EXPECT_EQ(samples[1].time, 1414141414123000);
+  EXPECT_EQ(samples[1].labels[0].second, "web02");
+
+  for (const auto& invalid : {
+      "http.latency",
+      "http.latency:",
+      "http.latency:abc",
+      "http.latency:1|c",
+      "http.latency:1 2x",
+      "http.latency[host=a][host=b]:1" }) {
+    std::string line(invalid);
+    bool raised = false;
+
+    try {
+      LineProtocolServer::parseLine(
+          line.c_str(),
+          line.c_str() + line.size(),
+          &batch);
+    } catch (fnordmetric::util::RuntimeException& e) {
+      raised = true;
+    }
+
+    EXPECT(raised);
+  }
+
+  EXPECT_EQ(batch["http.latency"].size(), 2);
+});
+
+TEST_CASE(StatsdTest, TestLineProtocolServerClosesOnInsertError, [] () {
+  auto dropped = fnordmetric::env()->stats()->counter("tcp.samples_dropped");
+  auto dropped_before = dropped->get();
+  auto received = fnordmetric::env()->stats()->counter("tcp.samples_received");
+  auto received_before = received->get();
+  BrokenMetricRepository metric_repo;
+
+  /* the pool must be shut down before the server is freed */
+  std::unique_ptr<LineProtocolServer> server;
+
+  {
+    fnord::thread::ThreadPool pool(
+        std::unique_ptr<fnord::util::ExceptionHandler>(
+            new fnord::util::CatchAndAbortExceptionHandler("crashed")),
+        2);
+
+    server.reset(new LineProtocolServer(&metric_repo, &pool));
+    server->listen(kTestTCPPort);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(kTestTCPPort);
+    EXPECT_EQ(connect(fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+
+    struct timeval timeout;
+    timeout.tv_sec = 5;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    /* the insert fails, so the server must close the connection */
+    std::string lines = "broken:1\nworking:3\nbroken:2\n";
+    EXPECT_EQ(write(fd, lines.data(), lines.size()), lines.size());
+
+    char c;
+    EXPECT_EQ(read(fd, &c, 1), 0);
+    close(fd);
+  }
+
+  /* only the samples of the failed metric are dropped */
+  EXPECT_EQ(dropped->get() - dropped_before, 2);
+  EXPECT_EQ(received->get() - received_before, 1);
+  EXPECT(scanStats(metric_repo.findMetric("working"))[""] == 3);
+});
+
+TEST_CASE(StatsdTest, TestDecodeMessagePack, [] () {
+  inmemory_backend::MetricRepository metric_repo;
+  MessagePackDecoder decoder(&metric_repo);
+
+  std::string buf;
+  fnord::msgpack::MessagePackWriter writer(&buf);
+  writer.writeArrayHeader(2);
+  writer.writeUInt(MessagePackDecoder::kMessageTypeString);
+  writer.writeString("http.latency");
+  writer.writeArrayHeader(2);
+  writer.writeUInt(MessagePackDecoder::kMessageTypeString);
+  writer.writeString("host");
+
+  for (int i = 0; i < 10; ++i) {
+    writer.writeArrayHeader(5);
+    writer.writeUInt(MessagePackDecoder::kMessageTypeSample);
+    writer.writeUInt(0);
+    writer.writeUInt(0);
+    writer.writeUInt(i);
+    writer.writeMapHeader(1);
+    writer.writeUInt(1);
+    writer.writeString("web01");
+  }
+
+  writer.writeArrayHeader(4);
+  writer.writeUInt(MessagePackDecoder::kMessageTypeSample);
+  writer.writeString("http.errors");
+  writer.writeUInt(0);
+  writer.writeFloat(0.5);
+
+  /* a partial message is left in the buffer until more data arrives */
+  auto consumed = decoder.decode(buf.data(), buf.size() - 2, false);
+  EXPECT(consumed < buf.size() - 2);
+  EXPECT_EQ(decoder.numSamples(), 10);
+  consumed += decoder.decode(
+      buf.data() + consumed,
+      buf.size() - consumed,
+      false);
+  EXPECT_EQ(consumed, buf.size());
+  EXPECT_EQ(decoder.numSamples(), 1);
+
+  double sum = 0;
+  size_t count = 0;
+  metric_repo.findMetric("http.latency")->scanSamples(
+      fnord::util::DateTime::epoch(),
+      fnord::util::DateTime(UINT64_MAX),
+      [&] (Sample* sample) -> bool {
+        EXPECT_EQ(sample->labels()[0].second, "web01");
+        sum += sample->value();
+        count++;
+        return true;
+      });
+
+  EXPECT_EQ(count, 10);
+  EXPECT(sum == 45);
+  EXPECT(scanStats(metric_repo.findMetric("http.errors"))[""] == 0.5);
+
+  std::string invalid;
+  fnord::msgpack::MessagePackWriter invalid_writer(&invalid);
+  invalid_writer.writeArrayHeader(4);
+  invalid_writer.writeUInt(MessagePackDecoder::kMessageTypeSample);
+  invalid_writer.writeUInt(23);
+  invalid_writer.writeUInt(0);
+  invalid_writer.writeUInt(1);
+
+  EXPECT_EXCEPTION("undefined string id: 23", [&] () {
+    decoder.decode(invalid.data(), invalid.size(), true);
+  });
+
+  EXPECT_EXCEPTION("requested read exceeds message bounds", [&] () {
+    decoder.decode(buf.data(), buf.size() - 2, true);
+  });
+});
+
+TEST_CASE(StatsdTest, TestDecodeMessagePackBodyAllOrNothing, [] () {
+  inmemory_backend::MetricRepository metric_repo;
+  MessagePackDecoder decoder(&metric_repo);
+
+  std::string buf;
+  fnord::msgpack::MessagePackWriter writer(&buf);
+  for (int i = 0; i < 3; ++i) {
+    writer.writeArrayHeader(4);
+    writer.writeUInt(MessagePackDecoder::kMessageTypeSample);
+    writer.writeString("http.errors");
+    writer.writeUInt(0);
+    writer.writeUInt(1);
+  }
+
+  auto valid_size = buf.size();
+  writer.writeArrayHeader(4);
+  writer.writeUInt(MessagePackDecoder::kMessageTypeSample);
+  writer.writeUInt(23);
+  writer.writeUInt(0);
+  writer.writeUInt(1);
+
+  EXPECT_EXCEPTION("undefined string id: 23", [&] () {
+    decoder.decodeAll(buf.data(), buf.size());
+  });
+
+  EXPECT_EQ(decoder.numSamples(), 0);
+  EXPECT_EQ(scanStats(metric_repo.findMetric("http.errors")).size(), 0);
+
+  /* an incomplete trailing message is invalid, too */
+  EXPECT_EXCEPTION("requested read exceeds message bounds", [&] () {
+    decoder.decodeAll(buf.data(), valid_size - 1);
+  });
+
+  decoder.decodeAll(buf.data(), valid_size);
+  EXPECT_EQ(decoder.numSamples(), 3);
+});
+
+TEST_CASE(StatsdTest, TestUDPServerDropsWhenQueueFull, [] () {
+  auto dropped = fnordmetric::env()->stats()->counter("udp.datagrams_dropped");
+  auto dropped_before = dropped->get();
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool blocked = true;
+  std::atomic<int> num_handling(0);
+  std::atomic<int> num_received(0);
+
+  /* the pool must be shut down before the server is freed */
+  std::unique_ptr<fnord::net::UDPServer> udp_server;
+
+  {
+    fnord::thread::ThreadPool pool(
+        std::unique_ptr<fnord::util::ExceptionHandler>(
+            new fnord::util::CatchAndAbortExceptionHandler("crashed")),
+        2);
+
+    udp_server.reset(new fnord::net::UDPServer(&pool, &pool, 4, 1));
+    udp_server->onMessage([&] (const fnord::util::Buffer& msg) {
+      num_handling++;
+      std::unique_lock<std::mutex> lk(mutex);
+      cv.wait(lk, [&] { return !blocked; });
+      num_received++;
+    });
+    udp_server->listen(kTestUDPPort);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(kTestUDPPort);
+
+    /* the first datagram blocks the only drain task in the callback */
+    sendto(fd, "x:1", 3, 0, (struct sockaddr *) &addr, sizeof(addr));
+    while (num_handling < 1) {
+      usleep(1000);
+    }
+
+    for (int i = 1; i < 50; ++i) {
+      sendto(fd, "x:1", 3, 0, (struct sockaddr *) &addr, sizeof(addr));
+    }
+
+    close(fd);
+
+    /* four datagrams are queued, the rest is dropped */
+    while (dropped->get() - dropped_before < 45) {
+      usleep(1000);
+    }
+
+    {
+      std::lock_guard<std::mutex> lk(mutex);
+      blocked = false;
+    }
+
+    cv.notify_all();
+
+    while (num_received < 5) {
+      usleep(1000);
+    }
+  }
+
+  EXPECT_EQ(dropped->get() - dropped_before, 45);
+  EXPECT_EQ(num_received.load(), 5);
+});
+
+TEST_CASE(StatsdTest, TestUDPServerKeepsDrainingAfterCallbackError, [] () {
+  auto errors = fnordmetric::env()->stats()->counter("udp.callback_errors");
+  auto errors_before = errors->get();
+  std::atomic<int> num_calls(0);
+  std::atomic<int> num_received(0);
+
+  /* the pool must be shut down before the server is freed */
+  std::unique_ptr<fnord::net::UDPServer> udp_server;
+
+  {
+    fnord::thread::ThreadPool pool(
+        std::unique_ptr<fnord::util::ExceptionHandler>(
+            new fnord::util::CatchAndAbortExceptionHandler("crashed")),
+        2);
+
+    udp_server.reset(new fnord::net::UDPServer(&pool, &pool, 16, 1));
+    udp_server->onMessage([&] (const fnord::util::Buffer& msg) {
+      if (num_calls++ == 0) {
+        RAISE(kIOError, "insert failed");
+      }
+
+      num_received++;
+    });
+    udp_server->listen(kTestUDPErrorPort);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(kTestUDPErrorPort);
+
+    sendto(fd, "x:1", 3, 0, (struct sockaddr *) &addr, sizeof(addr));
+    while (num_calls < 1) {
+      usleep(1000);
+    }
+
+    /* the queue is drained again after the callback failed */
+    for (int i = 0; i < 5; ++i) {
+      sendto(fd, "x:1", 3, 0, (struct sockaddr *) &addr, sizeof(addr));
+    }
+
+    close(fd);
+
+    for (int i = 0; i < 5000 && num_received < 5; ++i) {
+      usleep(1000);
+    }
+  }
+
+  EXPECT_EQ(num_received.load(), 5);
+  EXPECT_EQ(errors->get() - errors_before, 1);
+});
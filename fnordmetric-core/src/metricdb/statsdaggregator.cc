@@ -0,0 +1,242 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/environment.h>
+#include <fnordmetric/metricdb/statsdaggregator.h>
+#include <fnordmetric/thread/task.h>
+#include <fnordmetric/util/fnv.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+StatsdAggregator::Series::Series(
+    const std::string& key_,
+    const LabelListType& labels_,
+    kSampleType type_) :
+    key(key_),
+    labels(labels_),
+    type(type_),
+    updated(false),
+    idle_intervals(0),
+    value(0),
+    count(0) {}
+
+StatsdAggregator::StatsdAggregator(
+    IMetricRepository* metric_repo,
+    fnord::thread::TaskScheduler* scheduler,
+    uint64_t flush_interval_micros) :
+    metric_repo_(metric_repo),
+    scheduler_(scheduler),
+    flush_interval_micros_(flush_interval_micros),
+    samples_aggregated_(env()->stats()->counter("statsd.samples_aggregated")),
+    series_flushed_(env()->stats()->counter("statsd.series_flushed")),
+    flush_errors_(env()->stats()->counter("statsd.flush_errors")),
+    gauges_expired_(env()->stats()->counter("statsd.gauges_expired")) {}
+
+void StatsdAggregator::start() {
+  scheduler_->runAfter(
+      fnord::thread::Task::create([this] () -> void {
+        try {
+          flush();
+        } catch (const util::RuntimeException& e) {
+          env()->logger()->printf(
+              "ERROR",
+              "statsd flush failed: %s",
+              e.getMessage().c_str());
+        } catch (const std::exception& e) {
+          env()->logger()->printf(
+              "ERROR",
+              "statsd flush failed: %s",
+              e.what());
+        }
+
+        start();
+      }),
+      flush_interval_micros_,
+      fnord::thread::TaskScheduler::PRIORITY_LOW);
+}
+
+void StatsdAggregator::addSample(
+    const std::string& key,
+    const LabelListType& labels,
+    kSampleType type,
+    const std::string& value,
+    double sample_rate) {
+  double float_value = 0;
+  if (type != T_SET) {
+    try {
+      float_value = std::stod(value);
+    } catch (std::exception& e) {
+      RAISE(kParseError, "invalid statsd value: '%s'", value.c_str());
+    }
+  }
+
+  if (!(sample_rate > 0 && sample_rate <= 1)) {
+    RAISE(kParseError, "invalid statsd sample rate: %f", sample_rate);
+  }
+
+  std::string series_key = key;
+  series_key += '\0';
+  series_key += static_cast<char>('0' + type);
+  for (const auto& label : labels) {
+    series_key += '\0';
+    series_key += label.first;
+    series_key += '=';
+    series_key += label.second;
+  }
+
+  fnord::util::FNV<uint64_t> fnv;
+  auto& shard = shards_[fnv.hash(series_key) % kNumShards];
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(shard.mutex);
+
+  auto& series = shard.series[series_key];
+  if (series.get() == nullptr) {
+    series.reset(new Series(key, labels, type));
+  }
+
+  switch (type) {
+
+    case T_COUNTER:
+      series->value += float_value / sample_rate;
+      break;
+
+    case T_GAUGE:
+      if (value[0] == '+' || value[0] == '-') {
+        series->value += float_value;
+      } else {
+        series->value = float_value;
+      }
+      break;
+
+    case T_TIMER:
+      if (series->histogram.get() == nullptr) {
+        series->histogram.reset(new fnord::util::LogHistogram());
+      }
+
+      series->histogram->insert(float_value);
+      series->value += float_value;
+      series->count += 1 / sample_rate;
+      break;
+
+    case T_SET:
+      if (series->set.get() == nullptr) {
+        series->set.reset(new fnord::util::HyperLogLog());
+      }
+
+      series->set->insert(fnord::util::HyperLogLog::hash(value));
+      break;
+
+  }
+
+  series->updated = true;
+  samples_aggregated_->incr();
+}
+
+void StatsdAggregator::flush() {
+  std::vector<std::unique_ptr<Series>> flushed;
+
+  /* move the finished series out of the shards so that inserting into the
+     metric repository doesn't block the ingest threads */
+  for (auto& shard : shards_) {
+    std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(shard.mutex);
+
+    for (auto iter = shard.series.begin(); iter != shard.series.end(); ) {
+      auto& series = iter->second;
+
+      if (series->type == T_GAUGE) {
+        if (series->updated) {
+          flushed.emplace_back(
+              new Series(series->key, series->labels, series->type));
+          flushed.back()->value = series->value;
+          series->updated = false;
+          series->idle_intervals = 0;
+        } else if (++series->idle_intervals >= kGaugeExpiryIntervals) {
+          iter = shard.series.erase(iter);
+          gauges_expired_->incr();
+          continue;
+        }
+
+        ++iter;
+        continue;
+      }
+
+      flushed.emplace_back(std::move(series));
+      iter = shard.series.erase(iter);
+    }
+  }
+
+  size_t num_errors = 0;
+  for (const auto& series : flushed) {
+    std::string error;
+    try {
+      flushSeries(*series);
+      continue;
+    } catch (const util::RuntimeException& e) {
+      error = e.getMessage();
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+
+    /* log only the first error so that a broken backend doesn't log once
+       per series and interval */
+    if (num_errors++ == 0) {
+      env()->logger()->printf(
+          "ERROR",
+          "statsd flush of '%s' failed: %s",
+          series->key.c_str(),
+          error.c_str());
+    }
+  }
+
+  if (num_errors > 0) {
+    flush_errors_->incr(num_errors);
+  }
+
+  series_flushed_->incr(flushed.size() - num_errors);
+}
+
+void StatsdAggregator::flushSeries(const Series& series) {
+  auto metric = metric_repo_->findOrCreateMetric(series.key);
+
+  switch (series.type) {
+
+    case T_COUNTER:
+    case T_GAUGE:
+      metric->insertSample(series.value, series.labels);
+      return;
+
+    case T_SET:
+      metric->insertSample(series.set->estimate(), series.labels);
+      return;
+
+    case T_TIMER: {
+      const auto& histogram = *series.histogram;
+
+      auto insertStat = [&metric, &series] (const char* stat, double value) {
+        auto labels = series.labels;
+        labels.emplace_back("stat", stat);
+        metric->insertSample(value, labels);
+      };
+
+      insertStat("count", series.count);
+      insertStat("mean", series.value / histogram.count());
+      insertStat("min", histogram.min());
+      insertStat("max", histogram.max());
+      insertStat("p50", histogram.percentile(50));
+      insertStat("p90", histogram.percentile(90));
+      insertStat("p99", histogram.percentile(99));
+      return;
+    }
+
+  }
+}
+
+}
+}
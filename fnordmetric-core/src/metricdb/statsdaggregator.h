@@ -0,0 +1,132 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_STATSDAGGREGATOR_H
+#define _FNORDMETRIC_METRICDB_STATSDAGGREGATOR_H
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <fnordmetric/metricdb/metricrepository.h>
+#include <fnordmetric/stats/counter.h>
+#include <fnordmetric/stats/profiledmutex.h>
+#include <fnordmetric/thread/taskscheduler.h>
+#include <fnordmetric/util/hyperloglog.h>
+#include <fnordmetric/util/loghistogram.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Aggregates typed statsd samples in memory and writes one aggregate per
+ * (metric, labels) and flush interval to the metric repository:
+ *
+ *   - counters (|c): the sum of all increments, each divided by its sample
+ *     rate (@0.1)
+ *   - gauges (|g): the last value. A value with a leading + or - is added to
+ *     the current value. The last value is kept across flushes, but only
+ *     gauges that were updated in an interval are written. Gauges that were
+ *     not updated for kGaugeExpiryIntervals intervals are forgotten
+ *   - timers (|ms, |h): the count, mean, min, max, p50, p90 and p99 of the
+ *     values, distinguished by the "stat" label like the histograms written
+ *     by the StatsRecorder
+ *   - sets (|s): the estimated number of distinct values
+ *
+ * Samples without a type are not aggregated and should be inserted directly.
+ * The series are spread over kNumShards independently locked shards so that
+ * concurrent ingest threads rarely contend.
+ */
+class StatsdAggregator {
+public:
+  static const size_t kNumShards = 16;
+  static const uint32_t kGaugeExpiryIntervals = 60;
+
+  enum kSampleType {
+    T_COUNTER,
+    T_GAUGE,
+    T_TIMER,
+    T_SET
+  };
+
+  typedef std::vector<std::pair<std::string, std::string>> LabelListType;
+
+  /**
+   * Does not transfer ownership
+   */
+  StatsdAggregator(
+      IMetricRepository* metric_repo,
+      fnord::thread::TaskScheduler* scheduler,
+      uint64_t flush_interval_micros);
+
+  /**
+   * Schedule the first flush. The next flush is always scheduled, even if
+   * the previous one failed
+   */
+  void start();
+
+  /**
+   * Add a sample to the current interval. The value of a set sample is the
+   * raw set member, all other values must be numeric. Throws a parse error
+   * if the value is invalid
+   */
+  void addSample(
+      const std::string& key,
+      const LabelListType& labels,
+      kSampleType type,
+      const std::string& value,
+      double sample_rate);
+
+  /**
+   * Write the aggregates of the current interval to the metric repository
+   * and start a new interval. A series that can't be written is dropped and
+   * counted in statsd.flush_errors, the other series are still written
+   */
+  void flush();
+
+protected:
+
+  struct Series {
+    Series(
+        const std::string& key,
+        const LabelListType& labels,
+        kSampleType type);
+
+    std::string key;
+    LabelListType labels;
+    kSampleType type;
+    bool updated;
+    uint32_t idle_intervals;
+    double value;
+    double count;
+    std::unique_ptr<fnord::util::LogHistogram> histogram;
+    std::unique_ptr<fnord::util::HyperLogLog> set;
+  };
+
+  struct Shard {
+    Shard() : mutex("statsd.aggregator") {}
+    fnord::stats::ProfiledMutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<Series>> series;
+  };
+
+  void flushSeries(const Series& series);
+
+  IMetricRepository* metric_repo_;
+  fnord::thread::TaskScheduler* scheduler_;
+  uint64_t flush_interval_micros_;
+  Shard shards_[kNumShards];
+  fnord::stats::Counter* samples_aggregated_;
+  fnord::stats::Counter* series_flushed_;
+  fnord::stats::Counter* flush_errors_;
+  fnord::stats::Counter* gauges_expired_;
+};
+
+}
+}
+#endif
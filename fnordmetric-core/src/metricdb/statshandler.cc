@@ -0,0 +1,118 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string>
+#include <utility>
+#include <vector>
+#include <fnordmetric/metricdb/statshandler.h>
+#include <fnordmetric/util/jsonoutputstream.h>
+#include <fnordmetric/util/stringutil.h>
+#include <fnordmetric/util/uri.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+static const char kStatsUrl[] = "/stats";
+
+StatsHandler::StatsHandler(
+    stats::StatsRegistry* stats_registry) :
+    stats_registry_(stats_registry) {}
+
+bool StatsHandler::handleHTTPRequest(
+    http::HTTPRequest* request,
+    http::HTTPResponse* response) {
+  util::URI uri(request->getUrl());
+  auto path = uri.path();
+  fnord::util::StringUtil::stripTrailingSlashes(&path);
+
+  if (path != kStatsUrl ||
+      request->method() != http::HTTPRequest::M_GET) {
+    return false;
+  }
+
+  response->setStatus(http::kStatusOK);
+  response->addHeader("Content-Type", "application/json; charset=utf-8");
+  util::JSONOutputStream json(response->getBodyOutputStream());
+
+  std::vector<std::pair<std::string, uint64_t>> counters;
+  std::vector<std::pair<std::string, int64_t>> gauges;
+  std::vector<std::pair<std::string, stats::Histogram::Snapshot>> histograms;
+
+  stats_registry_->exportStats(
+      [&counters] (const std::string& name, const stats::Counter& counter) {
+        counters.emplace_back(name, counter.get());
+      },
+      [&gauges] (const std::string& name, const stats::Gauge& gauge) {
+        gauges.emplace_back(name, gauge.get());
+      },
+      [&histograms] (
+          const std::string& name,
+          const stats::Histogram& histogram) {
+        histograms.emplace_back(name, histogram.snapshot());
+      });
+
+  json.beginObject();
+  json.addObjectEntry("counters");
+  json.beginObject();
+
+  for (int i = 0; i < counters.size(); ++i) {
+    if (i > 0) { json.addComma(); }
+    json.addObjectEntry(counters[i].first);
+    json.addLiteral<uint64_t>(counters[i].second);
+  }
+
+  json.endObject();
+  json.addComma();
+  json.addObjectEntry("gauges");
+  json.beginObject();
+
+  for (int i = 0; i < gauges.size(); ++i) {
+    if (i > 0) { json.addComma(); }
+    json.addObjectEntry(gauges[i].first);
+    json.addLiteral<int64_t>(gauges[i].second);
+  }
+
+  json.endObject();
+  json.addComma();
+  json.addObjectEntry("histograms");
+  json.beginObject();
+
+  for (int i = 0; i < histograms.size(); ++i) {
+    const auto& snapshot = histograms[i].second;
+
+    if (i > 0) { json.addComma(); }
+    json.addObjectEntry(histograms[i].first);
+    json.beginObject();
+    json.addObjectEntry("count");
+    json.addLiteral<uint64_t>(snapshot.count);
+    json.addComma();
+    json.addObjectEntry("mean");
+    json.addFloat(snapshot.mean());
+    json.addComma();
+    json.addObjectEntry("p50");
+    json.addFloat(snapshot.percentile(50));
+    json.addComma();
+    json.addObjectEntry("p90");
+    json.addFloat(snapshot.percentile(90));
+    json.addComma();
+    json.addObjectEntry("p99");
+    json.addFloat(snapshot.percentile(99));
+    json.addComma();
+    json.addObjectEntry("max");
+    json.addFloat(snapshot.max());
+    json.endObject();
+  }
+
+  json.endObject();
+  json.endObject();
+  return true;
+}
+
+}
+}
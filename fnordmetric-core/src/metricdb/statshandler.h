@@ -0,0 +1,43 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_STATSHANDLER_H
+#define _FNORDMETRIC_METRICDB_STATSHANDLER_H
+#include <fnordmetric/http/httphandler.h>
+#include <fnordmetric/http/httprequest.h>
+#include <fnordmetric/http/httpresponse.h>
+#include <fnordmetric/stats/statsregistry.h>
+
+using namespace fnord;
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Renders all counters, gauges and histograms of a stats registry as JSON on
+ * GET /stats
+ */
+class StatsHandler : public http::HTTPHandler {
+public:
+
+  /**
+   * Does not transfer ownership
+   */
+  StatsHandler(stats::StatsRegistry* stats_registry);
+
+  bool handleHTTPRequest(
+      http::HTTPRequest* request,
+      http::HTTPResponse* response) override;
+
+protected:
+  stats::StatsRegistry* stats_registry_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,104 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <utility>
+#include <vector>
+#include <fnordmetric/metricdb/statsrecorder.h>
+#include <fnordmetric/thread/task.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+const char StatsRecorder::kMetricPrefix[] = "fnordmetric.";
+
+StatsRecorder::StatsRecorder(
+    fnord::stats::StatsRegistry* stats_registry,
+    IMetricRepository* metric_repo,
+    fnord::thread::TaskScheduler* scheduler,
+    uint64_t interval_micros) :
+    stats_registry_(stats_registry),
+    metric_repo_(metric_repo),
+    scheduler_(scheduler),
+    interval_micros_(interval_micros) {}
+
+void StatsRecorder::start() {
+  scheduler_->runAfter(
+      fnord::thread::Task::create([this] () -> void {
+        run();
+        start();
+      }),
+      interval_micros_,
+      fnord::thread::TaskScheduler::PRIORITY_LOW);
+}
+
+void StatsRecorder::run() {
+  typedef std::vector<std::pair<std::string, std::string>> LabelList;
+  std::vector<std::pair<std::string, uint64_t>> counters;
+  std::vector<std::pair<std::string, int64_t>> gauges;
+  std::vector<std::pair<std::string, fnord::stats::Histogram::Snapshot>>
+      histograms;
+
+  /* inserting samples updates stats, too, so the registry must not be
+     locked while we insert */
+  stats_registry_->exportStats(
+      [&counters] (
+          const std::string& name,
+          const fnord::stats::Counter& counter) {
+        counters.emplace_back(name, counter.get());
+      },
+      [&gauges] (const std::string& name, const fnord::stats::Gauge& gauge) {
+        gauges.emplace_back(name, gauge.get());
+      },
+      [&histograms] (
+          const std::string& name,
+          const fnord::stats::Histogram& histogram) {
+        histograms.emplace_back(name, histogram.snapshot());
+      });
+
+  for (const auto& counter : counters) {
+    auto& last_value = last_counters_[counter.first];
+    auto metric = metric_repo_->findOrCreateMetric(
+        kMetricPrefix + counter.first);
+
+    metric->insertSample(counter.second - last_value, LabelList{});
+    last_value = counter.second;
+  }
+
+  for (const auto& gauge : gauges) {
+    auto metric = metric_repo_->findOrCreateMetric(
+        kMetricPrefix + gauge.first);
+
+    metric->insertSample(gauge.second, LabelList{});
+  }
+
+  for (const auto& histogram : histograms) {
+    auto interval = histogram.second;
+    auto last_iter = last_histograms_.find(histogram.first);
+    if (last_iter != last_histograms_.end()) {
+      interval.subtract(last_iter->second);
+    }
+
+    last_histograms_[histogram.first] = histogram.second;
+
+    auto metric = metric_repo_->findOrCreateMetric(
+        kMetricPrefix + histogram.first);
+
+    metric->insertSample(interval.count, LabelList{{"stat", "count"}});
+    if (interval.count == 0) {
+      continue;
+    }
+
+    metric->insertSample(interval.percentile(50), LabelList{{"stat", "p50"}});
+    metric->insertSample(interval.percentile(99), LabelList{{"stat", "p99"}});
+    metric->insertSample(interval.max(), LabelList{{"stat", "max"}});
+  }
+}
+
+}
+}
@@ -0,0 +1,67 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_STATSRECORDER_H
+#define _FNORDMETRIC_METRICDB_STATSRECORDER_H
+#include <map>
+#include <string>
+#include <fnordmetric/metricdb/metricrepository.h>
+#include <fnordmetric/stats/statsregistry.h>
+#include <fnordmetric/thread/taskscheduler.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Periodically writes the stats of a stats registry into a metric repository,
+ * so the server's own stats can be charted with ChartSQL. Every stat is
+ * written to the metric "fnordmetric.<name>":
+ *
+ *   - counters: the increase since the previous run
+ *   - gauges: the current value
+ *   - histograms: the count, p50, p99 and max of the values inserted since
+ *     the previous run, distinguished by the "stat" label
+ *
+ * Like the CompactionTask, each run schedules the next one when it is done.
+ */
+class StatsRecorder {
+public:
+  static const char kMetricPrefix[];
+
+  /**
+   * Does not transfer ownership
+   */
+  StatsRecorder(
+      fnord::stats::StatsRegistry* stats_registry,
+      IMetricRepository* metric_repo,
+      fnord::thread::TaskScheduler* scheduler,
+      uint64_t interval_micros);
+
+  /**
+   * Schedule the first run
+   */
+  void start();
+
+  /**
+   * Record the current stats once
+   */
+  void run();
+
+protected:
+  fnord::stats::StatsRegistry* stats_registry_;
+  IMetricRepository* metric_repo_;
+  fnord::thread::TaskScheduler* scheduler_;
+  uint64_t interval_micros_;
+  std::map<std::string, uint64_t> last_counters_;
+  std::map<std::string, fnord::stats::Histogram::Snapshot> last_histograms_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,223 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <fnordmetric/environment.h>
+#include <fnordmetric/metricdb/tcpingestserver.h>
+#include <fnordmetric/stats/allocationscope.h>
+#include <fnordmetric/thread/task.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+TCPIngestServer::TCPIngestServer(
+    IMetricRepository* metric_repo,
+    fnord::thread::TaskScheduler* scheduler) :
+    metric_repo_(metric_repo),
+    scheduler_(scheduler),
+    ssock_(-1),
+    num_connections_(0),
+    connections_accepted_(env()->stats()->counter("tcp.connections_accepted")),
+    connections_open_(env()->stats()->gauge("tcp.connections_open")),
+    bytes_received_(env()->stats()->counter("tcp.bytes_received")),
+    samples_received_(env()->stats()->counter("tcp.samples_received")),
+    samples_dropped_(env()->stats()->counter("tcp.samples_dropped")) {}
+
+void TCPIngestServer::listen(int port) {
+  ssock_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (ssock_ < 0) {
+    RAISE_ERRNO(kIOError, "create socket() failed");
+  }
+
+  int opt = 1;
+  if (setsockopt(ssock_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+    RAISE_ERRNO(kIOError, "setsockopt(SO_REUSEADDR) failed");
+  }
+
+  struct sockaddr_in addr;
+  memset((char *) &addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (::bind(ssock_, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    RAISE_ERRNO(kIOError, "bind() failed");
+  }
+
+  if (::listen(ssock_, 1024) == -1) {
+    RAISE_ERRNO(kIOError, "listen() failed");
+  }
+
+  if (fcntl(ssock_, F_SETFL, fcntl(ssock_, F_GETFL, 0) | O_NONBLOCK) != 0) {
+    RAISE_ERRNO(kIOError, "fcntl(%i) failed", ssock_);
+  }
+
+  scheduler_->runOnReadable(
+      fnord::thread::Task::create(std::bind(&TCPIngestServer::accept, this)),
+      ssock_);
+}
+
+TCPIngestServer::Connection* TCPIngestServer::createConnection() {
+  return new Connection();
+}
+
+void TCPIngestServer::accept() {
+  for (;;) {
+    int fd = ::accept(ssock_, NULL, NULL);
+
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+
+      /* the listen socket stays readable while connections are waiting, so
+         retry later instead of spinning until fds are available again */
+      if (errno == EMFILE || errno == ENFILE ||
+          errno == ENOBUFS || errno == ENOMEM) {
+        env()->logger()->printf(
+            "ERROR",
+            "TCP server: accept() failed, retrying in %llums: %s",
+            (unsigned long long) kAcceptRetryMicros / 1000,
+            strerror(errno));
+
+        scheduler_->runAfter(
+            fnord::thread::Task::create(
+                std::bind(&TCPIngestServer::accept, this)),
+            kAcceptRetryMicros,
+            fnord::thread::TaskScheduler::PRIORITY_NORMAL);
+
+        return;
+      }
+
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        env()->logger()->printf(
+            "ERROR",
+            "TCP server: accept() failed: %s",
+            strerror(errno));
+      }
+
+      break;
+    }
+
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) != 0) {
+      close(fd);
+      continue;
+    }
+
+    connections_accepted_->incr();
+    connections_open_->set(++num_connections_);
+
+    auto conn = createConnection();
+    conn->fd = fd;
+    scheduler_->runOnReadable(
+        fnord::thread::Task::create([this, conn] () {
+          read(conn);
+        }),
+        fd);
+  }
+
+  scheduler_->runOnReadable(
+      fnord::thread::Task::create(std::bind(&TCPIngestServer::accept, this)),
+      ssock_);
+}
+
+void TCPIngestServer::read(Connection* conn) {
+  fnord::stats::AllocationScope allocation_scope(
+      fnord::stats::AllocationStats::SUBSYSTEM_INGEST);
+
+  char chunk[65536];
+  size_t bytes_read = 0;
+  bool eof = false;
+
+  while (bytes_read < kMaxReadBytes) {
+    auto chunk_size = ::read(conn->fd, chunk, sizeof(chunk));
+
+    if (chunk_size > 0) {
+      conn->buf.append(chunk, chunk_size);
+      bytes_read += chunk_size;
+      continue;
+    }
+
+    if (chunk_size < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (chunk_size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+
+    eof = true;
+    break;
+  }
+
+  bytes_received_->incr(bytes_read);
+
+  /* the connection must be closed or watched again whatever happens here,
+     otherwise the fd leaks */
+  bool processed;
+  try {
+    processed = processInput(conn, eof);
+  } catch (const util::RuntimeException& e) {
+    env()->logger()->printf(
+        "ERROR",
+        "TCP server: processing input on fd %i failed: %s",
+        conn->fd,
+        e.getMessage().c_str());
+
+    processed = false;
+  } catch (const std::exception& e) {
+    env()->logger()->printf(
+        "ERROR",
+        "TCP server: processing input on fd %i failed: %s",
+        conn->fd,
+        e.what());
+
+    processed = false;
+  }
+
+  if (!processed) {
+    env()->logger()->printf(
+        "WARNING",
+        "TCP server: closing connection on fd %i, input was not processed",
+        conn->fd);
+
+    eof = true;
+  } else if (!eof && conn->buf.size() > kMaxMessageSize) {
+    env()->logger()->printf(
+        "WARNING",
+        "TCP server: closing connection on fd %i, message too long",
+        conn->fd);
+
+    samples_dropped_->incr();
+    eof = true;
+  }
+
+  if (eof) {
+    close(conn->fd);
+    delete conn;
+    connections_open_->set(--num_connections_);
+    return;
+  }
+
+  /* the next read is only scheduled once this batch was inserted */
+  scheduler_->runOnReadable(
+      fnord::thread::Task::create([this, conn] () {
+        read(conn);
+      }),
+      conn->fd);
+}
+
+}
+}
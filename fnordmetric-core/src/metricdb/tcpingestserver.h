@@ -0,0 +1,92 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_METRICDB_TCPINGESTSERVER_H
+#define _FNORDMETRIC_METRICDB_TCPINGESTSERVER_H
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <fnordmetric/metricdb/metricrepository.h>
+#include <fnordmetric/stats/counter.h>
+#include <fnordmetric/stats/gauge.h>
+#include <fnordmetric/thread/taskscheduler.h>
+
+namespace fnordmetric {
+namespace metricdb {
+
+/**
+ * Base class for ingest protocols over long-lived TCP connections.
+ *
+ * Every time a connection becomes readable, up to kMaxReadBytes are appended
+ * to the connection's buffer and handed to processInput, which consumes all
+ * complete messages and inserts their samples. The connection is only
+ * watched for the next read once processInput returned, so a slow backend
+ * makes the kernel's receive buffer fill up and blocks the client instead of
+ * silently dropping samples.
+ *
+ * Connections that buffer more than kMaxMessageSize bytes of an incomplete
+ * message are closed. If accepting fails because the process ran out of file
+ * descriptors or memory, the server retries after kAcceptRetryMicros.
+ */
+class TCPIngestServer {
+public:
+  static const size_t kMaxReadBytes = 1 << 20;
+  static const size_t kMaxMessageSize = 1 << 16;
+  static const uint64_t kAcceptRetryMicros = 100000;
+
+  /**
+   * Does not transfer ownership
+   */
+  TCPIngestServer(
+      IMetricRepository* metric_repo,
+      fnord::thread::TaskScheduler* scheduler);
+
+  virtual ~TCPIngestServer() {}
+
+  void listen(int port);
+
+protected:
+
+  class Connection {
+  public:
+    virtual ~Connection() {}
+    int fd;
+    std::string buf;
+  };
+
+  /**
+   * Returns a new connection. Subclasses may return a subclass of Connection
+   * to keep per-connection protocol state
+   */
+  virtual Connection* createConnection();
+
+  /**
+   * Consume all complete messages (and, if eof is true, the rest) from the
+   * connection's buffer. Returns false if the input is invalid or its
+   * samples could not be inserted and the connection should be closed
+   */
+  virtual bool processInput(Connection* conn, bool eof) = 0;
+
+  void accept();
+  void read(Connection* conn);
+
+  IMetricRepository* metric_repo_;
+  fnord::thread::TaskScheduler* scheduler_;
+  int ssock_;
+  std::atomic<int64_t> num_connections_;
+  fnord::stats::Counter* connections_accepted_;
+  fnord::stats::Gauge* connections_open_;
+  fnord::stats::Counter* bytes_received_;
+  fnord::stats::Counter* samples_received_;
+  fnord::stats::Counter* samples_dropped_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,325 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <fnordmetric/msgpack/messagepackreader.h>
+
+namespace fnord {
+namespace msgpack {
+
+MessagePackReader::MessagePackReader(
+    const void* data,
+    size_t size) :
+    data_(static_cast<const uint8_t*>(data)),
+    size_(size),
+    pos_(0) {}
+
+uint8_t MessagePackReader::peekByte() const {
+  if (pos_ >= size_) {
+    RAISE(kBufferOverflowError, "requested read exceeds message bounds");
+  }
+
+  return data_[pos_];
+}
+
+const uint8_t* MessagePackReader::consume(size_t size) {
+  if (size > size_ - pos_) {
+    RAISE(kBufferOverflowError, "requested read exceeds message bounds");
+  }
+
+  auto ptr = data_ + pos_;
+  pos_ += size;
+  return ptr;
+}
+
+uint64_t MessagePackReader::readBigEndian(size_t size) {
+  auto bytes = consume(size);
+  uint64_t value = 0;
+
+  for (size_t i = 0; i < size; ++i) {
+    value = (value << 8) | bytes[i];
+  }
+
+  return value;
+}
+
+MessagePackReader::kType MessagePackReader::nextType() const {
+  auto byte = peekByte();
+
+  if (byte <= 0x7f) return T_UINT;
+  if (byte <= 0x8f) return T_MAP;
+  if (byte <= 0x9f) return T_ARRAY;
+  if (byte <= 0xbf) return T_STRING;
+  if (byte >= 0xe0) return T_INT;
+
+  switch (byte) {
+    case 0xc0: return T_NIL;
+    case 0xc2:
+    case 0xc3: return T_BOOL;
+    case 0xc4:
+    case 0xc5:
+    case 0xc6: return T_BINARY;
+    case 0xca:
+    case 0xcb: return T_FLOAT;
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf: return T_UINT;
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3: return T_INT;
+    case 0xd9:
+    case 0xda:
+    case 0xdb: return T_STRING;
+    case 0xdc:
+    case 0xdd: return T_ARRAY;
+    case 0xde:
+    case 0xdf: return T_MAP;
+  }
+
+  RAISE(kParseError, "unsupported msgpack type: 0x%02x", byte);
+}
+
+void MessagePackReader::readNil() {
+  if (peekByte() != 0xc0) {
+    RAISE(kTypeError, "msgpack value is not nil");
+  }
+
+  pos_++;
+}
+
+bool MessagePackReader::readBool() {
+  switch (peekByte()) {
+    case 0xc2:
+      pos_++;
+      return false;
+    case 0xc3:
+      pos_++;
+      return true;
+    default:
+      RAISE(kTypeError, "msgpack value is not a bool");
+  }
+}
+
+uint64_t MessagePackReader::readUInt() {
+  auto byte = peekByte();
+
+  if (byte <= 0x7f) {
+    pos_++;
+    return byte;
+  }
+
+  switch (byte) {
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+      pos_++;
+      return readBigEndian(1 << (byte - 0xcc));
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3: {
+      auto value = readInt();
+      if (value < 0) {
+        RAISE(kTypeError, "msgpack value is negative");
+      }
+
+      return value;
+    }
+    default:
+      RAISE(kTypeError, "msgpack value is not an integer");
+  }
+}
+
+int64_t MessagePackReader::readInt() {
+  auto byte = peekByte();
+
+  if (byte >= 0xe0) {
+    pos_++;
+    return static_cast<int8_t>(byte);
+  }
+
+  switch (byte) {
+    case 0xd0:
+      pos_++;
+      return static_cast<int8_t>(readBigEndian(1));
+    case 0xd1:
+      pos_++;
+      return static_cast<int16_t>(readBigEndian(2));
+    case 0xd2:
+      pos_++;
+      return static_cast<int32_t>(readBigEndian(4));
+    case 0xd3:
+      pos_++;
+      return static_cast<int64_t>(readBigEndian(8));
+    default: {
+      auto value = readUInt();
+      if (value > INT64_MAX) {
+        RAISE(kRangeError, "msgpack integer exceeds int64 range");
+      }
+
+      return value;
+    }
+  }
+}
+
+double MessagePackReader::readFloat() {
+  switch (peekByte()) {
+    case 0xca: {
+      pos_++;
+      uint32_t bits = readBigEndian(4);
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+    case 0xcb: {
+      pos_++;
+      uint64_t bits = readBigEndian(8);
+      double value;
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+    default:
+      if (nextType() == T_INT) {
+        return readInt();
+      }
+
+      return readUInt();
+  }
+}
+
+void MessagePackReader::readString(const char** data, size_t* size) {
+  auto byte = peekByte();
+
+  if (byte >= 0xa0 && byte <= 0xbf) {
+    pos_++;
+    *size = byte & 0x1f;
+  } else {
+    switch (byte) {
+      case 0xc4:
+      case 0xd9:
+        pos_++;
+        *size = readBigEndian(1);
+        break;
+      case 0xc5:
+      case 0xda:
+        pos_++;
+        *size = readBigEndian(2);
+        break;
+      case 0xc6:
+      case 0xdb:
+        pos_++;
+        *size = readBigEndian(4);
+        break;
+      default:
+        RAISE(kTypeError, "msgpack value is not a string");
+    }
+  }
+
+  *data = reinterpret_cast<const char*>(consume(*size));
+}
+
+uint32_t MessagePackReader::readArrayHeader() {
+  auto byte = peekByte();
+
+  if (byte >= 0x90 && byte <= 0x9f) {
+    pos_++;
+    return byte & 0x0f;
+  }
+
+  switch (byte) {
+    case 0xdc:
+      pos_++;
+      return readBigEndian(2);
+    case 0xdd:
+      pos_++;
+      return readBigEndian(4);
+    default:
+      RAISE(kTypeError, "msgpack value is not an array");
+  }
+}
+
+uint32_t MessagePackReader::readMapHeader() {
+  auto byte = peekByte();
+
+  if (byte >= 0x80 && byte <= 0x8f) {
+    pos_++;
+    return byte & 0x0f;
+  }
+
+  switch (byte) {
+    case 0xde:
+      pos_++;
+      return readBigEndian(2);
+    case 0xdf:
+      pos_++;
+      return readBigEndian(4);
+    default:
+      RAISE(kTypeError, "msgpack value is not a map");
+  }
+}
+
+void MessagePackReader::skip() {
+  const char* data;
+  size_t size;
+
+  switch (nextType()) {
+    case T_NIL:
+      readNil();
+      return;
+    case T_BOOL:
+      readBool();
+      return;
+    case T_UINT:
+      readUInt();
+      return;
+    case T_INT:
+      readInt();
+      return;
+    case T_FLOAT:
+      readFloat();
+      return;
+    case T_STRING:
+    case T_BINARY:
+      readString(&data, &size);
+      return;
+    case T_ARRAY:
+      for (auto n = readArrayHeader(); n > 0; --n) {
+        skip();
+      }
+      return;
+    case T_MAP:
+      for (auto n = readMapHeader(); n > 0; --n) {
+        skip();
+        skip();
+      }
+      return;
+  }
+}
+
+size_t MessagePackReader::position() const {
+  return pos_;
+}
+
+void MessagePackReader::seekTo(size_t pos) {
+  if (pos > size_) {
+    RAISE(kBufferOverflowError, "requested position exceeds message bounds");
+  }
+
+  pos_ = pos;
+}
+
+bool MessagePackReader::eof() const {
+  return pos_ >= size_;
+}
+
+}
+}
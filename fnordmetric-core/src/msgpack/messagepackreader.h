@@ -10,21 +10,94 @@
 #ifndef _FNORD_STORAGE_MSGPACK_H
 #define _FNORD_STORAGE_MSGPACK_H
 #include <stdlib.h>
-#include <string>
-#include <vector>
-#include <memory>
+#include <stdint.h>
 #include <fnordmetric/util/runtimeexception.h>
-#include <fnordmetric/sql/parser/token.h>
-#include <fnordmetric/sql/parser/astnode.h>
 
 namespace fnord {
 namespace msgpack {
 
+/**
+ * Reads MessagePack encoded values from a buffer without copying them
+ *   see https://github.com/msgpack/msgpack/blob/master/spec.md
+ *
+ * Strings and binaries are returned as pointers into the buffer. Reading
+ * past the end of the buffer raises a kBufferOverflowError, so a caller that
+ * receives a stream in pieces can rewind to the start of the current message
+ * with seekTo and retry once more data arrived. Extension types are not
+ * supported and raise a kParseError.
+ */
 class MessagePackReader {
+public:
 
+  enum kType {
+    T_NIL,
+    T_BOOL,
+    T_UINT,
+    T_INT,
+    T_FLOAT,
+    T_STRING,
+    T_BINARY,
+    T_ARRAY,
+    T_MAP
+  };
 
-};
+  MessagePackReader(const void* data, size_t size);
+
+  /**
+   * Returns the type of the next value without consuming it. Negative
+   * integers are T_INT, all other integers are T_UINT
+   */
+  kType nextType() const;
+
+  void readNil();
+  bool readBool();
+
+  /**
+   * Reads a non-negative integer
+   */
+  uint64_t readUInt();
+
+  /**
+   * Reads an integer that fits into an int64_t
+   */
+  int64_t readInt();
 
+  /**
+   * Reads a float or an integer
+   */
+  double readFloat();
+
+  /**
+   * Reads a string or binary. The returned pointer is valid as long as the
+   * underlying buffer is
+   */
+  void readString(const char** data, size_t* size);
+
+  /**
+   * Read the header of an array/map. The elements (key/value pairs for maps)
+   * follow as separate values
+   */
+  uint32_t readArrayHeader();
+  uint32_t readMapHeader();
+
+  /**
+   * Skip the next value including all nested values
+   */
+  void skip();
+
+  size_t position() const;
+  void seekTo(size_t pos);
+  bool eof() const;
+
+protected:
+  uint8_t peekByte() const;
+  const uint8_t* consume(size_t size);
+  uint64_t readBigEndian(size_t size);
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+};
 
 }
 }
@@ -0,0 +1,115 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <fnordmetric/msgpack/messagepackwriter.h>
+
+namespace fnord {
+namespace msgpack {
+
+MessagePackWriter::MessagePackWriter(std::string* target) : target_(target) {}
+
+void MessagePackWriter::writeBigEndian(
+    uint8_t type,
+    uint64_t value,
+    size_t size) {
+  char buf[9];
+  buf[0] = type;
+
+  for (size_t i = 0; i < size; ++i) {
+    buf[size - i] = static_cast<char>(value >> (i * 8));
+  }
+
+  target_->append(buf, size + 1);
+}
+
+void MessagePackWriter::writeNil() {
+  target_->push_back(static_cast<char>(0xc0));
+}
+
+void MessagePackWriter::writeBool(bool value) {
+  target_->push_back(static_cast<char>(value ? 0xc3 : 0xc2));
+}
+
+void MessagePackWriter::writeUInt(uint64_t value) {
+  if (value <= 0x7f) {
+    target_->push_back(static_cast<char>(value));
+  } else if (value <= UINT8_MAX) {
+    writeBigEndian(0xcc, value, 1);
+  } else if (value <= UINT16_MAX) {
+    writeBigEndian(0xcd, value, 2);
+  } else if (value <= UINT32_MAX) {
+    writeBigEndian(0xce, value, 4);
+  } else {
+    writeBigEndian(0xcf, value, 8);
+  }
+}
+
+void MessagePackWriter::writeInt(int64_t value) {
+  if (value >= 0) {
+    writeUInt(value);
+  } else if (value >= -32) {
+    target_->push_back(static_cast<char>(value));
+  } else if (value >= INT8_MIN) {
+    writeBigEndian(0xd0, value, 1);
+  } else if (value >= INT16_MIN) {
+    writeBigEndian(0xd1, value, 2);
+  } else if (value >= INT32_MIN) {
+    writeBigEndian(0xd2, value, 4);
+  } else {
+    writeBigEndian(0xd3, value, 8);
+  }
+}
+
+void MessagePackWriter::writeFloat(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  writeBigEndian(0xcb, bits, 8);
+}
+
+void MessagePackWriter::writeString(const char* data, size_t size) {
+  if (size <= 31) {
+    target_->push_back(static_cast<char>(0xa0 | size));
+  } else if (size <= UINT8_MAX) {
+    writeBigEndian(0xd9, size, 1);
+  } else if (size <= UINT16_MAX) {
+    writeBigEndian(0xda, size, 2);
+  } else {
+    writeBigEndian(0xdb, size, 4);
+  }
+
+  target_->append(data, size);
+}
+
+void MessagePackWriter::writeString(const std::string& str) {
+  writeString(str.data(), str.size());
+}
+
+void MessagePackWriter::writeArrayHeader(uint32_t size) {
+  if (size <= 15) {
+    target_->push_back(static_cast<char>(0x90 | size));
+  } else if (size <= UINT16_MAX) {
+    writeBigEndian(0xdc, size, 2);
+  } else {
+    writeBigEndian(0xdd, size, 4);
+  }
+}
+
+void MessagePackWriter::writeMapHeader(uint32_t size) {
+  if (size <= 15) {
+    target_->push_back(static_cast<char>(0x80 | size));
+  } else if (size <= UINT16_MAX) {
+    writeBigEndian(0xde, size, 2);
+  } else {
+    writeBigEndian(0xdf, size, 4);
+  }
+}
+
+}
+}
@@ -0,0 +1,50 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_MSGPACK_MESSAGEPACKWRITER_H
+#define _FNORDMETRIC_MSGPACK_MESSAGEPACKWRITER_H
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+
+namespace fnord {
+namespace msgpack {
+
+/**
+ * Appends MessagePack encoded values to a string, always using the smallest
+ * encoding for the value
+ */
+class MessagePackWriter {
+public:
+
+  /**
+   * Does not transfer ownership
+   */
+  MessagePackWriter(std::string* target);
+
+  void writeNil();
+  void writeBool(bool value);
+  void writeUInt(uint64_t value);
+  void writeInt(int64_t value);
+  void writeFloat(double value);
+  void writeString(const char* data, size_t size);
+  void writeString(const std::string& str);
+  void writeArrayHeader(uint32_t size);
+  void writeMapHeader(uint32_t size);
+
+protected:
+  void writeBigEndian(uint8_t type, uint64_t value, size_t size);
+
+  std::string* target_;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <string>
+#include <fnordmetric/msgpack/messagepackreader.h>
+#include <fnordmetric/msgpack/messagepackwriter.h>
+#include <fnordmetric/util/unittest.h>
+
+using fnord::msgpack::MessagePackReader;
+using fnord::msgpack::MessagePackWriter;
+
+UNIT_TEST(MessagePackTest);
+
+TEST_CASE(MessagePackTest, TestRoundTrip, [] () {
+  std::string buf;
+  MessagePackWriter writer(&buf);
+  writer.writeArrayHeader(3);
+  writer.writeUInt(7);
+  writer.writeUInt(300);
+  writer.writeUInt(UINT64_MAX);
+  writer.writeInt(-5);
+  writer.writeInt(-40000);
+  writer.writeFloat(23.5);
+  writer.writeString("fnord");
+  writer.writeString(std::string(300, 'x'));
+  writer.writeMapHeader(20);
+  writer.writeNil();
+  writer.writeBool(true);
+
+  MessagePackReader reader(buf.data(), buf.size());
+  EXPECT(reader.nextType() == MessagePackReader::T_ARRAY);
+  EXPECT_EQ(reader.readArrayHeader(), 3);
+  EXPECT_EQ(reader.readUInt(), 7);
+  EXPECT_EQ(reader.readUInt(), 300);
+  EXPECT_EQ(reader.readUInt(), UINT64_MAX);
+  EXPECT(reader.nextType() == MessagePackReader::T_INT);
+  EXPECT_EQ(reader.readInt(), -5);
+  EXPECT_EQ(reader.readInt(), -40000);
+  EXPECT(reader.readFloat() == 23.5);
+
+  const char* str;
+  size_t str_len;
+  reader.readString(&str, &str_len);
+  EXPECT_EQ(std::string(str, str_len), "fnord");
+  reader.readString(&str, &str_len);
+  EXPECT_EQ(str_len, 300);
+
+  EXPECT_EQ(reader.readMapHeader(), 20);
+  reader.readNil();
+  EXPECT(reader.readBool());
+  EXPECT(reader.eof());
+});
+
+TEST_CASE(MessagePackTest, TestSmallestEncoding, [] () {
+  std::string buf;
+  MessagePackWriter writer(&buf);
+  writer.writeUInt(127);
+  EXPECT_EQ(buf.size(), 1);
+  writer.writeInt(-32);
+  EXPECT_EQ(buf.size(), 2);
+  writer.writeString("abc");
+  EXPECT_EQ(buf.size(), 6);
+  writer.writeArrayHeader(15);
+  EXPECT_EQ(buf.size(), 7);
+});
+
+TEST_CASE(MessagePackTest, TestSkipAndTruncation, [] () {
+  std::string buf;
+  MessagePackWriter writer(&buf);
+  writer.writeArrayHeader(2);
+  writer.writeMapHeader(1);
+  writer.writeString("key");
+  writer.writeFloat(1.5);
+  writer.writeString("value");
+  writer.writeUInt(42);
+
+  MessagePackReader reader(buf.data(), buf.size());
+  reader.skip();
+  EXPECT_EQ(reader.readUInt(), 42);
+
+  MessagePackReader truncated(buf.data(), buf.size() - 3);
+  bool raised = false;
+  try {
+    truncated.skip();
+  } catch (fnordmetric::util::RuntimeException& e) {
+    raised = e.getTypeName() == "BufferOverflowError";
+  }
+
+  EXPECT(raised);
+});
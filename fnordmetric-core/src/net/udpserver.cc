@@ -7,7 +7,9 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <errno.h>
 #include <fcntl.h>
+#include <fnordmetric/environment.h>
 #include <fnordmetric/net/udpserver.h>
 #include <fnordmetric/util/runtimeexception.h>
 #include <netinet/in.h>
@@ -23,12 +25,51 @@ namespace net {
 
 UDPServer::UDPServer(
     thread::TaskScheduler* server_scheduler,
-    thread::TaskScheduler* callback_scheduler) :
+    thread::TaskScheduler* callback_scheduler,
+    size_t queue_size /* = kDefaultQueueSize */,
+    size_t num_queues /* = 1 */,
+    kOverflowPolicy overflow_policy /* = DROP_NEWEST */) :
     server_scheduler_(server_scheduler),
-    callback_scheduler_(callback_scheduler) {}
+    callback_scheduler_(callback_scheduler),
+    ssock_(-1),
+    next_queue_(0),
+    overflow_policy_(overflow_policy),
+    paused_(false),
+    datagrams_received_(
+        fnordmetric::env()->stats()->counter("udp.datagrams_received")),
+    bytes_received_(
+        fnordmetric::env()->stats()->counter("udp.bytes_received")),
+    receive_errors_(
+        fnordmetric::env()->stats()->counter("udp.receive_errors")),
+    datagrams_dropped_(
+        fnordmetric::env()->stats()->counter("udp.datagrams_dropped")),
+    receive_paused_(
+        fnordmetric::env()->stats()->counter("udp.receive_paused")),
+    callback_errors_(
+        fnordmetric::env()->stats()->counter("udp.callback_errors")),
+    queued_datagrams_(
+        fnordmetric::env()->stats()->gauge("udp.queued_datagrams")) {
+  if (num_queues == 0) {
+    num_queues = 1;
+  }
+
+  for (size_t i = 0; i < num_queues; ++i) {
+    queues_.emplace_back(new Queue(queue_size));
+  }
+
+  queued_datagrams_->setCallback([this] () -> int64_t {
+    int64_t num_queued = 0;
+    for (const auto& queue : queues_) {
+      num_queued += queue->messages.size();
+    }
+
+    return num_queued;
+  });
+}
 
 UDPServer::~UDPServer() {
   // FIXPAUL cancel pending task
+  queued_datagrams_->setCallback(nullptr);
   close(ssock_);
 }
 
@@ -73,29 +114,144 @@ void UDPServer::listen(int port) {
 void UDPServer::messageReceived() {
   struct sockaddr_in other_addr;
   socklen_t other_addr_len = sizeof(other_addr);
-
   char buf[65535];
-  auto buf_len = recvfrom(
-      ssock_,
-      buf,
-      sizeof(buf),
-      0,
-      (struct sockaddr *) &other_addr,
-      &other_addr_len);
+
+  for (size_t n = 0; n < kMaxReceiveBatch; ++n) {
+    /* a datagram that didn't fit into the queues before receiving paused is
+       enqueued before anything else is received */
+    if (pending_message_.get() == nullptr) {
+      auto buf_len = recvfrom(
+          ssock_,
+          buf,
+          sizeof(buf),
+          0,
+          (struct sockaddr *) &other_addr,
+          &other_addr_len);
+
+      if (buf_len < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          receive_errors_->incr();
+        }
+
+        break;
+      }
+
+      datagrams_received_->incr();
+      bytes_received_->incr(buf_len);
+
+      if (!callback_) {
+        continue;
+      }
+
+      pending_message_.reset(new Buffer(buf, buf_len));
+    }
+
+    while (!enqueue(&pending_message_)) {
+      if (overflow_policy_ == DROP_NEWEST) {
+        datagrams_dropped_->incr();
+        pending_message_.reset(nullptr);
+        break;
+      }
+
+      if (pause()) {
+        return;
+      }
+    }
+  }
 
   server_scheduler_->runOnReadable(
       thread::Task::create(std::bind(&UDPServer::messageReceived, this)),
       ssock_);
+}
+
+bool UDPServer::enqueue(MessageType* message) {
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    auto queue = queues_[next_queue_++ % queues_.size()].get();
 
-  if (buf_len < 0) {
-    RAISE_ERRNO(kIOError, "read(%i) failed", ssock_);
+    if (queue->messages.tryPush(std::move(*message))) {
+      scheduleDrain(queue);
+      return true;
+    }
   }
 
-  if (callback_) {
-    Buffer msg(buf, buf_len);
-    callback_scheduler_->run(thread::Task::create([msg, this] () {
-      this->callback_(msg);
-    }));
+  return false;
+}
+
+bool UDPServer::pause() {
+  receive_paused_->incr();
+  paused_.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  /* a queue might have been drained before paused_ was set, in which case
+     nobody would resume receiving */
+  for (const auto& queue : queues_) {
+    if (!queue->messages.full()) {
+      /* if a drain task already cleared paused_, it scheduled the resume */
+      return !paused_.exchange(false);
+    }
+  }
+
+  return true;
+}
+
+void UDPServer::scheduleDrain(Queue* queue) {
+  if (queue->drain_scheduled.exchange(true)) {
+    return;
+  }
+
+  /* received messages are ingest work, which must not wait behind
+     queries or compaction */
+  callback_scheduler_->run(
+      thread::Task::create([this, queue] () {
+        drain(queue);
+      }),
+      thread::TaskScheduler::PRIORITY_HIGH);
+}
+
+void UDPServer::drain(Queue* queue) {
+  MessageType message;
+  size_t num_errors = 0;
+  std::string error;
+
+  /* an exception must not escape, otherwise drain_scheduled stays set and
+     the queue is never drained again */
+  for (size_t n = 0; n < kMaxDrainBatch; ++n) {
+    if (!queue->messages.tryPop(&message)) {
+      break;
+    }
+
+    try {
+      callback_(*message);
+    } catch (const fnordmetric::util::RuntimeException& e) {
+      error = e.getMessage();
+      num_errors++;
+    } catch (const std::exception& e) {
+      error = e.what();
+      num_errors++;
+    }
+  }
+
+  /* log once per batch so that a failing callback doesn't log per datagram */
+  if (num_errors > 0) {
+    callback_errors_->incr(num_errors);
+    fnordmetric::env()->logger()->printf(
+        "ERROR",
+        "UDP server: message callback failed for %llu datagrams: %s",
+        (unsigned long long) num_errors,
+        error.c_str());
+  }
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (paused_.exchange(false)) {
+    server_scheduler_->run(
+        thread::Task::create(std::bind(&UDPServer::messageReceived, this)));
+  }
+
+  queue->drain_scheduled.store(false);
+
+  /* messages that were pushed while drain_scheduled was still set */
+  if (!queue->messages.empty()) {
+    scheduleDrain(queue);
   }
 }
 
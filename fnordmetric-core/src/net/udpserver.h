@@ -9,18 +9,56 @@
  */
 #ifndef _FNORDMETRIC_NET_UDPSERVER_H
 #define _FNORDMETRIC_NET_UDPSERVER_H
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <fnordmetric/stats/counter.h>
+#include <fnordmetric/stats/gauge.h>
+#include <fnordmetric/thread/mpscqueue.h>
 #include <fnordmetric/thread/taskscheduler.h>
 #include <fnordmetric/util/buffer.h>
-#include <functional>
 
 namespace fnord {
 namespace net {
 
+/**
+ * Receives datagrams and passes them to the message callback.
+ *
+ * Received datagrams are put into num_queues bounded MPSCQueues (round
+ * robin) of queue_size datagrams each. Every queue is drained by at most one
+ * task on the callback scheduler at a time, which handles up to
+ * kMaxDrainBatch datagrams before it yields, so the number of outstanding
+ * callback tasks (and threads) is bounded by num_queues and the memory used
+ * for buffered datagrams by num_queues * queue_size datagrams.
+ *
+ * If all queues are full, the overflow policy decides what happens:
+ *
+ *   DROP_NEWEST  the datagram is dropped and counted in udp.datagrams_dropped
+ *   PAUSE        receiving is paused until a queue was drained, so further
+ *                datagrams queue up in (and are dropped by) the kernel's
+ *                receive buffer. Counted in udp.receive_paused
+ *
+ * A datagram whose callback throws is counted in udp.callback_errors and
+ * the queue is drained as usual.
+ */
 class UDPServer {
 public:
+  static const size_t kDefaultQueueSize = 8192;
+  static const size_t kMaxReceiveBatch = 256;
+  static const size_t kMaxDrainBatch = 256;
+
+  enum kOverflowPolicy {
+    DROP_NEWEST,
+    PAUSE
+  };
+
   UDPServer(
       thread::TaskScheduler* server_scheduler,
-      thread::TaskScheduler* callback_scheduler);
+      thread::TaskScheduler* callback_scheduler,
+      size_t queue_size = kDefaultQueueSize,
+      size_t num_queues = 1,
+      kOverflowPolicy overflow_policy = DROP_NEWEST);
 
   ~UDPServer();
 
@@ -28,15 +66,50 @@ public:
   void listen(int port);
 
 protected:
+  typedef std::unique_ptr<util::Buffer> MessageType;
+
+  struct Queue {
+    Queue(size_t size) : messages(size), drain_scheduled(false) {}
+    thread::MPSCQueue<MessageType> messages;
+    std::atomic<bool> drain_scheduled;
+  };
+
   void messageReceived();
 
+  /**
+   * Push the message into the next queue that is not full. Returns false if
+   * all queues are full
+   */
+  bool enqueue(MessageType* message);
+
+  /**
+   * Called when all queues are full and the overflow policy is PAUSE.
+   * Returns false if a queue was drained in the meantime and receiving
+   * should continue
+   */
+  bool pause();
+
+  void scheduleDrain(Queue* queue);
+  void drain(Queue* queue);
+
   thread::TaskScheduler* server_scheduler_;
   thread::TaskScheduler* callback_scheduler_;
   int ssock_;
   std::function<void (const fnord::util::Buffer&)> callback_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+  size_t next_queue_;
+  kOverflowPolicy overflow_policy_;
+  MessageType pending_message_;
+  std::atomic<bool> paused_;
+  stats::Counter* datagrams_received_;
+  stats::Counter* bytes_received_;
+  stats::Counter* receive_errors_;
+  stats::Counter* datagrams_dropped_;
+  stats::Counter* receive_paused_;
+  stats::Counter* callback_errors_;
+  stats::Gauge* queued_datagrams_;
 };
 
-
 }
 }
 #endif
@@ -0,0 +1,58 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2011-2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_QUERY_JSONROWSINK_H
+#define _FNORDMETRIC_QUERY_JSONROWSINK_H
+#include <stdlib.h>
+#include <fnordmetric/sql/runtime/rowsink.h>
+#include <fnordmetric/sql/svalue.h>
+#include <fnordmetric/util/jsonoutputstream.h>
+
+namespace fnordmetric {
+namespace query {
+
+/**
+ * Writes each row as a JSON array of strings to the output stream as soon as
+ * it is produced, separated by commas. The enclosing array is not written.
+ */
+class JSONRowSink : public RowSink {
+public:
+
+  JSONRowSink(util::JSONOutputStream* json) : json_(json), num_rows_(0) {}
+
+  bool nextRow(SValue* row, int row_len) override {
+    if (num_rows_++ > 0) {
+      json_->addComma();
+    }
+
+    json_->beginArray();
+    for (int i = 0; i < row_len; ++i) {
+      if (i > 0) {
+        json_->addComma();
+      }
+
+      json_->addString(row[i].toString());
+    }
+    json_->endArray();
+
+    return true;
+  }
+
+  size_t getNumRows() const {
+    return num_rows_;
+  }
+
+protected:
+  util::JSONOutputStream* json_;
+  size_t num_rows_;
+};
+
+}
+}
+#endif
@@ -41,9 +41,10 @@ Query::Query(
     Runtime* runtime,
     std::unique_ptr<TableRepository> table_repo) :
     runtime_(runtime),
+    context_(nullptr),
     table_repo_(std::move(table_repo)),
     query_plan_(table_repo_.get()) {
-  auto statements = runtime->parser()->parseQuery(query_string);
+  auto statements = runtime->parseQuery(query_string);
   draw_statements_.emplace_back();
 
   for (const auto& stmt : statements) {
@@ -60,6 +61,14 @@ Query::Query(
             draw_statements_.back().empty() ?
                 nullptr : draw_statements_.back().back().get());
         break;
+      /* the plan of an EXPLAIN statement is never drawn */
+      case query::ASTNode::T_EXPLAIN:
+        statements_.emplace_back(
+            std::unique_ptr<QueryPlanNode>(
+                runtime_->queryPlanBuilder()->buildQueryPlan(
+                    stmt.get(), table_repo_.get())),
+            nullptr);
+        break;
       case query::ASTNode::T_IMPORT:
         table_repo_->import(
             ImportStatement(stmt.get(), runtime_->compiler()),
@@ -71,20 +80,74 @@ Query::Query(
   }
 }
 
-void Query::execute() {
+void Query::setContext(QueryContext* context) {
+  context_ = context;
+
   for (const auto& stmt : statements_) {
-    auto target = new ResultList();
-    target->addHeader(stmt.first->getColumns());
-    results_.emplace_back(target);
+    stmt.first->setContext(context);
+  }
+}
+
+void Query::execute() {
+  addResultLists();
+
+  for (int i = 0; i < statements_.size(); ++i) {
+    const auto& stmt = statements_[i];
+
+    if (stmt.second == nullptr) {
+      stmt.first->setTarget(results_[i].get());
+      stmt.first->execute();
+    }
+  }
+
+  executeCharts();
+}
+
+void Query::executeStreaming(
+    std::function<RowSink* (size_t index)> begin_rows,
+    std::function<void (size_t index)> end_rows) {
+  addResultLists();
+  executeCharts();
+
+  for (int i = 0; i < statements_.size(); ++i) {
+    const auto& stmt = statements_[i];
+    auto target = begin_rows(i);
 
     if (stmt.second == nullptr) {
       stmt.first->setTarget(target);
       stmt.first->execute();
     } else {
+      const auto& result_list = results_[i];
+      std::vector<SValue> row;
+
+      for (int j = 0; j < result_list->getNumRows(); ++j) {
+        row.clear();
+        for (const auto& value : result_list->getRow(j)) {
+          row.emplace_back(value);
+        }
+
+        target->nextRow(row.data(), row.size());
+      }
+    }
+
+    end_rows(i);
+  }
+}
+
+void Query::addResultLists() {
+  for (const auto& stmt : statements_) {
+    auto target = new ResultList();
+    target->addHeader(stmt.first->getColumns());
+    target->setContext(context_);
+    results_.emplace_back(target);
+
+    if (stmt.second != nullptr) {
       stmt.second->addSelectStatement(stmt.first.get(), target);
     }
   }
+}
 
+void Query::executeCharts() {
   for (const auto& draw_group : draw_statements_) {
     if (draw_group.size() == 0) {
       continue;
@@ -11,6 +11,7 @@
 #ifndef _FNORDMETRIC_QUERY_H
 #define _FNORDMETRIC_QUERY_H
 #include <stdlib.h>
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
@@ -25,6 +26,7 @@ class TableRepository;
 class DrawStatement;
 class ASTNode;
 class ResultList;
+class RowSink;
 
 class Query {
 public:
@@ -45,11 +47,34 @@ public:
   Query& operator=(const Query& copy) = delete;
   Query(Query&& move);
 
+  /**
+   * Bound the execution of all statements of this query by the provided
+   * context. Must be called before the query is executed. Does not transfer
+   * ownership
+   */
+  void setContext(QueryContext* context);
+
   /**
    * Execute the query. This may raise an exception.
    */
   void execute();
 
+  /**
+   * Execute the query, but don't buffer the rows of select statements that are
+   * not part of a chart in their result lists. This may raise an exception.
+   *
+   * All charts are executed first. Then, for each result list in statement
+   * order, begin_rows(index) is called, the rows of the result list are
+   * written into the returned sink and end_rows(index) is called. The rows of
+   * result lists that belong to a chart are replayed from their buffer.
+   *
+   * The result lists of streamed select statements only contain the column
+   * headers once the query was executed.
+   */
+  void executeStreaming(
+      std::function<RowSink* (size_t index)> begin_rows,
+      std::function<void (size_t index)> end_rows);
+
   /**
    * Get the number of result lists
    */
@@ -83,7 +108,11 @@ public:
   ui::Canvas* getChart(size_t index) const;
 
 protected:
+  void addResultLists();
+  void executeCharts();
+
   Runtime* runtime_;
+  QueryContext* context_;
   std::unique_ptr<TableRepository> table_repo_;
   QueryPlan query_plan_;
 
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <fnordmetric/environment.h>
 #include <fnordmetric/query/query.h>
 #include <fnordmetric/query/queryservice.h>
 #include <fnordmetric/sql/backends/csv/csvbackend.h>
@@ -18,6 +19,7 @@
 #include <fnordmetric/sql/parser/token.h>
 #include <fnordmetric/sql/parser/tokenize.h>
 #include <fnordmetric/sql/runtime/defaultruntime.h>
+#include <fnordmetric/sql/runtime/querycontext.h>
 #include <fnordmetric/sql/runtime/queryplannode.h>
 #include <fnordmetric/sql/runtime/resultlist.h>
 #include <fnordmetric/sql/runtime/tablescan.h>
@@ -66,6 +68,33 @@ class TestTableRef : public TableRef {
   }
 };
 
+/* returns num_rows rows or rows until the scan is aborted if num_rows is -1 */
+class LargeTestTableRef : public TestTableRef {
+public:
+  LargeTestTableRef(int64_t num_rows) : num_rows_(num_rows) {}
+  void executeScan(TableScan* scan) override {
+    for (int64_t i = 0; num_rows_ < 0 || i < num_rows_; ++i) {
+      std::vector<SValue> row;
+      row.emplace_back(SValue((int64_t) i));
+      row.emplace_back(SValue((int64_t) (i * 2)));
+      row.emplace_back(SValue("a string value that is buffered"));
+      if (!scan->nextRow(row.data(), row.size())) {
+        return;
+      }
+    }
+  }
+protected:
+  int64_t num_rows_;
+};
+
+static std::unique_ptr<TableRepository> largeTestTable(int64_t num_rows) {
+  std::unique_ptr<TableRepository> table_repo(new TableRepository());
+  table_repo->addTableRef(
+      "testtable",
+      std::unique_ptr<TableRef>(new LargeTestTableRef(num_rows)));
+  return table_repo;
+}
+
 class TestBackend : public Backend {
 public:
 
@@ -318,3 +347,223 @@ TEST_CASE(QueryTest, TestFourSelectFromCSVQuery, [] () {
 });
 
 
+TEST_CASE(QueryTest, TestStreamingFourSelectFromCSVQuery, [] () {
+  std::string query_str;
+  auto query_stream = fnordmetric::util::FileInputStream::openFile(
+      "test/fixtures/queries/gdpfourselects.sql");
+  query_stream->readUntilEOF(&query_str);
+
+  DefaultRuntime runtime;
+  runtime.addBackend(std::unique_ptr<Backend>(new csv_backend::CSVBackend()));
+  auto query = Query(query_str, &runtime);
+
+  std::vector<std::unique_ptr<ResultList>> streamed;
+  int num_ended = 0;
+  query.executeStreaming(
+      [&streamed] (size_t index) -> RowSink* {
+        EXPECT(index == streamed.size());
+        streamed.emplace_back(new ResultList());
+        return streamed.back().get();
+      },
+      [&num_ended] (size_t index) {
+        EXPECT(index == num_ended++);
+      });
+
+  EXPECT(streamed.size() == 4);
+  EXPECT(num_ended == 4);
+
+  for (int i = 0; i < streamed.size(); i++) {
+    auto results = streamed[i].get();
+    EXPECT(results->getNumRows() == 10);
+    EXPECT(results->getRow(0)[1] == "USA")
+    EXPECT(results->getRow(9)[1] == "IND")
+
+    /* streamed rows are not buffered in the query's result lists */
+    EXPECT(query.getResultList(i)->getNumRows() == 0);
+    EXPECT(query.getResultList(i)->getColumns().size() == 4);
+  }
+});
+
+TEST_CASE(QueryTest, TestQueryServiceStreamingJSON, [] () {
+  QueryService query_service;
+  query_service.registerBackend(
+      std::unique_ptr<fnordmetric::query::Backend>(
+          new fnordmetric::query::csv_backend::CSVBackend));
+
+  std::string output;
+  query_service.executeQuery(
+      fnordmetric::util::StringInputStream::fromString(
+          "  IMPORT TABLE gbp_per_country "
+          "     FROM 'csv:test/fixtures/gbp_per_country_simple.csv?headers=true';"
+          "  SELECT country, gbp FROM gbp_per_country LIMIT 2;"),
+      QueryService::FORMAT_JSON,
+      fnordmetric::util::StringOutputStream::fromString(&output));
+
+  std::string prefix = "{\"tables\": [{\"columns\": [\"country\",\"gbp\"],";
+  EXPECT_EQ(output.substr(0, prefix.size()), prefix);
+
+  std::string suffix = "]}],\"status\": \"success\"}";
+  EXPECT_EQ(output.substr(output.size() - suffix.size()), suffix);
+});
+
+TEST_CASE(QueryTest, TestQueryServiceStreamingJSONError, [] () {
+  QueryService query_service;
+  query_service.registerBackend(
+      std::unique_ptr<fnordmetric::query::Backend>(
+          new fnordmetric::query::csv_backend::CSVBackend));
+
+  std::string output;
+  query_service.executeQuery(
+      fnordmetric::util::StringInputStream::fromString(
+          "  IMPORT TABLE gbp_per_country "
+          "     FROM 'csv:test/fixtures/gbp_per_country_simple.csv?headers=true';"
+          "  SELECT country FROM gbp_per_country LIMIT 2;"
+          "  SELECT country - 1 FROM gbp_per_country;"),
+      QueryService::FORMAT_JSON,
+      fnordmetric::util::StringOutputStream::fromString(&output));
+
+  std::string prefix = "{\"tables\": [{\"columns\": [\"country\"],";
+  EXPECT_EQ(output.substr(0, prefix.size()), prefix);
+  EXPECT(output.find("]}],\"status\": \"error\"") != std::string::npos);
+});
+
+TEST_CASE(QueryTest, TestQueryServiceStreamingJSONChartError, [] () {
+  QueryService query_service;
+  query_service.registerBackend(
+      std::unique_ptr<fnordmetric::query::Backend>(
+          new fnordmetric::query::csv_backend::CSVBackend));
+
+  auto failed = fnordmetric::env()->stats()->counter("query.queries_failed");
+  auto failed_before = failed->get();
+
+  /* the chart fails to render after all rows were already written */
+  std::string output;
+  query_service.executeQuery(
+      fnordmetric::util::StringInputStream::fromString(
+          "  IMPORT TABLE gbp_per_country "
+          "     FROM 'csv:test/fixtures/gbp_per_country_simple.csv?headers=true';"
+          "  DRAW BARCHART YDOMAIN -1, 100 LOGARITHMIC;"
+          "  SELECT 'gbp' AS series, country AS x, gbp AS y"
+          "      FROM gbp_per_country LIMIT 2;"),
+      QueryService::FORMAT_JSON,
+      fnordmetric::util::StringOutputStream::fromString(&output));
+
+  std::string prefix =
+      "{\"tables\": [{\"columns\": [\"series\",\"x\",\"y\"],";
+  EXPECT_EQ(output.substr(0, prefix.size()), prefix);
+
+  std::string suffix =
+      "]}],\"status\": \"error\",\"error\": "
+      "\"negative value is outside of logarithmic domain\"}";
+  EXPECT_EQ(output.substr(output.size() - suffix.size()), suffix);
+  EXPECT_EQ(output.find("charts"), std::string::npos);
+  EXPECT_EQ(failed->get(), failed_before + 1);
+});
+
+TEST_CASE(QueryTest, TestQueryTimeout, [] () {
+  DefaultRuntime runtime;
+  Query query(
+      "SELECT one, two FROM testtable;",
+      &runtime,
+      largeTestTable(-1));
+
+  QueryContext context;
+  context.setTimeout(10000);
+  query.setContext(&context);
+
+  EXPECT_EXCEPTION("query timed out after 10ms", [&query] () {
+    query.execute();
+  });
+});
+
+TEST_CASE(QueryTest, TestQueryCancellation, [] () {
+  DefaultRuntime runtime;
+  Query query(
+      "SELECT one, two FROM testtable ORDER BY one DESC;",
+      &runtime,
+      largeTestTable(-1));
+
+  int num_checks = 0;
+  QueryContext context;
+  context.setCancellationCheck([&num_checks] () -> bool {
+    return ++num_checks > 10;
+  });
+
+  query.setContext(&context);
+
+  EXPECT_EXCEPTION("query was cancelled", [&query] () {
+    query.execute();
+  });
+
+  EXPECT_EQ(num_checks, 11);
+});
+
+TEST_CASE(QueryTest, TestQueryMemoryLimit, [] () {
+  DefaultRuntime runtime;
+  Query query(
+      "SELECT one, three FROM testtable ORDER BY one DESC;",
+      &runtime,
+      largeTestTable(100000));
+
+  QueryContext context;
+  context.setMemoryLimit(1024 * 1024);
+  query.setContext(&context);
+
+  EXPECT_EXCEPTION("query exceeded its memory limit of 1048576 bytes", [&] () {
+    query.execute();
+  });
+
+  /* the same query succeeds without a limit and accounts for its rows */
+  Query unbounded_query(
+      "SELECT one, three FROM testtable ORDER BY one DESC;",
+      &runtime,
+      largeTestTable(100000));
+
+  QueryContext unbounded_context;
+  unbounded_query.setContext(&unbounded_context);
+  unbounded_query.execute();
+
+  EXPECT(unbounded_query.getResultList(0)->getNumRows() == 100000);
+  EXPECT(unbounded_context.peakMemoryUsed() > 1024 * 1024);
+});
+
+TEST_CASE(QueryTest, TestExplain, [] () {
+  DefaultRuntime runtime;
+  Query query(
+      "EXPLAIN SELECT one, two FROM testtable ORDER BY one DESC LIMIT 10;",
+      &runtime,
+      largeTestTable(1000));
+
+  query.execute();
+  auto results = query.getResultList(0);
+  EXPECT_EQ(results->getColumns().size(), 3);
+  EXPECT_EQ(results->getNumRows(), 3);
+  EXPECT_EQ(results->getRow(0)[0], "0");
+  EXPECT_EQ(results->getRow(0)[2], "Limit(limit=10, offset=0)");
+  EXPECT_EQ(results->getRow(1)[1], "0");
+  EXPECT_EQ(results->getRow(1)[2], "  OrderBy(one DESC)");
+  EXPECT_EQ(results->getRow(2)[1], "1");
+  EXPECT_EQ(
+      results->getRow(2)[2],
+      "    TableScan(table=testtable, where=no, time_range_begin=0)");
+});
+
+TEST_CASE(QueryTest, TestExplainAnalyze, [] () {
+  DefaultRuntime runtime;
+  Query query(
+      "EXPLAIN ANALYZE SELECT one FROM testtable WHERE one > 99 LIMIT 10;",
+      &runtime,
+      largeTestTable(1000));
+
+  query.execute();
+  auto results = query.getResultList(0);
+  EXPECT_EQ(results->getColumns().size(), 10);
+  EXPECT_EQ(results->getColumns()[4], "rows_out");
+  EXPECT_EQ(results->getNumRows(), 2);
+
+  /* the limit clause stops the scan at the 11th matching row */
+  EXPECT_EQ(results->getRow(0)[3], "11");
+  EXPECT_EQ(results->getRow(0)[4], "10");
+  EXPECT_EQ(results->getRow(1)[3], "111");
+  EXPECT_EQ(results->getRow(1)[4], "11");
+});
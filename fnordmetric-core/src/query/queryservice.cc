@@ -8,19 +8,33 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <fnordmetric/environment.h>
+#include <fnordmetric/query/jsonrowsink.h>
 #include <fnordmetric/query/query.h>
 #include <fnordmetric/query/queryservice.h>
 #include <fnordmetric/sql/runtime/queryplannode.h>
 #include <fnordmetric/sql/runtime/resultlist.h>
 #include <fnordmetric/sql/runtime/tablerepository.h>
+#include <fnordmetric/stats/allocationscope.h>
 #include <fnordmetric/ui/svgtarget.h>
 #include <fnordmetric/util/inputstream.h>
 #include <fnordmetric/util/jsonoutputstream.h>
+#include <fnordmetric/util/wallclock.h>
 
 namespace fnordmetric {
 namespace query {
 
-QueryService::QueryService() {}
+QueryService::QueryService() :
+    queries_(env()->stats()->counter("query.queries")),
+    queries_failed_(env()->stats()->counter("query.queries_failed")),
+    query_micros_(env()->stats()->histogram("query.latency_micros")) {}
+
+void QueryService::setScheduler(fnord::thread::TaskScheduler* scheduler) {
+  runtime_.queryPlanBuilder()->setScheduler(scheduler);
+}
+
+void QueryService::setWindowCache(WindowCache* window_cache) {
+  runtime_.queryPlanBuilder()->setWindowCache(window_cache);
+}
 
 void QueryService::executeQuery(
     std::shared_ptr<util::InputStream> input_stream,
@@ -40,7 +54,11 @@ void QueryService::executeQuery(
     std::shared_ptr<util::OutputStream> output_stream,
     std::unique_ptr<TableRepository> table_repo,
     int width /* = -1 */,
-    int height /* = -1 */) {
+    int height /* = -1 */,
+    QueryContext* context /* = nullptr */) {
+  fnord::stats::AllocationScope allocation_scope(
+      fnord::stats::AllocationStats::SUBSYSTEM_QUERY);
+
   std::string query_string;
   input_stream->readUntilEOF(&query_string);
 
@@ -51,12 +69,19 @@ void QueryService::executeQuery(
         query_string.c_str());
   }
 
+  queries_->incr();
+  auto query_start = fnord::util::WallClock::unixMicros();
+  bool failed = false;
+
   try {
     Query query(query_string, &runtime_, std::move(table_repo));
-    query.execute();
+    if (context != nullptr) {
+      query.setContext(context);
+    }
 
     switch (output_format) {
       case FORMAT_SVG: {
+        query.execute();
         ui::SVGTarget target(output_stream.get());
         renderCharts(&query, &target, width, height);
         break;
@@ -64,11 +89,12 @@ void QueryService::executeQuery(
 
       case FORMAT_JSON: {
         util::JSONOutputStream target(output_stream);
-        renderJSON(&query, &target, width, height);
+        failed = !renderJSON(&query, &target, width, height);
         break;
       }
 
       case FORMAT_TABLE: {
+        query.execute();
         renderTables(&query, output_stream.get());
         break;
       }
@@ -78,9 +104,53 @@ void QueryService::executeQuery(
 
     }
   } catch (util::RuntimeException e) {
+    queries_failed_->incr();
+    query_micros_->insert(fnord::util::WallClock::unixMicros() - query_start);
     e.appendMessage(" while executing query: %s", query_string.c_str());
     throw e;
   }
+
+  /* errors of streamed JSON queries are reported in the output */
+  if (failed) {
+    queries_failed_->incr();
+  }
+
+  query_micros_->insert(fnord::util::WallClock::unixMicros() - query_start);
+}
+
+void QueryService::executeQuery(
+    const std::string& query_string,
+    std::unique_ptr<TableRepository> table_repo,
+    std::function<RowSink* (
+        size_t index,
+        const std::vector<std::string>& columns)> begin_rows,
+    std::function<void (size_t index)> end_rows,
+    QueryContext* context /* = nullptr */) {
+  fnord::stats::AllocationScope allocation_scope(
+      fnord::stats::AllocationStats::SUBSYSTEM_QUERY);
+
+  queries_->incr();
+  auto query_start = fnord::util::WallClock::unixMicros();
+
+  try {
+    Query query(query_string, &runtime_, std::move(table_repo));
+    if (context != nullptr) {
+      query.setContext(context);
+    }
+
+    query.executeStreaming(
+        [&query, &begin_rows] (size_t index) -> RowSink* {
+          return begin_rows(index, query.getResultList(index)->getColumns());
+        },
+        end_rows);
+  } catch (util::RuntimeException e) {
+    queries_failed_->incr();
+    query_micros_->insert(fnord::util::WallClock::unixMicros() - query_start);
+    e.appendMessage(" while executing query: %s", query_string.c_str());
+    throw e;
+  }
+
+  query_micros_->insert(fnord::util::WallClock::unixMicros() - query_start);
 }
 
 void QueryService::registerBackend(std::unique_ptr<Backend>&& backend) {
@@ -99,67 +169,66 @@ void QueryService::renderCharts(
   }
 }
 
-void QueryService::renderJSON(
+bool QueryService::renderJSON(
     Query* query,
     util::JSONOutputStream* target,
     int width,
     int height) const {
-  target->beginObject();
-
-  if (query->getNumResultLists() > 0) {
-    target->addObjectEntry("tables");
-    target->beginArray();
-    for (int i = 0; i < query->getNumResultLists(); ++i) {
-      const auto result_list = query->getResultList(i);
-      target->beginObject();
-
-      target->addObjectEntry("columns");
-      target->beginArray();
+  std::unique_ptr<JSONRowSink> rows;
+  bool tables_open = false;
+  bool rows_open = false;
+  std::string error;
 
-      auto columns = result_list->getColumns();
-      for (int i = 0; i < columns.size(); ++i) {
-        if (i > 0) {
-          target->addComma();
-        }
-        target->addString(columns[i]);
-      }
-      target->endArray();
-      target->addComma();
-
-      target->addObjectEntry("rows");
-      target->beginArray();
-      for (int j = 0; j < result_list->getNumRows(); ++j) {
-        const auto& row = result_list->getRow(j);
+  target->beginObject();
 
-        target->beginArray();
-        for (int i = 0; i < row.size(); ++i) {
-          if (i > 0) {
+  /* rows are written to the output while the query is executing, so once the
+     execution has started errors can only be reported in the status field */
+  try {
+    query->executeStreaming(
+        [&] (size_t index) -> RowSink* {
+          if (index == 0) {
+            target->addObjectEntry("tables");
+            target->beginArray();
+            tables_open = true;
+          } else {
             target->addComma();
           }
 
-          target->addString(row[i]);
-        }
-        target->endArray();
+          target->beginObject();
+          target->addObjectEntry("columns");
+          target->beginArray();
 
-        if (j < result_list->getNumRows() - 1) {
+          const auto& columns = query->getResultList(index)->getColumns();
+          for (int i = 0; i < columns.size(); ++i) {
+            if (i > 0) {
+              target->addComma();
+            }
+            target->addString(columns[i]);
+          }
+          target->endArray();
           target->addComma();
-        }
-      }
-      target->endArray();
-      target->endObject();
 
-      if (i < query->getNumResultLists() - 1) {
-        target->addComma();
-      }
-    }
-    target->endArray();
-    target->addComma();
-  }
+          target->addObjectEntry("rows");
+          target->beginArray();
+          rows.reset(new JSONRowSink(target));
+          rows_open = true;
+          return rows.get();
+        },
+        [&] (size_t index) {
+          target->endArray();
+          target->endObject();
+          rows_open = false;
+        });
 
-  if (query->getNumCharts() > 0) {
-    target->addObjectEntry("charts");
-    target->beginArray();
+    if (tables_open) {
+      target->endArray();
+      target->addComma();
+      tables_open = false;
+    }
 
+    /* render all charts before writing any of them so that a failing chart
+       doesn't leave an unterminated array in the output */
+    std::vector<std::string> charts;
     for (int i = 0; i < query->getNumCharts(); ++i) {
       std::string svg_data;
       auto string_stream = util::StringOutputStream::fromString(&svg_data);
@@ -167,25 +236,69 @@ void QueryService::renderJSON(
       auto chart = query->getChart(i);
       chart->setDimensions(width, height);
       chart->render(&svg_target);
+      charts.emplace_back(std::move(svg_data));
+    }
 
-      target->beginObject();
-      target->addObjectEntry("svg");
-      target->addString(svg_data);
-      target->endObject();
+    if (charts.size() > 0) {
+      target->addObjectEntry("charts");
+      target->beginArray();
 
-      if (i < query->getNumCharts() - 1) {
-        target->addComma();
+      for (int i = 0; i < charts.size(); ++i) {
+        if (i > 0) {
+          target->addComma();
+        }
+
+        target->beginObject();
+        target->addObjectEntry("svg");
+        target->addString(charts[i]);
+        target->endObject();
       }
+
+      target->endArray();
+      target->addComma();
     }
 
-    target->endArray();
-    target->addComma();
+    target->addObjectEntry("status");
+    target->addString("success");
+    target->endObject();
+    return true;
+  } catch (const util::RuntimeException& e) {
+    error = e.getMessage();
+  } catch (const std::exception& e) {
+    error = e.what();
   }
 
-  target->addObjectEntry("status");
-  target->addString("success");
+  /* if the output stream itself failed there is nobody left to report to */
+  try {
+    if (rows_open) {
+      target->endArray();
+      target->endObject();
+    }
+
+    if (tables_open) {
+      target->endArray();
+      target->addComma();
+    }
+
+    target->addObjectEntry("status");
+    target->addString("error");
+    target->addComma();
+    target->addObjectEntry("error");
+    target->addString(error);
+    target->endObject();
+  } catch (const util::RuntimeException& e) {
+    env()->logger()->printf(
+        "WARNING",
+        "can't write query error to the output: %s",
+        e.getMessage().c_str());
+  } catch (const std::exception& e) {
+    env()->logger()->printf(
+        "WARNING",
+        "can't write query error to the output: %s",
+        e.what());
+  }
 
-  target->endObject();
+  return false;
 }
 
 void QueryService::renderTables(Query* query, util::OutputStream* out) const {
@@ -9,8 +9,14 @@
  */
 #ifndef _FNORDMETRIC_QUERYSERVICE_H
 #define _FNORDMETRIC_QUERYSERVICE_H
+#include <functional>
+#include <string>
+#include <vector>
 #include <fnordmetric/query/query.h>
 #include <fnordmetric/sql/runtime/defaultruntime.h>
+#include <fnordmetric/sql/runtime/windowcache.h>
+#include <fnordmetric/stats/counter.h>
+#include <fnordmetric/stats/histogram.h>
 
 namespace fnordmetric {
 namespace ui {
@@ -25,8 +31,11 @@ namespace util {
 namespace query {
 
 /**
- * The query service is the default entry point for executing all queries. A
- * QueryService instance should only be used from one thread at the same time.
+ * The query service is the default entry point for executing all queries. Once
+ * all backends are registered, a QueryService instance may be used from many
+ * threads concurrently. Parsed queries are cached in the runtime's query
+ * cache, so a long lived instance should be preferred over creating a new
+ * instance per query.
  */
 class QueryService {
 public:
@@ -55,11 +64,15 @@ public:
       std::shared_ptr<util::OutputStream> output_stream);
 
   /**
-   * Execute a query. This may raise an exception.
+   * Execute a query. This may raise an exception. With FORMAT_JSON it only
+   * raises before anything was written to the output stream; later errors
+   * are reported in the "status" field of the output (see renderJSON).
    *
    * @param input_stream The input stream to read the SQL query
    * @param output_format The output format
    * @param output_stream The output stream to write the results
+   * @param context The context that bounds the query's execution time and
+   *   memory usage or nullptr for no limits
    */
   void executeQuery(
       std::shared_ptr<util::InputStream> input_stream,
@@ -67,13 +80,42 @@ public:
       std::shared_ptr<util::OutputStream> output_stream,
       std::unique_ptr<TableRepository> table_repo,
       int width = -1,
-      int height = -1);
+      int height = -1,
+      QueryContext* context = nullptr);
+
+  /**
+   * Execute a query and write the rows of every result list into a sink
+   * while they are produced. For each result list, begin_rows is called with
+   * the result list index and column names and returns the sink for its rows,
+   * then end_rows is called once all rows were written. This may raise an
+   * exception.
+   */
+  void executeQuery(
+      const std::string& query_string,
+      std::unique_ptr<TableRepository> table_repo,
+      std::function<RowSink* (
+          size_t index,
+          const std::vector<std::string>& columns)> begin_rows,
+      std::function<void (size_t index)> end_rows,
+      QueryContext* context = nullptr);
 
   /**
    * Register a query backend
    */
   void registerBackend(std::unique_ptr<Backend>&& backend);
 
+  /**
+   * Set the scheduler on which partitioned table scans are executed in
+   * parallel. By default all queries are executed on the calling thread.
+   */
+  void setScheduler(fnord::thread::TaskScheduler* scheduler);
+
+  /**
+   * Set the cache from which closed GROUP OVER TIMEWINDOW windows are served.
+   * By default all windows are recomputed for every query.
+   */
+  void setWindowCache(WindowCache* window_cache);
+
 protected:
 
   void renderCharts(
@@ -82,7 +124,14 @@ protected:
       int width,
       int height) const;
 
-  void renderJSON(
+  /**
+   * Execute the query and write the result rows to the target while they are
+   * produced instead of buffering the full result. Errors that occur during
+   * the execution or while rendering the charts are reported in the "status"
+   * and "error" fields of the response object instead of being raised.
+   * Returns false if the query failed
+   */
+  bool renderJSON(
       Query* query,
       util::JSONOutputStream* target,
       int width,
@@ -91,6 +140,9 @@ protected:
   void renderTables(Query* query, util::OutputStream* out) const;
 
   DefaultRuntime runtime_;
+  fnord::stats::Counter* queries_;
+  fnord::stats::Counter* queries_failed_;
+  fnord::stats::Histogram* query_micros_;
 };
 
 }
@@ -17,11 +17,18 @@
 #include <fnordmetric/http/httpserver.h>
 #include <fnordmetric/io/fileutil.h>
 #include <fnordmetric/metricdb/adminui.h>
+#include <fnordmetric/metricdb/debughandler.h>
+#include <fnordmetric/metricdb/executorstatshandler.h>
 #include <fnordmetric/metricdb/httpapi.h>
+#include <fnordmetric/metricdb/lineprotocolserver.h>
+#include <fnordmetric/metricdb/messagepackserver.h>
 #include <fnordmetric/metricdb/metricrepository.h>
 #include <fnordmetric/metricdb/backends/disk/metricrepository.h>
 #include <fnordmetric/metricdb/backends/inmemory/metricrepository.h>
 #include <fnordmetric/metricdb/statsd.h>
+#include <fnordmetric/metricdb/statsdaggregator.h>
+#include <fnordmetric/metricdb/statshandler.h>
+#include <fnordmetric/metricdb/statsrecorder.h>
 #include <fnordmetric/net/udpserver.h>
 #include <fnordmetric/util/exceptionhandler.h>
 #include <fnordmetric/util/inputstream.h>
@@ -29,6 +36,7 @@
 #include <fnordmetric/util/random.h>
 #include <fnordmetric/util/runtimeexception.h>
 #include <fnordmetric/util/signalhandler.h>
+#include <fnordmetric/thread/admissioncontroller.h>
 #include <fnordmetric/thread/threadpool.h>
 
 using namespace fnordmetric;
@@ -38,8 +46,63 @@ static const char kCrashErrorMsg[] =
     "FnordMetric crashed :( -- Please report a bug at "
     "github.com/paulasmuth/fnordmetric";
 
+using fnord::thread::AdmissionController;
 using fnord::thread::Task;
 using fnord::thread::TaskScheduler;
+using fnord::thread::ThreadPool;
+
+/**
+ * Parses a list of CPUs like "0-3,6"
+ */
+static std::vector<int> parseCPUList(const std::string& str) {
+  std::vector<int> cpus;
+  size_t begin = 0;
+
+  while (begin < str.size()) {
+    auto end = str.find(',', begin);
+    if (end == std::string::npos) {
+      end = str.size();
+    }
+
+    auto range = str.substr(begin, end - begin);
+    auto dash = range.find('-');
+    auto first = range.substr(0, dash);
+    auto last = dash == std::string::npos ? first : range.substr(dash + 1);
+
+    if (first.empty() || last.empty() ||
+        first.find_first_not_of("0123456789") != std::string::npos ||
+        last.find_first_not_of("0123456789") != std::string::npos ||
+        std::stoi(first) > std::stoi(last)) {
+      RAISE(kUsageError, "invalid CPU list: %s", str.c_str());
+    }
+
+    for (int cpu = std::stoi(first); cpu <= std::stoi(last); ++cpu) {
+      cpus.emplace_back(cpu);
+    }
+
+    begin = end + 1;
+  }
+
+  return cpus;
+}
+
+static void configureExecutor(ThreadPool* executor, const char* cpus_flag) {
+  if (env()->flags()->isSet(cpus_flag)) {
+    executor->setCPUAffinity(
+        parseCPUList(env()->flags()->getString(cpus_flag)));
+  }
+
+  env()->stats()->gauge("executor." + executor->name() + ".queue_depth")
+      ->setCallback([executor] () -> int64_t {
+        return executor->getStats().queue_depth;
+      });
+
+  env()->logger()->printf(
+      "INFO",
+      "Started %s executor with %zu threads",
+      executor->name().c_str(),
+      executor->numThreads());
+}
 
 static IMetricRepository* openBackend(
     const std::string& backend_type,
@@ -66,7 +129,22 @@ static IMetricRepository* openBackend(
         "Opening disk backend at %s",
         datadir.c_str());
 
-    return new disk_backend::MetricRepository(datadir, backend_scheduler);
+    std::string cold_datadir;
+    if (env()->flags()->isSet("cold_datadir")) {
+      cold_datadir = env()->flags()->getString("cold_datadir");
+      env()->logger()->printf(
+          "INFO",
+          "Moving old tables to cold datadir at %s",
+          cold_datadir.c_str());
+    }
+
+    return new disk_backend::MetricRepository(
+        datadir,
+        backend_scheduler,
+        env()->flags()->getInt("reorder_window") * 1000000llu,
+        env()->flags()->getInt("segment_size") << 20,
+        cold_datadir,
+        env()->flags()->getInt("cold_after") * 1000000llu);
   }
 
   RAISE(
@@ -76,14 +154,35 @@ static IMetricRepository* openBackend(
 }
 
 static int startServer() {
-  fnord::thread::ThreadPool server_pool(
+  /* receives samples and serves non-query http requests */
+  ThreadPool ingest_pool(
       std::unique_ptr<fnord::util::ExceptionHandler>(
-          new fnord::util::CatchAndAbortExceptionHandler(kCrashErrorMsg)));
+          new fnord::util::CatchAndAbortExceptionHandler(kCrashErrorMsg)),
+      env()->flags()->getInt("ingest_threads"),
+      "ingest");
 
-  fnord::thread::ThreadPool worker_pool(
+  /* executes queries */
+  ThreadPool query_pool(
       std::unique_ptr<fnord::util::ExceptionHandler>(
           new fnord::util::CatchAndPrintExceptionHandler(
-              fnordmetric::env()->logger())));
+              fnordmetric::env()->logger())),
+      env()->flags()->getInt("query_threads"),
+      "query");
+
+  /* runs background work like compactions */
+  ThreadPool maintenance_pool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler(kCrashErrorMsg)),
+      env()->flags()->getInt("maintenance_threads"),
+      "maintenance");
+
+  configureExecutor(&ingest_pool, "ingest_cpus");
+  configureExecutor(&query_pool, "query_cpus");
+  configureExecutor(&maintenance_pool, "maintenance_cpus");
+
+  AdmissionController query_admission(
+      env()->flags()->getInt("max_concurrent_queries"),
+      env()->flags()->getInt("max_queued_queries"));
 
   if (env()->flags()->isSet("datadir")) {
     auto datadir = env()->flags()->getString("datadir");
@@ -109,7 +208,18 @@ static int startServer() {
 
   auto metric_repo = openBackend(
       env()->flags()->getString("storage_backend"),
-      &server_pool);
+      &maintenance_pool);
+
+  /* record the server's own stats into the metric repository */
+  if (env()->flags()->getInt("self_metrics_interval") > 0) {
+    auto stats_recorder = new StatsRecorder(
+        env()->stats(),
+        metric_repo,
+        &maintenance_pool,
+        env()->flags()->getInt("self_metrics_interval") * 1000000);
+
+    stats_recorder->start();
+  }
 
   /* statsd server */
   if (env()->flags()->isSet("statsd_port")) {
@@ -119,11 +229,68 @@ static int startServer() {
         "Starting statsd server on port %i",
         port);
 
-    auto statsd_server =
-        new StatsdServer(metric_repo, &server_pool, &worker_pool);
+    StatsdAggregator* statsd_aggregator = nullptr;
+    auto flush_interval = env()->flags()->getInt("statsd_flush_interval");
+    if (flush_interval > 0) {
+      statsd_aggregator = new StatsdAggregator(
+          metric_repo,
+          &maintenance_pool,
+          flush_interval * 1000000);
+
+      statsd_aggregator->start();
+    }
+
+    auto overflow_policy_str =
+        env()->flags()->getString("udp_overflow_policy");
+    fnord::net::UDPServer::kOverflowPolicy overflow_policy;
+    if (overflow_policy_str == "drop") {
+      overflow_policy = fnord::net::UDPServer::DROP_NEWEST;
+    } else if (overflow_policy_str == "pause") {
+      overflow_policy = fnord::net::UDPServer::PAUSE;
+    } else {
+      RAISE(
+          kUsageError,
+          "invalid --udp_overflow_policy: %s",
+          overflow_policy_str.c_str());
+    }
+
+    auto statsd_server = new StatsdServer(
+        metric_repo,
+        &ingest_pool,
+        &ingest_pool,
+        statsd_aggregator,
+        env()->flags()->getInt("udp_queue_size"),
+        ingest_pool.numThreads(),
+        overflow_policy);
+
     statsd_server->listen(port);
   }
 
+  /* tcp line protocol server */
+  if (env()->flags()->isSet("tcp_port")) {
+    auto port = env()->flags()->getInt("tcp_port");
+    env()->logger()->printf(
+        "INFO",
+        "Starting TCP line protocol server on port %i",
+        port);
+
+    auto line_protocol_server =
+        new LineProtocolServer(metric_repo, &ingest_pool);
+    line_protocol_server->listen(port);
+  }
+
+  /* tcp msgpack server */
+  if (env()->flags()->isSet("msgpack_port")) {
+    auto port = env()->flags()->getInt("msgpack_port");
+    env()->logger()->printf(
+        "INFO",
+        "Starting TCP MessagePack server on port %i",
+        port);
+
+    auto msgpack_server = new MessagePackServer(metric_repo, &ingest_pool);
+    msgpack_server->listen(port);
+  }
+
   /* http server */
   if (env()->flags()->isSet("http_port")) {
     auto port = env()->flags()->getInt("http_port");
@@ -132,13 +299,37 @@ static int startServer() {
         "Starting HTTP server on port %i",
         port);
 
-    auto http_server = new fnord::http::HTTPServer(
-        &server_pool,
-        &worker_pool);
+    auto http_server = new fnord::http::HTTPServer(&ingest_pool);
+    http_server->setMaxBodySize(
+        env()->flags()->getInt("http_max_body_size") * 1024 * 1024);
+    http_server->addRequestScheduler("/query", &query_pool, &query_admission);
+
+    /* sample scans are streamed and may block on slow clients */
+    http_server->addRequestScheduler(
+        "/metrics/",
+        fnord::http::HTTPRequest::M_GET,
+        &query_pool,
+        &query_admission);
+
+    auto executor_stats = new ExecutorStatsHandler();
+    executor_stats->addExecutor(&ingest_pool);
+    executor_stats->addExecutor(&query_pool);
+    executor_stats->addExecutor(&maintenance_pool);
+    executor_stats->addAdmissionController("query", &query_admission);
+
+    auto http_api = new HTTPAPI(metric_repo, &query_pool);
+    http_api->setQueryLimits(
+        env()->flags()->getInt("query_timeout") * 1000000,
+        env()->flags()->getInt("query_memory_limit") * 1024 * 1024);
 
     http_server->addHandler(AdminUI::getHandler());
+    http_server->addHandler(std::unique_ptr<http::HTTPHandler>(http_api));
+    http_server->addHandler(
+        std::unique_ptr<http::HTTPHandler>(executor_stats));
+    http_server->addHandler(
+        std::unique_ptr<http::HTTPHandler>(new StatsHandler(env()->stats())));
     http_server->addHandler(
-        std::unique_ptr<http::HTTPHandler>(new HTTPAPI(metric_repo)));
+        std::unique_ptr<http::HTTPHandler>(new DebugHandler()));
     http_server->listen(port);
   }
 
@@ -152,6 +343,7 @@ static void printUsage() {
   env()->flags()->printUsage(err_stream.get());
   err_stream->printf("\nexamples:\n");
   err_stream->printf("    $ fnordmetric-server --http_port 8080 --statsd_port 8125 --datadir /tmp/fnordmetric-data\n");
+  err_stream->printf("    $ fnordmetric-server --http_port 8080 --tcp_port 8126 --datadir /tmp/fnordmetric-data\n");
 }
 
 int main(int argc, const char** argv) {
@@ -179,6 +371,53 @@ int main(int argc, const char** argv) {
       "Start the statsd interface on this port",
       "<port>");
 
+  env()->flags()->defineFlag(
+      "tcp_port",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      NULL,
+      "Start the TCP line protocol interface on this port",
+      "<port>");
+
+  env()->flags()->defineFlag(
+      "msgpack_port",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      NULL,
+      "Start the TCP MessagePack interface on this port",
+      "<port>");
+
+  env()->flags()->defineFlag(
+      "statsd_flush_interval",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "10",
+      "Aggregate typed statsd samples (counters, gauges, timers and sets) "
+      "and write them every this many seconds (0 = write every sample)",
+      "<secs>");
+
+  env()->flags()->defineFlag(
+      "udp_queue_size",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "8192",
+      "Buffer at most this many received datagrams per ingest thread",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "udp_overflow_policy",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      "drop",
+      "What to do with datagrams once the buffer is full: 'drop' them or "
+      "'pause' receiving and let the kernel drop them",
+      "<policy>");
+
   env()->flags()->defineFlag(
       "storage_backend",
       cli::FlagParser::T_STRING,
@@ -197,6 +436,156 @@ int main(int argc, const char** argv) {
       "Store the database in this directory (disk backend only)",
       "<path>");
 
+  env()->flags()->defineFlag(
+      "reorder_window",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "60",
+      "Buffer out of order samples for this many seconds before writing them "
+      "as a sorted run (disk backend only)",
+      "<secs>");
+
+  env()->flags()->defineFlag(
+      "segment_size",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "0",
+      "Store the live tables of low-rate metrics in shared segments of this "
+      "many megabytes. 0 disables segments (disk backend only)",
+      "<mb>");
+
+  env()->flags()->defineFlag(
+      "cold_datadir",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "Move old finalized tables into this directory, compressed (disk "
+      "backend only)",
+      "<path>");
+
+  env()->flags()->defineFlag(
+      "cold_after",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "604800",
+      "Move tables into the cold datadir once their newest sample is this "
+      "many seconds old (disk backend only)",
+      "<secs>");
+
+  env()->flags()->defineFlag(
+      "ingest_threads",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "0",
+      "Number of threads receiving samples (0 = one per core)",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "query_threads",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "0",
+      "Number of threads executing queries (0 = one per core)",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "maintenance_threads",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "1",
+      "Number of threads running compactions (0 = one per core)",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "ingest_cpus",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "Pin the ingest threads to these CPUs, e.g. 0-3,6 (linux only)",
+      "<cpus>");
+
+  env()->flags()->defineFlag(
+      "query_cpus",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "Pin the query threads to these CPUs, e.g. 0-3,6 (linux only)",
+      "<cpus>");
+
+  env()->flags()->defineFlag(
+      "maintenance_cpus",
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "Pin the maintenance threads to these CPUs, e.g. 0-3,6 (linux only)",
+      "<cpus>");
+
+  env()->flags()->defineFlag(
+      "max_concurrent_queries",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "16",
+      "Maximum number of queries executing at the same time",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "max_queued_queries",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "64",
+      "Maximum number of queries waiting to be executed. Further queries "
+      "are rejected with 503",
+      "<num>");
+
+  env()->flags()->defineFlag(
+      "http_max_body_size",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "64",
+      "Reject HTTP requests with a body larger than this many MB with 413",
+      "<mb>");
+
+  env()->flags()->defineFlag(
+      "query_timeout",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "60",
+      "Abort queries that run longer than this many seconds (0 = never)",
+      "<secs>");
+
+  env()->flags()->defineFlag(
+      "query_memory_limit",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "1024",
+      "Abort queries that buffer more than this many MB of rows (0 = never)",
+      "<mb>");
+
+  env()->flags()->defineFlag(
+      "self_metrics_interval",
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "0",
+      "Write the server's own stats into metrics named fnordmetric.* every "
+      "this many seconds (0 = never)",
+      "<secs>");
+
   env()->flags()->defineFlag(
       "disable_external_sources",
       cli::FlagParser::T_SWITCH,
@@ -54,10 +54,6 @@ bool MySQLBackend::openTables(
     target->emplace_back(new MySQLTableRef(conn, tbl));
   }
 
-  connections_mutex_.lock();
-  connections_.push_back(std::move(conn));
-  connections_mutex_.unlock();
-
   return true;
 }
 
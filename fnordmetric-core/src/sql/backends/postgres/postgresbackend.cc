@@ -52,10 +52,6 @@ bool PostgresBackend::openTables(
     target->emplace_back(new PostgresTableRef(conn, tbl));
   }
 
-  connections_mutex_.lock();
-  connections_.push_back(std::move(conn));
-  connections_mutex_.unlock();
-
   return true;
 }
 
@@ -30,10 +30,6 @@ public:
       const std::vector<std::string>& table_names,
       const util::URI& source_uri,
       std::vector<std::unique_ptr<TableRef>>* target) override;
-
-protected:
-  std::vector<std::shared_ptr<PostgresConnection>> connections_;
-  std::mutex connections_mutex_;
 };
 
 }
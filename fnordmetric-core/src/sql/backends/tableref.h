@@ -10,8 +10,11 @@
 #ifndef _FNORDMETRIC_QUERY_TABLEREF_H
 #define _FNORDMETRIC_QUERY_TABLEREF_H
 #include <stdlib.h>
+#include <stdint.h>
+#include <functional>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace fnordmetric {
 namespace query {
@@ -24,6 +27,40 @@ public:
   virtual int getColumnIndex(const std::string& name) = 0;
   virtual std::string getColumnName(int index) = 0;
   virtual void executeScan(TableScan* scan) = 0;
+
+  /**
+   * Split a scan of this table into independent partitions that may be
+   * executed concurrently. Each partition must be executed with its own
+   * TableScan instance. The default implementation returns a single partition
+   */
+  virtual void partitionScan(
+      std::vector<std::function<void (TableScan* scan)>>* partitions) {
+    partitions->emplace_back([this] (TableScan* scan) {
+      executeScan(scan);
+    });
+  }
+
+  /**
+   * Returns the index of the time column if this table is a time series that
+   * is ordered by time and supports time range scans (see
+   * TableScan::setTimeRangeBegin), otherwise -1
+   */
+  virtual int getTimeColumnIndex() {
+    return -1;
+  }
+
+  /**
+   * Time series tables may receive rows that are older than the time at which
+   * they were inserted ("late rows"). Returns the smallest time of all late
+   * rows that were received after the provided late row sequence number or
+   * UINT64_MAX if there were none and stores the current sequence number in
+   * cur_seq. The default implementation never has late rows.
+   */
+  virtual uint64_t getLateRowsMinTime(uint64_t since_seq, uint64_t* cur_seq) {
+    *cur_seq = 0;
+    return UINT64_MAX;
+  }
+
 protected:
 };
 
@@ -10,6 +10,8 @@
 #include <stdlib.h>
 #include <fnordmetric/sql/expressions/aggregate.h>
 #include <fnordmetric/sql/svalue.h>
+#include <fnordmetric/util/hyperloglog.h>
+#include <fnordmetric/util/loghistogram.h>
 
 namespace fnordmetric {
 namespace query {
@@ -20,6 +22,14 @@ void countExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
   *out = SValue((int64_t) ++(*count));
 }
 
+void countExprMerge(void* scratchpad, const void* other) {
+  *((uint64_t*) scratchpad) += *((const uint64_t*) other);
+}
+
+void countExprResult(void* scratchpad, SValue* out) {
+  *out = SValue((int64_t) *((uint64_t*) scratchpad));
+}
+
 void countExprFree(void* scratchpad) {
   /* noop */
 }
@@ -31,14 +41,16 @@ size_t countExprScratchpadSize() {
 /**
  * SUM() expression
  */
-union sum_expr_scratchpad {
+struct sum_expr_scratchpad {
   uint64_t t_integer;
   double t_float;
+  uint8_t has_integer;
+  uint8_t has_float;
 };
 
 void sumExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
   SValue* val = argv;
-  union sum_expr_scratchpad* data = (union sum_expr_scratchpad*) scratchpad;
+  auto data = (struct sum_expr_scratchpad*) scratchpad;
 
   if (argc != 1) {
     RAISE(
@@ -53,14 +65,38 @@ void sumExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
 
     case SValue::T_INTEGER:
       data->t_integer += val->getInteger();
-      *out = SValue((int64_t) data->t_integer);
-      return;
+      data->has_integer = 1;
+      break;
 
     case SValue::T_FLOAT:
     default:
       data->t_float += val->getFloat();
-      *out = SValue(data->t_float);
-      return;
+      data->has_float = 1;
+      break;
+  }
+
+  sumExprResult(scratchpad, out);
+}
+
+void sumExprMerge(void* scratchpad, const void* other) {
+  auto data = (struct sum_expr_scratchpad*) scratchpad;
+  auto other_data = (const struct sum_expr_scratchpad*) other;
+
+  data->t_integer += other_data->t_integer;
+  data->t_float += other_data->t_float;
+  data->has_integer |= other_data->has_integer;
+  data->has_float |= other_data->has_float;
+}
+
+void sumExprResult(void* scratchpad, SValue* out) {
+  auto data = (struct sum_expr_scratchpad*) scratchpad;
+
+  if (data->has_float) {
+    *out = SValue(data->t_float + (int64_t) data->t_integer);
+  } else if (data->has_integer) {
+    *out = SValue((int64_t) data->t_integer);
+  } else {
+    *out = SValue();
   }
 }
 
@@ -69,20 +105,20 @@ void sumExprFree(void* scratchpad) {
 }
 
 size_t sumExprScratchpadSize() {
-  return sizeof(union sum_expr_scratchpad);
+  return sizeof(struct sum_expr_scratchpad);
 }
 
 /**
  * MEAN() expression
  */
-union mean_expr_scratchpad {
+struct mean_expr_scratchpad {
   double sum;
-  int count;
+  uint64_t count;
 };
 
 void meanExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
   SValue* val = argv;
-  union mean_expr_scratchpad* data = (union mean_expr_scratchpad*) scratchpad;
+  auto data = (struct mean_expr_scratchpad*) scratchpad;
 
   if (argc != 1) {
     RAISE(
@@ -103,25 +139,43 @@ void meanExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
   }
 }
 
+void meanExprMerge(void* scratchpad, const void* other) {
+  auto data = (struct mean_expr_scratchpad*) scratchpad;
+  auto other_data = (const struct mean_expr_scratchpad*) other;
+
+  data->sum += other_data->sum;
+  data->count += other_data->count;
+}
+
+void meanExprResult(void* scratchpad, SValue* out) {
+  auto data = (struct mean_expr_scratchpad*) scratchpad;
+
+  if (data->count == 0) {
+    *out = SValue();
+  } else {
+    *out = SValue(data->sum / data->count);
+  }
+}
+
 void meanExprFree(void* scratchpad) {
   /* noop */
 }
 
 size_t meanExprScratchpadSize() {
-  return sizeof(union mean_expr_scratchpad);
+  return sizeof(struct mean_expr_scratchpad);
 }
 
 /**
  * MAX() expression
  */
-union max_expr_scratchpad {
+struct max_expr_scratchpad {
   double max;
   int count;
 };
 
 void maxExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
   SValue* val = argv;
-  union max_expr_scratchpad* data = (union max_expr_scratchpad*) scratchpad;
+  auto data = (struct max_expr_scratchpad*) scratchpad;
 
   if (argc != 1) {
     RAISE(
@@ -147,25 +201,50 @@ void maxExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
   }
 }
 
+void maxExprMerge(void* scratchpad, const void* other) {
+  auto data = (struct max_expr_scratchpad*) scratchpad;
+  auto other_data = (const struct max_expr_scratchpad*) other;
+
+  if (other_data->count == 0) {
+    return;
+  }
+
+  if (data->count == 0 || other_data->max > data->max) {
+    data->max = other_data->max;
+  }
+
+  data->count = 1;
+}
+
+void maxExprResult(void* scratchpad, SValue* out) {
+  auto data = (struct max_expr_scratchpad*) scratchpad;
+
+  if (data->count == 0) {
+    *out = SValue();
+  } else {
+    *out = SValue(data->max);
+  }
+}
+
 void maxExprFree(void* scratchpad) {
   /* noop */
 }
 
 size_t maxExprScratchpadSize() {
-  return sizeof(union max_expr_scratchpad);
+  return sizeof(struct max_expr_scratchpad);
 }
 
 /**
  * MIN() expression
  */
-union min_expr_scratchpad {
+struct min_expr_scratchpad {
   double min;
   int count;
 };
 
 void minExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
   SValue* val = argv;
-  union min_expr_scratchpad* data = (union min_expr_scratchpad*) scratchpad;
+  auto data = (struct min_expr_scratchpad*) scratchpad;
 
   if (argc != 1) {
     RAISE(
@@ -191,12 +270,183 @@ void minExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
   }
 }
 
+void minExprMerge(void* scratchpad, const void* other) {
+  auto data = (struct min_expr_scratchpad*) scratchpad;
+  auto other_data = (const struct min_expr_scratchpad*) other;
+
+  if (other_data->count == 0) {
+    return;
+  }
+
+  if (data->count == 0 || other_data->min < data->min) {
+    data->min = other_data->min;
+  }
+
+  data->count = 1;
+}
+
+void minExprResult(void* scratchpad, SValue* out) {
+  auto data = (struct min_expr_scratchpad*) scratchpad;
+
+  if (data->count == 0) {
+    *out = SValue();
+  } else {
+    *out = SValue(data->min);
+  }
+}
+
 void minExprFree(void* scratchpad) {
   /* noop */
 }
 
 size_t minExprScratchpadSize() {
-  return sizeof(union min_expr_scratchpad);
+  return sizeof(struct min_expr_scratchpad);
+}
+
+/**
+ * PERCENTILE() and MEDIAN() expressions
+ */
+struct percentile_expr_scratchpad {
+  double percentile;
+  uint8_t has_percentile;
+  fnord::util::LogHistogram histogram;
+};
+
+void percentileExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
+  auto data = (struct percentile_expr_scratchpad*) scratchpad;
+
+  if (argc != 2) {
+    RAISE(
+        kRuntimeError,
+        "wrong number of arguments for percentile(). expected: 2, got: %i\n",
+        argc);
+  }
+
+  if (!data->has_percentile) {
+    auto percentile = argv[1].getFloat();
+
+    if (percentile < 0 || percentile > 100) {
+      RAISE(
+          kRuntimeError,
+          "percentile() must be between 0 and 100, got: %f\n",
+          percentile);
+    }
+
+    data->percentile = percentile;
+    data->has_percentile = 1;
+  }
+
+  switch(argv->getType()) {
+    case SValue::T_NULL:
+      break;
+
+    default:
+      data->histogram.insert(argv->getFloat());
+      break;
+  }
+
+  /* the result is only computed once, see percentileExprResult */
+  *out = SValue();
+}
+
+void medianExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
+  if (argc != 1) {
+    RAISE(
+        kRuntimeError,
+        "wrong number of arguments for median(). expected: 1, got: %i\n",
+        argc);
+  }
+
+  SValue args[2];
+  args[0] = *argv;
+  args[1] = SValue((fnordmetric::FloatType) 50);
+  percentileExpr(scratchpad, 2, args, out);
+}
+
+void percentileExprMerge(void* scratchpad, const void* other) {
+  auto data = (struct percentile_expr_scratchpad*) scratchpad;
+  auto other_data = (const struct percentile_expr_scratchpad*) other;
+
+  if (!data->has_percentile) {
+    data->percentile = other_data->percentile;
+    data->has_percentile = other_data->has_percentile;
+  }
+
+  data->histogram.merge(other_data->histogram);
+}
+
+void percentileExprResult(void* scratchpad, SValue* out) {
+  auto data = (struct percentile_expr_scratchpad*) scratchpad;
+
+  if (data->histogram.count() == 0) {
+    *out = SValue();
+  } else {
+    *out = SValue(data->histogram.percentile(data->percentile));
+  }
+}
+
+void percentileExprFree(void* scratchpad) {
+  /* noop */
+}
+
+size_t percentileExprScratchpadSize() {
+  return sizeof(struct percentile_expr_scratchpad);
+}
+
+/**
+ * COUNT_DISTINCT() expression
+ */
+void countDistinctExpr(void* scratchpad, int argc, SValue* argv, SValue* out) {
+  auto hll = (fnord::util::HyperLogLog*) scratchpad;
+
+  if (argc != 1) {
+    RAISE(
+        kRuntimeError,
+        "wrong number of arguments for count_distinct(). expected: 1, "
+        "got: %i\n",
+        argc);
+  }
+
+  switch(argv->getType()) {
+    case SValue::T_NULL:
+      break;
+
+    case SValue::T_INTEGER: {
+      auto val = argv->getInteger();
+      hll->insert(fnord::util::HyperLogLog::hash(&val, sizeof(val)));
+      break;
+    }
+
+    case SValue::T_FLOAT: {
+      auto val = argv->getFloat();
+      hll->insert(fnord::util::HyperLogLog::hash(&val, sizeof(val)));
+      break;
+    }
+
+    default:
+      hll->insert(fnord::util::HyperLogLog::hash(argv->toString()));
+      break;
+  }
+
+  /* the result is only computed once, see countDistinctExprResult */
+  *out = SValue();
+}
+
+void countDistinctExprMerge(void* scratchpad, const void* other) {
+  ((fnord::util::HyperLogLog*) scratchpad)->merge(
+      *((const fnord::util::HyperLogLog*) other));
+}
+
+void countDistinctExprResult(void* scratchpad, SValue* out) {
+  *out = SValue((int64_t) ((fnord::util::HyperLogLog*) scratchpad)->estimate());
+}
+
+void countDistinctExprFree(void* scratchpad) {
+  /* noop */
+}
+
+size_t countDistinctExprScratchpadSize() {
+  return sizeof(fnord::util::HyperLogLog);
 }
 
 }
@@ -16,25 +16,54 @@ namespace query {
 namespace expressions {
 
 void countExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
+void countExprMerge(void* scratchpad, const void* other);
+void countExprResult(void* scratchpad, SValue* out);
 void countExprFree(void* scratchpad);
 size_t countExprScratchpadSize();
 
 void sumExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
+void sumExprMerge(void* scratchpad, const void* other);
+void sumExprResult(void* scratchpad, SValue* out);
 void sumExprFree(void* scratchpad);
 size_t sumExprScratchpadSize();
 
 void meanExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
+void meanExprMerge(void* scratchpad, const void* other);
+void meanExprResult(void* scratchpad, SValue* out);
 void meanExprFree(void* scratchpad);
 size_t meanExprScratchpadSize();
 
 void minExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
+void minExprMerge(void* scratchpad, const void* other);
+void minExprResult(void* scratchpad, SValue* out);
 void minExprFree(void* scratchpad);
 size_t minExprScratchpadSize();
 
 void maxExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
+void maxExprMerge(void* scratchpad, const void* other);
+void maxExprResult(void* scratchpad, SValue* out);
 void maxExprFree(void* scratchpad);
 size_t maxExprScratchpadSize();
 
+/**
+ * Approximate aggregates. These only compute their result in the result
+ * method (the value returned for each input row is NULL) and must therefore
+ * only be used in query plan nodes that finalize aggregates using the result
+ * methods (see executeExpressionResult)
+ */
+void percentileExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
+void medianExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
+void percentileExprMerge(void* scratchpad, const void* other);
+void percentileExprResult(void* scratchpad, SValue* out);
+void percentileExprFree(void* scratchpad);
+size_t percentileExprScratchpadSize();
+
+void countDistinctExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
+void countDistinctExprMerge(void* scratchpad, const void* other);
+void countDistinctExprResult(void* scratchpad, SValue* out);
+void countDistinctExprFree(void* scratchpad);
+size_t countDistinctExprScratchpadSize();
+
 }
 }
 }
@@ -72,7 +72,9 @@ public:
     T_DOMAIN_SCALE,
     T_GRID,
     T_LEGEND,
-    T_GROUP_OVER_TIMEWINDOW
+    T_GROUP_OVER_TIMEWINDOW,
+
+    T_EXPLAIN
   };
 
   ASTNode(kASTNodeType type);
@@ -62,5 +62,37 @@ std::vector<std::string> ASTUtil::columnNamesFromSelectList(
   return column_names;
 }
 
+std::string ASTUtil::fingerprint(ASTNode* ast) {
+  return fingerprint(ast, std::set<const ASTNode*>());
+}
+
+std::string ASTUtil::fingerprint(
+    ASTNode* ast,
+    const std::set<const ASTNode*>& ignore) {
+  std::string fpr = std::to_string(ast->getType());
+
+  auto token = ast->getToken();
+  if (token != nullptr) {
+    auto token_str = token->getString();
+    fpr += ":" + std::to_string(token->getType());
+    fpr += ":" + std::to_string(token_str.size()) + ":" + token_str;
+  }
+
+  if (ast->getType() == ASTNode::T_RESOLVED_COLUMN) {
+    fpr += "#" + std::to_string(ast->getID());
+  }
+
+  fpr += "(";
+  for (const auto child : ast->getChildren()) {
+    if (child != nullptr && ignore.count(child) == 0) {
+      fpr += fingerprint(child, ignore);
+      fpr += ",";
+    }
+  }
+  fpr += ")";
+
+  return fpr;
+}
+
 }
 }
@@ -9,6 +9,7 @@
  */
 #ifndef _FNORDMETRIC_SQL_ASTUTIL_H
 #define _FNORDMETRIC_SQL_ASTUTIL_H
+#include <set>
 #include <string>
 #include <vector>
 
@@ -24,6 +25,20 @@ public:
       ASTNode* select_list,
       TableRef* tbl_ref = nullptr);
 
+  /**
+   * Returns a string that uniquely identifies the structure and all tokens of
+   * the provided ast, e.g. to be used as a cache key
+   */
+  static std::string fingerprint(ASTNode* ast);
+
+  /**
+   * Returns the fingerprint of the provided ast without the ignored nodes and
+   * their children
+   */
+  static std::string fingerprint(
+      ASTNode* ast,
+      const std::set<const ASTNode*>& ignore);
+
 };
 
 }
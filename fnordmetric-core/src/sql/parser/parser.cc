@@ -245,13 +245,16 @@ ASTNode* Parser::statement() {
       return drawStatement();
     case Token::T_IMPORT:
       return importStatement();
+    case Token::T_EXPLAIN:
+      return explainStatement();
     default:
       break;
   }
 
   RAISE(
       kParseError,
-      "unexpected token %s%s%s, expected one of SELECT, DRAW or IMPORT",
+      "unexpected token %s%s%s, expected one of SELECT, DRAW, IMPORT or "
+      "EXPLAIN",
         Token::getTypeName(cur_token_->getType()),
         cur_token_->getString().size() > 0 ? ": " : "",
         cur_token_->getString().c_str());
@@ -345,6 +348,29 @@ ASTNode* Parser::importStatement() {
   return import;
 }
 
+/* EXPLAIN [ANALYZE] <select>. the ANALYZE token is stored on the node */
+ASTNode* Parser::explainStatement() {
+  auto explain = new ASTNode(ASTNode::T_EXPLAIN);
+  consumeToken();
+
+  if (*cur_token_ == Token::T_ANALYZE) {
+    explain->setToken(cur_token_);
+    consumeToken();
+  }
+
+  if (!(*cur_token_ == Token::T_SELECT)) {
+    RAISE(
+        kParseError,
+        "unexpected token %s%s%s, expected SELECT",
+        Token::getTypeName(cur_token_->getType()),
+        cur_token_->getString().size() > 0 ? ": " : "",
+        cur_token_->getString().c_str());
+  }
+
+  explain->appendChild(selectStatement());
+  return explain;
+}
+
 // FIXPAUL move this into sql extensions
 ASTNode* Parser::drawStatement() {
   auto chart = new ASTNode(ASTNode::T_DRAW);
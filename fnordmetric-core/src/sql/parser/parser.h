@@ -87,6 +87,7 @@ protected:
   ASTNode* legendClause();
 
   ASTNode* importStatement();
+  ASTNode* explainStatement();
 
   ASTNode* fromClause();
   ASTNode* whereClause();
@@ -135,6 +135,8 @@ const char* Token::getTypeName(kTokenType type) {
     case T_LEGEND: return "T_LEGEND";
     case T_OVER: return "T_OVER";
     case T_TIMEWINDOW: return "T_TIMEWINDOW";
+    case T_EXPLAIN: return "T_EXPLAIN";
+    case T_ANALYZE: return "T_ANALYZE";
     default: return "T_UNKNOWN_TOKEN";
   }
 }
@@ -107,7 +107,10 @@ public:
     T_ROTATE,
     T_LEGEND,
     T_OVER,
-    T_TIMEWINDOW
+    T_TIMEWINDOW,
+
+    T_EXPLAIN,
+    T_ANALYZE
   };
 
   Token(kTokenType token_type);
@@ -555,6 +555,16 @@ next:
     goto next;
   }
 
+  if (token == "EXPLAIN") {
+    token_list->emplace_back(Token::T_EXPLAIN);
+    goto next;
+  }
+
+  if (token == "ANALYZE") {
+    token_list->emplace_back(Token::T_ANALYZE);
+    goto next;
+  }
+
   if (token == "<<") {
     token_list->emplace_back(Token::T_LSHIFT);
     goto next;
@@ -212,6 +212,9 @@ CompiledExpression* Compiler::compileMethodCall(
   op->next  = nullptr;
 
   if (symbol->isAggregate()) {
+    op->aggregate = true;
+    op->merge = symbol->getMergeFnPtr();
+    op->result = symbol->getResultFnPtr();
     op->arg0 = (void *) *scratchpad_len;
     *scratchpad_len += symbol->getScratchpadSize();
   }
@@ -29,7 +29,10 @@ enum kCompiledExpressionType {
 struct CompiledExpression {
   kCompiledExpressionType type;
   void (*call)(void*, int, SValue*, SValue*);
+  void (*merge)(void*, const void*);
+  void (*result)(void*, SValue*);
   void* arg0;
+  bool aggregate;
   CompiledExpression* next;
   CompiledExpression* child;
 };
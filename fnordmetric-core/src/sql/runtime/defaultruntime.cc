@@ -22,43 +22,81 @@ DefaultRuntime::DefaultRuntime() {
       "count",
       &expressions::countExpr,
       expressions::countExprScratchpadSize(),
-      &expressions::countExprFree);
+      &expressions::countExprFree,
+      &expressions::countExprMerge,
+      &expressions::countExprResult);
 
   symbol_table_.registerSymbol(
       "sum",
       &expressions::sumExpr,
       expressions::sumExprScratchpadSize(),
-      &expressions::sumExprFree);
+      &expressions::sumExprFree,
+      &expressions::sumExprMerge,
+      &expressions::sumExprResult);
 
   symbol_table_.registerSymbol(
       "mean",
       &expressions::meanExpr,
       expressions::meanExprScratchpadSize(),
-      &expressions::meanExprFree);
+      &expressions::meanExprFree,
+      &expressions::meanExprMerge,
+      &expressions::meanExprResult);
 
   symbol_table_.registerSymbol(
       "avg",
       &expressions::meanExpr,
       expressions::meanExprScratchpadSize(),
-      &expressions::meanExprFree);
+      &expressions::meanExprFree,
+      &expressions::meanExprMerge,
+      &expressions::meanExprResult);
 
   symbol_table_.registerSymbol(
       "average",
       &expressions::meanExpr,
       expressions::meanExprScratchpadSize(),
-      &expressions::meanExprFree);
+      &expressions::meanExprFree,
+      &expressions::meanExprMerge,
+      &expressions::meanExprResult);
 
   symbol_table_.registerSymbol(
       "min",
       &expressions::minExpr,
       expressions::minExprScratchpadSize(),
-      &expressions::minExprFree);
+      &expressions::minExprFree,
+      &expressions::minExprMerge,
+      &expressions::minExprResult);
 
   symbol_table_.registerSymbol(
       "max",
       &expressions::maxExpr,
       expressions::maxExprScratchpadSize(),
-      &expressions::maxExprFree);
+      &expressions::maxExprFree,
+      &expressions::maxExprMerge,
+      &expressions::maxExprResult);
+
+  symbol_table_.registerSymbol(
+      "percentile",
+      &expressions::percentileExpr,
+      expressions::percentileExprScratchpadSize(),
+      &expressions::percentileExprFree,
+      &expressions::percentileExprMerge,
+      &expressions::percentileExprResult);
+
+  symbol_table_.registerSymbol(
+      "median",
+      &expressions::medianExpr,
+      expressions::percentileExprScratchpadSize(),
+      &expressions::percentileExprFree,
+      &expressions::percentileExprMerge,
+      &expressions::percentileExprResult);
+
+  symbol_table_.registerSymbol(
+      "count_distinct",
+      &expressions::countDistinctExpr,
+      expressions::countDistinctExprScratchpadSize(),
+      &expressions::countDistinctExprFree,
+      &expressions::countDistinctExprMerge,
+      &expressions::countDistinctExprResult);
 
   /* expressions/boolean.h */
   symbol_table_.registerSymbol("eq", &expressions::eqExpr);
@@ -7,6 +7,7 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
@@ -92,6 +93,146 @@ bool executeExpression(
   }
 }
 
+void mergeExpressionScratchpad(
+    CompiledExpression* expr,
+    void* scratchpad,
+    const void* other) {
+  for (auto cur = expr->child; cur != nullptr; cur = cur->next) {
+    mergeExpressionScratchpad(cur, scratchpad, other);
+  }
+
+  if (expr->type != X_CALL || expr->merge == nullptr) {
+    return;
+  }
+
+  auto offset = (size_t) (expr->arg0);
+  expr->merge(((char *) scratchpad) + offset, ((const char *) other) + offset);
+}
+
+bool executeExpressionResult(
+    CompiledExpression* expr,
+    void* scratchpad,
+    int row_len,
+    const SValue* row,
+    int* outc,
+    SValue* outv) {
+  if (expr->type == X_CALL && expr->result != nullptr) {
+    expr->result(((char *) scratchpad) + ((size_t) (expr->arg0)), outv);
+    *outc = 1;
+    return true;
+  }
+
+  int argc = 0;
+  SValue argv[8];
+
+  for (auto cur = expr->child; cur != nullptr; cur = cur->next) {
+    if (argc >= sizeof(argv) / sizeof(SValue)) {
+      RAISE(kRuntimeError, "too many arguments");
+    }
+
+    int out_len = 0;
+    if (!executeExpressionResult(
+        cur,
+        scratchpad,
+        row_len,
+        row,
+        &out_len,
+        argv + argc)) {
+      return false;
+    }
+
+    if (out_len != 1) {
+      RAISE(kRuntimeError, "expression did not return");
+    }
+
+    argc++;
+  }
+
+  switch (expr->type) {
+
+    case X_CALL: {
+      expr->call(nullptr, argc, argv, outv);
+      *outc = 1;
+      return true;
+    }
+
+    case X_MULTI: {
+      *outc = argc;
+      memcpy(outv, argv, sizeof(SValue) * argc);
+      return true;
+    }
+
+    default:
+      return executeExpression(expr, scratchpad, row_len, row, outc, outv);
+
+  }
+}
+
+static bool hasResultMethods(CompiledExpression* expr) {
+  if (expr->type == X_CALL && expr->aggregate) {
+    return expr->result != nullptr;
+  }
+
+  for (auto cur = expr->child; cur != nullptr; cur = cur->next) {
+    if (!hasResultMethods(cur)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void executeExpressionFinal(
+    CompiledExpression* expr,
+    void* scratchpad,
+    int row_len,
+    const SValue* row,
+    int step_outc,
+    const SValue* step_outv,
+    int* outc,
+    SValue* outv) {
+  if (expr->type != X_MULTI) {
+    if (hasResultMethods(expr)) {
+      executeExpressionResult(expr, scratchpad, row_len, row, outc, outv);
+    } else {
+      *outc = step_outc;
+      std::copy(step_outv, step_outv + step_outc, outv);
+    }
+
+    return;
+  }
+
+  /* outv may be step_outv, so every column only writes its own index */
+  int n = 0;
+  for (auto cur = expr->child; cur != nullptr; cur = cur->next, ++n) {
+    if (n >= step_outc) {
+      RAISE(kRuntimeError, "expression did not return");
+    }
+
+    if (!hasResultMethods(cur)) {
+      outv[n] = step_outv[n];
+      continue;
+    }
+
+    int out_len = 0;
+    if (!executeExpressionResult(
+        cur,
+        scratchpad,
+        row_len,
+        row,
+        &out_len,
+        outv + n)) {
+      RAISE(kRuntimeError, "expression did not return");
+    }
+
+    if (out_len != 1) {
+      RAISE(kRuntimeError, "expression did not return");
+    }
+  }
+
+  *outc = n;
+}
+
 SValue executeSimpleConstExpression(Compiler* compiler, ASTNode* expr) {
   size_t scratchpad_len = 0;
   auto compiled = compiler->compile(expr, &scratchpad_len);
@@ -25,6 +25,45 @@ bool executeExpression(
     int* outc,
     SValue* outv);
 
+/**
+ * Merge the aggregate scratchpad "other" into "scratchpad". Both scratchpads
+ * must have been produced by the same compiled expression and all aggregate
+ * functions in the expression must be mergeable
+ */
+void mergeExpressionScratchpad(
+    CompiledExpression* expr,
+    void* scratchpad,
+    const void* other);
+
+/**
+ * Like executeExpression, but does not feed the row into any aggregate
+ * functions. Instead the current result of each aggregate's scratchpad is
+ * returned
+ */
+bool executeExpressionResult(
+    CompiledExpression* expr,
+    void* scratchpad,
+    int argc,
+    const SValue* argv,
+    int* outc,
+    SValue* outv);
+
+/**
+ * Compute the final value of each column of a select list. Columns whose
+ * aggregate functions all have a result method are computed like in
+ * executeExpressionResult, all other columns are taken from step_outv, the
+ * output of executeExpression for the last input row
+ */
+void executeExpressionFinal(
+    CompiledExpression* expr,
+    void* scratchpad,
+    int argc,
+    const SValue* argv,
+    int step_outc,
+    const SValue* step_outv,
+    int* outc,
+    SValue* outv);
+
 SValue executeSimpleConstExpression(Compiler* compiler, ASTNode* expr);
 
 }
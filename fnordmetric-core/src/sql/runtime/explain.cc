@@ -0,0 +1,106 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/sql/runtime/explain.h>
+
+namespace fnordmetric {
+namespace query {
+
+Explain::Explain(
+    QueryPlanNode* child,
+    bool analyze) :
+    columns_{"id", "parent", "operator"},
+    child_(child),
+    analyze_(analyze),
+    next_id_(0) {
+  if (analyze_) {
+    columns_.emplace_back("rows_in");
+    columns_.emplace_back("rows_out");
+    columns_.emplace_back("wall_time_ms");
+    columns_.emplace_back("cpu_time_ms");
+    columns_.emplace_back("bytes_read");
+    columns_.emplace_back("tables_opened");
+    columns_.emplace_back("tables_skipped");
+  }
+
+  child->setTarget(this);
+  addChild(child);
+}
+
+void Explain::execute() {
+  ExecutionTimer timer(this);
+
+  if (analyze_) {
+    child_->execute();
+  }
+
+  next_id_ = 0;
+  explainNode(child_, -1, 0);
+  QueryPlanNode::finish();
+}
+
+void Explain::explainNode(
+    const QueryPlanNode* node,
+    int parent_id,
+    int depth) {
+  auto id = next_id_++;
+
+  std::vector<SValue> row;
+  row.emplace_back(static_cast<fnordmetric::IntegerType>(id));
+
+  if (parent_id < 0) {
+    row.emplace_back();
+  } else {
+    row.emplace_back(static_cast<fnordmetric::IntegerType>(parent_id));
+  }
+
+  row.emplace_back(std::string(depth * 2, ' ') + node->toString());
+
+  if (analyze_) {
+    auto stats = node->getStats();
+    row.emplace_back(static_cast<fnordmetric::IntegerType>(stats.rows_in));
+    row.emplace_back(static_cast<fnordmetric::IntegerType>(stats.rows_out));
+    row.emplace_back(
+        static_cast<fnordmetric::FloatType>(stats.wall_micros / 1000.0));
+    row.emplace_back(
+        static_cast<fnordmetric::FloatType>(stats.cpu_micros / 1000.0));
+    row.emplace_back(static_cast<fnordmetric::IntegerType>(stats.bytes_read));
+    row.emplace_back(
+        static_cast<fnordmetric::IntegerType>(stats.tables_opened));
+    row.emplace_back(
+        static_cast<fnordmetric::IntegerType>(stats.tables_skipped));
+  }
+
+  emitRow(row.data(), row.size());
+
+  for (const auto child : node->children()) {
+    explainNode(child, id, depth + 1);
+  }
+}
+
+bool Explain::nextRow(SValue* row, int row_len) {
+  return true;
+}
+
+void Explain::finish() {}
+
+size_t Explain::getNumCols() const {
+  return columns_.size();
+}
+
+const std::vector<std::string>& Explain::getColumns() const {
+  return columns_;
+}
+
+std::string Explain::toString() const {
+  return analyze_ ? "ExplainAnalyze" : "Explain";
+}
+
+}
+}
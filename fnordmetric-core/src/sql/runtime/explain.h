@@ -0,0 +1,60 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_SQL_EXPLAIN_H
+#define _FNORDMETRIC_SQL_EXPLAIN_H
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <fnordmetric/sql/runtime/queryplannode.h>
+
+namespace fnordmetric {
+namespace query {
+
+/**
+ * EXPLAIN [ANALYZE] <select>
+ *
+ * Emits one row per node of the child's query plan in pre-order. Each row has
+ * the node's id, the id of its parent and a description of the node that is
+ * indented by its depth in the tree.
+ *
+ * With ANALYZE, the child plan is executed first (its rows are discarded) and
+ * each row additionally contains the node's execution statistics (see
+ * QueryPlanNode::Stats)
+ */
+class Explain : public QueryPlanNode {
+public:
+
+  Explain(QueryPlanNode* child, bool analyze);
+
+  void execute() override;
+  bool nextRow(SValue* row, int row_len) override;
+  size_t getNumCols() const override;
+  const std::vector<std::string>& getColumns() const override;
+  std::string toString() const override;
+
+  /**
+   * The child calls finish() once it is done. Our own target is finished
+   * after the plan rows were emitted
+   */
+  void finish() override;
+
+protected:
+
+  void explainNode(const QueryPlanNode* node, int parent_id, int depth);
+
+  std::vector<std::string> columns_;
+  QueryPlanNode* child_;
+  bool analyze_;
+  int next_id_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,317 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <fnordmetric/sql/runtime/groupby.h>
+#include <fnordmetric/sql/runtime/compile.h>
+#include <fnordmetric/sql/runtime/execute.h>
+#include <fnordmetric/sql/runtime/tablescan.h>
+#include <fnordmetric/stats/allocationscope.h>
+
+namespace fnordmetric {
+namespace query {
+
+GroupBy::GroupBy(
+    std::vector<std::string>&& columns,
+    CompiledExpression* select_expr,
+    CompiledExpression* group_expr,
+    size_t scratchpad_size,
+    QueryPlanNode* child) :
+    GroupBy(
+        std::move(columns),
+        select_expr,
+        group_expr,
+        scratchpad_size,
+        child,
+        false,
+        nullptr) {}
+
+GroupBy::GroupBy(
+    std::vector<std::string>&& columns,
+    CompiledExpression* select_expr,
+    CompiledExpression* group_expr,
+    size_t scratchpad_size,
+    QueryPlanNode* child,
+    bool mergeable,
+    fnord::thread::TaskScheduler* scheduler) :
+    columns_(std::move(columns)),
+    select_expr_(select_expr),
+    group_expr_(group_expr),
+    scratchpad_size_(scratchpad_size),
+    child_(child),
+    mergeable_(mergeable),
+    scheduler_(scheduler),
+    num_partitions_(1) {
+  child->setTarget(this);
+  addChild(child);
+}
+
+GroupBy::~GroupBy() {
+  freeGroups(&groups_);
+}
+
+void GroupBy::execute() {
+  ExecutionTimer timer(this);
+  auto scan = dynamic_cast<TableScan*>(child_);
+
+  if (mergeable_ && scheduler_ != nullptr && scan != nullptr) {
+    std::vector<std::function<void (RowSink* target)>> partitions;
+    scan->partition(&partitions);
+
+    if (partitions.size() > 1) {
+      executeParallel(partitions);
+      return;
+    }
+  }
+
+  child_->execute();
+
+  for (auto& pair : groups_) {
+    finalizeGroup(&pair.second);
+
+    auto& row = pair.second.row;
+    emitRow(row.data(), row.size());
+  }
+}
+
+std::string GroupBy::toString() const {
+  return "GroupBy(mergeable=" + std::string(mergeable_ ? "yes" : "no") +
+      ", partitions=" + std::to_string(num_partitions_) + ")";
+}
+
+void GroupBy::executeParallel(
+    const std::vector<std::function<void (RowSink* target)>>& partitions) {
+  num_partitions_ = partitions.size();
+
+  std::vector<std::unique_ptr<PartialAggregation>> partials;
+  for (int i = 0; i < partitions.size(); ++i) {
+    partials.emplace_back(new PartialAggregation(this));
+  }
+
+  struct ParallelExecution {
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t total;
+    size_t next;
+    size_t pending;
+    std::exception_ptr error;
+  };
+
+  auto state = std::make_shared<ParallelExecution>();
+  state->total = partitions.size();
+  state->next = 0;
+  state->pending = partitions.size();
+
+  /* claims and executes the next partition that hasn't been started yet.
+     partitions and partials are only touched after a successful claim, while
+     the calling thread is still waiting for the claimed partition */
+  auto run_next = [state, &partitions, &partials] () -> bool {
+    size_t i;
+
+    {
+      std::unique_lock<std::mutex> lk(state->mutex);
+      if (state->next == state->total) {
+        return false;
+      }
+
+      i = state->next++;
+    }
+
+    try {
+      partitions[i](partials[i].get());
+    } catch (...) {
+      std::unique_lock<std::mutex> lk(state->mutex);
+      state->error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lk(state->mutex);
+    if (--state->pending == 0) {
+      state->cv.notify_all();
+    }
+
+    return true;
+  };
+
+  for (size_t i = 0; i < partitions.size() - 1; ++i) {
+    scheduler_->run(fnord::thread::Task::create([run_next] () {
+      fnord::stats::AllocationScope allocation_scope(
+          fnord::stats::AllocationStats::SUBSYSTEM_QUERY);
+      run_next();
+    }));
+  }
+
+  /* the calling thread executes partitions, too, until none are left. this
+     guarantees progress even if all of the scheduler's threads are busy (or
+     the calling thread is one of them) */
+  while (run_next());
+
+  {
+    std::unique_lock<std::mutex> lk(state->mutex);
+    while (state->pending > 0) {
+      state->cv.wait(lk);
+    }
+  }
+
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+
+  /* merge partial aggregations in partition order */
+  for (auto& partial : partials) {
+    for (auto& pair : partial->groups) {
+      auto group_iter = groups_.find(pair.first);
+
+      if (group_iter == groups_.end()) {
+        groups_.emplace(pair.first, pair.second);
+      } else {
+        auto& group = group_iter->second;
+        mergeExpressionScratchpad(
+            select_expr_,
+            group.scratchpad,
+            pair.second.scratchpad);
+
+        free(pair.second.scratchpad);
+        group.row = std::move(pair.second.row);
+      }
+
+      pair.second.scratchpad = nullptr;
+    }
+  }
+
+  for (auto& pair : groups_) {
+    auto& group = pair.second;
+    finalizeGroup(&group);
+    emitRow(group.row.data(), group.row.size());
+  }
+}
+
+void GroupBy::finalizeGroup(Group* group) {
+  SValue out[128]; // FIXPAUL
+  int out_len;
+
+  if (mergeable_) {
+    executeExpressionResult(
+        select_expr_,
+        group->scratchpad,
+        group->row.size(),
+        group->row.data(),
+        &out_len,
+        out);
+  } else {
+    executeExpressionFinal(
+        select_expr_,
+        group->scratchpad,
+        group->input.size(),
+        group->input.data(),
+        group->row.size(),
+        group->row.data(),
+        &out_len,
+        out);
+  }
+
+  group->row.assign(out, out + out_len);
+}
+
+bool GroupBy::nextRow(SValue* row, int row_len) {
+  accumulate(&groups_, row, row_len, mergeable_);
+  return true;
+}
+
+void GroupBy::accumulate(
+    GroupMap* groups,
+    SValue* row,
+    int row_len,
+    bool store_input) {
+  SValue out[128]; // FIXPAUL
+  int out_len = 0;
+
+  /* execute group expression */
+  if (group_expr_ != nullptr) {
+    executeExpression(group_expr_, nullptr, row_len, row, &out_len, out);
+  }
+
+  /* stringify expression results into group key */
+  auto key_str = SValue::makeUniqueKey(out, out_len);
+
+  /* get group */
+  Group* group = nullptr;
+
+  auto group_iter = groups->find(key_str);
+  if (group_iter == groups->end()) {
+    group = &(*groups)[key_str];
+    group->scratchpad = malloc(scratchpad_size_);
+
+    if (group->scratchpad == nullptr) {
+      RAISE(kMallocError, "malloc() failed");
+    }
+
+    memset(group->scratchpad, 0, scratchpad_size_);
+
+    if (context_ != nullptr) {
+      context_->allocate(sizeof(Group) + key_str.size() + scratchpad_size_);
+      allocateRow(row, row_len);
+    }
+  } else {
+    group = &group_iter->second;
+  }
+
+  /* execute select expresion and save results */
+  executeExpression(
+      select_expr_,
+      group->scratchpad,
+      row_len,
+      row,
+      &out_len,
+      out);
+
+  /* update group */
+  if (store_input) {
+    group->row.assign(row, row + row_len);
+  } else {
+    group->row.assign(out, out + out_len);
+    group->input.assign(row, row + row_len);
+  }
+}
+
+size_t GroupBy::getNumCols() const {
+  return columns_.size();
+}
+
+const std::vector<std::string>& GroupBy::getColumns() const {
+  return columns_;
+}
+
+void GroupBy::freeGroups(GroupMap* groups) {
+  for (auto& pair : *groups) {
+    auto scratchpad = pair.second.scratchpad;
+
+    if (scratchpad != nullptr) {
+      free(scratchpad);
+    }
+  }
+}
+
+GroupBy::PartialAggregation::PartialAggregation(
+    GroupBy* group_by) :
+    group_by_(group_by) {}
+
+GroupBy::PartialAggregation::~PartialAggregation() {
+  GroupBy::freeGroups(&groups);
+}
+
+bool GroupBy::PartialAggregation::nextRow(SValue* row, int row_len) {
+  group_by_->accumulate(&groups, row, row_len, true);
+  return true;
+}
+
+}
+}
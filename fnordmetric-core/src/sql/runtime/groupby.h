@@ -13,12 +13,15 @@
 #include <string>
 #include <string.h>
 #include <vector>
+#include <functional>
+#include <unordered_map>
 #include <assert.h>
 #include <fnordmetric/sql/parser/astnode.h>
 #include <fnordmetric/sql/parser/token.h>
 #include <fnordmetric/sql/runtime/queryplannode.h>
 #include <fnordmetric/sql/runtime/symboltable.h>
 #include <fnordmetric/sql/runtime/compile.h>
+#include <fnordmetric/thread/taskscheduler.h>
 
 namespace fnordmetric {
 namespace query {
@@ -31,104 +34,84 @@ public:
       CompiledExpression* select_expr,
       CompiledExpression* group_expr,
       size_t scratchpad_size,
-      QueryPlanNode* child) :
-      columns_(std::move(columns)),
-      select_expr_(select_expr),
-      group_expr_(group_expr),
-      scratchpad_size_(scratchpad_size),
-      child_(child) {
-    child->setTarget(this);
-  }
-
-  ~GroupBy() {
-    for (auto& pair : groups_) {
-      auto scratchpad = pair.second.scratchpad;
-
-      if (scratchpad != nullptr) {
-        free(scratchpad);
-      }
-    }
-  }
-
-  void execute() override {
-    child_->execute();
-
-    for (auto& pair : groups_) {
-      auto& row = pair.second.row;
-      emitRow(row.data(), row.size());
-    }
-  }
-
-  bool nextRow(SValue* row, int row_len) override {
-    SValue out[128]; // FIXPAUL
-    int out_len;
-
-    /* execute group expression */
-    if (group_expr_ != nullptr) {
-      executeExpression(group_expr_, nullptr, row_len, row, &out_len, out);
-    }
-
-    /* stringify expression results into group key */
-    auto key_str = SValue::makeUniqueKey(out, out_len);
-
-    /* get group */
-    Group* group = nullptr;
-
-    auto group_iter = groups_.find(key_str);
-    if (group_iter == groups_.end()) {
-      group = &groups_[key_str];
-      group->scratchpad = malloc(scratchpad_size_);
-
-      if (group->scratchpad == nullptr) {
-        RAISE(kMallocError, "malloc() failed");
-      }
-
-      memset(group->scratchpad, 0, scratchpad_size_);
-    } else {
-      group = &group_iter->second;
-    }
-
-    /* execute select expresion and save results */
-    executeExpression(
-        select_expr_,
-        group->scratchpad,
-        row_len,
-        row,
-        &out_len,
-        out);
-
-    std::vector<SValue> row_vec;
-    for (int i = 0; i < out_len; i++) {
-      row_vec.push_back(out[i]);
-    }
-
-    /* update group */
-    group->row = row_vec;
-
-    return true;
-  }
-
-  size_t getNumCols() const override {
-    return columns_.size();
-  }
-
-  const std::vector<std::string>& getColumns() const override {
-    return columns_;
-  }
+      QueryPlanNode* child);
+
+  /**
+   * If all aggregate functions in the select expression are mergeable, the
+   * final value of each group is computed using the aggregate result methods.
+   * Otherwise only the columns with non-mergeable aggregate functions use
+   * the output of the last row (see executeExpressionFinal).
+   *
+   * If additionally a scheduler is provided and the child node is a table
+   * scan that can be split into multiple partitions, each partition is scanned
+   * and pre-aggregated on the scheduler and the partial results are merged
+   * afterwards.
+   */
+  GroupBy(
+      std::vector<std::string>&& columns,
+      CompiledExpression* select_expr,
+      CompiledExpression* group_expr,
+      size_t scratchpad_size,
+      QueryPlanNode* child,
+      bool mergeable,
+      fnord::thread::TaskScheduler* scheduler);
+
+  ~GroupBy();
+
+  void execute() override;
+  bool nextRow(SValue* row, int row_len) override;
+  size_t getNumCols() const override;
+  const std::vector<std::string>& getColumns() const override;
+  std::string toString() const override;
 
 protected:
 
   struct Group {
     std::vector<SValue> row;
+    std::vector<SValue> input;
     void* scratchpad;
   };
 
+  typedef std::unordered_map<std::string, Group> GroupMap;
+
+  class PartialAggregation : public RowSink {
+  public:
+    PartialAggregation(GroupBy* group_by);
+    ~PartialAggregation();
+    bool nextRow(SValue* row, int row_len) override;
+    GroupMap groups;
+  protected:
+    GroupBy* group_by_;
+  };
+
+  /**
+   * Add a row to the matching group in the provided map. If store_input is
+   * true the input row is saved instead of the select expression result,
+   * otherwise both are saved
+   */
+  void accumulate(GroupMap* groups, SValue* row, int row_len, bool store_input);
+
+  void executeParallel(
+      const std::vector<std::function<void (RowSink* target)>>& partitions);
+
+  /**
+   * Compute the final select expression result of a group from its scratchpad
+   * and last input row (and, if not mergeable, the last select expression
+   * result, see executeExpressionFinal)
+   */
+  void finalizeGroup(Group* group);
+
+  static void freeGroups(GroupMap* groups);
+
   std::vector<std::string> columns_;
   CompiledExpression* select_expr_;
   CompiledExpression* group_expr_;
   size_t scratchpad_size_;
   QueryPlanNode* child_;
-  std::unordered_map<std::string, Group> groups_;
+  bool mergeable_;
+  fnord::thread::TaskScheduler* scheduler_;
+  size_t num_partitions_;
+  GroupMap groups_;
 };
 
 }
@@ -7,9 +7,12 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <set>
 #include <fnordmetric/sql/runtime/groupovertimewindow.h>
 #include <fnordmetric/sql/runtime/compile.h>
 #include <fnordmetric/sql/runtime/execute.h>
+#include <fnordmetric/util/wallclock.h>
 
 namespace fnordmetric {
 namespace query {
@@ -25,6 +28,35 @@ GroupOverTimewindow::GroupOverTimewindow(
     CompiledExpression* group_expr,
     size_t scratchpad_size,
     QueryPlanNode* child) :
+    GroupOverTimewindow(
+        std::move(columns),
+        time_expr,
+        window,
+        step,
+        input_row_size,
+        input_row_time_index,
+        select_expr,
+        group_expr,
+        scratchpad_size,
+        child,
+        false,
+        nullptr,
+        "") {}
+
+GroupOverTimewindow::GroupOverTimewindow(
+    std::vector<std::string>&& columns,
+    CompiledExpression* time_expr,
+    fnordmetric::IntegerType window,
+    fnordmetric::IntegerType step,
+    size_t input_row_size,
+    size_t input_row_time_index,
+    CompiledExpression* select_expr,
+    CompiledExpression* group_expr,
+    size_t scratchpad_size,
+    QueryPlanNode* child,
+    bool mergeable,
+    WindowCache* window_cache,
+    const std::string& fingerprint) :
     time_expr_(time_expr),
     window_(window),
     step_(step),
@@ -34,7 +66,11 @@ GroupOverTimewindow::GroupOverTimewindow(
     select_expr_(select_expr),
     group_expr_(group_expr),
     scratchpad_size_(scratchpad_size),
-    child_(child) {
+    child_(child),
+    mergeable_(mergeable),
+    window_cache_(window_cache),
+    fingerprint_(fingerprint),
+    min_time_(0) {
   scratchpad_ = malloc(scratchpad_size_);
 
   if (scratchpad_ == nullptr) {
@@ -42,13 +78,39 @@ GroupOverTimewindow::GroupOverTimewindow(
   }
 
   child->setTarget(this);
+  addChild(child);
 }
 
 GroupOverTimewindow::~GroupOverTimewindow() {
   free(scratchpad_);
 }
 
+std::string GroupOverTimewindow::toString() const {
+  auto str = "GroupOverTimewindow(window=" + std::to_string(window_) +
+      ", step=" + std::to_string(step_) +
+      ", window_cache=" + (window_cache_ == nullptr ? "no" : "yes");
+
+  /* set if earlier windows were served from the window cache */
+  if (min_time_ > 0) {
+    str += ", scan_from=" + std::to_string(min_time_);
+  }
+
+  return str + ")";
+}
+
 void GroupOverTimewindow::execute() {
+  ExecutionTimer timer(this);
+  auto scan = dynamic_cast<TableScan*>(child_);
+
+  if (window_cache_ != nullptr &&
+      scan != nullptr &&
+      window_ > 0 &&
+      step_ > 0 &&
+      scan->isTimeColumn(input_row_time_index_)) {
+    executeCached(scan);
+    return;
+  }
+
   child_->execute();
 
   for (auto& group : groups_) {
@@ -68,16 +130,6 @@ bool GroupOverTimewindow::nextRow(SValue* row, int row_len) {
   /* stringify expression results into group key */
   auto key_str = SValue::makeUniqueKey(out, out_len);
 
-  /* get group */
-  Group* group = nullptr;
-
-  auto group_iter = groups_.find(key_str);
-  if (group_iter == groups_.end()) {
-    group = &groups_[key_str];
-  } else {
-    group = &group_iter->second;
-  }
-
   /* execute time expression */
   executeExpression(time_expr_, nullptr, row_len, row, &out_len, out);
   if (out_len != 1) {
@@ -90,7 +142,28 @@ bool GroupOverTimewindow::nextRow(SValue* row, int row_len) {
 
   auto time = static_cast<uint64_t>(out[0].getTimestamp());
 
+  /* rows before min_time_ are served from the window cache */
+  if (time < min_time_) {
+    return true;
+  }
+
+  /* get group */
+  Group* group = nullptr;
+
+  auto group_iter = groups_.find(key_str);
+  if (group_iter == groups_.end()) {
+    group = &groups_[key_str];
+
+    if (context_ != nullptr) {
+      context_->allocate(sizeof(Group) + key_str.size());
+    }
+  } else {
+    group = &group_iter->second;
+  }
+
   /* add row to group */
+  allocateRow(row, row_len);
+
   std::vector<SValue> row_vec;
   for (int i = 0; i < row_len; i++) {
     row_vec.push_back(row[i]);
@@ -101,14 +174,187 @@ bool GroupOverTimewindow::nextRow(SValue* row, int row_len) {
   return true;
 }
 
-void GroupOverTimewindow::emitGroup(Group* group) {
-  auto& rows = group->rows;
+void GroupOverTimewindow::executeCached(TableScan* scan) {
+  uint64_t window_micros = window_ * 1000000;
+  uint64_t step_micros = step_ * 1000000;
+
+  /* windows that end before the horizon are closed and may be cached */
+  auto now = fnord::util::WallClock::unixMicros();
+  auto grace_period = window_cache_->gracePeriodMicros();
+  auto horizon = now > grace_period ? now - grace_period : 0;
+
+  /* only emit the windows that start in the time range of the scan. windows
+     that end after the time range are computed from the rows in the range but
+     are neither served from nor stored in the cache */
+  uint64_t range_begin;
+  uint64_t range_end;
+  scan->timeRange(&range_begin, &range_end);
+
+  uint64_t first_window = (range_begin / step_micros) * step_micros;
+  if (first_window < range_begin) {
+    first_window += step_micros;
+  }
 
-  if (rows.size() == 0) {
+  auto cache_until = std::min(horizon, range_end);
+
+  /* queries that only differ in their time range share one series */
+  auto series = fingerprint_ + ":" + scan->whereFingerprint();
+
+  /* fetch cached windows and drop the ones that may contain late rows */
+  uint64_t late_row_seq;
+  auto late_rows_min_time = scan->tableRef()->getLateRowsMinTime(
+      window_cache_->lateRowSequence(series),
+      &late_row_seq);
+
+  uint64_t covered_from = 0;
+  WindowCache::WindowList cached_windows;
+  auto covered_until = window_cache_->fetch(
+      series,
+      late_rows_min_time,
+      late_row_seq,
+      window_micros,
+      &covered_from,
+      &cached_windows);
+
+  /* only scan the rows of the first window that is not cached and after */
+  min_time_ = first_window;
+  covered_until = std::min(covered_until, range_end);
+  WindowCache::WindowList usable_windows;
+  if (covered_from <= first_window &&
+      covered_until >= first_window + window_micros) {
+    min_time_ = std::max(
+        first_window,
+        ((covered_until - window_micros) / step_micros + 1) * step_micros);
+
+    usable_windows.insert(
+        cached_windows.lower_bound(first_window),
+        cached_windows.lower_bound(min_time_));
+  }
+
+  scan->setTimeRangeBegin(min_time_);
+  child_->execute();
+
+  std::set<std::string> group_keys;
+  for (const auto& group : groups_) {
+    group_keys.insert(group.first);
+  }
+
+  for (const auto& window : usable_windows) {
+    for (const auto& group : *window.second) {
+      group_keys.insert(group.first);
+    }
+  }
+
+  std::map<uint64_t, WindowCache::WindowResult> new_windows;
+  for (const auto& group_key : group_keys) {
+    auto group_iter = groups_.find(group_key);
+
+    emitCachedGroup(
+        group_key,
+        group_iter == groups_.end() ? nullptr : &group_iter->second,
+        usable_windows,
+        range_end,
+        cache_until,
+        &new_windows);
+  }
+
+  WindowCache::WindowList closed_windows;
+  for (auto& window : new_windows) {
+    closed_windows.emplace(
+        window.first,
+        std::make_shared<const WindowCache::WindowResult>(
+            std::move(window.second)));
+  }
+
+  window_cache_->store(
+      series,
+      closed_windows,
+      window_micros,
+      first_window,
+      cache_until);
+}
+
+void GroupOverTimewindow::emitCachedGroup(
+    const std::string& group_key,
+    Group* group,
+    const WindowCache::WindowList& cached_windows,
+    uint64_t range_end,
+    uint64_t cache_until,
+    std::map<uint64_t, WindowCache::WindowResult>* new_windows) {
+  uint64_t window_micros = window_ * 1000000;
+  uint64_t step_micros = step_ * 1000000;
+
+  /* emit cached windows */
+  bool has_cached_windows = false;
+  uint64_t last_cached_window = 0;
+  for (const auto& window : cached_windows) {
+    auto iter = window.second->find(group_key);
+    if (iter == window.second->end()) {
+      continue;
+    }
+
+    auto row = iter->second;
+    emitRow(row.data(), row.size());
+    has_cached_windows = true;
+    last_cached_window = window.first;
+  }
+
+  if (group == nullptr || group->rows.size() == 0) {
     return;
   }
 
-  /* sort rows */
+  sortGroup(group);
+  auto& rows = group->rows;
+
+  /* emit the remaining windows, aligned to multiples of the step, until the
+     first window that ends after the last row */
+  uint64_t window_start_time;
+  uint64_t prev_window_end_time;
+  if (has_cached_windows) {
+    window_start_time = last_cached_window + step_micros;
+    prev_window_end_time = last_cached_window + window_micros;
+  } else {
+    window_start_time = (rows[0].first / step_micros) * step_micros;
+    prev_window_end_time = 0;
+  }
+
+  auto last_row_time = rows.back().first;
+  size_t window_start_idx = 0;
+  size_t window_end_idx;
+
+  while (prev_window_end_time <= last_row_time &&
+      window_start_time < range_end) {
+    while (window_start_idx < rows.size() &&
+        rows[window_start_idx].first < window_start_time) {
+      window_start_idx++;
+    }
+
+    auto window_end_time = window_start_time + window_micros;
+    for (
+        window_end_idx = window_start_idx;
+        window_end_idx < rows.size() &&
+            rows[window_end_idx].first < window_end_time;
+        ++window_end_idx);
+
+    auto row = computeWindow(
+        window_end_time,
+        rows.begin() + window_start_idx,
+        rows.begin() + window_end_idx);
+
+    emitRow(row.data(), row.size());
+
+    if (window_end_time <= cache_until) {
+      (*new_windows)[window_start_time].emplace(group_key, std::move(row));
+    }
+
+    prev_window_end_time = window_end_time;
+    window_start_time += step_micros;
+  }
+}
+
+void GroupOverTimewindow::sortGroup(Group* group) {
+  auto& rows = group->rows;
+
   std::sort(
       rows.begin(),
       rows.end(),
@@ -117,7 +363,16 @@ void GroupOverTimewindow::emitGroup(Group* group) {
           const std::pair<uint64_t, std::vector<SValue>>& b) {
             return a.first < b.first;
           });
+}
 
+void GroupOverTimewindow::emitGroup(Group* group) {
+  auto& rows = group->rows;
+
+  if (rows.size() == 0) {
+    return;
+  }
+
+  sortGroup(group);
 
   size_t window_start_idx = 0;
   size_t window_end_idx;
@@ -149,27 +404,38 @@ void GroupOverTimewindow::emitGroup(Group* group) {
 
 void GroupOverTimewindow::emitWindow(
     uint64_t window_time,
-    std::vector<std::pair<uint64_t, std::vector<SValue>>>::iterator
-        window_begin,
-    std::vector<std::pair<uint64_t, std::vector<SValue>>>::iterator
-        window_end) {
+    RowList::iterator window_begin,
+    RowList::iterator window_end) {
+  auto row = computeWindow(window_time, window_begin, window_end);
+  emitRow(row.data(), row.size());
+}
 
+std::vector<SValue> GroupOverTimewindow::computeWindow(
+    uint64_t window_time,
+    RowList::iterator window_begin,
+    RowList::iterator window_end) {
   SValue out[128]; // FIXPAUL
   int out_len;
 
   memset(scratchpad_, 0, scratchpad_size_);
 
+  std::vector<SValue> empty_row;
+  const std::vector<SValue>* last_row;
+
   if (window_begin == window_end) {
-    std::vector<SValue> row(input_row_size_, SValue());
-    row[input_row_time_index_] = SValue(fnord::util::DateTime(window_time));
+    empty_row.resize(input_row_size_);
+    empty_row[input_row_time_index_] =
+        SValue(fnord::util::DateTime(window_time));
 
     executeExpression(
         select_expr_,
         scratchpad_,
-        row.size(),
-        row.data(),
+        empty_row.size(),
+        empty_row.data(),
         &out_len,
         out);
+
+    last_row = &empty_row;
   } else {
     for (; window_begin != window_end; window_begin++) {
       auto& row = window_begin->second;
@@ -182,10 +448,32 @@ void GroupOverTimewindow::emitWindow(
           row.data(),
           &out_len,
           out);
+
+      last_row = &row;
     }
   }
 
-  emitRow(out, out_len);
+  if (mergeable_) {
+    executeExpressionResult(
+        select_expr_,
+        scratchpad_,
+        last_row->size(),
+        last_row->data(),
+        &out_len,
+        out);
+  } else {
+    executeExpressionFinal(
+        select_expr_,
+        scratchpad_,
+        last_row->size(),
+        last_row->data(),
+        out_len,
+        out,
+        &out_len,
+        out);
+  }
+
+  return std::vector<SValue>(out, out + out_len);
 }
 
 size_t GroupOverTimewindow::getNumCols() const {
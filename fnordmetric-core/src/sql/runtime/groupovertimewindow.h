@@ -10,6 +10,7 @@
 #ifndef _FNORDMETRIC_SQL_GROUPOVERTIMEWINDOW_H
 #define _FNORDMETRIC_SQL_GROUPOVERTIMEWINDOW_H
 #include <algorithm>
+#include <map>
 #include <memory>
 #include <stdlib.h>
 #include <string>
@@ -19,8 +20,10 @@
 #include <fnordmetric/sql/parser/astnode.h>
 #include <fnordmetric/sql/parser/token.h>
 #include <fnordmetric/sql/runtime/queryplannode.h>
+#include <fnordmetric/sql/runtime/tablescan.h>
 #include <fnordmetric/sql/runtime/symboltable.h>
 #include <fnordmetric/sql/runtime/compile.h>
+#include <fnordmetric/sql/runtime/windowcache.h>
 
 namespace fnordmetric {
 namespace query {
@@ -40,6 +43,35 @@ public:
       size_t scratchpad_size,
       QueryPlanNode* child);
 
+  /**
+   * If all aggregate functions in the select expression are mergeable, the
+   * final value of each window is computed using the aggregate result methods.
+   * Otherwise only the columns with non-mergeable aggregate functions use
+   * the output of the last row (see executeExpressionFinal).
+   *
+   * If a window cache is provided, closed windows are served from the cache
+   * and only the windows that were still open when the query last ran are
+   * recomputed from the table. Windows are then aligned to multiples of the
+   * step and only the windows that start in the time range of the scan are
+   * emitted (see TableScan::timeRange). The fingerprint must uniquely identify
+   * the query plan without its where clause; the where clause is identified
+   * by the fingerprint of the scan.
+   */
+  GroupOverTimewindow(
+      std::vector<std::string>&& columns,
+      CompiledExpression* time_expr,
+      fnordmetric::IntegerType window,
+      fnordmetric::IntegerType step,
+      size_t input_row_size,
+      size_t input_row_time_index,
+      CompiledExpression* select_expr,
+      CompiledExpression* group_expr,
+      size_t scratchpad_size,
+      QueryPlanNode* child,
+      bool mergeable,
+      WindowCache* window_cache,
+      const std::string& fingerprint);
+
   ~GroupOverTimewindow();
 
   void execute() override;
@@ -47,6 +79,7 @@ public:
 
   size_t getNumCols() const override;
   const std::vector<std::string>& getColumns() const override;
+  std::string toString() const override;
 
 protected:
 
@@ -54,14 +87,30 @@ protected:
     std::vector<std::pair<uint64_t, std::vector<SValue>>> rows;
   };
 
+  typedef std::vector<std::pair<uint64_t, std::vector<SValue>>> RowList;
+
+  void executeCached(TableScan* scan);
+
+  void sortGroup(Group* group);
   void emitGroup(Group* group);
 
+  void emitCachedGroup(
+      const std::string& group_key,
+      Group* group,
+      const WindowCache::WindowList& cached_windows,
+      uint64_t range_end,
+      uint64_t cache_until,
+      std::map<uint64_t, WindowCache::WindowResult>* new_windows);
+
   void emitWindow(
       uint64_t window_time,
-      std::vector<std::pair<uint64_t, std::vector<SValue>>>::iterator
-          window_begin,
-      std::vector<std::pair<uint64_t, std::vector<SValue>>>::iterator
-          window_end);
+      RowList::iterator window_begin,
+      RowList::iterator window_end);
+
+  std::vector<SValue> computeWindow(
+      uint64_t window_time,
+      RowList::iterator window_begin,
+      RowList::iterator window_end);
 
   std::vector<std::string> columns_;
   CompiledExpression* time_expr_;
@@ -73,8 +122,12 @@ protected:
   CompiledExpression* group_expr_;
   size_t scratchpad_size_;
   QueryPlanNode* child_;
+  bool mergeable_;
   void* scratchpad_;
   std::unordered_map<std::string, Group> groups_;
+  WindowCache* window_cache_;
+  const std::string fingerprint_;
+  uint64_t min_time_;
 };
 
 }
@@ -30,9 +30,11 @@ public:
       child_(child),
       counter_(0) {
     child->setTarget(this);
+    addChild(child);
   }
 
   void execute() override {
+    ExecutionTimer timer(this);
     child_->execute();
   }
 
@@ -57,6 +59,11 @@ public:
     return child_->getColumns();
   }
 
+  std::string toString() const override {
+    return "Limit(limit=" + std::to_string(limit_) +
+        ", offset=" + std::to_string(offset_) + ")";
+  }
+
 protected:
   size_t limit_;
   size_t offset_;
@@ -34,10 +34,12 @@ OrderBy::OrderBy(
   }
 
   child->setTarget(this);
+  addChild(child);
 }
 
 // FIXPAUL this should mergesort while inserting...
 void OrderBy::execute() {
+  ExecutionTimer timer(this);
   child_->execute();
 
   std::sort(rows_.begin(), rows_.end(), [this] (
@@ -83,6 +85,8 @@ void OrderBy::execute() {
 }
 
 bool OrderBy::nextRow(SValue* row, int row_len) {
+  allocateRow(row, row_len);
+
   std::vector<SValue> row_vec;
   for (int i = 0; i < row_len; i++) {
     row_vec.emplace_back(row[i]);
@@ -92,6 +96,27 @@ bool OrderBy::nextRow(SValue* row, int row_len) {
   return true;
 }
 
+std::string OrderBy::toString() const {
+  const auto& child_columns = child_->getColumns();
+  std::string str = "OrderBy(";
+
+  for (size_t i = 0; i < sort_specs_.size(); ++i) {
+    if (i > 0) {
+      str += ", ";
+    }
+
+    if (sort_specs_[i].column < child_columns.size()) {
+      str += child_columns[sort_specs_[i].column];
+    } else {
+      str += std::to_string(sort_specs_[i].column);
+    }
+
+    str += sort_specs_[i].descending ? " DESC" : " ASC";
+  }
+
+  return str + ")";
+}
+
 size_t OrderBy::getNumCols() const {
   return columns_.size();
 }
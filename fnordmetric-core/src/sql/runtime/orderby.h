@@ -37,6 +37,7 @@ public:
   bool nextRow(SValue* row, int row_len) override;
   size_t getNumCols() const override;
   const std::vector<std::string>& getColumns() const override;
+  std::string toString() const override;
 
 protected:
   std::vector<std::string> columns_;
@@ -0,0 +1,203 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/sql/parser/parser.h>
+#include <fnordmetric/sql/parser/tokenize.h>
+#include <fnordmetric/sql/runtime/querycache.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnordmetric {
+namespace query {
+
+QueryCache::QueryCache(
+    size_t max_entries /* = kDefaultMaxEntries */) :
+    max_entries_(max_entries),
+    num_hits_(0),
+    num_misses_(0) {}
+
+std::vector<std::unique_ptr<ASTNode>> QueryCache::parseQuery(
+    const std::string& query) {
+  if (query.size() == 0) {
+    RAISE(kParseError, "empty query");
+  }
+
+  std::vector<Token> tokens;
+  tokenizeQuery(query, &tokens);
+
+  /* build the normalized key and collect the literals */
+  std::string key;
+  std::vector<const Token*> literals;
+  for (const auto& token : tokens) {
+    key.append(std::to_string(token.getType()));
+
+    if (isLiteral(token)) {
+      literals.emplace_back(&token);
+      key.append("?");
+    } else {
+      key.append(":");
+      key.append(token.getString());
+    }
+
+    key.append(1, '\0');
+  }
+
+  auto cached = lookup(key);
+
+  if (cached.get() == nullptr) {
+    Parser parser;
+    parser.parse(query.c_str(), query.size());
+
+    std::vector<int> literal_indexes;
+    int num_literals = 0;
+    for (const auto& token : parser.getTokenList()) {
+      literal_indexes.emplace_back(isLiteral(token) ? num_literals++ : -1);
+    }
+
+    cached.reset(new CachedQuery());
+    for (const auto stmt : parser.getStatements()) {
+      buildLiteralSlots(
+          stmt,
+          parser.getTokenList(),
+          literal_indexes,
+          &cached->literal_slots);
+
+      cached->statements.emplace_back(stmt->deepCopy());
+    }
+
+    store(key, cached);
+  }
+
+  std::vector<std::unique_ptr<ASTNode>> stmts;
+  size_t slot = 0;
+  for (const auto& stmt : cached->statements) {
+    stmts.emplace_back(
+        bindLiterals(stmt.get(), literals, cached->literal_slots, &slot));
+  }
+
+  return stmts;
+}
+
+bool QueryCache::isLiteral(const Token& token) {
+  switch (token.getType()) {
+    case Token::T_STRING:
+    case Token::T_NUMERIC:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void QueryCache::buildLiteralSlots(
+    const ASTNode* node,
+    const std::vector<Token>& tokens,
+    const std::vector<int>& literal_indexes,
+    std::vector<int>* literal_slots) {
+  auto token = node->getToken();
+
+  if (token != nullptr && isLiteral(*token)) {
+    auto index = token - tokens.data();
+
+    if (index >= 0 && index < literal_indexes.size()) {
+      literal_slots->emplace_back(literal_indexes[index]);
+    } else {
+      literal_slots->emplace_back(-1);
+    }
+  }
+
+  for (const auto child : node->getChildren()) {
+    if (child != nullptr) {
+      buildLiteralSlots(child, tokens, literal_indexes, literal_slots);
+    }
+  }
+}
+
+ASTNode* QueryCache::bindLiterals(
+    const ASTNode* node,
+    const std::vector<const Token*>& literals,
+    const std::vector<int>& literal_slots,
+    size_t* slot) {
+  auto copy = new ASTNode(node->getType());
+  auto token = node->getToken();
+
+  if (token != nullptr) {
+    if (isLiteral(*token)) {
+      if (*slot >= literal_slots.size()) {
+        RAISE(kRuntimeError, "internal error: corrupt query cache entry");
+      }
+
+      auto literal_index = literal_slots[(*slot)++];
+      if (literal_index >= 0) {
+        token = literals[literal_index];
+      }
+    }
+
+    copy->setToken(new Token(*token));
+  }
+
+  for (const auto child : node->getChildren()) {
+    copy->appendChild(bindLiterals(child, literals, literal_slots, slot));
+  }
+
+  return copy;
+}
+
+std::shared_ptr<QueryCache::CachedQuery> QueryCache::lookup(
+    const std::string& key) {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+
+  auto iter = entries_.find(key);
+  if (iter == entries_.end()) {
+    ++num_misses_;
+    return std::shared_ptr<CachedQuery>(nullptr);
+  }
+
+  ++num_hits_;
+  lru_.splice(lru_.begin(), lru_, iter->second.second);
+  return iter->second.first;
+}
+
+void QueryCache::store(
+    const std::string& key,
+    std::shared_ptr<CachedQuery> query) {
+  if (max_entries_ == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+
+  if (entries_.count(key) > 0) {
+    return;
+  }
+
+  while (entries_.size() >= max_entries_) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+
+  lru_.push_front(key);
+  entries_.emplace(key, std::make_pair(query, lru_.begin()));
+}
+
+size_t QueryCache::size() const {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+  return entries_.size();
+}
+
+size_t QueryCache::numHits() const {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+  return num_hits_;
+}
+
+size_t QueryCache::numMisses() const {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+  return num_misses_;
+}
+
+}
+}
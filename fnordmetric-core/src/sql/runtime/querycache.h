@@ -0,0 +1,95 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_SQL_QUERYCACHE_H
+#define _FNORDMETRIC_SQL_QUERYCACHE_H
+#include <stdlib.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fnordmetric/sql/parser/astnode.h>
+#include <fnordmetric/sql/parser/token.h>
+
+namespace fnordmetric {
+namespace query {
+
+/**
+ * A bounded LRU cache of parsed statements. The cache is keyed by the
+ * normalized token stream of a query, i.e. the query text with all whitespace
+ * and all string and numeric literals removed. Queries that only differ in
+ * their literals (e.g. the time range of a dashboard query) share one entry;
+ * the literals of the current query are bound into the returned statements.
+ *
+ * A query cache is threadsafe.
+ */
+class QueryCache {
+public:
+  static const size_t kDefaultMaxEntries = 1024;
+
+  QueryCache(size_t max_entries = kDefaultMaxEntries);
+  QueryCache(const QueryCache& copy) = delete;
+  QueryCache& operator=(const QueryCache& copy) = delete;
+
+  /**
+   * Parse the query or return a copy of the cached statements for it. The
+   * returned statements are owned by the caller. This may raise an exception.
+   */
+  std::vector<std::unique_ptr<ASTNode>> parseQuery(const std::string& query);
+
+  size_t size() const;
+  size_t numHits() const;
+  size_t numMisses() const;
+
+protected:
+
+  struct CachedQuery {
+    std::vector<std::unique_ptr<ASTNode>> statements;
+
+    /**
+     * one entry per literal node in the statements (in pre-order): the index
+     * of the query literal to bind into the node or -1 to keep the token
+     */
+    std::vector<int> literal_slots;
+  };
+
+  static bool isLiteral(const Token& token);
+
+  static void buildLiteralSlots(
+      const ASTNode* node,
+      const std::vector<Token>& tokens,
+      const std::vector<int>& literal_indexes,
+      std::vector<int>* literal_slots);
+
+  static ASTNode* bindLiterals(
+      const ASTNode* node,
+      const std::vector<const Token*>& literals,
+      const std::vector<int>& literal_slots,
+      size_t* slot);
+
+  std::shared_ptr<CachedQuery> lookup(const std::string& key);
+  void store(const std::string& key, std::shared_ptr<CachedQuery> query);
+
+  const size_t max_entries_;
+  std::list<std::string> lru_;
+  std::unordered_map<
+      std::string,
+      std::pair<
+          std::shared_ptr<CachedQuery>,
+          std::list<std::string>::iterator>> entries_;
+  size_t num_hits_;
+  size_t num_misses_;
+  mutable std::mutex mutex_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,91 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <fnordmetric/sql/runtime/querycontext.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnordmetric {
+namespace query {
+
+static uint64_t monotonicMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+QueryContext::QueryContext() :
+    timeout_(0),
+    deadline_(0),
+    memory_limit_(0),
+    cancelled_(false),
+    memory_used_(0),
+    peak_memory_used_(0) {}
+
+void QueryContext::setTimeout(uint64_t timeout_micros) {
+  timeout_ = timeout_micros;
+  deadline_ = timeout_micros == 0 ? 0 : monotonicMicros() + timeout_micros;
+}
+
+void QueryContext::setMemoryLimit(size_t memory_limit) {
+  memory_limit_ = memory_limit;
+}
+
+void QueryContext::setCancellationCheck(std::function<bool ()> check) {
+  cancellation_check_ = check;
+}
+
+void QueryContext::cancel() {
+  cancelled_ = true;
+}
+
+void QueryContext::checkAlive() {
+  if (!cancelled_.load() && cancellation_check_ && cancellation_check_()) {
+    cancelled_ = true;
+  }
+
+  if (cancelled_.load()) {
+    RAISE(kRuntimeError, "query was cancelled");
+  }
+
+  if (deadline_ > 0 && monotonicMicros() > deadline_) {
+    RAISE(
+        kRuntimeError,
+        "query timed out after %llums",
+        (unsigned long long) (timeout_ / 1000));
+  }
+}
+
+void QueryContext::allocate(size_t bytes) {
+  auto used = (memory_used_ += bytes);
+
+  auto peak = peak_memory_used_.load();
+  while (used > peak && !peak_memory_used_.compare_exchange_weak(peak, used));
+
+  if (memory_limit_ > 0 && used > memory_limit_) {
+    RAISE(
+        kRuntimeError,
+        "query exceeded its memory limit of %zu bytes",
+        memory_limit_);
+  }
+}
+
+void QueryContext::release(size_t bytes) {
+  memory_used_ -= bytes;
+}
+
+size_t QueryContext::memoryUsed() const {
+  return memory_used_.load();
+}
+
+size_t QueryContext::peakMemoryUsed() const {
+  return peak_memory_used_.load();
+}
+
+}
+}
@@ -0,0 +1,101 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_SQL_RUNTIME_QUERYCONTEXT_H
+#define _FNORDMETRIC_SQL_RUNTIME_QUERYCONTEXT_H
+#include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+
+namespace fnordmetric {
+namespace query {
+
+/**
+ * Bounds the resources a single query may use. A query context is shared by
+ * all query plan nodes of one query and carries:
+ *
+ *   - a deadline after which the query is aborted
+ *   - a cancellation flag (e.g. set when the client disconnected)
+ *   - a memory accountant that all operators which buffer rows charge
+ *     against. A query that exceeds its memory limit is aborted
+ *
+ * Aborted queries raise a kRuntimeError from the thread that executes them.
+ * Table scans call checkAlive() every kCheckInterval rows, so a query is
+ * aborted shortly after it was cancelled or timed out.
+ *
+ * A query context is threadsafe.
+ */
+class QueryContext {
+public:
+  static const size_t kCheckInterval = 1024;
+
+  /**
+   * Create a new query context without a deadline and memory limit
+   */
+  QueryContext();
+
+  QueryContext(const QueryContext& copy) = delete;
+  QueryContext& operator=(const QueryContext& copy) = delete;
+
+  /**
+   * Abort the query once timeout_micros have passed from now. Zero means no
+   * deadline
+   */
+  void setTimeout(uint64_t timeout_micros);
+
+  /**
+   * Abort the query once it holds more than memory_limit bytes in buffers.
+   * Zero means no limit
+   */
+  void setMemoryLimit(size_t memory_limit);
+
+  /**
+   * Set a function that is polled by checkAlive() and returns true if the
+   * query should be cancelled. The function must be threadsafe
+   */
+  void setCancellationCheck(std::function<bool ()> check);
+
+  /**
+   * Cancel the query
+   */
+  void cancel();
+
+  /**
+   * Raises an exception if the query was cancelled or exceeded its deadline
+   */
+  void checkAlive();
+
+  /**
+   * Charge bytes against the query's memory limit. Raises an exception if the
+   * query exceeded its memory limit
+   */
+  void allocate(size_t bytes);
+
+  /**
+   * Release bytes that were previously charged with allocate()
+   */
+  void release(size_t bytes);
+
+  size_t memoryUsed() const;
+  size_t peakMemoryUsed() const;
+
+protected:
+  uint64_t timeout_;
+  uint64_t deadline_;
+  size_t memory_limit_;
+  std::atomic<bool> cancelled_;
+  std::atomic<size_t> memory_used_;
+  std::atomic<size_t> peak_memory_used_;
+  std::function<bool ()> cancellation_check_;
+};
+
+}
+}
+#endif
@@ -12,6 +12,7 @@
 #include <fnordmetric/sql/parser/astutil.h>
 #include <fnordmetric/sql/runtime/queryplanbuilder.h>
 #include <fnordmetric/sql/runtime/queryplannode.h>
+#include <fnordmetric/sql/runtime/explain.h>
 #include <fnordmetric/sql/runtime/tablelessselect.h>
 #include <fnordmetric/sql/runtime/tablescan.h>
 #include <fnordmetric/sql/runtime/tablerepository.h>
@@ -29,7 +30,17 @@ namespace query {
 QueryPlanBuilder::QueryPlanBuilder(
     Compiler* compiler,
     const std::vector<std::unique_ptr<Backend>>& backends) :
-    QueryPlanBuilderInterface(compiler, backends) {}
+    QueryPlanBuilderInterface(compiler, backends),
+    scheduler_(nullptr),
+    window_cache_(nullptr) {}
+
+void QueryPlanBuilder::setScheduler(fnord::thread::TaskScheduler* scheduler) {
+  scheduler_ = scheduler;
+}
+
+void QueryPlanBuilder::setWindowCache(WindowCache* window_cache) {
+  window_cache_ = window_cache;
+}
 
 void QueryPlanBuilder::buildQueryPlan(
     const std::vector<std::unique_ptr<ASTNode>>& statements,
@@ -37,7 +48,8 @@ void QueryPlanBuilder::buildQueryPlan(
 
   for (const auto& stmt : statements) {
     switch (stmt->getType()) {
-      case query::ASTNode::T_SELECT: {
+      case query::ASTNode::T_SELECT:
+      case query::ASTNode::T_EXPLAIN: {
         auto query_plan_node = buildQueryPlan(
             stmt.get(),
             query_plan->tableRepository());
@@ -69,6 +81,10 @@ QueryPlanNode* QueryPlanBuilder::buildQueryPlan(
     TableRepository* repo) {
   QueryPlanNode* exec = nullptr;
 
+  if (ast->getType() == ASTNode::T_EXPLAIN) {
+    return buildExplain(ast, repo);
+  }
+
   /* exapand all column names + wildcard to tablename->columnanme */
   if (hasUnexpandedColumns(ast)) {
     expandColumns(ast, repo);
@@ -115,6 +131,20 @@ QueryPlanNode* QueryPlanBuilder::buildQueryPlan(
   return nullptr;
 }
 
+QueryPlanNode* QueryPlanBuilder::buildExplain(
+    ASTNode* ast,
+    TableRepository* repo) {
+  if (ast->getChildren().size() != 1) {
+    RAISE(kRuntimeError, "corrupt AST");
+  }
+
+  auto child = buildQueryPlan(ast->getChildren()[0], repo);
+  auto analyze = ast->getToken() != nullptr &&
+      *ast->getToken() == Token::T_ANALYZE;
+
+  return new Explain(child, analyze);
+}
+
 bool QueryPlanBuilder::hasUnexpandedColumns(ASTNode* ast) const {
   if (ast->getType() != ASTNode::T_SELECT) {
     return false;
@@ -252,6 +282,33 @@ bool QueryPlanBuilder::hasAggregationExpression(ASTNode* ast) const {
   return false;
 }
 
+bool QueryPlanBuilder::hasOnlyMergeableAggregations(ASTNode* ast) const {
+  if (ast->getType() == ASTNode::T_METHOD_CALL) {
+    if (!(ast->getToken() != nullptr)) {
+      RAISE(kRuntimeError, "corrupt AST");
+    }
+
+    auto symbol = compiler_->symbolTable()->lookupSymbol
+        (ast->getToken()->getString());
+
+    if (symbol == nullptr) {
+      RAISE(kRuntimeError, "symbol lookup failed");
+    }
+
+    if (symbol->isAggregate() && !symbol->isMergeable()) {
+      return false;
+    }
+  }
+
+  for (const auto& child : ast->getChildren()) {
+    if (!hasOnlyMergeableAggregations(child)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void QueryPlanBuilder::expandColumns(ASTNode* ast, TableRepository* repo) {
   if (ast->getChildren().size() < 2) {
     RAISE(kRuntimeError, "corrupt AST");
@@ -371,7 +428,9 @@ QueryPlanNode* QueryPlanBuilder::buildGroupBy(
       select_expr,
       group_expr,
       select_scratchpad_len,
-      buildQueryPlan(child_ast, repo));
+      buildQueryPlan(child_ast, repo),
+      hasOnlyMergeableAggregations(select_list),
+      scheduler_);
 }
 
 QueryPlanNode* QueryPlanBuilder::buildGroupOverTimewindow(
@@ -483,6 +542,15 @@ QueryPlanNode* QueryPlanBuilder::buildGroupOverTimewindow(
   /* resolve output column names */
   auto column_names = ASTUtil::columnNamesFromSelectList(select_list);
 
+  /* the where clause is identified by the fingerprint of the table scan,
+     which ignores the time range of the query (see TableScan::timeRange) */
+  std::set<const ASTNode*> where_clauses;
+  for (const auto& child : ast->getChildren()) {
+    if (child != nullptr && child->getType() == ASTNode::T_WHERE) {
+      where_clauses.insert(child);
+    }
+  }
+
   return new GroupOverTimewindow(
       std::move(column_names),
       time_expr,
@@ -493,7 +561,10 @@ QueryPlanNode* QueryPlanBuilder::buildGroupOverTimewindow(
       select_expr,
       group_expr,
       select_scratchpad_len,
-      buildQueryPlan(child_ast, repo));
+      buildQueryPlan(child_ast, repo),
+      hasOnlyMergeableAggregations(select_list),
+      window_cache_,
+      ASTUtil::fingerprint(ast, where_clauses));
 }
 
 bool QueryPlanBuilder::buildInternalSelectList(
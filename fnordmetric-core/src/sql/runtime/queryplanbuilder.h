@@ -18,12 +18,14 @@
 #include <fnordmetric/sql/parser/astnode.h>
 #include <fnordmetric/sql/runtime/queryplan.h>
 #include <fnordmetric/sql/runtime/compile.h>
+#include <fnordmetric/thread/taskscheduler.h>
 
 namespace fnordmetric {
 namespace query {
 class QueryPlanNode;
 class TableRepository;
 class Runtime;
+class WindowCache;
 
 /**
  * All QueryPlanBuilder imeplementations must be thread safe. Specifically they
@@ -65,6 +67,19 @@ public:
 
   void extend(std::unique_ptr<QueryPlanBuilderInterface> other);
 
+  /**
+   * Set the scheduler on which partitioned table scans are executed in
+   * parallel. If no scheduler is set (the default) all scans are executed on
+   * the calling thread
+   */
+  void setScheduler(fnord::thread::TaskScheduler* scheduler);
+
+  /**
+   * Set the cache from which closed GROUP OVER TIMEWINDOW windows are served.
+   * If no window cache is set (the default) all windows are recomputed
+   */
+  void setWindowCache(WindowCache* window_cache);
+
 protected:
 
   /**
@@ -108,6 +123,12 @@ protected:
    */
   bool hasAggregationExpression(ASTNode* ast) const;
 
+  /**
+   * Walks the ast recursively and returns true if all aggregation expressions
+   * that were found support merging partial aggregations, otherwise false.
+   */
+  bool hasOnlyMergeableAggregations(ASTNode* ast) const;
+
   /**
    * Build a group by query plan node for a SELECT statement that has a GROUP
    * BY clause
@@ -136,10 +157,17 @@ protected:
    */
   bool buildInternalSelectList(ASTNode* ast, ASTNode* select_list);
 
+  /**
+   * Build an explain query plan node for an EXPLAIN [ANALYZE] statement
+   */
+  QueryPlanNode* buildExplain(ASTNode* ast, TableRepository* repo);
+
   QueryPlanNode* buildLimitClause(ASTNode* ast, TableRepository* repo);
   QueryPlanNode* buildOrderByClause(ASTNode* ast, TableRepository* repo);
 
   std::vector<std::unique_ptr<QueryPlanBuilderInterface>> extensions_;
+  fnord::thread::TaskScheduler* scheduler_;
+  WindowCache* window_cache_;
 };
 
 }
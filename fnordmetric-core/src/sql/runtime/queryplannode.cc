@@ -10,12 +10,51 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
+#include <chrono>
 #include "queryplannode.h"
 
 namespace fnordmetric {
 namespace query {
 
-QueryPlanNode::QueryPlanNode() : target_(nullptr) {}
+static uint64_t monotonicMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t threadCPUMicros() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+
+  return ts.tv_sec * 1000000llu + ts.tv_nsec / 1000;
+}
+
+QueryPlanNode::SharedStats::SharedStats() :
+    rows_in(0),
+    rows_out(0),
+    wall_micros(0),
+    cpu_micros(0),
+    bytes_read(0),
+    tables_opened(0),
+    tables_skipped(0) {}
+
+QueryPlanNode::ExecutionTimer::ExecutionTimer(const QueryPlanNode* node) :
+    stats_(node->stats_),
+    wall_begin_(monotonicMicros()),
+    cpu_begin_(threadCPUMicros()) {}
+
+QueryPlanNode::ExecutionTimer::~ExecutionTimer() {
+  stats_->wall_micros += monotonicMicros() - wall_begin_;
+  stats_->cpu_micros += threadCPUMicros() - cpu_begin_;
+}
+
+QueryPlanNode::QueryPlanNode() :
+    target_(nullptr),
+    context_(nullptr),
+    rows_out_(0),
+    stats_(new SharedStats()) {}
 
 QueryPlanNode::~QueryPlanNode() {}
 
@@ -23,11 +62,62 @@ void QueryPlanNode::setTarget(RowSink* target) {
   target_ = target;
 }
 
+void QueryPlanNode::setContext(QueryContext* context) {
+  context_ = context;
+
+  for (auto child : children_) {
+    child->setContext(context);
+  }
+}
+
+QueryContext* QueryPlanNode::context() const {
+  return context_;
+}
+
+void QueryPlanNode::addChild(QueryPlanNode* child) {
+  children_.emplace_back(child);
+}
+
+const std::vector<QueryPlanNode*>& QueryPlanNode::children() const {
+  return children_;
+}
+
+QueryPlanNode::Stats QueryPlanNode::getStats() const {
+  Stats stats;
+  stats.rows_in = stats_->rows_in;
+  stats.rows_out = rows_out_ + stats_->rows_out;
+  stats.wall_micros = stats_->wall_micros;
+  stats.cpu_micros = stats_->cpu_micros;
+  stats.bytes_read = stats_->bytes_read;
+  stats.tables_opened = stats_->tables_opened;
+  stats.tables_skipped = stats_->tables_skipped;
+
+  for (auto child : children_) {
+    stats.rows_in += child->getStats().rows_out;
+  }
+
+  return stats;
+}
+
+void QueryPlanNode::allocateRow(const SValue* row, int row_len) {
+  if (context_ == nullptr) {
+    return;
+  }
+
+  size_t bytes = sizeof(std::vector<SValue>);
+  for (int i = 0; i < row_len; ++i) {
+    bytes += row[i].getMemoryUsage();
+  }
+
+  context_->allocate(bytes);
+}
+
 bool QueryPlanNode::emitRow(SValue* row, int row_len) {
   if (target_ == nullptr) {
     RAISE(kRuntimeError, "QueryPlanNode has no target");
   }
 
+  ++rows_out_;
   return target_->nextRow(row, row_len);
 }
 
@@ -11,12 +11,16 @@
 #ifndef _FNORDMETRIC_SQL_QUERYPLANNODE_H
 #define _FNORDMETRIC_SQL_QUERYPLANNODE_H
 #include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 #include <assert.h>
 #include <fnordmetric/sql/svalue.h>
 #include <fnordmetric/sql/parser/token.h>
 #include <fnordmetric/sql/parser/astnode.h>
+#include <fnordmetric/sql/runtime/querycontext.h>
 #include <fnordmetric/sql/runtime/rowsink.h>
 
 namespace fnordmetric {
@@ -24,6 +28,23 @@ namespace query {
 
 class QueryPlanNode : public RowSink {
 public:
+
+  /**
+   * Execution statistics of a node (see EXPLAIN ANALYZE). Times include the
+   * time spent in the node's children. The cpu time only includes the time
+   * spent on the thread that executed the node (and for partitioned table
+   * scans, the time of all partitions)
+   */
+  struct Stats {
+    uint64_t rows_in;
+    uint64_t rows_out;
+    uint64_t wall_micros;
+    uint64_t cpu_micros;
+    uint64_t bytes_read;
+    uint64_t tables_opened;
+    uint64_t tables_skipped;
+  };
+
   QueryPlanNode();
   virtual ~QueryPlanNode();
 
@@ -32,12 +53,76 @@ public:
   virtual const std::vector<std::string>& getColumns() const = 0;
   int getColumnIndex(const std::string& column_name) const;
 
+  /**
+   * Returns a one line description of this node (see EXPLAIN)
+   */
+  virtual std::string toString() const = 0;
+
   void setTarget(RowSink* target);
   void finish() override;
 
+  /**
+   * Set the context that bounds the execution of this node and all of its
+   * children
+   */
+  void setContext(QueryContext* context);
+  QueryContext* context() const;
+
+  const std::vector<QueryPlanNode*>& children() const;
+
+  /**
+   * Returns the execution statistics of this node. The number of input rows
+   * defaults to the number of rows that were emitted by the node's children
+   */
+  virtual Stats getStats() const;
+
 protected:
+
+  struct SharedStats {
+    SharedStats();
+    std::atomic<uint64_t> rows_in;
+    std::atomic<uint64_t> rows_out;
+    std::atomic<uint64_t> wall_micros;
+    std::atomic<uint64_t> cpu_micros;
+    std::atomic<uint64_t> bytes_read;
+    std::atomic<uint64_t> tables_opened;
+    std::atomic<uint64_t> tables_skipped;
+  };
+
+  /**
+   * Adds the wall and cpu time that passed while it was alive to a node's
+   * stats. Every execute() implementation starts with an ExecutionTimer
+   */
+  class ExecutionTimer {
+  public:
+    ExecutionTimer(const QueryPlanNode* node);
+    ~ExecutionTimer();
+  protected:
+    std::shared_ptr<SharedStats> stats_;
+    uint64_t wall_begin_;
+    uint64_t cpu_begin_;
+  };
+
+  /**
+   * Register a child node. Does not transfer ownership
+   */
+  void addChild(QueryPlanNode* child);
+
   bool emitRow(SValue* row, int row_len);
+
+  /**
+   * Charge a row that is buffered by this node against the query's memory
+   * limit (see QueryContext::allocate)
+   */
+  void allocateRow(const SValue* row, int row_len);
+
   RowSink* target_;
+  QueryContext* context_;
+  std::vector<QueryPlanNode*> children_;
+  uint64_t rows_out_;
+
+  /* shared by all copies of a node, e.g. the partitions of a table scan */
+  std::shared_ptr<SharedStats> stats_;
 };
 
 }
@@ -13,6 +13,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <fnordmetric/sql/runtime/querycontext.h>
 #include <fnordmetric/sql/runtime/rowsink.h>
 #include <fnordmetric/sql/svalue.h>
 
@@ -21,13 +22,22 @@ namespace query {
 
 class ResultList : public RowSink {
 public:
-  ResultList() {}
+  ResultList() : context_(nullptr) {}
   ResultList(const ResultList& copy) = delete;
   ResultList& operator=(const ResultList& copy) = delete;
 
   ResultList(ResultList&& move) :
       columns_(std::move(move.columns_)),
-      rows_(std::move(move.rows_)) {}
+      rows_(std::move(move.rows_)),
+      context_(move.context_) {}
+
+  /**
+   * Charge all rows that are added to this result list against the query's
+   * memory limit (see QueryContext::allocate)
+   */
+  void setContext(QueryContext* context) {
+    context_ = context;
+  }
 
   size_t getNumColumns() const {
     return columns_.size();
@@ -72,10 +82,18 @@ public:
   }
 
   bool nextRow(query::SValue* row, int row_len) override {
+    size_t bytes = sizeof(std::vector<std::string>);
+
     addRow();
     for (int i = 0; i < row_len; ++i) {
       addColumn(row[i].toString());
+      bytes += sizeof(std::string) + rows_.back().back().size();
     }
+
+    if (context_ != nullptr) {
+      context_->allocate(bytes);
+    }
+
     return true;
   }
 
@@ -121,6 +139,7 @@ public:
 protected:
   std::vector<std::string> columns_;
   std::vector<std::vector<std::string>> rows_;
+  QueryContext* context_;
 };
 
 }
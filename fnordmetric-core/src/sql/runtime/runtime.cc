@@ -34,9 +34,18 @@ Compiler* Runtime::compiler() {
   return &compiler_;
 }
 
+std::vector<std::unique_ptr<ASTNode>> Runtime::parseQuery(
+    const std::string& query) {
+  return query_cache_.parseQuery(query);
+}
+
 Parser* Runtime::parser() {
   return &parser_;
 }
 
+QueryCache* Runtime::queryCache() {
+  return &query_cache_;
+}
+
 }
 }
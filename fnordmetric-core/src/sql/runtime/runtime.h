@@ -16,6 +16,7 @@
 #include <fnordmetric/sql/parser/astnode.h>
 #include <fnordmetric/sql/parser/parser.h>
 #include <fnordmetric/sql/runtime/compile.h>
+#include <fnordmetric/sql/runtime/querycache.h>
 #include <fnordmetric/sql/runtime/queryplan.h>
 #include <fnordmetric/sql/runtime/queryplanbuilder.h>
 
@@ -24,7 +25,9 @@ namespace query {
 class ResultList;
 
 /**
- * A runtime can only be used within a a single thread!
+ * Once all backends are added, a runtime may be used from many threads
+ * concurrently. The only exception is the parser, which can only be used
+ * within a single thread!
  */
 class Runtime {
 public:
@@ -32,13 +35,21 @@ public:
 
   void addBackend(std::unique_ptr<Backend> backend);
 
+  /**
+   * Parse the query using the query cache. The returned statements are owned
+   * by the caller. This may raise an exception.
+   */
+  std::vector<std::unique_ptr<ASTNode>> parseQuery(const std::string& query);
+
   Parser* parser();
+  QueryCache* queryCache();
   Compiler* compiler();
   const std::vector<std::unique_ptr<Backend>>& backends();
   QueryPlanBuilder* queryPlanBuilder();
 
 protected:
   Parser parser_;
+  QueryCache query_cache_;
   SymbolTable symbol_table_;
   Compiler compiler_;
   std::vector<std::unique_ptr<Backend>> backends_;
@@ -55,6 +55,32 @@ void SymbolTable::registerSymbol(
               free_method)));
 }
 
+void SymbolTable::registerSymbol(
+    const std::string& symbol,
+    void (*method)(void*, int, SValue*, SValue*),
+    size_t scratchpad_size,
+    void (*free_method)(void*),
+    void (*merge_method)(void*, const void*),
+    void (*result_method)(void*, SValue*)) {
+  std::string symbol_downcase = symbol;
+  std::transform(
+      symbol_downcase.begin(),
+      symbol_downcase.end(),
+      symbol_downcase.begin(),
+      ::tolower);
+
+  symbols_.emplace(
+      std::make_pair(
+          symbol_downcase,
+          SymbolTableEntry(
+              symbol_downcase,
+              method,
+              scratchpad_size,
+              free_method,
+              merge_method,
+              result_method)));
+}
+
 SymbolTableEntry const* SymbolTable::lookupSymbol(const std::string& symbol)
     const {
   std::string symbol_downcase = symbol;
@@ -79,7 +105,24 @@ SymbolTableEntry::SymbolTableEntry(
     void (*method)(void*, int, SValue*, SValue*),
     size_t scratchpad_size,
     void (*free_method)(void*)) :
+    SymbolTableEntry(
+        symbol,
+        method,
+        scratchpad_size,
+        free_method,
+        nullptr,
+        nullptr) {}
+
+SymbolTableEntry::SymbolTableEntry(
+    const std::string& symbol,
+    void (*method)(void*, int, SValue*, SValue*),
+    size_t scratchpad_size,
+    void (*free_method)(void*),
+    void (*merge_method)(void*, const void*),
+    void (*result_method)(void*, SValue*)) :
     call_(method),
+    merge_(merge_method),
+    result_(result_method),
     scratchpad_size_(scratchpad_size) {}
 
 SymbolTableEntry::SymbolTableEntry(
@@ -91,10 +134,22 @@ bool SymbolTableEntry::isAggregate() const {
   return scratchpad_size_ > 0;
 }
 
+bool SymbolTableEntry::isMergeable() const {
+  return merge_ != nullptr && result_ != nullptr;
+}
+
 void (*SymbolTableEntry::getFnPtr() const)(void*, int, SValue*, SValue*) {
   return call_;
 }
 
+void (*SymbolTableEntry::getMergeFnPtr() const)(void*, const void*) {
+  return merge_;
+}
+
+void (*SymbolTableEntry::getResultFnPtr() const)(void*, SValue*) {
+  return result_;
+}
+
 size_t SymbolTableEntry::getScratchpadSize() const {
   return scratchpad_size_;
 }
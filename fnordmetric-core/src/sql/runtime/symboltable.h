@@ -32,16 +32,35 @@ public:
       size_t scratchpad_size,
       void (*free_method)(void*));
 
+  /**
+   * Register an aggregate function whose scratchpad can be merged with
+   * another scratchpad of the same function (partial aggregation). The result
+   * method must write the current result of the scratchpad to out without
+   * consuming any input.
+   */
+  SymbolTableEntry(
+      const std::string& symbol,
+      void (*method)(void*, int, SValue*, SValue*),
+      size_t scratchpad_size,
+      void (*free_method)(void*),
+      void (*merge_method)(void*, const void*),
+      void (*result_method)(void*, SValue*));
+
   inline void call(void* scratchpad, int argc, SValue* argv, SValue* out) const {
     call_(scratchpad, argc, argv, out);
   }
 
   bool isAggregate() const;
+  bool isMergeable() const;
   void (*getFnPtr() const)(void*, int, SValue*, SValue*);
+  void (*getMergeFnPtr() const)(void*, const void*);
+  void (*getResultFnPtr() const)(void*, SValue*);
   size_t getScratchpadSize() const;
 
 protected:
   void (*call_)(void*, int, SValue*, SValue*);
+  void (*merge_)(void*, const void*);
+  void (*result_)(void*, SValue*);
   const size_t scratchpad_size_;
 };
 
@@ -59,6 +78,14 @@ public:
       size_t scratchpad_size,
       void (*free_method)(void*));
 
+  void registerSymbol(
+      const std::string& symbol,
+      void (*method)(void*, int, SValue*, SValue*),
+      size_t scratchpad_size,
+      void (*free_method)(void*),
+      void (*merge_method)(void*, const void*),
+      void (*result_method)(void*, SValue*));
+
 protected:
   std::unordered_map<std::string, SymbolTableEntry> symbols_;
 };
@@ -54,6 +54,7 @@ public:
       expression_(expression) {}
 
   void execute() override {
+    ExecutionTimer timer(this);
     SValue row[128]; // FIXPAUL
     int row_len;
 
@@ -74,6 +75,10 @@ public:
     return columns_;
   }
 
+  std::string toString() const override {
+    return "TablelessSelect";
+  }
+
 protected:
   const std::vector<std::string> columns_;
   CompiledExpression* expression_;
@@ -9,6 +9,8 @@
  */
 #include <fnordmetric/sql/parser/astutil.h>
 #include <fnordmetric/sql/runtime/tablescan.h>
+#include <fnordmetric/sql/svalue.h>
+#include <limits>
 
 namespace fnordmetric {
 namespace query {
@@ -89,6 +91,10 @@ TableScan* TableScan::build(
 
   /* get where expression */
   CompiledExpression* where_expr = nullptr;
+  std::vector<std::pair<int, std::string>> equality_constraints;
+  uint64_t range_begin = 0;
+  uint64_t range_end = std::numeric_limits<uint64_t>::max();
+  std::string where_fingerprint;
   if (ast->getChildren().size() > 2) {
     ASTNode* where_clause = ast->getChildren()[2];
     if (!(where_clause)) {
@@ -113,6 +119,21 @@ TableScan* TableScan::build(
       return nullptr;
     }
 
+    findEqualityConstraints(e, &equality_constraints);
+
+    std::set<const ASTNode*> range_nodes;
+    findTimeRangeConstraints(
+        e,
+        tbl_ref->getTimeColumnIndex(),
+        compiler,
+        &range_begin,
+        &range_end,
+        &range_nodes);
+
+    if (range_nodes.count(e) == 0) {
+      where_fingerprint = ASTUtil::fingerprint(e, range_nodes);
+    }
+
     size_t where_scratchpad_len = 0;
     where_expr = compiler->compile(e, &where_scratchpad_len);
     if (where_scratchpad_len != 0) {
@@ -122,28 +143,136 @@ TableScan* TableScan::build(
     }
   }
 
-  return new TableScan(
+  auto scan = new TableScan(
+      tbl_name_token->getString(),
       tbl_ref,
       std::move(column_names),
       select_expr,
       where_expr);
+
+  scan->equality_constraints_ = std::move(equality_constraints);
+  scan->time_range_begin_constraint_ = range_begin;
+  scan->time_range_end_constraint_ = range_end;
+  scan->where_fingerprint_ = std::move(where_fingerprint);
+  return scan;
 }
 
 TableScan::TableScan(
+    const std::string& table_name,
     TableRef* tbl_ref,
     std::vector<std::string>&& columns,
     CompiledExpression* select_expr,
     CompiledExpression* where_expr):
+    table_name_(table_name),
     tbl_ref_(tbl_ref),
     columns_(std::move(columns)),
     select_expr_(select_expr),
-    where_expr_(where_expr) {}
+    where_expr_(where_expr),
+    time_range_begin_(0),
+    time_range_begin_constraint_(0),
+    time_range_end_constraint_(std::numeric_limits<uint64_t>::max()),
+    rows_scanned_(0) {}
 
 void TableScan::execute() {
+  ExecutionTimer timer(this);
+
+  if (context_ != nullptr) {
+    context_->checkAlive();
+  }
+
   tbl_ref_->executeScan(this);
   finish();
 }
 
+void TableScan::partition(
+    std::vector<std::function<void (RowSink* target)>>* partitions) {
+  std::vector<std::function<void (TableScan* scan)>> table_partitions;
+  tbl_ref_->partitionScan(&table_partitions);
+
+  for (const auto& table_partition : table_partitions) {
+    partitions->emplace_back([this, table_partition] (RowSink* target) {
+      if (context_ != nullptr) {
+        context_->checkAlive();
+      }
+
+      ExecutionTimer timer(this);
+      TableScan scan(*this);
+      scan.rows_out_ = 0;
+      scan.rows_scanned_ = 0;
+      scan.setTarget(target);
+      table_partition(&scan);
+
+      /* the copy's row counters are lost when it goes out of scope */
+      stats_->rows_in += scan.rows_scanned_;
+      stats_->rows_out += scan.rows_out_;
+    });
+  }
+}
+
+void TableScan::setTimeRangeBegin(uint64_t time_begin) {
+  time_range_begin_ = time_begin;
+}
+
+uint64_t TableScan::timeRangeBegin() const {
+  return time_range_begin_;
+}
+
+const std::vector<std::pair<int, std::string>>&
+    TableScan::equalityConstraints() const {
+  return equality_constraints_;
+}
+
+void TableScan::timeRange(uint64_t* begin, uint64_t* end) const {
+  *begin = time_range_begin_constraint_;
+  *end = time_range_end_constraint_;
+}
+
+const std::string& TableScan::whereFingerprint() const {
+  return where_fingerprint_;
+}
+
+bool TableScan::isTimeColumn(size_t index) const {
+  auto time_column = tbl_ref_->getTimeColumnIndex();
+  if (time_column < 0) {
+    return false;
+  }
+
+  auto col = select_expr_->child;
+  for (int i = 0; col != nullptr && i < index; ++i) {
+    col = col->next;
+  }
+
+  return
+      col != nullptr &&
+      col->type == X_INPUT &&
+      reinterpret_cast<uint64_t>(col->arg0) == time_column;
+}
+
+TableRef* TableScan::tableRef() const {
+  return tbl_ref_;
+}
+
+void TableScan::addScanStats(
+    uint64_t bytes_read,
+    uint64_t tables_opened,
+    uint64_t tables_skipped) {
+  stats_->bytes_read += bytes_read;
+  stats_->tables_opened += tables_opened;
+  stats_->tables_skipped += tables_skipped;
+}
+
+QueryPlanNode::Stats TableScan::getStats() const {
+  auto stats = QueryPlanNode::getStats();
+  stats.rows_in += rows_scanned_;
+  return stats;
+}
+
+std::string TableScan::toString() const {
+  return "TableScan(table=" + table_name_ +
+      ", where=" + (where_expr_ == nullptr ? "no" : "yes") +
+      ", time_range_begin=" + std::to_string(time_range_begin_) + ")";
+}
+
 bool TableScan::nextRow(SValue* row, int row_len) {
   auto pred_bool = true;
   auto continue_bool = true;
@@ -151,6 +280,12 @@ bool TableScan::nextRow(SValue* row, int row_len) {
   SValue out[128]; // FIXPAUL
   int out_len;
 
+  /* abort the scan if the query was cancelled or timed out */
+  if (++rows_scanned_ % QueryContext::kCheckInterval == 0 &&
+      context_ != nullptr) {
+    context_->checkAlive();
+  }
+
   if (where_expr_ != nullptr) {
     executeExpression(where_expr_, nullptr, row_len, row, &out_len, out);
 
@@ -255,5 +390,173 @@ bool TableScan::resolveColumns(
   }
 }
 
+/* collect the "column = 'string'" conditions of a conjunction */
+void TableScan::findEqualityConstraints(
+    ASTNode* node,
+    std::vector<std::pair<int, std::string>>* constraints) {
+  if (*node == ASTNode::T_AND_EXPR) {
+    for (const auto& child : node->getChildren()) {
+      if (child != nullptr) {
+        findEqualityConstraints(child, constraints);
+      }
+    }
+
+    return;
+  }
+
+  if (!(*node == ASTNode::T_EQ_EXPR) || node->getChildren().size() != 2) {
+    return;
+  }
+
+  auto column = node->getChildren()[0];
+  auto literal = node->getChildren()[1];
+  if (column == nullptr || literal == nullptr) {
+    return;
+  }
+
+  if (*column == ASTNode::T_LITERAL) {
+    std::swap(column, literal);
+  }
+
+  if (!(*column == ASTNode::T_RESOLVED_COLUMN) ||
+      !(*literal == ASTNode::T_LITERAL)) {
+    return;
+  }
+
+  auto token = literal->getToken();
+  if (token == nullptr || !(*token == Token::T_STRING)) {
+    return;
+  }
+
+  /* strings that look like numbers are compared as numbers and missing
+     values compare equal to 'NULL' (see eqExpr) */
+  SValue value(token->getString());
+  if (value.testTypeWithNumericConversion() != SValue::T_STRING ||
+      token->getString() == "NULL") {
+    return;
+  }
+
+  constraints->emplace_back(column->getID(), token->getString());
+}
+
+/* returns true if the expression doesn't reference any column */
+static bool isConstExpression(ASTNode* node) {
+  if (*node == ASTNode::T_COLUMN_NAME ||
+      *node == ASTNode::T_RESOLVED_COLUMN) {
+    return false;
+  }
+
+  for (const auto& child : node->getChildren()) {
+    if (child != nullptr && !isConstExpression(child)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* collect the "time < <const timestamp>" conditions of a conjunction */
+void TableScan::findTimeRangeConstraints(
+    ASTNode* node,
+    int time_column,
+    Compiler* compiler,
+    uint64_t* begin,
+    uint64_t* end,
+    std::set<const ASTNode*>* range_nodes) {
+  if (time_column < 0) {
+    return;
+  }
+
+  if (*node == ASTNode::T_AND_EXPR) {
+    for (const auto& child : node->getChildren()) {
+      if (child != nullptr) {
+        findTimeRangeConstraints(
+            child,
+            time_column,
+            compiler,
+            begin,
+            end,
+            range_nodes);
+      }
+    }
+
+    return;
+  }
+
+  auto type = node->getType();
+  if ((type != ASTNode::T_LT_EXPR &&
+       type != ASTNode::T_LTE_EXPR &&
+       type != ASTNode::T_GT_EXPR &&
+       type != ASTNode::T_GTE_EXPR) ||
+      node->getChildren().size() != 2) {
+    return;
+  }
+
+  auto column = node->getChildren()[0];
+  auto expr = node->getChildren()[1];
+  if (column == nullptr || expr == nullptr) {
+    return;
+  }
+
+  /* "<const> < time" is "time > <const>" */
+  if (!(*column == ASTNode::T_RESOLVED_COLUMN)) {
+    std::swap(column, expr);
+    switch (type) {
+      case ASTNode::T_LT_EXPR: type = ASTNode::T_GT_EXPR; break;
+      case ASTNode::T_LTE_EXPR: type = ASTNode::T_GTE_EXPR; break;
+      case ASTNode::T_GT_EXPR: type = ASTNode::T_LT_EXPR; break;
+      case ASTNode::T_GTE_EXPR: type = ASTNode::T_LTE_EXPR; break;
+      default: break;
+    }
+  }
+
+  if (!(*column == ASTNode::T_RESOLVED_COLUMN) ||
+      column->getID() != time_column ||
+      !isConstExpression(expr)) {
+    return;
+  }
+
+  uint64_t time;
+  try {
+    auto value = executeSimpleConstExpression(compiler, expr);
+    if (value.getType() != SValue::T_TIMESTAMP) {
+      return;
+    }
+
+    time = static_cast<uint64_t>(value.getTimestamp());
+  } catch (const std::exception& e) {
+    return;
+  }
+
+  switch (type) {
+    case ASTNode::T_GT_EXPR:
+      if (time == std::numeric_limits<uint64_t>::max()) {
+        return;
+      }
+      *begin = std::max(*begin, time + 1);
+      break;
+
+    case ASTNode::T_GTE_EXPR:
+      *begin = std::max(*begin, time);
+      break;
+
+    case ASTNode::T_LT_EXPR:
+      *end = std::min(*end, time);
+      break;
+
+    case ASTNode::T_LTE_EXPR:
+      if (time == std::numeric_limits<uint64_t>::max()) {
+        return;
+      }
+      *end = std::min(*end, time + 1);
+      break;
+
+    default:
+      return;
+  }
+
+  range_nodes->insert(node);
+}
+
 }
 }
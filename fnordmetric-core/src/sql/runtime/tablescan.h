@@ -10,6 +10,8 @@
 #ifndef _FNORDMETRIC_QUERY_TABLELESCAN_H
 #define _FNORDMETRIC_QUERY_TABLELESCAN_H
 #include <stdlib.h>
+#include <functional>
+#include <set>
 #include <string>
 #include <vector>
 #include <assert.h>
@@ -33,6 +35,7 @@ public:
       Compiler* compiler);
 
   TableScan(
+      const std::string& table_name,
       TableRef* tbl_ref,
       std::vector<std::string>&& columns,
       CompiledExpression* select_expr,
@@ -40,17 +43,97 @@ public:
 
   void execute() override;
   bool nextRow(SValue* row, int row_len) override;
+
+  /**
+   * Split this scan into independent partitions (see TableRef::partitionScan).
+   * Each partition may be executed from a different thread and emits its rows
+   * into the provided target. finish() is not called on the target.
+   */
+  void partition(std::vector<std::function<void (RowSink* target)>>* partitions);
+
+  /**
+   * Restrict the scan to rows with a time >= time_begin. This is only a hint;
+   * tables that do not support time range scans return all rows
+   */
+  void setTimeRangeBegin(uint64_t time_begin);
+  uint64_t timeRangeBegin() const;
+
+  /**
+   * Returns the column index and value of every "column = 'string'"
+   * condition that all rows matching the where expression satisfy. This is
+   * only a hint; the where expression is still evaluated for every row
+   */
+  const std::vector<std::pair<int, std::string>>& equalityConstraints() const;
+
+  /**
+   * Stores the time range [begin, end) that all rows matching the where
+   * expression are in, derived from the "time < <const timestamp>" (or <=, >,
+   * >=) conditions on the time column. The range is [0, UINT64_MAX) if there
+   * are no such conditions
+   */
+  void timeRange(uint64_t* begin, uint64_t* end) const;
+
+  /**
+   * Returns the fingerprint of the where expression without the conditions
+   * that were used to compute the time range (see timeRange), i.e. two scans
+   * of the same table with the same fingerprint only differ in their range
+   */
+  const std::string& whereFingerprint() const;
+
+  /**
+   * Returns true if the output column with the provided index is the time
+   * column of a time series table
+   */
+  bool isTimeColumn(size_t index) const;
+
+  TableRef* tableRef() const;
+
+  /**
+   * Called by the table to report how much it read from storage during the
+   * scan (see EXPLAIN ANALYZE)
+   */
+  void addScanStats(
+      uint64_t bytes_read,
+      uint64_t tables_opened,
+      uint64_t tables_skipped);
+
   size_t getNumCols() const override;
   const std::vector<std::string>& getColumns() const override;
+  std::string toString() const override;
+
+  /**
+   * The number of input rows is the number of rows read from the table,
+   * including the ones that didn't match the where expression
+   */
+  Stats getStats() const override;
 
 protected:
 
   static bool resolveColumns(ASTNode* node, ASTNode* parent, TableRef* tbl_ref);
 
+  static void findEqualityConstraints(
+      ASTNode* node,
+      std::vector<std::pair<int, std::string>>* constraints);
+
+  static void findTimeRangeConstraints(
+      ASTNode* node,
+      int time_column,
+      Compiler* compiler,
+      uint64_t* begin,
+      uint64_t* end,
+      std::set<const ASTNode*>* range_nodes);
+
+  const std::string table_name_;
   TableRef* const tbl_ref_;
   const std::vector<std::string> columns_;
   CompiledExpression* const select_expr_;
   CompiledExpression* const where_expr_;
+  uint64_t time_range_begin_;
+  std::vector<std::pair<int, std::string>> equality_constraints_;
+  uint64_t time_range_begin_constraint_;
+  uint64_t time_range_end_constraint_;
+  std::string where_fingerprint_;
+  uint64_t rows_scanned_;
 };
 
 }
@@ -0,0 +1,182 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <fnordmetric/sql/runtime/windowcache.h>
+
+namespace fnordmetric {
+namespace query {
+
+WindowCache::WindowCache(
+    size_t max_entries /* = kDefaultMaxEntries */,
+    uint64_t grace_period_micros /* = kDefaultGracePeriodMicros */) :
+    max_entries_(max_entries),
+    grace_period_micros_(grace_period_micros),
+    num_entries_(0) {}
+
+uint64_t WindowCache::lateRowSequence(const std::string& series) {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+
+  auto iter = series_.find(series);
+  if (iter == series_.end()) {
+    return 0;
+  }
+
+  return iter->second.late_row_seq;
+}
+
+uint64_t WindowCache::fetch(
+    const std::string& series,
+    uint64_t late_rows_min_time,
+    uint64_t late_row_seq,
+    uint64_t window_micros,
+    uint64_t* covered_from,
+    WindowList* windows) {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+
+  auto iter = series_.find(series);
+  if (iter == series_.end()) {
+    return 0;
+  }
+
+  auto& s = iter->second;
+  lru_.splice(lru_.begin(), lru_, s.lru_pos);
+
+  /* drop all windows that may contain late rows */
+  if (late_rows_min_time < s.covered_until) {
+    s.covered_until = late_rows_min_time;
+
+    while (!s.windows.empty()) {
+      auto last = s.windows.end();
+      --last;
+
+      if (last->first + window_micros <= late_rows_min_time) {
+        break;
+      }
+
+      s.num_entries -= last->second->size();
+      num_entries_ -= last->second->size();
+      s.windows.erase(last);
+    }
+  }
+
+  s.late_row_seq = late_row_seq;
+  if (s.covered_until <= s.covered_from) {
+    return 0;
+  }
+
+  *covered_from = s.covered_from;
+  *windows = s.windows;
+  return s.covered_until;
+}
+
+void WindowCache::store(
+    const std::string& series,
+    const WindowList& windows,
+    uint64_t window_micros,
+    uint64_t covered_from,
+    uint64_t covered_until) {
+  if (max_entries_ == 0 || covered_until <= covered_from) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+
+  auto s = getSeries(series);
+
+  /* the union of both ranges is only covered if every window in it is in
+     one of them, i.e. if one range contains the other or if they overlap by
+     at least one window */
+  auto overlap_from = std::max(s->covered_from, covered_from);
+  auto overlap_until = std::min(s->covered_until, covered_until);
+  bool contained =
+      (covered_from <= s->covered_from && covered_until >= s->covered_until) ||
+      (covered_from >= s->covered_from && covered_until <= s->covered_until);
+
+  if (s->covered_until > s->covered_from &&
+      (contained ||
+          (overlap_until > overlap_from &&
+           overlap_until - overlap_from >= window_micros))) {
+    s->covered_from = std::min(s->covered_from, covered_from);
+    s->covered_until = std::max(s->covered_until, covered_until);
+  } else {
+    clearSeries(s);
+    s->covered_from = covered_from;
+    s->covered_until = covered_until;
+  }
+
+  for (const auto& window : windows) {
+    auto iter = s->windows.find(window.first);
+
+    if (iter == s->windows.end()) {
+      s->windows.emplace(window.first, window.second);
+      s->num_entries += window.second->size();
+      num_entries_ += window.second->size();
+      continue;
+    }
+
+    /* merge the groups into the existing window */
+    auto merged = std::make_shared<WindowResult>(*iter->second);
+    for (const auto& group : *window.second) {
+      if (merged->emplace(group.first, group.second).second) {
+        s->num_entries++;
+        num_entries_++;
+      }
+    }
+
+    iter->second = merged;
+  }
+
+  evict();
+}
+
+WindowCache::Series* WindowCache::getSeries(const std::string& series) {
+  auto iter = series_.find(series);
+  if (iter != series_.end()) {
+    lru_.splice(lru_.begin(), lru_, iter->second.lru_pos);
+    return &iter->second;
+  }
+
+  lru_.push_front(series);
+  auto& s = series_[series];
+  s.covered_from = 0;
+  s.covered_until = 0;
+  s.late_row_seq = 0;
+  s.num_entries = 0;
+  s.lru_pos = lru_.begin();
+  return &s;
+}
+
+void WindowCache::clearSeries(Series* series) {
+  num_entries_ -= series->num_entries;
+  series->num_entries = 0;
+  series->windows.clear();
+}
+
+void WindowCache::evict() {
+  /* never evict the most recently used series */
+  while (num_entries_ > max_entries_ && lru_.size() > 1) {
+    auto iter = series_.find(lru_.back());
+    num_entries_ -= iter->second.num_entries;
+    series_.erase(iter);
+    lru_.pop_back();
+  }
+}
+
+uint64_t WindowCache::gracePeriodMicros() const {
+  return grace_period_micros_;
+}
+
+size_t WindowCache::size() const {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+  return num_entries_;
+}
+
+}
+}
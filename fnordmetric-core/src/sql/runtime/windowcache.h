@@ -0,0 +1,124 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_SQL_WINDOWCACHE_H
+#define _FNORDMETRIC_SQL_WINDOWCACHE_H
+#include <stdlib.h>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fnordmetric/sql/svalue.h>
+
+namespace fnordmetric {
+namespace query {
+
+/**
+ * A bounded cache of per-window results for GROUP OVER TIMEWINDOW queries.
+ *
+ * Results are stored per series, where a series is identified by the query
+ * plan fingerprint without the time range of the query. Each series remembers
+ * the time range in which all windows are closed and cached ("covered from"
+ * and "covered until"); windows that start before or end after that range
+ * must be recomputed from the table. Closed windows are windows that ended
+ * more than the grace period before the query started. The grace period must
+ * not be shorter than the time by which samples may be older than their
+ * insert time without being recorded as late (see IMetric::lateSamplesMinTime).
+ *
+ * A window cache is threadsafe.
+ */
+class WindowCache {
+public:
+  static const size_t kDefaultMaxEntries = 1 << 20;
+  static const uint64_t kDefaultGracePeriodMicros = 5 * 1000000;
+
+  /**
+   * The results of one window: group key -> output row
+   */
+  typedef std::unordered_map<std::string, std::vector<SValue>> WindowResult;
+
+  /**
+   * All cached windows of a series: window start time -> results
+   */
+  typedef std::map<uint64_t, std::shared_ptr<const WindowResult>> WindowList;
+
+  WindowCache(
+      size_t max_entries = kDefaultMaxEntries,
+      uint64_t grace_period_micros = kDefaultGracePeriodMicros);
+
+  WindowCache(const WindowCache& copy) = delete;
+  WindowCache& operator=(const WindowCache& copy) = delete;
+
+  /**
+   * Returns the late row sequence number at which the series was last
+   * validated (see TableRef::getLateRowsMinTime)
+   */
+  uint64_t lateRowSequence(const std::string& series);
+
+  /**
+   * Fetch all cached windows of a series. Windows that end after
+   * late_rows_min_time are dropped first and the new late row sequence number
+   * is recorded. Returns the time until which all windows of the series are
+   * cached and stores the time from which they are cached in covered_from.
+   * Returns zero if nothing is cached.
+   */
+  uint64_t fetch(
+      const std::string& series,
+      uint64_t late_rows_min_time,
+      uint64_t late_row_seq,
+      uint64_t window_micros,
+      uint64_t* covered_from,
+      WindowList* windows);
+
+  /**
+   * Store closed windows of a series and record that all windows that start
+   * at or after covered_from and end before covered_until are cached. If the
+   * new range doesn't overlap the cached range by at least one window, the
+   * cached windows are dropped first.
+   */
+  void store(
+      const std::string& series,
+      const WindowList& windows,
+      uint64_t window_micros,
+      uint64_t covered_from,
+      uint64_t covered_until);
+
+  uint64_t gracePeriodMicros() const;
+  size_t size() const;
+
+protected:
+
+  struct Series {
+    WindowList windows;
+    uint64_t covered_from;
+    uint64_t covered_until;
+    uint64_t late_row_seq;
+    size_t num_entries;
+    std::list<std::string>::iterator lru_pos;
+  };
+
+  Series* getSeries(const std::string& series);
+  void clearSeries(Series* series);
+  void evict();
+
+  const size_t max_entries_;
+  const uint64_t grace_period_micros_;
+  std::unordered_map<std::string, Series> series_;
+  std::list<std::string> lru_;
+  size_t num_entries_;
+  mutable std::mutex mutex_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,155 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fnordmetric/query/query.h>
+#include <fnordmetric/sql/backends/tableref.h>
+#include <fnordmetric/sql/parser/astnode.h>
+#include <fnordmetric/sql/parser/parser.h>
+#include <fnordmetric/sql/parser/token.h>
+#include <fnordmetric/sql/runtime/defaultruntime.h>
+#include <fnordmetric/sql/runtime/execute.h>
+#include <fnordmetric/sql/runtime/resultlist.h>
+#include <fnordmetric/sql/runtime/tablerepository.h>
+#include <fnordmetric/sql/runtime/tablescan.h>
+#include <fnordmetric/util/benchmark.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+using namespace fnordmetric::query;
+
+/**
+ * ChartSQL execution: a compiled expression on its own, GROUP BY, and the
+ * approximate aggregates (percentile, count_distinct) next to the exact
+ * queries that compute the same result (ORDER BY ... LIMIT 1 OFFSET n and
+ * GROUP BY on the value column)
+ */
+BENCHMARK_SUITE(SQLBenchmark);
+
+static const int64_t kNumRows = 100000;
+static const int64_t kNumHosts = 100;
+
+/* kNumRows rows of (time, host, value) with about 50k distinct values */
+class FixtureTableRef : public TableRef {
+public:
+  std::vector<std::string> columns() override {
+    return {"time", "host", "value"};
+  }
+
+  int getColumnIndex(const std::string& name) override {
+    if (name == "time") return 0;
+    if (name == "host") return 1;
+    if (name == "value") return 2;
+    return -1;
+  }
+
+  std::string getColumnName(int index) override {
+    return columns()[index];
+  }
+
+  void executeScan(TableScan* scan) override {
+    char host[32];
+
+    for (int64_t i = 0; i < kNumRows; ++i) {
+      snprintf(host, sizeof(host), "host%03i", (int) (i % kNumHosts));
+
+      std::vector<SValue> row;
+      row.emplace_back(SValue((int64_t) (1400000000 + i)));
+      row.emplace_back(SValue(host));
+      row.emplace_back(SValue((double) ((i * 7919) % 50021) / 10.0));
+      if (!scan->nextRow(row.data(), row.size())) {
+        return;
+      }
+    }
+  }
+};
+
+static DefaultRuntime runtime;
+
+static size_t runQuery(const char* query_string) {
+  std::unique_ptr<TableRepository> table_repo(new TableRepository());
+  table_repo->addTableRef(
+      "fixture",
+      std::unique_ptr<TableRef>(new FixtureTableRef()));
+
+  Query query(query_string, &runtime, std::move(table_repo));
+  query.execute();
+  return query.getResultList(0)->getNumRows();
+}
+
+/* resolves the column names of an expression against FixtureTableRef */
+static void resolveColumns(ASTNode* node) {
+  if (node->getType() == ASTNode::T_COLUMN_NAME) {
+    FixtureTableRef table;
+    node->setType(ASTNode::T_RESOLVED_COLUMN);
+    node->setID(table.getColumnIndex(node->getToken()->getString()));
+    return;
+  }
+
+  for (auto child : node->getChildren()) {
+    resolveColumns(child);
+  }
+}
+
+static Parser expression_parser;
+static CompiledExpression* expression = nullptr;
+
+BENCHMARK_INITIALIZER(SQLBenchmark, CompileExpression, [] () {
+  const char query[] = "SELECT (value * 2 + time / 3) > 100 AND value < 4000;";
+  expression_parser.parse(query, strlen(query));
+
+  auto select_list = expression_parser.getStatements()[0]->getChildren()[0];
+  resolveColumns(select_list);
+
+  size_t scratchpad_len = 0;
+  expression = runtime.compiler()->compile(select_list, &scratchpad_len);
+});
+
+BENCHMARK_CASE(SQLBenchmark, ExecuteExpression, kNumRows, [] () {
+  SValue row[3];
+  SValue out[1];
+  int outc;
+
+  for (int64_t i = 0; i < kNumRows; ++i) {
+    row[0] = SValue((int64_t) (1400000000 + i));
+    row[2] = SValue((double) (i % 5000));
+    executeExpression(expression, nullptr, 3, row, &outc, out);
+  }
+});
+
+BENCHMARK_CASE(SQLBenchmark, GroupBy, kNumRows, [] () {
+  auto num_rows = runQuery(
+      "SELECT host, count(value), sum(value), max(value)"
+      "  FROM fixture GROUP BY host;");
+
+  if (num_rows != kNumHosts) {
+    RAISE(kRuntimeError, "GROUP BY returned the wrong number of rows");
+  }
+});
+
+BENCHMARK_CASE(SQLBenchmark, ExactPercentile, kNumRows, [] () {
+  /* the value with nearest rank 99% */
+  runQuery(
+      "SELECT value FROM fixture ORDER BY value DESC LIMIT 1 OFFSET 1000;");
+});
+
+BENCHMARK_CASE(SQLBenchmark, ApproxPercentile, kNumRows, [] () {
+  runQuery("SELECT percentile(value, 99) FROM fixture;");
+});
+
+BENCHMARK_CASE(SQLBenchmark, ExactCountDistinct, kNumRows, [] () {
+  /* the number of distinct values is the number of returned groups */
+  runQuery("SELECT value FROM fixture GROUP BY value;");
+});
+
+BENCHMARK_CASE(SQLBenchmark, ApproxCountDistinct, kNumRows, [] () {
+  runQuery("SELECT count_distinct(value) FROM fixture;");
+});
@@ -10,17 +10,22 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <fnordmetric/sql/backends/csv/csvbackend.h>
 #include <fnordmetric/sql/backends/csv/csvtableref.h>
 #include <fnordmetric/sql/backends/tableref.h>
+#include <fnordmetric/sql/expressions/aggregate.h>
 #include <fnordmetric/sql/parser/parser.h>
 #include <fnordmetric/sql/parser/token.h>
 #include <fnordmetric/sql/parser/tokenize.h>
 #include <fnordmetric/sql/runtime/defaultruntime.h>
+#include <fnordmetric/sql/runtime/querycache.h>
 #include <fnordmetric/sql/runtime/queryplannode.h>
 #include <fnordmetric/sql/runtime/resultlist.h>
 #include <fnordmetric/sql/runtime/tablescan.h>
 #include <fnordmetric/sql/runtime/tablerepository.h>
+#include <fnordmetric/sql/runtime/windowcache.h>
+#include <fnordmetric/thread/threadpool.h>
 #include <fnordmetric/ui/canvas.h>
 #include <fnordmetric/ui/svgtarget.h>
 #include <fnordmetric/util/datetime.h>
@@ -28,6 +33,7 @@
 #include <fnordmetric/util/outputstream.h>
 #include <fnordmetric/util/unittest.h>
 #include <fnordmetric/util/runtimeexception.h>
+#include <fnordmetric/util/wallclock.h>
 
 using namespace fnordmetric::query;
 
@@ -118,6 +124,109 @@ class TestTimeTableRef : public TableRef {
   }
 };
 
+class TestPartitionedTableRef : public TableRef {
+  std::vector<std::string> columns() override {
+    return {"one", "two", "three"};
+  }
+  int getColumnIndex(const std::string& name) override {
+    if (name == "one") return 0;
+    if (name == "two") return 1;
+    if (name == "three") return 2;
+    return -1;
+  }
+  std::string getColumnName(int index) override {
+    return columns()[index];
+  }
+  void executeScan(TableScan* scan) override {
+    for (int i = 0; i < 4; ++i) {
+      if (!scanPartition(i, scan)) {
+        return;
+      }
+    }
+  }
+  void partitionScan(
+      std::vector<std::function<void (TableScan* scan)>>* partitions)
+      override {
+    for (int i = 0; i < 4; ++i) {
+      partitions->emplace_back([this, i] (TableScan* scan) {
+        scanPartition(i, scan);
+      });
+    }
+  }
+  bool scanPartition(int partition, TableScan* scan) {
+    for (int i = partition * 250; i < (partition + 1) * 250; ++i) {
+      std::vector<SValue> row;
+      row.emplace_back(SValue((int64_t) i));
+      row.emplace_back(SValue((double) i / 4));
+      row.emplace_back(SValue((int64_t) (i % 3)));
+      if (!scan->nextRow(row.data(), row.size())) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
+
+struct TestWindowedTable {
+  std::vector<std::pair<uint64_t, int64_t>> rows;
+  uint64_t late_rows_min_time;
+  uint64_t late_row_seq;
+  uint64_t scan_begin;
+  size_t rows_scanned;
+  std::vector<std::pair<int, std::string>> equality_constraints;
+};
+
+class TestWindowedTableRef : public TableRef {
+public:
+  TestWindowedTableRef(TestWindowedTable* table) : table_(table) {}
+  std::vector<std::string> columns() override {
+    return {"time", "value", "host"};
+  }
+  int getColumnIndex(const std::string& name) override {
+    if (name == "time") return 0;
+    if (name == "value") return 1;
+    if (name == "host") return 2;
+    return -1;
+  }
+  std::string getColumnName(int index) override {
+    return columns()[index];
+  }
+  int getTimeColumnIndex() override {
+    return 0;
+  }
+  uint64_t getLateRowsMinTime(uint64_t since_seq, uint64_t* cur_seq) override {
+    *cur_seq = table_->late_row_seq;
+
+    if (since_seq < table_->late_row_seq) {
+      return table_->late_rows_min_time;
+    } else {
+      return UINT64_MAX;
+    }
+  }
+  void executeScan(TableScan* scan) override {
+    table_->scan_begin = scan->timeRangeBegin();
+    table_->equality_constraints = scan->equalityConstraints();
+    table_->rows_scanned = 0;
+
+    for (const auto& r : table_->rows) {
+      if (r.first < scan->timeRangeBegin()) {
+        continue;
+      }
+
+      std::vector<SValue> row;
+      row.emplace_back(fnord::util::DateTime(r.first));
+      row.emplace_back(SValue((int64_t) r.second));
+      row.emplace_back(SValue((int64_t) (r.second % 2)));
+      table_->rows_scanned++;
+      if (!scan->nextRow(row.data(), row.size())) {
+        return;
+      }
+    }
+  }
+protected:
+  TestWindowedTable* table_;
+};
 
 static Parser parseTestQuery(const char* query) {
   Parser parser;
@@ -126,10 +235,12 @@ static Parser parseTestQuery(const char* query) {
 }
 
 static std::unique_ptr<ResultList> executeTestQuery(
-    const char* query) {
+    const char* query,
+    fnord::thread::TaskScheduler* scheduler = nullptr) {
   DefaultRuntime runtime;
   runtime.addBackend(
       std::unique_ptr<Backend>(new csv_backend::CSVBackend()));
+  runtime.queryPlanBuilder()->setScheduler(scheduler);
 
   TableRepository table_repo;
   QueryPlan query_plan(&table_repo);
@@ -145,6 +256,10 @@ static std::unique_ptr<ResultList> executeTestQuery(
       "timeseries",
       std::unique_ptr<TableRef>(new TestTimeTableRef()));
 
+  query_plan.tableRepository()->addTableRef(
+      "partitioned",
+      std::unique_ptr<TableRef>(new TestPartitionedTableRef()));
+
   query_plan.tableRepository()->addTableRef(
       "gbp_per_country",
       std::unique_ptr<TableRef>(
@@ -491,7 +606,7 @@ TEST_CASE(SQLTest, TestSelectWithQuotedTableName, [] () {
 
 TEST_CASE(SQLTest, TestSelectMustBeFirstAssert, [] () {
   const char* err_msg = "unexpected token T_GROUP, expected one of SELECT, "
-      "DRAW or IMPORT";
+      "DRAW, IMPORT or EXPLAIN";
 
   EXPECT_EXCEPTION(err_msg, [] () {
     auto parser = parseTestQuery("GROUP BY SELECT");
@@ -1334,7 +1449,7 @@ TEST_CASE(SQLTest, TestMeanAggregation, [] () {
       "    testtable2;");
 
   EXPECT_EQ(results->getNumRows(), 1);
-  EXPECT_EQ(results->getRow(0)[0], "6.875000");
+  EXPECT_EQ(results->getRow(0)[0], "5.500000");
 });
 
 TEST_CASE(SQLTest, TestMaxAggregation, [] () {
@@ -1359,3 +1474,492 @@ TEST_CASE(SQLTest, TestMinAggregation, [] () {
   EXPECT_EQ(results->getRow(0)[0], "1.000000");
 });
 
+
+TEST_CASE(SQLTest, TestApproximateAggregations, [] () {
+  auto results = executeTestQuery(
+      "  SELECT"
+      "    percentile(one, 50), percentile(one, 99), median(two),"
+      "    count_distinct(three), count_distinct(one)"
+      "  FROM"
+      "    testtable;");
+
+  EXPECT_EQ(results->getNumRows(), 1);
+  EXPECT(fabs(std::stod(results->getRow(0)[0]) - 50) <= 50.0 / 32);
+  EXPECT(fabs(std::stod(results->getRow(0)[1]) - 99) <= 99.0 / 32);
+  EXPECT(fabs(std::stod(results->getRow(0)[2]) - 50) <= 50.0 / 32);
+  EXPECT_EQ(results->getRow(0)[3], "2");
+  EXPECT(abs(std::stoi(results->getRow(0)[4]) - 100) <= 2);
+});
+
+TEST_CASE(SQLTest, TestApproximateAggregationsStepOutput, [] () {
+  std::vector<char> scratchpad(std::max(
+      expressions::percentileExprScratchpadSize(),
+      expressions::countDistinctExprScratchpadSize()));
+
+  /* the steps only return NULL, the result method computes the result */
+  SValue out;
+  SValue args[2];
+  args[1] = SValue((fnordmetric::FloatType) 50);
+  for (int i = 1; i <= 3; ++i) {
+    args[0] = SValue((fnordmetric::IntegerType) 42);
+    expressions::percentileExpr(scratchpad.data(), 2, args, &out);
+    EXPECT(out.getType() == SValue::T_NULL);
+  }
+
+  expressions::percentileExprResult(scratchpad.data(), &out);
+  EXPECT(fabs(out.getFloat() - 42) <= 42.0 / 32);
+
+  std::fill(scratchpad.begin(), scratchpad.end(), 0);
+  for (int i = 1; i <= 3; ++i) {
+    args[0] = SValue((fnordmetric::IntegerType) i);
+    expressions::countDistinctExpr(scratchpad.data(), 1, args, &out);
+    EXPECT(out.getType() == SValue::T_NULL);
+  }
+
+  expressions::countDistinctExprResult(scratchpad.data(), &out);
+  EXPECT_EQ(out.getInteger(), 3);
+});
+
+/* an aggregate without merge and result methods */
+static void lastValueExpr(
+    void* scratchpad,
+    int argc,
+    SValue* argv,
+    SValue* out) {
+  *out = *argv;
+}
+
+static void lastValueExprFree(void* scratchpad) {}
+
+class NonMergeableRuntime : public DefaultRuntime {
+public:
+  NonMergeableRuntime() {
+    symbol_table_.registerSymbol(
+        "last_value",
+        &lastValueExpr,
+        sizeof(SValue),
+        &lastValueExprFree);
+  }
+};
+
+TEST_CASE(SQLTest, TestApproximateAggregationsNotMergeable, [] () {
+  NonMergeableRuntime runtime;
+
+  TableRepository table_repo;
+  QueryPlan query_plan(&table_repo);
+  query_plan.tableRepository()->addTableRef(
+      "partitioned",
+      std::unique_ptr<TableRef>(new TestPartitionedTableRef()));
+
+  query_plan.tableRepository()->addTableRef(
+      "timeseries",
+      std::unique_ptr<TableRef>(new TestTimeTableRef()));
+
+  auto ast = runtime.parser()->parseQuery(
+      "  SELECT"
+      "    three, percentile(one, 50), count_distinct(one), last_value(one)"
+      "  FROM"
+      "    partitioned"
+      "  GROUP BY"
+      "    three;"
+      "  SELECT"
+      "    time, percentile(value, 90), last_value(value)"
+      "  FROM"
+      "    timeseries"
+      "  GROUP OVER TIMEWINDOW(time, 60, 60);");
+
+  runtime.queryPlanBuilder()->buildQueryPlan(ast, &query_plan);
+  EXPECT_EQ(query_plan.queries().size(), 2);
+
+  /* the approximate aggregates are finalized once per row, the other
+     aggregate returns its value of the last input row */
+  ResultList group_by;
+  auto group_by_node = query_plan.queries()[0].get();
+  EXPECT(group_by_node->toString().find("mergeable=no") != std::string::npos);
+  group_by.addHeader(group_by_node->getColumns());
+  group_by_node->setTarget(&group_by);
+  group_by_node->execute();
+
+  EXPECT_EQ(group_by.getNumRows(), 3);
+  for (int i = 0; i < group_by.getNumRows(); ++i) {
+    const auto& row = group_by.getRow(i);
+    if (row[0] != "0") {
+      continue;
+    }
+
+    EXPECT(fabs(std::stod(row[1]) - 498) <= 498.0 / 32);
+    EXPECT(abs(std::stoi(row[2]) - 334) <= 5);
+    EXPECT_EQ(row[3], "999");
+  }
+
+  ResultList timewindow;
+  auto timewindow_node = query_plan.queries()[1].get();
+  timewindow.addHeader(timewindow_node->getColumns());
+  timewindow_node->setTarget(&timewindow);
+  timewindow_node->execute();
+
+  EXPECT(timewindow.getNumRows() > 1);
+  EXPECT(fabs(std::stod(timewindow.getRow(0)[1]) - 53) <= 53.0 / 32);
+  EXPECT(timewindow.getRow(0)[2] != "NULL");
+});
+
+TEST_CASE(SQLTest, TestGroupOverTimeWindowPercentile, [] () {
+  auto results = executeTestQuery(
+      "  SELECT time as X, percentile(value, 90) as Y"
+      "      FROM timeseries"
+      "      GROUP OVER TIMEWINDOW(time, 60, 60);");
+
+  EXPECT(results->getNumRows() > 1);
+  EXPECT(fabs(std::stod(results->getRow(0)[1]) - 53) <= 53.0 / 32);
+});
+
+TEST_CASE(SQLTest, TestParallelPartialAggregation, [] () {
+  /* the pool's threads are detached and never exit, so we never destroy it */
+  auto thread_pool = new fnord::thread::ThreadPool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler("crashed")));
+
+  const char query[] =
+      "  SELECT"
+      "    three, count(one), sum(one), mean(two), min(one), max(two),"
+      "    sum(one) / count(one)"
+      "  FROM"
+      "    partitioned"
+      "  GROUP BY"
+      "    three"
+      "  ORDER BY"
+      "    three ASC;";
+
+  auto serial = executeTestQuery(query);
+  auto parallel = executeTestQuery(query, thread_pool);
+
+  EXPECT_EQ(serial->getNumRows(), 3);
+  EXPECT_EQ(parallel->getNumRows(), 3);
+
+  for (int i = 0; i < serial->getNumRows(); ++i) {
+    const auto& serial_row = serial->getRow(i);
+    const auto& parallel_row = parallel->getRow(i);
+    EXPECT_EQ(serial_row.size(), parallel_row.size());
+
+    for (int j = 0; j < serial_row.size(); ++j) {
+      EXPECT_EQ(serial_row[j], parallel_row[j]);
+    }
+  }
+
+  EXPECT_EQ(parallel->getRow(0)[0], "0");
+  EXPECT_EQ(parallel->getRow(0)[1], "334");
+  EXPECT_EQ(parallel->getRow(0)[2], "166833");
+  EXPECT_EQ(parallel->getRow(0)[4], "0.000000");
+});
+
+TEST_CASE(SQLTest, TestParallelApproximateAggregation, [] () {
+  /* the pool's threads are detached and never exit, so we never destroy it */
+  auto thread_pool = new fnord::thread::ThreadPool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler("crashed")));
+
+  const char query[] =
+      "  SELECT"
+      "    three, percentile(one, 90), median(two), count_distinct(one)"
+      "  FROM"
+      "    partitioned"
+      "  GROUP BY"
+      "    three"
+      "  ORDER BY"
+      "    three ASC;";
+
+  auto serial = executeTestQuery(query);
+  auto parallel = executeTestQuery(query, thread_pool);
+
+  EXPECT_EQ(serial->getNumRows(), 3);
+  EXPECT_EQ(parallel->getNumRows(), 3);
+
+  for (int i = 0; i < serial->getNumRows(); ++i) {
+    const auto& serial_row = serial->getRow(i);
+    const auto& parallel_row = parallel->getRow(i);
+    EXPECT_EQ(serial_row.size(), parallel_row.size());
+
+    for (int j = 0; j < serial_row.size(); ++j) {
+      EXPECT_EQ(serial_row[j], parallel_row[j]);
+    }
+  }
+
+  EXPECT(fabs(std::stod(parallel->getRow(0)[1]) - 900) <= 900.0 / 32);
+});
+
+static void collectLiterals(ASTNode* node, std::vector<std::string>* literals) {
+  auto token = node->getToken();
+  if (token != nullptr && (
+      token->getType() == Token::T_NUMERIC ||
+      token->getType() == Token::T_STRING)) {
+    literals->emplace_back(token->getString());
+  }
+
+  for (const auto child : node->getChildren()) {
+    collectLiterals(child, literals);
+  }
+}
+
+TEST_CASE(SQLTest, TestQueryCacheBindsLiterals, [] () {
+  QueryCache cache;
+
+  auto stmts1 = cache.parseQuery(
+      "SELECT one FROM testtable WHERE two > 10 AND three = 'abc' LIMIT 5;");
+  auto stmts2 = cache.parseQuery(
+      "  SELECT one  FROM testtable\n  WHERE two > 23.5 AND three = 'xyz'"
+      "  LIMIT 10;");
+
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_EQ(cache.numHits(), 1);
+  EXPECT_EQ(cache.numMisses(), 1);
+  EXPECT_EQ(stmts1.size(), 1);
+  EXPECT_EQ(stmts2.size(), 1);
+
+  std::vector<std::string> literals1;
+  collectLiterals(stmts1[0].get(), &literals1);
+  EXPECT_EQ(literals1.size(), 3);
+  EXPECT_EQ(literals1[0], "10");
+  EXPECT_EQ(literals1[1], "abc");
+  EXPECT_EQ(literals1[2], "5");
+
+  std::vector<std::string> literals2;
+  collectLiterals(stmts2[0].get(), &literals2);
+  EXPECT_EQ(literals2.size(), 3);
+  EXPECT_EQ(literals2[0], "23.5");
+  EXPECT_EQ(literals2[1], "xyz");
+  EXPECT_EQ(literals2[2], "10");
+
+  cache.parseQuery("SELECT two FROM testtable WHERE two > 10;");
+  EXPECT_EQ(cache.size(), 2);
+});
+
+TEST_CASE(SQLTest, TestQueryCacheEviction, [] () {
+  QueryCache cache(2);
+
+  cache.parseQuery("SELECT one FROM testtable;");
+  cache.parseQuery("SELECT two FROM testtable;");
+  cache.parseQuery("SELECT one FROM testtable;");
+  cache.parseQuery("SELECT three FROM testtable;");
+  EXPECT_EQ(cache.size(), 2);
+
+  cache.parseQuery("SELECT one FROM testtable;");
+  EXPECT_EQ(cache.numHits(), 2);
+  cache.parseQuery("SELECT two FROM testtable;");
+  EXPECT_EQ(cache.numHits(), 2);
+});
+
+static std::unique_ptr<ResultList> executeWindowedTestQuery(
+    TestWindowedTable* table,
+    WindowCache* window_cache,
+    const std::string& where_clause = "") {
+  DefaultRuntime runtime;
+  runtime.queryPlanBuilder()->setWindowCache(window_cache);
+
+  TableRepository table_repo;
+  QueryPlan query_plan(&table_repo);
+  query_plan.tableRepository()->addTableRef(
+      "windowed",
+      std::unique_ptr<TableRef>(new TestWindowedTableRef(table)));
+
+  auto query =
+      "  SELECT time AS t, sum(value) AS s, count(value) AS c, host"
+      "      FROM windowed " + where_clause +
+      "      GROUP OVER TIMEWINDOW(time, 10, 5) BY host;";
+
+  auto ast = runtime.parser()->parseQuery(query.c_str());
+
+  runtime.queryPlanBuilder()->buildQueryPlan(ast, &query_plan);
+  EXPECT(query_plan.queries().size() == 1);
+
+  auto result = new ResultList();
+  auto query_plan_node = query_plan.queries()[0].get();
+  result->addHeader(query_plan_node->getColumns());
+  query_plan_node->setTarget(result);
+  query_plan_node->execute();
+
+  return std::unique_ptr<ResultList>(result);
+}
+
+static void expectSameResults(ResultList* a, ResultList* b) {
+  EXPECT_EQ(a->getNumRows(), b->getNumRows());
+
+  for (int i = 0; i < a->getNumRows() && i < b->getNumRows(); ++i) {
+    EXPECT_EQ(a->getRow(i).size(), b->getRow(i).size());
+
+    for (int j = 0; j < a->getRow(i).size(); ++j) {
+      EXPECT_EQ(a->getRow(i)[j], b->getRow(i)[j]);
+    }
+  }
+}
+
+TEST_CASE(SQLTest, TestGroupOverTimeWindowCache, [] () {
+  WindowCache window_cache(1024, 0);
+
+  TestWindowedTable table;
+  table.late_rows_min_time = UINT64_MAX;
+  table.late_row_seq = 0;
+
+  auto base = fnord::util::WallClock::unixMicros() - 100 * 1000000;
+  for (int i = 0; i < 100; ++i) {
+    table.rows.emplace_back(base + i * 1000000, i);
+  }
+
+  /* the first query scans the whole table and caches all closed windows */
+  auto cold = executeWindowedTestQuery(&table, &window_cache);
+  EXPECT_EQ(table.scan_begin, 0);
+  EXPECT_EQ(table.rows_scanned, 100);
+  EXPECT(cold->getNumRows() > 0);
+  EXPECT(window_cache.size() > 0);
+
+  /* the second query only scans the windows that were still open */
+  auto warm = executeWindowedTestQuery(&table, &window_cache);
+  EXPECT(table.scan_begin > base);
+  EXPECT(table.rows_scanned < 20);
+  expectSameResults(cold.get(), warm.get());
+
+  /* new rows are picked up by the open windows */
+  auto now = fnord::util::WallClock::unixMicros();
+  table.rows.emplace_back(now, 100);
+  table.rows.emplace_back(now, 101);
+
+  {
+    WindowCache empty_cache(1024, 0);
+    auto expected = executeWindowedTestQuery(&table, &empty_cache);
+    auto result = executeWindowedTestQuery(&table, &window_cache);
+    expectSameResults(expected.get(), result.get());
+  }
+
+  /* late rows invalidate the cached windows that contain them */
+  table.rows.emplace_back(base + 10 * 1000000, 1000);
+  table.late_rows_min_time = base + 10 * 1000000;
+  table.late_row_seq = 1;
+
+  {
+    WindowCache empty_cache(1024, 0);
+    auto expected = executeWindowedTestQuery(&table, &empty_cache);
+    auto result = executeWindowedTestQuery(&table, &window_cache);
+    EXPECT(table.scan_begin <= base + 10 * 1000000);
+    expectSameResults(expected.get(), result.get());
+  }
+});
+
+static std::string timeRangeWhereClause(uint64_t begin, uint64_t end) {
+  return
+      "WHERE time >= FROM_TIMESTAMP(" + std::to_string(begin) + ")" +
+      " AND FROM_TIMESTAMP(" + std::to_string(end) + ") > time";
+}
+
+TEST_CASE(SQLTest, TestGroupOverTimeWindowCacheTimeRange, [] () {
+  WindowCache window_cache(1024, 0);
+
+  TestWindowedTable table;
+  table.late_rows_min_time = UINT64_MAX;
+  table.late_row_seq = 0;
+
+  uint64_t base = (fnord::util::WallClock::unixMicros() / 1000000 - 200);
+  base -= base % 5;
+  for (int i = 0; i < 200; ++i) {
+    table.rows.emplace_back((base + i) * 1000000, i);
+  }
+
+  /* only the windows that start in the time range are emitted */
+  auto cold = executeWindowedTestQuery(
+      &table,
+      &window_cache,
+      timeRangeWhereClause(base + 50, base + 150));
+  EXPECT_EQ(table.scan_begin, (base + 50) * 1000000);
+  EXPECT_EQ(cold->getNumRows(), 38);
+
+  /* queries that only differ in their time range share the cached windows */
+  {
+    WindowCache empty_cache(1024, 0);
+    auto where_clause = timeRangeWhereClause(base + 60, base + 160);
+    auto expected = executeWindowedTestQuery(
+        &table,
+        &empty_cache,
+        where_clause);
+    auto result = executeWindowedTestQuery(
+        &table,
+        &window_cache,
+        where_clause);
+    EXPECT_EQ(table.scan_begin, (base + 145) * 1000000);
+    EXPECT_EQ(table.rows_scanned, 55);
+    EXPECT_EQ(result->getNumRows(), 38);
+    expectSameResults(expected.get(), result.get());
+  }
+
+  /* windows before the cached range are computed from the table */
+  {
+    WindowCache empty_cache(1024, 0);
+    auto where_clause = timeRangeWhereClause(base, base + 100);
+    auto expected = executeWindowedTestQuery(
+        &table,
+        &empty_cache,
+        where_clause);
+    auto result = executeWindowedTestQuery(
+        &table,
+        &window_cache,
+        where_clause);
+    EXPECT_EQ(table.scan_begin, base * 1000000);
+    expectSameResults(expected.get(), result.get());
+  }
+
+  /* cached windows that end after the time range are not used */
+  {
+    WindowCache empty_cache(1024, 0);
+    auto where_clause = timeRangeWhereClause(base + 20, base + 120);
+    auto expected = executeWindowedTestQuery(
+        &table,
+        &empty_cache,
+        where_clause);
+    auto result = executeWindowedTestQuery(
+        &table,
+        &window_cache,
+        where_clause);
+    EXPECT_EQ(table.scan_begin, (base + 115) * 1000000);
+    expectSameResults(expected.get(), result.get());
+  }
+
+  /* other conditions are part of the cache key */
+  executeWindowedTestQuery(
+      &table,
+      &window_cache,
+      timeRangeWhereClause(base + 60, base + 160) + " AND value < 1000");
+  EXPECT_EQ(table.scan_begin, (base + 60) * 1000000);
+});
+
+TEST_CASE(SQLTest, TestTableScanEqualityConstraints, [] () {
+  TestWindowedTable table;
+  for (int i = 0; i < 10; ++i) {
+    table.rows.emplace_back(i * 1000000, i);
+  }
+
+  DefaultRuntime runtime;
+  TableRepository table_repo;
+  QueryPlan query_plan(&table_repo);
+  query_plan.tableRepository()->addTableRef(
+      "windowed",
+      std::unique_ptr<TableRef>(new TestWindowedTableRef(&table)));
+
+  /* numeric strings and disjunctions are not constraints */
+  auto ast = runtime.parser()->parseQuery(
+      "  SELECT value FROM windowed"
+      "      WHERE host = 'a' AND value > 3 AND 'b' = host AND host = '1'"
+      "          AND (host = 'c' OR value = 1);");
+
+  runtime.queryPlanBuilder()->buildQueryPlan(ast, &query_plan);
+  EXPECT(query_plan.queries().size() == 1);
+
+  ResultList result;
+  auto query_plan_node = query_plan.queries()[0].get();
+  result.addHeader(query_plan_node->getColumns());
+  query_plan_node->setTarget(&result);
+  query_plan_node->execute();
+
+  EXPECT_EQ(result.getNumRows(), 0);
+  EXPECT_EQ(table.equality_constraints.size(), 2);
+  EXPECT_EQ(table.equality_constraints[0].first, 2);
+  EXPECT_EQ(table.equality_constraints[0].second, "a");
+  EXPECT_EQ(table.equality_constraints[1].first, 2);
+  EXPECT_EQ(table.equality_constraints[1].second, "b");
+});
@@ -144,6 +144,14 @@ SValue::kSValueType SValue::getType() const {
   return data_.type;
 }
 
+size_t SValue::getMemoryUsage() const {
+  if (data_.type == T_STRING) {
+    return sizeof(SValue) + data_.u.t_string.len;
+  } else {
+    return sizeof(SValue);
+  }
+}
+
 fnordmetric::IntegerType SValue::getInteger() const {
   switch (data_.type) {
 
@@ -54,6 +54,12 @@ public:
   template <typename T> bool testType() const;
   kSValueType getType() const;
   kSValueType testTypeWithNumericConversion() const;
+
+  /**
+   * Returns the number of bytes used by this value, including the string data
+   */
+  size_t getMemoryUsage() const;
+
   fnordmetric::IntegerType getInteger() const;
   fnordmetric::FloatType getFloat() const;
   fnordmetric::BoolType getBool() const;
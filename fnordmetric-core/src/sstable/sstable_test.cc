@@ -10,8 +10,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <fnordmetric/io/file.h>
 #include <fnordmetric/util/unittest.h>
+#include <fnordmetric/sstable/sstablereader.h>
+#include <fnordmetric/sstable/sstablerepair.h>
+#include <fnordmetric/sstable/sstablestreamwriter.h>
 #include <fnordmetric/sstable/sstablewriter.h>
 #include <fnordmetric/sstable/rowoffsetindex.h>
 
@@ -106,3 +110,40 @@ TEST_CASE(SSTableTest, TestSSTableWriterWithIndexes, [] () {
 
 
 
+
+TEST_CASE(SSTableTest, TestSSTableStreamWriter, [] () {
+  std::string filename = "/tmp/__fnord__sstabletest3.sstable";
+  unlink(filename.c_str());
+
+  std::string header = "myfnordyheader!";
+  auto tbl = SSTableStreamWriter::create(
+      filename,
+      header.data(),
+      header.size());
+
+  /* enough rows to flush the write buffer a few times */
+  for (int i = 0; i < 100000; ++i) {
+    auto key = "key" + std::to_string(i);
+    auto value = "value" + std::to_string(i);
+    tbl->appendRow(key.data(), key.size(), value.data(), value.size());
+  }
+
+  std::string footer = "myfnordyfooter!";
+  tbl->writeIndex(0x23, footer.data(), footer.size());
+  tbl->finalize();
+
+  SSTableRepair repair(filename);
+  EXPECT_EQ(repair.checkAndRepair(false), true);
+
+  SSTableReader reader(File::openFile(filename, File::O_READ));
+  EXPECT_EQ(reader.bodySize(), tbl->bodySize());
+  EXPECT_EQ(reader.readHeader().toString(), header);
+  EXPECT_EQ(reader.readFooter(0x23).toString(), footer);
+
+  auto cursor = reader.getCursor();
+  for (int i = 0; i < 100000; ++i) {
+    EXPECT_EQ(cursor->getKeyString(), "key" + std::to_string(i));
+    EXPECT_EQ(cursor->getDataString(), "value" + std::to_string(i));
+    EXPECT_EQ(cursor->next(), i < 99999);
+  }
+});
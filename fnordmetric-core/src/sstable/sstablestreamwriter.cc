@@ -0,0 +1,184 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <unistd.h>
+#include <fnordmetric/sstable/binaryformat.h>
+#include <fnordmetric/sstable/fileheaderwriter.h>
+#include <fnordmetric/sstable/sstablestreamwriter.h>
+#include <fnordmetric/util/fnv.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnord {
+namespace sstable {
+
+std::unique_ptr<SSTableStreamWriter> SSTableStreamWriter::create(
+    const std::string& filename,
+    void const* header,
+    size_t header_size) {
+  auto file = io::File::openFile(
+      filename,
+      io::File::O_READ | io::File::O_WRITE | io::File::O_CREATE);
+
+  return std::unique_ptr<SSTableStreamWriter>(
+      new SSTableStreamWriter(std::move(file), header, header_size));
+}
+
+SSTableStreamWriter::SSTableStreamWriter(
+    io::File&& file,
+    void const* header,
+    size_t header_size) :
+    file_(std::move(file)),
+    header_(static_cast<const char*>(header), header_size),
+    body_size_(0),
+    body_written_(false),
+    finalized_(false) {
+  buffer_.reserve(kBufferSize);
+
+  /* the body size is updated by finalize */
+  std::string file_header(FileHeaderWriter::calculateSize(header_size), 0);
+  FileHeaderWriter header_writer(
+      &file_header[0],
+      file_header.size(),
+      0,
+      header,
+      header_size);
+
+  write(file_header.data(), file_header.size());
+}
+
+void SSTableStreamWriter::appendRow(
+    void const* key,
+    size_t key_size,
+    void const* data,
+    size_t data_size) {
+  if (finalized_ || body_written_) {
+    RAISE(kIllegalStateError, "can't append rows after writing an index");
+  }
+
+  size_t row_size = sizeof(BinaryFormat::RowHeader) + key_size + data_size;
+  if (buffer_.size() + row_size > kBufferSize) {
+    flush();
+  }
+
+  auto row_offset = buffer_.size();
+  buffer_.resize(row_offset + row_size);
+  auto row = &buffer_[row_offset];
+
+  BinaryFormat::RowHeader header;
+  header.key_size = key_size;
+  header.data_size = data_size;
+  memcpy(row + sizeof(header), key, key_size);
+  memcpy(row + sizeof(header) + key_size, data, data_size);
+
+  /* the checksum covers the key and data sizes, the key and the data */
+  util::FNV<uint32_t> fnv;
+  memcpy(row, &header, sizeof(header));
+  header.checksum = fnv.hash(
+      row + sizeof(uint32_t),
+      row_size - sizeof(uint32_t));
+
+  memcpy(row, &header, sizeof(header));
+  body_size_ += row_size;
+}
+
+void SSTableStreamWriter::writeIndex(
+    uint32_t index_type,
+    void const* data,
+    size_t size) {
+  if (finalized_) {
+    RAISE(kIllegalStateError, "table is immutable (alread finalized)");
+  }
+
+  if (size == 0) {
+    return;
+  }
+
+  body_written_ = true;
+
+  BinaryFormat::FooterHeader header;
+  header.magic = BinaryFormat::kMagicBytes;
+  header.type = index_type;
+  header.footer_size = size;
+
+  util::FNV<uint32_t> fnv;
+  header.footer_checksum = fnv.hash(data, size);
+
+  write(&header, sizeof(header));
+  write(data, size);
+}
+
+void SSTableStreamWriter::finalize() {
+  if (finalized_) {
+    RAISE(kIllegalStateError, "table is immutable (alread finalized)");
+  }
+
+  flush();
+  finalized_ = true;
+
+  std::string file_header(FileHeaderWriter::calculateSize(header_.size()), 0);
+  FileHeaderWriter header_writer(
+      &file_header[0],
+      file_header.size(),
+      body_size_,
+      header_.data(),
+      header_.size());
+
+  if (pwrite(file_.fd(), file_header.data(), file_header.size(), 0) !=
+      file_header.size()) {
+    RAISE_ERRNO(kIOError, "pwrite() failed");
+  }
+
+  if (fsync(file_.fd()) != 0) {
+    RAISE_ERRNO(kIOError, "fsync() failed");
+  }
+}
+
+size_t SSTableStreamWriter::bodySize() const {
+  return body_size_;
+}
+
+void SSTableStreamWriter::write(void const* data, size_t size) {
+  if (buffer_.size() + size > kBufferSize) {
+    flush();
+  }
+
+  if (size > kBufferSize) {
+    buffer_.assign(static_cast<const char*>(data), size);
+    flush();
+  } else {
+    buffer_.append(static_cast<const char*>(data), size);
+  }
+}
+
+void SSTableStreamWriter::flush() {
+  size_t pos = 0;
+
+  while (pos < buffer_.size()) {
+    auto bytes_written = ::write(
+        file_.fd(),
+        buffer_.data() + pos,
+        buffer_.size() - pos);
+
+    if (bytes_written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      RAISE_ERRNO(kIOError, "write() failed");
+    }
+
+    pos += bytes_written;
+  }
+
+  buffer_.clear();
+}
+
+}
+}
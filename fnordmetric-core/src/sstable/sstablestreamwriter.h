@@ -0,0 +1,78 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORD_SSTABLE_SSTABLESTREAMWRITER_H
+#define _FNORD_SSTABLE_SSTABLESTREAMWRITER_H
+#include <stdlib.h>
+#include <string>
+#include <memory>
+#include <fnordmetric/io/file.h>
+
+namespace fnord {
+namespace sstable {
+
+/**
+ * Writes a new sstable front to back through a write buffer. Unlike
+ * SSTableWriter, rows can't be read before the table is finalized, but
+ * appending a row is only a memcpy, so this is the fastest way to write a
+ * complete table (e.g. when bulk loading). The file format is the same.
+ *
+ * Indexes (footers) may only be written after the last row.
+ */
+class SSTableStreamWriter {
+public:
+  static const size_t kBufferSize = 1 << 20; /* 1MB */
+
+  /**
+   * Create a new sstable. The file must not exist
+   */
+  static std::unique_ptr<SSTableStreamWriter> create(
+      const std::string& filename,
+      void const* header,
+      size_t header_size);
+
+  SSTableStreamWriter(const SSTableStreamWriter& other) = delete;
+  SSTableStreamWriter& operator=(const SSTableStreamWriter& other) = delete;
+
+  void appendRow(
+      void const* key,
+      size_t key_size,
+      void const* data,
+      size_t data_size);
+
+  void writeIndex(uint32_t index_type, void const* data, size_t size);
+
+  /**
+   * Write the body size into the header and flush the table to disk
+   */
+  void finalize();
+
+  size_t bodySize() const;
+
+protected:
+  SSTableStreamWriter(
+      io::File&& file,
+      void const* header,
+      size_t header_size);
+
+  void write(void const* data, size_t size);
+  void flush();
+
+  io::File file_;
+  std::string header_;
+  std::string buffer_;
+  size_t body_size_;
+  bool body_written_;
+  bool finalized_;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <new>
+#include <fnordmetric/stats/allocationscope.h>
+
+namespace fnord {
+namespace stats {
+
+/* constructed on first use since operator new may run before main() */
+static AllocationStats* allocationStats() {
+  static AllocationStats stats[AllocationStats::kNumSubsystems];
+  return stats;
+}
+
+const AllocationStats& AllocationStats::get(kSubsystem subsystem) {
+  return allocationStats()[subsystem];
+}
+
+const char* AllocationStats::subsystemName(kSubsystem subsystem) {
+  switch (subsystem) {
+    case SUBSYSTEM_OTHER: return "other";
+    case SUBSYSTEM_INGEST: return "ingest";
+    case SUBSYSTEM_QUERY: return "query";
+    case SUBSYSTEM_STORAGE: return "storage";
+    case SUBSYSTEM_HTTP: return "http";
+  }
+
+  return "unknown";
+}
+
+#ifdef FNORD_ENABLE_PROFILING
+
+static thread_local AllocationStats::kSubsystem current_subsystem =
+    AllocationStats::SUBSYSTEM_OTHER;
+
+AllocationScope::AllocationScope(
+    AllocationStats::kSubsystem subsystem) :
+    prev_subsystem_(current_subsystem) {
+  current_subsystem = subsystem;
+}
+
+AllocationScope::~AllocationScope() {
+  current_subsystem = prev_subsystem_;
+}
+
+static void* profiledAlloc(size_t size) {
+  auto& stats = allocationStats()[current_subsystem];
+  stats.allocations.incr();
+  stats.bytes_allocated.incr(size);
+
+  auto ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+
+  return ptr;
+}
+
+static void profiledFree(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  allocationStats()[current_subsystem].frees.incr();
+  free(ptr);
+}
+
+#endif
+
+}
+}
+
+#ifdef FNORD_ENABLE_PROFILING
+
+void* operator new(size_t size) {
+  return fnord::stats::profiledAlloc(size);
+}
+
+void* operator new[](size_t size) {
+  return fnord::stats::profiledAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  fnord::stats::profiledFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  fnord::stats::profiledFree(ptr);
+}
+
+#endif
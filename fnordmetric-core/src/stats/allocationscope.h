@@ -0,0 +1,78 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_STATS_ALLOCATIONSCOPE_H
+#define _FNORDMETRIC_STATS_ALLOCATIONSCOPE_H
+#include <stdint.h>
+#include <fnordmetric/stats/counter.h>
+#include "config.h"
+
+namespace fnord {
+namespace stats {
+
+/**
+ * Heap allocation counters of one subsystem
+ */
+struct AllocationStats {
+  enum kSubsystem {
+    SUBSYSTEM_OTHER = 0,
+    SUBSYSTEM_INGEST = 1,
+    SUBSYSTEM_QUERY = 2,
+    SUBSYSTEM_STORAGE = 3,
+    SUBSYSTEM_HTTP = 4
+  };
+
+  static const int kNumSubsystems = 5;
+
+  Counter allocations;
+  Counter frees;
+  Counter bytes_allocated;
+
+  /**
+   * Returns the stats of the provided subsystem. Always zero unless built
+   * with -DENABLE_PROFILING=ON
+   */
+  static const AllocationStats& get(kSubsystem subsystem);
+
+  static const char* subsystemName(kSubsystem subsystem);
+};
+
+/**
+ * Attributes all operator new/delete calls of the current thread to a
+ * subsystem for as long as the scope is alive. Scopes can be nested, the
+ * innermost one wins. Threads without a scope count as SUBSYSTEM_OTHER.
+ *
+ * A free is attributed to the subsystem that is active when the memory is
+ * released, not the one that allocated it, so the allocation and free counts
+ * of a subsystem show its churn rather than its live heap size.
+ *
+ * Only built with -DENABLE_PROFILING=ON, which replaces the global operator
+ * new and delete. Otherwise a scope is empty and compiles to nothing.
+ */
+class AllocationScope {
+public:
+#ifdef FNORD_ENABLE_PROFILING
+  explicit AllocationScope(AllocationStats::kSubsystem subsystem);
+  ~AllocationScope();
+#else
+  explicit AllocationScope(AllocationStats::kSubsystem subsystem) {}
+#endif
+
+  AllocationScope(const AllocationScope& copy) = delete;
+  AllocationScope& operator=(const AllocationScope& copy) = delete;
+
+#ifdef FNORD_ENABLE_PROFILING
+protected:
+  AllocationStats::kSubsystem prev_subsystem_;
+#endif
+};
+
+}
+}
+#endif
@@ -0,0 +1,66 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_STATS_COUNTER_H
+#define _FNORDMETRIC_STATS_COUNTER_H
+#include <stdint.h>
+#include <atomic>
+#include <fnordmetric/stats/stripe.h>
+
+namespace fnord {
+namespace stats {
+
+/**
+ * A monotonic counter that is cheap to increment from many threads at once.
+ *
+ * The counter is split into kNumStripes cache line sized stripes and every
+ * thread only increments its own stripe (with a relaxed atomic add), so
+ * concurrent increments don't contend on a lock or bounce a shared cache
+ * line. Reading the counter sums up all stripes.
+ */
+class Counter {
+public:
+  static const size_t kNumStripes = 16;
+
+  Counter() {
+    for (auto& stripe : stripes_) {
+      stripe.value = 0;
+    }
+  }
+
+  Counter(const Counter& copy) = delete;
+  Counter& operator=(const Counter& copy) = delete;
+
+  inline void incr(uint64_t value = 1) {
+    stripes_[currentStripe<kNumStripes>()].value.fetch_add(
+        value,
+        std::memory_order_relaxed);
+  }
+
+  uint64_t get() const {
+    uint64_t sum = 0;
+    for (const auto& stripe : stripes_) {
+      sum += stripe.value.load(std::memory_order_relaxed);
+    }
+
+    return sum;
+  }
+
+protected:
+  struct Stripe {
+    std::atomic<uint64_t> value;
+    char padding[kCacheLineSize - sizeof(std::atomic<uint64_t>)];
+  };
+
+  Stripe stripes_[kNumStripes];
+};
+
+}
+}
+#endif
@@ -0,0 +1,63 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_STATS_GAUGE_H
+#define _FNORDMETRIC_STATS_GAUGE_H
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+namespace fnord {
+namespace stats {
+
+/**
+ * A value that goes up and down, e.g. a queue depth. The value is either set
+ * explicitly or computed by a callback whenever the gauge is read
+ */
+class Gauge {
+public:
+  Gauge() : value_(0) {}
+
+  Gauge(const Gauge& copy) = delete;
+  Gauge& operator=(const Gauge& copy) = delete;
+
+  void set(int64_t value) {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  /**
+   * Compute the gauge's value with the provided callback from now on. The
+   * callback is called from the thread that reads the gauge
+   */
+  void setCallback(std::function<int64_t ()> callback) {
+    std::lock_guard<std::mutex> lock_holder(mutex_);
+    callback_ = callback;
+  }
+
+  int64_t get() const {
+    {
+      std::lock_guard<std::mutex> lock_holder(mutex_);
+      if (callback_) {
+        return callback_();
+      }
+    }
+
+    return value_.load(std::memory_order_relaxed);
+  }
+
+protected:
+  std::atomic<int64_t> value_;
+  mutable std::mutex mutex_;
+  std::function<int64_t ()> callback_;
+};
+
+}
+}
+#endif
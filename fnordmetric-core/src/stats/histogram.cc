@@ -0,0 +1,104 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <fnordmetric/stats/histogram.h>
+
+namespace fnord {
+namespace stats {
+
+Histogram::Histogram() {
+  for (auto& stripe : stripes_) {
+    for (auto& bucket : stripe.buckets) {
+      bucket = 0;
+    }
+
+    stripe.sum = 0;
+  }
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot snapshot;
+  snapshot.count = 0;
+  snapshot.sum = 0;
+
+  for (int i = 0; i < kNumBuckets; ++i) {
+    snapshot.buckets[i] = 0;
+  }
+
+  for (const auto& stripe : stripes_) {
+    for (int i = 0; i < kNumBuckets; ++i) {
+      auto n = stripe.buckets[i].load(std::memory_order_relaxed);
+      snapshot.buckets[i] += n;
+      snapshot.count += n;
+    }
+
+    snapshot.sum += stripe.sum.load(std::memory_order_relaxed);
+  }
+
+  return snapshot;
+}
+
+double Histogram::bucketValue(int index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+
+  int shift = index / kSubBuckets - 1;
+  double lower = ldexp(kSubBuckets + index % kSubBuckets, shift);
+  double width = ldexp(1, shift);
+  return lower + (width - 1) / 2;
+}
+
+double Histogram::Snapshot::percentile(double percentile) const {
+  if (count == 0) {
+    return 0;
+  }
+
+  uint64_t rank = ceil(percentile / 100.0 * count);
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return bucketValue(i);
+    }
+  }
+
+  return max();
+}
+
+double Histogram::Snapshot::mean() const {
+  return count == 0 ? 0 : sum / (double) count;
+}
+
+void Histogram::Snapshot::subtract(const Snapshot& earlier) {
+  count -= earlier.count;
+  sum -= earlier.sum;
+
+  for (int i = 0; i < kNumBuckets; ++i) {
+    buckets[i] -= earlier.buckets[i];
+  }
+}
+
+double Histogram::Snapshot::max() const {
+  for (int i = kNumBuckets; i-- > 0; ) {
+    if (buckets[i] > 0) {
+      return bucketValue(i);
+    }
+  }
+
+  return 0;
+}
+
+}
+}
@@ -0,0 +1,100 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_STATS_HISTOGRAM_H
+#define _FNORDMETRIC_STATS_HISTOGRAM_H
+#include <stdint.h>
+#include <atomic>
+#include <fnordmetric/stats/stripe.h>
+
+namespace fnord {
+namespace stats {
+
+/**
+ * A histogram of unsigned integer values (e.g. latencies in microseconds)
+ * that is cheap to update from many threads at once.
+ *
+ * Each power of two is split into kSubBuckets linear buckets, so percentiles
+ * are approximated within 1/kSubBuckets of their magnitude. Like Counter, the
+ * histogram is striped by thread and every stripe is only updated with
+ * relaxed atomic adds. Use LogHistogram if you need more precision and can
+ * afford a lock.
+ */
+class Histogram {
+public:
+  static const size_t kNumStripes = 8;
+  static const int kSubBucketBits = 2;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kNumBuckets = kSubBuckets * (64 - kSubBucketBits + 1);
+
+  struct Snapshot {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t buckets[kNumBuckets];
+
+    /**
+     * Returns the (approximated) value at the provided percentile using the
+     * nearest rank method or 0 if the histogram is empty
+     */
+    double percentile(double percentile) const;
+
+    double mean() const;
+    double max() const;
+
+    /**
+     * Remove the values of an earlier snapshot of the same histogram, so
+     * that only the values inserted since then remain
+     */
+    void subtract(const Snapshot& earlier);
+  };
+
+  Histogram();
+  Histogram(const Histogram& copy) = delete;
+  Histogram& operator=(const Histogram& copy) = delete;
+
+  inline void insert(uint64_t value) {
+    auto& stripe = stripes_[currentStripe<kNumStripes>()];
+    stripe.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    stripe.sum.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  /**
+   * Returns a copy of the histogram. The copy is not atomic, concurrent
+   * inserts may or may not be included
+   */
+  Snapshot snapshot() const;
+
+  static int bucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+      return value;
+    }
+
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - kSubBucketBits;
+    return kSubBuckets * (shift + 1) + ((value >> shift) & (kSubBuckets - 1));
+  }
+
+  /**
+   * Returns the midpoint of the range of values counted in the bucket
+   */
+  static double bucketValue(int index);
+
+protected:
+  struct Stripe {
+    std::atomic<uint64_t> buckets[kNumBuckets];
+    std::atomic<uint64_t> sum;
+    char padding[kCacheLineSize];
+  };
+
+  Stripe stripes_[kNumStripes];
+};
+
+}
+}
+#endif
@@ -0,0 +1,93 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <time.h>
+#include <map>
+#include <memory>
+#include <fnordmetric/stats/profiledmutex.h>
+
+namespace fnord {
+namespace stats {
+
+static std::mutex lock_stats_mutex;
+
+static std::map<std::string, std::unique_ptr<LockStats>>* lockStatsMap() {
+  static std::map<std::string, std::unique_ptr<LockStats>> lock_stats;
+  return &lock_stats;
+}
+
+LockStats* LockStats::get(const std::string& name) {
+  std::lock_guard<std::mutex> lock_holder(lock_stats_mutex);
+  auto& stats = (*lockStatsMap())[name];
+
+  if (stats.get() == nullptr) {
+    stats.reset(new LockStats());
+  }
+
+  return stats.get();
+}
+
+void LockStats::exportAll(
+    std::function<void (const std::string& name, const LockStats& stats)> fn) {
+  std::lock_guard<std::mutex> lock_holder(lock_stats_mutex);
+
+  for (const auto& stats : *lockStatsMap()) {
+    fn(stats.first, *stats.second);
+  }
+}
+
+#ifdef FNORD_ENABLE_PROFILING
+
+static inline uint64_t monotonicNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+ProfiledMutex::ProfiledMutex(
+    const char* name) :
+    stats_(LockStats::get(name)),
+    acquired_at_(0) {}
+
+void ProfiledMutex::lock() {
+  if (mutex_.try_lock()) {
+    acquired_at_ = monotonicNanos();
+  } else {
+    auto wait_begin = monotonicNanos();
+    mutex_.lock();
+    acquired_at_ = monotonicNanos();
+    stats_->contentions.incr();
+    stats_->wait_nanos.insert(acquired_at_ - wait_begin);
+  }
+
+  stats_->acquisitions.incr();
+}
+
+bool ProfiledMutex::try_lock() {
+  if (!mutex_.try_lock()) {
+    stats_->contentions.incr();
+    return false;
+  }
+
+  acquired_at_ = monotonicNanos();
+  stats_->acquisitions.incr();
+  return true;
+}
+
+void ProfiledMutex::unlock() {
+  /* acquired_at_ must be read while we still hold the lock */
+  auto hold_nanos = monotonicNanos() - acquired_at_;
+  mutex_.unlock();
+  stats_->hold_nanos.insert(hold_nanos);
+}
+
+#endif
+
+}
+}
@@ -0,0 +1,88 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_STATS_PROFILEDMUTEX_H
+#define _FNORDMETRIC_STATS_PROFILEDMUTEX_H
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <fnordmetric/stats/counter.h>
+#include <fnordmetric/stats/histogram.h>
+#include "config.h"
+
+namespace fnord {
+namespace stats {
+
+/**
+ * Contention statistics of all locks with the same name
+ */
+struct LockStats {
+  Counter acquisitions;
+  Counter contentions;
+  Histogram wait_nanos;
+  Histogram hold_nanos;
+
+  /**
+   * Returns the stats for the provided lock name. The returned pointer is
+   * valid forever
+   */
+  static LockStats* get(const std::string& name);
+
+  /**
+   * Calls the provided function for every lock name, sorted by name
+   */
+  static void exportAll(
+      std::function<void (const std::string& name, const LockStats& stats)>
+          fn);
+};
+
+#ifdef FNORD_ENABLE_PROFILING
+
+/**
+ * A drop-in replacement for std::mutex that records how often the lock was
+ * acquired, how often it was contended and how long threads waited for and
+ * held it. All mutexes with the same name share one LockStats entry, so e.g.
+ * the head_mutex_ of every disk metric is reported as one lock.
+ *
+ * Only built with -DENABLE_PROFILING=ON. Otherwise a ProfiledMutex is a plain
+ * std::mutex and the name is ignored.
+ */
+class ProfiledMutex {
+public:
+  static const bool kEnabled = true;
+
+  explicit ProfiledMutex(const char* name);
+  ProfiledMutex(const ProfiledMutex& copy) = delete;
+  ProfiledMutex& operator=(const ProfiledMutex& copy) = delete;
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+protected:
+  std::mutex mutex_;
+  LockStats* stats_;
+  uint64_t acquired_at_;
+};
+
+#else
+
+class ProfiledMutex : public std::mutex {
+public:
+  static const bool kEnabled = false;
+
+  explicit ProfiledMutex(const char* name) {}
+};
+
+#endif
+
+}
+}
+#endif
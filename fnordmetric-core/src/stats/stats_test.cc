@@ -0,0 +1,211 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <fnordmetric/metricdb/backends/inmemory/metricrepository.h>
+#include <fnordmetric/metricdb/statsrecorder.h>
+#include <fnordmetric/stats/allocationscope.h>
+#include <fnordmetric/stats/profiledmutex.h>
+#include <fnordmetric/stats/statsregistry.h>
+#include <fnordmetric/stats/threadcputime.h>
+#include <fnordmetric/util/unittest.h>
+
+using fnord::stats::AllocationScope;
+using fnord::stats::AllocationStats;
+using fnord::stats::Counter;
+using fnord::stats::Gauge;
+using fnord::stats::Histogram;
+using fnord::stats::LockStats;
+using fnord::stats::ProfiledMutex;
+using fnord::stats::StatsRegistry;
+using namespace fnordmetric::metricdb;
+
+UNIT_TEST(StatsTest);
+
+TEST_CASE(StatsTest, TestConcurrentCounter, [] () {
+  Counter counter;
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 32; ++i) {
+    threads.emplace_back([&counter] () {
+      for (int j = 0; j < 10000; ++j) {
+        counter.incr();
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  counter.incr(42);
+  EXPECT_EQ(counter.get(), 320042);
+});
+
+TEST_CASE(StatsTest, TestHistogramPercentiles, [] () {
+  Histogram histogram;
+
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.insert(i);
+  }
+
+  auto snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count, 1000);
+  EXPECT_EQ(snapshot.sum, 500500);
+  EXPECT(snapshot.mean() == 500.5);
+
+  /* percentiles are accurate to within one sub bucket (25%) */
+  EXPECT(snapshot.percentile(50) > 500 * 0.75);
+  EXPECT(snapshot.percentile(50) < 500 * 1.25);
+  EXPECT(snapshot.percentile(99) > 990 * 0.75);
+  EXPECT(snapshot.percentile(99) < 990 * 1.25);
+  EXPECT(snapshot.max() > 1000 * 0.75);
+
+  /* small values are exact */
+  EXPECT(Histogram::bucketValue(Histogram::bucketIndex(0)) == 0);
+  EXPECT(Histogram::bucketValue(Histogram::bucketIndex(3)) == 3);
+  EXPECT(Histogram::bucketIndex(UINT64_MAX) < Histogram::kNumBuckets);
+
+  histogram.insert(5000);
+  auto later = histogram.snapshot();
+  later.subtract(snapshot);
+  EXPECT_EQ(later.count, 1);
+  EXPECT(later.percentile(50) > 5000 * 0.75);
+});
+
+TEST_CASE(StatsTest, TestRegistry, [] () {
+  StatsRegistry registry;
+  auto counter = registry.counter("test.counter");
+  EXPECT(registry.counter("test.counter") == counter);
+
+  counter->incr(3);
+  registry.gauge("test.gauge")->set(-7);
+  registry.gauge("test.callback")->setCallback([] () -> int64_t {
+    return 23;
+  });
+  registry.histogram("test.histogram")->insert(100);
+
+  std::string exported;
+  registry.exportStats(
+      [&exported] (const std::string& name, const Counter& counter) {
+        exported += name + "=" + std::to_string(counter.get()) + ";";
+      },
+      [&exported] (const std::string& name, const Gauge& gauge) {
+        exported += name + "=" + std::to_string(gauge.get()) + ";";
+      },
+      [&exported] (const std::string& name, const Histogram& histogram) {
+        exported +=
+            name + "=" + std::to_string(histogram.snapshot().count) + ";";
+      });
+
+  EXPECT_EQ(
+      exported,
+      "test.counter=3;test.callback=23;test.gauge=-7;test.histogram=1;");
+});
+
+TEST_CASE(StatsTest, TestStatsRecorder, [] () {
+  StatsRegistry registry;
+  inmemory_backend::MetricRepository metric_repo;
+  StatsRecorder recorder(&registry, &metric_repo, nullptr, 0);
+
+  registry.counter("test.counter")->incr(5);
+  registry.histogram("test.histogram")->insert(10);
+  recorder.run();
+
+  registry.counter("test.counter")->incr(2);
+  recorder.run();
+
+  /* counters are recorded as the increase since the last run */
+  std::vector<double> values;
+  metric_repo.findMetric("fnordmetric.test.counter")->scanSamples(
+      fnord::util::DateTime::epoch(),
+      fnord::util::DateTime(UINT64_MAX),
+      [&values] (Sample* sample) -> bool {
+        values.emplace_back(sample->value());
+        return true;
+      });
+
+  EXPECT_EQ(values.size(), 2);
+  EXPECT(values[0] == 5);
+  EXPECT(values[1] == 2);
+
+  /* count, p50, p99 and max in the first run, only the count in the second */
+  size_t num_samples = 0;
+  metric_repo.findMetric("fnordmetric.test.histogram")->scanSamples(
+      fnord::util::DateTime::epoch(),
+      fnord::util::DateTime(UINT64_MAX),
+      [&num_samples] (Sample* sample) -> bool {
+        num_samples++;
+        return true;
+      });
+
+  EXPECT_EQ(num_samples, 5);
+});
+
+TEST_CASE(StatsTest, TestProfiledMutex, [] () {
+  ProfiledMutex mutex("test.profiled_mutex");
+  uint64_t value = 0;
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&mutex, &value] () {
+      for (int j = 0; j < 10000; ++j) {
+        std::lock_guard<ProfiledMutex> lock_holder(mutex);
+        value++;
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(value, 80000);
+
+  auto stats = LockStats::get("test.profiled_mutex");
+  if (ProfiledMutex::kEnabled) {
+    EXPECT_EQ(stats->acquisitions.get(), 80000);
+    EXPECT_EQ(stats->hold_nanos.snapshot().count, 80000);
+    EXPECT_EQ(
+        stats->wait_nanos.snapshot().count,
+        stats->contentions.get());
+  } else {
+    EXPECT_EQ(stats->acquisitions.get(), 0);
+  }
+});
+
+TEST_CASE(StatsTest, TestAllocationScope, [] () {
+  const auto& stats = AllocationStats::get(AllocationStats::SUBSYSTEM_QUERY);
+  auto allocations_before = stats.allocations.get();
+  auto bytes_before = stats.bytes_allocated.get();
+
+  {
+    AllocationScope scope(AllocationStats::SUBSYSTEM_QUERY);
+    std::unique_ptr<std::vector<char>> vec(new std::vector<char>(1000));
+  }
+
+  if (ProfiledMutex::kEnabled) {
+    EXPECT(stats.allocations.get() - allocations_before >= 2);
+    EXPECT(stats.bytes_allocated.get() - bytes_before >= 1000);
+  } else {
+    EXPECT_EQ(stats.allocations.get(), 0);
+  }
+});
+
+TEST_CASE(StatsTest, TestThreadCPUTimes, [] () {
+#if defined(__linux__)
+  auto threads = fnord::stats::getThreadCPUTimes();
+  EXPECT(threads.size() >= 1);
+  EXPECT(threads[0].name.size() > 0);
+  EXPECT(threads[0].user_millis >= 0);
+#endif
+});
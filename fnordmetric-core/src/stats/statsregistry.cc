@@ -0,0 +1,64 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <fnordmetric/stats/statsregistry.h>
+
+namespace fnord {
+namespace stats {
+
+template <typename T>
+T* StatsRegistry::getOrCreate(
+    std::map<std::string, std::unique_ptr<T>>* stats,
+    const std::string& name) {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+
+  auto& stat = (*stats)[name];
+  if (stat.get() == nullptr) {
+    stat.reset(new T());
+  }
+
+  return stat.get();
+}
+
+Counter* StatsRegistry::counter(const std::string& name) {
+  return getOrCreate(&counters_, name);
+}
+
+Gauge* StatsRegistry::gauge(const std::string& name) {
+  return getOrCreate(&gauges_, name);
+}
+
+Histogram* StatsRegistry::histogram(const std::string& name) {
+  return getOrCreate(&histograms_, name);
+}
+
+void StatsRegistry::exportStats(
+    std::function<void (const std::string& name, const Counter& counter)>
+        counter_fn,
+    std::function<void (const std::string& name, const Gauge& gauge)>
+        gauge_fn,
+    std::function<void (const std::string& name, const Histogram& histogram)>
+        histogram_fn) const {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+
+  for (const auto& counter : counters_) {
+    counter_fn(counter.first, *counter.second);
+  }
+
+  for (const auto& gauge : gauges_) {
+    gauge_fn(gauge.first, *gauge.second);
+  }
+
+  for (const auto& histogram : histograms_) {
+    histogram_fn(histogram.first, *histogram.second);
+  }
+}
+
+}
+}
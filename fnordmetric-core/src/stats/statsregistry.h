@@ -0,0 +1,73 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_STATS_STATSREGISTRY_H
+#define _FNORDMETRIC_STATS_STATSREGISTRY_H
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <fnordmetric/stats/counter.h>
+#include <fnordmetric/stats/gauge.h>
+#include <fnordmetric/stats/histogram.h>
+
+namespace fnord {
+namespace stats {
+
+/**
+ * A named set of counters, gauges and histograms that describe the server
+ * itself (samples received, query latencies, ...).
+ *
+ * Looking up a stat by name takes a lock, so components should look up their
+ * stats once (e.g. in their constructor) and keep the returned pointer. The
+ * returned stats are valid for the lifetime of the registry and updating
+ * them never takes a lock. Looking up the same name twice returns the same
+ * stat.
+ *
+ * Names are dot separated, e.g. "statsd.samples_received". The process wide
+ * registry is fnordmetric::env()->stats().
+ */
+class StatsRegistry {
+public:
+  StatsRegistry() {}
+  StatsRegistry(const StatsRegistry& copy) = delete;
+  StatsRegistry& operator=(const StatsRegistry& copy) = delete;
+
+  Counter* counter(const std::string& name);
+  Gauge* gauge(const std::string& name);
+  Histogram* histogram(const std::string& name);
+
+  /**
+   * Call the provided functions for every stat in the registry, ordered by
+   * name
+   */
+  void exportStats(
+      std::function<void (const std::string& name, const Counter& counter)>
+          counter_fn,
+      std::function<void (const std::string& name, const Gauge& gauge)>
+          gauge_fn,
+      std::function<void (const std::string& name, const Histogram& histogram)>
+          histogram_fn) const;
+
+protected:
+  template <typename T>
+  T* getOrCreate(
+      std::map<std::string, std::unique_ptr<T>>* stats,
+      const std::string& name);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Counter>> counters_;
+  std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+  std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+};
+
+}
+}
+#endif
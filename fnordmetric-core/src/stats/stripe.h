@@ -0,0 +1,35 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_STATS_STRIPE_H
+#define _FNORDMETRIC_STATS_STRIPE_H
+#include <stdlib.h>
+#include <atomic>
+
+namespace fnord {
+namespace stats {
+
+static const size_t kCacheLineSize = 64;
+
+/**
+ * Returns the stripe of the calling thread. Threads are assigned to stripes
+ * round-robin on their first call, so as long as there are fewer threads than
+ * stripes, no two threads update the same stripe (and cache line) of a
+ * striped counter
+ */
+template <size_t kNumStripes>
+inline size_t currentStripe() {
+  static std::atomic<size_t> next_stripe(0);
+  static thread_local size_t stripe = next_stripe++ % kNumStripes;
+  return stripe;
+}
+
+}
+}
+#endif
@@ -0,0 +1,99 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fnordmetric/stats/threadcputime.h>
+
+namespace fnord {
+namespace stats {
+
+/**
+ * Parses one /proc/self/task/<tid>/stat file. The thread name is enclosed in
+ * parens and may contain spaces, so the remaining fields are read after the
+ * last closing paren; utime and stime are the 14th and 15th field
+ */
+static bool readThreadStat(uint64_t tid, ThreadCPUTime* thread) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/task/%llu/stat",
+      (unsigned long long) tid);
+
+  auto file = fopen(path, "r");
+  if (file == nullptr) {
+    return false;
+  }
+
+  char buf[1024];
+  auto len = fread(buf, 1, sizeof(buf) - 1, file);
+  fclose(file);
+  buf[len] = 0;
+
+  auto name_begin = strchr(buf, '(');
+  auto name_end = strrchr(buf, ')');
+  if (name_begin == nullptr || name_end == nullptr || name_end < name_begin) {
+    return false;
+  }
+
+  unsigned long long utime;
+  unsigned long long stime;
+  auto num_fields = sscanf(
+      name_end + 1,
+      " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+      &utime,
+      &stime);
+
+  if (num_fields != 2) {
+    return false;
+  }
+
+  double millis_per_tick = 1000.0 / sysconf(_SC_CLK_TCK);
+  thread->tid = tid;
+  thread->name = std::string(name_begin + 1, name_end - name_begin - 1);
+  thread->user_millis = utime * millis_per_tick;
+  thread->system_millis = stime * millis_per_tick;
+  return true;
+}
+
+std::vector<ThreadCPUTime> getThreadCPUTimes() {
+  std::vector<ThreadCPUTime> threads;
+
+  auto dir = opendir("/proc/self/task");
+  if (dir == nullptr) {
+    return threads;
+  }
+
+  for (auto entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+    if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+      continue;
+    }
+
+    ThreadCPUTime thread;
+    if (readThreadStat(strtoull(entry->d_name, NULL, 10), &thread)) {
+      threads.emplace_back(thread);
+    }
+  }
+
+  closedir(dir);
+
+  std::sort(
+      threads.begin(),
+      threads.end(),
+      [] (const ThreadCPUTime& a, const ThreadCPUTime& b) {
+        return a.tid < b.tid;
+      });
+
+  return threads;
+}
+
+}
+}
@@ -0,0 +1,35 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_STATS_THREADCPUTIME_H
+#define _FNORDMETRIC_STATS_THREADCPUTIME_H
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace fnord {
+namespace stats {
+
+struct ThreadCPUTime {
+  uint64_t tid;
+  std::string name;
+  double user_millis;
+  double system_millis;
+};
+
+/**
+ * Returns the user and system CPU time of every thread in this process,
+ * sorted by tid. Read from /proc/self/task, so this returns an empty list on
+ * systems without procfs
+ */
+std::vector<ThreadCPUTime> getThreadCPUTimes();
+
+}
+}
+#endif
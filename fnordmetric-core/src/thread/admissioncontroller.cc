@@ -0,0 +1,92 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <exception>
+#include <fnordmetric/thread/admissioncontroller.h>
+#include <fnordmetric/thread/task.h>
+
+namespace fnord {
+namespace thread {
+
+AdmissionController::AdmissionController(
+    size_t max_running,
+    size_t max_queued /* = kUnlimited */) :
+    max_running_(max_running),
+    max_queued_(max_queued),
+    num_running_(0),
+    num_rejected_(0) {}
+
+bool AdmissionController::run(
+    TaskScheduler* scheduler,
+    std::function<void()> task,
+    TaskScheduler::kPriority priority) {
+  {
+    std::lock_guard<std::mutex> lock_holder(mutex_);
+    if (num_running_ >= max_running_) {
+      if (queue_.size() >= max_queued_) {
+        num_rejected_++;
+        return false;
+      }
+
+      queue_.emplace_back(task);
+      return true;
+    }
+
+    num_running_++;
+  }
+
+  /* the admitted task keeps running queued tasks until the queue is empty,
+     so at most max_running tasks are running at any time */
+  scheduler->run(Task::create([this, task] () {
+    auto next_task = task;
+    std::exception_ptr error;
+
+    for (;;) {
+      try {
+        next_task();
+      } catch (...) {
+        /* report the error once the slot has been released */
+        error = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock_holder(mutex_);
+      if (queue_.empty()) {
+        num_running_--;
+        break;
+      }
+
+      next_task = queue_.front();
+      queue_.pop_front();
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }), priority);
+
+  return true;
+}
+
+size_t AdmissionController::numRunning() const {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+  return num_running_;
+}
+
+size_t AdmissionController::numQueued() const {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+  return queue_.size();
+}
+
+uint64_t AdmissionController::numRejected() const {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+  return num_rejected_;
+}
+
+}
+}
@@ -0,0 +1,61 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_THREAD_ADMISSIONCONTROLLER_H
+#define _FNORDMETRIC_THREAD_ADMISSIONCONTROLLER_H
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <fnordmetric/thread/taskscheduler.h>
+
+namespace fnord {
+namespace thread {
+
+/**
+ * Limits the number of concurrently running tasks of one kind (e.g. queries)
+ * on a task scheduler.
+ *
+ * At most max_running admitted tasks run at the same time. Further tasks are
+ * queued without occupying a thread and started in FIFO order once a running
+ * task finishes. If max_queued tasks are already waiting, new tasks are
+ * rejected.
+ *
+ * An admission controller is threadsafe.
+ */
+class AdmissionController {
+public:
+  static const size_t kUnlimited = (size_t) -1;
+
+  AdmissionController(size_t max_running, size_t max_queued = kUnlimited);
+
+  /**
+   * Run the task on the scheduler once less than max_running tasks are
+   * running. Returns false if the task was rejected because the queue is full
+   */
+  bool run(
+      TaskScheduler* scheduler,
+      std::function<void()> task,
+      TaskScheduler::kPriority priority = TaskScheduler::PRIORITY_NORMAL);
+
+  size_t numRunning() const;
+  size_t numQueued() const;
+  uint64_t numRejected() const;
+
+protected:
+  size_t max_running_;
+  size_t max_queued_;
+  mutable std::mutex mutex_;
+  std::deque<std::function<void()>> queue_;
+  size_t num_running_;
+  uint64_t num_rejected_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,91 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_THREAD_MPSCQUEUE_H
+#define _FNORDMETRIC_THREAD_MPSCQUEUE_H
+#include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <fnordmetric/stats/stripe.h>
+
+namespace fnord {
+namespace thread {
+
+/**
+ * A bounded lock-free multi-producer single-consumer ring buffer.
+ *
+ * Every slot carries a sequence number that tells producers whether the slot
+ * is free and the consumer whether it was published, so neither side ever
+ * takes a lock or waits for the other (D. Vyukov's bounded queue). Producers
+ * claim a slot with a single CAS on the enqueue position; tryPush fails
+ * instead of blocking once all slots are used.
+ *
+ * tryPop and empty must only be called from one thread at a time. T must be
+ * default constructible and move assignable.
+ */
+template <typename T>
+class MPSCQueue {
+public:
+
+  /**
+   * The capacity is rounded up to the next power of two
+   */
+  explicit MPSCQueue(size_t capacity);
+
+  MPSCQueue(const MPSCQueue& copy) = delete;
+  MPSCQueue& operator=(const MPSCQueue& copy) = delete;
+
+  /**
+   * Append the value and return true or return false if the queue is full.
+   * The value is only moved from if it was appended
+   */
+  bool tryPush(T&& value);
+
+  /**
+   * Move the oldest value into target and return true or return false if the
+   * queue is empty
+   */
+  bool tryPop(T* target);
+
+  bool empty() const;
+
+  /**
+   * Returns true if the next tryPush would fail
+   */
+  bool full() const;
+
+  /**
+   * Returns the number of values in the queue. Only an estimate while values
+   * are pushed or popped concurrently
+   */
+  size_t size() const;
+
+  size_t capacity() const;
+
+protected:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  char padding1_[fnord::stats::kCacheLineSize];
+  std::atomic<size_t> enqueue_pos_;
+  char padding2_[fnord::stats::kCacheLineSize];
+  std::atomic<size_t> dequeue_pos_;
+  char padding3_[fnord::stats::kCacheLineSize];
+};
+
+}
+}
+
+#include "mpscqueue_impl.h"
+#endif
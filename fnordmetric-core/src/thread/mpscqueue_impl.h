@@ -0,0 +1,106 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_THREAD_MPSCQUEUE_IMPL_H
+#define _FNORDMETRIC_THREAD_MPSCQUEUE_IMPL_H
+
+namespace fnord {
+namespace thread {
+
+template <typename T>
+MPSCQueue<T>::MPSCQueue(size_t capacity) :
+    enqueue_pos_(0),
+    dequeue_pos_(0) {
+  size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+
+  slots_.reset(new Slot[size]);
+  mask_ = size - 1;
+
+  for (size_t i = 0; i < size; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+bool MPSCQueue<T>::tryPush(T&& value) {
+  auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Slot* slot;
+
+  for (;;) {
+    slot = &slots_[pos & mask_];
+    auto seq = slot->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(
+              pos,
+              pos + 1,
+              std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* the slot still holds the value from the previous round */
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->value = std::move(value);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+bool MPSCQueue<T>::tryPop(T* target) {
+  auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+  auto slot = &slots_[pos & mask_];
+
+  if (slot->sequence.load(std::memory_order_acquire) != pos + 1) {
+    return false;
+  }
+
+  *target = std::move(slot->value);
+  slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+  return true;
+}
+
+template <typename T>
+bool MPSCQueue<T>::empty() const {
+  auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+  auto slot = &slots_[pos & mask_];
+  return slot->sequence.load(std::memory_order_acquire) != pos + 1;
+}
+
+template <typename T>
+bool MPSCQueue<T>::full() const {
+  auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+  auto slot = &slots_[pos & mask_];
+  return slot->sequence.load(std::memory_order_acquire) != pos;
+}
+
+template <typename T>
+size_t MPSCQueue<T>::size() const {
+  auto dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+  auto enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+  return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+}
+
+template <typename T>
+size_t MPSCQueue<T>::capacity() const {
+  return mask_ + 1;
+}
+
+}
+}
+#endif
@@ -0,0 +1,309 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+#include <fnordmetric/thread/poller.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+namespace fnord {
+namespace thread {
+
+static uint64_t monotonicMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Poller::Poller() : shutdown_(false), poll_fd_(-1) {
+  if (pipe(wakeup_fds_) < 0) {
+    RAISE_ERRNO(kIOError, "pipe() failed");
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    fcntl(wakeup_fds_[i], F_SETFL, fcntl(wakeup_fds_[i], F_GETFL) | O_NONBLOCK);
+    fcntl(wakeup_fds_[i], F_SETFD, FD_CLOEXEC);
+  }
+
+#if defined(__linux__)
+  poll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (poll_fd_ < 0) {
+    RAISE_ERRNO(kIOError, "epoll_create1() failed");
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = wakeup_fds_[0];
+  if (epoll_ctl(poll_fd_, EPOLL_CTL_ADD, wakeup_fds_[0], &ev) < 0) {
+    RAISE_ERRNO(kIOError, "epoll_ctl() failed");
+  }
+#endif
+
+  thread_ = std::thread(std::bind(&Poller::run, this));
+}
+
+Poller::~Poller() {
+  {
+    std::lock_guard<std::mutex> lock_holder(mutex_);
+    shutdown_ = true;
+  }
+
+  wakeup();
+  thread_.join();
+
+  close(wakeup_fds_[0]);
+  close(wakeup_fds_[1]);
+  if (poll_fd_ >= 0) {
+    close(poll_fd_);
+  }
+}
+
+void Poller::onReadable(int fd, std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+  auto& waiters = waiters_[fd];
+  if (waiters.on_readable) {
+    RAISE(kRuntimeError, "fd %i is already waiting to become readable", fd);
+  }
+
+  waiters.on_readable = callback;
+  update(fd, waiters);
+}
+
+void Poller::onWritable(int fd, std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock_holder(mutex_);
+  auto& waiters = waiters_[fd];
+  if (waiters.on_writable) {
+    RAISE(kRuntimeError, "fd %i is already waiting to become writable", fd);
+  }
+
+  waiters.on_writable = callback;
+  update(fd, waiters);
+}
+
+void Poller::onTimeout(uint64_t delay_micros, std::function<void()> callback) {
+  {
+    std::lock_guard<std::mutex> lock_holder(mutex_);
+    timers_.emplace(monotonicMicros() + delay_micros, callback);
+  }
+
+  /* the poller thread has to recompute its timeout */
+  wakeup();
+}
+
+void Poller::wakeup() {
+  char byte = 0;
+  if (write(wakeup_fds_[1], &byte, 1) < 0 && errno != EAGAIN) {
+    RAISE_ERRNO(kIOError, "write() failed");
+  }
+}
+
+#if defined(__linux__)
+
+void Poller::update(int fd, const Waiters& waiters) {
+  struct epoll_event ev;
+  ev.events = EPOLLONESHOT;
+  ev.data.fd = fd;
+
+  if (waiters.on_readable) {
+    ev.events |= EPOLLIN | EPOLLRDHUP;
+  }
+
+  if (waiters.on_writable) {
+    ev.events |= EPOLLOUT;
+  }
+
+  /* one-shot registrations stay in the epoll set once they have fired, so
+     re-arm them. the fd is only unknown if it was closed in the meantime */
+  if (epoll_ctl(poll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0) {
+    return;
+  }
+
+  if (errno != ENOENT || epoll_ctl(poll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    RAISE_ERRNO(kIOError, "epoll_ctl(%i) failed", fd);
+  }
+}
+
+void Poller::run() {
+  static const int kMaxEventsPerPoll = 64;
+  struct epoll_event events[kMaxEventsPerPoll];
+
+  for (;;) {
+    int timeout;
+    {
+      std::lock_guard<std::mutex> lock_holder(mutex_);
+      if (shutdown_) {
+        return;
+      }
+
+      timeout = nextTimeoutMillis();
+    }
+
+    auto num_events = epoll_wait(poll_fd_, events, kMaxEventsPerPoll, timeout);
+    if (num_events < 0 && errno != EINTR) {
+      RAISE_ERRNO(kIOError, "epoll_wait() failed");
+    }
+
+    for (int i = 0; i < num_events; ++i) {
+      if (events[i].data.fd == wakeup_fds_[0]) {
+        char buf[256];
+        while (read(wakeup_fds_[0], buf, sizeof(buf)) > 0);
+        continue;
+      }
+
+      auto ev = events[i].events;
+      dispatch(
+          events[i].data.fd,
+          ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR),
+          ev & (EPOLLOUT | EPOLLHUP | EPOLLERR));
+    }
+
+    fireTimers();
+  }
+}
+
+#else
+
+void Poller::update(int fd, const Waiters& waiters) {
+  /* the poll() loop rebuilds its fd set on every iteration */
+  wakeup();
+}
+
+void Poller::run() {
+  std::vector<struct pollfd> fds;
+
+  for (;;) {
+    int timeout;
+    fds.clear();
+
+    {
+      std::lock_guard<std::mutex> lock_holder(mutex_);
+      if (shutdown_) {
+        return;
+      }
+
+      timeout = nextTimeoutMillis();
+
+      struct pollfd wakeup_fd;
+      wakeup_fd.fd = wakeup_fds_[0];
+      wakeup_fd.events = POLLIN;
+      fds.emplace_back(wakeup_fd);
+
+      for (const auto& waiter : waiters_) {
+        struct pollfd pfd;
+        pfd.fd = waiter.first;
+        pfd.events = 0;
+        pfd.events |= waiter.second.on_readable ? POLLIN : 0;
+        pfd.events |= waiter.second.on_writable ? POLLOUT : 0;
+        fds.emplace_back(pfd);
+      }
+    }
+
+    if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+      RAISE_ERRNO(kIOError, "poll() failed");
+    }
+
+    if (fds[0].revents) {
+      char buf[256];
+      while (read(wakeup_fds_[0], buf, sizeof(buf)) > 0);
+    }
+
+    for (int i = 1; i < fds.size(); ++i) {
+      auto ev = fds[i].revents;
+      if (ev) {
+        dispatch(
+            fds[i].fd,
+            ev & (POLLIN | POLLHUP | POLLERR | POLLNVAL),
+            ev & (POLLOUT | POLLHUP | POLLERR | POLLNVAL));
+      }
+    }
+
+    fireTimers();
+  }
+}
+
+#endif
+
+void Poller::dispatch(int fd, bool readable, bool writable) {
+  std::function<void()> on_readable;
+  std::function<void()> on_writable;
+
+  {
+    std::lock_guard<std::mutex> lock_holder(mutex_);
+    auto iter = waiters_.find(fd);
+    if (iter == waiters_.end()) {
+      return;
+    }
+
+    auto& waiters = iter->second;
+    if (readable) {
+      on_readable.swap(waiters.on_readable);
+    }
+
+    if (writable) {
+      on_writable.swap(waiters.on_writable);
+    }
+
+    if (waiters.on_readable || waiters.on_writable) {
+      update(fd, waiters);
+    } else {
+      waiters_.erase(iter);
+    }
+  }
+
+  if (on_readable) {
+    on_readable();
+  }
+
+  if (on_writable) {
+    on_writable();
+  }
+}
+
+int Poller::nextTimeoutMillis() {
+  if (timers_.empty()) {
+    return -1;
+  }
+
+  auto now = monotonicMicros();
+  auto next = timers_.begin()->first;
+  if (next <= now) {
+    return 0;
+  }
+
+  return (next - now + 999) / 1000;
+}
+
+void Poller::fireTimers() {
+  std::vector<std::function<void()>> expired;
+
+  {
+    std::lock_guard<std::mutex> lock_holder(mutex_);
+    auto now = monotonicMicros();
+
+    while (!timers_.empty() && timers_.begin()->first <= now) {
+      expired.emplace_back(timers_.begin()->second);
+      timers_.erase(timers_.begin());
+    }
+  }
+
+  for (const auto& callback : expired) {
+    callback();
+  }
+}
+
+}
+}
@@ -0,0 +1,82 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_THREAD_POLLER_H
+#define _FNORDMETRIC_THREAD_POLLER_H
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace fnord {
+namespace thread {
+
+/**
+ * Waits for file descriptor readiness and timers on a single background
+ * thread. Instead of parking a thread per file descriptor, every callback is
+ * registered with the poller and invoked on the poller's thread once the
+ * descriptor becomes ready or the timer expires. Callbacks must not block;
+ * usually they just hand a task to a ThreadPool.
+ *
+ * All registrations are one-shot. Uses epoll on Linux and poll() elsewhere.
+ * A poller is threadsafe.
+ */
+class Poller {
+public:
+  Poller();
+
+  /**
+   * Stops the poller thread. Callbacks that haven't fired yet are dropped
+   */
+  ~Poller();
+
+  /**
+   * Invoke the callback once the provided file descriptor becomes readable
+   * (or is closed/in an error state)
+   */
+  void onReadable(int fd, std::function<void()> callback);
+
+  /**
+   * Invoke the callback once the provided file descriptor becomes writable
+   * (or is closed/in an error state)
+   */
+  void onWritable(int fd, std::function<void()> callback);
+
+  /**
+   * Invoke the callback once at least delay_micros microseconds have passed
+   */
+  void onTimeout(uint64_t delay_micros, std::function<void()> callback);
+
+protected:
+  struct Waiters {
+    std::function<void()> on_readable;
+    std::function<void()> on_writable;
+  };
+
+  void run();
+  void wakeup();
+  void update(int fd, const Waiters& waiters);
+  void dispatch(int fd, bool readable, bool writable);
+  int nextTimeoutMillis();
+  void fireTimers();
+
+  std::mutex mutex_;
+  std::unordered_map<int, Waiters> waiters_;
+  std::multimap<uint64_t, std::function<void()>> timers_;
+  bool shutdown_;
+  int poll_fd_;
+  int wakeup_fds_[2];
+  std::thread thread_;
+};
+
+}
+}
+#endif
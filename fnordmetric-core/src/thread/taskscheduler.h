@@ -9,6 +9,7 @@
  */
 #ifndef _FNORDMETRIC_THREAD_TASKSCHEDULER_H
 #define _FNORDMETRIC_THREAD_TASKSCHEDULER_H
+#include <stdint.h>
 #include <fnordmetric/thread/task.h>
 
 namespace fnord {
@@ -16,13 +17,40 @@ namespace thread {
 
 class TaskScheduler {
 public:
+  /**
+   * Task priorities. Runnable tasks with a higher priority are preferred over
+   * tasks with a lower priority, so that e.g. background compaction and
+   * queries can't starve ingest
+   */
+  enum kPriority {
+    PRIORITY_HIGH = 0,
+    PRIORITY_NORMAL = 1,
+    PRIORITY_LOW = 2
+  };
+
+  static const int kNumPriorities = 3;
+
   virtual ~TaskScheduler() {}
 
   /**
-   * Run the provided task as soon as possible
+   * Run the provided task as soon as possible with normal priority
    */
   virtual void run(std::shared_ptr<Task> task) = 0;
 
+  /**
+   * Run the provided task as soon as possible with the provided priority
+   */
+  virtual void run(std::shared_ptr<Task> task, kPriority priority) = 0;
+
+  /**
+   * Run the provided task with the provided priority once at least
+   * delay_micros microseconds have passed
+   */
+  virtual void runAfter(
+      std::shared_ptr<Task> task,
+      uint64_t delay_micros,
+      kPriority priority) = 0;
+
   /**
    * Run the provided task when the provided filedescriptor becomes readable
    */
@@ -7,124 +7,282 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
-#include <assert.h>
+#include <chrono>
+#include <errno.h>
 #include <memory>
+#include <string.h>
 #include <fnordmetric/thread/threadpool.h>
 #include <fnordmetric/util/runtimeexception.h>
-#include <sys/select.h>
-#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 using fnord::util::ExceptionHandler;
 
 namespace fnord {
 namespace thread {
 
+/* the pool and worker index of the calling thread if it is a worker thread */
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+static uint64_t monotonicMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 ThreadPool::ThreadPool(
-    std::unique_ptr<ExceptionHandler> error_handler) :
+    std::unique_ptr<ExceptionHandler> error_handler,
+    size_t num_threads,
+    const std::string& name) :
+    name_(name),
     error_handler_(std::move(error_handler)),
-    free_threads_(0) {}
+    next_worker_(0),
+    num_queued_(0),
+    num_idle_(0),
+    shutdown_(false),
+    poller_(new Poller()) {
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
 
-void ThreadPool::run(std::shared_ptr<Task> task) {
-  runInternal([this, task] () {
-    task->run();
-  });
+  if (num_threads == 0) {
+    num_threads = 1;
+  }
+
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(new Worker());
+  }
+
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(std::bind(&ThreadPool::runWorker, this, i));
+
+#if defined(__linux__)
+    /* thread names are limited to 15 characters */
+    auto thread_name = name_.substr(0, 10) + "-" + std::to_string(i);
+    pthread_setname_np(threads_.back().native_handle(), thread_name.c_str());
+#endif
+  }
 }
 
-void ThreadPool::runOnReadable(std::shared_ptr<Task> task, int fd) {
-  runInternal([this, task, fd] () {
-    fd_set op_read, op_write;
-    FD_ZERO(&op_read);
-    FD_ZERO(&op_write);
-    FD_SET(fd, &op_read);
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock_holder(idle_mutex_);
+    shutdown_ = true;
+  }
 
-    auto res = select(fd + 1, &op_read, &op_write, NULL, NULL);
+  idle_cv_.notify_all();
 
-    if (res == 0) {
-      RAISE(kIOError, "unexpected timeout while select()ing");
-    }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
 
-    if (res == -1) {
-      RAISE_ERRNO(kIOError, "select() failed");
-    }
+  /* the draining workers may still have called runAfter or runOn* */
+  poller_.reset(nullptr);
+}
 
-    task->run();
-  });
+size_t ThreadPool::numThreads() const {
+  return workers_.size();
 }
 
-void ThreadPool::runOnWritable(std::shared_ptr<Task> task, int fd) {
-  runInternal([task, fd] () {
-    fd_set op_read, op_write;
-    FD_ZERO(&op_read);
-    FD_ZERO(&op_write);
-    FD_SET(fd, &op_write);
+const std::string& ThreadPool::name() const {
+  return name_;
+}
 
-    auto res = select(fd + 1, &op_read, &op_write, NULL, NULL);
+void ThreadPool::setCPUAffinity(const std::vector<int>& cpus) {
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (auto cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
 
-    if (res == 0) {
-      RAISE(kIOError, "unexpected timeout while select()ing");
-    }
+  for (auto& thread : threads_) {
+    auto err = pthread_setaffinity_np(
+        thread.native_handle(),
+        sizeof(cpu_set),
+        &cpu_set);
 
-    if (res == -1) {
-      RAISE_ERRNO(kIOError, "select() failed");
+    if (err != 0) {
+      errno = err;
+      RAISE_ERRNO(kRuntimeError, "pthread_setaffinity_np() failed");
     }
+  }
+#endif
+}
 
-    task->run();
+ThreadPool::Stats ThreadPool::getStats() const {
+  Stats stats;
+  stats.name = name_;
+  stats.num_threads = workers_.size();
+  stats.queue_depth = num_queued_.load();
+  stats.num_tasks = num_tasks_.get();
+  stats.wait_micros = wait_micros_.snapshot();
+  return stats;
+}
+
+void ThreadPool::run(std::shared_ptr<Task> task) {
+  runInternal(task, PRIORITY_NORMAL);
+}
+
+void ThreadPool::run(std::shared_ptr<Task> task, kPriority priority) {
+  runInternal(task, priority);
+}
+
+void ThreadPool::runOnReadable(std::shared_ptr<Task> task, int fd) {
+  if (shutdown_.load()) {
+    return;
+  }
+
+  poller_->onReadable(fd, [this, task] () {
+    runInternal(task, PRIORITY_HIGH);
   });
 }
 
-void ThreadPool::runInternal(std::function<void()> fn) {
-  bool start_thread = true;
+void ThreadPool::runOnWritable(std::shared_ptr<Task> task, int fd) {
+  if (shutdown_.load()) {
+    return;
+  }
 
-  {
-    std::lock_guard<std::mutex> lock_holder(runq_mutex_);
-    runq_.push_back(fn);
+  poller_->onWritable(fd, [this, task] () {
+    runInternal(task, PRIORITY_HIGH);
+  });
+}
 
-    if (runq_.size() < free_threads_) {
-      start_thread = false;
-    }
+void ThreadPool::runAfter(
+    std::shared_ptr<Task> task,
+    uint64_t delay_micros,
+    kPriority priority) {
+  if (shutdown_.load()) {
+    return;
+  }
+
+  poller_->onTimeout(delay_micros, [this, task, priority] () {
+    runInternal(task, priority);
+  });
+}
+
+void ThreadPool::runInternal(std::shared_ptr<Task> task, kPriority priority) {
+  /* only the draining workers may add tasks after shutdown */
+  if (shutdown_.load() && current_pool != this) {
+    return;
   }
 
-  if (start_thread) {
-    startThread();
+  size_t index;
+  if (current_pool == this) {
+    index = current_worker;
+  } else {
+    index = next_worker_++ % workers_.size();
   }
 
-  wakeup_.notify_one();
+  {
+    auto& worker = workers_[index];
+    std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(worker->mutex);
+    worker->queues[priority].emplace_back(
+        QueuedTask { task, monotonicMicros() });
+  }
+
+  num_queued_++;
+
+  if (num_idle_.load() > 0) {
+    std::lock_guard<std::mutex> lock_holder(idle_mutex_);
+    idle_cv_.notify_one();
+  }
 }
 
-void ThreadPool::startThread() {
-  try {
-    std::thread thread([this] () {
-      for (;;) {
-        try {
-          std::function<void()> task;
+void ThreadPool::runWorker(size_t index) {
+  current_pool = this;
+  current_worker = index;
 
-          {
-            std::unique_lock<std::mutex> lk(runq_mutex_);
-            free_threads_++;
+  for (uint64_t n = 1; ; ++n) {
+    QueuedTask task;
 
-            while (runq_.size() == 0) {
-              wakeup_.wait(lk);
-            }
+    if (!popTask(index, n % kStarvationInterval == 0, &task)) {
+      std::unique_lock<std::mutex> lk(idle_mutex_);
+      num_idle_++;
 
-            assert(runq_.size() > 0);
-            task = runq_.front();
-            runq_.pop_front();
-            free_threads_--;
-          }
+      while (num_queued_.load() == 0 && !shutdown_) {
+        idle_cv_.wait(lk);
+      }
 
-          task();
-        } catch (const std::exception& e) {
-          this->error_handler_->onException(e);
-        }
+      num_idle_--;
+
+      if (shutdown_ && num_queued_.load() == 0) {
+        return;
       }
-    });
 
-    thread.detach();
-  } catch (const std::exception& e) {
-    this->error_handler_->onException(e);
+      continue;
+    }
+
+    /* the stats are striped by thread, so workers don't contend on them */
+    num_tasks_.incr();
+    wait_micros_.insert(monotonicMicros() - task.queued_at);
+
+    try {
+      task.task->run();
+    } catch (const std::exception& e) {
+      error_handler_->onException(e);
+    }
+  }
+}
+
+bool ThreadPool::popTask(
+    size_t index,
+    bool low_first,
+    QueuedTask* task) {
+  if (num_queued_.load() == 0) {
+    return false;
+  }
+
+  for (int i = 0; i < kNumPriorities; ++i) {
+    auto priority = low_first ? kNumPriorities - 1 - i : i;
+
+    if (popLocal(index, priority, task) || steal(index, priority, task)) {
+      num_queued_--;
+      return true;
+    }
   }
+
+  return false;
 }
 
+bool ThreadPool::popLocal(
+    size_t index,
+    int priority,
+    QueuedTask* task) {
+  auto& worker = workers_[index];
+  std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(worker->mutex);
+  auto& queue = worker->queues[priority];
+
+  if (queue.empty()) {
+    return false;
+  }
+
+  *task = std::move(queue.front());
+  queue.pop_front();
+  return true;
+}
+
+bool ThreadPool::steal(
+    size_t index,
+    int priority,
+    QueuedTask* task) {
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    auto& worker = workers_[(index + i) % workers_.size()];
+    std::lock_guard<fnord::stats::ProfiledMutex> lock_holder(worker->mutex);
+    auto& queue = worker->queues[priority];
+
+    if (!queue.empty()) {
+      *task = std::move(queue.back());
+      queue.pop_back();
+      return true;
+    }
+  }
+
+  return false;
+}
 
 }
 }
@@ -11,8 +11,17 @@
 #define _FNORDMETRIC_THREAD_THREADPOOL_H
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
-#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fnordmetric/stats/counter.h>
+#include <fnordmetric/stats/histogram.h>
+#include <fnordmetric/stats/profiledmutex.h>
+#include <fnordmetric/thread/poller.h>
 #include <fnordmetric/thread/task.h>
 #include <fnordmetric/thread/taskscheduler.h>
 #include <fnordmetric/util/exceptionhandler.h>
@@ -21,26 +30,112 @@ namespace fnord {
 namespace thread {
 
 /**
- * A threadpool is threadsafe
+ * A fixed size work-stealing thread pool.
+ *
+ * Every worker thread owns one run queue per priority. Tasks that are
+ * scheduled from a worker thread are pushed to that worker's own queue, all
+ * other tasks are distributed round-robin over the workers. A worker runs the
+ * tasks in its own queue in FIFO order and steals from the back of the other
+ * workers' queues before going to sleep, so workers only contend on a queue
+ * once they run out of work.
+ *
+ * Higher priorities are always preferred, except that every
+ * kStarvationInterval-th task is picked from the lowest non-empty priority so
+ * low priority tasks can't starve.
+ *
+ * runOnReadable, runOnWritable and runAfter don't block a worker thread: the
+ * pool's Poller waits for the fd or timer and then enqueues the task.
+ *
+ * Tasks must not block for a long time (or forever): with a fixed number of
+ * threads, a blocked task takes a worker away from everyone else.
+ *
+ * A pool has a name (its threads are named "<name>-<index>") and keeps
+ * statistics about its queue depth and how long tasks waited in the queue
+ * before they started running.
+ *
+ * A threadpool is threadsafe. The destructor waits for all queued tasks to
+ * finish, including the tasks they spawn with run. Once the destructor
+ * started, all other new tasks (from other threads, runOnReadable,
+ * runOnWritable and runAfter) are dropped.
  */
 class ThreadPool : public TaskScheduler {
 public:
+  static const size_t kStarvationInterval = 16;
+
+  struct Stats {
+    std::string name;
+    size_t num_threads;
+    size_t queue_depth;
+    uint64_t num_tasks;
+    fnord::stats::Histogram::Snapshot wait_micros;
+  };
+
+  /**
+   * @param num_threads the number of worker threads. Zero means one thread
+   *   per core
+   * @param name the name of the pool
+   */
   ThreadPool(
-      std::unique_ptr<fnord::util::ExceptionHandler> error_handler);
+      std::unique_ptr<fnord::util::ExceptionHandler> error_handler,
+      size_t num_threads = 0,
+      const std::string& name = "pool");
+
+  ~ThreadPool();
 
   void run(std::shared_ptr<Task> task) override;
+  void run(std::shared_ptr<Task> task, kPriority priority) override;
   void runOnReadable(std::shared_ptr<Task> task, int fd) override;
   void runOnWritable(std::shared_ptr<Task> task, int fd) override;
+  void runAfter(
+      std::shared_ptr<Task> task,
+      uint64_t delay_micros,
+      kPriority priority) override;
+
+  size_t numThreads() const;
+  const std::string& name() const;
+
+  /**
+   * Pin all worker threads to the provided set of CPUs. Only supported on
+   * Linux, a no-op elsewhere
+   */
+  void setCPUAffinity(const std::vector<int>& cpus);
+
+  /**
+   * Returns a snapshot of the pool's statistics
+   */
+  Stats getStats() const;
 
 protected:
-  void runInternal(std::function<void()> fn);
-  void startThread();
+  struct QueuedTask {
+    std::shared_ptr<Task> task;
+    uint64_t queued_at;
+  };
+
+  struct Worker {
+    Worker() : mutex("threadpool.runq") {}
+    fnord::stats::ProfiledMutex mutex;
+    std::deque<QueuedTask> queues[kNumPriorities];
+  };
+
+  void runInternal(std::shared_ptr<Task> task, kPriority priority);
+  void runWorker(size_t index);
+  bool popTask(size_t index, bool low_first, QueuedTask* task);
+  bool popLocal(size_t index, int priority, QueuedTask* task);
+  bool steal(size_t index, int priority, QueuedTask* task);
 
+  std::string name_;
   std::unique_ptr<fnord::util::ExceptionHandler> error_handler_;
-  std::mutex runq_mutex_;
-  std::list<std::function<void()>> runq_;
-  std::condition_variable wakeup_;
-  int free_threads_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> next_worker_;
+  std::atomic<size_t> num_queued_;
+  std::atomic<size_t> num_idle_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+  std::atomic<bool> shutdown_;
+  std::unique_ptr<Poller> poller_;
+  fnord::stats::Counter num_tasks_;
+  fnord::stats::Histogram wait_micros_;
 };
 
 }
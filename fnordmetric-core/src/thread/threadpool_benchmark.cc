@@ -0,0 +1,99 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <fnordmetric/thread/threadpool.h>
+#include <fnordmetric/util/benchmark.h>
+
+using fnord::thread::Task;
+using fnord::thread::ThreadPool;
+
+/**
+ * Scheduler microbenchmarks for the ThreadPool: the time from run() on an
+ * external thread until the task has executed on an idle pool (spawn), the
+ * time from run() on a busy worker until another worker has stolen and
+ * executed the task (steal) and the throughput with many external threads
+ * submitting empty tasks concurrently
+ */
+BENCHMARK_SUITE(ThreadPoolBenchmark);
+
+static const size_t kNumThreads = 4;
+static const int kNumProducers = 8;
+static const int kTasksPerProducer = 10000;
+
+/* the pool is never shut down, so it is intentionally leaked */
+static ThreadPool* pool;
+
+BENCHMARK_INITIALIZER(ThreadPoolBenchmark, StartPool, [] () {
+  pool = new ThreadPool(
+      std::unique_ptr<fnord::util::ExceptionHandler>(
+          new fnord::util::CatchAndAbortExceptionHandler("crashed")),
+      kNumThreads);
+});
+
+BENCHMARK_CASE(ThreadPoolBenchmark, SpawnLatency, 1, [] () {
+  std::atomic<bool> done(false);
+
+  pool->run(Task::create([&done] () {
+    done = true;
+  }));
+
+  while (!done.load()) {
+    std::this_thread::yield();
+  }
+});
+
+BENCHMARK_CASE(ThreadPoolBenchmark, StealLatency, 1, [] () {
+  std::atomic<bool> stolen(false);
+  std::atomic<bool> done(false);
+
+  /* the spawning worker stays busy until the task was stolen */
+  pool->run(Task::create([&stolen, &done] () {
+    pool->run(Task::create([&stolen] () {
+      stolen = true;
+    }));
+
+    while (!stolen.load()) {
+      std::this_thread::yield();
+    }
+
+    done = true;
+  }));
+
+  while (!done.load()) {
+    std::this_thread::yield();
+  }
+});
+
+BENCHMARK_CASE(
+    ThreadPoolBenchmark,
+    Throughput,
+    kNumProducers * kTasksPerProducer,
+    [] () {
+  std::atomic<int> num_done(0);
+  std::vector<std::thread> producers;
+
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers.emplace_back([&num_done] () {
+      for (int j = 0; j < kTasksPerProducer; ++j) {
+        pool->run(Task::create([&num_done] () { num_done++; }));
+      }
+    });
+  }
+
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  while (num_done.load() < kNumProducers * kTasksPerProducer) {
+    std::this_thread::yield();
+  }
+});
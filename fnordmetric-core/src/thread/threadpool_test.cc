@@ -0,0 +1,340 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <fnordmetric/thread/admissioncontroller.h>
+#include <fnordmetric/thread/mpscqueue.h>
+#include <fnordmetric/thread/threadpool.h>
+#include <fnordmetric/util/unittest.h>
+#include <fnordmetric/util/wallclock.h>
+
+using fnord::thread::AdmissionController;
+using fnord::thread::MPSCQueue;
+using fnord::thread::Task;
+using fnord::thread::TaskScheduler;
+using fnord::thread::ThreadPool;
+using fnord::util::WallClock;
+
+UNIT_TEST(ThreadPoolTest);
+
+static std::unique_ptr<fnord::util::ExceptionHandler> abortHandler() {
+  return std::unique_ptr<fnord::util::ExceptionHandler>(
+      new fnord::util::CatchAndAbortExceptionHandler("crashed"));
+}
+
+TEST_CASE(ThreadPoolTest, TestRunsAllTasks, [] () {
+  std::atomic<int> counter(0);
+
+  {
+    ThreadPool pool(abortHandler(), 4);
+    EXPECT_EQ(pool.numThreads(), 4);
+
+    for (int i = 0; i < 10000; ++i) {
+      pool.run(Task::create([&counter] () { counter++; }));
+    }
+  }
+
+  /* the destructor waits for all queued tasks */
+  EXPECT_EQ(counter.load(), 10000);
+});
+
+TEST_CASE(ThreadPoolTest, TestTasksSpawnedFromWorkers, [] () {
+  std::atomic<int> counter(0);
+
+  {
+    ThreadPool pool(abortHandler(), 4);
+    auto pool_ptr = &pool;
+
+    for (int i = 0; i < 100; ++i) {
+      pool.run(Task::create([pool_ptr, &counter] () {
+        for (int j = 0; j < 100; ++j) {
+          pool_ptr->run(Task::create([&counter] () { counter++; }));
+        }
+      }));
+    }
+  }
+
+  EXPECT_EQ(counter.load(), 10000);
+});
+
+TEST_CASE(ThreadPoolTest, TestPriorities, [] () {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool blocked = true;
+  std::string order;
+
+  ThreadPool pool(abortHandler(), 1);
+
+  /* block the only worker until all tasks are queued */
+  pool.run(Task::create([&] () {
+    std::unique_lock<std::mutex> lk(mutex);
+    while (blocked) {
+      cv.wait(lk);
+    }
+  }));
+
+  auto append = [&order] (char c) {
+    return Task::create([&order, c] () { order += c; });
+  };
+
+  pool.run(append('l'), TaskScheduler::PRIORITY_LOW);
+  pool.run(append('n'), TaskScheduler::PRIORITY_NORMAL);
+  pool.run(append('h'), TaskScheduler::PRIORITY_HIGH);
+  pool.run(append('H'), TaskScheduler::PRIORITY_HIGH);
+
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+    blocked = false;
+    cv.notify_all();
+  }
+
+  while (order.size() < 4) {
+    usleep(1000);
+  }
+
+  EXPECT_EQ(order, "hHnl");
+});
+
+TEST_CASE(ThreadPoolTest, TestLowPriorityDoesNotStarve, [] () {
+  std::atomic<bool> low_ran(false);
+  std::atomic<int> high_ran(0);
+
+  ThreadPool pool(abortHandler(), 1);
+  auto pool_ptr = &pool;
+
+  /* a high priority task that keeps rescheduling itself */
+  std::function<void()> high;
+  high = [&] () {
+    if (++high_ran < 1000 && !low_ran) {
+      pool_ptr->run(Task::create(high), TaskScheduler::PRIORITY_HIGH);
+    }
+  };
+
+  pool.run(Task::create(high), TaskScheduler::PRIORITY_HIGH);
+  pool.run(
+      Task::create([&low_ran] () { low_ran = true; }),
+      TaskScheduler::PRIORITY_LOW);
+
+  while (!low_ran && high_ran < 1000) {
+    usleep(1000);
+  }
+
+  EXPECT(low_ran.load());
+  EXPECT(high_ran.load() < 1000);
+});
+
+TEST_CASE(ThreadPoolTest, TestRunOnReadable, [] () {
+  int fds[2];
+  EXPECT(pipe(fds) == 0);
+
+  std::atomic<bool> ran(false);
+  ThreadPool pool(abortHandler(), 1);
+
+  pool.runOnReadable(
+      Task::create([&ran, fds] () {
+        char byte;
+        EXPECT(read(fds[0], &byte, 1) == 1);
+        ran = true;
+      }),
+      fds[0]);
+
+  /* the worker isn't blocked while the poller waits for the fd */
+  std::atomic<bool> other_ran(false);
+  pool.run(Task::create([&other_ran] () { other_ran = true; }));
+  while (!other_ran) {
+    usleep(1000);
+  }
+
+  EXPECT(ran.load() == false);
+  EXPECT(write(fds[1], "x", 1) == 1);
+
+  while (!ran) {
+    usleep(1000);
+  }
+
+  close(fds[0]);
+  close(fds[1]);
+});
+
+TEST_CASE(ThreadPoolTest, TestRunAfter, [] () {
+  std::atomic<uint64_t> ran_at(0);
+  ThreadPool pool(abortHandler(), 1);
+
+  auto scheduled_at = WallClock::unixMicros();
+  pool.runAfter(
+      Task::create([&ran_at] () { ran_at = WallClock::unixMicros(); }),
+      50000,
+      TaskScheduler::PRIORITY_LOW);
+
+  while (ran_at.load() == 0) {
+    usleep(1000);
+  }
+
+  EXPECT(ran_at.load() - scheduled_at >= 50000);
+});
+
+TEST_CASE(ThreadPoolTest, TestShutdownDropsRescheduledTasks, [] () {
+  std::atomic<bool> running(false);
+  std::atomic<int> num_runs(0);
+  std::shared_ptr<Task> task;
+
+  {
+    ThreadPool pool(abortHandler(), 1);
+    auto pool_ptr = &pool;
+
+    /* reschedules itself like the compaction task */
+    task = Task::create([pool_ptr, &task, &running, &num_runs] () {
+      running = true;
+      usleep(20000);
+      num_runs++;
+      pool_ptr->runAfter(task, 1000, TaskScheduler::PRIORITY_NORMAL);
+    });
+
+    pool.run(task);
+    while (!running.load()) {
+      usleep(1000);
+    }
+  }
+
+  EXPECT(num_runs.load() >= 1);
+});
+
+TEST_CASE(ThreadPoolTest, TestStats, [] () {
+  std::atomic<int> counter(0);
+  ThreadPool pool(abortHandler(), 2, "test");
+
+  for (int i = 0; i < 100; ++i) {
+    pool.run(Task::create([&counter] () { counter++; }));
+  }
+
+  while (counter.load() < 100) {
+    usleep(1000);
+  }
+
+  auto stats = pool.getStats();
+  EXPECT_EQ(stats.name, "test");
+  EXPECT_EQ(stats.num_threads, 2);
+  EXPECT_EQ(stats.queue_depth, 0);
+  EXPECT_EQ(stats.num_tasks, 100);
+  EXPECT_EQ(stats.wait_micros.count, 100);
+});
+
+TEST_CASE(ThreadPoolTest, TestAdmissionController, [] () {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool blocked = true;
+  std::atomic<int> num_done(0);
+
+  ThreadPool pool(abortHandler(), 4);
+  AdmissionController admission(2, 1);
+
+  auto task = [&] () {
+    std::unique_lock<std::mutex> lk(mutex);
+    while (blocked) {
+      cv.wait(lk);
+    }
+
+    num_done++;
+  };
+
+  EXPECT(admission.run(&pool, task));
+  EXPECT(admission.run(&pool, task));
+  EXPECT_EQ(admission.numRunning(), 2);
+
+  /* the third task is queued, the fourth one is rejected */
+  EXPECT(admission.run(&pool, task));
+  EXPECT_EQ(admission.numQueued(), 1);
+  EXPECT(!admission.run(&pool, task));
+  EXPECT_EQ(admission.numRejected(), 1);
+
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+    blocked = false;
+    cv.notify_all();
+  }
+
+  while (num_done.load() < 3) {
+    usleep(1000);
+  }
+
+  while (admission.numRunning() > 0) {
+    usleep(1000);
+  }
+
+  EXPECT_EQ(admission.numQueued(), 0);
+});
+
+TEST_CASE(ThreadPoolTest, TestMPSCQueueIsBounded, [] () {
+  MPSCQueue<int> queue(5);
+  EXPECT_EQ(queue.capacity(), 8);
+  EXPECT(queue.empty());
+
+  for (int i = 0; i < 8; ++i) {
+    EXPECT(queue.tryPush(std::move(i)));
+  }
+
+  int value = 42;
+  EXPECT(queue.full());
+  EXPECT(!queue.tryPush(std::move(value)));
+  EXPECT_EQ(queue.size(), 8);
+
+  for (int i = 0; i < 8; ++i) {
+    EXPECT(queue.tryPop(&value));
+    EXPECT_EQ(value, i);
+  }
+
+  EXPECT(!queue.tryPop(&value));
+  EXPECT(queue.empty());
+  EXPECT(queue.tryPush(std::move(value)));
+});
+
+TEST_CASE(ThreadPoolTest, TestMPSCQueueConcurrentProducers, [] () {
+  static const int kNumProducers = 4;
+  static const int kNumValues = 100000;
+  MPSCQueue<std::unique_ptr<int>> queue(64);
+  std::vector<std::thread> producers;
+
+  for (int p = 0; p < kNumProducers; ++p) {
+    producers.emplace_back([&queue, p] () {
+      for (int i = 0; i < kNumValues; ++i) {
+        std::unique_ptr<int> value(new int(p * kNumValues + i));
+        while (!queue.tryPush(std::move(value))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  /* values of every producer must arrive in order */
+  std::vector<int> last(kNumProducers, -1);
+  std::unique_ptr<int> value;
+  for (int n = 0; n < kNumProducers * kNumValues; ) {
+    if (!queue.tryPop(&value)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    auto producer = *value / kNumValues;
+    EXPECT(*value % kNumValues == last[producer] + 1);
+    last[producer] = *value % kNumValues;
+    ++n;
+  }
+
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  EXPECT(queue.empty());
+});
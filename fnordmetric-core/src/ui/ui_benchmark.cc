@@ -0,0 +1,84 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <fnordmetric/ui/axisdefinition.h>
+#include <fnordmetric/ui/barchart.h>
+#include <fnordmetric/ui/canvas.h>
+#include <fnordmetric/ui/continuousdomain.h>
+#include <fnordmetric/ui/domain.h>
+#include <fnordmetric/ui/linechart.h>
+#include <fnordmetric/ui/series.h>
+#include <fnordmetric/ui/svgtarget.h>
+#include <fnordmetric/util/outputstream.h>
+#include <fnordmetric/util/benchmark.h>
+
+using namespace fnordmetric;
+using namespace fnordmetric::ui;
+
+/**
+ * SVG rendering of a line chart with 4 series of 1000 points each (about one
+ * day of minutely samples) and a bar chart with 100 bars
+ */
+BENCHMARK_SUITE(UIBenchmark);
+
+static const int kNumSeries = 4;
+static const int kNumPoints = 1000;
+static const int kNumBars = 100;
+
+static ContinuousDomain<double> x_domain(0, kNumPoints, false);
+static ContinuousDomain<double> y_domain(0, 100, false);
+static Canvas line_canvas;
+static Canvas bar_canvas;
+
+BENCHMARK_INITIALIZER(UIBenchmark, BuildCharts, [] () {
+  auto line_chart = line_canvas.addChart<LineChart2D<double, double>>(
+      &x_domain, &y_domain);
+
+  for (int s = 0; s < kNumSeries; ++s) {
+    auto series = new Series2D<double, double>("series" + std::to_string(s));
+    for (int i = 0; i < kNumPoints; ++i) {
+      series->addDatum(i, 50 + 40 * sin(i / 50.0 + s));
+    }
+
+    line_chart->addSeries(series);
+  }
+
+  line_chart->addAxis(AxisDefinition::BOTTOM);
+  line_chart->addAxis(AxisDefinition::LEFT);
+
+  auto bar_chart = bar_canvas.addChart<BarChart2D<std::string, double>>(
+      BarChart::O_VERTICAL);
+
+  auto series = new Series2D<std::string, double>("bars");
+  for (int i = 0; i < kNumBars; ++i) {
+    series->addDatum("bar" + std::to_string(i), (i * 37) % 100);
+  }
+
+  bar_chart->addSeries(series);
+  bar_chart->addAxis(AxisDefinition::BOTTOM);
+  bar_chart->addAxis(AxisDefinition::LEFT);
+});
+
+static void renderSVG(const Canvas& canvas) {
+  std::string svg;
+  auto output = util::StringOutputStream::fromString(&svg);
+  SVGTarget target(output.get());
+  canvas.render(&target);
+}
+
+BENCHMARK_CASE(UIBenchmark, RenderLineChartSVG, 1, [] () {
+  renderSVG(line_canvas);
+});
+
+BENCHMARK_CASE(UIBenchmark, RenderBarChartSVG, 1, [] () {
+  renderSVG(bar_canvas);
+});
@@ -0,0 +1,255 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <fnordmetric/cli/flagparser.h>
+#include <fnordmetric/util/benchmark.h>
+#include <fnordmetric/util/jsonoutputstream.h>
+#include <fnordmetric/util/outputstream.h>
+#include <fnordmetric/util/runtimeexception.h>
+
+namespace fnordmetric {
+namespace util {
+
+/* the flag parser identifies flags by the address of their name */
+static const char kWarmupFlag[] = "warmup";
+static const char kIterationsFlag[] = "iterations";
+static const char kFilterFlag[] = "filter";
+static const char kJSONFlag[] = "json";
+
+static uint64_t monotonicNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Benchmark::Result Benchmark::runCase(
+    const BenchmarkCase* benchmark_case,
+    uint64_t warmup_iterations,
+    uint64_t iterations) {
+  for (uint64_t i = 0; i < warmup_iterations; ++i) {
+    benchmark_case->lambda_();
+  }
+
+  std::vector<double> samples;
+  samples.reserve(iterations);
+  uint64_t total_nanos = 0;
+
+  for (uint64_t i = 0; i < iterations; ++i) {
+    auto begin = monotonicNanos();
+    benchmark_case->lambda_();
+    auto nanos = monotonicNanos() - begin;
+
+    total_nanos += nanos;
+    samples.emplace_back(
+        (double) nanos / benchmark_case->ops_per_iteration_);
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  /* nearest rank percentile */
+  auto percentile = [&samples] (double p) -> double {
+    auto rank = static_cast<size_t>(p / 100.0 * samples.size() + 0.5);
+    return samples[rank == 0 ? 0 : std::min(rank, samples.size()) - 1];
+  };
+
+  Result result;
+  result.name = benchmark_case->name_;
+  result.iterations = iterations;
+  result.ops_per_iteration = benchmark_case->ops_per_iteration_;
+  result.ops_per_second =
+      (double) (iterations * benchmark_case->ops_per_iteration_) /
+      ((double) total_nanos / 1000000000.0);
+  result.min_nanos = samples.front();
+  result.mean_nanos =
+      (double) total_nanos / (iterations * benchmark_case->ops_per_iteration_);
+  result.p50_nanos = percentile(50);
+  result.p90_nanos = percentile(90);
+  result.p99_nanos = percentile(99);
+  result.max_nanos = samples.back();
+  return result;
+}
+
+static void writeJSON(
+    const char* suite_name,
+    const std::vector<Benchmark::Result>& results,
+    std::shared_ptr<OutputStream> output) {
+  JSONOutputStream json(output);
+
+  json.beginObject();
+  json.addObjectEntry("suite");
+  json.addString(suite_name);
+  json.addComma();
+  json.addObjectEntry("results");
+  json.beginArray();
+
+  for (int i = 0; i < results.size(); ++i) {
+    const auto& result = results[i];
+
+    if (i > 0) { json.addComma(); }
+    json.beginObject();
+    json.addObjectEntry("name");
+    json.addString(result.name);
+    json.addComma();
+    json.addObjectEntry("iterations");
+    json.addLiteral<uint64_t>(result.iterations);
+    json.addComma();
+    json.addObjectEntry("ops_per_iteration");
+    json.addLiteral<uint64_t>(result.ops_per_iteration);
+    json.addComma();
+    json.addObjectEntry("ops_per_second");
+    json.addFloat(result.ops_per_second);
+    json.addComma();
+    json.addObjectEntry("ns_per_op");
+    json.beginObject();
+    json.addObjectEntry("min");
+    json.addFloat(result.min_nanos);
+    json.addComma();
+    json.addObjectEntry("mean");
+    json.addFloat(result.mean_nanos);
+    json.addComma();
+    json.addObjectEntry("p50");
+    json.addFloat(result.p50_nanos);
+    json.addComma();
+    json.addObjectEntry("p90");
+    json.addFloat(result.p90_nanos);
+    json.addComma();
+    json.addObjectEntry("p99");
+    json.addFloat(result.p99_nanos);
+    json.addComma();
+    json.addObjectEntry("max");
+    json.addFloat(result.max_nanos);
+    json.endObject();
+    json.endObject();
+  }
+
+  json.endArray();
+  json.endObject();
+  output->write("\n");
+}
+
+int Benchmark::run(int argc, const char** argv) {
+  cli::FlagParser flags;
+
+  flags.defineFlag(
+      kWarmupFlag,
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "10",
+      "Number of unmeasured iterations per case",
+      "<num>");
+
+  flags.defineFlag(
+      kIterationsFlag,
+      cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "100",
+      "Number of measured iterations per case",
+      "<num>");
+
+  flags.defineFlag(
+      kFilterFlag,
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "Only run cases whose name contains this string",
+      "<string>");
+
+  flags.defineFlag(
+      kJSONFlag,
+      cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "Also write the results as JSON to this file ('-' for stdout)",
+      "<file>");
+
+  try {
+    flags.parseArgv(argc, argv);
+  } catch (RuntimeException e) {
+    e.debugPrint();
+    auto err_stream = OutputStream::getStderr();
+    err_stream->printf("\nusage: %s [options]\n\noptions:\n", argv[0]);
+    flags.printUsage(err_stream.get());
+    return 1;
+  }
+
+  auto warmup = flags.getInt(kWarmupFlag);
+  auto iterations = flags.getInt(kIterationsFlag);
+  if (iterations < 1) {
+    iterations = 1;
+  }
+
+  std::string filter;
+  if (flags.isSet(kFilterFlag)) {
+    filter = flags.getString(kFilterFlag);
+  }
+
+  try {
+    for (auto initializer : initializers_) {
+      initializer->lambda_();
+    }
+  } catch (RuntimeException e) {
+    fprintf(stderr, "%s: initializer failed\n", name_);
+    e.debugPrint();
+    return 1;
+  }
+
+  fprintf(stderr, "%s\n", name_);
+
+  std::vector<Result> results;
+  for (auto benchmark_case : cases_) {
+    if (strstr(benchmark_case->name_, filter.c_str()) == nullptr) {
+      continue;
+    }
+
+    fprintf(stderr, "    %-40s", benchmark_case->name_);
+    fflush(stderr);
+
+    try {
+      results.emplace_back(runCase(benchmark_case, warmup, iterations));
+    } catch (RuntimeException e) {
+      fprintf(stderr, " \033[1;31m[FAIL]\e[0m\n");
+      e.debugPrint();
+      return 1;
+    }
+
+    const auto& result = results.back();
+    fprintf(
+        stderr,
+        "%12.0f ops/s   p50: %10.1fns   p90: %10.1fns   p99: %10.1fns\n",
+        result.ops_per_second,
+        result.p50_nanos,
+        result.p90_nanos,
+        result.p99_nanos);
+  }
+
+  if (flags.isSet(kJSONFlag)) {
+    auto json_file = flags.getString(kJSONFlag);
+    std::shared_ptr<OutputStream> output;
+
+    if (json_file == "-") {
+      output = OutputStream::getStdout();
+    } else {
+      output = FileOutputStream::openFile(json_file);
+    }
+
+    writeJSON(name_, results, output);
+  }
+
+  return 0;
+}
+
+}
+}
@@ -0,0 +1,125 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_UTIL_BENCHMARK_H
+#define _FNORDMETRIC_UTIL_BENCHMARK_H
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define BENCHMARK_SUITE(S) \
+    static fnordmetric::util::Benchmark S(#S); \
+    int main(int argc, const char** argv) { \
+      auto& s = S; \
+      return s.run(argc, argv); \
+    }
+
+/* the lambda is variadic since its body may contain unparenthesized commas */
+#define BENCHMARK_CASE(S, N, O, ...) \
+    static fnordmetric::util::Benchmark::BenchmarkCase \
+        __##S##__case__##N(&S, #N, (O), (__VA_ARGS__));
+
+#define BENCHMARK_INITIALIZER(S, N, ...) \
+    static fnordmetric::util::Benchmark::BenchmarkInitializer \
+        __##S##__case__##N(&S, (__VA_ARGS__));
+
+namespace fnordmetric {
+namespace util {
+
+/**
+ * A minimal microbenchmark harness, the benchmark counterpart of UnitTest.
+ *
+ * Every case is a function that performs a fixed number of operations
+ * (ops_per_iteration). The harness calls it --warmup times without measuring,
+ * then --iterations times while timing each call, and reports the throughput
+ * and the min/mean/p50/p90/p99/max time per operation. Initializers run once
+ * before the first case and should generate all fixture data, so that the
+ * benchmarks don't depend on external files or services.
+ *
+ * With --json <file> (or --json - for stdout) the results are also written
+ * as JSON so that runs can be compared against an earlier baseline.
+ *
+ *   $ benchmark-statsd --iterations 200 --filter Parse --json out.json
+ */
+class Benchmark {
+public:
+
+  class BenchmarkCase {
+  public:
+    BenchmarkCase(
+        Benchmark* benchmark,
+        const char* name,
+        uint64_t ops_per_iteration,
+        std::function<void ()> lambda) :
+        name_(name),
+        ops_per_iteration_(ops_per_iteration),
+        lambda_(lambda) {
+      benchmark->addBenchmarkCase(this);
+    }
+
+    const char* name_;
+    uint64_t ops_per_iteration_;
+    std::function<void ()> lambda_;
+  };
+
+  class BenchmarkInitializer {
+  public:
+    BenchmarkInitializer(
+        Benchmark* benchmark,
+        std::function<void ()> lambda) :
+        lambda_(lambda) {
+      benchmark->addInitializer(this);
+    }
+
+    std::function<void ()> lambda_;
+  };
+
+  struct Result {
+    std::string name;
+    uint64_t iterations;
+    uint64_t ops_per_iteration;
+    double ops_per_second;
+    double min_nanos;
+    double mean_nanos;
+    double p50_nanos;
+    double p90_nanos;
+    double p99_nanos;
+    double max_nanos;
+  };
+
+  Benchmark(const char* name) : name_(name) {}
+
+  void addBenchmarkCase(const BenchmarkCase* benchmark_case) {
+    cases_.push_back(benchmark_case);
+  }
+
+  void addInitializer(const BenchmarkInitializer* init) {
+    initializers_.push_back(init);
+  }
+
+  int run(int argc, const char** argv);
+
+  /**
+   * Run a single case and return its statistics (times are per operation)
+   */
+  static Result runCase(
+      const BenchmarkCase* benchmark_case,
+      uint64_t warmup_iterations,
+      uint64_t iterations);
+
+protected:
+  const char* name_;
+  std::vector<const BenchmarkCase*> cases_;
+  std::vector<const BenchmarkInitializer*> initializers_;
+};
+
+}
+}
+#endif
@@ -0,0 +1,85 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <fnordmetric/util/fnv.h>
+#include <fnordmetric/util/hyperloglog.h>
+
+namespace fnord {
+namespace util {
+
+void HyperLogLog::insert(uint64_t hash) {
+  auto index = hash >> (64 - kPrecision);
+  auto rest = (hash << kPrecision) | (1llu << (kPrecision - 1));
+
+  /* rank = position of the first set bit in the remaining bits */
+  uint8_t rank = 1;
+  while ((rest & (1llu << 63)) == 0) {
+    rest <<= 1;
+    rank++;
+  }
+
+  if (rank > registers_[index]) {
+    registers_[index] = rank;
+  }
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+  for (size_t i = 0; i < kNumRegisters; ++i) {
+    if (other.registers_[i] > registers_[i]) {
+      registers_[i] = other.registers_[i];
+    }
+  }
+}
+
+uint64_t HyperLogLog::estimate() const {
+  double m = kNumRegisters;
+  double alpha = 0.7213 / (1.0 + 1.079 / m);
+  double sum = 0;
+  size_t num_zero_registers = 0;
+
+  for (size_t i = 0; i < kNumRegisters; ++i) {
+    sum += ldexp(1.0, -registers_[i]);
+
+    if (registers_[i] == 0) {
+      num_zero_registers++;
+    }
+  }
+
+  double estimate = alpha * m * m / sum;
+
+  /* use linear counting for small cardinalities */
+  if (estimate <= 2.5 * m && num_zero_registers > 0) {
+    estimate = m * log(m / num_zero_registers);
+  }
+
+  return static_cast<uint64_t>(estimate + 0.5);
+}
+
+uint64_t HyperLogLog::hash(const void* data, size_t size) {
+  FNV<uint64_t> fnv;
+  auto h = fnv.hash(data, size);
+
+  /* FNV1a doesn't spread short keys into the high bits, so finalize the hash
+     with the MurmurHash3 fmix64 step */
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdllu;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53llu;
+  h ^= h >> 33;
+
+  return h;
+}
+
+uint64_t HyperLogLog::hash(const std::string& data) {
+  return hash(data.data(), data.size());
+}
+
+}
+}
@@ -0,0 +1,62 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_UTIL_HYPERLOGLOG_H
+#define _FNORDMETRIC_UTIL_HYPERLOGLOG_H
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+
+namespace fnord {
+namespace util {
+
+/**
+ * A HyperLogLog sketch that estimates the number of distinct values in a set
+ *   see http://algo.inria.fr/flajolet/Publications/FlFuGaMe07.pdf
+ *
+ * The sketch has a fixed size and a zero-filled HyperLogLog is a valid empty
+ * sketch, so it can be stored in preallocated memory (e.g. an aggregate
+ * function scratchpad). Two sketches can be merged losslessly. The standard
+ * error of the estimate is 1.04 / sqrt(kNumRegisters), i.e. about 1.6%.
+ */
+class HyperLogLog {
+public:
+  static const int kPrecision = 12;
+  static const size_t kNumRegisters = 1 << kPrecision;
+
+  /**
+   * Add a value to the set. The hash must be a well distributed 64 bit hash
+   * of the value (see HyperLogLog::hash)
+   */
+  void insert(uint64_t hash);
+
+  /**
+   * Merge another sketch into this one. The result is the same as if all
+   * values of the other sketch had been inserted into this one
+   */
+  void merge(const HyperLogLog& other);
+
+  /**
+   * Returns the estimated number of distinct values in the set
+   */
+  uint64_t estimate() const;
+
+  /**
+   * Returns a 64 bit hash of the data that is suitable for HyperLogLog::insert
+   */
+  static uint64_t hash(const void* data, size_t size);
+  static uint64_t hash(const std::string& data);
+
+protected:
+  uint8_t registers_[kNumRegisters];
+};
+
+}
+}
+#endif
@@ -0,0 +1,88 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fnordmetric/util/hyperloglog.h>
+#include <fnordmetric/util/unittest.h>
+
+using fnord::util::HyperLogLog;
+
+UNIT_TEST(HyperLogLogTest);
+
+static HyperLogLog* newHyperLogLog() {
+  auto hll = (HyperLogLog*) malloc(sizeof(HyperLogLog));
+  memset(hll, 0, sizeof(HyperLogLog));
+  return hll;
+}
+
+static void expectWithinError(uint64_t estimate, uint64_t exact, double error) {
+  EXPECT(fabs((double) estimate - exact) <= exact * error);
+}
+
+TEST_CASE(HyperLogLogTest, TestEmpty, [] () {
+  auto hll = newHyperLogLog();
+  EXPECT_EQ(hll->estimate(), 0);
+  free(hll);
+});
+
+TEST_CASE(HyperLogLogTest, TestEstimate, [] () {
+  auto hll = newHyperLogLog();
+
+  for (int n = 1; n <= 200000; ++n) {
+    auto key = std::to_string(n);
+
+    /* insert every value twice */
+    hll->insert(HyperLogLog::hash(key));
+    hll->insert(HyperLogLog::hash(key));
+
+    switch (n) {
+      case 10:
+      case 100:
+      case 1000:
+      case 10000:
+      case 100000:
+      case 200000:
+        expectWithinError(hll->estimate(), n, 0.05);
+        break;
+    }
+  }
+
+  free(hll);
+});
+
+TEST_CASE(HyperLogLogTest, TestMerge, [] () {
+  auto a = newHyperLogLog();
+  auto b = newHyperLogLog();
+  auto c = newHyperLogLog();
+
+  for (int n = 0; n < 60000; ++n) {
+    auto hash = HyperLogLog::hash(std::to_string(n));
+
+    /* a and b overlap by 20000 values */
+    if (n < 40000) {
+      a->insert(hash);
+    }
+
+    if (n >= 20000) {
+      b->insert(hash);
+    }
+
+    c->insert(hash);
+  }
+
+  a->merge(*b);
+  EXPECT_EQ(a->estimate(), c->estimate());
+  expectWithinError(a->estimate(), 60000, 0.05);
+
+  free(a);
+  free(b);
+  free(c);
+});
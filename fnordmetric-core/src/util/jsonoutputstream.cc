@@ -42,6 +42,19 @@ void JSONOutputStream::addString(const std::string& string) {
   output_->write("\"");
 }
 
+void JSONOutputStream::addFloat(double value) {
+  /* json has no representation for nan or infinity */
+  if (value != value || value - value != 0) {
+    output_->write("null");
+  } else {
+    output_->printf("%g", value);
+  }
+}
+
+void JSONOutputStream::addBool(bool value) {
+  output_->write(value ? "true" : "false");
+}
+
 void JSONOutputStream::beginArray() {
   output_->printf("[");
 }
@@ -28,6 +28,7 @@ public:
   void addComma();
   void addString(const std::string& string);
   void addFloat(double value);
+  void addBool(bool value);
 
   template <typename T>
   void addLiteral(T integer) {
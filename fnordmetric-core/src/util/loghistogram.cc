@@ -0,0 +1,157 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include <fnordmetric/util/loghistogram.h>
+
+namespace fnord {
+namespace util {
+
+void LogHistogram::insert(double value) {
+  if (std::isnan(value)) {
+    return;
+  }
+
+  if (count_ == 0 || value < min_) {
+    min_ = value;
+  }
+
+  if (count_ == 0 || value > max_) {
+    max_ = value;
+  }
+
+  count_++;
+
+  auto index = bucketIndex(fabs(value));
+  if (index < 0) {
+    zero_count_++;
+  } else if (value > 0) {
+    positive_[index]++;
+  } else {
+    negative_[index]++;
+  }
+}
+
+void LogHistogram::merge(const LogHistogram& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+
+  if (count_ == 0 || other.min_ < min_) {
+    min_ = other.min_;
+  }
+
+  if (count_ == 0 || other.max_ > max_) {
+    max_ = other.max_;
+  }
+
+  count_ += other.count_;
+  zero_count_ += other.zero_count_;
+
+  for (int i = 0; i < kNumBuckets; ++i) {
+    positive_[i] += other.positive_[i];
+    negative_[i] += other.negative_[i];
+  }
+}
+
+double LogHistogram::percentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  if (percentile <= 0) {
+    return min_;
+  }
+
+  if (percentile >= 100) {
+    return max_;
+  }
+
+  uint64_t rank = ceil(percentile / 100.0 * count_);
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  auto value = valueAtRank(rank);
+
+  if (value < min_) {
+    return min_;
+  }
+
+  if (value > max_) {
+    return max_;
+  }
+
+  return value;
+}
+
+double LogHistogram::valueAtRank(uint64_t rank) const {
+  uint64_t n = 0;
+
+  /* walk the buckets in ascending value order */
+  for (int i = kNumBuckets - 1; i >= 0; --i) {
+    n += negative_[i];
+    if (n >= rank) {
+      return -bucketValue(i);
+    }
+  }
+
+  n += zero_count_;
+  if (n >= rank) {
+    return 0;
+  }
+
+  for (int i = 0; i < kNumBuckets; ++i) {
+    n += positive_[i];
+    if (n >= rank) {
+      return bucketValue(i);
+    }
+  }
+
+  return max_;
+}
+
+uint64_t LogHistogram::count() const {
+  return count_;
+}
+
+double LogHistogram::min() const {
+  return min_;
+}
+
+double LogHistogram::max() const {
+  return max_;
+}
+
+int LogHistogram::bucketIndex(double magnitude) {
+  int exponent;
+  auto mantissa = frexp(magnitude, &exponent); // magnitude = m * 2^e, m>=0.5
+
+  if (magnitude == 0 || exponent <= kMinExponent) {
+    return -1;
+  }
+
+  if (exponent > kMaxExponent) {
+    return kNumBuckets - 1;
+  }
+
+  int sub_bucket = (mantissa - 0.5) * 2 * kSubBuckets;
+  return (exponent - kMinExponent - 1) * kSubBuckets + sub_bucket;
+}
+
+double LogHistogram::bucketValue(int index) {
+  auto exponent = index / kSubBuckets + kMinExponent + 1;
+  auto sub_bucket = index % kSubBuckets;
+
+  /* return the center of the bucket */
+  return ldexp(0.5 + (sub_bucket + 0.5) / (2 * kSubBuckets), exponent);
+}
+
+}
+}
@@ -0,0 +1,71 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FNORDMETRIC_UTIL_LOGHISTOGRAM_H
+#define _FNORDMETRIC_UTIL_LOGHISTOGRAM_H
+#include <stdlib.h>
+#include <stdint.h>
+
+namespace fnord {
+namespace util {
+
+/**
+ * A histogram with logarithmically sized buckets (similar to a HDR histogram)
+ * that answers percentile queries with a bounded relative error.
+ *
+ * Each power of two between 2^kMinExponent and 2^kMaxExponent is split into
+ * kSubBuckets linear buckets, so a value is approximated within 1/2 *
+ * 1/kSubBuckets (~1.6%) of its magnitude. Smaller magnitudes are counted as
+ * zero, larger ones are counted in the last bucket. The exact minimum and
+ * maximum values are tracked separately.
+ *
+ * The histogram has a fixed size and a zero-filled LogHistogram is a valid
+ * empty histogram, so it can be stored in preallocated memory (e.g. an
+ * aggregate function scratchpad). Two histograms can be merged losslessly.
+ */
+class LogHistogram {
+public:
+  static const int kSubBucketBits = 5;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kMinExponent = -16;
+  static const int kMaxExponent = 32;
+  static const int kNumBuckets =
+      (kMaxExponent - kMinExponent) * kSubBuckets;
+
+  void insert(double value);
+  void merge(const LogHistogram& other);
+
+  /**
+   * Returns the (approximated) value at the provided percentile using the
+   * nearest rank method. The percentile must be between 0 and 100. Returns
+   * 0 if the histogram is empty.
+   */
+  double percentile(double percentile) const;
+
+  uint64_t count() const;
+  double min() const;
+  double max() const;
+
+protected:
+
+  double valueAtRank(uint64_t rank) const;
+  static int bucketIndex(double magnitude);
+  static double bucketValue(int index);
+
+  uint64_t count_;
+  uint64_t zero_count_;
+  double min_;
+  double max_;
+  uint32_t positive_[kNumBuckets];
+  uint32_t negative_[kNumBuckets];
+};
+
+}
+}
+#endif
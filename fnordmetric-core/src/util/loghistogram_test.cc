@@ -0,0 +1,120 @@
+/**
+ * This file is part of the "FnordMetric" project
+ *   Copyright (c) 2014 Paul Asmuth, Google Inc.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <fnordmetric/util/loghistogram.h>
+#include <fnordmetric/util/unittest.h>
+
+using fnord::util::LogHistogram;
+
+UNIT_TEST(LogHistogramTest);
+
+static const double kPercentiles[] = { 1, 10, 25, 50, 75, 90, 95, 99, 99.9 };
+
+static LogHistogram* newLogHistogram() {
+  auto hist = (LogHistogram*) malloc(sizeof(LogHistogram));
+  memset(hist, 0, sizeof(LogHistogram));
+  return hist;
+}
+
+/**
+ * nearest rank percentile of a sorted list of values
+ */
+static double exactPercentile(const std::vector<double>& values, double p) {
+  size_t rank = ceil(p / 100.0 * values.size());
+  return values[rank < 1 ? 0 : rank - 1];
+}
+
+static void expectWithinError(double approx, double exact) {
+  EXPECT(fabs(approx - exact) <= fabs(exact) / LogHistogram::kSubBuckets);
+}
+
+TEST_CASE(LogHistogramTest, TestEmpty, [] () {
+  auto hist = newLogHistogram();
+  EXPECT_EQ(hist->count(), 0);
+  EXPECT_EQ(hist->percentile(50), 0);
+  free(hist);
+});
+
+TEST_CASE(LogHistogramTest, TestPercentiles, [] () {
+  auto hist = newLogHistogram();
+  std::vector<double> values;
+
+  /* a long tailed latency-like distribution */
+  srand(42);
+  for (int i = 0; i < 100000; ++i) {
+    double value = 0.5 + (rand() % 1000) / 10.0;
+    if (i % 100 == 0) {
+      value *= 50;
+    }
+
+    values.emplace_back(value);
+    hist->insert(value);
+  }
+
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(hist->count(), values.size());
+  EXPECT_EQ(hist->percentile(0), values.front());
+  EXPECT_EQ(hist->percentile(100), values.back());
+
+  for (auto p : kPercentiles) {
+    expectWithinError(hist->percentile(p), exactPercentile(values, p));
+  }
+
+  free(hist);
+});
+
+TEST_CASE(LogHistogramTest, TestNegativeAndZeroValues, [] () {
+  auto hist = newLogHistogram();
+  std::vector<double> values;
+
+  for (int i = -500; i <= 500; ++i) {
+    values.emplace_back(i * 1.5);
+    hist->insert(i * 1.5);
+  }
+
+  EXPECT_EQ(hist->min(), -750);
+  EXPECT_EQ(hist->max(), 750);
+  EXPECT_EQ(hist->percentile(50), 0);
+
+  for (auto p : kPercentiles) {
+    expectWithinError(hist->percentile(p), exactPercentile(values, p));
+  }
+
+  free(hist);
+});
+
+TEST_CASE(LogHistogramTest, TestMerge, [] () {
+  auto a = newLogHistogram();
+  auto b = newLogHistogram();
+  auto c = newLogHistogram();
+
+  for (int i = 0; i < 10000; ++i) {
+    double value = 1 + i * 0.37;
+    (i % 3 == 0 ? a : b)->insert(value);
+    c->insert(value);
+  }
+
+  a->merge(*b);
+  EXPECT_EQ(a->count(), c->count());
+  EXPECT_EQ(a->min(), c->min());
+  EXPECT_EQ(a->max(), c->max());
+
+  for (auto p : kPercentiles) {
+    EXPECT_EQ(a->percentile(p), c->percentile(p));
+  }
+
+  free(a);
+  free(b);
+  free(c);
+});
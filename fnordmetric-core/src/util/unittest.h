@@ -61,11 +61,11 @@ void EXPECT_EQ(T1 left, T2 right) {
         L(); \
       } catch (fnordmetric::util::RuntimeException e) { \
         raised = true; \
-        auto msg = e.getMessage().c_str(); \
-        if (strcmp(msg, E) != 0) { \
+        auto msg = e.getMessage(); \
+        if (strcmp(msg.c_str(), E) != 0) { \
           RAISE( \
               kExpectationFailed, \
-              "excepted exception '%s' but got '%s'", E, msg); \
+              "excepted exception '%s' but got '%s'", E, msg.c_str()); \
         } \
       } \
       if (!raised) { \